@@ -0,0 +1,283 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "configmanager.h"
+#include "game.h"
+#include "monster.h"
+#include "monsters.h"
+#include "networkmessage.h"
+#include "npc.h"
+#include "npcbehavior.h"
+#include "scriptmanager.h"
+#include "scriptreader.h"
+#include "scriptwriter.h"
+#include "script.h"
+#include "spells.h"
+#include "vocation.h"
+#include "xtea.h"
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+
+/*
+ * Micro-benchmarks of the core hot paths, run from the source folder against the real world:
+ * config.lua, data/ and the map named in the config are loaded like the server does, without
+ * database, network or the game loop. The spawns are placed so the map has its usual creatures.
+ */
+
+extern Game g_game;
+extern ConfigManager g_config;
+extern Monsters g_monsters;
+extern Vocations g_vocations;
+extern Scripts* g_scripts;
+extern Spells* g_spells;
+
+namespace {
+
+// creatures the map queries are centered on, taken in a fixed order
+constexpr size_t MAX_SAMPLE_POSITIONS = 1024;
+
+const std::string BENCH_NPC = "h.l.";
+const std::string BENCH_BEHAVIOUR_FILE = "data/npc/behavior/hl.npc";
+
+std::vector<Position> samplePositions;
+std::vector<Monster*> sampleMonsters;
+
+bool loadWorld()
+{
+	if (!g_config.load()) {
+		std::cout << "> ERROR: Unable to load " << g_config.getString(ConfigManager::CONFIG_FILE) << std::endl;
+		return false;
+	}
+
+	if (!g_vocations.loadFromXml()) {
+		return false;
+	}
+
+	if (!Item::items.loadFromCache()) {
+		if (!Item::items.loadFromOtb("data/items/items.otb") || !Item::items.loadFromXml()) {
+			return false;
+		}
+	}
+
+	if (!ScriptingManager::getInstance().loadScriptSystems() || !g_scripts->loadScripts("scripts", false, false)) {
+		return false;
+	}
+
+	if (!g_monsters.loadFromXml() || !g_scripts->loadScripts("monster", false, false)) {
+		return false;
+	}
+
+	if (!Outfits::getInstance().loadFromXml()) {
+		return false;
+	}
+
+	NpcBehavior::preloadDatabases("data/npc/behavior/");
+
+	if (!g_game.map.loadMap("data/world/" + g_config.getString(ConfigManager::MAP_NAME) + ".otbm", false)) {
+		return false;
+	}
+	g_game.map.spawns.startup();
+
+	for (Monster* monster : g_game.getMonsters()) {
+		if (sampleMonsters.size() == MAX_SAMPLE_POSITIONS) {
+			break;
+		}
+		sampleMonsters.push_back(monster);
+		samplePositions.push_back(monster->getPosition());
+	}
+
+	std::cout << ">> Benchmarking with " << g_game.getMonstersOnline() << " monsters and " << g_game.getNpcsOnline() << " npcs" << std::endl;
+	return !samplePositions.empty();
+}
+
+void BM_MapGetSpectators(benchmark::State& state)
+{
+	const bool multifloor = state.range(0) != 0;
+	size_t index = 0;
+	for (auto _ : state) {
+		SpectatorVec spectators;
+		g_game.map.getSpectators(spectators, samplePositions[index], multifloor);
+		benchmark::DoNotOptimize(spectators.size());
+		index = (index + 1) % samplePositions.size();
+	}
+}
+BENCHMARK(BM_MapGetSpectators)->Arg(0)->Arg(1);
+
+void BM_MapGetPathMatching(benchmark::State& state)
+{
+	FindPathParams fpp;
+	fpp.maxSearchDist = 12;
+	fpp.minTargetDist = 0;
+	fpp.maxTargetDist = 1;
+
+	const int32_t distance = state.range(0);
+	size_t index = 0;
+	for (auto _ : state) {
+		Monster* monster = sampleMonsters[index];
+		Position targetPos = monster->getPosition();
+		targetPos.x += distance;
+		targetPos.y += distance / 2;
+
+		std::vector<Direction> dirList;
+		benchmark::DoNotOptimize(g_game.map.getPathMatching(*monster, dirList, FrozenPathingConditionCall(targetPos), fpp));
+		index = (index + 1) % sampleMonsters.size();
+	}
+}
+BENCHMARK(BM_MapGetPathMatching)->Arg(4)->Arg(8);
+
+void BM_XteaEncrypt(benchmark::State& state)
+{
+	const xtea::round_keys keys = xtea::expand_key({0x01234567, 0x89abcdef, 0xfedcba98, 0x76543210});
+	std::vector<uint8_t> data(state.range(0));
+	for (auto _ : state) {
+		xtea::encrypt(data.data(), data.size(), keys);
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.SetLabel(xtea::kernel_name());
+}
+BENCHMARK(BM_XteaEncrypt)->Arg(64)->Arg(1024)->Arg(16384);
+
+void BM_XteaEncryptReference(benchmark::State& state)
+{
+	const xtea::round_keys keys = xtea::expand_key({0x01234567, 0x89abcdef, 0xfedcba98, 0x76543210});
+	std::vector<uint8_t> data(state.range(0));
+	for (auto _ : state) {
+		xtea::encrypt_reference(data.data(), data.size(), keys);
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_XteaEncryptReference)->Arg(64)->Arg(1024)->Arg(16384);
+
+void BM_NetworkMessageAddGet(benchmark::State& state)
+{
+	static NetworkMessage msg;
+	const std::string text = "Hello, this is a message of usual length.";
+	const Position pos(32369, 32241, 7);
+	for (auto _ : state) {
+		msg.reset();
+		for (int32_t i = 0; i < 32; ++i) {
+			msg.addByte(0x6A);
+			msg.addPosition(pos);
+			msg.add<uint16_t>(static_cast<uint16_t>(i));
+			msg.add<uint32_t>(0x40000000 + i);
+			msg.addString(text);
+		}
+
+		msg.setBufferPosition(0);
+		for (int32_t i = 0; i < 32; ++i) {
+			benchmark::DoNotOptimize(msg.getByte());
+			benchmark::DoNotOptimize(msg.getPosition());
+			benchmark::DoNotOptimize(msg.get<uint16_t>());
+			benchmark::DoNotOptimize(msg.get<uint32_t>());
+			benchmark::DoNotOptimize(msg.getString());
+		}
+	}
+}
+BENCHMARK(BM_NetworkMessageAddGet);
+
+void BM_ScriptReaderTokenize(benchmark::State& state)
+{
+	const auto size = std::filesystem::file_size(BENCH_BEHAVIOUR_FILE);
+	for (auto _ : state) {
+		ScriptReader script;
+		if (!script.loadScript(BENCH_BEHAVIOUR_FILE)) {
+			state.SkipWithError("could not open the behaviour file");
+			break;
+		}
+
+		size_t tokens = 0;
+		while (script.nextToken() != TOKEN_ENDOFFILE) {
+			++tokens;
+		}
+		benchmark::DoNotOptimize(tokens);
+	}
+	state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_ScriptReaderTokenize);
+
+void BM_SpellsGetInstantSpell(benchmark::State& state)
+{
+	// a spell, a spell with a parameter and the usual chat that is no spell at all
+	const std::array<std::string, 4> words = {"exura vita", "utevo res \"rat", "hello there", "exori"};
+	size_t index = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(g_spells->getInstantSpell(words[index]));
+		index = (index + 1) % words.size();
+	}
+}
+BENCHMARK(BM_SpellsGetInstantSpell);
+
+void BM_NpcBehaviorReact(benchmark::State& state)
+{
+	std::unique_ptr<Npc> npc(Npc::createNpc(BENCH_NPC));
+	if (!npc) {
+		state.SkipWithError("could not create the npc");
+		return;
+	}
+
+	NpcBehavior behavior(npc.get());
+	if (!behavior.loadDatabase(BENCH_BEHAVIOUR_FILE)) {
+		state.SkipWithError("could not load the behaviour file");
+		return;
+	}
+
+	// chatter next to the npc that matches none of its keywords, no action runs
+	Player player(nullptr);
+	const std::string message = "does anyone know where the boat to the next town leaves from";
+	for (auto _ : state) {
+		behavior.react(SITUATION_NONE, &player, message);
+	}
+}
+BENCHMARK(BM_NpcBehaviorReact);
+
+void BM_ItemSerializeTVPFormat(benchmark::State& state)
+{
+	// a parcel holding a letter, a few gold stacks and a nested parcel with more of the same
+	std::unique_ptr<Item> parcel(Item::CreateItem(ITEM_PARCEL));
+	Container* container = parcel->getContainer();
+	Container* inner = container;
+	for (int32_t depth = 0; depth < 2; ++depth) {
+		Item* letter = Item::CreateItem(ITEM_LETTER);
+		letter->setText("Dear friend,\nthe rent of the house is due next week.");
+		inner->internalAddThing(letter);
+		for (int32_t i = 0; i < 8; ++i) {
+			inner->internalAddThing(Item::CreateItem(ITEM_GOLD_COIN, 100));
+		}
+
+		Item* nested = Item::CreateItem(ITEM_PARCEL);
+		inner->internalAddThing(nested);
+		inner = nested->getContainer();
+	}
+
+	ScriptWriter script;
+	for (auto _ : state) {
+		parcel->serializeTVPFormat(script);
+		benchmark::DoNotOptimize(script.hash());
+		script.discard();
+	}
+}
+BENCHMARK(BM_ItemSerializeTVPFormat);
+
+}
+
+int main(int argc, char* argv[])
+{
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+
+	if (!loadWorld()) {
+		std::cout << "> ERROR: Unable to load the world, run tvp_bench from the server folder." << std::endl;
+		return 1;
+	}
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,521 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "configmanager.h"
+#include "game.h"
+#include "iomap.h"
+#include "monster.h"
+#include "monsters.h"
+#include "protocolgame.h"
+#include "scheduler.h"
+#include "scriptmanager.h"
+#include "script.h"
+#include "vocation.h"
+
+#include <fmt/format.h>
+#include <filesystem>
+#include <fstream>
+
+/*
+ * Deterministic simulation of the game loop, for regression and performance runs without production
+ * data. It runs from the source folder like the server: config.lua and data/ are loaded, but the map
+ * is a flat synthetic area and there is neither database nor network. Monsters and players are
+ * placed on it, the players have a protocol without connection (it builds their packets and drops
+ * them) and are driven once a second through the Game::player* calls. The scheduler and the
+ * dispatcher run on the main thread in virtual time, so a run takes the same turns every time for
+ * the same seed and reports how many ticks per second the machine gets through and how many heap
+ * allocations a tick makes. A tick is one checkCreatures slot, 100 ms of game time.
+ *
+ * Scenarios:
+ *   ai      the players walk around at random, the monsters wake up, chase and attack them
+ *   combat  the players attack the nearest monster, dead monsters leave corpses and are replaced
+ *   decay   the players stand still while corpses are dropped all over the map
+ *   restart coins are put into a bag and a paper is written on after a live map snapshot, both must be
+ *           back after the delta journal is saved and the live map is loaded again, exits with 1 if not
+ * The players are healed every second, dying would write to the database.
+ */
+
+extern Game g_game;
+extern ConfigManager g_config;
+extern Monsters g_monsters;
+extern Vocations g_vocations;
+extern Scripts* g_scripts;
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+}
+
+// every heap allocation of the process comes through here, the object pools of the game only when they run dry
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size != 0 ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace {
+
+// OTSYS_TIME of the first tick, fixed so every run sees the same times
+constexpr int64_t VIRTUAL_EPOCH = 1700000000000;
+constexpr uint32_t TICK_INTERVAL = EVENT_CHECK_CREATURE_INTERVAL;
+constexpr uint32_t TICKS_PER_SECOND = 1000 / TICK_INTERVAL;
+
+// north west corner of the synthetic map
+constexpr uint16_t MAP_X = 1000;
+constexpr uint16_t MAP_Y = 1000;
+constexpr uint8_t MAP_Z = 7;
+
+constexpr uint16_t PLAYER_GROUP = 1;
+constexpr uint16_t PLAYER_VOCATION = 4;
+// the players attack monsters up to this far away
+constexpr int32_t COMBAT_RANGE = 7;
+
+// the items the restart scenario changes without Tile::markChanged
+constexpr uint16_t RESTART_BAG = 1987;
+constexpr uint16_t RESTART_PAPER = 1947;
+constexpr uint16_t RESTART_COINS = 2148;
+const std::string RESTART_TEXT = "Written after the snapshot.";
+
+enum class Mode {
+	AI,
+	COMBAT,
+	DECAY,
+	RESTART,
+};
+
+struct Scenario {
+	Mode mode = Mode::AI;
+	std::string monsterName = "rat";
+	uint32_t monsters = 500;
+	uint32_t players = 50;
+	uint32_t ticks = 6000;
+	uint32_t reportTicks = 600;
+	uint32_t seed = 1;
+	uint16_t size = 128;
+	uint16_t groundId = 102;
+	// corpses dropped per second in the decay scenario
+	uint32_t decayItems = 100;
+};
+
+std::vector<Player*> players;
+uint16_t corpseId = 0;
+
+void printUsage()
+{
+	std::cout << "Usage: tvp_sim [options]\n"
+	             "  --scenario <name>         ai, combat, decay or restart (ai)\n"
+	             "  --monsters <count>        monsters kept on the map (500)\n"
+	             "  --players <count>         players without client (50)\n"
+	             "  --monster <name>          monster type to place (rat)\n"
+	             "  --ticks <count>           ticks of 100 ms to run (6000)\n"
+	             "  --report <ticks>          ticks between two reports (600)\n"
+	             "  --size <tiles>            side of the square map (128)\n"
+	             "  --ground <id>             item id of the ground (102)\n"
+	             "  --decay-items <count>     corpses dropped per second in the decay scenario (100)\n"
+	             "  --seed <number>           seed of the game and of the player actions (1)\n";
+}
+
+bool parseArguments(int argc, char* argv[], Scenario& scenario)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+
+		const std::string value = argv[++i];
+		if (arg == "--scenario") {
+			if (value == "ai") {
+				scenario.mode = Mode::AI;
+			} else if (value == "combat") {
+				scenario.mode = Mode::COMBAT;
+			} else if (value == "decay") {
+				scenario.mode = Mode::DECAY;
+			} else if (value == "restart") {
+				scenario.mode = Mode::RESTART;
+			} else {
+				return false;
+			}
+		} else if (arg == "--monsters") {
+			scenario.monsters = std::stoul(value);
+		} else if (arg == "--players") {
+			scenario.players = std::stoul(value);
+		} else if (arg == "--monster") {
+			scenario.monsterName = value;
+		} else if (arg == "--ticks") {
+			scenario.ticks = std::stoul(value);
+		} else if (arg == "--report") {
+			scenario.reportTicks = std::max<unsigned long>(1, std::stoul(value));
+		} else if (arg == "--size") {
+			scenario.size = static_cast<uint16_t>(std::clamp<unsigned long>(std::stoul(value), 16, 1024));
+		} else if (arg == "--ground") {
+			scenario.groundId = static_cast<uint16_t>(std::stoul(value));
+		} else if (arg == "--decay-items") {
+			scenario.decayItems = std::stoul(value);
+		} else if (arg == "--seed") {
+			scenario.seed = static_cast<uint32_t>(std::stoul(value));
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool loadWorld(const Scenario& scenario)
+{
+	if (!g_config.load()) {
+		std::cout << "> ERROR: Unable to load " << g_config.getString(ConfigManager::CONFIG_FILE) << std::endl;
+		return false;
+	}
+
+	// the dispatcher and load shedding budgets stay off, they would tie the game to the speed of the machine
+	seedRandomGenerator(scenario.seed);
+	setVirtualTime(VIRTUAL_EPOCH);
+	g_dispatcher.startWithoutThread();
+	g_scheduler.useVirtualClock();
+
+	if (!g_vocations.loadFromXml()) {
+		return false;
+	}
+
+	if (!Item::items.loadFromCache()) {
+		if (!Item::items.loadFromOtb("data/items/items.otb") || !Item::items.loadFromXml()) {
+			return false;
+		}
+	}
+
+	if (!ScriptingManager::getInstance().loadScriptSystems() || !g_scripts->loadScripts("scripts", false, false)) {
+		return false;
+	}
+
+	if (!g_monsters.loadFromXml() || !g_scripts->loadScripts("monster", false, false)) {
+		return false;
+	}
+
+	if (!Outfits::getInstance().loadFromXml()) {
+		return false;
+	}
+
+	if (!g_game.groups.load()) {
+		return false;
+	}
+
+	MonsterType* mType = g_monsters.getMonsterType(scenario.monsterName);
+	if (!mType) {
+		std::cout << "> ERROR: Unknown monster " << scenario.monsterName << std::endl;
+		return false;
+	}
+	corpseId = mType->info.lookcorpse;
+
+	if (!Item::items[scenario.groundId].isGroundTile()) {
+		std::cout << "> ERROR: Item " << scenario.groundId << " is no ground" << std::endl;
+		return false;
+	}
+
+	for (uint16_t y = 0; y < scenario.size; ++y) {
+		for (uint16_t x = 0; x < scenario.size; ++x) {
+			Item* ground = Item::CreateItem(scenario.groundId);
+			g_game.map.setTile(MAP_X + x, MAP_Y + y, MAP_Z, IOMap::createTile(ground, MAP_X + x, MAP_Y + y, MAP_Z));
+		}
+	}
+	return true;
+}
+
+Position getRandomPosition(const Scenario& scenario)
+{
+	return Position(MAP_X + uniform_random(0, scenario.size - 1), MAP_Y + uniform_random(0, scenario.size - 1), MAP_Z);
+}
+
+bool placePlayers(const Scenario& scenario)
+{
+	for (uint32_t i = 0; i < scenario.players; ++i) {
+		auto protocol = std::make_shared<ProtocolGame>(nullptr);
+		Player* player = protocol->createPlayer(fmt::format("Simulated {:d}", i + 1));
+		player->setGroup(g_game.groups.getGroup(PLAYER_GROUP));
+		player->setVocation(PLAYER_VOCATION);
+
+		if (!g_game.placeCreature(player, getRandomPosition(scenario), true)) {
+			std::cout << "> ERROR: Unable to place " << player->getName() << std::endl;
+			return false;
+		}
+
+		g_game.playerSetFightModes(player->getID(), FIGHTMODE_ATTACK, true, false);
+		players.push_back(player);
+	}
+	return true;
+}
+
+void placeMonsters(const Scenario& scenario)
+{
+	while (g_game.getMonstersOnline() < scenario.monsters) {
+		Monster* monster = Monster::createMonster(scenario.monsterName);
+		if (!monster) {
+			return;
+		}
+
+		if (!g_game.placeCreature(monster, getRandomPosition(scenario), true)) {
+			delete monster;
+			return;
+		}
+	}
+}
+
+void attackNearestMonster(Player* player)
+{
+	if (player->getAttackedCreature()) {
+		return;
+	}
+
+	SpectatorVec spectators;
+	g_game.map.getSpectators(spectators, player->getPosition(), false, false, COMBAT_RANGE, COMBAT_RANGE, COMBAT_RANGE, COMBAT_RANGE);
+
+	const Monster* nearest = nullptr;
+	int32_t nearestDistance = std::numeric_limits<int32_t>::max();
+	for (Creature* spectator : spectators) {
+		if (const Monster* monster = spectator->getMonster()) {
+			const int32_t distance = Position::getDistanceX(monster->getPosition(), player->getPosition()) + Position::getDistanceY(monster->getPosition(), player->getPosition());
+			if (distance < nearestDistance) {
+				nearest = monster;
+				nearestDistance = distance;
+			}
+		}
+	}
+
+	if (nearest) {
+		g_game.playerSetAttackedCreature(player->getID(), nearest->getID());
+	}
+}
+
+void dropCorpses(const Scenario& scenario)
+{
+	for (uint32_t i = 0; i < scenario.decayItems; ++i) {
+		Tile* tile = g_game.map.getTile(getRandomPosition(scenario));
+		Item* corpse = Item::CreateItem(corpseId);
+		if (g_game.internalAddItem(tile, corpse, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
+			delete corpse;
+			continue;
+		}
+		corpse->startDecaying();
+	}
+}
+
+// once a second, like a client sending its actions
+void drive(const Scenario& scenario)
+{
+	for (Player* player : players) {
+		player->resetIdleTime();
+		player->changeHealth(player->getMaxHealth() - player->getHealth(), false);
+
+		switch (scenario.mode) {
+			case Mode::AI:
+				g_game.playerMove(player->getID(), static_cast<Direction>(uniform_random(DIRECTION_NORTH, DIRECTION_WEST)));
+				break;
+
+			case Mode::COMBAT:
+				attackNearestMonster(player);
+				break;
+
+			case Mode::DECAY:
+			case Mode::RESTART:
+				break;
+		}
+	}
+
+	if (scenario.mode == Mode::DECAY) {
+		dropCorpses(scenario);
+	}
+	placeMonsters(scenario);
+}
+
+Item* findItem(const Tile* tile, uint16_t itemId)
+{
+	if (const TileItemVector* items = tile->getItemList()) {
+		for (Item* item : *items) {
+			if (item->getID() == itemId) {
+				return item;
+			}
+		}
+	}
+	return nullptr;
+}
+
+// the live map files go to a scratch folder, the ones of the server are never touched
+bool checkRestart(const Scenario& scenario)
+{
+	const std::filesystem::path sourceFolder = std::filesystem::current_path();
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / fmt::format("tvp_sim_restart_{:d}", scenario.seed);
+
+	std::error_code ec;
+	std::filesystem::remove_all(folder, ec);
+	std::filesystem::create_directories(folder / "gamedata", ec);
+	std::filesystem::create_directories(folder / "data" / "world", ec);
+	// older than the live map files, so loadMapData takes them
+	std::ofstream otbm(folder / "data" / "world" / (g_config.getString(ConfigManager::MAP_NAME) + ".otbm"));
+	otbm.close();
+	std::filesystem::current_path(folder, ec);
+	if (ec) {
+		std::cout << "> ERROR: Unable to use " << folder.string() << ": " << ec.message() << std::endl;
+		return false;
+	}
+	g_config.setBoolean(ConfigManager::ENABLE_MAP_DATA_FILES, true);
+
+	Tile* tile = g_game.map.getTile(MAP_X, MAP_Y, MAP_Z);
+	Item* bag = Item::CreateItem(RESTART_BAG);
+	Item* paper = Item::CreateItem(RESTART_PAPER);
+	g_game.internalAddItem(tile, bag, INDEX_WHEREEVER, FLAG_NOLIMIT);
+	g_game.internalAddItem(tile, paper, INDEX_WHEREEVER, FLAG_NOLIMIT);
+
+	// a full snapshot with the bag empty and the paper blank, then a delta with both changed
+	IOMap::saveMapData();
+	g_game.internalAddItem(bag->getContainer(), Item::CreateItem(RESTART_COINS, 10), INDEX_WHEREEVER, FLAG_NOLIMIT);
+	paper->setText(RESTART_TEXT);
+	IOMap::saveMapData();
+
+	// the tiles are replaced with what the files hold, like at startup
+	bool passed = IOMap::loadMapData() == MAP_DATA_LOAD_FOUND;
+	if (passed) {
+		tile = g_game.map.getTile(MAP_X, MAP_Y, MAP_Z);
+		bag = findItem(tile, RESTART_BAG);
+		paper = findItem(tile, RESTART_PAPER);
+
+		const Container* container = bag ? bag->getContainer() : nullptr;
+		passed = container && container->size() == 1 && container->getItemByIndex(0)->getID() == RESTART_COINS &&
+			paper && paper->getText() == RESTART_TEXT;
+	}
+
+	std::filesystem::current_path(sourceFolder, ec);
+	std::filesystem::remove_all(folder, ec);
+
+	std::cout << (passed ? ">> Restart check passed: the bag and the paper came back as they were changed." :
+		">> Restart check failed: the bag or the paper came back as they were at the snapshot.") << std::endl;
+	return passed;
+}
+
+// runs the scheduler and the dispatcher up to the given game time, one wheel tick at a time
+void advance(uint64_t& elapsed, uint64_t until)
+{
+	while (elapsed < until) {
+		elapsed = std::min<uint64_t>(elapsed + SCHEDULER_WHEEL_TICK, until);
+		setVirtualTime(VIRTUAL_EPOCH + elapsed);
+		g_scheduler.advanceTo(elapsed);
+		while (g_dispatcher.runQueuedTasks()) {}
+	}
+}
+
+// the creatures where they stand with the health they have, two runs of the same scenario give the same digest
+uint64_t getStateDigest()
+{
+	uint64_t digest = 14695981039346656037ULL;
+	const auto mix = [&digest](uint64_t value) {
+		digest = (digest ^ value) * 1099511628211ULL;
+	};
+
+	for (const Monster* monster : g_game.getMonsters()) {
+		mix(monster->getID());
+		mix(monster->getPosition().x | (monster->getPosition().y << 16));
+		mix(monster->getHealth());
+	}
+	for (const Player* player : players) {
+		mix(player->getPosition().x | (player->getPosition().y << 16));
+	}
+	mix(g_game.getDecayingItems());
+	return digest;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Scenario scenario;
+	try {
+		if (!parseArguments(argc, argv, scenario)) {
+			printUsage();
+			return 1;
+		}
+	} catch (const std::exception&) {
+		printUsage();
+		return 1;
+	}
+
+	if (!loadWorld(scenario)) {
+		std::cout << "> ERROR: Unable to load the world, run tvp_sim from the server folder." << std::endl;
+		return 1;
+	}
+
+	if (scenario.mode == Mode::RESTART) {
+		return checkRestart(scenario) ? 0 : 1;
+	}
+
+	if (!placePlayers(scenario)) {
+		return 1;
+	}
+	placeMonsters(scenario);
+
+	g_game.start(nullptr);
+	g_game.startWorldEvents();
+
+	std::cout << fmt::format(">> Simulating {:d} ticks with {:d} monsters and {:d} players on {:d}x{:d} tiles", scenario.ticks,
+		g_game.getMonstersOnline(), g_game.getPlayersOnline(), scenario.size, scenario.size) << std::endl;
+
+	uint64_t elapsed = 0;
+	const auto start = std::chrono::steady_clock::now();
+	const uint64_t startAllocations = allocations.load(std::memory_order_relaxed);
+	auto windowStart = start;
+	uint64_t windowAllocations = startAllocations;
+
+	for (uint32_t tick = 1; tick <= scenario.ticks; ++tick) {
+		if (tick % TICKS_PER_SECOND == 0) {
+			drive(scenario);
+		}
+		advance(elapsed, static_cast<uint64_t>(tick) * TICK_INTERVAL);
+
+		if (tick % scenario.reportTicks == 0) {
+			const auto now = std::chrono::steady_clock::now();
+			const double seconds = std::chrono::duration<double>(now - windowStart).count();
+			const uint64_t currentAllocations = allocations.load(std::memory_order_relaxed);
+			std::cout << fmt::format("tick {:d} | ticks/s {:.0f} | allocations/tick {:.1f} | monsters {:d} | decaying items {:d}", tick,
+				scenario.reportTicks / seconds, static_cast<double>(currentAllocations - windowAllocations) / scenario.reportTicks,
+				g_game.getMonstersOnline(), g_game.getDecayingItems()) << std::endl;
+			windowStart = now;
+			windowAllocations = currentAllocations;
+		}
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const uint64_t totalAllocations = allocations.load(std::memory_order_relaxed) - startAllocations;
+	std::cout << fmt::format(">> {:d} ticks ({:.0f} s of game time) in {:.2f} s: {:.0f} ticks/s, {:.1f} allocations/tick, state digest {:016x}",
+		scenario.ticks, elapsed / 1000., seconds, scenario.ticks / seconds, static_cast<double>(totalAllocations) / std::max<uint32_t>(1, scenario.ticks),
+		getStateDigest()) << std::endl;
+	return 0;
+}
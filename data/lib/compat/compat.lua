@@ -1325,7 +1325,6 @@ end
 
 function broadcastMessage(message, messageType)
 	Game.broadcastMessage(message, messageType)
-	print("> Broadcasted message: \"" .. message .. "\".")
 end
 doBroadcastMessage = broadcastMessage
 
@@ -183,3 +183,16 @@ function Combat:getTargets(creature, variant)
 	self:execute(creature, variant)
 	return targets
 end
+
+-- Player:computeDamage, computeHealing and computeSkillDamage as formulas the server evaluates on its own
+function Combat:setDamageFormula(damage, variation, limitMinimum, limitMaximum)
+	return self:setFormula(COMBAT_FORMULA_BASEDAMAGE, -(damage - variation), limitMinimum and 100 or 0, -(damage + variation), limitMaximum and 100 or 0)
+end
+
+function Combat:setHealingFormula(damage, variation, limitMinimum, limitMaximum)
+	return self:setFormula(COMBAT_FORMULA_BASEDAMAGE, damage - variation, limitMinimum and 100 or 0, damage + variation, limitMaximum and 100 or 0)
+end
+
+function Combat:setSkillDamageFormula(damage, variation, limitMinimum, limitMaximum)
+	return self:setFormula(COMBAT_FORMULA_BASESKILL, -(damage - variation), limitMinimum and 100 or 0, -(damage + variation), limitMaximum and 100 or 0)
+end
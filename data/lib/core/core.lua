@@ -15,3 +15,5 @@ dofile('data/lib/core/position.lua')
 dofile('data/lib/core/teleport.lua')
 dofile('data/lib/core/tile.lua')
 dofile('data/lib/core/vocation.lua')
+-- replaces C API getters, so it goes last
+dofile('data/lib/core/ffi.lua')
@@ -0,0 +1,90 @@
+-- The most called read-only getters through the LuaJIT FFI instead of the Lua C API, so the
+-- scripts calling them can be compiled by the JIT. See src/luaffi.cpp, luaFfiBindings turns them off.
+if type(jit) ~= 'table' or not configManager.getBoolean(configKeys.LUA_FFI_BINDINGS) then
+	return
+end
+
+local ok, ffi = pcall(require, 'ffi')
+if not ok then
+	return
+end
+
+ffi.cdef[[
+typedef struct { uint16_t x; uint16_t y; uint8_t z; } TvpPosition;
+
+uint32_t tvp_creature_get_id(const void* creature);
+bool tvp_creature_get_position(const void* creature, TvpPosition* position);
+int32_t tvp_creature_get_health(const void* creature);
+int32_t tvp_creature_get_max_health(const void* creature);
+uint32_t tvp_player_get_level(const void* player);
+uint16_t tvp_item_get_id(const void* item);
+bool tvp_item_get_position(const void* item, TvpPosition* position);
+]]
+
+local C = ffi.C
+
+-- a server that does not export them keeps the C API methods
+if not pcall(function() return C.tvp_item_get_position end) then
+	return
+end
+
+local positionMetatable = debug.getregistry().Position
+local position = ffi.new('TvpPosition')
+
+local function newPosition()
+	return setmetatable({x = position.x, y = position.y, z = position.z, stackpos = 0}, positionMetatable)
+end
+
+function Creature.getId(self)
+	local id = C.tvp_creature_get_id(self)
+	if id == 0 then
+		return nil
+	end
+	return id
+end
+
+function Creature.getPosition(self)
+	if not C.tvp_creature_get_position(self, position) then
+		return nil
+	end
+	return newPosition()
+end
+
+function Creature.getHealth(self)
+	local health = C.tvp_creature_get_health(self)
+	if health < 0 then
+		return nil
+	end
+	return health
+end
+
+function Creature.getMaxHealth(self)
+	local maxHealth = C.tvp_creature_get_max_health(self)
+	if maxHealth < 0 then
+		return nil
+	end
+	return maxHealth
+end
+
+function Player.getLevel(self)
+	local level = C.tvp_player_get_level(self)
+	if level == 0 then
+		return nil
+	end
+	return level
+end
+
+function Item.getId(self)
+	local id = C.tvp_item_get_id(self)
+	if id == 0 then
+		return nil
+	end
+	return id
+end
+
+function Item.getPosition(self)
+	if not C.tvp_item_get_position(self, position) then
+		return nil
+	end
+	return newPosition()
+end
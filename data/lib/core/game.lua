@@ -83,16 +83,6 @@ function Game.transformItemInPosition(position, fromitemid, toitemid)
 	return true
 end
 
-function Game.broadcastMessage(message, messageType)
-	if not messageType then
-		messageType = MESSAGE_STATUS_WARNING
-	end
-
-	for _, player in ipairs(Game.getPlayers()) do
-		player:sendTextMessage(messageType, message)
-	end
-end
-
 function Game.convertIpToString(ip)
 	local band = bit.band
 	local rshift = bit.rshift
@@ -1,3 +1,4 @@
 function onUpdateDatabase()
-	return false
+	db.query("ALTER TABLE `players_online` ADD `shard_id` int(10) UNSIGNED NOT NULL DEFAULT 0;")
+	return true
 end
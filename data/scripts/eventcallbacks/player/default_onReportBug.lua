@@ -6,22 +6,26 @@ ec.onReportBug = function(self, message)
 	end
 
 	local name = self:getName()
-	local file = io.open("gamedata/reports/bugs/" .. name .. " report.txt", "a")
+	local playerPosition = self:getPosition()
+	local report = "------------------------------\n" ..
+		"Name: " .. name ..
+		" [Player Position: " .. playerPosition.x .. ", " .. playerPosition.y .. ", " .. playerPosition.z .. "]\n" ..
+		"Comment: " .. message .. "\n"
 
-	if not file then
-		self:sendTextMessage(MESSAGE_EVENT_DEFAULT, "There was an error when processing your report, please contact a gamemaster.")
-		return true
-	end
+	local playerId = self:getId()
+	appendFile("gamedata/reports/bugs/" .. name .. " report.txt", report, function(success)
+		local player = Player(playerId)
+		if not player then
+			return
+		end
 
-	io.output(file)
-	io.write("------------------------------\n")
-	io.write("Name: " .. name)
-	local playerPosition = self:getPosition()
-	io.write(" [Player Position: " .. playerPosition.x .. ", " .. playerPosition.y .. ", " .. playerPosition.z .. "]\n")
-	io.write("Comment: " .. message .. "\n")
-	io.close(file)
+		if not success then
+			player:sendTextMessage(MESSAGE_EVENT_DEFAULT, "There was an error when processing your report, please contact a gamemaster.")
+			return
+		end
 
-	self:sendTextMessage(MESSAGE_EVENT_DEFAULT, "Your report has been sent to " .. configManager.getString(configKeys.SERVER_NAME) .. ".")
+		player:sendTextMessage(MESSAGE_EVENT_DEFAULT, "Your report has been sent to " .. configManager.getString(configKeys.SERVER_NAME) .. ".")
+	end)
 	return true
 end
 
@@ -285,14 +285,7 @@ end
 local logFormat = "[%s] %s %s"
 
 function logCommand(player, words, param)
-	local file = io.open("data/logs/" .. player:getName() .. " commands.log", "a")
-	if not file then
-		return
-	end
-
-	io.output(file)
-	io.write(logFormat:format(os.date("%d/%m/%Y %H:%M"), words, param):trim() .. "\n")
-	io.close(file)
+	appendFile("data/logs/" .. player:getName() .. " commands.log", logFormat:format(os.date("%d/%m/%Y %H:%M"), words, param):trim() .. "\n")
 end
 
 function Player:addPartyCondition(combat, variant, condition, baseMana)
@@ -81,7 +81,7 @@ EventCallback = {
 		if isScriptsInterface() then
 			local type, call = rawget(self, "type"), rawget(self, "call")
 			if type and call then
-				EventCallbackData[type][#EventCallbackData[type] + 1] = {call, tonumber(index) or 0}
+				EventCallbackData[type][#EventCallbackData[type] + 1] = {call, tonumber(index) or 0, debug.getinfo(call, "S").source}
 				table.sort(EventCallbackData[type], function (a, b) return a[2] < b[2] end)
 				return rawset(self, "type", nil) and rawset(self, "call", nil)
 			end
@@ -93,6 +93,18 @@ EventCallback = {
 		for i = 1, EVENT_CALLBACK_LAST do
 			EventCallbackData[i] = {}
 		end
+	end,
+	-- called by the per-file reload, before the file runs again
+	clearFile = function (self, file)
+		local source = "@" .. file
+		for i = 1, EVENT_CALLBACK_LAST do
+			local eventTable = EventCallbackData[i]
+			for k = #eventTable, 1, -1 do
+				if eventTable[k][3] == source then
+					table.remove(eventTable, k)
+				end
+			end
+		end
 	end
 }
 
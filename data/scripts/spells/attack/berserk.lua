@@ -6,11 +6,7 @@ combat:setParameter(COMBAT_PARAM_BLOCKSHIELD, false)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 combat:setArea(createCombatArea(AREA_SQUARE1X1))
 
-function onGetFormulaValues(player, skill, attack, factor)
-	return player:computeSkillDamage(80, 20, skill, false, true)
-end
-
-combat:setCallback(CALLBACK_PARAM_SKILLVALUE, "onGetFormulaValues")
+combat:setSkillDamageFormula(80, 20, false, true)
 
 local spell = Spell(SPELL_INSTANT)
 
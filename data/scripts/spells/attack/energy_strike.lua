@@ -3,11 +3,7 @@ combat:setParameter(COMBAT_PARAM_TYPE, COMBAT_ENERGYDAMAGE)
 combat:setParameter(COMBAT_PARAM_EFFECT, CONST_ME_TELEPORT)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(45, 10)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(45, 10)
 
 local spell = Spell(SPELL_INSTANT)
 
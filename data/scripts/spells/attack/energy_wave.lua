@@ -4,11 +4,7 @@ combat:setParameter(COMBAT_PARAM_EFFECT, CONST_ME_TELEPORT)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 combat:setArea(createCombatArea(AREA_SQUAREWAVE5))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(150, 50)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(150, 50)
 
 local spell = Spell(SPELL_INSTANT)
 
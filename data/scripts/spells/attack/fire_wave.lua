@@ -4,11 +4,7 @@ combat:setParameter(COMBAT_PARAM_EFFECT, CONST_ME_FIREAREA)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 combat:setArea(createCombatArea(AREA_WAVE4))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(30, 10, true)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(30, 10, true)
 
 local spell = Spell(SPELL_INSTANT)
 
@@ -5,11 +5,7 @@ combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 combat:setParameter(COMBAT_PARAM_BLOCKARMOR, true)
 combat:setParameter(COMBAT_PARAM_BLOCKSHIELD, false)
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(45, 10)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(45, 10)
 
 local spell = Spell(SPELL_INSTANT)
 
@@ -4,11 +4,7 @@ combat:setParameter(COMBAT_PARAM_EFFECT, CONST_ME_EXPLOSIONHIT)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 combat:setArea(createCombatArea(AREA_BEAM8))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(120, 80)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(120, 80)
 
 local spell = Spell(SPELL_INSTANT)
 
@@ -6,11 +6,7 @@ combat:setParameter(COMBAT_PARAM_BLOCKARMOR, true)
 combat:setParameter(COMBAT_PARAM_BLOCKSHIELD, false)
 combat:setArea(createCombatArea(AREA_CIRCLE5X5))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(250, 50)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(250, 50)
 
 local spell = Spell(SPELL_INSTANT)
 
@@ -5,11 +5,7 @@ combat:setParameter(COMBAT_PARAM_DISPEL, CONDITION_PARALYZE)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, false)
 combat:setParameter(COMBAT_PARAM_TARGETCASTERORTOPMOST, true)
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeHealing(40, 20, true)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setHealingFormula(40, 20, true)
 
 local spell = Spell(SPELL_INSTANT)
 
@@ -24,11 +24,7 @@ combat:setParameter(COMBAT_PARAM_BLOCKARMOR, true)
 combat:setParameter(COMBAT_PARAM_BLOCKSHIELD, false)
 combat:setArea(createCombatArea(AREA_CROSS1X1))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(60, 40)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(60, 40)
 
 local rune = Spell(SPELL_RUNE)
 
@@ -22,11 +22,7 @@ combat:setParameter(COMBAT_PARAM_DISTANCEEFFECT, CONST_ANI_FIRE)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, true)
 combat:setArea(createCombatArea(AREA_CIRCLE2X2))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(20, 5, true)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(20, 5, true)
 
 local rune = Spell(SPELL_RUNE)
 
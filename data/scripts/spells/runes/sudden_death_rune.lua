@@ -24,11 +24,7 @@ combat:setParameter(COMBAT_PARAM_BLOCKARMOR, true)
 combat:setParameter(COMBAT_PARAM_BLOCKSHIELD, false)
 combat:setArea(createCombatArea(AREA_SINGLE))
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(150, 20)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(150, 20)
 
 local rune = Spell(SPELL_RUNE)
 
@@ -22,11 +22,7 @@ combat:setParameter(COMBAT_PARAM_DISPEL, CONDITION_PARALYZE)
 combat:setParameter(COMBAT_PARAM_AGGRESSIVE, false)
 combat:setParameter(COMBAT_PARAM_TARGETCASTERORTOPMOST, false)
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeHealing(250, 0, true)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setHealingFormula(250, 0, true)
 
 local rune = Spell(SPELL_RUNE)
 
@@ -0,0 +1,23 @@
+local talkaction = TalkAction("/memory")
+
+function talkaction.onSay(player, words, param, type)
+	if player:getAccountType() < ACCOUNT_TYPE_GOD then
+		return false
+	end
+
+	local stats = Game.getMemoryStats()
+	local text = string.format("Items: %d, item attributes: %d (%d KiB).\n", stats.items, stats.itemAttributes, math.floor(stats.itemAttributesBytes / 1024))
+	text = text .. string.format("Players: %d, monsters: %d, npcs: %d.\n", stats.players, stats.monsters, stats.npcs)
+	text = text .. string.format("Tiles: %d, floors: %d, refresh items: %d (%d KiB).\n", stats.tiles, stats.floors, stats.refreshItems, math.floor(stats.refreshBytes / 1024))
+	text = text .. string.format("Output messages: %d, statements: %d, listeners: %d.\n", stats.outputMessages, stats.statements, stats.listeners)
+	text = text .. string.format("Lua: %d KiB, depot items online: %d.", math.floor(stats.luaMemory / 1024), stats.depotItems)
+	player:showTextDialog(2598, text)
+
+	Game.dumpMemoryReport()
+	player:sendTextMessage(MESSAGE_INFO_DESCR, "Memory report written to data/logs/memory.log.")
+	return false
+end
+
+talkaction:access(true)
+talkaction:separator(" ")
+talkaction:register()
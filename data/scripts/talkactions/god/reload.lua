@@ -20,6 +20,9 @@ local reloadTypes = {
 
 	["global"] = RELOAD_TYPE_GLOBAL,
 
+	["guild"] = RELOAD_TYPE_GUILDS,
+	["guilds"] = RELOAD_TYPE_GUILDS,
+
 	["globalevent"] = RELOAD_TYPE_GLOBALEVENTS,
 	["globalevents"] = RELOAD_TYPE_GLOBALEVENTS,
 
@@ -49,6 +52,7 @@ local reloadTypes = {
 	["weapons"] = RELOAD_TYPE_WEAPONS,
 
 	["scripts"] = RELOAD_TYPE_SCRIPTS,
+	["changed"] = RELOAD_TYPE_CHANGED_SCRIPTS,
 	["libs"] = RELOAD_TYPE_GLOBAL
 }
 
@@ -0,0 +1,26 @@
+local talkaction = TalkAction("/scriptprofile")
+
+function talkaction.onSay(player, words, param, type)
+	if player:getAccountType() < ACCOUNT_TYPE_GOD then
+		return false
+	end
+
+	if param == "reset" then
+		Game.resetScriptProfile()
+		player:sendTextMessage(MESSAGE_INFO_DESCR, "Script profile reset.")
+		return false
+	end
+
+	local scripts = Game.dumpScriptProfile()
+	if not scripts then
+		player:sendCancelMessage("The script profiler is disabled, set luaProfiler in config.lua.")
+		return false
+	end
+
+	player:sendTextMessage(MESSAGE_INFO_DESCR, "Profile of " .. scripts .. " scripts written to data/logs/script_profile.log.")
+	return false
+end
+
+talkaction:access(true)
+talkaction:separator(" ")
+talkaction:register()
\ No newline at end of file
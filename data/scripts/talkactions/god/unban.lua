@@ -13,6 +13,7 @@ function talkaction.onSay(player, words, param)
 	db.asyncQuery("DELETE FROM `account_bans` WHERE `account_id` = " .. result.getNumber(resultId, "account_id"))
 	db.asyncQuery("DELETE FROM `ip_bans` WHERE `ip` = " .. result.getNumber(resultId, "lastip"))
 	result.free(resultId)
+	Game.reloadBans()
 	player:sendTextMessage(MESSAGE_EVENT_ADVANCE, param .. " has been unbanned.")
 	return false
 end
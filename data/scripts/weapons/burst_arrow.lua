@@ -14,11 +14,7 @@ combat:setParameter(COMBAT_PARAM_BLOCKARMOR, true)
 combat:setParameter(COMBAT_PARAM_BLOCKSHIELD, false)
 combat:setArea(area)
 
-function onGetFormulaValues(player, level, magicLevel)
-	return player:computeDamage(30, 30)
-end
-
-combat:setCallback(CALLBACK_PARAM_LEVELMAGICVALUE, "onGetFormulaValues")
+combat:setDamageFormula(30, 30)
 
 function weapon.onUseWeapon(player, variant, hit)
 	local result = combat:execute(player, variant)
@@ -303,7 +303,8 @@ DELIMITER ;
 --
 
 CREATE TABLE `players_online` (
-  `player_id` int(11) NOT NULL
+  `player_id` int(11) NOT NULL,
+  `shard_id` int(10) UNSIGNED NOT NULL DEFAULT 0
 ) ENGINE=MEMORY DEFAULT CHARSET=utf8mb3 COLLATE=utf8mb3_general_ci;
 
 -- --------------------------------------------------------
@@ -30,20 +30,40 @@ Actions::~Actions()
 	clear();
 }
 
-void Actions::clearMap(ActionUseMap& map)
+void Actions::clearMap(ActionUseMap& map, ActionUseIndex& index)
 {
 	map.clear();
+	index.clear();
 }
 
 void Actions::clear()
 {
-	clearMap(useItemMap);
-	clearMap(uniqueItemMap);
-	clearMap(actionItemMap);
+	clearMap(useItemMap, useItemIndex);
+	clearMap(uniqueItemMap, uniqueItemIndex);
+	clearMap(actionItemMap, actionItemIndex);
 
 	getScriptInterface().reInitState();
 }
 
+void Actions::removeScriptFile(const std::string* scriptFile)
+{
+	removeScriptFile(scriptFile, useItemMap, useItemIndex);
+	removeScriptFile(scriptFile, uniqueItemMap, uniqueItemIndex);
+	removeScriptFile(scriptFile, actionItemMap, actionItemIndex);
+}
+
+void Actions::removeScriptFile(const std::string* scriptFile, ActionUseMap& map, ActionUseIndex& index)
+{
+	for (auto it = map.begin(); it != map.end();) {
+		if (it->second.isFromScriptFile(scriptFile)) {
+			index[it->first] = nullptr;
+			it = map.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 LuaScriptInterface& Actions::getScriptInterface()
 {
 	return scriptInterface;
@@ -60,8 +80,7 @@ bool Actions::registerLuaEvent(Action* event)
 	if (!action->getItemIdRange().empty()) {
 		const auto& range = action->getItemIdRange();
 		for (auto id : range) {
-			auto result = useItemMap.emplace(id, *action);
-			if (!result.second) {
+			if (!addAction(*action, id, useItemMap, useItemIndex)) {
 				std::cout << "[Warning - Actions::registerLuaEvent] Duplicate registered item with id: " << id << " in range from id: " << range.front() << ", to id: " << range.back() << std::endl;
 			}
 		}
@@ -71,8 +90,7 @@ bool Actions::registerLuaEvent(Action* event)
 	if (!action->getUniqueIdRange().empty()) {
 		const auto& range = action->getUniqueIdRange();
 		for (auto id : range) {
-			auto result = uniqueItemMap.emplace(id, *action);
-			if (!result.second) {
+			if (!addAction(*action, id, uniqueItemMap, uniqueItemIndex)) {
 				std::cout << "[Warning - Actions::registerLuaEvent] Duplicate registered item with uid: " << id << " in range from uid: " << range.front() << ", to uid: " << range.back() << std::endl;
 			}
 		}
@@ -82,8 +100,7 @@ bool Actions::registerLuaEvent(Action* event)
 	if (!action->getActionIdRange().empty()) {
 		const auto& range = action->getActionIdRange();
 		for (auto id : range) {
-			auto result = actionItemMap.emplace(id, *action);
-			if (!result.second) {
+			if (!addAction(*action, id, actionItemMap, actionItemIndex)) {
 				std::cout << "[Warning - Actions::registerLuaEvent] Duplicate registered item with aid: " << id << " in range from aid: " << range.front() << ", to aid: " << range.back() << std::endl;
 			}
 		}
@@ -94,6 +111,20 @@ bool Actions::registerLuaEvent(Action* event)
 	return false;
 }
 
+bool Actions::addAction(const Action& action, uint16_t id, ActionUseMap& map, ActionUseIndex& index)
+{
+	auto result = map.emplace(id, action);
+	if (!result.second) {
+		return false;
+	}
+
+	if (id >= index.size()) {
+		index.resize(id + 1);
+	}
+	index[id] = &result.first->second;
+	return true;
+}
+
 ReturnValue Actions::canUse(const Player* player, const Position& pos)
 {
 	if (pos.x != 0xFFFF) {
@@ -149,22 +180,19 @@ ReturnValue Actions::canUseFar(const Creature* creature, const Position& toPos,
 Action* Actions::getAction(const Item* item)
 {
 	if (item->hasAttribute(ITEM_ATTRIBUTE_UNIQUEID)) {
-		auto it = uniqueItemMap.find(item->getUniqueId());
-		if (it != uniqueItemMap.end()) {
-			return &it->second;
+		if (Action* action = findAction(uniqueItemIndex, item->getUniqueId())) {
+			return action;
 		}
 	}
 
 	if (item->hasAttribute(ITEM_ATTRIBUTE_ACTIONID)) {
-		auto it = actionItemMap.find(item->getActionId());
-		if (it != actionItemMap.end()) {
-			return &it->second;
+		if (Action* action = findAction(actionItemIndex, item->getActionId())) {
+			return action;
 		}
 	}
 
-	auto it = useItemMap.find(item->getID());
-	if (it != useItemMap.end()) {
-		return &it->second;
+	if (Action* action = findAction(useItemIndex, item->getID())) {
+		return action;
 	}
 
 	//rune items
@@ -107,6 +107,7 @@ class Actions final
 
 		bool registerLuaEvent(Action* event);
 		void clear();
+		void removeScriptFile(const std::string* scriptFile);
 
 	private:
 		ReturnValue internalUseItem(Player* player, const Position& pos, uint8_t index, Item* item);
@@ -119,8 +120,19 @@ class Actions final
 		ActionUseMap uniqueItemMap;
 		ActionUseMap actionItemMap;
 
+		// the maps above indexed directly by id, probed on every use
+		using ActionUseIndex = std::vector<Action*>;
+		ActionUseIndex useItemIndex;
+		ActionUseIndex uniqueItemIndex;
+		ActionUseIndex actionItemIndex;
+
 		Action* getAction(const Item* item);
-		void clearMap(ActionUseMap& map);
+		void clearMap(ActionUseMap& map, ActionUseIndex& index);
+		static void removeScriptFile(const std::string* scriptFile, ActionUseMap& map, ActionUseIndex& index);
+		bool addAction(const Action& action, uint16_t id, ActionUseMap& map, ActionUseIndex& index);
+		static Action* findAction(const ActionUseIndex& index, uint16_t id) {
+			return id < index.size() ? index[id] : nullptr;
+		}
 
 		LuaScriptInterface scriptInterface;
 };
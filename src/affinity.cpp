@@ -0,0 +1,196 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "affinity.h"
+#include "configmanager.h"
+#include "tools.h"
+
+#include <charconv>
+#include <filesystem>
+
+#ifdef __linux__
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+extern ConfigManager g_config;
+
+namespace {
+
+constexpr std::array<std::string_view, 8> ROLES = {"dispatcher", "scheduler", "database", "files", "logger", "metrics", "network", "jobs"};
+
+// filled once at startup before any thread asks for its cores
+std::map<std::string, std::vector<uint32_t>, std::less<>> roleCores;
+
+bool parseCore(std::string_view text, uint32_t& core)
+{
+	const auto result = std::from_chars(text.data(), text.data() + text.size(), core);
+	return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+// "2-5,8" to 2, 3, 4, 5, 8
+bool parseCores(const std::string& text, std::vector<uint32_t>& cores)
+{
+	for (std::string range : explodeString(text, ",")) {
+		trimString(range);
+		const std::string_view view = range;
+		const size_t dash = view.find('-');
+
+		uint32_t first, last;
+		if (dash == std::string_view::npos) {
+			if (!parseCore(view, first)) {
+				return false;
+			}
+			last = first;
+		} else if (!parseCore(view.substr(0, dash), first) || !parseCore(view.substr(dash + 1), last) || last < first) {
+			return false;
+		}
+
+		for (uint32_t core = first; core <= last; ++core) {
+			cores.push_back(core);
+		}
+	}
+	return !cores.empty();
+}
+
+template <typename Handle>
+void pin(Handle handle, std::string_view role, size_t index)
+{
+	const std::vector<uint32_t>& cores = affinity::getCores(role);
+	if (cores.empty()) {
+		return;
+	}
+
+	std::vector<uint32_t> pinned;
+	if (index == affinity::ALL_CORES) {
+		pinned = cores;
+	} else {
+		pinned.push_back(cores[index % cores.size()]);
+	}
+
+	bool success = false;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (uint32_t core : pinned) {
+		if (core < CPU_SETSIZE) {
+			CPU_SET(core, &set);
+		}
+	}
+	success = pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	DWORD_PTR mask = 0;
+	for (uint32_t core : pinned) {
+		if (core < sizeof(mask) * 8) {
+			mask |= static_cast<DWORD_PTR>(1) << core;
+		}
+	}
+	success = mask != 0 && SetThreadAffinityMask(handle, mask) != 0;
+#else
+	(void)handle;
+#endif
+
+	if (!success) {
+		std::cout << "[Warning - affinity::pinThread] Cannot pin a " << role << " thread to its cores." << std::endl;
+	}
+}
+
+}
+
+namespace affinity {
+
+bool load()
+{
+	roleCores.clear();
+
+	const std::string& config = g_config.getString(ConfigManager::THREAD_AFFINITY);
+	if (config.empty()) {
+		return true;
+	}
+
+#if !defined(__linux__) && !defined(_WIN32)
+	std::cout << "> Warning: threadAffinity is set, but threads cannot be pinned on this system." << std::endl;
+	return true;
+#else
+	for (std::string entry : explodeString(config, ";")) {
+		trimString(entry);
+		if (entry.empty()) {
+			continue;
+		}
+
+		const size_t equals = entry.find('=');
+		if (equals == std::string::npos) {
+			std::cout << "[Error - affinity::load] Missing '=' in threadAffinity entry \"" << entry << "\"." << std::endl;
+			return false;
+		}
+
+		std::string role = asLowerCaseString(entry.substr(0, equals));
+		trimString(role);
+		if (std::find(ROLES.begin(), ROLES.end(), role) == ROLES.end()) {
+			std::cout << "[Error - affinity::load] Unknown thread role \"" << role << "\" in threadAffinity." << std::endl;
+			return false;
+		}
+
+		std::vector<uint32_t> cores;
+		if (!parseCores(entry.substr(equals + 1), cores)) {
+			std::cout << "[Error - affinity::load] Invalid core list for " << role << " in threadAffinity." << std::endl;
+			return false;
+		}
+		roleCores[role] = std::move(cores);
+	}
+	return true;
+#endif
+}
+
+const std::vector<uint32_t>& getCores(std::string_view role)
+{
+	static const std::vector<uint32_t> none;
+	auto it = roleCores.find(role);
+	return it != roleCores.end() ? it->second : none;
+}
+
+void pinThread(std::thread& thread, std::string_view role, size_t index/* = ALL_CORES*/)
+{
+	if (thread.joinable()) {
+		pin(thread.native_handle(), role, index);
+	}
+}
+
+void pinCurrentThread(std::string_view role, size_t index/* = ALL_CORES*/)
+{
+#ifdef __linux__
+	pin(pthread_self(), role, index);
+#elif defined(_WIN32)
+	pin(GetCurrentThread(), role, index);
+#else
+	(void)role;
+	(void)index;
+#endif
+}
+
+int32_t getNode(std::string_view role)
+{
+	const std::vector<uint32_t>& cores = getCores(role);
+	if (cores.empty()) {
+		return -1;
+	}
+
+#ifdef __linux__
+	// the core's directory links the node it belongs to, as node<N>
+	std::error_code ec;
+	const std::string directory = "/sys/devices/system/cpu/cpu" + std::to_string(cores.front());
+	for (auto it = std::filesystem::directory_iterator(directory, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+		const std::string name = it->path().filename().string();
+		uint32_t node;
+		if (name.starts_with("node") && parseCore(std::string_view(name).substr(4), node)) {
+			return static_cast<int32_t>(node);
+		}
+	}
+#endif
+	return -1;
+}
+
+} // namespace affinity
@@ -0,0 +1,30 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Pins the threads of the server to the cores threadAffinity gives their role, a list like
+ * "dispatcher=0;scheduler=1;network=2-3;database=4;files=5;jobs=6-11". The roles are dispatcher,
+ * scheduler, database, files, logger, metrics, network and jobs. A thread of a pool (network, jobs)
+ * takes one core of its role's list in turn, any other thread may run on all of them. A role left
+ * out floats as before. Linux and Windows, elsewhere nothing is pinned.
+ */
+namespace affinity {
+
+constexpr size_t ALL_CORES = std::numeric_limits<size_t>::max();
+
+// reads threadAffinity, false if it cannot be parsed
+bool load();
+
+// the cores role is pinned to, empty when it is not
+const std::vector<uint32_t>& getCores(std::string_view role);
+
+// pins thread to the cores of role, or to the index-th one in turn for a thread of a pool
+void pinThread(std::thread& thread, std::string_view role, size_t index = ALL_CORES);
+void pinCurrentThread(std::string_view role, size_t index = ALL_CORES);
+
+// the numa node of the first core of role, -1 when it is not pinned or the node is unknown
+int32_t getNode(std::string_view role);
+
+} // namespace affinity
@@ -0,0 +1,184 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "arena.h"
+#include "affinity.h"
+#include "configmanager.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern ConfigManager g_config;
+
+namespace {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+constexpr size_t REGION_SIZE = 32 * HUGE_PAGE_SIZE;
+// each thread bumps through a slice of its own, the lock is taken once per slice
+constexpr size_t SLICE_SIZE = 256 * 1024;
+constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+// a bigger chunk would leave too much of the slice it does not fit in unused
+constexpr size_t MAX_CHUNK_SIZE = SLICE_SIZE / 16;
+
+std::atomic<bool> enabled{false};
+HugePages_t hugePages = HUGE_PAGES_NONE;
+int32_t numaNode = -1;
+
+struct Slice {
+	char* next = nullptr;
+	char* end = nullptr;
+};
+
+thread_local Slice slice;
+
+std::mutex regionLock;
+std::vector<std::pair<const char*, const char*>> regions;
+char* regionNext = nullptr;
+char* regionEnd = nullptr;
+
+#ifdef __linux__
+
+// MPOL_PREFERRED of linux/mempolicy.h, the pages go elsewhere once the node is full
+constexpr int PREFERRED_NODE_POLICY = 1;
+
+// regionLock held
+char* mapRegion()
+{
+	void* region = MAP_FAILED;
+	if (hugePages == HUGE_PAGES_EXPLICIT) {
+		static bool warned = false;
+		region = mmap(nullptr, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (region == MAP_FAILED && !warned) {
+			std::cout << "[Warning - arena::allocate] No explicit huge pages left, see vm.nr_hugepages. Transparent huge pages are used instead." << std::endl;
+			warned = true;
+		}
+	}
+
+	if (region == MAP_FAILED) {
+		// transparent huge pages only back whole aligned huge pages, the ends past them are unmapped
+		void* mapping = mmap(nullptr, REGION_SIZE + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapping == MAP_FAILED) {
+			return nullptr;
+		}
+
+		char* begin = static_cast<char*>(mapping);
+		char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(begin) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+		if (aligned != begin) {
+			munmap(begin, aligned - begin);
+		}
+		if (char* end = begin + REGION_SIZE + HUGE_PAGE_SIZE; aligned + REGION_SIZE != end) {
+			munmap(aligned + REGION_SIZE, end - (aligned + REGION_SIZE));
+		}
+
+		region = aligned;
+		if (hugePages != HUGE_PAGES_NONE) {
+			madvise(region, REGION_SIZE, MADV_HUGEPAGE);
+		}
+	}
+
+	// no page is touched yet, they are all faulted in on the node
+	if (numaNode >= 0) {
+		unsigned long nodeMask = 1UL << numaNode;
+		if (syscall(SYS_mbind, region, REGION_SIZE, PREFERRED_NODE_POLICY, &nodeMask, sizeof(nodeMask) * 8, 0) != 0) {
+			std::cout << "[Warning - arena::allocate] Cannot place the pool memory on numa node " << numaNode << '.' << std::endl;
+		}
+	}
+	return static_cast<char*>(region);
+}
+
+#else
+
+char* mapRegion()
+{
+	return nullptr;
+}
+
+#endif
+
+}
+
+namespace arena {
+
+void load()
+{
+	hugePages = static_cast<HugePages_t>(g_config.getNumber(ConfigManager::HUGE_PAGES));
+	// a write of the game copies a whole explicit huge page while the forked save runs, once the pool has none left the
+	// kernel takes the page from the copy, which dies of SIGBUS and loses the save
+	if (hugePages == HUGE_PAGES_EXPLICIT && g_config.getBoolean(ConfigManager::FORK_SAVE)) {
+		std::cout << "> Warning: explicit hugePages cannot be used with forkSave, transparent huge pages are used instead." << std::endl;
+		hugePages = HUGE_PAGES_TRANSPARENT;
+	}
+	numaNode = g_config.getNumber(ConfigManager::NUMA_NODE);
+	if (numaNode < 0) {
+		numaNode = affinity::getNode("dispatcher");
+	}
+
+	if (numaNode >= static_cast<int32_t>(sizeof(unsigned long) * 8)) {
+		std::cout << "> Warning: numaNode " << numaNode << " is out of range, the pool memory is not placed on a node." << std::endl;
+		numaNode = -1;
+	}
+
+#ifdef __linux__
+	enabled.store(hugePages != HUGE_PAGES_NONE || numaNode >= 0, std::memory_order_relaxed);
+#else
+	if (hugePages != HUGE_PAGES_NONE || g_config.getNumber(ConfigManager::NUMA_NODE) >= 0) {
+		std::cout << "> Warning: hugePages and numaNode are only supported on Linux, the pools use the heap." << std::endl;
+	}
+#endif
+}
+
+bool isEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void* allocate(size_t size)
+{
+	if (!isEnabled() || size > MAX_CHUNK_SIZE) {
+		return nullptr;
+	}
+
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	if (static_cast<size_t>(slice.end - slice.next) < size) {
+		std::lock_guard<std::mutex> lockClass(regionLock);
+		if (regionNext == regionEnd) {
+			char* region = mapRegion();
+			if (!region) {
+				return nullptr;
+			}
+
+			regions.emplace_back(region, region + REGION_SIZE);
+			regionNext = region;
+			regionEnd = region + REGION_SIZE;
+		}
+
+		// what is left of the old slice stays unused
+		slice.next = regionNext;
+		slice.end = regionNext + SLICE_SIZE;
+		regionNext += SLICE_SIZE;
+	}
+
+	void* p = slice.next;
+	slice.next += size;
+	return p;
+}
+
+bool contains(const void* p)
+{
+	if (!isEnabled()) {
+		return false;
+	}
+
+	const char* address = static_cast<const char*>(p);
+	std::lock_guard<std::mutex> lockClass(regionLock);
+	return std::any_of(regions.begin(), regions.end(), [address](const auto& region) {
+		return address >= region.first && address < region.second;
+	});
+}
+
+} // namespace arena
@@ -0,0 +1,33 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Large regions the object pools of lockfree.h carve their chunks from once hugePages or numaNode
+ * is set: the map's tiles and floors, the items, the monsters and the network messages. The
+ * regions are backed by transparent or explicit huge pages, so walking the map takes a fraction of
+ * the TLB entries it would with 4 KB pages, and are bound to the memory of one numa node. A region
+ * is never given back to the system, its chunks are recycled by the pools. Linux only, elsewhere
+ * the pools keep using the heap. Any thread.
+ */
+enum HugePages_t : uint8_t {
+	HUGE_PAGES_NONE = 0,
+	HUGE_PAGES_TRANSPARENT = 1,
+	HUGE_PAGES_EXPLICIT = 2,
+};
+
+namespace arena {
+
+// reads hugePages and numaNode, a numaNode of -1 is the node of the cores the dispatcher is pinned to
+void load();
+
+bool isEnabled();
+
+// a chunk of size bytes aligned for any object, nullptr while disabled or once no region can be mapped
+void* allocate(size_t size);
+
+// whether p was handed out by allocate
+bool contains(const void* p);
+
+} // namespace arena
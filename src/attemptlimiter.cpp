@@ -0,0 +1,106 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "attemptlimiter.h"
+#include "tools.h"
+
+bool AttemptLimiter::registerAttempt(uint32_t key, uint32_t maxAttempts, int64_t lockDuration)
+{
+	const int64_t now = OTSYS_TIME();
+
+	Shard& shard = getShard(key);
+	std::lock_guard<std::mutex> lockClass(shard.lock);
+
+	auto& bucket = getBucket(shard, key);
+	return addAttempt(bucket, findEntry(bucket, key, now), key, maxAttempts, lockDuration, now);
+}
+
+bool AttemptLimiter::tryAttempt(uint32_t key, uint32_t maxAttempts, int64_t lockDuration)
+{
+	const int64_t now = OTSYS_TIME();
+
+	Shard& shard = getShard(key);
+	std::lock_guard<std::mutex> lockClass(shard.lock);
+
+	auto& bucket = getBucket(shard, key);
+	Entry* entry = findEntry(bucket, key, now);
+	if (entry && entry->lockedUntil != 0) {
+		if (entry->lockedUntil > now) {
+			return false;
+		}
+
+		// lock is over, attempts start again from zero
+		entry->attempts = 0;
+		entry->lockedUntil = 0;
+	}
+
+	addAttempt(bucket, entry, key, maxAttempts, lockDuration, now);
+	return true;
+}
+
+bool AttemptLimiter::addAttempt(std::array<Entry, ENTRIES_PER_BUCKET>& bucket, Entry* entry, uint32_t key, uint32_t maxAttempts, int64_t lockDuration, int64_t now)
+{
+	if (!entry) {
+		// free or expired entries first, then unlocked ones, then the one expiring the soonest
+		entry = &*std::min_element(bucket.begin(), bucket.end(), [now](const Entry& lhs, const Entry& rhs) {
+			return std::make_tuple(lhs.expiresAt > now, lhs.lockedUntil > now, lhs.expiresAt) <
+			       std::make_tuple(rhs.expiresAt > now, rhs.lockedUntil > now, rhs.expiresAt);
+		});
+
+		entry->key = key;
+		entry->attempts = 0;
+		entry->lockedUntil = 0;
+	}
+
+	if (++entry->attempts >= maxAttempts) {
+		entry->lockedUntil = now + lockDuration;
+	}
+	entry->expiresAt = std::max(now + lockDuration, entry->lockedUntil);
+	return entry->lockedUntil > now;
+}
+
+bool AttemptLimiter::isLocked(uint32_t key)
+{
+	const int64_t now = OTSYS_TIME();
+
+	Shard& shard = getShard(key);
+	std::lock_guard<std::mutex> lockClass(shard.lock);
+
+	Entry* entry = findEntry(getBucket(shard, key), key, now);
+	if (!entry || entry->lockedUntil == 0) {
+		return false;
+	}
+
+	if (entry->lockedUntil <= now) {
+		// lock is over, attempts start again from zero
+		entry->attempts = 0;
+		entry->lockedUntil = 0;
+		return false;
+	}
+	return true;
+}
+
+void AttemptLimiter::reset(uint32_t key, bool force)
+{
+	const int64_t now = OTSYS_TIME();
+
+	Shard& shard = getShard(key);
+	std::lock_guard<std::mutex> lockClass(shard.lock);
+
+	Entry* entry = findEntry(getBucket(shard, key), key, now);
+	if (entry && (force || entry->lockedUntil <= now)) {
+		*entry = {};
+	}
+}
+
+AttemptLimiter::Entry* AttemptLimiter::findEntry(std::array<Entry, ENTRIES_PER_BUCKET>& bucket, uint32_t key, int64_t now)
+{
+	for (Entry& entry : bucket) {
+		if (entry.key == key && entry.expiresAt > now) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,60 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Counts attempts per key (account number, ip) and locks the key once a limit is reached.
+ * The table has a fixed size and is split in shards with a lock each, so the network threads
+ * can check and register attempts without waiting on one another or on the dispatcher.
+ * Entries expire on their own once the lock is over and no attempt was made for a lock duration,
+ * and when a bucket is full the entry that expires the soonest is replaced.
+ */
+class AttemptLimiter
+{
+	public:
+		// returns true if the key is locked after this attempt
+		bool registerAttempt(uint32_t key, uint32_t maxAttempts, int64_t lockDuration);
+		bool isLocked(uint32_t key);
+		// isLocked and registerAttempt as one step: returns false if the key is locked, otherwise
+		// registers the attempt and returns true
+		bool tryAttempt(uint32_t key, uint32_t maxAttempts, int64_t lockDuration);
+		// an active lock is kept unless force is set
+		void reset(uint32_t key, bool force);
+
+	private:
+		static constexpr size_t SHARDS = 16;
+		static constexpr size_t BUCKETS_PER_SHARD = 64;
+		static constexpr size_t ENTRIES_PER_BUCKET = 4;
+
+		struct Entry {
+			uint32_t key = 0;
+			uint32_t attempts = 0;
+			int64_t lockedUntil = 0;
+			// 0 for free entries
+			int64_t expiresAt = 0;
+		};
+
+		struct Shard {
+			std::mutex lock;
+			std::array<std::array<Entry, ENTRIES_PER_BUCKET>, BUCKETS_PER_SHARD> buckets;
+		};
+
+		static size_t hash(uint32_t key) {
+			// spread consecutive keys over the shards and buckets
+			return static_cast<size_t>((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+		}
+
+		Shard& getShard(uint32_t key) {
+			return shards[hash(key) % SHARDS];
+		}
+		static std::array<Entry, ENTRIES_PER_BUCKET>& getBucket(Shard& shard, uint32_t key) {
+			return shard.buckets[(hash(key) / SHARDS) % BUCKETS_PER_SHARD];
+		}
+
+		static Entry* findEntry(std::array<Entry, ENTRIES_PER_BUCKET>& bucket, uint32_t key, int64_t now);
+		// shard lock held, entry is the one findEntry returned
+		static bool addAttempt(std::array<Entry, ENTRIES_PER_BUCKET>& bucket, Entry* entry, uint32_t key, uint32_t maxAttempts, int64_t lockDuration, int64_t now);
+
+		std::array<Shard, SHARDS> shards;
+};
@@ -4,12 +4,100 @@
 #include "otpch.h"
 
 #include "ban.h"
+#include "configmanager.h"
 #include "database.h"
 #include "databasetasks.h"
+#include "scheduler.h"
 #include "tools.h"
 
 #include <fmt/format.h>
 
+extern ConfigManager g_config;
+
+namespace {
+
+struct BanCache {
+	std::unordered_map<uint32_t, BanInfo> accounts;
+	std::unordered_map<uint32_t, BanInfo> ips;
+	std::unordered_set<uint32_t> namelocks;
+};
+
+std::mutex banCacheLock;
+BanCache banCache;
+
+// bans added by the server whose row may not be inserted yet when a reload reads the tables,
+// they stay until a reload queued after their insert has run
+struct AddedBan {
+	BanInfo banInfo;
+	uint64_t sequence;
+};
+std::unordered_map<uint32_t, AddedBan> addedAccountBans;
+uint64_t addedBanSequence = 0;
+
+bool hasExpired(time_t expiresAt, time_t now)
+{
+	return expiresAt != 0 && now > expiresAt;
+}
+
+BanInfo readBan(const DBResult_ptr& result)
+{
+	BanInfo banInfo;
+	banInfo.reason = result->getString("reason");
+	banInfo.expiresAt = result->getNumber<time_t>("expires_at");
+	// a ban given by the server, or by a player that was deleted since
+	banInfo.bannedBy = result->getString("name");
+	if (banInfo.bannedBy.empty()) {
+		banInfo.bannedBy = "Server";
+	}
+	return banInfo;
+}
+
+// reads the active bans, the expired ones are moved to the history on the way
+bool readBans(Database& db, BanCache& bans)
+{
+	const time_t now = time(nullptr);
+
+	// an empty result and a lost connection look the same, a reload must not lift every ban
+	if (!db.storeQuery("SELECT 1")) {
+		return false;
+	}
+
+	DBResult_ptr result;
+	if ((result = db.storeQuery("SELECT `b`.`account_id`, `b`.`reason`, `b`.`banned_at`, `b`.`expires_at`, `b`.`banned_by`, `p`.`name` FROM `account_bans` AS `b` LEFT JOIN `players` AS `p` ON `p`.`id` = `b`.`banned_by`"))) {
+		do {
+			const uint32_t accountId = result->getNumber<uint32_t>("account_id");
+			BanInfo banInfo = readBan(result);
+			if (hasExpired(banInfo.expiresAt, now)) {
+				db.executeQuery(fmt::format("INSERT INTO `account_ban_history` (`account_id`, `reason`, `banned_at`, `expired_at`, `banned_by`) VALUES ({:d}, {:s}, {:d}, {:d}, {:d})", accountId, db.escapeString(banInfo.reason), result->getNumber<time_t>("banned_at"), banInfo.expiresAt, result->getNumber<uint32_t>("banned_by")));
+				db.executeQuery(fmt::format("DELETE FROM `account_bans` WHERE `account_id` = {:d}", accountId));
+				continue;
+			}
+			bans.accounts.emplace(accountId, std::move(banInfo));
+		} while (result->next());
+	}
+
+	if ((result = db.storeQuery("SELECT `b`.`ip`, `b`.`reason`, `b`.`expires_at`, `p`.`name` FROM `ip_bans` AS `b` LEFT JOIN `players` AS `p` ON `p`.`id` = `b`.`banned_by`"))) {
+		do {
+			const uint32_t ip = result->getNumber<uint32_t>("ip");
+			BanInfo banInfo = readBan(result);
+			if (hasExpired(banInfo.expiresAt, now)) {
+				db.executeQuery(fmt::format("DELETE FROM `ip_bans` WHERE `ip` = {:d}", ip));
+				continue;
+			}
+			bans.ips.emplace(ip, std::move(banInfo));
+		} while (result->next());
+	}
+
+	if ((result = db.storeQuery("SELECT `player_id` FROM `player_namelocks`"))) {
+		do {
+			bans.namelocks.insert(result->getNumber<uint32_t>("player_id"));
+		} while (result->next());
+	}
+	return true;
+}
+
+}
+
 bool Ban::acceptConnection(uint32_t clientIP)
 {
 	std::lock_guard<std::recursive_mutex> lockClass(lock);
@@ -46,32 +134,19 @@ bool Ban::acceptConnection(uint32_t clientIP)
 
 bool IOBan::isAccountBanned(uint32_t accountId, BanInfo& banInfo)
 {
-	Database& db = Database::getInstance();
-
-	DBResult_ptr accountBanResult = db.storeQuery(fmt::format("SELECT `reason`, `expires_at`, `banned_at`, `banned_by` FROM `account_bans` WHERE `account_id` = {:d}", accountId));
-	if (!accountBanResult) {
+	std::lock_guard<std::mutex> lockClass(banCacheLock);
+	auto it = banCache.accounts.find(accountId);
+	if (it == banCache.accounts.end()) {
 		return false;
 	}
 
-	DBResult_ptr responsibleResult = db.storeQuery(fmt::format("SELECT `name` FROM `players` WHERE `id` = {:d}", accountBanResult->getNumber<uint32_t>("banned_by")));
-
-	int64_t expiresAt = accountBanResult->getNumber<int64_t>("expires_at");
-	if (expiresAt != 0 && time(nullptr) > expiresAt) {
-		// Move the ban to history if it has expired
-		g_databaseTasks.addTask(fmt::format("INSERT INTO `account_ban_history` (`account_id`, `reason`, `banned_at`, `expired_at`, `banned_by`) VALUES ({:d}, {:s}, {:d}, {:d}, {:d})", accountId, db.escapeString(accountBanResult->getString("reason")), accountBanResult->getNumber<time_t>("banned_at"), expiresAt, accountBanResult->getNumber<uint32_t>("banned_by")));
-		g_databaseTasks.addTask(fmt::format("DELETE FROM `account_bans` WHERE `account_id` = {:d}", accountId));
+	// the next reload moves it to the history
+	if (hasExpired(it->second.expiresAt, time(nullptr))) {
+		banCache.accounts.erase(it);
 		return false;
 	}
 
-	banInfo.expiresAt = expiresAt;
-	banInfo.reason = accountBanResult->getString("reason");
-
-	if (responsibleResult) {
-		banInfo.bannedBy = responsibleResult->getString("name");
-	} else {
-		banInfo.bannedBy = "Server";
-	}
-
+	banInfo = it->second;
 	return true;
 }
 
@@ -81,33 +156,83 @@ bool IOBan::isIpBanned(uint32_t clientIP, BanInfo& banInfo)
 		return false;
 	}
 
-	Database& db = Database::getInstance();
+	std::lock_guard<std::mutex> lockClass(banCacheLock);
+	auto it = banCache.ips.find(clientIP);
+	if (it == banCache.ips.end()) {
+		return false;
+	}
 
-	DBResult_ptr ipBanResult = db.storeQuery(fmt::format("SELECT `reason`, `expires_at`, `banned_by` FROM `ip_bans` WHERE `ip` = {:d}", clientIP));
-	if (!ipBanResult) {
+	if (hasExpired(it->second.expiresAt, time(nullptr))) {
+		banCache.ips.erase(it);
 		return false;
 	}
 
-	DBResult_ptr responsibleResult = db.storeQuery(fmt::format("SELECT `name` FROM `players` WHERE `id` = {:d}", ipBanResult->getNumber<uint32_t>("banned_by")));
+	banInfo = it->second;
+	return true;
+}
+
+bool IOBan::isPlayerNamelocked(uint32_t playerId)
+{
+	std::lock_guard<std::mutex> lockClass(banCacheLock);
+	return banCache.namelocks.contains(playerId);
+}
 
-	int64_t expiresAt = ipBanResult->getNumber<int64_t>("expires_at");
-	if (expiresAt != 0 && time(nullptr) > expiresAt) {
-		g_databaseTasks.addTask(fmt::format("DELETE FROM `ip_bans` WHERE `ip` = {:d}", clientIP));
+bool IOBan::loadBans()
+{
+	BanCache bans;
+	if (!readBans(Database::getInstance(), bans)) {
 		return false;
 	}
 
-	banInfo.expiresAt = expiresAt;
-	banInfo.reason = ipBanResult->getString("reason");
-	if (responsibleResult) {
-		banInfo.bannedBy = responsibleResult->getString("name");
-	} else {
-		banInfo.bannedBy = "Server";
+	std::lock_guard<std::mutex> lockClass(banCacheLock);
+	banCache = std::move(bans);
+	return true;
+}
+
+void IOBan::reloadBans()
+{
+	uint64_t sequence;
+	{
+		std::lock_guard<std::mutex> lockClass(banCacheLock);
+		sequence = addedBanSequence;
 	}
 
-	return true;
+	g_databaseTasks.addTask([sequence](Database& db) {
+		BanCache bans;
+		if (!readBans(db, bans)) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lockClass(banCacheLock);
+		for (auto it = addedAccountBans.begin(); it != addedAccountBans.end();) {
+			if (it->second.sequence <= sequence) {
+				// inserted before this reload was queued, the tables had it
+				it = addedAccountBans.erase(it);
+			} else {
+				bans.accounts.insert_or_assign(it->first, it->second.banInfo);
+				++it;
+			}
+		}
+		banCache = std::move(bans);
+	});
 }
 
-bool IOBan::isPlayerNamelocked(uint32_t playerId)
+void IOBan::scheduleReload()
+{
+	const int64_t interval = g_config.getNumber(ConfigManager::BAN_REFRESH_INTERVAL);
+	if (interval <= 0) {
+		return;
+	}
+
+	g_scheduler.addEvent(createSchedulerTask(static_cast<uint32_t>(interval * 1000), []() {
+		reloadBans();
+		scheduleReload();
+	}));
+}
+
+void IOBan::addAccountBan(uint32_t accountId, const BanInfo& banInfo)
 {
-	return Database::getInstance().storeQuery(fmt::format("SELECT 1 FROM `player_namelocks` WHERE `player_id` = {:d}", playerId)).get() != nullptr;
+	std::lock_guard<std::mutex> lockClass(banCacheLock);
+	banCache.accounts.insert_or_assign(accountId, banInfo);
+	addedAccountBans.insert_or_assign(accountId, AddedBan{banInfo, ++addedBanSequence});
 }
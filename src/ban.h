@@ -30,10 +30,26 @@ class Ban
 		std::recursive_mutex lock;
 };
 
+/*
+ * The account bans, IP bans and namelocks are held in memory, a login does not query the database.
+ * They are loaded at startup and read again every banRefreshInterval seconds on the database thread,
+ * which also moves the expired bans to the history. Scripts that change the tables call reloadBans.
+ */
 class IOBan
 {
 	public:
 		static bool isAccountBanned(uint32_t accountId, BanInfo& banInfo);
 		static bool isIpBanned(uint32_t clientIP, BanInfo& banInfo);
 		static bool isPlayerNamelocked(uint32_t playerId);
+
+		// reads the bans on the calling thread, before the database thread runs
+		static bool loadBans();
+		// reads the bans again after the queries queued on the database thread so far
+		static void reloadBans();
+		// reloads the bans every banRefreshInterval seconds
+		static void scheduleReload();
+
+		// for a ban whose row is inserted by the server itself, on the dispatcher right before the insert
+		// is queued, it is kept across the reloads that could miss the row
+		static void addAccountBan(uint32_t accountId, const BanInfo& banInfo);
 };
@@ -6,6 +6,7 @@
 #include "bed.h"
 #include "game.h"
 #include "iologindata.h"
+#include "iomap.h"
 #include "scheduler.h"
 
 #include <fmt/format.h>
@@ -25,7 +26,9 @@ Attr_ReadValue BedItem::readAttr(AttrTypes_t attr, PropStream& propStream)
 				std::string name = IOLoginData::getNameByGuid(guid);
 				if (!name.empty()) {
 					setSpecialDescription(name + " is sleeping there.");
-					g_game.setBedSleeper(this, guid);
+					if (!deferGameRegistration) {
+						g_game.setBedSleeper(this, guid);
+					}
 					sleeperGUID = guid;
 				}
 			}
@@ -38,7 +41,7 @@ Attr_ReadValue BedItem::readAttr(AttrTypes_t attr, PropStream& propStream)
 				return ATTR_READ_ERROR;
 			}
 
-			sleepStart = static_cast<uint64_t>(sleep_start);
+			sleepStart = static_cast<time_t>(sleep_start);
 			return ATTR_READ_CONTINUE;
 		}
 
@@ -158,12 +161,14 @@ bool BedItem::sleep(Player* player)
 	g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&Game::kickPlayer, &g_game, playerId, false)));
 
 	// change self and partner's appearance
-	updateAppearance(player);
+	setOccupiedAppearance(player->getSex());
 
 	if (BedItem* nextBedItem = getNextBedItem()) {
-		nextBedItem->updateAppearance(player);
+		nextBedItem->setOccupiedAppearance(player->getSex());
 	}
 
+	// the sleeper sex is read from the appearance
+	IOMap::saveBedSleepers();
 	return true;
 }
 
@@ -181,7 +186,10 @@ void BedItem::wakeUp(Player* player)
 	}
 
 	// update the bedSleepersMap
-	g_game.removeBedSleeper(sleeperGUID);
+	if (sleeperGUID != 0) {
+		g_game.removeBedSleeper(sleeperGUID);
+		IOMap::saveBedSleepers();
+	}
 
 	BedItem* nextBedItem = getNextBedItem();
 
@@ -193,15 +201,40 @@ void BedItem::wakeUp(Player* player)
 	}
 
 	// change self and partner's appearance
-	updateAppearance(nullptr);
+	setFreeAppearance();
 
 	if (nextBedItem) {
-		nextBedItem->updateAppearance(nullptr);
+		nextBedItem->setFreeAppearance();
+	}
+}
+
+void BedItem::restoreSleeper(uint32_t guid, const std::string& name, PlayerSex_t sex, time_t start)
+{
+	sleeperGUID = guid;
+	sleepStart = start;
+	setSpecialDescription(name + " is sleeping there.");
+	g_game.setBedSleeper(this, guid);
+
+	setOccupiedAppearance(sex);
+
+	if (BedItem* nextBedItem = getNextBedItem()) {
+		nextBedItem->setOccupiedAppearance(sex);
 	}
 }
 
+PlayerSex_t BedItem::getSleeperSex() const
+{
+	const ItemType& freeType = Item::items[Item::items[id].transformToFree];
+	return freeType.transformToOnUse[PLAYERSEX_MALE] == id ? PLAYERSEX_MALE : PLAYERSEX_FEMALE;
+}
+
 void BedItem::regeneratePlayer(Player* player) const
 {
+	// sleepers read from house files written before the beds file have no start
+	if (sleepStart == 0) {
+		return;
+	}
+
 	const uint32_t sleptTime = time(nullptr) - sleepStart;
 
 	if (sleptTime < 60) {
@@ -237,20 +270,28 @@ void BedItem::regeneratePlayer(Player* player) const
 
 }
 
-void BedItem::updateAppearance(const Player* player)
+void BedItem::setOccupiedAppearance(PlayerSex_t sex)
 {
 	const ItemType& it = Item::items[id];
 	if (it.type == ITEM_TYPE_BED) {
-		if (player && it.transformToOnUse[player->getSex()] != 0) {
-			const ItemType& newType = Item::items[it.transformToOnUse[player->getSex()]];
+		if (it.transformToOnUse[sex] != 0) {
+			const ItemType& newType = Item::items[it.transformToOnUse[sex]];
 			if (newType.type == ITEM_TYPE_BED) {
-				g_game.transformItem(this, it.transformToOnUse[player->getSex()]);
-			}
-		} else if (it.transformToFree != 0) {
-			const ItemType& newType = Item::items[it.transformToFree];
-			if (newType.type == ITEM_TYPE_BED) {
-				g_game.transformItem(this, it.transformToFree);
+				g_game.transformItem(this, it.transformToOnUse[sex]);
 			}
+		} else {
+			setFreeAppearance();
+		}
+	}
+}
+
+void BedItem::setFreeAppearance()
+{
+	const ItemType& it = Item::items[id];
+	if (it.type == ITEM_TYPE_BED && it.transformToFree != 0) {
+		const ItemType& newType = Item::items[it.transformToFree];
+		if (newType.type == ITEM_TYPE_BED) {
+			g_game.transformItem(this, it.transformToFree);
 		}
 	}
 }
@@ -29,6 +29,11 @@ class BedItem final : public Item
 		uint32_t getSleeper() const {
 			return sleeperGUID;
 		}
+		time_t getSleepStart() const {
+			return sleepStart;
+		}
+		// derived from the occupied appearance, only valid while someone sleeps in the bed
+		PlayerSex_t getSleeperSex() const;
 
 		House* getHouse() const {
 			return house;
@@ -42,17 +47,20 @@ class BedItem final : public Item
 		bool trySleep(Player* player);
 		bool sleep(Player* player);
 		void wakeUp(Player* player);
+		// puts back a sleeper read from the beds file at startup
+		void restoreSleeper(uint32_t guid, const std::string& name, PlayerSex_t sex, time_t start);
 
 		BedItem* getNextBedItem() const;
 
 	protected:
-		void updateAppearance(const Player* player);
+		void setOccupiedAppearance(PlayerSex_t sex);
+		void setFreeAppearance();
 		void regeneratePlayer(Player* player) const;
 		void internalSetSleeper(const Player* player);
 		void internalRemoveSleeper();
 
 		House* house = nullptr;
-		uint64_t sleepStart = 0;
+		time_t sleepStart = 0;
 		uint32_t sleeperGUID = 0;
 
 		friend class Item;
@@ -0,0 +1,54 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "cast.h"
+#include "tools.h"
+
+void Cast::publish(const uint8_t* bytes, size_t length)
+{
+	auto chunk = std::make_shared<const std::string>(reinterpret_cast<const char*>(bytes), length);
+
+	std::lock_guard<std::mutex> lockClass(chunkLock);
+	chunks.push_back(std::move(chunk));
+	this->bytes += length;
+
+	while (this->bytes > CAST_MAX_BYTES && chunks.size() > 1) {
+		this->bytes -= chunks.front()->size();
+		chunks.pop_front();
+		++firstSequence;
+	}
+}
+
+void Cast::startCatchUp()
+{
+	std::lock_guard<std::mutex> lockClass(chunkLock);
+	catchUpSequence = firstSequence + chunks.size();
+	catchUpTime = OTSYS_TIME();
+}
+
+bool Cast::getCatchUp(uint64_t& sequence) const
+{
+	std::lock_guard<std::mutex> lockClass(chunkLock);
+	if (catchUpTime == 0 || catchUpSequence < firstSequence || OTSYS_TIME() - catchUpTime > CAST_CATCHUP_REUSE) {
+		return false;
+	}
+
+	sequence = catchUpSequence;
+	return true;
+}
+
+bool Cast::read(uint64_t& sequence, std::vector<Chunk>& messages) const
+{
+	std::lock_guard<std::mutex> lockClass(chunkLock);
+	if (sequence < firstSequence) {
+		return false;
+	}
+
+	for (size_t i = sequence - firstSequence; i < chunks.size(); ++i) {
+		messages.push_back(chunks[i]);
+	}
+	sequence = firstSequence + chunks.size();
+	return true;
+}
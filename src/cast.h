@@ -0,0 +1,74 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <deque>
+
+static constexpr int32_t CAST_POLL_INTERVAL = 50;
+// viewers joining within this time of a catch-up start at it instead of redrawing the player's screen again
+static constexpr int64_t CAST_CATCHUP_REUSE = 5000;
+static constexpr size_t CAST_MAX_BYTES = 8 * 1024 * 1024;
+
+/*
+ * The messages the client of a casting player is sent, kept for the clients watching it. The dispatcher
+ * adds each message once, as it goes out to the player, and every viewer copies it from its network
+ * thread at its own pace: after joining, a viewer costs the game nothing. A viewer starts at a catch-up,
+ * a redraw of the player's screen, and is dropped once it falls behind the oldest message kept.
+ */
+class Cast
+{
+	public:
+		using Chunk = std::shared_ptr<const std::string>;
+
+		explicit Cast(std::string password) : password(std::move(password)) {}
+
+		// non-copyable
+		Cast(const Cast&) = delete;
+		Cast& operator=(const Cast&) = delete;
+
+		// dispatcher thread
+		void publish(const uint8_t* bytes, size_t length);
+		// dispatcher thread, the next message published begins a catch-up
+		void startCatchUp();
+		// dispatcher thread, where a joining viewer starts; false if there is no recent catch-up to start at
+		bool getCatchUp(uint64_t& sequence) const;
+		// dispatcher thread, the viewers are dropped once they read what was published so far
+		void close() {
+			closed.store(true, std::memory_order_release);
+		}
+
+		// any thread: the messages from sequence on, sequence moves past them; false once they are gone
+		bool read(uint64_t& sequence, std::vector<Chunk>& messages) const;
+		bool isClosed() const {
+			return closed.load(std::memory_order_acquire);
+		}
+
+		const std::string& getPassword() const {
+			return password;
+		}
+
+		void addViewer() {
+			viewers.fetch_add(1, std::memory_order_relaxed);
+		}
+		void removeViewer() {
+			viewers.fetch_sub(1, std::memory_order_relaxed);
+		}
+		uint32_t getViewers() const {
+			return viewers.load(std::memory_order_relaxed);
+		}
+
+	private:
+		mutable std::mutex chunkLock;
+		std::deque<Chunk> chunks;
+		// sequence of chunks.front()
+		uint64_t firstSequence = 0;
+		size_t bytes = 0;
+
+		uint64_t catchUpSequence = 0;
+		int64_t catchUpTime = 0;
+
+		std::atomic<uint32_t> viewers{0};
+		std::atomic<bool> closed{false};
+		const std::string password;
+};
@@ -104,8 +104,12 @@ bool ChatChannel::talk(const Player& fromPlayer, SpeakClasses type, const std::s
 
 	uint32_t statementId = g_game.recordStatement(fromPlayer.getGUID(), type, getId(), text);
 
+	// the message is the same for every user, so it is serialized once
+	NetworkMessage msg;
+	ProtocolGame::AddChannelMessage(msg, statementId, &fromPlayer, type, text, id);
+
 	for (const auto& it : users) {
-		it.second->sendToChannel(statementId, &fromPlayer, type, text, id);
+		it.second->sendNetworkMessage(msg);
 		g_game.recordListener(statementId, it.second->getGUID());
 	}
 	return true;
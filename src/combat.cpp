@@ -9,6 +9,8 @@
 #include "weapons.h"
 #include "configmanager.h"
 #include "events.h"
+#include "purefunctions.h"
+#include "profiler.h"
 
 extern Game g_game;
 extern Weapons* g_weapons;
@@ -50,49 +52,67 @@ MatrixArea createArea(const std::vector<uint32_t>& vec, uint32_t rows)
 	return area;
 }
 
-std::vector<Tile*> getList(const MatrixArea& area, const Position& targetPos, const Direction dir)
+// tile lists are reused between casts, a cast started from a script callback of another cast takes its own list
+class AreaTileList
 {
-	auto casterPos = getNextPosition(dir, targetPos);
+	public:
+		AreaTileList() {
+			if (!freeLists.empty()) {
+				tiles = std::move(freeLists.back());
+				freeLists.pop_back();
+			}
+		}
+		~AreaTileList() {
+			tiles.clear();
+			freeLists.push_back(std::move(tiles));
+		}
 
-	std::vector<Tile*> vec;
+		// non-copyable
+		AreaTileList(const AreaTileList&) = delete;
+		AreaTileList& operator=(const AreaTileList&) = delete;
 
-	auto center = area.getCenter();
+		std::vector<Tile*> tiles;
 
-	Position tmpPos(targetPos.x - center.first, targetPos.y - center.second, targetPos.z);
-	for (uint32_t row = 0; row < area.getRows(); ++row, ++tmpPos.y) {
-		for (uint32_t col = 0; col < area.getCols(); ++col, ++tmpPos.x) {
-			if (area(row, col)) {
-				if (g_game.canThrowObjectTo(casterPos, tmpPos, false)) {
-					Tile* tile = g_game.map.getTile(tmpPos);
-					if (!tile) {
-						tile = new Tile(tmpPos.x, tmpPos.y, tmpPos.z);
-						g_game.map.setTile(tmpPos, tile);
-					}
-					vec.push_back(tile);
-				}
-			}
+	private:
+		static thread_local std::vector<std::vector<Tile*>> freeLists;
+};
+
+thread_local std::vector<std::vector<Tile*>> AreaTileList::freeLists;
+
+Tile* getOrCreateTile(const Position& pos)
+{
+	Tile* tile = g_game.map.getTile(pos);
+	if (!tile) {
+		tile = new Tile(pos.x, pos.y, pos.z);
+		g_game.map.setTile(pos, tile);
+	}
+	return tile;
+}
+
+void getList(const AreaCombat::Offsets& offsets, const Position& targetPos, const Direction dir, std::vector<Tile*>& tiles)
+{
+	auto casterPos = getNextPosition(dir, targetPos);
+
+	for (const auto& offset : offsets) {
+		Position tmpPos(targetPos.x + offset.first, targetPos.y + offset.second, targetPos.z);
+		if (g_game.canThrowObjectTo(casterPos, tmpPos, false)) {
+			tiles.push_back(getOrCreateTile(tmpPos));
 		}
-		tmpPos.x -= area.getCols();
 	}
-	return vec;
 }
 
-std::vector<Tile*> getCombatArea(const Position& centerPos, const Position& targetPos, const AreaCombat* area)
+void getCombatArea(const Position& centerPos, const Position& targetPos, const AreaCombat* area, std::vector<Tile*>& tiles)
 {
 	if (targetPos.z >= MAP_MAX_LAYERS) {
-		return {};
+		return;
 	}
 
 	if (area) {
-		return getList(area->getArea(centerPos, targetPos), targetPos, getDirectionTo(targetPos, centerPos));
+		getList(area->getOffsets(centerPos, targetPos), targetPos, getDirectionTo(targetPos, centerPos), tiles);
+		return;
 	}
 
-	Tile* tile = g_game.map.getTile(targetPos);
-	if (!tile) {
-		tile = new Tile(targetPos.x, targetPos.y, targetPos.z);
-		g_game.map.setTile(targetPos, tile);
-	}
-	return {tile};
+	tiles.push_back(getOrCreateTile(targetPos));
 }
 
 }
@@ -117,6 +137,22 @@ CombatDamage Combat::getCombatDamage(Creature* creature, Creature* target) const
 			} else if (formulaType == COMBAT_FORMULA_LEVELMAGIC) {
 				int32_t levelFormula = player->getLevel() * 2 + player->getMagicLevel() * 3;
 				damage.value = random(std::fma(levelFormula, mina, minb), std::fma(levelFormula, maxa, maxb));
+			} else if (formulaType == COMBAT_FORMULA_BASEDAMAGE || formulaType == COMBAT_FORMULA_BASESKILL) {
+				// mina and maxa are the least and most damage, minb and maxb bound the level formula, 0 leaves it open
+				double formula = 3 * player->getMagicLevel() + 2 * player->getLevel();
+				if (formula < minb) {
+					formula = minb;
+				} else if (maxb != 0 && formula > maxb) {
+					formula = maxb;
+				}
+
+				double min = formula * mina / 100;
+				double max = formula * maxa / 100;
+				if (formulaType == COMBAT_FORMULA_BASESKILL) {
+					min = min * player->getLevel() / 25;
+					max = max * player->getLevel() / 25;
+				}
+				damage.value = random(static_cast<int32_t>(min), static_cast<int32_t>(max));
 			} else if (formulaType == COMBAT_FORMULA_SKILL) {
 				Item* tool = player->getWeapon();
 				const Weapon* weapon = g_weapons->getWeapon(tool);
@@ -730,7 +766,13 @@ void Combat::doCombat(Creature* caster, const Position& position, bool angleSpel
 		CombatDamage damage = getCombatDamage(caster, nullptr);
 		doAreaCombat(caster, position, area.get(), damage, params, angleSpell);
 	} else {
-		auto tiles = angleSpell && caster ? getCombatArea(caster->getPosition(), position, area.get()) : getCombatArea(position, position, area.get());
+		AreaTileList tileList;
+		std::vector<Tile*>& tiles = tileList.tiles;
+		if (angleSpell && caster) {
+			getCombatArea(caster->getPosition(), position, area.get(), tiles);
+		} else {
+			getCombatArea(position, position, area.get(), tiles);
+		}
 
 		SpectatorVec spectators;
 		uint32_t maxX = 0;
@@ -938,7 +980,14 @@ void Combat::doTargetCombat(Creature* caster, Creature* target, CombatDamage& da
 
 void Combat::doAreaCombat(Creature* caster, const Position& position, const AreaCombat* area, CombatDamage& damage, const CombatParams& params, bool angleSpell)
 {
-	auto tiles = caster && angleSpell ? getCombatArea(caster->getPosition(), position, area) : getCombatArea(position, position, area);
+	PROFILE_FUNCTION();
+	AreaTileList tileList;
+	std::vector<Tile*>& tiles = tileList.tiles;
+	if (caster && angleSpell) {
+		getCombatArea(caster->getPosition(), position, area, tiles);
+	} else {
+		getCombatArea(position, position, area, tiles);
+	}
 
 	if (params.noDamage) {
 		damage.value = 0;
@@ -979,6 +1028,9 @@ void Combat::doAreaCombat(Creature* caster, const Position& position, const Area
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, position, true, true, rangeX, rangeX, rangeY, rangeY);
 
+	// the hit effects, damage texts and health updates of every target go out together
+	BroadcastBatch broadcastBatch(spectators);
+
 	postCombatEffects(caster, position, params);
 
 	std::vector<Creature*> toDamageCreatures;
@@ -1034,13 +1086,13 @@ void Combat::doAreaCombat(Creature* caster, const Position& position, const Area
 
 			bool success = false;
 			if (damageCopy.type != COMBAT_MANADRAIN) {
-				if (g_game.combatBlockHit(damageCopy, caster, creature, params.noDamage ? true : params.blockedByShield, params.blockedByArmor, params.itemId != 0, params.ignoreResistances) != BLOCK_NONE) {
+				if (g_game.combatBlockHit(damageCopy, caster, creature, params.noDamage ? true : params.blockedByShield, params.blockedByArmor, params.itemId != 0, params.ignoreResistances, false, &spectators) != BLOCK_NONE) {
 					continue;
 				}
-				success = g_game.combatChangeHealth(caster, creature, damageCopy);
+				success = g_game.combatChangeHealth(caster, creature, damageCopy, &spectators);
 			}
 			else {
-				success = g_game.combatChangeMana(caster, creature, damageCopy);
+				success = g_game.combatChangeMana(caster, creature, damageCopy, &spectators);
 			}
 
 			if (success) {
@@ -1117,31 +1169,14 @@ void Combat::doAreaCombat(Creature* caster, const Position& position, const Area
 void ValueCallback::getMinMaxValues(Player* player, CombatDamage& damage) const
 {
 	//onGetPlayerMinMaxValues(...)
-	if (!scriptInterface->reserveScriptEnv()) {
-		std::cout << "[Error - ValueCallback::getMinMaxValues] Call stack overflow" << std::endl;
-		return;
-	}
-
-	ScriptEnvironment* env = scriptInterface->getScriptEnv();
-	if (!env->setCallbackId(scriptId, scriptInterface)) {
-		scriptInterface->resetScriptEnv();
-		return;
-	}
-
-	lua_State* L = scriptInterface->getLuaState();
-
-	scriptInterface->pushFunction(scriptId);
-
-	LuaScriptInterface::pushUserdata<Player>(L, player);
-	LuaScriptInterface::setMetatable(L, -1, "Player");
-
-	int parameters = 1;
+	std::array<double, 3> values;
+	size_t valueCount;
 	switch (type) {
 		case COMBAT_FORMULA_LEVELMAGIC: {
 			//onGetPlayerMinMaxValues(player, level, maglevel)
-			lua_pushnumber(L, player->getLevel());
-			lua_pushnumber(L, player->getMagicLevel());
-			parameters += 2;
+			values[0] = player->getLevel();
+			values[1] = player->getMagicLevel();
+			valueCount = 2;
 			break;
 		}
 
@@ -1162,20 +1197,58 @@ void ValueCallback::getMinMaxValues(Player* player, CombatDamage& damage) const
 				}
 			}
 
-			lua_pushnumber(L, player->getWeaponSkill(item ? item : tool));
-			lua_pushnumber(L, attackValue);
-			lua_pushnumber(L, player->getAttackFactor());
-			parameters += 3;
+			values[0] = player->getWeaponSkill(item ? item : tool);
+			values[1] = attackValue;
+			values[2] = player->getAttackFactor();
+			valueCount = 3;
 			break;
 		}
 
 		default: {
 			std::cout << "ValueCallback::getMinMaxValues - unknown callback type" << std::endl;
-			scriptInterface->resetScriptEnv();
 			return;
 		}
 	}
 
+	if (pureFunctionId != 0) {
+		// marked pure, runs on a state of its own and gets nil for the player
+		std::array<double, 2> results;
+		bool success;
+		if (valueCount == 2) {
+			success = g_pureFunctions.call(pureFunctionId, {std::nullopt, values[0], values[1]}, results.data(), results.size());
+		} else {
+			success = g_pureFunctions.call(pureFunctionId, {std::nullopt, values[0], values[1], values[2]}, results.data(), results.size());
+		}
+
+		if (success) {
+			damage.value = random(static_cast<int32_t>(results[0]), static_cast<int32_t>(results[1]));
+		}
+		return;
+	}
+
+	if (!scriptInterface->reserveScriptEnv()) {
+		std::cout << "[Error - ValueCallback::getMinMaxValues] Call stack overflow" << std::endl;
+		return;
+	}
+
+	ScriptEnvironment* env = scriptInterface->getScriptEnv();
+	if (!env->setCallbackId(scriptId, scriptInterface)) {
+		scriptInterface->resetScriptEnv();
+		return;
+	}
+
+	lua_State* L = scriptInterface->getLuaState();
+
+	scriptInterface->pushFunction(scriptId);
+
+	LuaScriptInterface::pushUserdata<Player>(L, player);
+	LuaScriptInterface::setMetatable(L, -1, "Player");
+
+	for (size_t i = 0; i < valueCount; ++i) {
+		lua_pushnumber(L, values[i]);
+	}
+
+	int parameters = valueCount + 1;
 	int size0 = lua_gettop(L);
 	if (lua_pcall(L, parameters, 2, 0) != 0) {
 		LuaScriptInterface::reportError(nullptr, LuaScriptInterface::popString(L));
@@ -1319,7 +1392,7 @@ MatrixArea MatrixArea::rotate270() const {
 	return {{center.second, cols - center.first - 1}, cols, rows, std::move(newArr)};
 }
 
-const MatrixArea& AreaCombat::getArea(const Position& centerPos, const Position& targetPos) const {
+Direction AreaCombat::getAreaDirection(const Position& centerPos, const Position& targetPos) const {
 	int32_t dx = Position::getOffsetX(targetPos, centerPos);
 	int32_t dy = Position::getOffsetY(targetPos, centerPos);
 
@@ -1346,6 +1419,11 @@ const MatrixArea& AreaCombat::getArea(const Position& centerPos, const Position&
 		}
 	}
 
+	return dir;
+}
+
+const MatrixArea& AreaCombat::getArea(const Position& centerPos, const Position& targetPos) const {
+	Direction dir = getAreaDirection(centerPos, targetPos);
 	if (dir >= areas.size()) {
 		// this should not happen. it means we forgot to call setupArea.
 		static MatrixArea empty;
@@ -1354,6 +1432,34 @@ const MatrixArea& AreaCombat::getArea(const Position& centerPos, const Position&
 	return areas[dir];
 }
 
+const AreaCombat::Offsets& AreaCombat::getOffsets(const Position& centerPos, const Position& targetPos) const {
+	Direction dir = getAreaDirection(centerPos, targetPos);
+	if (dir >= offsets.size()) {
+		static Offsets empty;
+		return empty;
+	}
+	return offsets[dir];
+}
+
+void AreaCombat::updateOffsets()
+{
+	offsets.resize(areas.size());
+	for (size_t i = 0; i < areas.size(); ++i) {
+		const MatrixArea& area = areas[i];
+		const auto& center = area.getCenter();
+
+		Offsets& areaOffsets = offsets[i];
+		areaOffsets.clear();
+		for (uint32_t row = 0; row < area.getRows(); ++row) {
+			for (uint32_t col = 0; col < area.getCols(); ++col) {
+				if (area(row, col)) {
+					areaOffsets.emplace_back(static_cast<int32_t>(col) - static_cast<int32_t>(center.first), static_cast<int32_t>(row) - static_cast<int32_t>(center.second));
+				}
+			}
+		}
+	}
+}
+
 void AreaCombat::setupArea(const std::vector<uint32_t>& vec, uint32_t rows)
 {
 	auto area = createArea(vec, rows);
@@ -1365,6 +1471,7 @@ void AreaCombat::setupArea(const std::vector<uint32_t>& vec, uint32_t rows)
 	areas[DIRECTION_SOUTH] = area.rotate180();
 	areas[DIRECTION_WEST] = area.rotate270();
 	areas[DIRECTION_NORTH] = std::move(area);
+	updateOffsets();
 }
 
 void AreaCombat::setupArea(int32_t length, int32_t spread)
@@ -1452,6 +1559,7 @@ void AreaCombat::setupExtArea(const std::vector<uint32_t>& vec, uint32_t rows)
 	areas[DIRECTION_SOUTHWEST] = area.flip();
 	areas[DIRECTION_SOUTHEAST] = std::move(areaSouthEast);
 	areas[DIRECTION_NORTHWEST] = std::move(area);
+	updateOffsets();
 }
 
 //**********************************************************//
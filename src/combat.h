@@ -105,14 +105,23 @@ class MatrixArea
 class AreaCombat
 {
 	public:
+		// x and y offsets of the tiles an area hits, relative to the target position
+		using Offsets = std::vector<std::pair<int32_t, int32_t>>;
+
 		void setupArea(const std::vector<uint32_t>& vec, uint32_t rows);
 		void setupArea(int32_t length, int32_t spread);
 		void setupArea(int32_t radius);
 		void setupExtArea(const std::vector<uint32_t>& vec, uint32_t rows);
 		const MatrixArea& getArea(const Position& centerPos, const Position& targetPos) const;
+		const Offsets& getOffsets(const Position& centerPos, const Position& targetPos) const;
 
 	private:
+		Direction getAreaDirection(const Position& centerPos, const Position& targetPos) const;
+		void updateOffsets();
+
 		std::vector<MatrixArea> areas;
+		// one list per entry of areas, built when the area is set up
+		std::vector<Offsets> offsets;
 		bool hasExtArea = false;
 };
 
@@ -6,9 +6,45 @@
 #include "condition.h"
 #include "game.h"
 #include "scriptwriter.h"
+#include "lockfree.h"
 
 extern Game g_game;
 
+namespace {
+
+// one chunk size that fits every condition type
+constexpr size_t CONDITION_CHUNK_SIZE = std::max({
+	sizeof(ConditionGeneric), sizeof(ConditionAttributes), sizeof(ConditionRegeneration), sizeof(ConditionSoul), sizeof(ConditionInvisible),
+	sizeof(ConditionDamage), sizeof(ConditionSpeed), sizeof(ConditionOutfit), sizeof(ConditionLight), sizeof(ConditionDrunk)
+});
+
+using ConditionPool = LockfreeObjectPool<Condition, CONDITION_CHUNK_SIZE, 4096>;
+
+// the members Condition::serialize writes, a member at its default is left out of the mask
+enum ConditionField : uint16_t {
+	CONDITIONFIELD_ID = 1 << 0,
+	CONDITIONFIELD_TICKS = 1 << 1,
+	CONDITIONFIELD_BUFF = 1 << 2, // no value, the bit is the flag
+	CONDITIONFIELD_SUBID = 1 << 3,
+	CONDITIONFIELD_AGGRESSIVE = 1 << 4, // no value, the bit is the flag
+	CONDITIONFIELD_CYCLE = 1 << 5,
+	CONDITIONFIELD_COUNT = 1 << 6,
+	CONDITIONFIELD_MAXCOUNT = 1 << 7,
+	CONDITIONFIELD_FACTORPERCENT = 1 << 8,
+};
+
+}
+
+void* Condition::operator new(size_t size)
+{
+	return ConditionPool::allocate(size);
+}
+
+void Condition::operator delete(void* p, size_t size)
+{
+	ConditionPool::deallocate(p, size);
+}
+
 bool Condition::setParam(ConditionParam_t param, int32_t value)
 {
 	switch (param) {
@@ -141,6 +177,100 @@ void Condition::serializeTVPFormat(ScriptWriter& script)
 	script.writeNumber(factorPercent);
 }
 
+bool Condition::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (legacy) {
+		uint8_t buff, aggr;
+		if (!propStream.read<ConditionId_t>(id) || !propStream.read<int32_t>(ticks) || !propStream.read<uint8_t>(buff) ||
+			!propStream.read<uint32_t>(subId) || !propStream.read<uint8_t>(aggr) || !propStream.read<int32_t>(cycle) ||
+			!propStream.read<int32_t>(count) || !propStream.read<int32_t>(maxCount) || !propStream.read<int32_t>(factorPercent)) {
+			return false;
+		}
+
+		isBuff = buff != 0;
+		aggressive = aggr != 0;
+		return true;
+	}
+
+	uint16_t fields;
+	if (!propStream.read<uint16_t>(fields)) {
+		return false;
+	}
+
+	id = CONDITIONID_DEFAULT;
+	ticks = 0;
+	subId = 0;
+	cycle = 0;
+	count = 0;
+	maxCount = 0;
+	factorPercent = -1;
+	isBuff = (fields & CONDITIONFIELD_BUFF) != 0;
+	aggressive = (fields & CONDITIONFIELD_AGGRESSIVE) != 0;
+
+	return (!(fields & CONDITIONFIELD_ID) || propStream.read<ConditionId_t>(id)) &&
+		(!(fields & CONDITIONFIELD_TICKS) || propStream.read<int32_t>(ticks)) &&
+		(!(fields & CONDITIONFIELD_SUBID) || propStream.read<uint32_t>(subId)) &&
+		(!(fields & CONDITIONFIELD_CYCLE) || propStream.read<int32_t>(cycle)) &&
+		(!(fields & CONDITIONFIELD_COUNT) || propStream.read<int32_t>(count)) &&
+		(!(fields & CONDITIONFIELD_MAXCOUNT) || propStream.read<int32_t>(maxCount)) &&
+		(!(fields & CONDITIONFIELD_FACTORPERCENT) || propStream.read<int32_t>(factorPercent));
+}
+
+void Condition::serialize(PropWriteStream& propWriteStream)
+{
+	uint16_t fields = 0;
+	if (id != CONDITIONID_DEFAULT) {
+		fields |= CONDITIONFIELD_ID;
+	}
+	if (ticks != 0) {
+		fields |= CONDITIONFIELD_TICKS;
+	}
+	if (isBuff) {
+		fields |= CONDITIONFIELD_BUFF;
+	}
+	if (subId != 0) {
+		fields |= CONDITIONFIELD_SUBID;
+	}
+	if (aggressive) {
+		fields |= CONDITIONFIELD_AGGRESSIVE;
+	}
+	if (cycle != 0) {
+		fields |= CONDITIONFIELD_CYCLE;
+	}
+	if (count != 0) {
+		fields |= CONDITIONFIELD_COUNT;
+	}
+	if (maxCount != 0) {
+		fields |= CONDITIONFIELD_MAXCOUNT;
+	}
+	if (factorPercent != -1) {
+		fields |= CONDITIONFIELD_FACTORPERCENT;
+	}
+
+	propWriteStream.write<uint16_t>(fields);
+	if (fields & CONDITIONFIELD_ID) {
+		propWriteStream.write<ConditionId_t>(id);
+	}
+	if (fields & CONDITIONFIELD_TICKS) {
+		propWriteStream.write<int32_t>(ticks);
+	}
+	if (fields & CONDITIONFIELD_SUBID) {
+		propWriteStream.write<uint32_t>(subId);
+	}
+	if (fields & CONDITIONFIELD_CYCLE) {
+		propWriteStream.write<int32_t>(cycle);
+	}
+	if (fields & CONDITIONFIELD_COUNT) {
+		propWriteStream.write<int32_t>(count);
+	}
+	if (fields & CONDITIONFIELD_MAXCOUNT) {
+		propWriteStream.write<int32_t>(maxCount);
+	}
+	if (fields & CONDITIONFIELD_FACTORPERCENT) {
+		propWriteStream.write<int32_t>(factorPercent);
+	}
+}
+
 void Condition::setTicks(int32_t newTicks)
 {
 	ticks = newTicks;
@@ -404,6 +534,57 @@ bool ConditionAttributes::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionAttributes::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	for (int32_t skill : skills) {
+		propWriteStream.write<int32_t>(skill);
+	}
+
+	for (int32_t stat : stats) {
+		propWriteStream.write<int32_t>(stat);
+	}
+
+	propWriteStream.write<uint8_t>(disableDefense);
+
+	for (int32_t specialSkill : specialSkills) {
+		propWriteStream.write<int32_t>(specialSkill);
+	}
+}
+
+bool ConditionAttributes::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	for (int32_t& skill : skills) {
+		if (!propStream.read<int32_t>(skill)) {
+			return false;
+		}
+	}
+
+	for (int32_t& stat : stats) {
+		if (!propStream.read<int32_t>(stat)) {
+			return false;
+		}
+	}
+
+	uint8_t defense;
+	if (!propStream.read<uint8_t>(defense)) {
+		return false;
+	}
+	disableDefense = defense != 0;
+
+	for (int32_t& specialSkill : specialSkills) {
+		if (!propStream.read<int32_t>(specialSkill)) {
+			return false;
+		}
+	}
+	return true;
+}
+
 bool ConditionAttributes::startCondition(Creature* creature)
 {
 	if (!Condition::startCondition(creature)) {
@@ -844,6 +1025,26 @@ bool ConditionRegeneration::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionRegeneration::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	propWriteStream.write<uint32_t>(healthTicks);
+	propWriteStream.write<uint32_t>(healthGain);
+	propWriteStream.write<uint32_t>(manaTicks);
+	propWriteStream.write<uint32_t>(manaGain);
+}
+
+bool ConditionRegeneration::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	return propStream.read<uint32_t>(healthTicks) && propStream.read<uint32_t>(healthGain) &&
+		propStream.read<uint32_t>(manaTicks) && propStream.read<uint32_t>(manaGain);
+}
+
 bool ConditionRegeneration::executeCondition(Creature* creature, int32_t interval)
 {
 	internalHealthTicks += interval;
@@ -950,6 +1151,23 @@ bool ConditionSoul::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionSoul::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	propWriteStream.write<uint32_t>(soulGain);
+	propWriteStream.write<uint32_t>(soulTicks);
+}
+
+bool ConditionSoul::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	return propStream.read<uint32_t>(soulGain) && propStream.read<uint32_t>(soulTicks);
+}
+
 bool ConditionSoul::executeCondition(Creature* creature, int32_t interval)
 {
 	internalSoulTicks += interval;
@@ -1096,24 +1314,17 @@ void ConditionDamage::serializeTVPFormat(ScriptWriter& script)
 	script.writeText(",");
 	script.writeNumber(periodDamage);
 	script.writeText(",");
-	script.writeNumber(damageList.size());
-	if (damageList.size() > 0) {
+	const size_t rounds = hasDamageRounds() ? damageList->size() - damageRound : 0;
+	script.writeNumber(rounds);
+	for (size_t i = 0; i < rounds; ++i) {
+		const IntervalInfo& intervalInfo = (*damageList)[damageRound + i];
+
 		script.writeText(",");
-		for (int32_t i = 0; i <= damageList.size() - 1; i++) {
-			auto it = damageList.begin();
-			std::advance(it, i);
-			const IntervalInfo& internalInfo = *it;
-
-			script.writeNumber(internalInfo.interval);
-			script.writeText(",");
-			script.writeNumber(internalInfo.timeLeft);
-			script.writeText(",");
-			script.writeNumber(internalInfo.value);
-
-			if (i < damageList.size() - 1) {
-				script.writeText(",");
-			}
-		}
+		script.writeNumber(intervalInfo.interval);
+		script.writeText(",");
+		script.writeNumber(i == 0 ? roundTimeLeft : intervalInfo.timeLeft);
+		script.writeText(",");
+		script.writeNumber(intervalInfo.value);
 	}
 }
 
@@ -1147,6 +1358,117 @@ bool ConditionDamage::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionDamage::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	// the damage list is left out, it is never loaded back
+	propWriteStream.write<uint8_t>(delayed);
+	propWriteStream.write<int32_t>(periodDamage);
+}
+
+bool ConditionDamage::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	uint8_t delay;
+	if (!propStream.read<uint8_t>(delay) || !propStream.read<int32_t>(periodDamage)) {
+		return false;
+	}
+	delayed = delay != 0;
+
+	if (!legacy) {
+		return true;
+	}
+
+	//the damage list is skipped, as the text format does
+	uint32_t totalDamageList;
+	if (!propStream.read<uint32_t>(totalDamageList)) {
+		return false;
+	}
+	return propStream.skip(static_cast<size_t>(totalDamageList) * 3 * sizeof(int32_t));
+}
+
+void ConditionDamage::serializeState(PropWriteStream& propWriteStream) const
+{
+	propWriteStream.write<int32_t>(cycle);
+	propWriteStream.write<int32_t>(minCycle);
+	propWriteStream.write<int32_t>(count);
+	propWriteStream.write<int32_t>(maxCount);
+	propWriteStream.write<int32_t>(factorPercent);
+	propWriteStream.write<int64_t>(endTime);
+	propWriteStream.write<uint32_t>(subId);
+	propWriteStream.write<int32_t>(ticks);
+	propWriteStream.write<uint8_t>(isBuff);
+	propWriteStream.write<uint8_t>(aggressive);
+
+	propWriteStream.write<int32_t>(maxDamage);
+	propWriteStream.write<int32_t>(minDamage);
+	propWriteStream.write<int32_t>(startDamage);
+	propWriteStream.write<int32_t>(periodDamage);
+	propWriteStream.write<int32_t>(periodDamageTick);
+	propWriteStream.write<int32_t>(tickInterval);
+	propWriteStream.write<int32_t>(initDamage);
+	propWriteStream.write<uint8_t>(forceUpdate);
+	propWriteStream.write<uint8_t>(delayed);
+	propWriteStream.write<uint8_t>(field);
+	propWriteStream.write<uint32_t>(owner);
+	propWriteStream.write<uint32_t>(ownerGuid);
+
+	const size_t rounds = hasDamageRounds() ? damageList->size() - damageRound : 0;
+	propWriteStream.write<uint32_t>(rounds);
+	for (size_t i = 0; i < rounds; ++i) {
+		const IntervalInfo& intervalInfo = (*damageList)[damageRound + i];
+		propWriteStream.write<int32_t>(intervalInfo.interval);
+		propWriteStream.write<int32_t>(i == 0 ? roundTimeLeft : intervalInfo.timeLeft);
+		propWriteStream.write<int32_t>(intervalInfo.value);
+	}
+}
+
+bool ConditionDamage::unserializeState(PropStream& propStream)
+{
+	uint8_t buff, aggressiveFlag, forceUpdateFlag, delayedFlag, fieldFlag;
+	if (!propStream.read<int32_t>(cycle) || !propStream.read<int32_t>(minCycle) || !propStream.read<int32_t>(count) ||
+		!propStream.read<int32_t>(maxCount) || !propStream.read<int32_t>(factorPercent) || !propStream.read<int64_t>(endTime) ||
+		!propStream.read<uint32_t>(subId) || !propStream.read<int32_t>(ticks) || !propStream.read<uint8_t>(buff) ||
+		!propStream.read<uint8_t>(aggressiveFlag)) {
+		return false;
+	}
+	isBuff = buff != 0;
+	aggressive = aggressiveFlag != 0;
+
+	if (!propStream.read<int32_t>(maxDamage) || !propStream.read<int32_t>(minDamage) || !propStream.read<int32_t>(startDamage) ||
+		!propStream.read<int32_t>(periodDamage) || !propStream.read<int32_t>(periodDamageTick) || !propStream.read<int32_t>(tickInterval) ||
+		!propStream.read<int32_t>(initDamage) || !propStream.read<uint8_t>(forceUpdateFlag) || !propStream.read<uint8_t>(delayedFlag) ||
+		!propStream.read<uint8_t>(fieldFlag) || !propStream.read<uint32_t>(owner) || !propStream.read<uint32_t>(ownerGuid)) {
+		return false;
+	}
+	forceUpdate = forceUpdateFlag != 0;
+	delayed = delayedFlag != 0;
+	field = fieldFlag != 0;
+
+	uint32_t totalDamageList;
+	if (!propStream.read<uint32_t>(totalDamageList)) {
+		return false;
+	}
+
+	auto rounds = std::make_shared<std::vector<IntervalInfo>>();
+	rounds->reserve(totalDamageList);
+	for (uint32_t i = 0; i < totalDamageList; i++) {
+		IntervalInfo info;
+		if (!propStream.read<int32_t>(info.interval) || !propStream.read<int32_t>(info.timeLeft) || !propStream.read<int32_t>(info.value)) {
+			return false;
+		}
+		rounds->push_back(info);
+	}
+
+	damageList = std::move(rounds);
+	setDamageRound(0);
+	return true;
+}
+
 bool ConditionDamage::updateCondition(const Condition* addCondition)
 {
 	const ConditionDamage& conditionDamage = static_cast<const ConditionDamage&>(*addCondition);
@@ -1182,6 +1504,11 @@ bool ConditionDamage::addDamage(int32_t rounds, int32_t time, int32_t value)
 		return false;
 	}
 
+	std::vector<IntervalInfo>& ownDamageList = getOwnDamageList();
+	if (ownDamageList.empty()) {
+		roundTimeLeft = time;
+	}
+
 	//rounds, time, damage
 	for (int32_t i = 0; i <= rounds; ++i) {
 		IntervalInfo damageInfo{};
@@ -1189,7 +1516,7 @@ bool ConditionDamage::addDamage(int32_t rounds, int32_t time, int32_t value)
 		damageInfo.timeLeft = time;
 		damageInfo.value = value;
 
-		damageList.push_back(damageInfo);
+		ownDamageList.push_back(damageInfo);
 
 		if (ticks != -1) {
 			setTicks(ticks + damageInfo.interval);
@@ -1205,7 +1532,7 @@ bool ConditionDamage::init()
 		return true;
 	}
 
-	if (!damageList.empty()) {
+	if (hasDamageRounds()) {
 		return true;
 	}
 
@@ -1225,7 +1552,7 @@ bool ConditionDamage::init()
 			addDamage(1, tickInterval, -value);
 		}
 	}
-	return !damageList.empty();
+	return hasDamageRounds();
 }
 
 bool ConditionDamage::startCondition(Creature* creature)
@@ -1277,20 +1604,20 @@ bool ConditionDamage::executeCondition(Creature* creature, int32_t interval)
 			periodDamageTick = 0;
 			doDamage(creature, periodDamage);
 		}
-	} else if (!damageList.empty()) {
-		IntervalInfo& damageInfo = damageList.front();
+	} else if (hasDamageRounds()) {
+		const IntervalInfo& damageInfo = (*damageList)[damageRound];
 
 		bool bRemove = (ticks != -1);
 		creature->onTickCondition(getType(), bRemove);
-		damageInfo.timeLeft -= interval;
+		roundTimeLeft -= interval;
 
-		if (damageInfo.timeLeft <= 0) {
+		if (roundTimeLeft <= 0) {
 			int32_t damage = damageInfo.value;
 
 			if (bRemove) {
-				damageList.pop_front();
+				setDamageRound(damageRound + 1);
 			} else {
-				damageInfo.timeLeft = damageInfo.interval;
+				roundTimeLeft = damageInfo.interval;
 			}
 
 			doDamage(creature, damage);
@@ -1362,17 +1689,38 @@ bool ConditionDamage::getNextDamage(int32_t& damage)
 	if (periodDamage != 0) {
 		damage = periodDamage;
 		return true;
-	} else if (!damageList.empty()) {
-		IntervalInfo& damageInfo = damageList.front();
-		damage = damageInfo.value;
+	} else if (hasDamageRounds()) {
+		damage = (*damageList)[damageRound].value;
 		if (ticks != -1) {
-			damageList.pop_front();
+			setDamageRound(damageRound + 1);
 		}
 		return true;
 	}
 	return false;
 }
 
+void ConditionDamage::setDamageRound(size_t round)
+{
+	damageRound = round;
+	if (hasDamageRounds()) {
+		roundTimeLeft = (*damageList)[damageRound].timeLeft;
+	}
+}
+
+std::vector<IntervalInfo>& ConditionDamage::getOwnDamageList()
+{
+	if (!damageList) {
+		damageList = std::make_shared<std::vector<IntervalInfo>>();
+		damageRound = 0;
+	} else if (damageList.use_count() > 1 || damageRound != 0) {
+		// the rounds already dealt are left behind
+		auto first = damageList->begin() + std::min(damageRound, damageList->size());
+		damageList = std::make_shared<std::vector<IntervalInfo>>(first, damageList->end());
+		damageRound = 0;
+	}
+	return *damageList;
+}
+
 bool ConditionDamage::doDamage(Creature* creature, int32_t healthChange)
 {
 	if (creature->isSuppress(getType()) || creature->isImmune(getType())) {
@@ -1453,11 +1801,9 @@ void ConditionDamage::addCondition(Creature* creature, const Condition* conditio
 	maxCount = conditionDamage.maxCount;
 	cycle = conditionDamage.cycle;
 
-	if (!damageList.empty()) {
-		damageList.clear();
-	}
-
 	damageList = conditionDamage.damageList;
+	damageRound = conditionDamage.damageRound;
+	roundTimeLeft = conditionDamage.roundTimeLeft;
 
 	if (init()) {
 		if (conditionDamage.initDamage != 0) {
@@ -1473,10 +1819,10 @@ int32_t ConditionDamage::getTotalDamage() const
 	}
 
 	int32_t result;
-	if (!damageList.empty()) {
+	if (hasDamageRounds()) {
 		result = 0;
-		for (const IntervalInfo& intervalInfo : damageList) {
-			result += intervalInfo.value;
+		for (size_t i = damageRound; i < damageList->size(); ++i) {
+			result += (*damageList)[i].value;
 		}
 	} else {
 		result = minDamage + (maxDamage - minDamage) / 2;
@@ -1581,6 +1927,22 @@ bool ConditionSpeed::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionSpeed::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	propWriteStream.write<int32_t>(storedSpeedDelta);
+}
+
+bool ConditionSpeed::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	return propStream.read<int32_t>(storedSpeedDelta);
+}
+
 bool ConditionSpeed::startCondition(Creature* creature)
 {
 	if (!Condition::startCondition(creature)) {
@@ -1733,6 +2095,29 @@ bool ConditionOutfit::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionOutfit::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	propWriteStream.write<uint16_t>(outfit.lookType);
+	propWriteStream.write<uint16_t>(outfit.lookTypeEx);
+	propWriteStream.write<uint8_t>(outfit.lookHead);
+	propWriteStream.write<uint8_t>(outfit.lookBody);
+	propWriteStream.write<uint8_t>(outfit.lookLegs);
+	propWriteStream.write<uint8_t>(outfit.lookFeet);
+}
+
+bool ConditionOutfit::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	return propStream.read<uint16_t>(outfit.lookType) && propStream.read<uint16_t>(outfit.lookTypeEx) &&
+		propStream.read<uint8_t>(outfit.lookHead) && propStream.read<uint8_t>(outfit.lookBody) &&
+		propStream.read<uint8_t>(outfit.lookLegs) && propStream.read<uint8_t>(outfit.lookFeet);
+}
+
 bool ConditionOutfit::startCondition(Creature* creature)
 {
 	if (!Condition::startCondition(creature)) {
@@ -1913,6 +2298,26 @@ bool ConditionLight::unserializeTVPFormat(ScriptReader& script)
 	return true;
 }
 
+void ConditionLight::serialize(PropWriteStream& propWriteStream)
+{
+	Condition::serialize(propWriteStream);
+
+	propWriteStream.write<uint8_t>(lightInfo.color);
+	propWriteStream.write<uint8_t>(lightInfo.level);
+	propWriteStream.write<uint32_t>(internalLightTicks);
+	propWriteStream.write<uint32_t>(lightChangeInterval);
+}
+
+bool ConditionLight::unserialize(PropStream& propStream, bool legacy/* = false*/)
+{
+	if (!Condition::unserialize(propStream, legacy)) {
+		return false;
+	}
+
+	return propStream.read<uint8_t>(lightInfo.color) && propStream.read<uint8_t>(lightInfo.level) &&
+		propStream.read<uint32_t>(internalLightTicks) && propStream.read<uint32_t>(lightChangeInterval);
+}
+
 bool ConditionDrunk::startCondition(Creature* creature)
 {
 	if (!Condition::startCondition(creature)) {
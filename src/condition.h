@@ -68,6 +68,10 @@ class Condition
 			subId(subId), ticks(ticks), conditionType(type), isBuff(buff), aggressive(aggressive), id(id) {}
 		virtual ~Condition() = default;
 
+		// conditions are cloned for every hit, their memory is recycled through a free list
+		static void* operator new(size_t size);
+		static void operator delete(void* p, size_t size);
+
 		virtual bool startCondition(Creature* creature);
 		virtual bool executeCondition(Creature* creature, int32_t interval);
 		virtual void endCondition(Creature* creature) = 0;
@@ -111,6 +115,9 @@ class Condition
 		//serialization
 		virtual bool unserializeTVPFormat(ScriptReader& script);
 		virtual void serializeTVPFormat(ScriptWriter& script);
+		// a field mask leaves out the members at their defaults, legacy reads the fixed layout written before
+		virtual bool unserialize(PropStream& propStream, bool legacy = false);
+		virtual void serialize(PropWriteStream& propWriteStream);
 
 	protected:
 		virtual bool updateCondition(const Condition* addCondition);
@@ -170,6 +177,8 @@ class ConditionAttributes final : public ConditionGeneric
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
 
 	private:
 		int32_t skills[SKILL_LAST + 1] = {};
@@ -208,6 +217,8 @@ class ConditionRegeneration final : public ConditionGeneric
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
 
 	private:
 		uint32_t internalHealthTicks = 0;
@@ -238,6 +249,8 @@ class ConditionSoul final : public ConditionGeneric
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
 
 	private:
 		uint32_t internalSoulTicks = 0;
@@ -294,6 +307,12 @@ class ConditionDamage final : public Condition
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
+
+		// every member, unlike serialize, used by the items cache for the item conditions
+		void serializeState(PropWriteStream& propWriteStream) const;
+		bool unserializeState(PropStream& propStream);
 
 	private:
 		int32_t maxDamage = 0;
@@ -312,7 +331,18 @@ class ConditionDamage final : public Condition
 
 		bool init();
 
-		std::list<IntervalInfo> damageList;
+		// the rounds of damage, shared by the clones of a condition until one of them adds to them
+		std::shared_ptr<std::vector<IntervalInfo>> damageList;
+		// the round due next and the time left until it deals its damage
+		size_t damageRound = 0;
+		int32_t roundTimeLeft = 0;
+
+		bool hasDamageRounds() const {
+			return damageList && damageRound < damageList->size();
+		}
+		void setDamageRound(size_t round);
+		// the rounds not dealt yet, copied first while other conditions share them
+		std::vector<IntervalInfo>& getOwnDamageList();
 
 		bool getNextDamage(int32_t& damage);
 		bool doDamage(Creature* creature, int32_t healthChange);
@@ -342,6 +372,8 @@ class ConditionSpeed final : public Condition
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
 
 	private:
 		int32_t storedSpeedDelta = 0;
@@ -369,6 +401,8 @@ class ConditionOutfit final : public Condition
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
 
 	private:
 		Outfit_t outfit;
@@ -399,6 +433,8 @@ class ConditionLight final : public Condition
 		//serialization
 		void serializeTVPFormat(ScriptWriter& script) override;
 		bool unserializeTVPFormat(ScriptReader& script) override;
+		void serialize(PropWriteStream& propWriteStream) override;
+		bool unserialize(PropStream& propStream, bool legacy = false) override;
 
 	private:
 		void updateLightCycles(const Condition* condition);
@@ -11,9 +11,14 @@
 #endif
 
 #include "configmanager.h"
+#include "arena.h"
 #include "game.h"
+#include "loadshedder.h"
 #include "monster.h"
 #include "pugicast.h"
+#include "tasks.h"
+#include "scriptprofiler.h"
+#include "trafficstats.h"
 
 #if LUA_VERSION_NUM >= 502
 #undef lua_strlen
@@ -75,7 +80,15 @@ bool getGlobalBoolean(lua_State* L, const char* identifier, const bool defaultVa
 
 ConfigManager::ConfigManager()
 {
-	string[CONFIG_FILE] = "config.lua";
+	auto snapshot = std::make_unique<Snapshot>();
+	snapshot->string[CONFIG_FILE] = "config.lua";
+	publish(std::move(snapshot));
+}
+
+void ConfigManager::publish(std::unique_ptr<Snapshot> snapshot)
+{
+	current.store(snapshot.get(), std::memory_order_release);
+	snapshots.push_back(std::move(snapshot));
 }
 
 namespace {
@@ -131,12 +144,19 @@ bool ConfigManager::load()
 
 	luaL_openlibs(L);
 
+	std::lock_guard<std::mutex> lockGuard(writeLock);
 	if (luaL_dofile(L, getString(CONFIG_FILE).c_str())) {
 		std::cout << "[Error - ConfigManager::load] " << lua_tostring(L, -1) << std::endl;
 		lua_close(L);
 		return false;
 	}
 
+	// filled in aside and published at once, values read once at startup are carried over
+	std::unique_ptr<Snapshot> snapshot = copySnapshot();
+	auto& string = snapshot->string;
+	auto& integer = snapshot->integer;
+	auto& boolean = snapshot->boolean;
+
 	//parse config
 	if (!loaded) { //info that must be loaded one time (unless we reset the modules involved)
 		boolean[BIND_ONLY_GLOBAL_ADDRESS] = getGlobalBoolean(L, "bindOnlyGlobalAddress", false);
@@ -157,6 +177,8 @@ bool ConfigManager::load()
 		string[DISABLED_MAILBOXES] = getGlobalString(L, "disabledMailboxes", "");
 
 		integer[SQL_PORT] = getGlobalNumber(L, "mysqlPort", 3306);
+		integer[SQL_CONNECTIONS] = std::max<int32_t>(1, getGlobalNumber(L, "mysqlConnections", 4));
+		integer[SQL_BATCH_SIZE] = std::max<int32_t>(1, getGlobalNumber(L, "mysqlBatchSize", 32));
 
 		if (integer[GAME_PORT] == 0) {
 			integer[GAME_PORT] = getGlobalNumber(L, "gameProtocolPort", 7172);
@@ -168,6 +190,9 @@ bool ConfigManager::load()
 
 		integer[STATUS_PORT] = getGlobalNumber(L, "statusProtocolPort", 7171);
 
+		string[METRICS_IP] = getGlobalString(L, "metricsIP", "127.0.0.1");
+		integer[METRICS_PORT] = getGlobalNumber(L, "metricsPort", 0);
+
 		boolean[ENABLE_MAP_REFRESH] = getGlobalBoolean(L, "enableMapRefresh", true);
 		boolean[CLASSIC_MONSTER_INVISIBILITY] = getGlobalBoolean(L, "classicMonsterInvisibility", true);
 		boolean[MYSQL_USE_SSL] = getGlobalBoolean(L, "mysqlUseSSL", false);
@@ -179,6 +204,14 @@ bool ConfigManager::load()
 		integer[TILE_ITEM_LIMIT] = getGlobalNumber(L, "tileItemLimit", 1000);
 		integer[HOUSE_TILE_ITEM_LIMIT] = getGlobalNumber(L, "houseTileItemLimit", 100);
 		integer[MAX_OPEN_CONTAINERS] = getGlobalNumber(L, "maxOpenContainers", 15);
+		integer[NETWORK_THREADS] = std::max<int32_t>(1, getGlobalNumber(L, "networkThreads", 1));
+		integer[RSA_THREADS] = std::max<int32_t>(0, getGlobalNumber(L, "rsaThreads", 0));
+		integer[SAVE_THREADS] = std::max<int32_t>(1, getGlobalNumber(L, "saveThreads", 4));
+		integer[JOB_THREADS] = std::max<int32_t>(-1, getGlobalNumber(L, "jobThreads", -1));
+
+		string[THREAD_AFFINITY] = getGlobalString(L, "threadAffinity", "");
+		integer[HUGE_PAGES] = std::clamp<int32_t>(getGlobalNumber(L, "hugePages", 0), HUGE_PAGES_NONE, HUGE_PAGES_EXPLICIT);
+		integer[NUMA_NODE] = std::max<int32_t>(-1, getGlobalNumber(L, "numaNode", -1));
 	}
 
 	boolean[ENABLE_MAP_DATA_FILES] = getGlobalBoolean(L, "enableMapDataFiles", true);
@@ -241,6 +274,21 @@ bool ConfigManager::load()
 	boolean[SPAWN_ONE_MONSTER_AT_A_TIME] = getGlobalBoolean(L, "spawnOneMonsterAtATime", false);
 	boolean[TILE_OLDSCHOOL_ITEM_STACKING] = getGlobalBoolean(L, "tileOldschoolItemStacking", false);
 	boolean[SPAWN_MULTIFLOOR_RESPAWN_BLOCK] = getGlobalBoolean(L, "spawnMultifloorRespawnBlock", false);
+	boolean[DISPATCHER_LOCKFREE_QUEUE] = getGlobalBoolean(L, "dispatcherLockfreeQueue", false);
+	boolean[DISPATCHER_TASK_STATS] = getGlobalBoolean(L, "dispatcherTaskStats", false);
+	boolean[BINARY_PLAYER_FILES] = getGlobalBoolean(L, "binaryPlayerFiles", true);
+	boolean[SYNC_SAVE_FILES] = getGlobalBoolean(L, "syncSaveFiles", true);
+	boolean[ITEMS_CACHE] = getGlobalBoolean(L, "itemsCache", true);
+	boolean[LUA_PROFILER] = getGlobalBoolean(L, "luaProfiler", false);
+	boolean[FLUSH_WALK_PACKETS] = getGlobalBoolean(L, "flushWalkPackets", true);
+	boolean[FLUSH_PING_PACKETS] = getGlobalBoolean(L, "flushPingPackets", true);
+	boolean[TRAFFIC_STATS] = getGlobalBoolean(L, "trafficStats", false);
+	boolean[LUA_GC_GENERATIONAL] = getGlobalBoolean(L, "luaGcGenerational", false);
+	boolean[FORK_SAVE] = getGlobalBoolean(L, "forkSave", false);
+	boolean[PACKET_RATE_LIMIT] = getGlobalBoolean(L, "packetRateLimit", true);
+	boolean[LUA_FFI_BINDINGS] = getGlobalBoolean(L, "luaFfiBindings", true);
+	boolean[FAST_SHUTDOWN] = getGlobalBoolean(L, "fastShutdown", true);
+	boolean[NPC_BEHAVIOUR_CACHE] = getGlobalBoolean(L, "npcBehaviourCache", true);
 
 	string[DEFAULT_PRIORITY] = getGlobalString(L, "defaultPriority", "high");
 	string[SERVER_NAME] = getGlobalString(L, "serverName", "");
@@ -254,6 +302,7 @@ bool ConfigManager::load()
 	string[IP_LOCK_MESSAGE] = getGlobalString(L, "ipLockMessage", "IP address blocked for 30 minutes. Please wait.");
 	string[ACCOUNT_LOCK_MESSAGE] = getGlobalString(L, "accountLockMessage", "Account disabled for five minutes. Please wait.");
 	string[SERVER_SAVE_TIME] = getGlobalString(L, "serverSaveTime", "04:00:00");
+	string[WORLD_SNAPSHOT_FILE] = getGlobalString(L, "worldSnapshotFile", "gamedata/world.json");
 
 	integer[MAX_PLAYERS] = getGlobalNumber(L, "maxPlayers");
 	integer[PZ_LOCKED] = getGlobalNumber(L, "pzLocked", 60000);
@@ -290,9 +339,32 @@ bool ConfigManager::load()
 	integer[FAILED_LOGINATTEMPTS_IP_BAN] = getGlobalNumber(L, "failedLoginAttemptsIPBan", 15);
 	integer[ACCOUNT_LOCK_DURATION] = getGlobalNumber(L, "accountLockDuration", 5 * 60 * 1000);
 	integer[IP_LOCK_DURATION] = getGlobalNumber(L, "ipLockDuration", 30 * 60 * 1000);
-
-	expStages = loadXMLStages();
-	expStages.shrink_to_fit();
+	integer[DISPATCHER_SLOW_TASK_THRESHOLD] = getGlobalNumber(L, "dispatcherSlowTaskThreshold", 100);
+	integer[DISPATCHER_STATS_INTERVAL] = getGlobalNumber(L, "dispatcherStatsInterval", 60);
+	integer[DISPATCHER_BATCH_BUDGET] = getGlobalNumber(L, "dispatcherBatchBudget", 100);
+	integer[TICK_BUDGET] = getGlobalNumber(L, "tickBudget", 50);
+	integer[LUA_PROFILER_LOG_INTERVAL] = getGlobalNumber(L, "luaProfilerLogInterval", 0);
+	integer[STATEMENT_LOG_SIZE] = getGlobalNumber(L, "statementLogSize", 100000);
+	integer[STATEMENT_LISTENER_LOG_SIZE] = getGlobalNumber(L, "statementListenerLogSize", 1000000);
+	integer[STATEMENT_RETENTION] = getGlobalNumber(L, "statementRetention", 30 * 60);
+	integer[ACCOUNT_CACHE_DURATION] = getGlobalNumber(L, "accountCacheDuration", 60);
+	integer[SEND_QUEUE_DEGRADE_SIZE] = getGlobalNumber(L, "sendQueueDegradeSize", 128 * 1024);
+	integer[SEND_QUEUE_LIMIT] = getGlobalNumber(L, "sendQueueLimit", 1024 * 1024);
+	integer[TRAFFIC_STATS_LOG_INTERVAL] = getGlobalNumber(L, "trafficStatsLogInterval", 0);
+	integer[WORLD_SNAPSHOT_INTERVAL] = getGlobalNumber(L, "worldSnapshotInterval", 0);
+	integer[CAST_ACCOUNT_NUMBER] = getGlobalNumber(L, "castAccountNumber", 0);
+	integer[SHARD_ID] = getGlobalNumber(L, "shardId", 0);
+	integer[BAN_REFRESH_INTERVAL] = getGlobalNumber(L, "banRefreshInterval", 60);
+	integer[LUA_GC_IDLE_BUDGET] = getGlobalNumber(L, "luaGcIdleBudget", 1000);
+	integer[PLAYER_AUTOSAVE_INTERVAL] = getGlobalNumber(L, "playerAutosaveInterval", 10 * 60);
+	integer[PLAYER_FILE_CACHE_SIZE] = getGlobalNumber(L, "playerFileCacheSize", 1000);
+	integer[FILE_COMPRESSION_LEVEL] = getGlobalNumber(L, "fileCompressionLevel", 0);
+	integer[LAZY_SPAWN_RADIUS] = getGlobalNumber(L, "lazySpawnRadius", 0);
+	integer[LAZY_SPAWN_IDLE_TIME] = getGlobalNumber(L, "lazySpawnIdleTime", 10 * 60);
+
+	snapshot->expStages = loadXMLStages();
+	snapshot->expStages.shrink_to_fit();
+	publish(std::move(snapshot));
 
 	loaded = true;
 	lua_close(L);
@@ -303,6 +375,10 @@ bool ConfigManager::load()
 bool ConfigManager::reload()
 {
 	bool result = load();
+	g_dispatcher.loadConfig();
+	g_loadShedder.loadConfig();
+	g_scriptProfiler.loadConfig();
+	g_trafficStats.loadConfig();
 	if (transformToSHA1(getString(ConfigManager::MOTD)) != g_game.getMotdHash()) {
 		g_game.incrementMotdNum();
 	}
@@ -317,7 +393,7 @@ const std::string& ConfigManager::getString(string_config_t what) const
 		std::cout << "[Warning - ConfigManager::getString] Accessing invalid index: " << what << std::endl;
 		return dummyStr;
 	}
-	return string[what];
+	return getSnapshot().string[what];
 }
 
 int32_t ConfigManager::getNumber(integer_config_t what) const
@@ -326,7 +402,7 @@ int32_t ConfigManager::getNumber(integer_config_t what) const
 		std::cout << "[Warning - ConfigManager::getNumber] Accessing invalid index: " << what << std::endl;
 		return 0;
 	}
-	return integer[what];
+	return getSnapshot().integer[what];
 }
 
 bool ConfigManager::getBoolean(boolean_config_t what) const
@@ -335,18 +411,19 @@ bool ConfigManager::getBoolean(boolean_config_t what) const
 		std::cout << "[Warning - ConfigManager::getBoolean] Accessing invalid index: " << what << std::endl;
 		return false;
 	}
-	return boolean[what];
+	return getSnapshot().boolean[what];
 }
 
 float ConfigManager::getExperienceStage(uint32_t level) const
 {
-	auto it = std::find_if(expStages.begin(), expStages.end(), [level](auto&& stage) {
+	const Snapshot& snapshot = getSnapshot();
+	auto it = std::find_if(snapshot.expStages.begin(), snapshot.expStages.end(), [level](auto&& stage) {
 		auto&& [minLevel, maxLevel, _] = stage;
 		return level >= minLevel && level <= maxLevel;
 		});
 
-	if (it == expStages.end()) {
-		return getNumber(ConfigManager::RATE_EXPERIENCE);
+	if (it == snapshot.expStages.end()) {
+		return snapshot.integer[RATE_EXPERIENCE];
 	}
 
 	return std::get<2>(*it);
@@ -359,7 +436,10 @@ bool ConfigManager::setString(string_config_t what, const std::string& value)
 		return false;
 	}
 
-	string[what] = value;
+	std::lock_guard<std::mutex> lockGuard(writeLock);
+	std::unique_ptr<Snapshot> snapshot = copySnapshot();
+	snapshot->string[what] = value;
+	publish(std::move(snapshot));
 	return true;
 }
 
@@ -370,7 +450,10 @@ bool ConfigManager::setNumber(integer_config_t what, int32_t value)
 		return false;
 	}
 
-	integer[what] = value;
+	std::lock_guard<std::mutex> lockGuard(writeLock);
+	std::unique_ptr<Snapshot> snapshot = copySnapshot();
+	snapshot->integer[what] = value;
+	publish(std::move(snapshot));
 	return true;
 }
 
@@ -381,6 +464,9 @@ bool ConfigManager::setBoolean(boolean_config_t what, bool value)
 		return false;
 	}
 
-	boolean[what] = value;
+	std::lock_guard<std::mutex> lockGuard(writeLock);
+	std::unique_ptr<Snapshot> snapshot = copySnapshot();
+	snapshot->boolean[what] = value;
+	publish(std::move(snapshot));
 	return true;
 }
@@ -79,6 +79,21 @@ class ConfigManager
 			SPAWN_ONE_MONSTER_AT_A_TIME,
 			SPAWN_MULTIFLOOR_RESPAWN_BLOCK,
 			TILE_OLDSCHOOL_ITEM_STACKING,
+			DISPATCHER_LOCKFREE_QUEUE,
+			DISPATCHER_TASK_STATS,
+			BINARY_PLAYER_FILES,
+			SYNC_SAVE_FILES,
+			ITEMS_CACHE,
+			LUA_PROFILER,
+			FLUSH_WALK_PACKETS,
+			FLUSH_PING_PACKETS,
+			TRAFFIC_STATS,
+			LUA_GC_GENERATIONAL,
+			FORK_SAVE,
+			PACKET_RATE_LIMIT,
+			LUA_FFI_BINDINGS,
+			FAST_SHUTDOWN,
+			NPC_BEHAVIOUR_CACHE,
 
 			LAST_BOOLEAN_CONFIG /* this must be the last one */
 		};
@@ -107,12 +122,17 @@ class ConfigManager
 			ACCOUNT_LOCK_MESSAGE,
 			IP_LOCK_MESSAGE,
 			SERVER_SAVE_TIME,
+			METRICS_IP,
+			WORLD_SNAPSHOT_FILE,
+			THREAD_AFFINITY,
 
 			LAST_STRING_CONFIG /* this must be the last one */
 		};
 
 		enum integer_config_t {
 			SQL_PORT,
+			SQL_CONNECTIONS,
+			SQL_BATCH_SIZE,
 			MAX_PLAYERS,
 			PZ_LOCKED,
 			RATE_EXPERIENCE,
@@ -157,6 +177,35 @@ class ConfigManager
 			ACCOUNT_LOCK_DURATION,
 			IP_LOCK_DURATION,
 			MAX_OPEN_CONTAINERS,
+			DISPATCHER_SLOW_TASK_THRESHOLD,
+			DISPATCHER_STATS_INTERVAL,
+			DISPATCHER_BATCH_BUDGET,
+			TICK_BUDGET,
+			NETWORK_THREADS,
+			RSA_THREADS,
+			SAVE_THREADS,
+			JOB_THREADS,
+			LUA_PROFILER_LOG_INTERVAL,
+			STATEMENT_LOG_SIZE,
+			STATEMENT_LISTENER_LOG_SIZE,
+			STATEMENT_RETENTION,
+			ACCOUNT_CACHE_DURATION,
+			SEND_QUEUE_DEGRADE_SIZE,
+			SEND_QUEUE_LIMIT,
+			TRAFFIC_STATS_LOG_INTERVAL,
+			METRICS_PORT,
+			WORLD_SNAPSHOT_INTERVAL,
+			CAST_ACCOUNT_NUMBER,
+			SHARD_ID,
+			BAN_REFRESH_INTERVAL,
+			LUA_GC_IDLE_BUDGET,
+			PLAYER_AUTOSAVE_INTERVAL,
+			PLAYER_FILE_CACHE_SIZE,
+			FILE_COMPRESSION_LEVEL,
+			LAZY_SPAWN_RADIUS,
+			LAZY_SPAWN_IDLE_TIME,
+			HUGE_PAGES,
+			NUMA_NODE,
 
 			LAST_INTEGER_CONFIG /* this must be the last one */
 		};
@@ -174,11 +223,28 @@ class ConfigManager
 		bool setBoolean(boolean_config_t what, bool value);
 
 	private:
-		std::string string[LAST_STRING_CONFIG] = {};
-		int32_t integer[LAST_INTEGER_CONFIG] = {};
-		bool boolean[LAST_BOOLEAN_CONFIG] = {};
+		// every value as of one load, a reload publishes a new one so no thread reads one half written
+		struct Snapshot {
+			std::string string[LAST_STRING_CONFIG] = {};
+			int32_t integer[LAST_INTEGER_CONFIG] = {};
+			bool boolean[LAST_BOOLEAN_CONFIG] = {};
 
-		ExperienceStages expStages = {};
+			ExperienceStages expStages = {};
+		};
+
+		const Snapshot& getSnapshot() const {
+			return *current.load(std::memory_order_acquire);
+		}
+		// copies the current snapshot for a writer to change, publish makes it the current one
+		std::unique_ptr<Snapshot> copySnapshot() const {
+			return std::make_unique<Snapshot>(getSnapshot());
+		}
+		void publish(std::unique_ptr<Snapshot> snapshot);
+
+		// replaced snapshots are kept, getString hands out references into them and reloads are rare
+		std::vector<std::unique_ptr<Snapshot>> snapshots;
+		std::atomic<const Snapshot*> current{nullptr};
+		std::mutex writeLock;
 
 		bool loaded = false;
 };
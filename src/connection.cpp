@@ -43,6 +43,31 @@ void ConnectionManager::closeAll()
 	connections.clear();
 }
 
+void ConnectionManager::closeTimedOut()
+{
+	// a deadline is a number stored on every read and write, not a timer armed and cancelled each time
+	const int64_t now = OTSYS_TIME();
+	const auto hasTimedOut = [now](const std::atomic<int64_t>& deadline) {
+		const int64_t value = deadline.load(std::memory_order_relaxed);
+		return value != 0 && value <= now;
+	};
+
+	std::vector<Connection_ptr> timedOut;
+	{
+		std::lock_guard<std::mutex> lockClass(connectionManagerLock);
+		for (const auto& connection : connections) {
+			if (hasTimedOut(connection->readDeadline) || hasTimedOut(connection->writeDeadline)) {
+				timedOut.push_back(connection);
+			}
+		}
+	}
+
+	// closing releases the connection, which takes the lock again
+	for (const auto& connection : timedOut) {
+		connection->close(Connection::FORCE_CLOSE);
+	}
+}
+
 // Connection
 
 void Connection::close(bool force)
@@ -73,7 +98,6 @@ void Connection::closeSocket()
 	if (socket.is_open()) {
 		try {
 			readTimer.cancel();
-			writeTimer.cancel();
 			boost::system::error_code error;
 			socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
 			socket.close(error);
@@ -100,8 +124,7 @@ void Connection::accept()
 {
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
 	try {
-		readTimer.expires_after(std::chrono::seconds(CONNECTION_READ_TIMEOUT));
-		readTimer.async_wait(std::bind(&Connection::handleTimeout, std::weak_ptr<Connection>(shared_from_this()), std::placeholders::_1));
+		readDeadline = OTSYS_TIME() + CONNECTION_READ_TIMEOUT * 1000;
 
 		// Read size of the first packet
 		boost::asio::async_read(socket,
@@ -116,7 +139,7 @@ void Connection::accept()
 void Connection::parseHeader(const boost::system::error_code& error)
 {
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
-	readTimer.cancel();
+	readDeadline = 0;
 
 	if (error) {
 		close(FORCE_CLOSE);
@@ -135,9 +158,7 @@ void Connection::parseHeader(const boost::system::error_code& error)
 	}
 
 	try {
-		readTimer.expires_after(std::chrono::seconds(CONNECTION_READ_TIMEOUT));
-		readTimer.async_wait(std::bind(&Connection::handleTimeout, std::weak_ptr<Connection>(shared_from_this()),
-		                                    std::placeholders::_1));
+		readDeadline = OTSYS_TIME() + CONNECTION_READ_TIMEOUT * 1000;
 
 		// Read packet content
 		msg.setLength(size + NetworkMessage::HEADER_LENGTH);
@@ -151,7 +172,7 @@ void Connection::parseHeader(const boost::system::error_code& error)
 void Connection::parsePacket(const boost::system::error_code& error)
 {
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
-	readTimer.cancel();
+	readDeadline = 0;
 
 	if (error) {
 		close(FORCE_CLOSE);
@@ -184,8 +205,7 @@ void Connection::parsePacket(const boost::system::error_code& error)
 		readTimer.expires_after(std::chrono::milliseconds(50));
 		readTimer.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
 			if (!ec) {
-				self->readTimer.expires_after(std::chrono::seconds(CONNECTION_READ_TIMEOUT));
-				self->readTimer.async_wait(std::bind(&Connection::handleTimeout, std::weak_ptr<Connection>(self), std::placeholders::_1));
+				self->readDeadline = OTSYS_TIME() + CONNECTION_READ_TIMEOUT * 1000;
 
 				// Wait to the next packet
 				boost::asio::async_read(self->socket,
@@ -206,23 +226,56 @@ void Connection::send(const OutputMessage_ptr& msg)
 		return;
 	}
 
-	bool noPendingWrite = messageQueue.empty();
+	// a client that does not read what it is sent is dropped before its queue takes more memory
+	const int64_t limit = g_config.getNumber(ConfigManager::SEND_QUEUE_LIMIT);
+	if (limit > 0 && queuedBytes + msg->getCapacity() > static_cast<size_t>(limit)) {
+		ConnectionManager::getInstance().onConnectionShed();
+		close(FORCE_CLOSE);
+		return;
+	}
+
+	queuedBytes += msg->getCapacity();
 	messageQueue.emplace_back(msg);
-	if (noPendingWrite) {
-		internalSend(msg);
+	if (messagesInFlight == 0) {
+		internalSend();
 	}
 }
 
-void Connection::internalSend(const OutputMessage_ptr& msg)
+bool Connection::isSendQueueCongested() const
+{
+	const int64_t degradeSize = g_config.getNumber(ConfigManager::SEND_QUEUE_DEGRADE_SIZE);
+	return degradeSize > 0 && queuedBytes >= static_cast<size_t>(degradeSize);
+}
+
+void Connection::post(std::function<void()>&& handler)
 {
-	protocol->onSendMessage(msg);
+	boost::asio::post(socket.get_executor(), [self = shared_from_this(), handler = std::move(handler)]() {
+		std::lock_guard<std::recursive_mutex> lockClass(self->connectionLock);
+		if (!self->closed) {
+			handler();
+		}
+	});
+}
+
+void Connection::internalSend()
+{
+	// every message queued while the previous write was in flight goes out in the same syscall
+	std::array<boost::asio::const_buffer, CONNECTION_WRITE_BATCH> buffers;
+	messagesInFlight = std::min(messageQueue.size(), CONNECTION_WRITE_BATCH);
+	size_t bytes = 0;
+	for (size_t i = 0; i < messagesInFlight; ++i) {
+		const OutputMessage_ptr& msg = messageQueue[i];
+		protocol->onSendMessage(msg);
+		buffers[i] = boost::asio::buffer(msg->getOutputBuffer(), msg->getLength());
+		bytes += msg->getLength();
+	}
+
 	try {
-		writeTimer.expires_after(std::chrono::seconds(CONNECTION_WRITE_TIMEOUT));
-		writeTimer.async_wait(std::bind(&Connection::handleTimeout, std::weak_ptr<Connection>(shared_from_this()),
-		                                     std::placeholders::_1));
+		writeDeadline = OTSYS_TIME() + CONNECTION_WRITE_TIMEOUT * 1000;
+		ConnectionManager::getInstance().onWrite(messagesInFlight, bytes);
 
-		boost::asio::async_write(socket,
-		                         boost::asio::buffer(msg->getOutputBuffer(), msg->getLength()),
+		// unused trailing buffers are empty and skipped by the write
+		boost::asio::async_write(socket, buffers,
 		                         std::bind(&Connection::onWriteOperation, shared_from_this(), std::placeholders::_1));
 	} catch (boost::system::system_error& e) {
 		std::cout << "[Network error - Connection::internalSend] " << e.what() << std::endl;
@@ -247,30 +300,23 @@ uint32_t Connection::getIP()
 void Connection::onWriteOperation(const boost::system::error_code& error)
 {
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
-	writeTimer.cancel();
-	messageQueue.pop_front();
+	writeDeadline = 0;
+	for (size_t i = 0; i < messagesInFlight; ++i) {
+		queuedBytes -= messageQueue[i]->getCapacity();
+	}
+	messageQueue.erase(messageQueue.begin(), messageQueue.begin() + messagesInFlight);
+	messagesInFlight = 0;
 
 	if (error) {
 		messageQueue.clear();
+		queuedBytes = 0;
 		close(FORCE_CLOSE);
 		return;
 	}
 
 	if (!messageQueue.empty()) {
-		internalSend(messageQueue.front());
+		internalSend();
 	} else if (closed) {
 		closeSocket();
 	}
 }
-
-void Connection::handleTimeout(ConnectionWeak_ptr connectionWeak, const boost::system::error_code& error)
-{
-	if (error == boost::asio::error::operation_aborted) {
-		//The timer has been manually canceled
-		return;
-	}
-
-	if (auto connection = connectionWeak.lock()) {
-		connection->close(FORCE_CLOSE);
-	}
-}
@@ -9,6 +9,10 @@
 
 static constexpr int32_t CONNECTION_WRITE_TIMEOUT = 30;
 static constexpr int32_t CONNECTION_READ_TIMEOUT = 30;
+// how often the read and write deadlines of every connection are checked, in milliseconds
+static constexpr int32_t CONNECTION_TIMEOUT_CHECK_INTERVAL = 1000;
+// maximum number of queued messages written together with a single gather write
+static constexpr size_t CONNECTION_WRITE_BATCH = 16;
 
 class Protocol;
 using Protocol_ptr = std::shared_ptr<Protocol>;
@@ -23,6 +27,14 @@ class ServicePort;
 using ServicePort_ptr = std::shared_ptr<ServicePort>;
 using ConstServicePort_ptr = std::shared_ptr<const ServicePort>;
 
+struct SendQueueStats {
+	uint64_t droppedPackets = 0;
+	uint64_t closedConnections = 0;
+	uint64_t writes = 0;
+	uint64_t writtenMessages = 0;
+	uint64_t writtenBytes = 0;
+};
+
 class ConnectionManager
 {
 	public:
@@ -34,12 +46,39 @@ class ConnectionManager
 		Connection_ptr createConnection(boost::asio::io_context& io_context, ConstServicePort_ptr servicePort);
 		void releaseConnection(const Connection_ptr& connection);
 		void closeAll();
+		// closes the connections whose read or write did not complete in time
+		void closeTimedOut();
+
+		void onPacketDropped() {
+			droppedPackets.fetch_add(1, std::memory_order_relaxed);
+		}
+		void onConnectionShed() {
+			closedConnections.fetch_add(1, std::memory_order_relaxed);
+		}
+		void onWrite(size_t messages, size_t bytes) {
+			writes.fetch_add(1, std::memory_order_relaxed);
+			writtenMessages.fetch_add(messages, std::memory_order_relaxed);
+			writtenBytes.fetch_add(bytes, std::memory_order_relaxed);
+		}
+		SendQueueStats getSendQueueStats() const {
+			return {droppedPackets.load(std::memory_order_relaxed), closedConnections.load(std::memory_order_relaxed),
+				writes.load(std::memory_order_relaxed), writtenMessages.load(std::memory_order_relaxed),
+				writtenBytes.load(std::memory_order_relaxed)};
+		}
 
 	private:
 		ConnectionManager() = default;
 
 		std::unordered_set<Connection_ptr> connections;
 		std::mutex connectionManagerLock;
+
+		// packets left out for congested clients and clients disconnected for not reading
+		std::atomic<uint64_t> droppedPackets{0};
+		std::atomic<uint64_t> closedConnections{0};
+		// gather writes issued and the messages they carried
+		std::atomic<uint64_t> writes{0};
+		std::atomic<uint64_t> writtenMessages{0};
+		std::atomic<uint64_t> writtenBytes{0};
 };
 
 class Connection : public std::enable_shared_from_this<Connection>
@@ -54,7 +93,6 @@ class Connection : public std::enable_shared_from_this<Connection>
 		Connection(boost::asio::io_context& io_context,
 		ConstServicePort_ptr service_port) :
 			readTimer(io_context),
-			writeTimer(io_context),
 			service_port(std::move(service_port)),
 			socket(io_context) {}
 		~Connection();
@@ -68,18 +106,27 @@ class Connection : public std::enable_shared_from_this<Connection>
 
 		void send(const OutputMessage_ptr& msg);
 
+		// any thread, true while more than sendQueueDegradeSize bytes wait to be sent
+		bool isSendQueueCongested() const;
+
+		// runs handler on the network thread that owns this connection, unless it got closed meanwhile
+		void post(std::function<void()>&& handler);
+
 		uint32_t getIP();
 
+		// the executor of the network thread that owns this connection
+		boost::asio::any_io_executor getExecutor() {
+			return socket.get_executor();
+		}
+
 	private:
 		void parseHeader(const boost::system::error_code& error);
 		void parsePacket(const boost::system::error_code& error);
 
 		void onWriteOperation(const boost::system::error_code& error);
 
-		static void handleTimeout(ConnectionWeak_ptr connectionWeak, const boost::system::error_code& error);
-
 		void closeSocket();
-		void internalSend(const OutputMessage_ptr& msg);
+		void internalSend();
 
 		boost::asio::ip::tcp::socket& getSocket() {
 			return socket;
@@ -88,12 +135,18 @@ class Connection : public std::enable_shared_from_this<Connection>
 
 		NetworkMessage msg;
 
+		// delays reading the next packet, the timeouts are deadlines checked by ConnectionManager
 		boost::asio::steady_timer readTimer;
-		boost::asio::steady_timer writeTimer;
+		std::atomic<int64_t> readDeadline{0};
+		std::atomic<int64_t> writeDeadline{0};
 
 		std::recursive_mutex connectionLock;
 
-		std::list<OutputMessage_ptr> messageQueue;
+		// messages being written come first, followed by the ones waiting for the next write
+		std::deque<OutputMessage_ptr> messageQueue;
+		size_t messagesInFlight = 0;
+		// buffer sizes of the queued messages
+		std::atomic<size_t> queuedBytes{0};
 
 		ConstServicePort_ptr service_port;
 		Protocol_ptr protocol;
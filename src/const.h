@@ -290,6 +290,8 @@ enum ReloadTypes_t : uint8_t  {
 	RELOAD_TYPE_NPCS,
 	RELOAD_TYPE_RAIDS,
 	RELOAD_TYPE_SCRIPTS,
+	RELOAD_TYPE_CHANGED_SCRIPTS,
+	RELOAD_TYPE_GUILDS,
 };
 
 static constexpr int32_t CHANNEL_GUILD = 0x00;
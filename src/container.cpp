@@ -6,6 +6,7 @@
 #include "container.h"
 #include "iomap.h"
 #include "game.h"
+#include "itemupdatebatch.h"
 
 extern Game g_game;
 
@@ -63,6 +64,7 @@ void Container::addItem(Item* item)
 	itemlist.push_back(item);
 	item->setParent(this);
 	updateItemWeight(item->getWeight());
+	updateItemHoldingCount(getHoldingCount(item));
 }
 
 void Container::addItemFront(Item* item)
@@ -70,6 +72,7 @@ void Container::addItemFront(Item* item)
 	itemlist.push_front(item);
 	item->setParent(this);
 	updateItemWeight(item->getWeight());
+	updateItemHoldingCount(getHoldingCount(item));
 
 	//send change to client
 	if (getParent() && (getParent() != VirtualCylinder::virtualCylinder)) {
@@ -118,7 +121,6 @@ bool Container::unserializeItemNode(OTB::Loader& loader, const OTB::Node& node,
 		}
 
 		addItem(item);
-		updateItemWeight(item->getWeight());
 	}
 	return true;
 }
@@ -131,6 +133,23 @@ void Container::updateItemWeight(int32_t diff)
 	}
 }
 
+void Container::updateItemHoldingCount(int32_t diff)
+{
+	totalItemCount += diff;
+	if (Container* parentContainer = getParentContainer()) {
+		parentContainer->updateItemHoldingCount(diff);
+	}
+}
+
+uint32_t Container::getHoldingCount(const Item* item)
+{
+	// the item itself and everything inside it
+	if (const Container* container = item->getContainer()) {
+		return 1 + container->getItemHoldingCount();
+	}
+	return 1;
+}
+
 uint32_t Container::getWeight() const
 {
 	return Item::getWeight() + totalWeight;
@@ -178,17 +197,14 @@ Item* Container::getItemByIndex(size_t index) const
 
 uint32_t Container::getItemHoldingCount() const
 {
-	uint32_t counter = 0;
-	for (ContainerIterator it = iterator(); it.hasNext(); it.advance()) {
-		++counter;
-	}
-	return counter;
+	return totalItemCount;
 }
 
 bool Container::isHoldingItem(const Item* item) const
 {
-	for (ContainerIterator it = iterator(); it.hasNext(); it.advance()) {
-		if (*it == item) {
+	// walking up from the item is bounded by the nesting depth, not by the size of this container
+	for (const Cylinder* parent = item->getParent(); parent; parent = parent->getParent()) {
+		if (parent == this) {
 			return true;
 		}
 	}
@@ -197,6 +213,11 @@ bool Container::isHoldingItem(const Item* item) const
 
 void Container::onAddContainerItem(Item* item)
 {
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->addContainerItem(this, item);
+		return;
+	}
+
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, getPosition(), false, true, 2, 2, 2, 2);
 
@@ -213,12 +234,19 @@ void Container::onAddContainerItem(Item* item)
 
 void Container::onUpdateContainerItem(uint32_t index, Item* oldItem, Item* newItem)
 {
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->updateContainerItem(this, oldItem, newItem);
+		return;
+	}
+
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, getPosition(), false, true, 2, 2, 2, 2);
 
 	//send to client
-	for (Creature* spectator : spectators) {
-		spectator->getPlayer()->sendUpdateContainerItem(this, index, newItem);
+	if (index < getClientWindowSize()) {
+		for (Creature* spectator : spectators) {
+			spectator->getPlayer()->sendUpdateContainerItem(this, index, newItem);
+		}
 	}
 
 	//event methods
@@ -229,16 +257,23 @@ void Container::onUpdateContainerItem(uint32_t index, Item* oldItem, Item* newIt
 
 void Container::onRemoveContainerItem(uint32_t index, Item* item)
 {
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->removeContainerItem(this, item);
+		return;
+	}
+
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, getPosition(), false, true, 2, 2, 2, 2);
 
 	//send change to client
-	for (Creature* spectator : spectators) {
-		if (size() >= capacity()) {
-			Player* player = spectator->getPlayer();
-			spectator->getPlayer()->sendContainer(player->getContainerID(this), this, hasParent());
-		} else {
-			spectator->getPlayer()->sendRemoveContainerItem(this, index);
+	if (index < getClientWindowSize()) {
+		for (Creature* spectator : spectators) {
+			if (size() >= getClientWindowSize()) {
+				// an item moves into the window from behind it, which the protocol can only show by sending the window again
+				spectator->getPlayer()->onSendContainer(this);
+			} else {
+				spectator->getPlayer()->sendRemoveContainerItem(this, index);
+			}
 		}
 	}
 
@@ -534,6 +569,7 @@ void Container::addThing(int32_t index, Thing* thing)
 	item->setParent(this);
 	itemlist.push_front(item);
 	updateItemWeight(item->getWeight());
+	updateItemHoldingCount(getHoldingCount(item));
 
 	//send change to client
 	if (getParent() && (getParent() != VirtualCylinder::virtualCylinder)) {
@@ -589,6 +625,7 @@ void Container::replaceThing(uint32_t index, Thing* thing)
 	itemlist[index] = item;
 	item->setParent(this);
 	updateItemWeight(-static_cast<int32_t>(replacedItem->getWeight()) + item->getWeight());
+	updateItemHoldingCount(-static_cast<int32_t>(getHoldingCount(replacedItem)) + getHoldingCount(item));
 
 	//send change to client
 	if (getParent()) {
@@ -622,6 +659,7 @@ void Container::removeThing(Thing* thing, uint32_t count)
 		}
 	} else {
 		updateItemWeight(-static_cast<int32_t>(item->getWeight()));
+		updateItemHoldingCount(-static_cast<int32_t>(getHoldingCount(item)));
 
 		item->setParent(nullptr);
 		itemlist.erase(itemlist.begin() + index);
@@ -739,6 +777,7 @@ void Container::internalAddThing(uint32_t, Thing* thing)
 	item->setParent(this);
 	itemlist.push_front(item);
 	updateItemWeight(item->getWeight());
+	updateItemHoldingCount(getHoldingCount(item));
 }
 
 void Container::startDecaying()
@@ -755,6 +794,15 @@ void Container::startDecaying()
 	}
 }
 
+void Container::onRemoved()
+{
+	Item::onRemoved();
+
+	for (ContainerIterator it = iterator(); it.hasNext(); it.advance()) {
+		g_game.stopDecay(*it);
+	}
+}
+
 ContainerIterator Container::iterator() const
 {
 	ContainerIterator cit;
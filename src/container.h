@@ -72,6 +72,10 @@ class Container : public Item, public Cylinder
 		uint32_t capacity() const {
 			return maxSize;
 		}
+		// the client only gets the first items of a container, changes past them are not sent
+		uint32_t getClientWindowSize() const {
+			return std::min<uint32_t>(maxSize, std::numeric_limits<uint8_t>::max());
+		}
 
 		ContainerIterator iterator() const;
 
@@ -130,6 +134,8 @@ class Container : public Item, public Cylinder
 		void internalAddThing(Thing* thing) override final;
 		void internalAddThing(uint32_t index, Thing* thing) override final;
 		void startDecaying() override final;
+		// the decay wheel holds a reference to every decaying item, the content leaves it with the container
+		void onRemoved() override;
 
 	protected:
 		ItemDeque itemlist;
@@ -139,6 +145,8 @@ class Container : public Item, public Cylinder
 
 		uint32_t maxSize;
 		uint32_t totalWeight = 0;
+		// every item held, nested containers and their contents included
+		uint32_t totalItemCount = 0;
 		uint32_t serializationCount = 0;
 
 		void onAddContainerItem(Item* item);
@@ -147,6 +155,8 @@ class Container : public Item, public Cylinder
 
 		Container* getParentContainer();
 		void updateItemWeight(int32_t diff);
+		void updateItemHoldingCount(int32_t diff);
+		static uint32_t getHoldingCount(const Item* item);
 
 		friend class ContainerIterator;
 		friend class IOMap;
@@ -8,6 +8,7 @@
 #include "monster.h"
 #include "configmanager.h"
 #include "scheduler.h"
+#include "profiler.h"
 
 extern Game g_game;
 extern ConfigManager g_config;
@@ -78,6 +79,7 @@ void Creature::setSkull(Skulls_t newSkull)
 
 void Creature::onThink(uint32_t interval)
 {
+	PROFILE_FUNCTION();
 	if (followCreature && master != followCreature && !canSeeCreature(followCreature)) {
 		onCreatureDisappear(followCreature, false);
 	}
@@ -895,6 +897,7 @@ bool Creature::addCondition(Condition* condition)
 
 	if (condition->startCondition(this)) {
 		conditions.push_back(condition);
+		g_game.addConditionCreature(this);
 		onAddCondition(condition->getType());
 		return true;
 	}
@@ -918,41 +921,36 @@ bool Creature::addCombatCondition(Condition* condition)
 
 void Creature::removeCondition(ConditionType_t type)
 {
-	auto it = conditions.begin();
-	const auto& end = conditions.end();
-	while (it != end) {
+	// ending a condition can change the list, so the search starts over after each one
+	auto matches = [type](const Condition* condition) { return condition->getType() == type; };
+	auto it = std::find_if(conditions.begin(), conditions.end(), matches);
+	while (it != conditions.end()) {
 		Condition* condition = *it;
-		if (condition->getType() != type) {
-			++it;
-			continue;
-		}
-
-		it = conditions.erase(it);
+		conditions.erase(it);
 
 		condition->endCondition(this);
 		delete condition;
 
 		onEndCondition(type);
+
+		it = std::find_if(conditions.begin(), conditions.end(), matches);
 	}
 }
 
 void Creature::removeCondition(ConditionType_t type, ConditionId_t conditionId)
 {
-	auto it = conditions.begin();
-	const auto& end = conditions.end();
-	while (it != end) {
+	auto matches = [type, conditionId](const Condition* condition) { return condition->getType() == type && condition->getId() == conditionId; };
+	auto it = std::find_if(conditions.begin(), conditions.end(), matches);
+	while (it != conditions.end()) {
 		Condition* condition = *it;
-		if (condition->getType() != type || condition->getId() != conditionId) {
-			++it;
-			continue;
-		}
-
-		it = conditions.erase(it);
+		conditions.erase(it);
 
 		condition->endCondition(this);
 		delete condition;
 
 		onEndCondition(type);
+
+		it = std::find_if(conditions.begin(), conditions.end(), matches);
 	}
 }
 
@@ -1091,18 +1089,14 @@ bool Creature::registerCreatureEvent(const std::string& name)
 		return false;
 	}
 
-	const CreatureEventType_t type = event->getEventType();
-	if (hasEventRegistered(type)) {
-		for (const CreatureEvent* creatureEvent : eventsList) {
-			if (creatureEvent == event) {
-				return false;
-			}
-		}
-	} else {
-		scriptEventsBitField |= static_cast<uint32_t>(1) << type;
+	auto& registered = eventsByType[event->getEventType()];
+	if (registered && std::find(registered->begin(), registered->end(), event) != registered->end()) {
+		return false;
 	}
 
-	eventsList.push_back(event);
+	auto events = registered ? std::make_shared<CreatureEventList::Events>(*registered) : std::make_shared<CreatureEventList::Events>();
+	events->push_back(event);
+	registered = std::move(events);
 	return true;
 }
 
@@ -1113,52 +1107,25 @@ bool Creature::unregisterCreatureEvent(const std::string& name)
 		return false;
 	}
 
-	const CreatureEventType_t type = event->getEventType();
-	if (!hasEventRegistered(type)) {
+	auto& registered = eventsByType[event->getEventType()];
+	if (!registered) {
 		return false;
 	}
 
-	bool resetTypeBit = true;
-
-	auto it = eventsList.begin(), end = eventsList.end();
-	while (it != end) {
-		const CreatureEvent* curEvent = *it;
-		if (curEvent == event) {
-			it = eventsList.erase(it);
-			continue;
-		}
-
-		if (curEvent->getEventType() == type) {
-			resetTypeBit = false;
-		}
-		++it;
-	}
-
-	if (resetTypeBit) {
-		scriptEventsBitField &= ~(static_cast<uint32_t>(1) << type);
-	}
-	return true;
-}
-
-CreatureEventList Creature::getCreatureEvents(CreatureEventType_t type) const
-{
-	CreatureEventList tmpEventList;
-
-	if (!hasEventRegistered(type)) {
-		return tmpEventList;
+	auto it = std::find(registered->begin(), registered->end(), event);
+	if (it == registered->end()) {
+		return true;
 	}
 
-	for (CreatureEvent* creatureEvent : eventsList) {
-		if (!creatureEvent->isLoaded()) {
-			continue;
-		}
-
-		if (creatureEvent->getEventType() == type) {
-			tmpEventList.push_back(creatureEvent);
-		}
+	if (registered->size() == 1) {
+		registered.reset();
+		return true;
 	}
 
-	return tmpEventList;
+	auto events = std::make_shared<CreatureEventList::Events>(*registered);
+	events->erase(events->begin() + (it - registered->begin()));
+	registered = std::move(events);
+	return true;
 }
 
 bool FrozenPathingConditionCall::isInRange(const Position& startPos, const Position& testPos,
@@ -1272,9 +1239,166 @@ void Creature::onWalk(Direction& dir, uint32_t& flags)
 	}
 }
 
+namespace {
+
+// paths found during the current dispatcher cycle, a creature standing on one of them walks its remainder
+struct CachedPath
+{
+	Position targetPos;
+	FindPathParams fpp;
+	std::vector<Position> positions;
+	std::vector<Direction> dirList;
+};
+
+std::vector<CachedPath> pathCache;
+uint64_t pathCacheCycle = 0;
+
+void refreshPathCache()
+{
+	if (pathCacheCycle != g_dispatcher.getDispatcherCycle()) {
+		pathCacheCycle = g_dispatcher.getDispatcherCycle();
+		pathCache.clear();
+	}
+}
+
+}
+
 bool Creature::getPathTo(const Position& targetPos, std::vector<Direction>& dirList, const FindPathParams& fpp)
 {
-	return g_game.map.getPathMatching(*this, dirList, FrozenPathingConditionCall(targetPos), fpp);
+	if (!getMonster()) {
+		return g_game.map.getPathMatching(*this, dirList, FrozenPathingConditionCall(targetPos), fpp);
+	}
+
+	if (getReusablePath(targetPos, dirList, fpp)) {
+		return true;
+	}
+
+	const Position& startPos = getPosition();
+	if (!g_game.map.getPathMatching(*this, dirList, FrozenPathingConditionCall(targetPos), fpp)) {
+		lastPath.clear();
+		return false;
+	}
+
+	lastPath = dirList;
+	lastPathStart = startPos;
+	lastPathTarget = targetPos;
+	lastPathParams = fpp;
+	lastPathRepairs = 0;
+
+	CachedPath& cachedPath = pathCache.emplace_back();
+	cachedPath.targetPos = targetPos;
+	cachedPath.fpp = fpp;
+	cachedPath.dirList = dirList;
+	cachedPath.positions.reserve(dirList.size() + 1);
+	cachedPath.positions.push_back(startPos);
+	for (Direction dir : dirList) {
+		cachedPath.positions.push_back(getNextPosition(dir, cachedPath.positions.back()));
+	}
+	return true;
+}
+
+bool Creature::getReusablePath(const Position& targetPos, std::vector<Direction>& dirList, const FindPathParams& fpp)
+{
+	refreshPathCache();
+
+	const Position& startPos = getPosition();
+	const FrozenPathingConditionCall pathCondition(targetPos);
+
+	// another creature found a path to the same target this cycle and we stand on it
+	for (const CachedPath& cachedPath : pathCache) {
+		if (cachedPath.targetPos != targetPos || cachedPath.fpp != fpp) {
+			continue;
+		}
+
+		auto it = std::find(cachedPath.positions.begin(), cachedPath.positions.end(), startPos);
+		if (it == cachedPath.positions.end()) {
+			continue;
+		}
+
+		std::vector<Direction> remainder(cachedPath.dirList.begin() + std::distance(cachedPath.positions.begin(), it), cachedPath.dirList.end());
+		if (isPathWalkable(startPos, remainder, pathCondition, fpp) && isPathEndMatching(startPos, cachedPath.positions.back(), pathCondition, fpp)) {
+			dirList.insert(dirList.end(), remainder.begin(), remainder.end());
+			return true;
+		}
+	}
+
+	// our own previous path, if we are still on it and the target moved one step at most
+	if (lastPath.empty() || lastPathRepairs >= MAX_PATH_REPAIRS || lastPathParams != fpp || lastPathTarget.z != targetPos.z ||
+	        Position::getDistanceX(lastPathTarget, targetPos) > 1 || Position::getDistanceY(lastPathTarget, targetPos) > 1) {
+		return false;
+	}
+
+	Position pos = lastPathStart;
+	size_t walked = 0;
+	while (pos != startPos && walked < lastPath.size()) {
+		pos = getNextPosition(lastPath[walked++], pos);
+	}
+
+	if (pos != startPos) {
+		return false;
+	}
+
+	std::vector<Direction> remainder(lastPath.begin() + walked, lastPath.end());
+	if (!isPathWalkable(startPos, remainder, pathCondition, fpp)) {
+		return false;
+	}
+
+	Position endPos = startPos;
+	for (Direction dir : remainder) {
+		endPos = getNextPosition(dir, endPos);
+	}
+
+	if (!isPathEndMatching(startPos, endPos, pathCondition, fpp)) {
+		if (targetPos == lastPathTarget) {
+			return false;
+		}
+
+		// follow the target's last step
+		remainder.push_back(getDirectionTo(endPos, targetPos));
+		if (!fpp.allowDiagonal && (remainder.back() & DIRECTION_DIAGONAL_MASK)) {
+			return false;
+		}
+
+		endPos = getNextPosition(remainder.back(), endPos);
+		if (endPos == targetPos || !g_game.map.canWalkTo(*this, endPos) || !isPathEndMatching(startPos, endPos, pathCondition, fpp)) {
+			return false;
+		}
+	}
+
+	lastPath = remainder;
+	lastPathStart = startPos;
+	lastPathTarget = targetPos;
+	++lastPathRepairs;
+
+	dirList.insert(dirList.end(), remainder.begin(), remainder.end());
+	return true;
+}
+
+bool Creature::isPathWalkable(const Position& startPos, const std::vector<Direction>& dirList, const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const
+{
+	Position pos = startPos;
+	for (Direction dir : dirList) {
+		pos = getNextPosition(dir, pos);
+		if (fpp.maxSearchDist != 0 && (Position::getDistanceX(startPos, pos) > fpp.maxSearchDist || Position::getDistanceY(startPos, pos) > fpp.maxSearchDist)) {
+			return false;
+		}
+
+		if (fpp.keepDistance && !pathCondition.isInRange(startPos, pos, fpp)) {
+			return false;
+		}
+
+		if (!g_game.map.canWalkTo(*this, pos)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Creature::isPathEndMatching(const Position& startPos, const Position& endPos, const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const
+{
+	// only accept what the search would have stopped at right away
+	int32_t bestMatch = 0;
+	return pathCondition(startPos, endPos, fpp, bestMatch) && bestMatch == 0;
 }
 
 bool Creature::getPathTo(const Position& targetPos, std::vector<Direction>& dirList, int32_t minTargetDist, int32_t maxTargetDist, bool fullPathSearch /*= true*/, bool clearSight /*= true*/, int32_t maxSearchDist /*= 0*/)
@@ -1394,7 +1518,7 @@ void Creature::addWalkToDo(Direction dir)
 	ToDoEntry toDoEntry;
 	totalToDo++;
 	toDoEntry.type = TODO_WALK;
-	toDoEntry.function = std::bind(&Game::moveCreature, &g_game, this, dir, FLAG_IGNOREFIELDDAMAGE);
+	toDoEntry.direction = dir;
 	toDoEntries.push_back(toDoEntry);
 }
 
@@ -1495,11 +1619,7 @@ void Creature::startToDo()
 
 	const int64_t delay = calculateToDoDelay();
 	earliestWakeUpTime = OTSYS_TIME() + delay;
-	if (delay > 50) {
-		g_scheduler.addEvent(createSchedulerTask(static_cast<uint32_t>(delay), std::bind(&Game::executeCreature, &g_game, getID())));
-	} else {
-		g_scheduler.addEvent(createSchedulerTask(50, std::bind(&Game::executeCreature, &g_game, getID())));
-	}
+	g_game.scheduleCreatureExecution(this);
 }
 
 void Creature::executeToDoEntries()
@@ -1520,11 +1640,7 @@ void Creature::executeToDoEntries()
 				}
 			} else {
 				earliestWakeUpTime = OTSYS_TIME() + delay;
-				if (delay > 50) {
-					g_scheduler.addEvent(createSchedulerTask(static_cast<uint32_t>(delay), std::bind(&Game::executeCreature, &g_game, getID())));
-				} else {
-					g_scheduler.addEvent(createSchedulerTask(50, std::bind(&Game::executeCreature, &g_game, getID())));
-				}
+				g_game.scheduleCreatureExecution(this);
 			}
 
 			return;
@@ -1533,7 +1649,9 @@ void Creature::executeToDoEntries()
 		ToDoEntry& toDoEntry = toDoEntries[currentToDo];
 		currentToDo++;
 
-		if (toDoEntry.type >= TODO_ACTION) {
+		if (toDoEntry.type == TODO_WALK) {
+			g_game.moveCreature(this, toDoEntry.direction, FLAG_IGNOREFIELDDAMAGE);
+		} else if (toDoEntry.type >= TODO_ACTION) {
 			if (toDoEntry.function) {
 				toDoEntry.function();
 			}
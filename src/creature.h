@@ -11,8 +11,83 @@
 #include "enums.h"
 #include "creatureevent.h"
 
-using ConditionList = std::list<Condition*>;
-using CreatureEventList = std::list<CreatureEvent*>;
+#include <boost/container/small_vector.hpp>
+
+// creatures rarely carry more than a few conditions at once
+using ConditionList = boost::container::small_vector<Condition*, 4>;
+
+/*
+ * The loaded events of one type registered to a creature. It shares the list of the creature, which
+ * is replaced instead of changed, so events registered or unregistered while it is iterated do not
+ * affect it.
+ */
+class CreatureEventList
+{
+	public:
+		using Events = std::vector<CreatureEvent*>;
+
+		class iterator
+		{
+			public:
+				iterator(Events::const_iterator it, Events::const_iterator end) : it(it), end(end) {
+					skipUnloaded();
+				}
+
+				CreatureEvent* operator*() const {
+					return *it;
+				}
+				iterator& operator++() {
+					++it;
+					skipUnloaded();
+					return *this;
+				}
+				bool operator==(const iterator& other) const {
+					return it == other.it;
+				}
+
+			private:
+				// events of a script that was reloaded without them stay registered until the creature is gone
+				void skipUnloaded() {
+					while (it != end && !(*it)->isLoaded()) {
+						++it;
+					}
+				}
+
+				Events::const_iterator it;
+				Events::const_iterator end;
+		};
+
+		CreatureEventList() = default;
+		explicit CreatureEventList(std::shared_ptr<const Events> events) : events(std::move(events)) {}
+
+		iterator begin() const {
+			const Events& list = getEvents();
+			return {list.begin(), list.end()};
+		}
+		iterator end() const {
+			const Events& list = getEvents();
+			return {list.end(), list.end()};
+		}
+
+		bool empty() const {
+			return begin() == end();
+		}
+		size_t size() const {
+			size_t size = 0;
+			for (auto it = begin(), last = end(); it != last; ++it) {
+				++size;
+			}
+			return size;
+		}
+
+	private:
+		const Events& getEvents() const {
+			static const Events noEvents;
+			return events ? *events : noEvents;
+		}
+
+		std::shared_ptr<const Events> events;
+};
 
 enum slots_t : uint8_t {
 	CONST_SLOT_WHEREEVER = 0,
@@ -39,8 +114,13 @@ struct FindPathParams {
 	int32_t maxSearchDist = 0;
 	int32_t minTargetDist = -1;
 	int32_t maxTargetDist = -1;
+
+	bool operator==(const FindPathParams&) const = default;
 };
 
+// number of times a monster path is extended by the target's last step before it is searched again
+static constexpr int32_t MAX_PATH_REPAIRS = 4;
+
 enum ToDoType_t : uint8_t {
 	TODO_NONE,
 	TODO_WAIT,
@@ -52,7 +132,11 @@ enum ToDoType_t : uint8_t {
 
 struct ToDoEntry {
 	ToDoType_t type = TODO_NONE;
+	// the step of a TODO_WALK
+	Direction direction = DIRECTION_NONE;
+	// when a TODO_WAIT ends
 	int64_t time = 0;
+	// only TODO_ACTION and TODO_USEEX carry a function
 	std::function<void(void)> function;
 };
 
@@ -68,6 +152,8 @@ class Tile;
 static constexpr int32_t EVENT_CREATURECOUNT = 10;
 static constexpr int32_t EVENT_CREATURE_THINK_INTERVAL = 1000;
 static constexpr int32_t EVENT_CHECK_CREATURE_INTERVAL = (EVENT_CREATURE_THINK_INTERVAL / EVENT_CREATURECOUNT);
+// granularity of the wheel the to do entries of creatures are run from
+static constexpr int32_t EVENT_EXECUTE_INTERVAL = 50;
 static constexpr int32_t CREATURE_DAMAGEMAP_SIZE = 20;
 
 class FrozenPathingConditionCall
@@ -364,11 +450,19 @@ class Creature : virtual public Thing
 		virtual void onRemoveCreature(Creature* creature, bool isLogout);
 		virtual void onCreatureMove(Creature* creature, const Tile* newTile, const Position& newPos,
 		                            const Tile* oldTile, const Position& oldPos, bool teleport);
+		// whether onCreatureMove does anything when creature moves in view, every step asks all spectators
+		virtual bool caresAboutMove(const Creature* creature) const {
+			return creature == this || creature == followCreature || creature == attackedCreature;
+		}
 
 		virtual void onAttackedCreatureDisappear(bool) {}
 		virtual void onFollowCreatureDisappear(bool) {}
 
 		virtual void onCreatureSay(Creature*, SpeakClasses, const std::string&) {}
+		// players always hear what is said around them, other creatures only when onCreatureSay does something
+		virtual bool canHear() const {
+			return false;
+		}
 
 		virtual void onPlacedCreature() {}
 
@@ -466,13 +560,31 @@ class Creature : virtual public Thing
 		static constexpr int32_t maxWalkCacheWidth = (mapWalkWidth - 1) / 2;
 		static constexpr int32_t maxWalkCacheHeight = (mapWalkHeight - 1) / 2;
 
+		// read for every creature by spectator lookups, checkCreatures, combat and pathfinding,
+		// kept together at the start of the object so those touch a single cache line
 		Position position;
+		Tile* currentTile = nullptr;
+		uint32_t id = 0;
+		int32_t health = 1000;
+		int32_t healthMax = 1000;
+		uint32_t baseSpeed = 70;
+		int32_t varSpeed = 0;
+		Direction direction = DIRECTION_SOUTH;
+		bool isInternalRemoved = false;
+		bool creatureCheck = false;
+		bool inCheckCreaturesVector = false;
+		bool inConditionCreatures = false;
+		bool movementBlocked = false;
+		Creature* attackedCreature = nullptr;
+		Creature* followCreature = nullptr;
+		Creature* master = nullptr;
 
 		std::array<CountBlock_t, CREATURE_DAMAGEMAP_SIZE> damageMap;
 		uint8_t actDamageEntry = 0;
 
 		std::list<Creature*> summons;
-		CreatureEventList eventsList;
+		// the registered events by type, nullptr for a type without any
+		std::array<std::shared_ptr<const CreatureEventList::Events>, CREATURE_EVENT_TYPES> eventsByType;
 		ConditionList conditions;
 
 		bool isExecuting = false;
@@ -481,10 +593,16 @@ class Creature : virtual public Thing
 		int32_t currentToDo = 0;
 		std::vector<ToDoEntry> toDoEntries;
 
-		Tile* currentTile = nullptr;
-		Creature* attackedCreature = nullptr;
-		Creature* followCreature = nullptr;
-		Creature* master = nullptr;
+		// monsters chasing a target reuse paths instead of searching again
+		bool getReusablePath(const Position& targetPos, std::vector<Direction>& dirList, const FindPathParams& fpp);
+		bool isPathWalkable(const Position& startPos, const std::vector<Direction>& dirList, const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const;
+		bool isPathEndMatching(const Position& startPos, const Position& endPos, const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const;
+
+		std::vector<Direction> lastPath;
+		Position lastPathStart;
+		Position lastPathTarget;
+		FindPathParams lastPathParams;
+		int32_t lastPathRepairs = 0;
 
 		uint64_t totalCombatDamageReceived = 0;
 		uint64_t lastDefense = OTSYS_TIME();
@@ -493,41 +611,33 @@ class Creature : virtual public Thing
 		int64_t earliestWakeUpTime = 0;
 
 		uint32_t referenceCounter = 0;
-		uint32_t id = 0;
-		uint32_t scriptEventsBitField = 0;
 		uint32_t lastHitCreatureId = 0;
 		uint32_t blockCount = 0;
 		uint32_t blockTicks = 0;
-		uint32_t baseSpeed = 70;
 		uint32_t lastKilledCreatureIdEvent = 0;
-		int32_t varSpeed = 0;
-		int32_t health = 1000;
-		int32_t healthMax = 1000;
 
 		Outfit_t currentOutfit;
 		Outfit_t defaultOutfit;
 
 		Position lastPosition;
 
-		Direction direction = DIRECTION_SOUTH;
 		Skulls_t skull = SKULL_NONE;
 
-		bool isInternalRemoved = false;
-		bool creatureCheck = false;
-		bool inCheckCreaturesVector = false;
 		bool skillLoss = true;
 		bool lootDrop = true;
 		bool hiddenHealth = false;
 		bool canUseDefense = true;
-		bool movementBlocked = false;
 
 		//creature script events
 		bool hasEventRegistered(CreatureEventType_t event) const {
-			return (0 != (scriptEventsBitField & (static_cast<uint32_t>(1) << event)));
+			return eventsByType[event] != nullptr;
+		}
+		CreatureEventList getCreatureEvents(CreatureEventType_t type) const {
+			return CreatureEventList(eventsByType[type]);
 		}
-		CreatureEventList getCreatureEvents(CreatureEventType_t type) const;
 
 		void onCreatureDisappear(const Creature* creature, bool isLogout);
+
 		virtual void doAttacking() {}
 
 		virtual uint64_t getLostExperience() const {
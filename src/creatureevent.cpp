@@ -29,6 +29,16 @@ void CreatureEvents::removeInvalidEvents()
 	}
 }
 
+void CreatureEvents::removeScriptFile(const std::string* scriptFile)
+{
+	// creatures keep pointers to their events, the file registers them again into the unloaded ones
+	for (auto& it : creatureEvents) {
+		if (it.second.isFromScriptFile(scriptFile)) {
+			it.second.clearEvent();
+		}
+	}
+}
+
 LuaScriptInterface& CreatureEvents::getScriptInterface()
 {
 	return scriptInterface;
@@ -181,6 +191,7 @@ void CreatureEvent::copyEvent(CreatureEvent* creatureEvent)
 {
 	scriptId = creatureEvent->scriptId;
 	scriptInterface = creatureEvent->scriptInterface;
+	scriptFile = creatureEvent->scriptFile;
 	loaded = creatureEvent->loaded;
 }
 
@@ -27,6 +27,8 @@ enum CreatureEventType_t {
 	CREATURE_EVENT_EXTENDED_OPCODE, // otclient additional network opcodes
 };
 
+static constexpr size_t CREATURE_EVENT_TYPES = CREATURE_EVENT_EXTENDED_OPCODE + 1;
+
 class CreatureEvent final : public ScriptEvent
 {
 	public:
@@ -98,6 +100,7 @@ class CreatureEvents final
 
 		bool registerLuaEvent(CreatureEvent* event);
 		void clear();
+		void removeScriptFile(const std::string* scriptFile);
 
 		void removeInvalidEvents();
 
@@ -0,0 +1,129 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <deque>
+
+/*
+ * The monsters or npcs of the game by id. An id is the base of the table, a generation and a slot:
+ * a lookup is an index and a compare, and the id of a creature that is gone no longer matches its
+ * slot. Slots are reused oldest first and only once MIN_FREE_SLOTS of them are free, so the same
+ * id comes around again only after millions of creatures were removed, long after a client forgot
+ * it. The creatures are also kept in a dense list to be walked. Dispatcher thread only.
+ */
+template<typename T>
+class CreatureTable
+{
+	public:
+		static constexpr uint32_t SLOT_BITS = 20;
+		static constexpr uint32_t GENERATION_BITS = 10;
+		static constexpr uint32_t MAX_SLOTS = 1 << SLOT_BITS;
+		static constexpr size_t MIN_FREE_SLOTS = 1 << 16;
+
+		explicit CreatureTable(uint32_t baseId) : baseId(baseId) {}
+
+		// a new id, 0 if every slot is taken
+		uint32_t reserveId() {
+			uint32_t slot;
+			if (freeSlots.size() > MIN_FREE_SLOTS || (slots.size() == MAX_SLOTS && !freeSlots.empty())) {
+				slot = freeSlots.front();
+				freeSlots.pop_front();
+			} else if (slots.size() < MAX_SLOTS) {
+				slot = static_cast<uint32_t>(slots.size());
+				slots.emplace_back();
+			} else {
+				return 0;
+			}
+
+			slots[slot].reserved = true;
+			return baseId | (static_cast<uint32_t>(slots[slot].generation) << SLOT_BITS) | slot;
+		}
+
+		// whether id was reserved and not released since
+		bool isReserved(uint32_t id) const {
+			const Slot* slot = getSlot(id);
+			return slot && slot->reserved;
+		}
+
+		// creature's id must be reserved
+		void insert(T* creature) {
+			Slot& slot = slots[creature->getID() & SLOT_MASK];
+			if (slot.creature) {
+				return;
+			}
+
+			slot.creature = creature;
+			slot.index = static_cast<uint32_t>(creatures.size());
+			creatures.push_back(creature);
+		}
+
+		// releases the id, lookups of it fail from now on
+		void erase(uint32_t id) {
+			Slot* slot = getSlot(id);
+			if (!slot || !slot->reserved) {
+				return;
+			}
+
+			if (slot->creature) {
+				T* last = creatures.back();
+				creatures[slot->index] = last;
+				slots[last->getID() & SLOT_MASK].index = slot->index;
+				creatures.pop_back();
+			}
+
+			slot->creature = nullptr;
+			slot->reserved = false;
+			slot->generation = (slot->generation + 1) & GENERATION_MASK;
+			freeSlots.push_back(id & SLOT_MASK);
+		}
+
+		T* get(uint32_t id) const {
+			const Slot* slot = getSlot(id);
+			return slot ? slot->creature : nullptr;
+		}
+
+		size_t size() const {
+			return creatures.size();
+		}
+
+		typename std::vector<T*>::const_iterator begin() const {
+			return creatures.begin();
+		}
+		typename std::vector<T*>::const_iterator end() const {
+			return creatures.end();
+		}
+
+	private:
+		static constexpr uint32_t SLOT_MASK = MAX_SLOTS - 1;
+		static constexpr uint32_t GENERATION_MASK = (1 << GENERATION_BITS) - 1;
+		static constexpr uint32_t ID_MASK = (1 << (SLOT_BITS + GENERATION_BITS)) - 1;
+
+		struct Slot {
+			T* creature = nullptr;
+			uint32_t index = 0;
+			uint16_t generation = 0;
+			bool reserved = false;
+		};
+
+		const Slot* getSlot(uint32_t id) const {
+			const uint32_t slot = id & SLOT_MASK;
+			if ((id & ~ID_MASK) != baseId || slot >= slots.size()) {
+				return nullptr;
+			}
+
+			const Slot& entry = slots[slot];
+			if (entry.generation != ((id >> SLOT_BITS) & GENERATION_MASK)) {
+				return nullptr;
+			}
+			return &entry;
+		}
+		Slot* getSlot(uint32_t id) {
+			return const_cast<Slot*>(std::as_const(*this).getSlot(id));
+		}
+
+		std::vector<Slot> slots;
+		std::deque<uint32_t> freeSlots;
+		std::vector<T*> creatures;
+		const uint32_t baseId;
+};
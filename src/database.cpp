@@ -5,25 +5,44 @@
 
 #include "configmanager.h"
 #include "database.h"
+#include "logger.h"
 
 #include <mysql/errmsg.h>
 
 extern ConfigManager g_config;
 
+namespace {
+
+bool isConnectionError(unsigned int error)
+{
+	return error == CR_SERVER_LOST || error == CR_SERVER_GONE_ERROR || error == CR_CONN_HOST_ERROR || error == 1053/*ER_SERVER_SHUTDOWN*/ || error == CR_CONNECTION_ERROR;
+}
+
+}
+
 Database::~Database()
 {
-	if (handle != nullptr) {
-		mysql_close(handle);
+	disconnect();
+}
+
+void Database::disconnect()
+{
+	std::lock_guard<std::mutex> lockClass(poolLock);
+	for (auto& connection : connections) {
+		clearStatements(*connection);
+		mysql_close(connection->handle);
 	}
+	connections.clear();
+	freeConnections.clear();
 }
 
-bool Database::connect()
+MYSQL* Database::openConnection()
 {
 	// connection handle initialization
-	handle = mysql_init(nullptr);
+	MYSQL* handle = mysql_init(nullptr);
 	if (!handle) {
 		std::cout << std::endl << "Failed to initialize MySQL connection handle." << std::endl;
-		return false;
+		return nullptr;
 	}
 
 	// automatic reconnect
@@ -43,7 +62,23 @@ bool Database::connect()
 	// connects to database
 	if (!mysql_real_connect(handle, g_config.getString(ConfigManager::MYSQL_HOST).c_str(), g_config.getString(ConfigManager::MYSQL_USER).c_str(), g_config.getString(ConfigManager::MYSQL_PASS).c_str(), g_config.getString(ConfigManager::MYSQL_DB).c_str(), g_config.getNumber(ConfigManager::SQL_PORT), g_config.getString(ConfigManager::MYSQL_SOCK).c_str(), 0)) {
 		std::cout << std::endl << "MySQL Error Message: " << mysql_error(handle) << std::endl;
-		return false;
+		mysql_close(handle);
+		return nullptr;
+	}
+	return handle;
+}
+
+bool Database::connect(size_t connectionCount/* = 1*/)
+{
+	for (size_t i = 0; i < std::max<size_t>(1, connectionCount); ++i) {
+		MYSQL* handle = openConnection();
+		if (!handle) {
+			return false;
+		}
+
+		auto& connection = connections.emplace_back(std::make_unique<Connection>());
+		connection->handle = handle;
+		freeConnections.push_back(connection.get());
 	}
 
 	DBResult_ptr result = storeQuery("SHOW VARIABLES LIKE 'max_allowed_packet'");
@@ -53,38 +88,103 @@ bool Database::connect()
 	return true;
 }
 
-bool Database::beginTransaction()
+Database::Connection* Database::acquireConnection()
 {
-	if (!executeQuery("BEGIN")) {
-		return false;
+	const std::thread::id thisThread = std::this_thread::get_id();
+
+	std::unique_lock<std::mutex> poolLockUnique(poolLock);
+	for (auto& connection : connections) {
+		if (connection->transactionDepth != 0 && connection->transactionThread == thisThread) {
+			return connection.get();
+		}
 	}
 
-	databaseLock.lock();
-	return true;
+	if (connections.empty()) {
+		return nullptr;
+	}
+
+	poolSignal.wait(poolLockUnique, [this]() { return !freeConnections.empty(); });
+	Connection* connection = freeConnections.back();
+	freeConnections.pop_back();
+	return connection;
 }
 
-bool Database::rollback()
+void Database::releaseConnection(Connection* connection)
+{
+	{
+		std::lock_guard<std::mutex> lockClass(poolLock);
+		if (connection->transactionDepth != 0) {
+			return;
+		}
+		freeConnections.push_back(connection);
+	}
+	poolSignal.notify_one();
+}
+
+bool Database::beginTransaction()
 {
-	if (mysql_rollback(handle) != 0) {
-		std::cout << "[Error - mysql_rollback] Message: " << mysql_error(handle) << std::endl;
-		databaseLock.unlock();
+	Connection* connection = acquireConnection();
+	if (!connection) {
 		return false;
 	}
 
-	databaseLock.unlock();
+	{
+		std::lock_guard<std::mutex> lockClass(poolLock);
+		connection->transactionThread = std::this_thread::get_id();
+		connection->transactionDepth++;
+	}
+
+	if (!executeQuery("BEGIN")) {
+		{
+			std::lock_guard<std::mutex> lockClass(poolLock);
+			connection->transactionDepth--;
+		}
+		releaseConnection(connection);
+		return false;
+	}
 	return true;
 }
 
-bool Database::commit()
+bool Database::endTransaction(bool commit)
 {
-	if (mysql_commit(handle) != 0) {
-		std::cout << "[Error - mysql_commit] Message: " << mysql_error(handle) << std::endl;
-		databaseLock.unlock();
+	Connection* connection = acquireConnection();
+	if (!connection) {
 		return false;
 	}
 
-	databaseLock.unlock();
-	return true;
+	if (connection->transactionDepth == 0) {
+		// the transaction never started
+		releaseConnection(connection);
+		return false;
+	}
+
+	bool success = true;
+	if (commit) {
+		if (mysql_commit(connection->handle) != 0) {
+			std::cout << "[Error - mysql_commit] Message: " << mysql_error(connection->handle) << std::endl;
+			success = false;
+		}
+	} else if (mysql_rollback(connection->handle) != 0) {
+		std::cout << "[Error - mysql_rollback] Message: " << mysql_error(connection->handle) << std::endl;
+		success = false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lockClass(poolLock);
+		connection->transactionDepth--;
+	}
+	releaseConnection(connection);
+	return success;
+}
+
+bool Database::rollback()
+{
+	return endTransaction(false);
+}
+
+bool Database::commit()
+{
+	return endTransaction(true);
 }
 
 bool Database::executeQuery(const std::string& query)
@@ -92,12 +192,16 @@ bool Database::executeQuery(const std::string& query)
 	bool success = true;
 
 	// executes the query
-	databaseLock.lock();
+	Connection* connection = acquireConnection();
+	if (!connection) {
+		return false;
+	}
+
+	MYSQL* handle = connection->handle;
 
 	while (mysql_real_query(handle, query.c_str(), query.length()) != 0) {
 		std::cout << "[Error - mysql_real_query] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_error(handle) << std::endl;
-		auto error = mysql_errno(handle);
-		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
+		if (!isConnectionError(mysql_errno(handle))) {
 			success = false;
 			break;
 		}
@@ -105,7 +209,8 @@ bool Database::executeQuery(const std::string& query)
 	}
 
 	MYSQL_RES* m_res = mysql_store_result(handle);
-	databaseLock.unlock();
+	lastInsertId = mysql_insert_id(handle);
+	releaseConnection(connection);
 
 	if (m_res) {
 		mysql_free_result(m_res);
@@ -116,13 +221,17 @@ bool Database::executeQuery(const std::string& query)
 
 DBResult_ptr Database::storeQuery(const std::string& query)
 {
-	databaseLock.lock();
+	Connection* connection = acquireConnection();
+	if (!connection) {
+		return nullptr;
+	}
+
+	MYSQL* handle = connection->handle;
 
 	retry:
 	while (mysql_real_query(handle, query.c_str(), query.length()) != 0) {
 		std::cout << "[Error - mysql_real_query] Query: " << query << std::endl << "Message: " << mysql_error(handle) << std::endl;
-		auto error = mysql_errno(handle);
-		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
+		if (!isConnectionError(mysql_errno(handle))) {
 			break;
 		}
 		std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -133,14 +242,13 @@ DBResult_ptr Database::storeQuery(const std::string& query)
 	MYSQL_RES* res = mysql_store_result(handle);
 	if (res == nullptr) {
 		std::cout << "[Error - mysql_store_result] Query: " << query << std::endl << "Message: " << mysql_error(handle) << std::endl;
-		auto error = mysql_errno(handle);
-		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
-			databaseLock.unlock();
+		if (!isConnectionError(mysql_errno(handle))) {
+			releaseConnection(connection);
 			return nullptr;
 		}
 		goto retry;
 	}
-	databaseLock.unlock();
+	releaseConnection(connection);
 
 	// retrieving results of query
 	DBResult_ptr result = std::make_shared<DBResult>(res);
@@ -150,12 +258,173 @@ DBResult_ptr Database::storeQuery(const std::string& query)
 	return result;
 }
 
-std::string Database::escapeString(const std::string& s) const
+DBResult_ptr Database::storePreparedQuery(const std::string& query, const std::vector<DBParam>& params)
+{
+	Connection* connection = acquireConnection();
+	if (!connection) {
+		return nullptr;
+	}
+
+	DBResult_ptr result = runPreparedQuery(*connection, query, params);
+	releaseConnection(connection);
+	return result;
+}
+
+MYSQL_STMT* Database::getStatement(Connection& connection, const std::string& query)
+{
+	auto it = connection.statements.find(query);
+	if (it != connection.statements.end()) {
+		return it->second;
+	}
+
+	MYSQL_STMT* statement = mysql_stmt_init(connection.handle);
+	if (!statement) {
+		std::cout << "[Error - mysql_stmt_init] Message: " << mysql_error(connection.handle) << std::endl;
+		return nullptr;
+	}
+
+	if (mysql_stmt_prepare(statement, query.c_str(), query.length()) != 0) {
+		std::cout << "[Error - mysql_stmt_prepare] Query: " << query << std::endl << "Message: " << mysql_stmt_error(statement) << std::endl;
+		mysql_stmt_close(statement);
+		return nullptr;
+	}
+
+	// lets the result buffers be sized before fetching
+	my_bool_t updateMaxLength = 1;
+	mysql_stmt_attr_set(statement, STMT_ATTR_UPDATE_MAX_LENGTH, &updateMaxLength);
+
+	connection.statements.emplace(query, statement);
+	return statement;
+}
+
+void Database::clearStatements(Connection& connection)
+{
+	// statements do not survive a reconnect
+	for (const auto& it : connection.statements) {
+		mysql_stmt_close(it.second);
+	}
+	connection.statements.clear();
+}
+
+DBResult_ptr Database::runPreparedQuery(Connection& connection, const std::string& query, const std::vector<DBParam>& params)
+{
+	MYSQL_STMT* statement;
+	while (true) {
+		statement = getStatement(connection, query);
+		if (!statement) {
+			if (!isConnectionError(mysql_errno(connection.handle))) {
+				return nullptr;
+			}
+
+			clearStatements(connection);
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			continue;
+		}
+
+		std::vector<MYSQL_BIND> paramBinds(params.size());
+		std::vector<long long> numbers(params.size());
+		for (size_t i = 0; i < params.size(); ++i) {
+			MYSQL_BIND& bind = paramBinds[i];
+			memset(&bind, 0, sizeof(bind));
+			if (const int64_t* number = boost::get<int64_t>(&params[i])) {
+				numbers[i] = *number;
+				bind.buffer_type = MYSQL_TYPE_LONGLONG;
+				bind.buffer = &numbers[i];
+			} else {
+				const std::string& string = boost::get<std::string>(params[i]);
+				bind.buffer_type = MYSQL_TYPE_STRING;
+				bind.buffer = const_cast<char*>(string.data());
+				bind.buffer_length = string.length();
+			}
+		}
+
+		if (mysql_stmt_bind_param(statement, paramBinds.data()) == 0 && mysql_stmt_execute(statement) == 0) {
+			break;
+		}
+
+		std::cout << "[Error - mysql_stmt_execute] Query: " << query << std::endl << "Message: " << mysql_stmt_error(statement) << std::endl;
+		if (!isConnectionError(mysql_stmt_errno(statement))) {
+			return nullptr;
+		}
+
+		clearStatements(connection);
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	lastInsertId = mysql_stmt_insert_id(statement);
+
+	MYSQL_RES* metadata = mysql_stmt_result_metadata(statement);
+	if (!metadata) {
+		// not a query with a result set
+		return nullptr;
+	}
+
+	if (mysql_stmt_store_result(statement) != 0) {
+		std::cout << "[Error - mysql_stmt_store_result] Query: " << query << std::endl << "Message: " << mysql_stmt_error(statement) << std::endl;
+		mysql_free_result(metadata);
+		return nullptr;
+	}
+
+	const unsigned int columns = mysql_num_fields(metadata);
+	MYSQL_FIELD* fields = mysql_fetch_fields(metadata);
+
+	// every column is fetched as text, like the rows of a plain query
+	std::vector<MYSQL_BIND> resultBinds(columns);
+	std::vector<std::vector<char>> buffers(columns);
+	std::vector<unsigned long> lengths(columns);
+	std::vector<my_bool_t> nulls(columns);
+	for (unsigned int i = 0; i < columns; ++i) {
+		const MYSQL_FIELD& field = fields[i];
+		const bool variableLength = field.type == MYSQL_TYPE_BLOB || field.type == MYSQL_TYPE_TINY_BLOB || field.type == MYSQL_TYPE_MEDIUM_BLOB ||
+			field.type == MYSQL_TYPE_LONG_BLOB || field.type == MYSQL_TYPE_VAR_STRING || field.type == MYSQL_TYPE_STRING || field.type == MYSQL_TYPE_JSON;
+		buffers[i].resize((variableLength ? field.max_length : std::max(field.max_length, field.length)) + 1);
+
+		MYSQL_BIND& bind = resultBinds[i];
+		memset(&bind, 0, sizeof(bind));
+		bind.buffer_type = MYSQL_TYPE_STRING;
+		bind.buffer = buffers[i].data();
+		bind.buffer_length = buffers[i].size();
+		bind.length = &lengths[i];
+		bind.is_null = &nulls[i];
+	}
+
+	DBResult_ptr result = std::make_shared<DBResult>(metadata, nullptr);
+	if (mysql_stmt_bind_result(statement, resultBinds.data()) == 0) {
+		int status;
+		while ((status = mysql_stmt_fetch(statement)) == 0 || status == MYSQL_DATA_TRUNCATED) {
+			if (status == MYSQL_DATA_TRUNCATED) {
+				for (unsigned int i = 0; i < columns; ++i) {
+					if (!nulls[i] && lengths[i] >= buffers[i].size()) {
+						buffers[i].resize(lengths[i] + 1);
+						resultBinds[i].buffer = buffers[i].data();
+						resultBinds[i].buffer_length = buffers[i].size();
+						mysql_stmt_fetch_column(statement, &resultBinds[i], i, 0);
+					}
+				}
+				mysql_stmt_bind_result(statement, resultBinds.data());
+			}
+			result->addPreparedRow(buffers, lengths, nulls);
+		}
+	} else {
+		std::cout << "[Error - mysql_stmt_bind_result] Query: " << query << std::endl << "Message: " << mysql_stmt_error(statement) << std::endl;
+	}
+
+	mysql_stmt_free_result(statement);
+	mysql_free_result(metadata);
+
+	result->finishPreparedRows();
+	if (!result->hasNext()) {
+		return nullptr;
+	}
+	return result;
+}
+
+std::string Database::escapeString(const std::string& s)
 {
 	return escapeBlob(s.c_str(), s.length());
 }
 
-std::string Database::escapeBlob(const char* s, uint32_t length) const
+std::string Database::escapeBlob(const char* s, uint32_t length)
 {
 	// the worst case is 2n + 1
 	size_t maxLength = (length * 2) + 1;
@@ -165,10 +434,22 @@ std::string Database::escapeBlob(const char* s, uint32_t length) const
 	escaped.push_back('\'');
 
 	if (length != 0) {
-		char* output = new char[maxLength];
-		mysql_real_escape_string(handle, output, s, length);
-		escaped.append(output);
-		delete[] output;
+		if (Connection* connection = acquireConnection()) {
+			// the handle gives the character set, it may not be used while another thread runs a query on it
+			char* output = new char[maxLength];
+			mysql_real_escape_string(connection->handle, output, s, length);
+			releaseConnection(connection);
+			escaped.append(output);
+			delete[] output;
+		} else {
+			// no query runs without a connection, it only has to stay well-formed
+			for (uint32_t i = 0; i < length; ++i) {
+				if (s[i] == '\'' || s[i] == '\\') {
+					escaped.push_back('\\');
+				}
+				escaped.push_back(s[i]);
+			}
+		}
 	}
 
 	escaped.push_back('\'');
@@ -186,46 +467,84 @@ DBResult::DBResult(MYSQL_RES* res)
 		listNames[field->name] = i++;
 		field = mysql_fetch_field(handle);
 	}
+	columns = i;
 
 	row = mysql_fetch_row(handle);
 }
 
+DBResult::DBResult(MYSQL_RES* metadata, std::nullptr_t)
+{
+	size_t i = 0;
+
+	MYSQL_FIELD* field = mysql_fetch_field(metadata);
+	while (field) {
+		listNames[field->name] = i++;
+		field = mysql_fetch_field(metadata);
+	}
+	columns = i;
+}
+
 DBResult::~DBResult()
 {
-	mysql_free_result(handle);
+	if (handle) {
+		mysql_free_result(handle);
+	}
 }
 
-std::string DBResult::getString(const std::string& s) const
+void DBResult::addPreparedRow(const std::vector<std::vector<char>>& buffers, const std::vector<unsigned long>& lengths, const std::vector<my_bool_t>& nulls)
 {
-	auto it = listNames.find(s);
-	if (it == listNames.end()) {
-		std::cout << "[Error - DBResult::getString] Column '" << s << "' does not exist in result set." << std::endl;
-		return std::string();
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		if (nulls[i]) {
+			preparedOffsets.push_back(std::string::npos);
+			preparedLengths.push_back(0);
+			continue;
+		}
+
+		preparedOffsets.push_back(preparedData.size());
+		preparedLengths.push_back(lengths[i]);
+		preparedData.append(buffers[i].data(), lengths[i]);
+		preparedData.push_back('\0');
 	}
+}
 
-	if (row[it->second] == nullptr) {
-		return std::string();
+void DBResult::finishPreparedRows()
+{
+	preparedRows.reserve(preparedOffsets.size());
+	for (size_t offset : preparedOffsets) {
+		preparedRows.push_back(offset == std::string::npos ? nullptr : preparedData.data() + offset);
 	}
 
-	return std::string(row[it->second]);
+	preparedRow = 0;
+	row = preparedRows.empty() ? nullptr : preparedRows.data();
 }
 
-const char* DBResult::getStream(const std::string& s, unsigned long& size) const
+size_t DBResult::getColumnIndex(std::string_view s) const
 {
 	auto it = listNames.find(s);
 	if (it == listNames.end()) {
-		std::cout << "[Error - DBResult::getStream] Column '" << s << "' doesn't exist in the result set" << std::endl;
-		size = 0;
-		return nullptr;
+		TVP_LOG(LOGLEVEL_ERROR, "[Error - DBResult::getColumnIndex] Column '{:s}' doesn't exist in the result set", s);
+		return std::numeric_limits<size_t>::max();
 	}
+	return it->second;
+}
 
-	if (row[it->second] == nullptr) {
-		size = 0;
-		return nullptr;
+std::string_view DBResult::getValue(size_t column) const
+{
+	if (column >= columns || !row || row[column] == nullptr) {
+		return {};
 	}
 
-	size = mysql_fetch_lengths(handle)[it->second];
-	return row[it->second];
+	if (handle) {
+		return {row[column], mysql_fetch_lengths(handle)[column]};
+	}
+	return {row[column], preparedLengths[preparedRow * columns + column]};
+}
+
+const char* DBResult::getStream(size_t column, unsigned long& size) const
+{
+	std::string_view value = getValue(column);
+	size = value.size();
+	return value.data();
 }
 
 bool DBResult::hasNext() const
@@ -235,11 +554,21 @@ bool DBResult::hasNext() const
 
 bool DBResult::next()
 {
-	row = mysql_fetch_row(handle);
-	return row != nullptr;
+	if (handle) {
+		row = mysql_fetch_row(handle);
+		return row != nullptr;
+	}
+
+	if (columns == 0 || (++preparedRow + 1) * columns > preparedRows.size()) {
+		row = nullptr;
+		return false;
+	}
+
+	row = preparedRows.data() + preparedRow * columns;
+	return true;
 }
 
-DBInsert::DBInsert(std::string query) : query(std::move(query))
+DBInsert::DBInsert(std::string query, Database& db/* = Database::getInstance()*/) : db(db), query(std::move(query))
 {
 	this->length = this->query.length();
 }
@@ -249,7 +578,7 @@ bool DBInsert::addRow(const std::string& row)
 	// adds new row to buffer
 	const size_t rowLength = row.length();
 	length += rowLength;
-	if (length > Database::getInstance().getMaxPacketSize() && !execute()) {
+	if (length > db.getMaxPacketSize() && !execute()) {
 		return false;
 	}
 
@@ -282,7 +611,7 @@ bool DBInsert::execute()
 	}
 
 	// executes buffer
-	bool res = Database::getInstance().executeQuery(query + values);
+	bool res = db.executeQuery(query + values);
 	values.clear();
 	length = query.length();
 	return res;
@@ -3,13 +3,19 @@
 
 #pragma once
 
-#include <boost/lexical_cast.hpp>
+#include <charconv>
 
 #include <mysql/mysql.h>
 
+// MySQL 8 replaced my_bool by bool in MYSQL_BIND, MariaDB did not
+using my_bool_t = std::remove_pointer_t<decltype(MYSQL_BIND::is_null)>;
+
 class DBResult;
 using DBResult_ptr = std::shared_ptr<DBResult>;
 
+// parameter bound to a '?' placeholder of a prepared statement
+using DBParam = boost::variant<int64_t, std::string>;
+
 class Database
 {
 	public:
@@ -34,9 +40,20 @@ class Database
 		/**
 		 * Connects to the database
 		 *
+		 * Opens a pool of connections, every query takes a free one for its duration.
+		 * Until then every query fails right away, tvp_sim runs the game like that.
+		 *
+		 * @param connections number of connections in the pool
 		 * @return true on successful connection, false on error
 		 */
-		bool connect();
+		bool connect(size_t connections = 1);
+
+		/**
+		 * Closes every connection of the pool
+		 *
+		 * Only once no thread runs queries anymore, the ones after it fail right away.
+		 */
+		void disconnect();
 
 		/**
 		 * Executes command.
@@ -57,6 +74,16 @@ class Database
 		 */
 		DBResult_ptr storeQuery(const std::string& query);
 
+		/**
+		 * Queries database through a server-side prepared statement.
+		 *
+		 * Each connection prepares the statement once and keeps it, the parameters
+		 * are bound to its '?' placeholders in order.
+		 *
+		 * @return results object (nullptr on error or empty result)
+		 */
+		DBResult_ptr storePreparedQuery(const std::string& query, const std::vector<DBParam>& params);
+
 		/**
 		 * Escapes string for query.
 		 *
@@ -65,18 +92,19 @@ class Database
 		 * @param s string to be escaped
 		 * @return quoted string
 		 */
-		std::string escapeString(const std::string& s) const;
+		std::string escapeString(const std::string& s);
 
 		/**
 		 * Escapes binary stream for query.
 		 *
-		 * Prepares binary stream to fit SQL queries.
+		 * Prepares binary stream to fit SQL queries. Takes a connection of the pool for the
+		 * duration, so it waits while every connection is busy.
 		 *
 		 * @param s binary stream
 		 * @param length stream length
 		 * @return quoted string
 		 */
-		std::string escapeBlob(const char* s, uint32_t length) const;
+		std::string escapeBlob(const char* s, uint32_t length);
 
 		/**
 		 * Retrieve id of last inserted row
@@ -84,7 +112,7 @@ class Database
 		 * @return id on success, 0 if last query did not result on any rows with auto_increment keys
 		 */
 		uint64_t getLastInsertId() const {
-			return static_cast<uint64_t>(mysql_insert_id(handle));
+			return lastInsertId;
 		}
 
 		/**
@@ -112,10 +140,32 @@ class Database
 		bool rollback();
 		bool commit();
 
-		MYSQL* handle = nullptr;
-		std::recursive_mutex databaseLock;
+		struct Connection {
+			MYSQL* handle = nullptr;
+			std::unordered_map<std::string, MYSQL_STMT*> statements;
+			// a transaction keeps the connection for the thread that started it
+			std::thread::id transactionThread;
+			uint32_t transactionDepth = 0;
+		};
+
+		MYSQL* openConnection();
+		Connection* acquireConnection();
+		void releaseConnection(Connection* connection);
+		bool endTransaction(bool commit);
+
+		MYSQL_STMT* getStatement(Connection& connection, const std::string& query);
+		static void clearStatements(Connection& connection);
+		DBResult_ptr runPreparedQuery(Connection& connection, const std::string& query, const std::vector<DBParam>& params);
+
+		std::vector<std::unique_ptr<Connection>> connections;
+		std::vector<Connection*> freeConnections;
+		std::mutex poolLock;
+		std::condition_variable poolSignal;
 		uint64_t maxPacketSize = 1048576;
 
+		// the id of the last insert belongs to the connection that ran it, so it is kept per thread
+		static inline thread_local uint64_t lastInsertId = 0;
+
 	friend class DBTransaction;
 };
 
@@ -125,43 +175,71 @@ class DBResult
 		explicit DBResult(MYSQL_RES* res);
 		~DBResult();
 
+		// result of a prepared statement, rows are copied in by Database as they are fetched
+		explicit DBResult(MYSQL_RES* metadata, std::nullptr_t);
+
 		// non-copyable
 		DBResult(const DBResult&) = delete;
 		DBResult& operator=(const DBResult&) = delete;
 
+		// position of a column in the result set, loops over many rows should look it up once
+		size_t getColumnIndex(std::string_view s) const;
+
 		template<typename T>
-		T getNumber(const std::string& s) const
+		T getNumber(size_t column) const
 		{
-			auto it = listNames.find(s);
-			if (it == listNames.end()) {
-				std::cout << "[Error - DBResult::getNumber] Column '" << s << "' doesn't exist in the result set" << std::endl;
-				return static_cast<T>(0);
+			if constexpr (std::is_enum_v<T>) {
+				return static_cast<T>(getNumber<std::underlying_type_t<T>>(column));
+			} else {
+				std::string_view value = getValue(column);
+				T data;
+				if (std::from_chars(value.data(), value.data() + value.size(), data).ec != std::errc()) {
+					return static_cast<T>(0);
+				}
+				return data;
 			}
+		}
 
-			if (row[it->second] == nullptr) {
-				return static_cast<T>(0);
-			}
+		template<typename T>
+		T getNumber(std::string_view s) const
+		{
+			return getNumber<T>(getColumnIndex(s));
+		}
 
-			T data;
-			try {
-				data = boost::lexical_cast<T>(row[it->second]);
-			} catch (boost::bad_lexical_cast&) {
-				data = 0;
-			}
-			return data;
+		std::string getString(size_t column) const {
+			return std::string(getValue(column));
+		}
+		std::string getString(std::string_view s) const {
+			return getString(getColumnIndex(s));
 		}
 
-		std::string getString(const std::string& s) const;
-		const char* getStream(const std::string& s, unsigned long& size) const;
+		const char* getStream(size_t column, unsigned long& size) const;
+		const char* getStream(std::string_view s, unsigned long& size) const {
+			return getStream(getColumnIndex(s), size);
+		}
 
 		bool hasNext() const;
 		bool next();
 
 	private:
-		MYSQL_RES* handle;
-		MYSQL_ROW row;
+		void addPreparedRow(const std::vector<std::vector<char>>& buffers, const std::vector<unsigned long>& lengths, const std::vector<my_bool_t>& nulls);
+		void finishPreparedRows();
+
+		// empty for NULL values and unknown columns
+		std::string_view getValue(size_t column) const;
+
+		MYSQL_RES* handle = nullptr;
+		MYSQL_ROW row = nullptr;
+
+		std::map<std::string, size_t, std::less<>> listNames;
+		size_t columns = 0;
 
-		std::map<std::string, size_t> listNames;
+		// prepared statement results, stored row by row
+		std::string preparedData;
+		std::vector<size_t> preparedOffsets;
+		std::vector<unsigned long> preparedLengths;
+		std::vector<char*> preparedRows;
+		size_t preparedRow = 0;
 
 	friend class Database;
 };
@@ -172,12 +250,13 @@ class DBResult
 class DBInsert
 {
 	public:
-		explicit DBInsert(std::string query);
+		explicit DBInsert(std::string query, Database& db = Database::getInstance());
 		bool addRow(const std::string& row);
 		bool addRow(std::ostringstream& row);
 		bool execute();
 
 	private:
+		Database& db;
 		std::string query;
 		std::string values;
 		size_t length;
@@ -186,11 +265,11 @@ class DBInsert
 class DBTransaction
 {
 	public:
-		constexpr DBTransaction() = default;
+		explicit DBTransaction(Database& db = Database::getInstance()) : db(db) {}
 
 		~DBTransaction() {
 			if (state == STATE_START) {
-				Database::getInstance().rollback();
+				db.rollback();
 			}
 		}
 
@@ -200,7 +279,7 @@ class DBTransaction
 
 		bool begin() {
 			state = STATE_START;
-			return Database::getInstance().beginTransaction();
+			return db.beginTransaction();
 		}
 
 		bool commit() {
@@ -209,7 +288,7 @@ class DBTransaction
 			}
 
 			state = STATE_COMMIT;
-			return Database::getInstance().commit();
+			return db.commit();
 		}
 
 	private:
@@ -219,5 +298,6 @@ class DBTransaction
 			STATE_COMMIT,
 		};
 
+		Database& db;
 		TransactionStates_t state = STATE_NO_START;
 };
@@ -5,8 +5,11 @@
 
 #include "databasetasks.h"
 #include "tasks.h"
+#include "configmanager.h"
+#include "profiler.h"
 
 extern Dispatcher g_dispatcher;
+extern ConfigManager g_config;
 
 void DatabaseTasks::start()
 {
@@ -16,6 +19,9 @@ void DatabaseTasks::start()
 
 void DatabaseTasks::threadMain()
 {
+	PROFILE_THREAD("DatabaseTasks");
+
+	std::vector<DatabaseTask> batch;
 	std::unique_lock<std::mutex> taskLockUnique(taskLock, std::defer_lock);
 	while (getState() != THREAD_STATE_TERMINATED) {
 		taskLockUnique.lock();
@@ -24,10 +30,9 @@ void DatabaseTasks::threadMain()
 		}
 
 		if (!tasks.empty()) {
-			DatabaseTask task = std::move(tasks.front());
-			tasks.pop_front();
+			popTasks(batch, g_config.getNumber(ConfigManager::SQL_BATCH_SIZE));
 			taskLockUnique.unlock();
-			runTask(task);
+			runBatch(batch);
 		} else {
 			taskLockUnique.unlock();
 		}
@@ -35,12 +40,40 @@ void DatabaseTasks::threadMain()
 }
 
 void DatabaseTasks::addTask(std::string query, std::function<void(DBResult_ptr, bool)> callback/* = nullptr*/, bool store/* = false*/)
+{
+	addTask(DatabaseTask(std::move(query), std::move(callback), store));
+}
+
+void DatabaseTasks::addTask(std::function<void(Database&)> function)
+{
+	addTask(DatabaseTask(std::move(function)));
+}
+
+void DatabaseTasks::addCoalescedTask(std::string key, std::string query)
+{
+	DatabaseTask task(std::move(query), nullptr, false);
+	task.key = std::move(key);
+	addTask(std::move(task));
+}
+
+void DatabaseTasks::addTask(DatabaseTask&& task)
 {
 	bool signal = false;
 	taskLock.lock();
 	if (getState() == THREAD_STATE_RUNNING) {
-		signal = tasks.empty();
-		tasks.emplace_back(std::move(query), std::move(callback), store);
+		auto it = task.key.empty() ? keyedTasks.end() : keyedTasks.find(task.key);
+		if (it != keyedTasks.end()) {
+			// the pending query has not run yet and this one overrides its effect
+			it->second->query = std::move(task.query);
+			++stats.coalesced;
+		} else {
+			signal = tasks.empty();
+			tasks.push_back(std::move(task));
+			if (!tasks.back().key.empty()) {
+				keyedTasks.emplace(tasks.back().key, std::prev(tasks.end()));
+			}
+			stats.maxQueueDepth = std::max(stats.maxQueueDepth, tasks.size());
+		}
 	}
 	taskLock.unlock();
 
@@ -49,8 +82,39 @@ void DatabaseTasks::addTask(std::string query, std::function<void(DBResult_ptr,
 	}
 }
 
+void DatabaseTasks::popTasks(std::vector<DatabaseTask>& batch, size_t maxBatchSize)
+{
+	// queries whose result is not stored are run together, anything else runs on its own
+	auto isBatchable = [](const DatabaseTask& task) { return !task.function && !task.store; };
+
+	batch.clear();
+	do {
+		DatabaseTask& task = tasks.front();
+		if (!batch.empty() && (!isBatchable(task) || !isBatchable(batch.front()))) {
+			break;
+		}
+
+		if (!task.key.empty()) {
+			keyedTasks.erase(task.key);
+		}
+
+		batch.push_back(std::move(task));
+		tasks.pop_front();
+	} while (!tasks.empty() && batch.size() < maxBatchSize);
+
+	stats.tasks += batch.size();
+	++stats.batches;
+	stats.maxBatchSize = std::max(stats.maxBatchSize, batch.size());
+}
+
 void DatabaseTasks::runTask(const DatabaseTask& task)
 {
+	PROFILE_FUNCTION();
+	if (task.function) {
+		task.function(db);
+		return;
+	}
+
 	bool success;
 	DBResult_ptr result;
 	if (task.store) {
@@ -66,14 +130,49 @@ void DatabaseTasks::runTask(const DatabaseTask& task)
 	}
 }
 
+void DatabaseTasks::runBatch(std::vector<DatabaseTask>& batch)
+{
+	PROFILE_FUNCTION();
+	if (batch.size() == 1) {
+		runTask(batch.front());
+		return;
+	}
+
+	// a single commit for the whole batch, if the transaction can not be started the queries still run one by one
+	DBTransaction transaction(db);
+	transaction.begin();
+
+	std::vector<std::pair<std::function<void(DBResult_ptr, bool)>, bool>> callbacks;
+	for (DatabaseTask& task : batch) {
+		bool success = db.executeQuery(task.query);
+		if (task.callback) {
+			callbacks.emplace_back(std::move(task.callback), success);
+		}
+	}
+
+	transaction.commit();
+
+	for (auto& it : callbacks) {
+		g_dispatcher.addTask(createTask(std::bind(std::move(it.first), nullptr, it.second)));
+	}
+}
+
+DatabaseTasksStats DatabaseTasks::getStats()
+{
+	std::lock_guard<std::mutex> lockClass(taskLock);
+	DatabaseTasksStats result = stats;
+	result.queueDepth = tasks.size();
+	return result;
+}
+
 void DatabaseTasks::flush()
 {
+	std::vector<DatabaseTask> batch;
 	std::unique_lock<std::mutex> guard{ taskLock };
 	while (!tasks.empty()) {
-		auto task = std::move(tasks.front());
-		tasks.pop_front();
+		popTasks(batch, g_config.getNumber(ConfigManager::SQL_BATCH_SIZE));
 		guard.unlock();
-		runTask(task);
+		runBatch(batch);
 		guard.lock();
 	}
 }
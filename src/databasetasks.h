@@ -11,12 +11,27 @@
 struct DatabaseTask {
 	DatabaseTask(std::string&& query, std::function<void(DBResult_ptr, bool)>&& callback, bool store) :
 		query(std::move(query)), callback(std::move(callback)), store(store) {}
+	explicit DatabaseTask(std::function<void(Database&)>&& function) :
+		function(std::move(function)), store(false) {}
 
 	std::string query;
 	std::function<void(DBResult_ptr, bool)> callback;
+	// runs on the database thread with its connection, used to group several queries in one transaction
+	std::function<void(Database&)> function;
+	// pending tasks with the same key are superseded by the newest one
+	std::string key;
 	bool store;
 };
 
+struct DatabaseTasksStats {
+	size_t queueDepth = 0;
+	size_t maxQueueDepth = 0;
+	uint64_t tasks = 0;
+	uint64_t batches = 0;
+	size_t maxBatchSize = 0;
+	uint64_t coalesced = 0;
+};
+
 class DatabaseTasks : public ThreadHolder<DatabaseTasks>
 {
 	public:
@@ -26,14 +41,23 @@ class DatabaseTasks : public ThreadHolder<DatabaseTasks>
 		void shutdown();
 
 		void addTask(std::string query, std::function<void(DBResult_ptr, bool)> callback = nullptr, bool store = false);
+		void addTask(std::function<void(Database&)> function);
+		void addCoalescedTask(std::string key, std::string query);
+
+		DatabaseTasksStats getStats();
 
 		void threadMain();
 	private:
+		void addTask(DatabaseTask&& task);
+		void popTasks(std::vector<DatabaseTask>& batch, size_t maxBatchSize);
 		void runTask(const DatabaseTask& task);
+		void runBatch(std::vector<DatabaseTask>& batch);
 
 		Database db;
 		std::thread thread;
 		std::list<DatabaseTask> tasks;
+		std::unordered_map<std::string, std::list<DatabaseTask>::iterator> keyedTasks;
+		DatabaseTasksStats stats;
 		std::mutex taskLock;
 		std::condition_variable taskSignal;
 };
@@ -0,0 +1,173 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "decay.h"
+#include "game.h"
+
+int64_t DecayWheel::toTick(int64_t time)
+{
+	return time / EVENT_DECAYINTERVAL;
+}
+
+void DecayWheel::schedule(Item* item, uint32_t duration, int64_t now)
+{
+	auto it = indexes.find(item);
+	if (it != indexes.end()) {
+		unlink(it->second);
+		entries[it->second].expireTime = now + duration;
+		link(it->second);
+		return;
+	}
+
+	if (indexes.empty()) {
+		// the wheel has been empty, skip the ticks nothing was waiting for
+		wheelTick = std::max(wheelTick, toTick(now));
+	}
+
+	uint32_t index = allocateEntry();
+	WheelEntry& entry = entries[index];
+	entry.item = item;
+	entry.expireTime = now + duration;
+	link(index);
+	indexes.emplace(item, index);
+}
+
+bool DecayWheel::unschedule(Item* item, int64_t now)
+{
+	auto it = indexes.find(item);
+	if (it == indexes.end()) {
+		return false;
+	}
+
+	const uint32_t index = it->second;
+	indexes.erase(it);
+
+	item->setIntAttr(ITEM_ATTRIBUTE_DURATION, std::max<int64_t>(0, entries[index].expireTime - now));
+	unlink(index);
+	releaseEntry(index);
+	return true;
+}
+
+bool DecayWheel::getRemaining(const Item* item, int64_t now, uint32_t& remaining) const
+{
+	auto it = indexes.find(item);
+	if (it == indexes.end()) {
+		return false;
+	}
+
+	remaining = static_cast<uint32_t>(std::max<int64_t>(0, entries[it->second].expireTime - now));
+	return true;
+}
+
+void DecayWheel::advance(int64_t now, std::vector<Item*>& expired)
+{
+	const int64_t currentTick = toTick(now);
+	while (wheelTick <= currentTick && !indexes.empty()) {
+		const uint32_t slot = wheelTick & WHEEL_MASK;
+		if (slot == 0) {
+			// the lower wheel wrapped around, bring the next slot of every upper level down
+			for (uint32_t level = 1; level < WHEEL_LEVELS; ++level) {
+				const uint32_t upperSlot = (wheelTick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+				cascade(level, upperSlot);
+				if (upperSlot != 0) {
+					break;
+				}
+			}
+		}
+
+		uint32_t index = slots[slot];
+		slots[slot] = INVALID_INDEX;
+		while (index != INVALID_INDEX) {
+			WheelEntry& entry = entries[index];
+			const uint32_t next = entry.next;
+			if (entry.expireTime > now) {
+				// parked in the farthest slot, it is not due yet
+				link(index);
+			} else {
+				entry.item->setIntAttr(ITEM_ATTRIBUTE_DURATION, 0);
+				expired.push_back(entry.item);
+				indexes.erase(entry.item);
+				releaseEntry(index);
+			}
+			index = next;
+		}
+
+		++wheelTick;
+	}
+}
+
+uint32_t DecayWheel::allocateEntry()
+{
+	if (!freeEntries.empty()) {
+		uint32_t index = freeEntries.back();
+		freeEntries.pop_back();
+		return index;
+	}
+
+	entries.emplace_back();
+	return entries.size() - 1;
+}
+
+void DecayWheel::releaseEntry(uint32_t index)
+{
+	WheelEntry& entry = entries[index];
+	entry.item = nullptr;
+	entry.prev = entry.next = INVALID_INDEX;
+	freeEntries.push_back(index);
+}
+
+void DecayWheel::link(uint32_t index)
+{
+	WheelEntry& entry = entries[index];
+
+	// round up, items never decay early
+	int64_t expireTick = std::max((entry.expireTime + EVENT_DECAYINTERVAL - 1) / EVENT_DECAYINTERVAL, wheelTick);
+	int64_t ticks = expireTick - wheelTick;
+	if (ticks > WHEEL_MAX_TICKS) {
+		// park it in the farthest slot, it is placed again every time its slot cascades
+		ticks = WHEEL_MAX_TICKS;
+		expireTick = wheelTick + ticks;
+	}
+
+	uint32_t level = 0;
+	while (level + 1 < WHEEL_LEVELS && ticks >= (1LL << (WHEEL_BITS * (level + 1)))) {
+		++level;
+	}
+
+	entry.slot = static_cast<uint16_t>(level * WHEEL_SIZE + ((expireTick >> (WHEEL_BITS * level)) & WHEEL_MASK));
+	entry.prev = INVALID_INDEX;
+	entry.next = slots[entry.slot];
+	if (entry.next != INVALID_INDEX) {
+		entries[entry.next].prev = index;
+	}
+	slots[entry.slot] = index;
+}
+
+void DecayWheel::unlink(uint32_t index)
+{
+	WheelEntry& entry = entries[index];
+	if (entry.prev != INVALID_INDEX) {
+		entries[entry.prev].next = entry.next;
+	} else {
+		slots[entry.slot] = entry.next;
+	}
+
+	if (entry.next != INVALID_INDEX) {
+		entries[entry.next].prev = entry.prev;
+	}
+	entry.prev = entry.next = INVALID_INDEX;
+}
+
+void DecayWheel::cascade(uint32_t level, uint32_t slot)
+{
+	uint32_t index = slots[level * WHEEL_SIZE + slot];
+	slots[level * WHEEL_SIZE + slot] = INVALID_INDEX;
+
+	while (index != INVALID_INDEX) {
+		uint32_t next = entries[index].next;
+		link(index);
+		index = next;
+	}
+}
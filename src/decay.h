@@ -0,0 +1,73 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+class Item;
+
+/*
+ * Hierarchical timing wheel (4 levels of 64 slots) of decaying items, only used by the dispatcher.
+ * Items are linked into the slot of their absolute expiry and are not touched again until it fires.
+ * While an item is in the wheel its duration attribute is stale, the remaining time is
+ * written back when the item leaves the wheel.
+ */
+class DecayWheel
+{
+	public:
+		DecayWheel() {
+			slots.fill(INVALID_INDEX);
+		}
+
+		// non-copyable
+		DecayWheel(const DecayWheel&) = delete;
+		DecayWheel& operator=(const DecayWheel&) = delete;
+
+		bool isScheduled(const Item* item) const {
+			return indexes.find(item) != indexes.end();
+		}
+		size_t size() const {
+			return indexes.size();
+		}
+
+		// (re)links the item so that it expires in duration milliseconds
+		void schedule(Item* item, uint32_t duration, int64_t now);
+		// returns false if the item was not scheduled
+		bool unschedule(Item* item, int64_t now);
+		// returns false if the item is not scheduled
+		bool getRemaining(const Item* item, int64_t now, uint32_t& remaining) const;
+
+		// collects the items whose expiry has been reached, their duration attribute is set to 0
+		void advance(int64_t now, std::vector<Item*>& expired);
+
+	private:
+		static constexpr uint32_t WHEEL_BITS = 6;
+		static constexpr uint32_t WHEEL_SIZE = 1 << WHEEL_BITS;
+		static constexpr uint32_t WHEEL_MASK = WHEEL_SIZE - 1;
+		static constexpr uint32_t WHEEL_LEVELS = 4;
+		static constexpr int64_t WHEEL_MAX_TICKS = (1LL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		struct WheelEntry {
+			Item* item = nullptr;
+			int64_t expireTime = 0;
+			uint32_t prev = INVALID_INDEX;
+			uint32_t next = INVALID_INDEX;
+			uint16_t slot = 0;
+		};
+
+		static int64_t toTick(int64_t time);
+
+		uint32_t allocateEntry();
+		void releaseEntry(uint32_t index);
+		void link(uint32_t index);
+		void unlink(uint32_t index);
+		void cascade(uint32_t level, uint32_t slot);
+
+		std::vector<WheelEntry> entries;
+		std::vector<uint32_t> freeEntries;
+		std::unordered_map<const Item*, uint32_t> indexes;
+		std::array<uint32_t, WHEEL_LEVELS * WHEEL_SIZE> slots;
+
+		// next tick to be processed, only moves forward
+		int64_t wheelTick = 0;
+};
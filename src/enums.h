@@ -289,6 +289,9 @@ enum formulaType_t {
 	COMBAT_FORMULA_LEVELMAGIC,
 	COMBAT_FORMULA_SKILL,
 	COMBAT_FORMULA_DAMAGE,
+	// the formulas of Player:computeDamage and Player:computeSkillDamage, evaluated without a script
+	COMBAT_FORMULA_BASEDAMAGE,
+	COMBAT_FORMULA_BASESKILL,
 };
 
 enum ConditionType_t {
@@ -482,4 +485,5 @@ enum MonstersEvent_t : uint8_t {
 	MONSTERS_EVENT_DISAPPEAR = 3,
 	MONSTERS_EVENT_MOVE = 4,
 	MONSTERS_EVENT_SAY = 5,
+	MONSTERS_EVENT_THINK_BATCH = 6,
 };
@@ -53,6 +53,11 @@ class Events
 
 		bool load();
 
+		// when nothing listens to Creature:onHear, say events only go to the creatures that hear, see Map::getHearers
+		bool hasCreatureOnHear() const {
+			return info.creatureOnHear != -1;
+		}
+
 		// Creature
 		bool eventCreatureOnChangeOutfit(Creature* creature, const Outfit_t& outfit);
 		ReturnValue eventCreatureOnAreaCombat(Creature* creature, Tile* tile, bool aggressive);
@@ -0,0 +1,330 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "filecompression.h"
+#include "configmanager.h"
+#include "filetasks.h"
+
+#include <fmt/format.h>
+#include <filesystem>
+#include <fstream>
+
+#ifdef TVP_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+extern ConfigManager g_config;
+
+namespace {
+
+// the magic number starting every zstd frame, little endian
+constexpr char FRAME_MAGIC[] = {'\x28', '\xB5', '\x2F', '\xFD'};
+
+struct FileKind {
+	std::string_view name;
+	std::string_view extension;
+	// where the files to train its dictionary from are, the map has just the one file
+	std::string_view directory;
+};
+
+constexpr std::array<FileKind, COMPRESSED_FILE_LAST + 1> fileKinds = {{
+	{"", "", ""},
+	{"map", ".tvpm", ""},
+	{"house", ".tvph", "gamedata/houses"},
+	{"player", ".tvpp", "gamedata/players"},
+	{"playerbinary", ".tvpb", "gamedata/players"},
+}};
+
+#ifdef TVP_ZSTD
+
+constexpr const char* DICTIONARY_DIRECTORY = "gamedata/dictionaries";
+constexpr size_t DICTIONARY_CAPACITY = 112640;
+// a dictionary trained from fewer files would fit them and nothing else
+constexpr size_t MIN_SAMPLES = 32;
+constexpr size_t MAX_SAMPLES = 10000;
+constexpr size_t MAX_SAMPLE_BYTES = 64 * 1024 * 1024;
+
+struct Dictionary
+{
+	explicit Dictionary(std::string&& content) : content(std::move(content)),
+		decompression(ZSTD_createDDict(this->content.data(), this->content.size())) {}
+	~Dictionary() {
+		ZSTD_freeDDict(decompression);
+		ZSTD_freeCDict(compression);
+	}
+
+	// non-copyable
+	Dictionary(const Dictionary&) = delete;
+	Dictionary& operator=(const Dictionary&) = delete;
+
+	std::string content;
+	ZSTD_DDict* decompression;
+	// made for the level it is first used with, dictionaryLock held
+	ZSTD_CDict* compression = nullptr;
+	int compressionLevel = 0;
+};
+
+std::mutex dictionaryLock;
+std::unordered_map<uint32_t, std::shared_ptr<Dictionary>> dictionaries;
+// the newest dictionary of each kind, files are compressed with it
+std::array<std::shared_ptr<Dictionary>, COMPRESSED_FILE_LAST + 1> currentDictionaries;
+
+bool readFile(const std::filesystem::path& path, std::string& content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+std::shared_ptr<Dictionary> addDictionary(CompressedFile_t kind, std::string&& content)
+{
+	const uint32_t id = ZDICT_getDictID(content.data(), content.size());
+	if (id == 0) {
+		return nullptr;
+	}
+
+	auto dictionary = std::make_shared<Dictionary>(std::move(content));
+	if (!dictionary->decompression) {
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lockClass(dictionaryLock);
+	dictionaries[id] = dictionary;
+	currentDictionaries[kind] = dictionary;
+	return dictionary;
+}
+
+// runs on the file thread
+void trainDictionary(CompressedFile_t kind)
+{
+	const FileKind& fileKind = fileKinds[kind];
+
+	std::string samples;
+	std::vector<size_t> sampleSizes;
+	std::string file;
+	std::string content;
+
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(fileKind.directory, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		if (!it->is_regular_file(ec) || filecompression::getFileKind(it->path().string()) != kind) {
+			continue;
+		}
+
+		if (!readFile(it->path(), file) || !filecompression::decompress(file.data(), file.size(), content) || content.empty()) {
+			continue;
+		}
+
+		if (samples.size() + content.size() > MAX_SAMPLE_BYTES) {
+			break;
+		}
+
+		samples += content;
+		sampleSizes.push_back(content.size());
+		if (sampleSizes.size() == MAX_SAMPLES) {
+			break;
+		}
+	}
+
+	// trained at a later startup, once there are enough files
+	if (sampleSizes.size() < MIN_SAMPLES) {
+		return;
+	}
+
+	std::string dictionary(DICTIONARY_CAPACITY, '\0');
+	const size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), sampleSizes.size());
+	if (ZDICT_isError(size)) {
+		std::cout << "[Warning - filecompression::trainDictionary] Cannot train the " << fileKind.name << " dictionary: " << ZDICT_getErrorName(size) << std::endl;
+		return;
+	}
+	dictionary.resize(size);
+
+	const std::string filename = fmt::format("{:s}/{:s}-{:d}.dict", DICTIONARY_DIRECTORY, fileKind.name, ZDICT_getDictID(dictionary.data(), dictionary.size()));
+	if (!FileTasks::writeFileContents(filename, dictionary.data(), dictionary.size())) {
+		return;
+	}
+
+	addDictionary(kind, std::move(dictionary));
+	std::cout << ">> Trained the " << fileKind.name << " file dictionary from " << sampleSizes.size() << " files." << std::endl;
+}
+
+#endif
+
+}
+
+namespace filecompression {
+
+CompressedFile_t getFileKind(std::string_view filename)
+{
+	// exports are read by people and would be training samples of the player dictionary otherwise
+	if (filename.ends_with(".export.tvpp")) {
+		return COMPRESSED_FILE_NONE;
+	}
+
+	for (size_t kind = COMPRESSED_FILE_NONE + 1; kind <= COMPRESSED_FILE_LAST; ++kind) {
+		if (filename.ends_with(fileKinds[kind].extension)) {
+			return static_cast<CompressedFile_t>(kind);
+		}
+	}
+	return COMPRESSED_FILE_NONE;
+}
+
+void loadDictionaries()
+{
+	const bool enabled = g_config.getNumber(ConfigManager::FILE_COMPRESSION_LEVEL) > 0;
+#ifdef TVP_ZSTD
+	std::error_code ec;
+	std::filesystem::create_directories(DICTIONARY_DIRECTORY, ec);
+
+	// named <kind>-<id>.dict, the newest of a kind is the one new files are compressed with
+	std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+	for (auto it = std::filesystem::directory_iterator(DICTIONARY_DIRECTORY, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+		if (it->path().extension() == ".dict") {
+			files.emplace_back(it->last_write_time(ec), it->path());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	for (const auto& [writeTime, path] : files) {
+		const std::string stem = path.stem().string();
+		const std::string_view name = std::string_view(stem).substr(0, stem.rfind('-'));
+		auto kind = std::find_if(fileKinds.begin(), fileKinds.end(), [name](const FileKind& fileKind) { return fileKind.name == name; });
+
+		std::string content;
+		if (kind == fileKinds.begin() || kind == fileKinds.end() || !readFile(path, content) ||
+				!addDictionary(static_cast<CompressedFile_t>(kind - fileKinds.begin()), std::move(content))) {
+			std::cout << "[Warning - filecompression::loadDictionaries] Cannot load " << path.string() << '.' << std::endl;
+		}
+	}
+
+	if (!enabled) {
+		return;
+	}
+
+	for (size_t kind = COMPRESSED_FILE_NONE + 1; kind <= COMPRESSED_FILE_LAST; ++kind) {
+		if (!fileKinds[kind].directory.empty() && !currentDictionaries[kind]) {
+			g_fileTasks.addTask([kind]() { trainDictionary(static_cast<CompressedFile_t>(kind)); });
+		}
+	}
+#else
+	if (enabled) {
+		std::cout << "> Warning: fileCompressionLevel is set, but the server was built without zstd. The save files are not compressed." << std::endl;
+	}
+#endif
+}
+
+bool isEnabled()
+{
+#ifdef TVP_ZSTD
+	return g_config.getNumber(ConfigManager::FILE_COMPRESSION_LEVEL) > 0;
+#else
+	return false;
+#endif
+}
+
+bool isCompressed(const char* data, size_t size)
+{
+	return size >= sizeof(FRAME_MAGIC) && std::equal(std::begin(FRAME_MAGIC), std::end(FRAME_MAGIC), data);
+}
+
+std::string compress(CompressedFile_t kind, std::string&& data)
+{
+	const int32_t level = g_config.getNumber(ConfigManager::FILE_COMPRESSION_LEVEL);
+	if (kind == COMPRESSED_FILE_NONE || level <= 0) {
+		return std::move(data);
+	}
+
+#ifdef TVP_ZSTD
+	thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context{ZSTD_createCCtx(), ZSTD_freeCCtx};
+
+	const int compressionLevel = std::min<int>(level, ZSTD_maxCLevel());
+
+	// the dictionary is kept alive while it is used, a newer one may replace it meanwhile
+	std::shared_ptr<Dictionary> dictionary;
+	ZSTD_CDict* compressionDictionary = nullptr;
+	{
+		std::lock_guard<std::mutex> lockClass(dictionaryLock);
+		dictionary = currentDictionaries[kind];
+		if (dictionary) {
+			if (!dictionary->compression || dictionary->compressionLevel != compressionLevel) {
+				ZSTD_freeCDict(dictionary->compression);
+				dictionary->compression = ZSTD_createCDict(dictionary->content.data(), dictionary->content.size(), compressionLevel);
+				dictionary->compressionLevel = compressionLevel;
+			}
+			compressionDictionary = dictionary->compression;
+		}
+	}
+
+	std::string compressed(ZSTD_compressBound(data.size()), '\0');
+	size_t size;
+	if (compressionDictionary) {
+		size = ZSTD_compress_usingCDict(context.get(), compressed.data(), compressed.size(), data.data(), data.size(), compressionDictionary);
+	} else {
+		size = ZSTD_compressCCtx(context.get(), compressed.data(), compressed.size(), data.data(), data.size(), compressionLevel);
+	}
+
+	if (ZSTD_isError(size)) {
+		std::cout << "[Error - filecompression::compress] " << ZSTD_getErrorName(size) << ", the file is written uncompressed." << std::endl;
+		return std::move(data);
+	}
+
+	compressed.resize(size);
+	return compressed;
+#else
+	return std::move(data);
+#endif
+}
+
+bool decompress(const char* data, size_t size, std::string& content)
+{
+	if (!isCompressed(data, size)) {
+		content.assign(data, size);
+		return true;
+	}
+
+#ifdef TVP_ZSTD
+	thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context{ZSTD_createDCtx(), ZSTD_freeDCtx};
+
+	// written by compress in one go, the frame always knows its size
+	const unsigned long long contentSize = ZSTD_getFrameContentSize(data, size);
+	if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+		return false;
+	}
+
+	std::shared_ptr<Dictionary> dictionary;
+	if (const uint32_t id = ZSTD_getDictID_fromFrame(data, size); id != 0) {
+		std::lock_guard<std::mutex> lockClass(dictionaryLock);
+		auto it = dictionaries.find(id);
+		if (it == dictionaries.end()) {
+			std::cout << "[Error - filecompression::decompress] Dictionary " << id << " is missing from " << DICTIONARY_DIRECTORY << '.' << std::endl;
+			return false;
+		}
+		dictionary = it->second;
+	}
+
+	content.resize(contentSize);
+	size_t result;
+	if (dictionary) {
+		result = ZSTD_decompress_usingDDict(context.get(), content.data(), content.size(), data, size, dictionary->decompression);
+	} else {
+		result = ZSTD_decompressDCtx(context.get(), content.data(), content.size(), data, size);
+	}
+
+	if (ZSTD_isError(result) || result != contentSize) {
+		content.clear();
+		return false;
+	}
+	return true;
+#else
+	std::cout << "[Error - filecompression::decompress] A compressed file cannot be read, the server was built without zstd." << std::endl;
+	return false;
+#endif
+}
+
+} // namespace filecompression
@@ -0,0 +1,42 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Optional zstd compression of the save files: the live map data, the house files and the text and
+ * binary player files. Every kind but the map has a dictionary trained from its own files, kept in
+ * gamedata/dictionaries. Each frame names its dictionary and none is ever removed, so files written
+ * with an older dictionary stay readable. Files that are not compressed read as they are, so turning
+ * compression on or off needs no conversion. Any thread.
+ */
+enum CompressedFile_t : uint8_t {
+	COMPRESSED_FILE_NONE,
+	COMPRESSED_FILE_MAP,
+	COMPRESSED_FILE_HOUSE,
+	COMPRESSED_FILE_PLAYER,
+	COMPRESSED_FILE_PLAYER_BINARY,
+
+	COMPRESSED_FILE_LAST = COMPRESSED_FILE_PLAYER_BINARY
+};
+
+namespace filecompression {
+
+// the kind of a save file by its extension, COMPRESSED_FILE_NONE for files that are never compressed (player exports too)
+CompressedFile_t getFileKind(std::string_view filename);
+
+// loads the dictionaries and trains the missing ones on the file thread while compression is on
+void loadDictionaries();
+
+// whether new files are written compressed
+bool isEnabled();
+
+bool isCompressed(const char* data, size_t size);
+
+// the contents to write to a file of kind, compressed while fileCompressionLevel is not 0
+std::string compress(CompressedFile_t kind, std::string&& data);
+
+// the contents of a file as they were before compress, false if they cannot be decompressed
+bool decompress(const char* data, size_t size, std::string& content);
+
+} // namespace filecompression
@@ -43,7 +43,6 @@ struct InvalidOTBFormat final : LoadError {
 class Loader {
 	MappedFile     fileContents;
 	Node              root;
-	std::vector<char> propBuffer;
 public:
 	Loader(const std::string& fileName, const Identifier& acceptedIdentifier);
 	bool getProps(const Node& node, PropStream& props);
@@ -126,12 +125,20 @@ class PropWriteStream
 			buffer.clear();
 		}
 
+		std::vector<char> release() {
+			return std::exchange(buffer, {});
+		}
+
 		template <typename T>
 		void write(T add) {
 			char* addr = reinterpret_cast<char*>(&add);
 			std::copy(addr, addr + sizeof(T), std::back_inserter(buffer));
 		}
 
+		void writeBytes(const char* bytes, size_t size) {
+			buffer.insert(buffer.end(), bytes, bytes + size);
+		}
+
 		void writeString(const std::string& str) {
 			size_t strLength = str.size();
 			if (strLength > std::numeric_limits<uint16_t>::max()) {
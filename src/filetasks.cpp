@@ -0,0 +1,274 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "filetasks.h"
+#include "configmanager.h"
+#include "filecompression.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern ConfigManager g_config;
+
+namespace {
+
+bool syncFile(FILE* file)
+{
+	if (fflush(file) != 0) {
+		return false;
+	}
+
+	if (!g_config.getBoolean(ConfigManager::SYNC_SAVE_FILES)) {
+		return true;
+	}
+
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+void syncDirectory(const std::string& directory)
+{
+#ifndef _WIN32
+	int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd == -1) {
+		std::cout << "[Error - FileTasks::syncDirectories] Cannot open " << directory << '.' << std::endl;
+		return;
+	}
+
+	if (fsync(fd) != 0) {
+		std::cout << "[Error - FileTasks::syncDirectories] Cannot flush " << directory << '.' << std::endl;
+	}
+	close(fd);
+#else
+	// NTFS journals the rename itself, there is no directory handle to flush
+	(void)directory;
+#endif
+}
+
+}
+
+void FileTasks::threadMain()
+{
+	std::unique_lock<std::mutex> taskLockUnique(taskLock, std::defer_lock);
+	while (getState() != THREAD_STATE_TERMINATED) {
+		taskLockUnique.lock();
+		if (tasks.empty() || paused) {
+			taskSignal.wait(taskLockUnique);
+		}
+
+		if (!tasks.empty() && !paused) {
+			auto task = std::move(tasks.front());
+			tasks.pop_front();
+			runningTask = true;
+			taskLockUnique.unlock();
+			task();
+
+			taskLockUnique.lock();
+			runningTask = false;
+			bool idle = tasks.empty();
+			taskLockUnique.unlock();
+			pauseSignal.notify_all();
+			if (idle) {
+				syncDirectories();
+			}
+		} else {
+			taskLockUnique.unlock();
+		}
+	}
+}
+
+void FileTasks::addTask(std::function<void()>&& task)
+{
+	bool signal = false;
+	taskLock.lock();
+	if (getState() == THREAD_STATE_TERMINATED && !inlineTasks) {
+		// queued behind the writes still pending, the file thread or shutdown may be running them
+		tasks.push_back(std::move(task));
+		bool joined = threadJoined;
+		taskLock.unlock();
+
+		if (joined) {
+			runPendingTasks();
+		}
+		return;
+	}
+
+	if (getState() != THREAD_STATE_RUNNING || inlineTasks) {
+		taskLock.unlock();
+		task();
+		syncDirectories();
+		return;
+	}
+
+	signal = tasks.empty();
+	tasks.push_back(std::move(task));
+	taskLock.unlock();
+
+	if (signal) {
+		taskSignal.notify_one();
+	}
+}
+
+void FileTasks::writeFile(const std::string& filename, std::string&& data, bool append/* = false*/, std::function<void(bool)> callback/* = nullptr*/)
+{
+	addFileTask(filename, [filename, data = std::move(data), append, callback = std::move(callback)]() mutable {
+		// appends would put a second frame after the first, the files appended to are never compressed
+		if (!append) {
+			data = filecompression::compress(filecompression::getFileKind(filename), std::move(data));
+		}
+
+		bool success = writeFileContents(filename, data.data(), data.size(), append);
+		if (callback) {
+			callback(success);
+		}
+	});
+}
+
+void FileTasks::removeFile(const std::string& filename)
+{
+	addFileTask(filename, [filename]() {
+		std::error_code ec;
+		std::filesystem::remove(filename, ec);
+		if (ec) {
+			std::cout << "[Error - FileTasks::removeFile] Cannot remove " << filename << ": " << ec.message() << std::endl;
+		}
+	});
+}
+
+void FileTasks::addFileTask(const std::string& filename, std::function<void()>&& task)
+{
+	taskLock.lock();
+	++pendingFiles[filename];
+	taskLock.unlock();
+
+	addTask([this, filename, task = std::move(task)]() {
+		task();
+
+		std::lock_guard<std::mutex> lockClass(taskLock);
+		unsyncedDirectories.insert(std::filesystem::path(filename).parent_path().string());
+
+		auto it = pendingFiles.find(filename);
+		if (--it->second == 0) {
+			pendingFiles.erase(it);
+			fileSignal.notify_all();
+		}
+	});
+}
+
+void FileTasks::waitForFile(const std::string& filename)
+{
+	std::unique_lock<std::mutex> taskLockUnique(taskLock);
+	fileSignal.wait(taskLockUnique, [&]() { return pendingFiles.find(filename) == pendingFiles.end(); });
+}
+
+bool FileTasks::isFilePending(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lockClass(taskLock);
+	return pendingFiles.find(filename) != pendingFiles.end();
+}
+
+void FileTasks::pause()
+{
+	std::unique_lock<std::mutex> taskLockUnique(taskLock);
+	paused = true;
+	pauseSignal.wait(taskLockUnique, [this]() { return !runningTask; });
+}
+
+void FileTasks::resume()
+{
+	taskLock.lock();
+	paused = false;
+	taskLock.unlock();
+	taskSignal.notify_one();
+}
+
+bool FileTasks::writeFileContents(const std::string& filename, const char* data, size_t size, bool append/* = false*/)
+{
+	const std::string tmpFilename = filename + ".tmp";
+	const std::string& target = append ? filename : tmpFilename;
+
+	FILE* file = fopen(target.c_str(), append ? "ab" : "wb");
+	if (!file) {
+		std::cout << "[Error - FileTasks::writeFileContents] Cannot open " << target << " for writing." << std::endl;
+		return false;
+	}
+
+	bool written = fwrite(data, 1, size, file) == size && syncFile(file);
+	if (fclose(file) != 0 || !written) {
+		std::cout << "[Error - FileTasks::writeFileContents] Cannot write " << target << '.' << std::endl;
+		return false;
+	}
+
+	if (append) {
+		return true;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpFilename, filename, ec);
+	if (ec) {
+		std::cout << "[Error - FileTasks::writeFileContents] Cannot replace " << filename << ": " << ec.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void FileTasks::runPendingTasks()
+{
+	std::lock_guard<std::mutex> drainGuard(drainLock);
+
+	std::unique_lock<std::mutex> guard{ taskLock };
+	while (!tasks.empty()) {
+		auto task = std::move(tasks.front());
+		tasks.pop_front();
+		guard.unlock();
+		task();
+		guard.lock();
+	}
+	guard.unlock();
+
+	syncDirectories();
+}
+
+void FileTasks::syncDirectories()
+{
+	std::set<std::string> directories;
+	{
+		std::lock_guard<std::mutex> lockClass(taskLock);
+		directories.swap(unsyncedDirectories);
+	}
+
+	if (!g_config.getBoolean(ConfigManager::SYNC_SAVE_FILES)) {
+		return;
+	}
+
+	for (const std::string& directory : directories) {
+		syncDirectory(directory);
+	}
+}
+
+void FileTasks::shutdown()
+{
+	taskLock.lock();
+	setState(THREAD_STATE_TERMINATED);
+	taskLock.unlock();
+	taskSignal.notify_one();
+
+	//the thread finishes the task at hand first, so writes to the same file keep their order
+	join();
+
+	taskLock.lock();
+	threadJoined = true;
+	taskLock.unlock();
+	runPendingTasks();
+}
@@ -0,0 +1,67 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <condition_variable>
+#include "thread_holder_base.h"
+
+/*
+ * Writes the save files (players, houses, live map data) on their own thread,
+ * so the dispatcher only pays for serializing into memory.
+ * Tasks run in the order they were added; before the thread starts they run right away, after shutdown
+ * they run on the caller once the tasks queued before them are done.
+ */
+class FileTasks : public ThreadHolder<FileTasks>
+{
+	public:
+		FileTasks() = default;
+		void shutdown();
+
+		void addTask(std::function<void()>&& task);
+
+		// replaces the file with data (or appends it), readers of the file must call waitForFile first
+		// save files are compressed on the file thread, see filecompression.h
+		// callback is told on the file thread whether the write succeeded
+		void writeFile(const std::string& filename, std::string&& data, bool append = false, std::function<void(bool)> callback = nullptr);
+		// removes the file, if it exists, once the writes queued before are done
+		void removeFile(const std::string& filename);
+		void waitForFile(const std::string& filename);
+		// whether a write or removal of the file is still queued
+		bool isFilePending(const std::string& filename);
+
+		// holds the queued tasks back until resume, returns once the task at hand is done
+		void pause();
+		void resume();
+		// for a forked child, which has no file thread: tasks run right away on the caller
+		void runInline() {
+			inlineTasks = true;
+		}
+
+		// writes aside, flushes and renames over the file, so a crash never leaves it half written
+		static bool writeFileContents(const std::string& filename, const char* data, size_t size, bool append = false);
+
+		void threadMain();
+	private:
+		void runPendingTasks();
+		void addFileTask(const std::string& filename, std::function<void()>&& task);
+		void syncDirectories();
+
+		std::list<std::function<void()>> tasks;
+		// directories with renamed or removed entries, flushed together once the queue runs dry
+		std::set<std::string> unsyncedDirectories;
+		std::unordered_map<std::string, uint32_t> pendingFiles;
+		std::mutex taskLock;
+		// held while the queue is run on a thread other than the file thread, so it is run in order
+		std::mutex drainLock;
+		std::condition_variable taskSignal;
+		std::condition_variable fileSignal;
+		std::condition_variable pauseSignal;
+		bool paused = false;
+		bool runningTask = false;
+		bool inlineTasks = false;
+		// set by shutdown once the file thread is gone, the queue is then run by whoever adds a task
+		bool threadJoined = false;
+};
+
+extern FileTasks g_fileTasks;
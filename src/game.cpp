@@ -12,21 +12,40 @@
 #include "creatureevent.h"
 #include "databasetasks.h"
 #include "events.h"
+#include "filetasks.h"
 #include "game.h"
 #include "globalevent.h"
 #include "iologindata.h"
+#include "iomap.h"
+#include "itemupdatebatch.h"
+#include "jobpool.h"
 #include "items.h"
+#include "loadshedder.h"
+#include "logger.h"
+#include "metrics.h"
 #include "monster.h"
 #include "movement.h"
+#include "packetrecorder.h"
 #include "scheduler.h"
 #include "server.h"
 #include "spells.h"
 #include "talkaction.h"
 #include "weapons.h"
+#include "worldsnapshot.h"
+#include "worldshards.h"
 #include "script.h"
+#include "profiler.h"
 
+#include <filesystem>
 #include <fmt/format.h>
 
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 extern ConfigManager g_config;
 extern Actions* g_actions;
 extern Chat* g_chat;
@@ -56,20 +75,68 @@ void Game::start(ServiceManager* manager)
 	updateWorldTime();
 
 	if (g_config.getBoolean(ConfigManager::DEFAULT_WORLD_LIGHT)) {
-		g_scheduler.addEvent(createSchedulerTask(EVENT_LIGHTINTERVAL, std::bind(&Game::checkLight, this)));
+		g_scheduler.addEvent(createSchedulerTask(EVENT_LIGHTINTERVAL, std::bind(&Game::checkLight, this), "Game::checkLight"));
 	}
-	g_scheduler.addEvent(createSchedulerTask(EVENT_CREATURE_THINK_INTERVAL, std::bind(&Game::checkCreatures, this, 0)));
-	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_CREATURE_THINK_INTERVAL, std::bind(&Game::checkCreatures, this, 0), "Game::checkCreatures"));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this), "Game::checkDecay"));
+	nextExecuteTime = OTSYS_TIME() + EVENT_EXECUTE_INTERVAL;
+	g_scheduler.addEvent(createSchedulerTask(EVENT_EXECUTE_INTERVAL, std::bind(&Game::executeCreatures, this), "Game::executeCreatures"));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_PLAYER_TIMERS_INTERVAL, std::bind(&Game::checkPlayerTimers, this), "Game::checkPlayerTimers"));
 }
 
 bool Game::loadMainMap(const std::string& filename)
 {
-	return map.loadMap("data/world/" + filename + ".otbm", true);
+	return map.loadTilesAndHouses("data/world/" + filename + ".otbm", true);
+}
+
+void Game::loadMainMapSpawns()
+{
+	map.loadSpawns();
+}
+
+bool Game::loadMap(const std::string& path)
+{
+	if (mapPatch) {
+		return false;
+	}
+
+	// the script is told right away, the errors of a file that is there show once it is decoded
+	std::error_code ec;
+	if (!std::filesystem::is_regular_file(path, ec)) {
+		std::cout << "[Error - Game::loadMap] Cannot find map patch " << path << '.' << std::endl;
+		return false;
+	}
+
+	std::cout << ">> Loading map patch " << path << '.' << std::endl;
+	mapPatch = std::make_shared<MapPatch>(path);
+	g_fileTasks.addTask([patch = mapPatch]() {
+		patch->decode();
+		g_dispatcher.addTask(createTask(std::bind(&Game::applyMapPatch, &g_game)));
+	});
+	return true;
 }
 
-void Game::loadMap(const std::string& path)
+void Game::applyMapPatch()
 {
-	map.loadMapPart(path, true, true);
+	if (!mapPatch) {
+		return;
+	}
+
+	if (!mapPatch->getError().empty()) {
+		std::cout << "[Error - Game::applyMapPatch] " << mapPatch->getFileName() << ": " << mapPatch->getError() << std::endl;
+		mapPatch.reset();
+		return;
+	}
+
+	// one batch per task, whatever was queued meanwhile runs in between
+	if (mapPatch->applyBatch(map)) {
+		g_dispatcher.addTask(createTask(std::bind(&Game::applyMapPatch, this)));
+		return;
+	}
+
+	std::cout << ">> Applied map patch " << mapPatch->getFileName() << ": " << mapPatch->getChangedTiles() << " tiles changed, " <<
+		mapPatch->getUnchangedTiles() << " unchanged, " << mapPatch->getHouseTiles() << " house tiles left alone." << std::endl;
+	mapPatch.reset();
 }
 
 GameState_t Game::getGameState() const
@@ -108,7 +175,8 @@ void Game::setGameState(GameState_t newState)
 
 			loadMotdNum();
 			loadPlayersRecord();
-			loadAccountStorageValues();
+			IOLoginData::resetOnlineStatus();
+			loadGuilds();
 
 			g_globalEvents->startup();
 
@@ -118,10 +186,9 @@ void Game::setGameState(GameState_t newState)
 				Database::getInstance().executeQuery("UPDATE `players` SET `posx` = 0 WHERE 1;");
 			}
 
-			processCommunication();
-			processRemovedCreatures();
-			proceduralRefreshMap();
-			processConditions();
+			statementLog.setLimits(g_config.getNumber(ConfigManager::STATEMENT_LOG_SIZE), g_config.getNumber(ConfigManager::STATEMENT_LISTENER_LOG_SIZE));
+
+			startWorldEvents();
 			break;
 		}
 
@@ -149,6 +216,7 @@ void Game::setGameState(GameState_t newState)
 
 			g_scheduler.stop();
 			g_databaseTasks.stop();
+			g_fileTasks.stop();
 			g_dispatcher.stop();
 			break;
 		}
@@ -158,6 +226,19 @@ void Game::setGameState(GameState_t newState)
 	}
 }
 
+void Game::startWorldEvents()
+{
+	processCommunication();
+	processRemovedCreatures();
+	proceduralRefreshMap();
+	processConditions();
+	flushOnlineStatus();
+
+	if (g_config.getNumber(ConfigManager::PLAYER_AUTOSAVE_INTERVAL) > 0) {
+		g_scheduler.addEvent(createSchedulerTask(EVENT_AUTOSAVE_INTERVAL, std::bind(&Game::autosavePlayers, this), "Game::autosavePlayers"));
+	}
+}
+
 #if !defined(_MSC_VER)
 __attribute__((used))
 #endif
@@ -168,24 +249,186 @@ void Game::saveGameState()
 	}
 
 	std::cout << "> Saving game..." << std::endl;
+	const auto saveStart = std::chrono::steady_clock::now();
 
-	if (!saveAccountStorageValues()) {
-		std::cout << "[Error - Game::saveGameState] Failed to save account-level storage values." << std::endl;
-	}
+	// the houses are saved without the items on their way to a depot, and the depots with them
+	map.houses.finishDepotTransfers();
 
+	std::vector<Player*> onlinePlayers;
+	onlinePlayers.reserve(players.size());
 	for (const auto& it : players) {
-		IOLoginData::savePlayer(it.second);
+		onlinePlayers.push_back(it.second);
 	}
 
-	Map::save();
+	// the shutdown save is written before the process ends, it never forks
+	if (gameState == GAME_STATE_SHUTDOWN || !g_config.getBoolean(ConfigManager::FORK_SAVE) || !forkSaveGameState(onlinePlayers)) {
+		// the files written now must land after the ones of a forked save still running
+		checkForkedSave(true);
 
+		if (!saveAccountStorageValues()) {
+			std::cout << "[Error - Game::saveGameState] Failed to save account-level storage values." << std::endl;
+		}
+
+		IOLoginData::savePlayers(onlinePlayers);
+
+		Map::save();
+	}
+
+	IOLoginData::flushOnlineStatus();
 	g_databaseTasks.flush();
 
+	saveStats.lastTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - saveStart);
+	saveStats.totalTime += saveStats.lastTime;
+	++saveStats.saves;
+
 	if (gameState == GAME_STATE_MAINTAIN) {
 		setGameState(GAME_STATE_NORMAL);
 	}
 }
 
+void Game::flushOnlineStatus()
+{
+	IOLoginData::flushOnlineStatus();
+	g_scheduler.addEvent(createSchedulerTask(EVENT_ONLINE_STATUS_INTERVAL, std::bind(&Game::flushOnlineStatus, this), "Game::flushOnlineStatus"));
+}
+
+bool Game::forkSaveGameState(const std::vector<Player*>& onlinePlayers)
+{
+#ifdef _WIN32
+	(void)onlinePlayers;
+	return false;
+#else
+	if (forkedSave.pid != 0) {
+		// the tiles stay in the journal for the next save, the queries below are sent as always
+		std::cout << "> Warning: The last forked save is still being written, the files of this save are skipped." << std::endl;
+		saveGameStateDatabase(onlinePlayers);
+		return true;
+	}
+
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cout << "[Error - Game::forkSaveGameState] Cannot create a pipe, the game is saved without forking." << std::endl;
+		return false;
+	}
+
+	// the copy has no file thread, so no write may be halfway through when it forks
+	// the files of the game wait until the copy is done, so they land after the ones it writes
+	g_fileTasks.pause();
+	// the copy writes a full snapshot, the deltas of later saves cannot build on what only it knows
+	IOMap::discardSavedMapData();
+
+	pid_t pid;
+	{
+		// the copy has only the thread that forks, a lock held by another thread would stay taken in it forever
+		auto playerFileCacheLock = IOLoginData::lockPlayerFileCache();
+		pid = fork();
+	}
+
+	if (pid == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		g_fileTasks.resume();
+		std::cout << "[Error - Game::forkSaveGameState] Cannot fork, the game is saved without forking." << std::endl;
+		return false;
+	}
+
+	if (pid == 0) {
+		// the copy: this is its only thread, it writes the files and never touches the database or lua
+		close(fds[0]);
+		for (int signal : {SIGINT, SIGTERM, SIGHUP, SIGUSR1}) {
+			std::signal(signal, SIG_DFL);
+		}
+		g_fileTasks.runInline();
+
+		bool saved = true;
+		for (Player* player : onlinePlayers) {
+			saved = IOLoginData::savePlayerFile(player) && saved;
+		}
+
+		if (isMapSavingEnabled()) {
+			saved = IOMap::saveMapData() && saved;
+		}
+		saved = IOMap::saveHouseItems() && saved;
+
+		const char status = saved ? 1 : 0;
+		if (write(fds[1], &status, 1) != 1) {
+			saved = false;
+		}
+		// the state of the copy is the game's, none of it may be destroyed
+		_exit(saved ? 0 : 1);
+	}
+
+	close(fds[1]);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	forkedSave.pid = pid;
+	forkedSave.pipe = fds[0];
+	forkedSave.start = std::chrono::steady_clock::now();
+
+	// the copy writes the tiles changed so far
+	clearTileSaveJournal();
+	saveGameStateDatabase(onlinePlayers);
+
+	g_scheduler.addEvent(createSchedulerTask(EVENT_FORKED_SAVE_INTERVAL, std::bind(&Game::checkForkedSave, this, false), "Game::checkForkedSave"));
+	return true;
+#endif
+}
+
+void Game::saveGameStateDatabase(const std::vector<Player*>& onlinePlayers)
+{
+	if (!saveAccountStorageValues()) {
+		std::cout << "[Error - Game::saveGameState] Failed to save account-level storage values." << std::endl;
+	}
+
+	for (Player* player : onlinePlayers) {
+		IOLoginData::savePlayerDatabase(player);
+	}
+
+	if (!IOMap::saveHouseDatabaseInformation()) {
+		std::cout << "[Error - Game::forkSaveGameState] Failed to save the house information." << std::endl;
+	}
+}
+
+void Game::checkForkedSave(bool wait)
+{
+#ifndef _WIN32
+	if (forkedSave.pid == 0) {
+		return;
+	}
+
+	if (wait) {
+		fcntl(forkedSave.pipe, F_SETFL, 0);
+	}
+
+	char status = 0;
+	ssize_t size;
+	do {
+		size = read(forkedSave.pipe, &status, 1);
+	} while (size == -1 && errno == EINTR);
+
+	if (size == -1 && errno == EAGAIN) {
+		g_scheduler.addEvent(createSchedulerTask(EVENT_FORKED_SAVE_INTERVAL, std::bind(&Game::checkForkedSave, this, false), "Game::checkForkedSave"));
+		return;
+	}
+
+	// the copy exits right after it reports, or it died and the pipe closed
+	int exitStatus = 0;
+	while (waitpid(forkedSave.pid, &exitStatus, 0) == -1 && errno == EINTR) {}
+	close(forkedSave.pipe);
+	g_fileTasks.resume();
+
+	const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - forkedSave.start);
+	if (size == 1 && status == 1 && WIFEXITED(exitStatus) && WEXITSTATUS(exitStatus) == 0) {
+		std::cout << "> Forked save written in: " << duration.count() / 1000. << " s" << std::endl;
+	} else {
+		std::cout << "[Error - Game::checkForkedSave] The forked save failed, some files of the last save may be missing." << std::endl;
+	}
+
+	forkedSave = {};
+#else
+	(void)wait;
+#endif
+}
+
 Cylinder* Game::internalGetCylinder(Player* player, const Position& pos) const
 {
 	if (pos.x != 0xFFFF) {
@@ -357,40 +600,22 @@ void Game::internalGetPosition(Item* item, Position& pos, uint8_t& stackpos)
 
 Creature* Game::getCreatureByID(uint32_t id)
 {
-	if (id <= Player::playerAutoID) {
-		return getPlayerByID(id);
-	} else if (id <= Monster::monsterAutoID) {
-		return getMonsterByID(id);
-	} else if (id <= Npc::npcAutoID) {
+	if (id >= Npc::ID_BASE) {
 		return getNpcByID(id);
+	} else if (id >= Monster::ID_BASE) {
+		return getMonsterByID(id);
 	}
-	return nullptr;
+	return getPlayerByID(id);
 }
 
 Monster* Game::getMonsterByID(uint32_t id)
 {
-	if (id == 0) {
-		return nullptr;
-	}
-
-	auto it = monsters.find(id);
-	if (it == monsters.end()) {
-		return nullptr;
-	}
-	return it->second;
+	return monsters.get(id);
 }
 
 Npc* Game::getNpcByID(uint32_t id)
 {
-	if (id == 0) {
-		return nullptr;
-	}
-
-	auto it = npcs.find(id);
-	if (it == npcs.end()) {
-		return nullptr;
-	}
-	return it->second;
+	return npcs.get(id);
 }
 
 Player* Game::getPlayerByID(uint32_t id)
@@ -412,33 +637,28 @@ Creature* Game::getCreatureByName(const std::string& s)
 		return nullptr;
 	}
 
-	const std::string& lowerCaseName = asLowerCaseString(s);
-
 	{
-		auto it = mappedPlayerNames.find(lowerCaseName);
+		auto it = mappedPlayerNames.find(s);
 		if (it != mappedPlayerNames.end()) {
 			return it->second;
 		}
 	}
 
-	auto equalCreatureName = [&](const std::pair<uint32_t, Creature*>& it) {
-		auto name = it.second->getName();
-		return lowerCaseName.size() == name.size() && std::equal(lowerCaseName.begin(), lowerCaseName.end(), name.begin(), [](char a, char b) {
-			return a == std::tolower(b);
-		});
+	auto equalCreatureName = [&](const Creature* creature) {
+		return CaseInsensitiveEqual()(s, creature->getName());
 	};
 
 	{
 		auto it = std::find_if(npcs.begin(), npcs.end(), equalCreatureName);
 		if (it != npcs.end()) {
-			return it->second;
+			return *it;
 		}
 	}
 
 	{
 		auto it = std::find_if(monsters.begin(), monsters.end(), equalCreatureName);
 		if (it != monsters.end()) {
-			return it->second;
+			return *it;
 		}
 	}
 
@@ -452,9 +672,9 @@ Npc* Game::getNpcByName(const std::string& s)
 	}
 
 	const char* npcName = s.c_str();
-	for (const auto& it : npcs) {
-		if (strcasecmp(npcName, it.second->getName().c_str()) == 0) {
-			return it.second;
+	for (Npc* npc : npcs) {
+		if (strcasecmp(npcName, npc->getName().c_str()) == 0) {
+			return npc;
 		}
 	}
 	return nullptr;
@@ -466,7 +686,7 @@ Player* Game::getPlayerByName(const std::string& s)
 		return nullptr;
 	}
 
-	auto it = mappedPlayerNames.find(asLowerCaseString(s));
+	auto it = mappedPlayerNames.find(s);
 	if (it == mappedPlayerNames.end()) {
 		return nullptr;
 	}
@@ -545,11 +765,19 @@ bool Game::placeCreature(Creature* creature, const Position& pos, bool forced /*
 		return false;
 	}
 
+	if (placeCreaturesDepth != 0) {
+		// announced by endPlaceCreatures
+		creature->incrementReferenceCounter();
+		placedCreatures.push_back(creature);
+		return true;
+	}
+
 	SpectatorVec spectators;
 	map.getSpectators(spectators, creature->getPosition(), true);
+	const TileStackpos stackpos(creature->getTile(), creature);
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendCreatureAppear(creature, creature->getPosition());
+			tmpPlayer->sendCreatureAppear(creature, creature->getPosition(), stackpos);
 		}
 	}
 
@@ -557,6 +785,126 @@ bool Game::placeCreature(Creature* creature, const Position& pos, bool forced /*
 		spectator->onCreatureAppear(creature, true);
 	}
 
+	onPlacedCreature(creature);
+	return true;
+}
+
+std::vector<Creature*> Game::placeCreatures(const std::vector<std::pair<Creature*, Position>>& creatures)
+{
+	std::vector<Creature*> placed;
+	beginPlaceCreatures();
+	for (const auto& it : creatures) {
+		if (placeCreature(it.first, it.second, true)) {
+			placed.push_back(it.first);
+		}
+	}
+	endPlaceCreatures();
+	return placed;
+}
+
+void Game::beginPlaceCreatures()
+{
+	++placeCreaturesDepth;
+}
+
+void Game::endPlaceCreatures()
+{
+	if (--placeCreaturesDepth != 0) {
+		return;
+	}
+
+	std::vector<Creature*> creatures = std::move(placedCreatures);
+	placedCreatures.clear();
+
+	// a creature only learns about the ones placed before it, as with one placeCreature call each
+	std::unordered_set<const Creature*> pending(creatures.begin(), creatures.end());
+
+	// nearby creatures share one spectator lookup, the regions are announced in the order their first
+	// creature was placed and the creatures of a region in the order they were placed
+	std::map<std::tuple<uint8_t, uint16_t, uint16_t>, size_t> regionIndexes;
+	std::vector<std::vector<Creature*>> regions;
+	for (Creature* creature : creatures) {
+		if (creature->isRemoved()) {
+			pending.erase(creature);
+			continue;
+		}
+
+		const Position& pos = creature->getPosition();
+		auto it = regionIndexes.try_emplace(std::make_tuple(pos.z, pos.y >> PLACE_CREATURES_REGION_BITS, pos.x >> PLACE_CREATURES_REGION_BITS), regions.size()).first;
+		if (it->second == regions.size()) {
+			regions.emplace_back();
+		}
+		regions[it->second].push_back(creature);
+	}
+
+	for (std::vector<Creature*>& region : regions) {
+		announcePlacedCreatures(region.begin(), region.end(), pending);
+	}
+
+	for (Creature* creature : creatures) {
+		ReleaseCreature(creature);
+	}
+}
+
+void Game::announcePlacedCreatures(std::vector<Creature*>::iterator first, std::vector<Creature*>::iterator last, std::unordered_set<const Creature*>& pending)
+{
+	// one box holding the spectators of every creature, the floor offset shifts it diagonally
+	const Position& centerPos = (*first)->getPosition();
+	int32_t minX = std::numeric_limits<int32_t>::max(), maxX = std::numeric_limits<int32_t>::min();
+	int32_t minY = std::numeric_limits<int32_t>::max(), maxY = std::numeric_limits<int32_t>::min();
+	int32_t minZ = MAP_MAX_LAYERS, maxZ = -1;
+	for (auto it = first; it != last; ++it) {
+		const Position& pos = (*it)->getPosition();
+		minX = std::min<int32_t>(minX, pos.x + pos.z);
+		maxX = std::max<int32_t>(maxX, pos.x + pos.z);
+		minY = std::min<int32_t>(minY, pos.y + pos.z);
+		maxY = std::max<int32_t>(maxY, pos.y + pos.z);
+
+		int32_t minRangeZ, maxRangeZ;
+		Map::getSpectatorFloors(pos, true, minRangeZ, maxRangeZ);
+		minZ = std::min(minZ, minRangeZ);
+		maxZ = std::max(maxZ, maxRangeZ);
+	}
+
+	const int32_t centerX = centerPos.x + centerPos.z;
+	const int32_t centerY = centerPos.y + centerPos.z;
+	SpectatorVec spectators;
+	map.getSpectatorsInternal(spectators, centerPos, minX - centerX - Map::maxViewportX, maxX - centerX + Map::maxViewportX,
+		minY - centerY - Map::maxViewportY, maxY - centerY + Map::maxViewportY, minZ, maxZ, false);
+
+	for (auto it = first; it != last; ++it) {
+		Creature* creature = *it;
+		pending.erase(creature);
+
+		const Position& pos = creature->getPosition();
+		int32_t minRangeZ, maxRangeZ;
+		Map::getSpectatorFloors(pos, true, minRangeZ, maxRangeZ);
+		const Map::SpectatorCacheKey range{pos, -Map::maxViewportX, Map::maxViewportX, -Map::maxViewportY, Map::maxViewportY, minRangeZ, maxRangeZ, false};
+
+		SpectatorVec creatureSpectators;
+		for (Creature* spectator : spectators) {
+			if (pending.count(spectator) == 0 && range.covers(spectator->getPosition())) {
+				creatureSpectators.emplace_back(spectator);
+			}
+		}
+
+		const TileStackpos stackpos(creature->getTile(), creature);
+		for (Creature* spectator : creatureSpectators) {
+			if (Player* tmpPlayer = spectator->getPlayer()) {
+				tmpPlayer->sendCreatureAppear(creature, pos, stackpos);
+			}
+		}
+
+		for (Creature* spectator : creatureSpectators) {
+			spectator->onCreatureAppear(creature, true);
+		}
+
+		onPlacedCreature(creature);
+	}
+}
+
+void Game::onPlacedCreature(Creature* creature)
+{
 	creature->getParent()->postAddNotification(creature, nullptr, 0);
 
 	addCreatureCheck(creature);
@@ -566,8 +914,6 @@ bool Game::placeCreature(Creature* creature, const Position& pos, bool forced /*
 	if (creature->getPlayer()) {
 		addMagicEffect(creature->getPosition(), CONST_ME_TELEPORT);
 	}
-
-	return true;
 }
 
 bool Game::removeCreature(Creature* creature, bool isLogout/* = true*/)
@@ -582,9 +928,10 @@ bool Game::removeCreature(Creature* creature, bool isLogout/* = true*/)
 
 	SpectatorVec spectators;
 	map.getSpectators(spectators, tile->getPosition(), true);
+	const TileStackpos stackpos(tile, creature);
 	for (Creature* spectator : spectators) {
 		if (Player* player = spectator->getPlayer()) {
-			oldStackPosVector.push_back(player->canSeeCreature(creature) ? tile->getClientIndexOfCreature(player, creature) : -1);
+			oldStackPosVector.push_back(player->canSeeCreature(creature) ? stackpos.get(player) : -1);
 		}
 	}
 
@@ -935,6 +1282,16 @@ ReturnValue Game::internalMoveCreature(Creature* creature, Direction direction,
 
 ReturnValue Game::internalMoveCreature(Creature& creature, Tile& toTile, uint32_t flags /*= 0*/)
 {
+	// only players leave the areas of the shard, and only when they may log out
+	if (!g_worldShards.isOwned(toTile.getPosition())) {
+		const Player* player = creature.getPlayer();
+		if (!player) {
+			return RETURNVALUE_NOTPOSSIBLE;
+		} else if (!player->canLeaveShard()) {
+			return RETURNVALUE_YOUMAYNOTLOGOUTDURINGAFIGHT;
+		}
+	}
+
 	//check if we can move the creature to the destination
 	ReturnValue ret = toTile.queryAdd(0, creature, 1, flags);
 	if (ret != RETURNVALUE_NOERROR) {
@@ -1430,9 +1787,7 @@ ReturnValue Game::internalMoveItem(Cylinder* fromCylinder, Cylinder* toCylinder,
 
 	if (moveItem && moveItem->getDuration() > 0) {
 		if (moveItem->getDecaying() != DECAYING_TRUE) {
-			moveItem->incrementReferenceCounter();
-			moveItem->setDecaying(DECAYING_TRUE);
-			toDecayItems.push_front(moveItem);
+			scheduleDecay(moveItem);
 		}
 	}
 
@@ -1443,6 +1798,191 @@ ReturnValue Game::internalMoveItem(Cylinder* fromCylinder, Cylinder* toCylinder,
 	return ret;
 }
 
+ReturnValue Game::internalMoveItems(const ItemVector& items, Container* toContainer, uint32_t flags/* = 0*/, Creature* actor/* = nullptr*/)
+{
+	struct ItemMove {
+		Item* item;
+		// the stacks of toContainer the item merges into and how much goes to each
+		std::vector<std::pair<Item*, uint32_t>> merges;
+	};
+
+	std::vector<ItemMove> moves;
+	moves.reserve(items.size());
+
+	std::unordered_set<const Item*> seen;
+	for (Item* item : items) {
+		Cylinder* fromCylinder = item->getParent();
+		if (!fromCylinder || fromCylinder == toContainer || !seen.insert(item).second) {
+			continue;
+		}
+
+		if (!item->isPickupable()) {
+			return RETURNVALUE_CANNOTPICKUP;
+		}
+
+		if (item == toContainer) {
+			return RETURNVALUE_THISISIMPOSSIBLE;
+		}
+
+		for (const Cylinder* cylinder = toContainer->getParent(); cylinder; cylinder = cylinder->getParent()) {
+			if (cylinder == item) {
+				return RETURNVALUE_THISISIMPOSSIBLE;
+			}
+		}
+
+		ReturnValue ret = fromCylinder->queryRemove(*item, item->getItemCount(), flags, actor);
+		if (ret != RETURNVALUE_NOERROR) {
+			return ret;
+		}
+
+		moves.push_back({item, {}});
+	}
+
+	if (moves.empty()) {
+		return RETURNVALUE_NOERROR;
+	}
+
+	const Cylinder* topParent = toContainer->getTopParent();
+	if (actor && g_config.getBoolean(ConfigManager::ONLY_INVITED_CAN_MOVE_HOUSE_ITEMS)) {
+		const Tile* tile = topParent->getTile();
+		if (const House* house = tile ? tile->getHouse() : nullptr) {
+			if (!topParent->getCreature() && !house->isInvited(actor->getPlayer())) {
+				return RETURNVALUE_PLAYERISNOTINVITED;
+			}
+		}
+	}
+
+	// plan the merges up front, the remainder of a stack fills a slot and is an open stack itself
+	std::vector<std::pair<Item*, uint32_t>> openStacks;
+	for (Item* toItem : toContainer->getItemList()) {
+		if (toItem->isStackable() && toItem->getItemCount() < 100) {
+			openStacks.emplace_back(toItem, toItem->getItemCount());
+		}
+	}
+
+	size_t neededSlots = 0;
+	for (ItemMove& move : moves) {
+		Item* item = move.item;
+		if (!item->isStackable()) {
+			++neededSlots;
+			continue;
+		}
+
+		uint32_t count = item->getItemCount();
+		for (auto& [stack, stackCount] : openStacks) {
+			if (count == 0) {
+				break;
+			}
+
+			if (stackCount < 100 && item->equals(stack)) {
+				uint32_t n = std::min<uint32_t>(100 - stackCount, count);
+				move.merges.emplace_back(stack, n);
+				stackCount += n;
+				count -= n;
+			}
+		}
+
+		if (count != 0) {
+			openStacks.emplace_back(item, count);
+			++neededSlots;
+		}
+	}
+
+	if (!hasBitSet(FLAG_NOLIMIT, flags)) {
+		if (toContainer->size() + neededSlots > toContainer->capacity()) {
+			return RETURNVALUE_CONTAINERNOTENOUGHROOM;
+		}
+
+		if (Player* player = toContainer->getHoldingPlayer()) {
+			uint64_t weight = 0;
+			bool fromOutside = false;
+			for (const ItemMove& move : moves) {
+				const Item* item = move.item;
+				if (item->getTopParent() != player) {
+					weight += item->getWeight();
+					fromOutside = true;
+				}
+			}
+
+			if (fromOutside) {
+				if (player->hasFlag(PlayerFlag_CannotPickupItem)) {
+					return RETURNVALUE_NOTENOUGHCAPACITY;
+				}
+
+				if (!player->hasFlag(PlayerFlag_HasInfiniteCapacity) && weight > player->getFreeCapacity()) {
+					return RETURNVALUE_NOTENOUGHCAPACITY;
+				}
+			}
+		}
+
+		const DepotLocker* depotLocker = toContainer->getDepotLocker();
+		if (!depotLocker) {
+			depotLocker = toContainer->getHoldingDepot();
+		}
+
+		if (depotLocker) {
+			uint32_t addedCount = 0;
+			for (const ItemMove& move : moves) {
+				const Item* item = move.item;
+				if (item->getHoldingDepot() != depotLocker) {
+					const Container* container = item->getContainer();
+					addedCount += 1 + (container ? container->getItemHoldingCount() : 0);
+				}
+			}
+
+			if (depotLocker->getItemHoldingCount() + addedCount > depotLocker->getMaxDepotItems()) {
+				return RETURNVALUE_DEPOTISFULL;
+			}
+		}
+	}
+
+	// the packets, spectator lookups and stats of the whole move go out once this ends
+	ItemUpdateBatch batch;
+	for (const ItemMove& move : moves) {
+		Item* item = move.item;
+		Cylinder* fromCylinder = item->getParent();
+		int32_t itemIndex = fromCylinder->getThingIndex(item);
+
+		uint32_t count = item->getItemCount();
+		for (const auto& [stack, n] : move.merges) {
+			toContainer->updateThing(stack, stack->getID(), stack->getItemCount() + n);
+			count -= n;
+		}
+
+		fromCylinder->removeThing(item, item->getItemCount());
+		if (count != 0) {
+			// detached, so the new count needs no update of its own
+			item->setItemCount(count);
+			toContainer->addThing(item);
+		}
+
+		if (itemIndex != -1) {
+			fromCylinder->postRemoveNotification(item, toContainer, itemIndex);
+		}
+
+		if (count != 0) {
+			int32_t moveItemIndex = toContainer->getThingIndex(item);
+			if (moveItemIndex != -1) {
+				toContainer->postAddNotification(item, fromCylinder, moveItemIndex);
+			}
+
+			if (item->getDuration() > 0 && item->getDecaying() != DECAYING_TRUE) {
+				scheduleDecay(item);
+			}
+		} else if (item->isRemoved()) {
+			ReleaseItem(item);
+		}
+
+		for (const auto& [stack, n] : move.merges) {
+			int32_t updateItemIndex = toContainer->getThingIndex(stack);
+			if (updateItemIndex != -1) {
+				toContainer->postAddNotification(stack, fromCylinder, updateItemIndex);
+			}
+		}
+	}
+	return RETURNVALUE_NOERROR;
+}
+
 ReturnValue Game::internalAddItem(Cylinder* toCylinder, Item* item, int32_t index /*= INDEX_WHEREEVER*/,
                                   uint32_t flags/* = 0*/, bool test/* = false*/)
 {
@@ -1525,9 +2065,7 @@ ReturnValue Game::internalAddItem(Cylinder* toCylinder, Item* item, int32_t inde
 	}
 
 	if (item->getDuration() > 0) {
-		item->incrementReferenceCounter();
-		item->setDecaying(DECAYING_TRUE);
-		toDecayItems.push_front(item);
+		scheduleDecay(item);
 	}
 
 	return RETURNVALUE_NOERROR;
@@ -1567,9 +2105,7 @@ ReturnValue Game::internalRemoveItem(Item* item, int32_t count /*= -1*/, bool te
 
 		if (item->isRemoved()) {
 			item->onRemoved();
-			if (item->canDecay()) {
-				decayItems->remove(item);
-			}
+			stopDecay(item);
 			ReleaseItem(item);
 		}
 
@@ -2012,6 +2548,7 @@ Item* Game::transformItem(Item* item, uint16_t newId, int32_t newCount /*= -1*/)
 
 					item->setParent(nullptr);
 					cylinder->postRemoveNotification(item, cylinder, itemIndex);
+					stopDecay(item);
 					ReleaseItem(item);
 					return newItem;
 				} else {
@@ -2036,6 +2573,10 @@ Item* Game::transformItem(Item* item, uint16_t newId, int32_t newCount /*= -1*/)
 			}
 
 			cylinder->updateThing(item, itemId, count);
+			if (!item->canDecay()) {
+				// e.g. an unequipped ring, it keeps whatever time it had left
+				stopDecay(item);
+			}
 			cylinder->postAddNotification(item, cylinder, itemIndex);
 			return item;
 		}
@@ -2058,13 +2599,12 @@ Item* Game::transformItem(Item* item, uint16_t newId, int32_t newCount /*= -1*/)
 
 	item->setParent(nullptr);
 	cylinder->postRemoveNotification(item, cylinder, itemIndex);
+	stopDecay(item);
 	ReleaseItem(item);
 
 	if (newItem->getDuration() > 0) {
 		if (newItem->getDecaying() != DECAYING_TRUE) {
-			newItem->incrementReferenceCounter();
-			newItem->setDecaying(DECAYING_TRUE);
-			toDecayItems.push_front(newItem);
+			scheduleDecay(newItem);
 		}
 	}
 
@@ -2085,6 +2625,15 @@ ReturnValue Game::internalTeleport(Thing* thing, const Position& newPos, bool pu
 	}
 
 	if (Creature* creature = thing->getCreature()) {
+		if (!g_worldShards.isOwned(newPos)) {
+			const Player* player = creature->getPlayer();
+			if (!player) {
+				return RETURNVALUE_NOTPOSSIBLE;
+			} else if (!player->canLeaveShard()) {
+				return RETURNVALUE_YOUMAYNOTLOGOUTDURINGAFIGHT;
+			}
+		}
+
 		ReturnValue ret = toTile->queryAdd(0, *creature, 1, FLAG_NOLIMIT);
 		if (ret != RETURNVALUE_NOERROR) {
 			return ret;
@@ -2897,36 +3446,23 @@ void Game::playerRequestTrade(uint32_t playerId, const Position pos, uint8_t sta
 		return;
 	}
 
-	Container* tradeItemContainer = tradeItem->getContainer();
-	if (tradeItemContainer) {
-		for (const auto& it : tradeItems) {
-			Item* item = it.first;
-			if (tradeItem == item) {
-				player->sendCancelMessage(RETURNVALUE_NOTPOSSIBLE);
-				return;
-			}
-
-			if (tradeItemContainer->isHoldingItem(item)) {
-				player->sendCancelMessage(RETURNVALUE_NOTPOSSIBLE);
-				return;
-			}
+	// the item, or a container holding it, is already being traded
+	for (Thing* thing = tradeItem; thing; thing = thing->getParent()) {
+		Item* item = thing->getItem();
+		if (!item) {
+			break;
+		}
 
-			Container* container = item->getContainer();
-			if (container && container->isHoldingItem(tradeItem)) {
-				player->sendCancelMessage(RETURNVALUE_NOTPOSSIBLE);
-				return;
-			}
+		if (tradeItems.contains(item)) {
+			player->sendCancelMessage(RETURNVALUE_NOTPOSSIBLE);
+			return;
 		}
-	} else {
-		for (const auto& it : tradeItems) {
-			Item* item = it.first;
-			if (tradeItem == item) {
-				player->sendCancelMessage(RETURNVALUE_NOTPOSSIBLE);
-				return;
-			}
+	}
 
-			Container* container = item->getContainer();
-			if (container && container->isHoldingItem(tradeItem)) {
+	// something inside the container is already being traded
+	if (const Container* tradeItemContainer = tradeItem->getContainer()) {
+		for (const auto& it : tradeItems) {
+			if (tradeItemContainer->isHoldingItem(it.first)) {
 				player->sendCancelMessage(RETURNVALUE_NOTPOSSIBLE);
 				return;
 			}
@@ -3559,132 +4095,52 @@ void Game::playerSay(uint32_t playerId, uint16_t channelId, SpeakClasses type,
 
 void Game::registerFailedAccountLogin(uint32_t accountNumber)
 {
-	std::lock_guard<std::mutex> lock(gameLock);
-
-	if (g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_ACCOUNT_LOCK) == 0) {
+	const uint32_t maxAttempts = g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_ACCOUNT_LOCK);
+	if (maxAttempts == 0) {
 		return;
 	}
 
-	auto it = accountLoginAttemptsMap.find(accountNumber);
-	if (it == accountLoginAttemptsMap.end()) {
-		auto pair = std::make_pair<uint32_t, uint64_t>(1, OTSYS_TIME());
-		accountLoginAttemptsMap[accountNumber] = pair;
-	}
-	else {
-		it->second.first++;
-		if (it->second.first >= g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_ACCOUNT_LOCK)) {
-			it->second.second = OTSYS_TIME() + g_config.getNumber(ConfigManager::ACCOUNT_LOCK_DURATION);
-		}
-	}
+	accountLoginAttempts.registerAttempt(accountNumber, maxAttempts, g_config.getNumber(ConfigManager::ACCOUNT_LOCK_DURATION));
 }
 
 bool Game::isAccountLocked(uint32_t accountNumber)
 {
-	std::lock_guard<std::mutex> lock(gameLock);
-
-	auto it = accountLoginAttemptsMap.find(accountNumber);
-	if (it == accountLoginAttemptsMap.end()) {
-		return false;
-	}
-
-	bool locked = it->second.first >= g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_ACCOUNT_LOCK) && OTSYS_TIME() <= it->second.second;
-	
-	if (it->second.first >= g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_ACCOUNT_LOCK) && OTSYS_TIME() >= it->second.second) {
-		it->second.first = 0;
-		locked = false;
-	}
-
-	return locked;
+	return accountLoginAttempts.isLocked(accountNumber);
 }
 
 void Game::resetIpLoginAttempts(uint32_t ip)
 {
-	std::lock_guard<std::mutex> lock(gameLock);
-
-	auto it = ipLoginAttemptsMap.find(ip);
-	if (it == ipLoginAttemptsMap.end()) {
-		return;
-	}
-
-	if (OTSYS_TIME() - (g_config.getNumber(ConfigManager::IP_LOCK_DURATION)) >= it->second.second) {
-		ipLoginAttemptsMap.erase(it);
-	}
+	ipLoginAttempts.reset(ip, false);
 }
 
 void Game::resetAccountLoginAttempts(uint32_t accountNumber)
 {
-	std::lock_guard<std::mutex> lock(gameLock);
-
-	auto it = accountLoginAttemptsMap.find(accountNumber);
-	if (it == accountLoginAttemptsMap.end()) {
-		return;
-	}
-
-	accountLoginAttemptsMap.erase(it);
+	accountLoginAttempts.reset(accountNumber, true);
 }
 
 void Game::registerFailedIPLogin(uint32_t ip)
 {
-	std::lock_guard<std::mutex> lock(gameLock);
-
-	if (g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_IP_BAN) == 0) {
+	const uint32_t maxAttempts = g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_IP_BAN);
+	if (maxAttempts == 0) {
 		return;
 	}
 
-	auto it = ipLoginAttemptsMap.find(ip);
-	if (it == ipLoginAttemptsMap.end()) {
-		auto pair = std::make_pair<uint32_t, uint64_t>(1, OTSYS_TIME());
-		ipLoginAttemptsMap[ip] = pair;
-	}
-	else {
-		it->second.first++;
-		if (it->second.first >= g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_IP_BAN)) {
-			it->second.second = OTSYS_TIME() + g_config.getNumber(ConfigManager::IP_LOCK_DURATION);
-		}
-	}
+	ipLoginAttempts.registerAttempt(ip, maxAttempts, g_config.getNumber(ConfigManager::IP_LOCK_DURATION));
 }
 
 bool Game::isIPLocked(uint32_t ip)
 {
-	std::lock_guard<std::mutex> lock(gameLock);
-
-	auto it = ipLoginAttemptsMap.find(ip);
-	if (it == ipLoginAttemptsMap.end()) {
-		return false;
-	}
-
-	bool locked = it->second.first >= g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_IP_BAN) && OTSYS_TIME() <= it->second.second;
-	
-	if (it->second.first >= g_config.getNumber(ConfigManager::FAILED_LOGINATTEMPTS_IP_BAN) && OTSYS_TIME() >= it->second.second) {
-		it->second.first = 0;
-		locked = false;
-	}
-
-	return locked;
+	return ipLoginAttempts.isLocked(ip);
 }
 
 uint32_t Game::recordStatement(uint32_t guid, uint32_t mode, uint32_t channel, const std::string& text)
 {
-	static uint32_t statementId = 0;
-
-	Statement statement;
-	statement.characterID = guid;
-	statement.mode = mode;
-	statement.channel = channel;
-	statement.text = text;
-	statement.timeStamp = std::time(nullptr);
-
-	statements.push_back(statement);
-	return statementId - 1;
+	return statementLog.addStatement(guid, mode, channel, text);
 }
 
 void Game::recordListener(uint32_t statementId, uint32_t guid)
 {
-	Listener listener;
-	listener.StatementID = statementId;
-	listener.CharacterID = guid;
-
-	listeners.push_back(listener);
+	statementLog.addListener(statementId, guid);
 }
 
 bool Game::playerSaySpell(Player* player, SpeakClasses type, const std::string& text)
@@ -3799,31 +4255,47 @@ bool Game::playerSpeakTo(Player* player, SpeakClasses type, const std::string& r
 	return true;
 }
 
-void Game::processCommunication()
+void Game::autosavePlayers()
 {
-	auto timeLimit = std::time(nullptr) - 1800;
-	uint32_t statementId = 0;
+	g_scheduler.addEvent(createSchedulerTask(EVENT_AUTOSAVE_INTERVAL, std::bind(&Game::autosavePlayers, this), "Game::autosavePlayers"));
 
-	while (!statements.empty())
-    {
-        auto it = statements.front();
-        if (it.timeStamp >= timeLimit)
-            break;
+	const time_t now = std::time(nullptr);
+	const time_t from = lastAutosaveTime != 0 ? lastAutosaveTime + 1 : now;
+	lastAutosaveTime = now;
 
-		statementId = it.statementID;
-        statements.pop_front();
-    }
+	const int32_t interval = g_config.getNumber(ConfigManager::PLAYER_AUTOSAVE_INTERVAL);
+	if (interval <= 0 || gameState != GAME_STATE_NORMAL || now < from) {
+		return;
+	}
 
-	while (!listeners.empty())
-    {
-        auto it = listeners.front();
-        if (it.StatementID >= statementId)
-            break;
+	// a player's second is its guid modulo the interval, so the saves spread evenly over it; a late
+	// run also saves the players of the seconds it missed
+	const uint32_t seconds = static_cast<uint32_t>(std::min<time_t>(now - from + 1, interval));
+	const uint32_t firstSecond = static_cast<uint32_t>(from % interval);
+	for (const auto& it : players) {
+		Player* player = it.second;
+		if ((player->getGUID() % interval + interval - firstSecond) % interval < seconds && IOLoginData::savePlayer(player)) {
+			++saveStats.autosaves;
+		}
+	}
+}
 
-        listeners.pop_front();
-    }
+void Game::processCommunication()
+{
+	const uint32_t timeLimit = std::time(nullptr) - g_config.getNumber(ConfigManager::STATEMENT_RETENTION);
+	if (statementTrimQueued) {
+		// the queue was not empty once since the last interval, the log still has to keep to its retention
+		statementLog.removeExpired(timeLimit);
+	} else {
+		statementTrimQueued = true;
+		g_dispatcher.addIdleJob([this]() {
+			statementLog.removeExpired(std::time(nullptr) - g_config.getNumber(ConfigManager::STATEMENT_RETENTION));
+			statementTrimQueued = false;
+			return false;
+		});
+	}
 
-	g_scheduler.addEvent(createSchedulerTask(EVENT_COMMUNICATION_INTERVAL, std::bind(&Game::processCommunication, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_COMMUNICATION_INTERVAL, std::bind(&Game::processCommunication, this), "Game::processCommunication"));
 }
 
 //--
@@ -3839,8 +4311,9 @@ bool Game::internalCreatureTurn(Creature* creature, Direction dir)
 	//send to client
 	SpectatorVec spectators;
 	map.getSpectators(spectators, creature->getPosition(), true, true);
+	const TileStackpos stackpos(creature->getTile(), creature);
 	for (Creature* spectator : spectators) {
-		spectator->getPlayer()->sendCreatureTurn(creature);
+		spectator->getPlayer()->sendCreatureTurn(creature, stackpos);
 	}
 	return true;
 }
@@ -3869,7 +4342,14 @@ bool Game::internalCreatureSay(Creature* creature, SpeakClasses type, const std:
 		// is used if available and if it can be used, else a local vector is
 		// used (hopefully the compiler will optimize away the construction of
 		// the temporary when it's not used).
-		if (type != TALKTYPE_YELL && type != TALKTYPE_MONSTER_YELL) {
+		if (!g_events->hasCreatureOnHear()) {
+			// nobody else does anything with it, so only the creatures that hear are looked up
+			if (type != TALKTYPE_YELL && type != TALKTYPE_MONSTER_YELL) {
+				map.getHearers(spectators, *pos, false, Map::maxClientViewportX, Map::maxClientViewportY);
+			} else {
+				map.getHearers(spectators, *pos, true, 18, 14);
+			}
+		} else if (type != TALKTYPE_YELL && type != TALKTYPE_MONSTER_YELL) {
 			map.getSpectators(spectators, *pos, false, false,
 			              Map::maxClientViewportX, Map::maxClientViewportX,
 			              Map::maxClientViewportY, Map::maxClientViewportY);
@@ -3880,32 +4360,54 @@ bool Game::internalCreatureSay(Creature* creature, SpeakClasses type, const std:
 		spectators = (*spectatorsPtr);
 	}
 
-	//send to client
-	for (Creature* spectator : spectators) {
+	// serialized on the first player that hears it, the others get the same bytes
+	NetworkMessage sayMessage;
+	bool sayMessageReady = false;
+
+	auto canHear = [&](const Creature* spectator) {
 		if (type == TALKTYPE_YELL || type == TALKTYPE_MONSTER_YELL) {
 			if (pos->z >= 8 && spectator->getPosition().z != pos->z) {
-				continue;
+				return false;
 			}
 
 			if (pos->z <= 7 && spectator->getPosition().z > 7) {
-				continue;
+				return false;
 			}
 		}
+		return true;
+	};
 
-		// event method
-		spectator->onCreatureSay(creature, type, text);
-		if (creature != spectator) {
-			g_events->eventCreatureOnHear(spectator, creature, text, type);
+	//send to client, before any event can say something else, so the listeners are recorded in statement order
+	for (Creature* spectator : spectators) {
+		if (!canHear(spectator)) {
+			continue;
 		}
 
 		if (Player* tmpPlayer = spectator->getPlayer()) {
 			if (!ghostMode || tmpPlayer->canSeeCreature(creature)) {
-				tmpPlayer->sendCreatureSay(statementId, creature, type, text, pos);
+				if (!sayMessageReady) {
+					ProtocolGame::AddCreatureSay(sayMessage, statementId, creature, type, text, pos);
+					sayMessageReady = true;
+				}
+
+				tmpPlayer->sendNetworkMessage(sayMessage);
 				recordListener(statementId, tmpPlayer->getGUID());
 			}
 		}
 	}
 
+	//event method
+	for (Creature* spectator : spectators) {
+		if (!canHear(spectator)) {
+			continue;
+		}
+
+		spectator->onCreatureSay(creature, type, text);
+		if (creature != spectator) {
+			g_events->eventCreatureOnHear(spectator, creature, text, type);
+		}
+	}
+
 	return true;
 }
 
@@ -3918,8 +4420,14 @@ void Game::addCreatureCheck(Creature* creature)
 		return;
 	}
 
+	if (!creature->conditions.empty()) {
+		// placed again while still carrying conditions
+		addConditionCreature(creature);
+	}
+
 	creature->inCheckCreaturesVector = true;
-	checkCreatureLists[uniform_random(0, EVENT_CREATURECOUNT - 1)].push_back(creature);
+	// creature ids are sequential, so this spreads the creatures evenly over the buckets
+	checkCreatureLists[creature->getID() % EVENT_CREATURECOUNT].push_back(creature);
 	creature->incrementReferenceCounter();
 }
 
@@ -3930,40 +4438,116 @@ void Game::removeCreatureCheck(Creature* creature)
 	}
 }
 
+void Game::addConditionCreature(Creature* creature)
+{
+	if (creature->inConditionCreatures) {
+		return;
+	}
+
+	creature->inConditionCreatures = true;
+	conditionCreatures.push_back(creature);
+	creature->incrementReferenceCounter();
+}
+
 void Game::processConditions()
 {
-	for (auto& i : checkCreatureLists) {
-		for (auto& creature : i) {
+	// conditions can be added to other creatures, which grows the vector while we walk it
+	size_t i = 0;
+	while (i < conditionCreatures.size()) {
+		Creature* creature = conditionCreatures[i];
+		if (!creature->conditions.empty() && !creature->isRemoved()) {
 			if (creature->creatureCheck && creature->getHealth() > 0) {
 				creature->executeConditions(EVENT_CREATURE_THINK_INTERVAL);
 			}
+			++i;
+		} else {
+			creature->inConditionCreatures = false;
+			conditionCreatures[i] = conditionCreatures.back();
+			conditionCreatures.pop_back();
+			ReleaseCreature(creature);
 		}
 	}
 
-	g_scheduler.addEvent(createSchedulerTask(EVENT_CONDITIONS_INTERVAL, std::bind(&Game::processConditions, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_CONDITIONS_INTERVAL, std::bind(&Game::processConditions, this), "Game::processConditions"));
 }
 
 void Game::checkCreatures(size_t index)
 {
-	g_scheduler.addEvent(createSchedulerTask(EVENT_CHECK_CREATURE_INTERVAL, std::bind(&Game::checkCreatures, this, (index + 1) % EVENT_CREATURECOUNT)));
+	PROFILE_FUNCTION();
+	g_scheduler.addEvent(createSchedulerTask(EVENT_CHECK_CREATURE_INTERVAL, std::bind(&Game::checkCreatures, this, (index + 1) % EVENT_CREATURECOUNT), "Game::checkCreatures"));
+	const auto start = std::chrono::steady_clock::now();
+	const uint32_t idleThinkDivisor = g_loadShedder.getIdleThinkDivisor();
 
 	auto& checkCreatureList = checkCreatureLists[index];
-	auto it = checkCreatureList.begin(), end = checkCreatureList.end();
-	while (it != end) {
-		Creature* creature = *it;
+	size_t i = 0;
+	while (i < checkCreatureList.size()) {
+		Creature* creature = checkCreatureList[i];
 		if (creature->creatureCheck) {
 			if (creature->getHealth() > 0) {
-				creature->onThink(EVENT_CREATURE_THINK_INTERVAL);
+				Monster* monster = creature->getMonster();
+				const uint32_t interval = monster ? monster->getThinkInterval(EVENT_CREATURE_THINK_INTERVAL, idleThinkDivisor) : EVENT_CREATURE_THINK_INTERVAL;
+				if (interval != 0) {
+					creature->onThink(interval);
+				}
 			}
-			++it;
+			++i;
 		} else {
 			creature->inCheckCreaturesVector = false;
-			it = checkCreatureList.erase(it);
+			checkCreatureList[i] = checkCreatureList.back();
+			checkCreatureList.pop_back();
 			ReleaseCreature(creature);
 		}
-	}
+	}
+
+	executeBatchedMonsterThinks();
+	cleanup();
+
+	g_loadShedder.addCheckCreaturesTime(std::chrono::steady_clock::now() - start);
+}
+
+void Game::addBatchedMonsterThink(Monster* monster)
+{
+	batchedMonsterThinks[monster->mType].push_back(monster);
+}
+
+void Game::executeBatchedMonsterThinks()
+{
+	for (auto& it : batchedMonsterThinks) {
+		std::vector<Monster*>& monsters = it.second;
+
+		// the monsters are still referenced by the check lists, but may have died or left during the walk
+		std::erase_if(monsters, [](const Monster* monster) { return monster->isRemoved() || monster->getHealth() <= 0; });
+		if (monsters.empty()) {
+			continue;
+		}
+
+		// onThinkBatch(monsters, interval)
+		const MonsterType* mType = it.first;
+		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
+		if (!scriptInterface->reserveScriptEnv()) {
+			std::cout << "[Error - Game::executeBatchedMonsterThinks] Call stack overflow" << std::endl;
+			monsters.clear();
+			continue;
+		}
 
-	cleanup();
+		ScriptEnvironment* env = scriptInterface->getScriptEnv();
+		env->setScriptId(mType->info.thinkBatchEvent, scriptInterface);
+
+		lua_State* L = scriptInterface->getLuaState();
+		scriptInterface->pushFunction(mType->info.thinkBatchEvent);
+
+		int index = 0;
+		lua_createtable(L, monsters.size(), 0);
+		for (Monster* monster : monsters) {
+			LuaScriptInterface::pushUserdata<Monster>(L, monster);
+			LuaScriptInterface::setMetatable(L, -1, "Monster");
+			lua_rawseti(L, -2, ++index);
+		}
+		monsters.clear();
+
+		lua_pushnumber(L, EVENT_CREATURE_THINK_INTERVAL);
+		scriptInterface->callFunction(2);
+	}
 }
 
 void Game::changeSpeed(Creature* creature, int32_t varSpeedDelta)
@@ -4020,7 +4604,7 @@ void Game::changeLight(const Creature* creature)
 	}
 }
 
-BlockType_t Game::combatBlockHit(CombatDamage& damage, Creature* attacker, Creature* target, bool checkDefense, bool checkArmor, bool field, bool ignoreResistances /*= false */, bool meleeHit /*= false*/)
+BlockType_t Game::combatBlockHit(CombatDamage& damage, Creature* attacker, Creature* target, bool checkDefense, bool checkArmor, bool field, bool ignoreResistances /*= false */, bool meleeHit /*= false*/, const SpectatorVec* spectators /*= nullptr*/)
 {
 	if (damage.type == COMBAT_NONE) {
 		return BLOCK_NONE;
@@ -4034,11 +4618,11 @@ BlockType_t Game::combatBlockHit(CombatDamage& damage, Creature* attacker, Creat
 		return BLOCK_NONE;
 	}
 
-	static const auto sendBlockEffect = [this](BlockType_t blockType, CombatType_t combatType, const Position& targetPos) {
+	const auto sendBlockEffect = [this, spectators](BlockType_t blockType, CombatType_t combatType, const Position& targetPos) {
 		if (blockType == BLOCK_DEFENSE) {
-			addMagicEffect(targetPos, CONST_ME_POFF);
+			addMagicEffect(spectators, targetPos, CONST_ME_POFF);
 		} else if (blockType == BLOCK_ARMOR) {
-			addMagicEffect(targetPos, CONST_ME_BLOCKHIT);
+			addMagicEffect(spectators, targetPos, CONST_ME_BLOCKHIT);
 		} else if (blockType == BLOCK_IMMUNITY) {
 			uint8_t hitEffect = 0;
 			switch (combatType) {
@@ -4057,7 +4641,7 @@ BlockType_t Game::combatBlockHit(CombatDamage& damage, Creature* attacker, Creat
 					break;
 				}
 			}
-			addMagicEffect(targetPos, hitEffect);
+			addMagicEffect(spectators, targetPos, hitEffect);
 		}
 	};
 
@@ -4167,7 +4751,7 @@ void Game::combatGetTypeInfo(CombatType_t combatType, Creature* target, TextColo
 	}
 }
 
-bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage& damage)
+bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage& damage, const SpectatorVec* spectators /*= nullptr*/)
 {
 	if (g_config.getBoolean(ConfigManager::UNLIMITED_PLAYER_HP) && target->getPlayer()) {
 		return true;
@@ -4186,7 +4770,7 @@ bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage
 					creatureEvent->executeHealthChange(target, attacker, damage);
 				}
 				damage.origin = ORIGIN_NONE;
-				return combatChangeHealth(attacker, target, damage);
+				return combatChangeHealth(attacker, target, damage, spectators);
 			}
 		}
 
@@ -4194,7 +4778,7 @@ bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage
 	} else {
 		if (!target->isAttackable()) {
 			if (!target->isInGhostMode() && !target->getNpc()) {
-				addMagicEffect(targetPos, CONST_ME_POFF);
+				addMagicEffect(spectators, targetPos, CONST_ME_POFF);
 			}
 			return true;
 		}
@@ -4232,8 +4816,8 @@ bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage
 
 				targetPlayer->drainMana(attacker, healthChange);
 
-				addMagicEffect(targetPos, CONST_ME_LOSEENERGY);
-				addAnimatedText(targetPos, TEXTCOLOR_BLUE, std::to_string(damage.value));
+				addMagicEffect(spectators, targetPos, CONST_ME_LOSEENERGY);
+				addAnimatedText(spectators, targetPos, TEXTCOLOR_BLUE, std::to_string(damage.value));
 
 				TextMessage message;
 				message.type = MESSAGE_EVENT_DEFAULT;
@@ -4265,7 +4849,7 @@ bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage
 					creatureEvent->executeHealthChange(target, attacker, damage);
 				}
 				damage.origin = ORIGIN_NONE;
-				return combatChangeHealth(attacker, target, damage);
+				return combatChangeHealth(attacker, target, damage, spectators);
 			}
 		}
 
@@ -4285,8 +4869,8 @@ bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage
 		if (damage.value) {
 			combatGetTypeInfo(damage.type, target, textColor, hitEffect);
 			if (hitEffect != CONST_ME_NONE) {
-				addMagicEffect(targetPos, hitEffect);
-				addAnimatedText(targetPos, textColor, std::to_string(damage.value));
+				addMagicEffect(spectators, targetPos, hitEffect);
+				addAnimatedText(spectators, targetPos, textColor, std::to_string(damage.value));
 			}
 		}
 
@@ -4314,13 +4898,13 @@ bool Game::combatChangeHealth(Creature* attacker, Creature* target, CombatDamage
 		}
 
 		target->drainHealth(attacker, realDamage);
-		addCreatureHealth(target);
+		addCreatureHealth(spectators, target);
 	}
 
 	return true;
 }
 
-bool Game::combatChangeMana(Creature* attacker, Creature* target, CombatDamage& damage)
+bool Game::combatChangeMana(Creature* attacker, Creature* target, CombatDamage& damage, const SpectatorVec* spectators /*= nullptr*/)
 {
 	Player* targetPlayer = target->getPlayer();
 	if (!targetPlayer) {
@@ -4336,7 +4920,7 @@ bool Game::combatChangeMana(Creature* attacker, Creature* target, CombatDamage&
 					creatureEvent->executeManaChange(target, attacker, damage);
 				}
 				damage.origin = ORIGIN_NONE;
-				return combatChangeMana(attacker, target, damage);
+				return combatChangeMana(attacker, target, damage, spectators);
 			}
 		}
 
@@ -4345,7 +4929,7 @@ bool Game::combatChangeMana(Creature* attacker, Creature* target, CombatDamage&
 		const Position& targetPos = target->getPosition();
 		if (!target->isAttackable()) {
 			if (!target->isInGhostMode()) {
-				addMagicEffect(targetPos, CONST_ME_POFF);
+				addMagicEffect(spectators, targetPos, CONST_ME_POFF);
 			}
 			return false;
 		}
@@ -4360,7 +4944,7 @@ bool Game::combatChangeMana(Creature* attacker, Creature* target, CombatDamage&
 		int32_t manaLoss = std::min<int32_t>(targetPlayer->getMana(), -manaChange);
 		BlockType_t blockType = target->blockHit(attacker, COMBAT_MANADRAIN, manaLoss);
 		if (blockType != BLOCK_NONE) {
-			addMagicEffect(targetPos, CONST_ME_POFF);
+			addMagicEffect(spectators, targetPos, CONST_ME_POFF);
 			return false;
 		}
 
@@ -4375,12 +4959,12 @@ bool Game::combatChangeMana(Creature* attacker, Creature* target, CombatDamage&
 					creatureEvent->executeManaChange(target, attacker, damage);
 				}
 				damage.origin = ORIGIN_NONE;
-				return combatChangeMana(attacker, target, damage);
+				return combatChangeMana(attacker, target, damage, spectators);
 			}
 		}
 
 		targetPlayer->drainMana(attacker, manaLoss);
-		addAnimatedText(targetPos, TEXTCOLOR_BLUE, std::to_string(manaLoss));
+		addAnimatedText(spectators, targetPos, TEXTCOLOR_BLUE, std::to_string(manaLoss));
 
 		TextMessage message;
 		message.type = MESSAGE_EVENT_DEFAULT;
@@ -4405,11 +4989,7 @@ void Game::addCreatureHealth(const Creature* target)
 
 void Game::addCreatureHealth(const SpectatorVec& spectators, const Creature* target)
 {
-	for (Creature* spectator : spectators) {
-		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendCreatureHealth(target);
-		}
-	}
+	ProtocolGame::broadcastCreatureHealth(spectators, target);
 }
 
 void Game::addMagicEffect(const Position& pos, uint8_t effect)
@@ -4421,11 +5001,7 @@ void Game::addMagicEffect(const Position& pos, uint8_t effect)
 
 void Game::addMagicEffect(const SpectatorVec& spectators, const Position& pos, uint8_t effect)
 {
-	for (Creature* spectator : spectators) {
-		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendMagicEffect(pos, effect);
-		}
-	}
+	ProtocolGame::broadcastMagicEffect(spectators, pos, effect);
 }
 
 void Game::addDistanceEffect(const Position& fromPos, const Position& toPos, uint8_t effect)
@@ -4440,11 +5016,7 @@ void Game::addDistanceEffect(const Position& fromPos, const Position& toPos, uin
 
 void Game::addDistanceEffect(const SpectatorVec& spectators, const Position& fromPos, const Position& toPos, uint8_t effect)
 {
-	for (Creature* spectator : spectators) {
-		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendDistanceShoot(fromPos, toPos, effect);
-		}
-	}
+	ProtocolGame::broadcastDistanceShoot(spectators, fromPos, toPos, effect);
 }
 
 void Game::addAnimatedText(const Position& pos, TextColor_t textColor, const std::string& text)
@@ -4457,15 +5029,41 @@ void Game::addAnimatedText(const Position& pos, TextColor_t textColor, const std
 
 void Game::addAnimatedText(const SpectatorVec& spectators, const Position& pos, TextColor_t textColor, const std::string& text)
 {
-	for (Creature* spectator : spectators) {
-		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendAnimatedText(pos, textColor, text);
-		}
+	ProtocolGame::broadcastAnimatedText(spectators, pos, textColor, text);
+}
+
+void Game::addCreatureHealth(const SpectatorVec* spectators, const Creature* target)
+{
+	if (spectators) {
+		addCreatureHealth(*spectators, target);
+	} else {
+		addCreatureHealth(target);
+	}
+}
+
+void Game::addMagicEffect(const SpectatorVec* spectators, const Position& pos, uint8_t effect)
+{
+	if (spectators) {
+		addMagicEffect(*spectators, pos, effect);
+	} else {
+		addMagicEffect(pos, effect);
+	}
+}
+
+void Game::addAnimatedText(const SpectatorVec* spectators, const Position& pos, TextColor_t textColor, const std::string& text)
+{
+	if (spectators) {
+		addAnimatedText(*spectators, pos, textColor, text);
+	} else {
+		addAnimatedText(pos, textColor, text);
 	}
 }
 
 void Game::setAccountStorageValue(const uint32_t accountId, const uint32_t key, const int32_t value)
 {
+	loadAccountStorageValues(accountId);
+	dirtyAccountStorage.emplace(accountId, key);
+
 	if (value == -1) {
 		accountStorageMap[accountId].erase(key);
 		return;
@@ -4474,8 +5072,10 @@ void Game::setAccountStorageValue(const uint32_t accountId, const uint32_t key,
 	accountStorageMap[accountId][key] = value;
 }
 
-int32_t Game::getAccountStorageValue(const uint32_t accountId, const uint32_t key) const
+int32_t Game::getAccountStorageValue(const uint32_t accountId, const uint32_t key)
 {
+	loadAccountStorageValues(accountId);
+
 	const auto& accountMapIt = accountStorageMap.find(accountId);
 	if (accountMapIt != accountStorageMap.end()) {
 		const auto& storageMapIt = accountMapIt->second.find(key);
@@ -4486,20 +5086,45 @@ int32_t Game::getAccountStorageValue(const uint32_t accountId, const uint32_t ke
 	return -1;
 }
 
-void Game::loadAccountStorageValues()
+void Game::loadAccountStorageValues(uint32_t accountId)
 {
+	auto result = accountStorageMap.try_emplace(accountId);
+	if (!result.second) {
+		return;
+	}
+
 	Database& db = Database::getInstance();
 
-	DBResult_ptr result;
-	if ((result = db.storeQuery("SELECT `account_id`, `key`, `value` FROM `account_storage`"))) {
+	DBResult_ptr queryResult;
+	if ((queryResult = db.storeQuery(fmt::format("SELECT `key`, `value` FROM `account_storage` WHERE `account_id` = {:d}", accountId)))) {
+		const size_t keyColumn = queryResult->getColumnIndex("key");
+		const size_t valueColumn = queryResult->getColumnIndex("value");
+		auto& storageMap = result.first->second;
 		do {
-			g_game.setAccountStorageValue(result->getNumber<uint32_t>("account_id"), result->getNumber<uint32_t>("key"), result->getNumber<int32_t>("value"));
-		} while (result->next());
+			storageMap[queryResult->getNumber<uint32_t>(keyColumn)] = queryResult->getNumber<int32_t>(valueColumn);
+		} while (queryResult->next());
+	}
+}
+
+void Game::loadGuilds()
+{
+	for (Guild* guild : IOGuild::loadGuilds()) {
+		// on a reload the guilds already known are updated in place, their online members point at them
+		if (Guild* knownGuild = getGuild(guild->getId())) {
+			knownGuild->refresh(*guild);
+			delete guild;
+		} else {
+			addGuild(guild);
+		}
 	}
 }
 
-bool Game::saveAccountStorageValues() const
+bool Game::saveAccountStorageValues()
 {
+	if (dirtyAccountStorage.empty()) {
+		return true;
+	}
+
 	DBTransaction transaction;
 	Database& db = Database::getInstance();
 
@@ -4507,28 +5132,43 @@ bool Game::saveAccountStorageValues() const
 		return false;
 	}
 
-	if (!db.executeQuery("DELETE FROM `account_storage`")) {
-		return false;
-	}
-
-	for (const auto& accountIt : g_game.accountStorageMap) {
-		if (accountIt.second.empty()) {
-			continue;
-		}
+	// the values that are set are replaced, the ones set to -1 deleted an account at a time
+	DBInsert accountStorageQuery("REPLACE INTO `account_storage` (`account_id`, `key`, `value`) VALUES");
+	for (auto it = dirtyAccountStorage.begin(); it != dirtyAccountStorage.end();) {
+		const uint32_t accountId = it->first;
+		const auto& storageMap = accountStorageMap[accountId];
 
-		DBInsert accountStorageQuery("INSERT INTO `account_storage` (`account_id`, `key`, `value`) VALUES");
-		for (const auto& storageIt : accountIt.second) {
-			if (!accountStorageQuery.addRow(fmt::format("{:d}, {:d}, {:d}", accountIt.first, storageIt.first, storageIt.second))) {
-				return false;
+		std::string deletedKeys;
+		for (; it != dirtyAccountStorage.end() && it->first == accountId; ++it) {
+			const uint32_t key = it->second;
+			auto storageIt = storageMap.find(key);
+			if (storageIt != storageMap.end()) {
+				if (!accountStorageQuery.addRow(fmt::format("{:d}, {:d}, {:d}", accountId, key, storageIt->second))) {
+					return false;
+				}
+			} else {
+				if (!deletedKeys.empty()) {
+					deletedKeys.push_back(',');
+				}
+				deletedKeys += std::to_string(key);
 			}
 		}
 
-		if (!accountStorageQuery.execute()) {
+		if (!deletedKeys.empty() && !db.executeQuery(fmt::format("DELETE FROM `account_storage` WHERE `account_id` = {:d} AND `key` IN ({:s})", accountId, deletedKeys))) {
 			return false;
 		}
 	}
 
-	return transaction.commit();
+	if (!accountStorageQuery.execute()) {
+		return false;
+	}
+
+	if (!transaction.commit()) {
+		return false;
+	}
+
+	dirtyAccountStorage.clear();
+	return true;
 }
 
 void Game::startDecay(Item* item)
@@ -4543,14 +5183,35 @@ void Game::startDecay(Item* item)
 	}
 
 	if (item->getDuration() > 0) {
-		item->incrementReferenceCounter();
-		item->setDecaying(DECAYING_TRUE);
-		toDecayItems.push_front(item);
+		scheduleDecay(item);
 	} else {
 		internalDecayItem(item);
 	}
 }
 
+void Game::scheduleDecay(Item* item)
+{
+	if (!decayWheel.isScheduled(item)) {
+		// the wheel keeps the item alive until it expires or is stopped
+		item->incrementReferenceCounter();
+	}
+
+	decayWheel.schedule(item, item->getDuration(), OTSYS_TIME());
+	item->setDecaying(DECAYING_TRUE);
+}
+
+void Game::stopDecay(Item* item)
+{
+	if (decayWheel.unschedule(item, OTSYS_TIME())) {
+		ReleaseItem(item);
+	}
+}
+
+bool Game::getDecayRemaining(const Item* item, uint32_t& remaining) const
+{
+	return decayWheel.getRemaining(item, OTSYS_TIME(), remaining);
+}
+
 void Game::internalDecayItem(Item* item)
 {
 	const ItemType& it = Item::items[item->getID()];
@@ -4560,7 +5221,7 @@ void Game::internalDecayItem(Item* item)
 	} else {
 		ReturnValue ret = internalRemoveItem(item);
 		if (ret != RETURNVALUE_NOERROR) {
-			std::cout << "[Debug - Game::internalDecayItem] internalDecayItem failed, error code: " << static_cast<uint32_t>(ret) << ", item id: " << item->getID() << std::endl;
+			TVP_LOG(LOGLEVEL_DEBUG, "[Debug - Game::internalDecayItem] internalDecayItem failed, error code: {:d}, item id: {:d}", static_cast<uint32_t>(ret), item->getID());
 		}
 	}
 }
@@ -4593,117 +5254,150 @@ void Game::processRemovedCreatures()
 	}
 	removedCreatures.clear();
 
-	g_scheduler.addEvent(createSchedulerTask(1000, std::bind(&Game::processRemovedCreatures, this)));
+	g_scheduler.addEvent(createSchedulerTask(1000, std::bind(&Game::processRemovedCreatures, this), "Game::processRemovedCreatures"));
 }
 
-void Game::proceduralRefreshMap()
+void Game::clearTileSaveJournal()
 {
-	if (!g_config.getBoolean(ConfigManager::ENABLE_MAP_REFRESH) || getGameState() >= GAME_STATE_SHUTDOWN) {
+	for (Tile* tile : tileSaveJournal) {
+		tile->resetTrackFlag(TILETRACK_SAVE_DIRTY);
+	}
+	tileSaveJournal.clear();
+}
+
+void Game::addTileToRefresh(Tile* tile)
+{
+	if (tile->hasTrackFlag(TILETRACK_REFRESH)) {
 		return;
 	}
 
-	if (tilesToRefresh.size() > 0) {
-		bool increaseRefreshSet = true;
-		int32_t tilesPerCycle = g_config.getNumber(ConfigManager::MAP_REFRESH_TILES_PER_CYCLE);
-		for (int32_t i = nextMapRefreshSet; i <= nextMapRefreshSet + tilesPerCycle; i++) {
-			if (i == tilesToRefresh.size() - 1) {
-				nextMapRefreshSet = 0;
-				increaseRefreshSet = false;
-				break;
-			}
+	tile->setTrackFlag(TILETRACK_REFRESH);
+	tilesToRefresh.push_back(tile);
 
-			// skip procedural map refresh upon ending game
-			if (getGameState() >= GAME_STATE_SHUTDOWN) {
-				return;
-			}
+	const Position& pos = tile->getPosition();
+	const uint32_t key = (static_cast<uint32_t>(pos.x >> REFRESH_SECTOR_BITS) << 16) | (static_cast<uint32_t>(pos.y >> REFRESH_SECTOR_BITS) << 4) | pos.z;
+	auto it = refreshSectorIndex.find(key);
+	if (it == refreshSectorIndex.end()) {
+		it = refreshSectorIndex.emplace(key, refreshSectors.size()).first;
 
-			Tile* tile = tilesToRefresh[i];
-			if (!tile || tile->getCreatureCount() > 0) {
-				continue;
-			}
+		RefreshSector& sector = refreshSectors.emplace_back();
+		sector.base = Position((pos.x >> REFRESH_SECTOR_BITS) << REFRESH_SECTOR_BITS, (pos.y >> REFRESH_SECTOR_BITS) << REFRESH_SECTOR_BITS, pos.z);
+		sector.dueTime = std::numeric_limits<int64_t>::max();
+	}
 
-			if (OTSYS_TIME() < tile->getNextRefreshTime()) {
-				// this tile cannot refresh at this moment
-				continue;
-			}
+	RefreshSector& sector = refreshSectors[it->second];
+	sector.tiles.push_back(tile);
 
-			SpectatorVec spectators;
-			map.getSpectators(spectators, tile->getPosition(), true, true, 16, 16, 16, 16);
+	// entries left behind by an earlier due time are skipped when they come up
+	if (tile->getNextRefreshTime() < sector.dueTime) {
+		sector.dueTime = tile->getNextRefreshTime();
+		refreshQueue.push({sector.dueTime, it->second});
+	}
+}
 
-			if (!spectators.empty()) {
-				// cannot refresh this area, there are players/creatures present
-				continue;
-			}
+void Game::refreshSector(RefreshSector& sector, int64_t now)
+{
+	constexpr int32_t sectorSize = 1 << REFRESH_SECTOR_BITS;
+	constexpr int32_t halfSector = sectorSize / 2;
 
-			tile->refresh();
-			tile->updateRefreshTime();
+	// the same 16 tiles every single tile checks, around the whole sector
+	SpectatorVec spectators;
+	map.getSpectators(spectators, Position(sector.base.x + halfSector, sector.base.y + halfSector, sector.base.z), true, true,
+	                  16 + halfSector, 16 + halfSector, 16 + halfSector, 16 + halfSector);
+	const bool playersAround = !spectators.empty();
+
+	const int64_t retryTime = now + static_cast<int64_t>(g_config.getNumber(ConfigManager::MAP_REFRESH_INTERVAL)) * g_loadShedder.getRefreshIntervalFactor();
+	int64_t dueTime = std::numeric_limits<int64_t>::max();
+	for (Tile* tile : sector.tiles) {
+		if (now < tile->getNextRefreshTime()) {
+			// this tile cannot refresh at this moment
+			dueTime = std::min(dueTime, tile->getNextRefreshTime());
+			continue;
 		}
 
-		if (increaseRefreshSet) {
-			nextMapRefreshSet += g_config.getNumber(ConfigManager::MAP_REFRESH_TILES_PER_CYCLE);
+		if (tile->getCreatureCount() > 0) {
+			dueTime = std::min(dueTime, retryTime);
+			continue;
+		}
+
+		if (playersAround) {
+			SpectatorVec tileSpectators;
+			map.getSpectators(tileSpectators, tile->getPosition(), true, true, 16, 16, 16, 16);
+			if (!tileSpectators.empty()) {
+				// cannot refresh this area, there are players present
+				dueTime = std::min(dueTime, retryTime);
+				continue;
+			}
 		}
-	}
 
-	eventRefreshId = g_scheduler.addEvent(createSchedulerTask(g_config.getNumber(ConfigManager::MAP_REFRESH_INTERVAL), std::bind(&Game::proceduralRefreshMap, this)));
+		tile->refresh();
+		tile->updateRefreshTime();
+		dueTime = std::min(dueTime, tile->getNextRefreshTime());
+	}
+	sector.dueTime = dueTime;
 }
 
-void Game::checkDecay()
+void Game::proceduralRefreshMap()
 {
-	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this)));
+	if (!g_config.getBoolean(ConfigManager::ENABLE_MAP_REFRESH) || getGameState() >= GAME_STATE_SHUTDOWN) {
+		return;
+	}
 
-	size_t bucket = (lastBucket + 1) % EVENT_DECAY_BUCKETS;
+	// only the sectors with a due tile are visited, up to the configured number of tiles per cycle
+	const int64_t now = OTSYS_TIME();
+	int32_t tilesLeft = g_config.getNumber(ConfigManager::MAP_REFRESH_TILES_PER_CYCLE);
+	while (!refreshQueue.empty() && tilesLeft > 0) {
+		RefreshSectorDue due = refreshQueue.top();
+		if (due.dueTime > now) {
+			break;
+		}
+		refreshQueue.pop();
 
-	auto it = decayItems[bucket].begin(), end = decayItems[bucket].end();
-	while (it != end) {
-		Item* item = *it;
-		if (!item->canDecay()) {
-			item->setDecaying(DECAYING_FALSE);
-			ReleaseItem(item);
-			it = decayItems[bucket].erase(it);
+		RefreshSector& sector = refreshSectors[due.sector];
+		if (due.dueTime != sector.dueTime) {
 			continue;
 		}
 
-		int32_t duration = item->getDuration();
-		int32_t decreaseTime = std::min<int32_t>(EVENT_DECAYINTERVAL * EVENT_DECAY_BUCKETS, duration);
+		refreshSector(sector, now);
+		tilesLeft -= sector.tiles.size();
 
-		duration -= decreaseTime;
-		item->decreaseDuration(decreaseTime);
+		if (sector.dueTime != std::numeric_limits<int64_t>::max()) {
+			refreshQueue.push({sector.dueTime, due.sector});
+		}
+	}
 
-		if (duration <= 0) {
-			it = decayItems[bucket].erase(it);
-			internalDecayItem(item);
-			ReleaseItem(item);
-		} else if (duration < EVENT_DECAYINTERVAL * EVENT_DECAY_BUCKETS) {
-			it = decayItems[bucket].erase(it);
-			size_t newBucket = (bucket + ((duration + EVENT_DECAYINTERVAL / 2) / 1000)) % EVENT_DECAY_BUCKETS;
-			if (newBucket == bucket) {
-				internalDecayItem(item);
-				ReleaseItem(item);
-			} else {
-				decayItems[newBucket].push_back(item);
-			}
+	const uint32_t interval = g_config.getNumber(ConfigManager::MAP_REFRESH_INTERVAL) * g_loadShedder.getRefreshIntervalFactor();
+	eventRefreshId = g_scheduler.addEvent(createSchedulerTask(interval, std::bind(&Game::proceduralRefreshMap, this), "Game::proceduralRefreshMap"));
+}
+
+void Game::checkDecay()
+{
+	PROFILE_FUNCTION();
+	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this), "Game::checkDecay"));
+
+	decayWheel.advance(OTSYS_TIME(), expiredDecayItems);
+	for (Item* item : expiredDecayItems) {
+		if (!item->canDecay()) {
+			item->setDecaying(DECAYING_FALSE);
 		} else {
-			++it;
+			internalDecayItem(item);
 		}
+		ReleaseItem(item);
 	}
+	expiredDecayItems.clear();
 
-	lastBucket = bucket;
 	cleanup();
 }
 
 void Game::checkLight()
 {
-	g_scheduler.addEvent(createSchedulerTask(EVENT_LIGHTINTERVAL, std::bind(&Game::checkLight, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_LIGHTINTERVAL, std::bind(&Game::checkLight, this), "Game::checkLight"));
 	oldLightLevel = lightLevel;
 	oldLightColor = lightColor;
 	updateWorldLightLevel();
 
 	if (oldLightLevel != lightLevel || oldLightColor != lightColor) {
-		LightInfo lightInfo = getWorldLightInfo();
-
-		for (const auto& it : players) {
-			it.second->sendWorldLight(lightInfo);
-		}
+		ProtocolGame::broadcastWorldLight(players, getWorldLightInfo());
 	}
 }
 
@@ -4753,7 +5447,7 @@ void Game::updateWorldLightLevel()
 
 void Game::updateWorldTime()
 {
-	g_scheduler.addEvent(createSchedulerTask(EVENT_WORLDTIMEINTERVAL, std::bind(&Game::updateWorldTime, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_WORLDTIMEINTERVAL, std::bind(&Game::updateWorldTime, this), "Game::updateWorldTime"));
 	time_t osTime = time(nullptr);
 	tm* timeInfo = localtime(&osTime);
 	worldTime = (timeInfo->tm_sec + (timeInfo->tm_min * 60)) / 2.5f;
@@ -4763,11 +5457,21 @@ void Game::shutdown()
 {
 	std::cout << "Shutting down..." << std::flush;
 
+	g_packetRecorder.flush();
+	g_metrics.shutdown();
+	g_worldSnapshot.shutdown();
+
 	g_scheduler.shutdown();
 	g_databaseTasks.shutdown();
+	g_fileTasks.shutdown();
+	g_jobPool.shutdown();
 	g_dispatcher.shutdown();
-	map.spawns.clear();
-	raids.clear();
+
+	// the process exits once the threads are done, rebuilding the raid scripts is wasted then
+	if (!g_config.getBoolean(ConfigManager::FAST_SHUTDOWN)) {
+		map.spawns.clear();
+		raids.clear();
+	}
 
 	cleanup();
 
@@ -4797,16 +5501,6 @@ void Game::cleanup()
 		item->decrementReferenceCounter();
 	}
 	ToReleaseItems.clear();
-
-	for (Item* item : toDecayItems) {
-		const uint32_t dur = item->getDuration();
-		if (dur >= EVENT_DECAYINTERVAL * EVENT_DECAY_BUCKETS) {
-			decayItems[lastBucket].push_back(item);
-		} else {
-			decayItems[(lastBucket + 1 + dur / 1000) % EVENT_DECAY_BUCKETS].push_back(item);
-		}
-	}
-	toDecayItems.clear();
 }
 
 void Game::ReleaseCreature(Creature* creature)
@@ -4822,23 +5516,53 @@ void Game::ReleaseItem(Item* item)
 void Game::broadcastMessage(const std::string& text, MessageClasses type) const
 {
 	std::cout << "> Broadcasted message: \"" << text << "\"." << std::endl;
-	for (const auto& it : players) {
-		it.second->sendTextMessage(type, text);
-	}
+	ProtocolGame::broadcastTextMessage(players, TextMessage(type, text));
 }
 
-void Game::executeCreature(uint32_t creatureId)
+void Game::scheduleCreatureExecution(const Creature* creature)
 {
-	Creature* creature = getCreatureByID(creatureId);
-	if (!creature || creature->isRemoved() || creature->toDoEntries.empty()) {
-		return;
+	const int64_t wakeUpTime = creature->earliestWakeUpTime;
+
+	// further than the wheel reaches goes in its last slot and is queued again from there
+	size_t ticks = 0;
+	if (wakeUpTime > nextExecuteTime) {
+		ticks = std::min<size_t>((wakeUpTime - nextExecuteTime + EVENT_EXECUTE_INTERVAL - 1) / EVENT_EXECUTE_INTERVAL, EXECUTE_WHEEL_SIZE - 1);
 	}
+	executeWheel[(executeSlot + ticks) % EXECUTE_WHEEL_SIZE].push_back({creature->getID(), wakeUpTime});
+}
+
+void Game::executeCreatures()
+{
+	PROFILE_FUNCTION();
+	g_scheduler.addEvent(createSchedulerTask(EVENT_EXECUTE_INTERVAL, std::bind(&Game::executeCreatures, this), "Game::executeCreatures"));
+
+	const int64_t now = OTSYS_TIME();
+	dueExecutions.swap(executeWheel[executeSlot]);
+	executeSlot = (executeSlot + 1) % EXECUTE_WHEEL_SIZE;
+	nextExecuteTime = now + EVENT_EXECUTE_INTERVAL;
+
+	for (const CreatureExecution& execution : dueExecutions) {
+		Creature* creature = getCreatureByID(execution.creatureId);
+		if (!creature || creature->isRemoved() || creature->toDoEntries.empty() || creature->earliestWakeUpTime != execution.wakeUpTime) {
+			continue;
+		}
+
+		if (execution.wakeUpTime > now) {
+			scheduleCreatureExecution(creature);
+			continue;
+		}
 
-	creature->executeToDoEntries();
+		creature->executeToDoEntries();
+	}
+	dueExecutions.clear();
 }
 
 void Game::updateCreatureSkull(const Creature* creature)
 {
+	if (const Player* player = creature->getPlayer()) {
+		schedulePlayerSkullCheck(player);
+	}
+
 	if (getWorldType() != WORLD_TYPE_PVP) {
 		return;
 	}
@@ -5242,12 +5966,8 @@ void Game::playerDebugAssert(uint32_t playerId, const std::string& assertLine, c
 	}
 
 	// TODO: move debug assertions to database
-	FILE* file = fopen("gamedata/client_assertions.txt", "a");
-	if (file) {
-		fprintf(file, "----- %s - %s (%s) -----\n", formatDate(time(nullptr)).c_str(), player->getName().c_str(), convertIPToString(player->getIP()).c_str());
-		fprintf(file, "%s\n%s\n%s\n%s\n", assertLine.c_str(), date.c_str(), description.c_str(), comment.c_str());
-		fclose(file);
-	}
+	g_fileTasks.writeFile("gamedata/client_assertions.txt", fmt::format("----- {:s} - {:s} ({:s}) -----\n{:s}\n{:s}\n{:s}\n{:s}\n",
+		formatDate(time(nullptr)), player->getName(), convertIPToString(player->getIP()), assertLine, date, description, comment), true);
 }
 
 void Game::parsePlayerExtendedOpcode(uint32_t playerId, uint8_t opcode, const std::string& buffer)
@@ -5293,8 +6013,9 @@ bool Game::searchFreeField(Creature* creature, uint16_t& x, uint16_t& y, uint8_t
 	int32_t dy = 0;
 
 	while (true) {
-		Tile* tile = map.getTile(x + dx, y + dy, z);
-		if (!tile || !tile->getGround() || tile->getCreatureCount() > 0 || tile->hasFlag(TILESTATE_BLOCKSOLID) || tile->hasFlag(TILESTATE_BLOCKPATH) ||
+		// missing, groundless and blocked tiles are skipped by the floor masks alone
+		Tile* tile = map.isTileFree(x + dx, y + dy, z) ? map.getTile(x + dx, y + dy, z) : nullptr;
+		if (!tile || tile->getCreatureCount() > 0 ||
 			creature && tile->queryAdd(INDEX_WHEREEVER, *creature, 1, FLAG_PATHFINDING) != RETURNVALUE_NOERROR || tile->getHouse() != nullptr && !allowHouses) {
 			if (Direction == 2) {
 				--dx;
@@ -5363,20 +6084,7 @@ bool Game::searchFreeField(Creature* creature, uint16_t& x, uint16_t& y, uint8_t
 			return false;
 		}
 
-		Tile* tile = map.getTile(x + dx, y + dy, z);
-		if (!tile) {
-			continue;
-		}
-
-		if (tile->hasFlag(TILESTATE_BLOCKSOLID)) {
-			continue;
-		}
-
-		if (tile->hasFlag(TILESTATE_BLOCKPATH)) {
-			continue;
-		}
-
-		if (!tile->getGround()) {
+		if (!map.isTileFree(x + dx, y + dy, z)) {
 			continue;
 		}
 
@@ -5559,36 +6267,35 @@ bool Game::searchSpawnField(uint16_t& x, uint16_t& y, uint8_t& z, int32_t distan
 
 bool Game::searchSummonField(uint16_t& x, uint16_t& y, uint8_t& z, int32_t distance)
 {
-	int32_t NewTieBreaker = 0;
-	int32_t TieBreaker = -1;
-	int32_t BestX = 0;
-	int32_t BestY = 0;
-
-	for (int32_t dx = -distance; dx <= distance; ++dx) {
-		for (int32_t dy = -distance; dy <= distance; ++dy) {
-			NewTieBreaker = uniform_random(0, 99);
-			if (NewTieBreaker > TieBreaker) {
-				Tile* tile = map.getTile(x + dx, y + dy, z);
-				if (tile && tile->getCreatureCount() == 0 && tile->getGround() && !tile->hasFlag(TILESTATE_BLOCKSOLID) && !tile->hasFlag(TILESTATE_BLOCKPATH)) {
-					if (!tile->getHouse() && !tile->hasFlag(TILESTATE_PROTECTIONZONE)) {
-						if (map.canThrowObjectTo(Position(x, y, z), Position(x + dx, y + dy, z))) {
-							TieBreaker = NewTieBreaker;
-							BestX = x + dx;
-							BestY = y + dy;
-						}
-					}
-				}
-			}
-		}
+	const std::vector<Position> fields = searchSummonFields(Position(x, y, z), distance, 1);
+	if (fields.empty()) {
+		return false;
 	}
 
-	if (TieBreaker != -1) {
-		x = BestX;
-		y = BestY;
-		return true;
-	}
+	x = fields.front().x;
+	y = fields.front().y;
+	return true;
+}
 
-	return false;
+std::vector<Position> Game::searchSummonFields(const Position& centerPos, int32_t distance, size_t count)
+{
+	const Position fromPos(std::max<int32_t>(centerPos.x - distance, 0), std::max<int32_t>(centerPos.y - distance, 0), centerPos.z);
+	const Position toPos(std::min<int32_t>(centerPos.x + distance, std::numeric_limits<uint16_t>::max()),
+		std::min<int32_t>(centerPos.y + distance, std::numeric_limits<uint16_t>::max()), centerPos.z);
+
+	std::vector<Position> fields;
+	map.getPlaceableFields(fields, fromPos, toPos);
+	std::ranges::shuffle(fields, getRandomGenerator());
+
+	// only as many lines of sight as it takes to find count fields
+	auto last = fields.begin();
+	for (auto it = fields.begin(); it != fields.end() && static_cast<size_t>(last - fields.begin()) < count; ++it) {
+		if (map.canThrowObjectTo(centerPos, *it)) {
+			*last++ = *it;
+		}
+	}
+	fields.erase(last, fields.end());
+	return fields;
 }
 
 void Game::playerAnswerModalWindow(uint32_t playerId, uint32_t modalWindowId, uint8_t button, uint8_t choice)
@@ -5611,26 +6318,118 @@ void Game::playerAnswerModalWindow(uint32_t playerId, uint32_t modalWindowId, ui
 
 void Game::addPlayer(Player* player)
 {
-	const std::string& lowercase_name = asLowerCaseString(player->getName());
-	mappedPlayerNames[lowercase_name] = player;
+	mappedPlayerNames[player->getName()] = player;
 	mappedPlayerGuids[player->getGUID()] = player;
 	preloadedPlayerGuids[player->getGUID()] = player->getName();
-	wildcardTree.insert(lowercase_name);
+	wildcardTree.insert(asLowerCaseString(player->getName()));
 	players[player->getID()] = player;
+
+	const int64_t now = OTSYS_TIME();
+	schedulePlayerTimer(player, PLAYERTIMER_PING, player->lastPing + PLAYER_PING_INTERVAL);
+	schedulePlayerTimer(player, PLAYERTIMER_IDLE, now);
+	schedulePlayerSkullCheck(player);
+}
+
+void Game::schedulePlayerSkullCheck(const Player* player)
+{
+	const Skulls_t skull = player->getSkull();
+	if (skull == SKULL_RED) {
+		const int64_t remaining = std::max<int64_t>(0, player->playerKillerEnd - std::time(nullptr));
+		schedulePlayerTimer(player, PLAYERTIMER_SKULL, OTSYS_TIME() + remaining * 1000);
+	} else if (skull == SKULL_WHITE) {
+		schedulePlayerTimer(player, PLAYERTIMER_SKULL, OTSYS_TIME());
+	}
+}
+
+void Game::checkPlayerTimers()
+{
+	g_scheduler.addEvent(createSchedulerTask(EVENT_PLAYER_TIMERS_INTERVAL, std::bind(&Game::checkPlayerTimers, this), "Game::checkPlayerTimers"));
+
+	const int64_t now = OTSYS_TIME();
+	while (!playerTimers.empty() && playerTimers.top().dueTime <= now) {
+		const PlayerTimer timer = playerTimers.top();
+		playerTimers.pop();
+
+		Player* player = getPlayerByID(timer.playerId);
+		if (!player || player->isRemoved()) {
+			continue;
+		}
+
+		switch (timer.type) {
+			case PLAYERTIMER_PING: {
+				// a reconnect restarts the interval
+				if (now - player->lastPing >= PLAYER_PING_INTERVAL) {
+					player->sendPing();
+				}
+
+				if (!player->isRemoved()) {
+					schedulePlayerTimer(player, PLAYERTIMER_PING, player->lastPing + PLAYER_PING_INTERVAL);
+				}
+				break;
+			}
+
+			case PLAYERTIMER_IDLE: {
+				if (const int64_t nextCheck = player->checkIdle(now)) {
+					schedulePlayerTimer(player, PLAYERTIMER_IDLE, nextCheck);
+				}
+				break;
+			}
+
+			case PLAYERTIMER_SKULL: {
+				// the end of a fight checks the skull again
+				if (getWorldType() != WORLD_TYPE_PVP_ENFORCED) {
+					player->checkSkullTicks();
+				}
+
+				if (player->getSkull() == SKULL_RED && player->playerKillerEnd > std::time(nullptr)) {
+					schedulePlayerSkullCheck(player);
+				}
+				break;
+			}
+		}
+	}
 }
 
 void Game::removePlayer(Player* player)
 {
-	const std::string& lowercase_name = asLowerCaseString(player->getName());
-	mappedPlayerNames.erase(lowercase_name);
+	mappedPlayerNames.erase(player->getName());
 	mappedPlayerGuids.erase(player->getGUID());
-	wildcardTree.remove(lowercase_name);
+	wildcardTree.remove(asLowerCaseString(player->getName()));
 	players.erase(player->getID());
 }
 
+void Game::addVIPSubscriber(uint32_t guid, Player* player)
+{
+	vipSubscribers[guid].push_back(player);
+}
+
+void Game::removeVIPSubscriber(uint32_t guid, Player* player)
+{
+	auto it = vipSubscribers.find(guid);
+	if (it == vipSubscribers.end()) {
+		return;
+	}
+
+	std::vector<Player*>& subscribers = it->second;
+	auto subscriber = std::find(subscribers.begin(), subscribers.end(), player);
+	if (subscriber != subscribers.end()) {
+		*subscriber = subscribers.back();
+		subscribers.pop_back();
+	}
+
+	if (subscribers.empty()) {
+		vipSubscribers.erase(it);
+	}
+}
+
+uint32_t Game::reserveNpcId(uint32_t id)
+{
+	return npcs.isReserved(id) ? id : npcs.reserveId();
+}
+
 void Game::addNpc(Npc* npc)
 {
-	npcs[npc->getID()] = npc;
+	npcs.insert(npc);
 }
 
 void Game::removeNpc(Npc* npc)
@@ -5638,9 +6437,14 @@ void Game::removeNpc(Npc* npc)
 	npcs.erase(npc->getID());
 }
 
+uint32_t Game::reserveMonsterId(uint32_t id)
+{
+	return monsters.isReserved(id) ? id : monsters.reserveId();
+}
+
 void Game::addMonster(Monster* monster)
 {
-	monsters[monster->getID()] = monster;
+	monsters.insert(monster);
 }
 
 void Game::removeMonster(Monster* monster)
@@ -5741,13 +6545,23 @@ bool Game::reload(ReloadTypes_t reloadType)
 		case RELOAD_TYPE_CONFIG: return g_config.reload();
 		case RELOAD_TYPE_EVENTS: return g_events->load();
 		case RELOAD_TYPE_ITEMS: return Item::items.reload();
-		case RELOAD_TYPE_MONSTERS: return g_monsters.reload();
+		case RELOAD_TYPE_MONSTERS: {
+			if (!g_monsters.reload()) {
+				return false;
+			}
+			map.updateHearers();
+			return true;
+		}
 		case RELOAD_TYPE_NPCS: {
 			Npcs::reload();
 			return true;
 		}
 
 		case RELOAD_TYPE_RAIDS: return raids.reload() && raids.startup();
+		case RELOAD_TYPE_GUILDS: {
+			loadGuilds();
+			return true;
+		}
 
 		case RELOAD_TYPE_SCRIPTS: {
 			// commented out stuff is TODO, once we approach further in revscriptsys
@@ -5771,6 +6585,14 @@ bool Game::reload(ReloadTypes_t reloadType)
 			g_events->load();
 			g_chat->load();
 			*/
+			map.updateHearers();
+			return true;
+		}
+
+		case RELOAD_TYPE_CHANGED_SCRIPTS: {
+			// only the files changed since they were loaded, everything else keeps its registrations
+			g_scripts->reloadChangedScripts("scripts");
+			map.updateHearers();
 			return true;
 		}
 
@@ -5787,6 +6609,7 @@ bool Game::reload(ReloadTypes_t reloadType)
 			Item::items.reload();
 			g_events->load();
 			g_chat->load();
+			loadGuilds();
 			g_actions->clear();
 			g_creatureEvents->clear();
 			g_moveEvents->clear();
@@ -5795,6 +6618,7 @@ bool Game::reload(ReloadTypes_t reloadType)
 			g_spells->clear();
 			g_scripts->loadScripts("scripts", false, true);
 			g_creatureEvents->removeInvalidEvents();
+			map.updateHearers();
 			return true;
 		}
 	}
@@ -13,9 +13,14 @@
 #include "player.h"
 #include "raids.h"
 #include "npc.h"
+#include "creaturetable.h"
 #include "wildcardtree.h"
+#include "decay.h"
+#include "statementlog.h"
+#include "attemptlimiter.h"
 
 class ServiceManager;
+class MapPatch;
 class Creature;
 class Monster;
 class Npc;
@@ -62,29 +67,31 @@ struct RuleViolation {
 	bool pending;
 };
 
-struct Statement
-{
-	uint32_t statementID = 0;
-    uint32_t timeStamp = 0;
-    uint32_t characterID = 0;
-    uint32_t mode = 0;
-    uint32_t channel = 0;
-    std::string text;
-    bool reported = false;
-};
-
-struct Listener
-{
-    uint32_t StatementID = 0;
-    uint32_t CharacterID = 0;
+// global saves, the time the dispatcher spends on them (the files are written afterwards on the file thread)
+struct GameSaveStats {
+	uint64_t saves = 0;
+	std::chrono::microseconds totalTime{0};
+	std::chrono::microseconds lastTime{0};
+	// players saved by the rolling autosave
+	uint64_t autosaves = 0;
 };
 
 static constexpr int32_t EVENT_LIGHTINTERVAL = 1000;
 static constexpr int32_t EVENT_WORLDTIMEINTERVAL = 2500;
 static constexpr int32_t EVENT_DECAYINTERVAL = 250;
-static constexpr int32_t EVENT_DECAY_BUCKETS = 4;
 static constexpr int32_t EVENT_CONDITIONS_INTERVAL = 1000;
 static constexpr int32_t EVENT_COMMUNICATION_INTERVAL = 5000;
+static constexpr int32_t EVENT_AUTOSAVE_INTERVAL = 1000;
+static constexpr int32_t EVENT_PLAYER_TIMERS_INTERVAL = 1000;
+static constexpr int32_t EVENT_FORKED_SAVE_INTERVAL = 100;
+static constexpr int32_t EVENT_ONLINE_STATUS_INTERVAL = 1000;
+static constexpr int32_t PLAYER_PING_INTERVAL = 5000;
+
+enum PlayerTimer_t : uint8_t {
+	PLAYERTIMER_PING,
+	PLAYERTIMER_IDLE,
+	PLAYERTIMER_SKULL,
+};
 
 static constexpr int32_t PLAYER_NAME_MAXLENGTH = 30;
 
@@ -105,8 +112,11 @@ class Game
 
 		void start(ServiceManager* manager);
 
+		// tiles and houses, any thread; the spawns are loaded by loadMainMapSpawns once the monsters and npcs are
 		bool loadMainMap(const std::string& filename);
-		void loadMap(const std::string& path);
+		void loadMainMapSpawns();
+		// decodes the map part on the file thread and applies it to the live map in batches, false while another one is applied
+		bool loadMap(const std::string& path);
 
 		/**
 		  * Get the map size - info purpose only
@@ -216,6 +226,22 @@ class Game
 		  */
 		bool placeCreature(Creature* creature, const Position& pos, bool forced = false);
 
+		/**
+		  * Place a batch of creatures on the map, like placeCreature with forced set,
+		  * looking up the spectators of all of them at once.
+		  * \param creatures Creatures to place with their positions
+		  * \returns The creatures that were placed, the others are left without a parent
+		  */
+		std::vector<Creature*> placeCreatures(const std::vector<std::pair<Creature*, Position>>& creatures);
+
+		/**
+		  * Creatures placed between these calls are put on the map right away, but their
+		  * spectators are told at the end, with one spectator lookup per map region.
+		  * Calls can be nested, the outermost end announces the creatures.
+		  */
+		void beginPlaceCreatures();
+		void endPlaceCreatures();
+
 		/**
 		  * Remove Creature from the map.
 		  * Removes the Creature from the map
@@ -227,6 +253,8 @@ class Game
 
 		void addCreatureCheck(Creature* creature);
 		static void removeCreatureCheck(Creature* creature);
+		void addConditionCreature(Creature* creature);
+		void addBatchedMonsterThink(Monster* monster);
 
 		size_t getPlayersOnline() const {
 			return players.size();
@@ -237,6 +265,9 @@ class Game
 		size_t getNpcsOnline() const {
 			return npcs.size();
 		}
+		size_t getDecayingItems() const {
+			return decayWheel.size();
+		}
 		uint32_t getPlayersRecord() const {
 			return playersRecord;
 		}
@@ -264,6 +295,11 @@ class Game
 
 		ReturnValue internalMoveItem(Cylinder* fromCylinder, Cylinder* toCylinder, int32_t index,
 		                             Item* item, uint32_t count, Item** _moveItem, uint32_t flags = 0, Creature* actor = nullptr, Item* tradeItem = nullptr, const Position* fromPos = nullptr, const Position* toPos = nullptr);
+		/// Moves whole items into toContainer, all of them or, when one cannot be moved, none.
+		///	The room, capacity and depot checks run once for the lot, stackables merge into the open
+		///	stacks of the container and the players seeing the changes get one update per container
+		///	and tile. Items already in toContainer are skipped.
+		ReturnValue internalMoveItems(const ItemVector& items, Container* toContainer, uint32_t flags = 0, Creature* actor = nullptr);
 
 		ReturnValue internalAddItem(Cylinder* toCylinder, Item* item, int32_t index = INDEX_WHEREEVER,
 		                            uint32_t flags = 0, bool test = false);
@@ -364,7 +400,8 @@ class Game
 		bool playerBroadcastMessage(Player* player, const std::string& text) const;
 		void broadcastMessage(const std::string& text, MessageClasses type) const;
 
-		void executeCreature(uint32_t creatureId);
+		// queues the creature to run its to do entries once its earliestWakeUpTime is reached
+		void scheduleCreatureExecution(const Creature* creature);
 
 		//Implementation of player invoked events
 		void playerMoveThing(uint32_t playerId, const Position fromPos, uint16_t spriteId, uint8_t fromStackPos,
@@ -437,6 +474,8 @@ class Game
 		bool searchLoginField(Creature* creature, uint16_t& x, uint16_t& y, uint8_t& z, int32_t distance, bool player, bool allowHouses = false);
 		bool searchSpawnField(uint16_t& x, uint16_t& y, uint8_t& z, int32_t distance);
 		bool searchSummonField(uint16_t& x, uint16_t& y, uint8_t& z, int32_t distance);
+		// up to count distinct fields searchSummonField could pick, in random order
+		std::vector<Position> searchSummonFields(const Position& centerPos, int32_t distance, size_t count);
 
 		void cleanup();
 		void shutdown();
@@ -450,6 +489,12 @@ class Game
 		void internalCreatureChangeVisible(Creature* creature, bool visible);
 		void changeLight(const Creature* creature);
 		void updateCreatureSkull(const Creature* creature);
+		// the timer of the player runs at dueTime (OTSYS_TIME)
+		void schedulePlayerTimer(const Player* player, PlayerTimer_t type, int64_t dueTime) {
+			playerTimers.push({dueTime, player->getID(), type});
+		}
+		// a red skull is checked when it expires, a white one right away
+		void schedulePlayerSkullCheck(const Player* player);
 		void updatePlayerShield(Player* player);
 
 		void storePlayerName(uint32_t id, const std::string& str) {
@@ -463,21 +508,37 @@ class Game
 			return it->second;
 		}
 
+		// the online players that have guid in their VIP list, kept by Player::addList/removeList and the VIP changes
+		const std::vector<Player*>* getVIPSubscribers(uint32_t guid) const {
+			auto it = vipSubscribers.find(guid);
+			if (it == vipSubscribers.end()) {
+				return nullptr;
+			}
+			return &it->second;
+		}
+		void addVIPSubscriber(uint32_t guid, Player* player);
+		void removeVIPSubscriber(uint32_t guid, Player* player);
+
 		GameState_t getGameState() const;
 		void setGameState(GameState_t newState);
 		void saveGameState();
+		// reaps the forked save once it is done, wait blocks until then
+		void checkForkedSave(bool wait);
 
 		//Events
 		void processConditions();
+		// the periodic events setGameState(GAME_STATE_INIT) starts, tvp_sim calls it without the rest of the startup
+		void startWorldEvents();
 		void checkCreatures(size_t index);
 		void checkLight();
 
-		BlockType_t combatBlockHit(CombatDamage& damage, Creature* attacker, Creature* target, bool checkDefense, bool checkArmor, bool field, bool ignoreResistances = false, bool meleeHit = false);
+		// spectators, when given, must cover every player that can see the target, area combat passes the set it gathered for the whole area
+		BlockType_t combatBlockHit(CombatDamage& damage, Creature* attacker, Creature* target, bool checkDefense, bool checkArmor, bool field, bool ignoreResistances = false, bool meleeHit = false, const SpectatorVec* spectators = nullptr);
 
 		void combatGetTypeInfo(CombatType_t combatType, Creature* target, TextColor_t& color, uint8_t& effect);
 
-		bool combatChangeHealth(Creature* attacker, Creature* target, CombatDamage& damage);
-		bool combatChangeMana(Creature* attacker, Creature* target, CombatDamage& damage);
+		bool combatChangeHealth(Creature* attacker, Creature* target, CombatDamage& damage, const SpectatorVec* spectators = nullptr);
+		bool combatChangeMana(Creature* attacker, Creature* target, CombatDamage& damage, const SpectatorVec* spectators = nullptr);
 
 		//animation help functions
 		void addCreatureHealth(const Creature* target);
@@ -490,11 +551,19 @@ class Game
 		static void addAnimatedText(const SpectatorVec& spectators, const Position& pos, TextColor_t textColor, const std::string& text);
 
 		void setAccountStorageValue(const uint32_t accountId, const uint32_t key, const int32_t value);
-		int32_t getAccountStorageValue(const uint32_t accountId, const uint32_t key) const;
-		void loadAccountStorageValues();
-		bool saveAccountStorageValues() const;
+		int32_t getAccountStorageValue(const uint32_t accountId, const uint32_t key);
+		// reads the values of the account unless they were read already, at login or on first use
+		void loadAccountStorageValues(uint32_t accountId);
+		// also reloads the names and ranks of the guilds read before, deleted guilds and ranks stay
+		void loadGuilds();
+		// writes the values changed since the last save
+		bool saveAccountStorageValues();
 
 		void startDecay(Item* item);
+		// puts the item in the decay wheel without checking whether it can decay yet, that happens when it expires
+		void scheduleDecay(Item* item);
+		void stopDecay(Item* item);
+		bool getDecayRemaining(const Item* item, uint32_t& remaining) const;
 
 		int16_t getWorldTime() { return worldTime; }
 		void updateWorldTime();
@@ -507,14 +576,18 @@ class Game
 
 		const std::unordered_map<uint32_t, RuleViolation>& getRuleViolationReports() const { return ruleViolations; }
 		const std::unordered_map<uint32_t, Player*>& getPlayers() const { return players; }
-		const std::map<uint32_t, Npc*>& getNpcs() const { return npcs; }
+		const CreatureTable<Npc>& getNpcs() const { return npcs; }
+		const CreatureTable<Monster>& getMonsters() const { return monsters; }
 
 		void addPlayer(Player* player);
 		void removePlayer(Player* player);
 
+		// id if it is still reserved, a new one otherwise
+		uint32_t reserveNpcId(uint32_t id);
 		void addNpc(Npc* npc);
 		void removeNpc(Npc* npc);
 
+		uint32_t reserveMonsterId(uint32_t id);
 		void addMonster(Monster* monster);
 		void removeMonster(Monster* monster);
 
@@ -527,6 +600,13 @@ class Game
 		BedItem* getBedBySleeper(uint32_t guid) const;
 		void setBedSleeper(BedItem* bed, uint32_t guid);
 		void removeBedSleeper(uint32_t guid);
+		const std::unordered_map<uint32_t, BedItem*>& getBedSleepers() const {
+			return bedSleepersMap;
+		}
+
+		const GameSaveStats& getSaveStats() const {
+			return saveStats;
+		}
 
 		Item* getUniqueItem(uint16_t uniqueId);
 		bool addUniqueItem(uint16_t uniqueId, Item* item);
@@ -538,32 +618,44 @@ class Game
 		Map map;
 		Raids raids;
 
-		std::forward_list<Item*> toDecayItems;
-
 		bool isTileInRefreshList(const Tile* tile) const {
-		    return std::find(tilesToRefresh.begin(), tilesToRefresh.end(), tile) != tilesToRefresh.end();
+			return tile->hasTrackFlag(TILETRACK_REFRESH);
 		}
 
 		void clearTileFromRefresh(const Tile* tile);
-		std::vector<Tile*> getTilesToRefresh() const {
+		const std::vector<Tile*>& getTilesToRefresh() const {
 			return tilesToRefresh;
 		}
-		void addTileToRefresh(Tile* tile) {
-			tilesToRefresh.push_back(tile);
-		}
+		void addTileToRefresh(Tile* tile);
 
-	    bool isTileInSaveList(const Tile* tile) const {
-		    return std::find(tilesToSave.begin(), tilesToSave.end(), tile) != tilesToSave.end();
-	    }
+		bool isTileInSaveList(const Tile* tile) const {
+			return tile->hasTrackFlag(TILETRACK_SAVE);
+		}
 
 		void clearTileFromSave(const Tile* tile);
-		std::vector<Tile*> getTilesToSave() const {
+		const std::vector<Tile*>& getTilesToSave() const {
 			return tilesToSave;
 		}
 		void addTileToSave(Tile* tile) {
-			tilesToSave.push_back(tile);
+			if (!tile->hasTrackFlag(TILETRACK_SAVE)) {
+				tile->setTrackFlag(TILETRACK_SAVE);
+				tilesToSave.push_back(tile);
+			}
 		}
 
+		// tiles of the save list changed since the last map data save, each one listed once
+		const std::vector<Tile*>& getTileSaveJournal() const {
+			return tileSaveJournal;
+		}
+		void addTileToSaveJournal(Tile* tile) {
+			tile->setTrackFlag(TILETRACK_SNAPSHOT_DIRTY);
+			if (!tile->hasTrackFlag(TILETRACK_SAVE_DIRTY)) {
+				tile->setTrackFlag(TILETRACK_SAVE_DIRTY);
+				tileSaveJournal.push_back(tile);
+			}
+		}
+		void clearTileSaveJournal();
+
 		bool isMapSavingEnabled() const {
 			return allowMapSave;
 		}
@@ -584,6 +676,9 @@ class Game
 
 		uint32_t recordStatement(uint32_t guid, uint32_t mode, uint32_t channel, const std::string& text);
 		void recordListener(uint32_t statementId, uint32_t guid);
+		StatementLog& getStatementLog() {
+			return statementLog;
+		}
 
 	private:
 		bool playerSaySpell(Player* player, SpeakClasses type, const std::string& text);
@@ -591,52 +686,143 @@ class Game
 		bool playerYell(Player* player, const std::string& text);
 		bool playerSpeakTo(Player* player, SpeakClasses type, const std::string& receiver, const std::string& text);
 
+		void announcePlacedCreatures(std::vector<Creature*>::iterator first, std::vector<Creature*>::iterator last, std::unordered_set<const Creature*>& pending);
+		void onPlacedCreature(Creature* creature);
+
 		void processCommunication();
+		// saves the players whose second of playerAutosaveInterval it is, every player once an interval
+		void autosavePlayers();
+		// the last second autosavePlayers handled, the seconds since are caught up on the next run
+		time_t lastAutosaveTime = 0;
+		void flushOnlineStatus();
+		// writes the files of a global save from a forked copy of the server, false if it cannot fork
+		bool forkSaveGameState(const std::vector<Player*>& onlinePlayers);
+		// the part of a forked save the server sends itself
+		void saveGameStateDatabase(const std::vector<Player*>& onlinePlayers);
+		// runs the player timers that are due, instead of every player checking them on every think
+		void checkPlayerTimers();
 		void processRemovedCreatures();
 		void proceduralRefreshMap();
 		void checkDecay();
+		void executeCreatures();
+		void executeBatchedMonsterThinks();
 		void internalDecayItem(Item* item);
 
+		// broadcast to the given spectators, or look them up when there are none
+		void addCreatureHealth(const SpectatorVec* spectators, const Creature* target);
+		void addMagicEffect(const SpectatorVec* spectators, const Position& pos, uint8_t effect);
+		void addAnimatedText(const SpectatorVec* spectators, const Position& pos, TextColor_t textColor, const std::string& text);
+
 		std::unordered_map<uint32_t, RuleViolation> ruleViolations;
 
 		std::unordered_map<uint32_t, Player*> players;
-		std::unordered_map<std::string, Player*> mappedPlayerNames;
+		std::unordered_map<std::string, Player*, CaseInsensitiveHash, CaseInsensitiveEqual> mappedPlayerNames;
 		std::unordered_map<uint32_t, Player*> mappedPlayerGuids;
 		std::unordered_map<uint32_t, std::string> preloadedPlayerGuids;
+		std::unordered_map<uint32_t, std::vector<Player*>> vipSubscribers;
 		std::unordered_map<uint32_t, Guild*> guilds;
 		std::unordered_map<uint16_t, Item*> uniqueItems;
 		std::map<uint32_t, uint32_t> stages;
 		std::unordered_map<uint32_t, std::unordered_map<uint32_t, int32_t>> accountStorageMap;
-		std::deque<Statement> statements;
-		std::deque<Listener> listeners;
-
-		std::unordered_map<uint32_t, std::pair<uint32_t, uint64_t>> accountLoginAttemptsMap;
-		std::unordered_map<uint32_t, std::pair<uint32_t, uint64_t>> ipLoginAttemptsMap;
-
-		std::list<Item*> decayItems[EVENT_DECAY_BUCKETS];
-		std::list<Creature*> checkCreatureLists[EVENT_CREATURECOUNT];
+		// account and key of the values changed since the last save
+		std::set<std::pair<uint32_t, uint32_t>> dirtyAccountStorage;
+		StatementLog statementLog;
+		// the expired statements are removed by an idle job, one at a time, or by processCommunication
+		// when the job is still waiting for an empty queue on the next interval
+		bool statementTrimQueued = false;
+
+		// the map part being applied, see loadMap
+		std::shared_ptr<MapPatch> mapPatch;
+		void applyMapPatch();
+
+		AttemptLimiter accountLoginAttempts;
+		AttemptLimiter ipLoginAttempts;
+
+		DecayWheel decayWheel;
+		std::vector<Item*> expiredDecayItems;
+
+		// creatures waiting to run their to do entries, in the slot of their wake up time. An entry whose
+		// wake up time is not the creature's anymore was replaced by a newer one and is dropped.
+		struct CreatureExecution {
+			uint32_t creatureId;
+			int64_t wakeUpTime;
+		};
+		static constexpr size_t EXECUTE_WHEEL_SIZE = 64;
+		std::array<std::vector<CreatureExecution>, EXECUTE_WHEEL_SIZE> executeWheel;
+		std::vector<CreatureExecution> dueExecutions;
+		// the slot run next and when
+		size_t executeSlot = 0;
+		int64_t nextExecuteTime = 0;
+		// creatures are only flagged on removal and swapped out of their bucket when it is next checked
+		std::vector<Creature*> checkCreatureLists[EVENT_CREATURECOUNT];
+
+		// monsters whose type has an onThinkBatch event, collected while a check bucket is walked
+		std::unordered_map<MonsterType*, std::vector<Monster*>> batchedMonsterThinks;
+
+		// creatures that had a condition added, dropped by processConditions once they have none left
+		std::vector<Creature*> conditionCreatures;
 
 		std::vector<Creature*> ToReleaseCreatures;
+
+		// creatures placed since beginPlaceCreatures, each holding a reference
+		static constexpr int32_t PLACE_CREATURES_REGION_BITS = 5;
+		std::vector<Creature*> placedCreatures;
+		uint32_t placeCreaturesDepth = 0;
 		std::vector<Item*> ToReleaseItems;
 
 		std::set<Creature*> removedCreatures;
 		std::set<Creature*> killedCreatures;
 
-		size_t lastBucket = 0;
-		size_t nextMapRefreshSet = 0;
-
-		WildcardTreeNode wildcardTree { false };
+		WildcardTree wildcardTree;
 
-		std::map<uint32_t, Npc*> npcs;
-		std::map<uint32_t, Monster*> monsters;
+		CreatureTable<Npc> npcs{Npc::ID_BASE};
+		CreatureTable<Monster> monsters{Monster::ID_BASE};
 
 		//list of items that are in trading state, mapped to the player
-		std::map<Item*, uint32_t> tradeItems;
+		std::unordered_map<Item*, uint32_t> tradeItems;
 
-		std::map<uint32_t, BedItem*> bedSleepersMap;
+		std::unordered_map<uint32_t, BedItem*> bedSleepersMap;
 
 		std::vector<Tile*> tilesToRefresh;
+
+		// the refresh tiles grouped by 32x32 area of a floor, one player check covers a whole sector
+		// and the sectors wait in a queue ordered by the time their next tile is due
+		struct RefreshSector {
+			std::vector<Tile*> tiles;
+			Position base;
+			int64_t dueTime = 0;
+		};
+		struct RefreshSectorDue {
+			int64_t dueTime;
+			uint32_t sector;
+
+			bool operator>(const RefreshSectorDue& other) const {
+				return dueTime > other.dueTime;
+			}
+		};
+		static constexpr int32_t REFRESH_SECTOR_BITS = 5;
+
+		void refreshSector(RefreshSector& sector, int64_t now);
+
+		std::vector<RefreshSector> refreshSectors;
+		std::unordered_map<uint32_t, uint32_t> refreshSectorIndex;
+		std::priority_queue<RefreshSectorDue, std::vector<RefreshSectorDue>, std::greater<RefreshSectorDue>> refreshQueue;
+
+		// the keep-alive pings, idle checks and skull expiries of the players online, by when they are due;
+		// a timer of a player who left is dropped when it comes up
+		struct PlayerTimer {
+			int64_t dueTime;
+			uint32_t playerId;
+			PlayerTimer_t type;
+
+			bool operator>(const PlayerTimer& other) const {
+				return dueTime > other.dueTime;
+			}
+		};
+		std::priority_queue<PlayerTimer, std::vector<PlayerTimer>, std::greater<PlayerTimer>> playerTimers;
+
 		std::vector<Tile*> tilesToSave;
+		std::vector<Tile*> tileSaveJournal;
 
 		static constexpr uint8_t LIGHT_DAY = 250;
 		static constexpr uint8_t LIGHT_NIGHT = 40;
@@ -667,10 +853,20 @@ class Game
 		std::string motdHash;
 		uint32_t motdNum = 0;
 
-		uint32_t eventRefreshId = 0;
+		uint64_t eventRefreshId = 0;
 
 		uint32_t bootTime = 0;
 
+		GameSaveStats saveStats;
+
+		// the forked copy writing the last global save, pid 0 while there is none
+		struct ForkedSave {
+			int pid = 0;
+			int pipe = -1;
+			std::chrono::steady_clock::time_point start;
+		};
+		ForkedSave forkedSave;
+
 		uint32_t lastStageLevel = 0;
 		bool stagesEnabled = false;
 		bool useLastStageLevel = false;
@@ -678,6 +874,4 @@ class Game
 		bool allowMapSave = true;
 
 		bool sendPlayersToTemple = false;
-
-		std::mutex gameLock;
 };
@@ -37,18 +37,49 @@ void GlobalEvents::clear()
 	clearMap(thinkMap);
 	clearMap(serverMap);
 	clearMap(timerMap);
+	rebuildQueues();
 
 	getScriptInterface().reInitState();
 }
 
+void GlobalEvents::removeScriptFile(const std::string* scriptFile)
+{
+	for (GlobalEventMap* map : {&thinkMap, &serverMap, &timerMap}) {
+		for (auto it = map->begin(); it != map->end();) {
+			if (it->second.isFromScriptFile(scriptFile)) {
+				it = map->erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	rebuildQueues();
+
+	// restarted so that the events the file registers again are scheduled right away
+	g_scheduler.stopEvent(thinkEventId);
+	thinkEventId = 0;
+	if (!thinkMap.empty()) {
+		thinkEventId = g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&GlobalEvents::think, this), "GlobalEvents::think"));
+	}
+
+	g_scheduler.stopEvent(timerEventId);
+	timerEventId = 0;
+	if (!timerMap.empty()) {
+		timerEventId = g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&GlobalEvents::timer, this), "GlobalEvents::timer"));
+	}
+}
+
 bool GlobalEvents::registerLuaEvent(GlobalEvent* event)
 {
 	GlobalEvent_ptr globalEvent{ event };
 	if (globalEvent->getEventType() == GLOBALEVENT_TIMER) {
 		auto result = timerMap.emplace(globalEvent->getName(), std::move(*globalEvent));
 		if (result.second) {
+			GlobalEvent& timerEvent = result.first->second;
+			timerQueue.emplace(timerEvent.getNextExecution(), &timerEvent);
 			if (timerEventId == 0) {
-				timerEventId = g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&GlobalEvents::timer, this)));
+				timerEventId = g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&GlobalEvents::timer, this), "GlobalEvents::timer"));
 			}
 			return true;
 		}
@@ -60,8 +91,10 @@ bool GlobalEvents::registerLuaEvent(GlobalEvent* event)
 	} else { // think event
 		auto result = thinkMap.emplace(globalEvent->getName(), std::move(*globalEvent));
 		if (result.second) {
+			GlobalEvent& thinkEvent = result.first->second;
+			thinkQueue.emplace(thinkEvent.getNextExecution(), &thinkEvent);
 			if (thinkEventId == 0) {
-				thinkEventId = g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&GlobalEvents::think, this)));
+				thinkEventId = g_scheduler.addEvent(createSchedulerTask(SCHEDULER_MINTICKS, std::bind(&GlobalEvents::think, this), "GlobalEvents::think"));
 			}
 			return true;
 		}
@@ -76,77 +109,76 @@ void GlobalEvents::startup() const
 	execute(GLOBALEVENT_STARTUP);
 }
 
-void GlobalEvents::timer()
+void GlobalEvents::rebuildQueues()
 {
-	time_t now = time(nullptr);
-
-	int64_t nextScheduledTime = std::numeric_limits<int64_t>::max();
+	thinkQueue = {};
+	for (auto& it : thinkMap) {
+		thinkQueue.emplace(it.second.getNextExecution(), &it.second);
+	}
 
-	auto it = timerMap.begin();
-	while (it != timerMap.end()) {
-		GlobalEvent& globalEvent = it->second;
+	timerQueue = {};
+	for (auto& it : timerMap) {
+		timerQueue.emplace(it.second.getNextExecution(), &it.second);
+	}
+}
 
-		int64_t nextExecutionTime = globalEvent.getNextExecution() - now;
-		if (nextExecutionTime > 0) {
-			if (nextExecutionTime < nextScheduledTime) {
-				nextScheduledTime = nextExecutionTime;
-			}
+void GlobalEvents::timer()
+{
+	const int64_t now = time(nullptr);
 
-			++it;
-			continue;
-		}
+	// every event runs at most once a call, even when it is behind
+	std::vector<GlobalEvent*> executed;
+	while (!timerQueue.empty() && timerQueue.top().first <= now) {
+		GlobalEvent* globalEvent = timerQueue.top().second;
+		timerQueue.pop();
 
-		if (!globalEvent.executeEvent()) {
-			it = timerMap.erase(it);
+		if (!globalEvent->executeEvent()) {
+			timerMap.erase(timerMap.find(globalEvent->getName()));
 			continue;
 		}
 
-		nextExecutionTime = 86400;
-		if (nextExecutionTime < nextScheduledTime) {
-			nextScheduledTime = nextExecutionTime;
-		}
-
-		globalEvent.setNextExecution(globalEvent.getNextExecution() + nextExecutionTime);
+		globalEvent->setNextExecution(globalEvent->getNextExecution() + 86400);
+		executed.push_back(globalEvent);
+	}
 
-		++it;
+	for (GlobalEvent* globalEvent : executed) {
+		timerQueue.emplace(globalEvent->getNextExecution(), globalEvent);
 	}
 
-	if (nextScheduledTime != std::numeric_limits<int64_t>::max()) {
-		timerEventId = g_scheduler.addEvent(createSchedulerTask(std::max<int64_t>(1000, nextScheduledTime * 1000),
+	if (!timerQueue.empty()) {
+		timerEventId = g_scheduler.addEvent(createSchedulerTask(std::max<int64_t>(1000, (timerQueue.top().first - now) * 1000),
 							                std::bind(&GlobalEvents::timer, this)));
+	} else {
+		timerEventId = 0;
 	}
 }
 
 void GlobalEvents::think()
 {
-	int64_t now = OTSYS_TIME();
+	const int64_t now = OTSYS_TIME();
 
-	int64_t nextScheduledTime = std::numeric_limits<int64_t>::max();
-	for (auto& it : thinkMap) {
-		GlobalEvent& globalEvent = it.second;
+	std::vector<GlobalEvent*> executed;
+	while (!thinkQueue.empty() && thinkQueue.top().first <= now) {
+		GlobalEvent* globalEvent = thinkQueue.top().second;
+		thinkQueue.pop();
 
-		int64_t nextExecutionTime = globalEvent.getNextExecution() - now;
-		if (nextExecutionTime > 0) {
-			if (nextExecutionTime < nextScheduledTime) {
-				nextScheduledTime = nextExecutionTime;
-			}
-			continue;
+		if (!globalEvent->executeEvent()) {
+			std::cout << "[Error - GlobalEvents::think] Failed to execute event: " << globalEvent->getName() << std::endl;
 		}
 
-		if (!globalEvent.executeEvent()) {
-			std::cout << "[Error - GlobalEvents::think] Failed to execute event: " << globalEvent.getName() << std::endl;
-		}
-
-		nextExecutionTime = globalEvent.getInterval();
-		if (nextExecutionTime < nextScheduledTime) {
-			nextScheduledTime = nextExecutionTime;
-		}
+		// an event that fell behind in a stall runs once and keeps its interval from now on, it does not catch up
+		globalEvent->setNextExecution(std::max(globalEvent->getNextExecution() + globalEvent->getInterval(), now + globalEvent->getInterval()));
+		executed.push_back(globalEvent);
+	}
 
-		globalEvent.setNextExecution(globalEvent.getNextExecution() + nextExecutionTime);
+	for (GlobalEvent* globalEvent : executed) {
+		thinkQueue.emplace(globalEvent->getNextExecution(), globalEvent);
 	}
 
-	if (nextScheduledTime != std::numeric_limits<int64_t>::max()) {
-		thinkEventId = g_scheduler.addEvent(createSchedulerTask(nextScheduledTime, std::bind(&GlobalEvents::think, this)));
+	if (!thinkQueue.empty()) {
+		thinkEventId = g_scheduler.addEvent(createSchedulerTask(std::max<int64_t>(SCHEDULER_MINTICKS, thinkQueue.top().first - now), std::bind(&GlobalEvents::think, this), "GlobalEvents::think"));
+	} else {
+		thinkEventId = 0;
 	}
 }
 
@@ -5,6 +5,8 @@
 
 #include "script.h"
 
+#include <queue>
+
 enum GlobalEvent_t {
 	GLOBALEVENT_NONE,
 	GLOBALEVENT_TIMER,
@@ -17,6 +19,8 @@ enum GlobalEvent_t {
 class GlobalEvent;
 using GlobalEvent_ptr = std::unique_ptr<GlobalEvent>;
 using GlobalEventMap = std::map<std::string, GlobalEvent>;
+// the events of a map by their next execution, soonest first
+using GlobalEventQueue = std::priority_queue<std::pair<int64_t, GlobalEvent*>, std::vector<std::pair<int64_t, GlobalEvent*>>, std::greater<>>;
 
 class GlobalEvents final
 {
@@ -39,6 +43,7 @@ class GlobalEvents final
 
 		bool registerLuaEvent(GlobalEvent* event);
 		void clear();
+		void removeScriptFile(const std::string* scriptFile);
 
 	private:
 		std::string getScriptBaseName() const {
@@ -50,8 +55,12 @@ class GlobalEvents final
 		}
 		LuaScriptInterface scriptInterface;
 
+		// queues the events of the think and timer maps again, after some were erased
+		void rebuildQueues();
+
 		GlobalEventMap thinkMap, serverMap, timerMap;
-		int32_t thinkEventId = 0, timerEventId = 0;
+		GlobalEventQueue thinkQueue, timerQueue;
+		uint64_t thinkEventId = 0, timerEventId = 0;
 };
 
 class GlobalEvent final : public ScriptEvent
@@ -0,0 +1,26 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "configmanager.h"
+#include "databasetasks.h"
+#include "filetasks.h"
+#include "game.h"
+#include "jobpool.h"
+#include "monsters.h"
+#include "scheduler.h"
+#include "vocation.h"
+
+// the server wide objects live apart from main, so other programs (tvp_bench) link the same game core
+
+DatabaseTasks g_databaseTasks;
+FileTasks g_fileTasks;
+JobPool g_jobPool;
+Dispatcher g_dispatcher;
+Scheduler g_scheduler;
+
+Game g_game;
+ConfigManager g_config;
+Monsters g_monsters;
+Vocations g_vocations;
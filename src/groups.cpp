@@ -137,15 +137,21 @@ bool Groups::load()
 
 		groups.push_back(group);
 	}
+
+	// the first group of an id wins
+	for (Group& group : groups) {
+		if (group.id >= groupsById.size()) {
+			groupsById.resize(group.id + 1);
+		}
+
+		if (!groupsById[group.id]) {
+			groupsById[group.id] = &group;
+		}
+	}
 	return true;
 }
 
 Group* Groups::getGroup(uint16_t id)
 {
-	for (Group& group : groups) {
-		if (group.id == id) {
-			return &group;
-		}
-	}
-	return nullptr;
+	return id < groupsById.size() ? groupsById[id] : nullptr;
 }
@@ -20,4 +20,6 @@ class Groups {
 
 	private:
 		std::vector<Group> groups;
+		// by id, built once the groups are loaded
+		std::vector<Group*> groupsById;
 };
@@ -5,10 +5,6 @@
 
 #include "guild.h"
 
-#include "game.h"
-
-extern Game g_game;
-
 void Guild::addMember(Player* player)
 {
 	membersOnline.push_back(player);
@@ -16,12 +12,8 @@ void Guild::addMember(Player* player)
 
 void Guild::removeMember(Player* player)
 {
+	// the guild stays cached in Game::guilds for the next login of its members
 	membersOnline.remove(player);
-
-	if (membersOnline.empty()) {
-		g_game.removeGuild(id);
-		delete this;
-	}
 }
 
 GuildRank_ptr Guild::getRankById(uint32_t rankId)
@@ -58,3 +50,16 @@ void Guild::addRank(uint32_t rankId, const std::string& rankName, uint8_t level)
 {
 	ranks.emplace_back(std::make_shared<GuildRank>(rankId, rankName, level));
 }
+
+void Guild::refresh(const Guild& loaded)
+{
+	name = loaded.name;
+	for (const GuildRank_ptr& loadedRank : loaded.ranks) {
+		if (GuildRank_ptr rank = getRankById(loadedRank->id)) {
+			rank->name = loadedRank->name;
+			rank->level = loadedRank->level;
+		} else {
+			addRank(loadedRank->id, loadedRank->name, loadedRank->level);
+		}
+	}
+}
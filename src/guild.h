@@ -47,6 +47,8 @@ class Guild
 		GuildRank_ptr getRankByName(const std::string& name) const;
 		GuildRank_ptr getRankByLevel(uint8_t level) const;
 		void addRank(uint32_t rankId, const std::string& rankName, uint8_t level);
+		// takes the name and ranks of a copy read again from the database, the ranks held by players stay valid
+		void refresh(const Guild& loaded);
 
 		const std::string& getMotd() const {
 			return motd;
@@ -10,13 +10,23 @@
 #include "game.h"
 #include "configmanager.h"
 #include "bed.h"
+#include "tasks.h"
 
 #include <fmt/format.h>
 
 extern ConfigManager g_config;
 extern Game g_game;
 
-House::House(uint32_t houseId) : id(houseId) {}
+namespace {
+
+uint32_t lastAccessVersion = 0;
+
+// items moved per idle slice of a depot transfer
+constexpr size_t DEPOT_TRANSFER_SLICE_SIZE = 32;
+
+}
+
+House::House(uint32_t houseId) : id(houseId), accessVersion(++lastAccessVersion) {}
 
 void House::addTile(Tile* tile)
 {
@@ -25,7 +35,7 @@ void House::addTile(Tile* tile)
 	houseTiles.push_back(tile);
 }
 
-void House::setOwner(uint32_t guid, bool updateDatabase/* = true*/, Player* player/* = nullptr*/)
+void House::setOwner(uint32_t guid, bool updateDatabase/* = true*/)
 {
 	if (updateDatabase && owner != guid) {
 		Database& db = Database::getInstance();
@@ -41,10 +51,9 @@ void House::setOwner(uint32_t guid, bool updateDatabase/* = true*/, Player* play
 
 	//send items to depot
 	if (guid == 0 || g_config.getBoolean(ConfigManager::HOUSE_TRANSFEROWNERSHIP_TRANSFERITEMS)) {
-		if (player) {
-			transferToDepot(player);
-		} else {
-			transferToDepot();
+		// an empty house waits for the idle slices, the new owner and guests could pick the items up before them
+		if (transferToDepot() && guid != 0) {
+			finishDepotTransfer();
 		}
 	}
 
@@ -171,15 +180,30 @@ AccessHouseLevel_t House::getHouseAccessLevel(const Player* player) const
 		return HOUSE_OWNER;
 	}
 
-	if (subOwnerList.isInList(player)) {
-		return HOUSE_SUBOWNER;
+	return getListAccessLevel(player);
+}
+
+AccessHouseLevel_t House::getListAccessLevel(const Player* player) const
+{
+	GuildRank_ptr rank = player->getGuildRank();
+	const uint32_t rankId = rank ? rank->id : 0;
+
+	Player::HouseAccess& access = player->houseAccess;
+	if (access.version == accessVersion && access.rankId == rankId) {
+		return static_cast<AccessHouseLevel_t>(access.level);
 	}
 
-	if (guestList.isInList(player)) {
-		return HOUSE_GUEST;
+	AccessHouseLevel_t level = HOUSE_NOT_INVITED;
+	if (subOwnerList.isInList(player)) {
+		level = HOUSE_SUBOWNER;
+	} else if (guestList.isInList(player)) {
+		level = HOUSE_GUEST;
 	}
 
-	return HOUSE_NOT_INVITED;
+	access.version = accessVersion;
+	access.rankId = rankId;
+	access.level = level;
+	return level;
 }
 
 bool House::kickPlayer(Player* player, Player* target)
@@ -208,8 +232,10 @@ void House::setAccessList(uint32_t listId, const std::string& textlist)
 {
 	if (listId == GUEST_LIST) {
 		guestList.parseList(textlist);
+		accessVersion = ++lastAccessVersion;
 	} else if (listId == SUBOWNER_LIST) {
 		subOwnerList.parseList(textlist);
+		accessVersion = ++lastAccessVersion;
 	} else {
 		Door* door = getDoorByNumber(listId);
 		if (door) {
@@ -238,54 +264,96 @@ bool House::transferToDepot()
 		return false;
 	}
 
-	if (Player* player = g_game.getPlayerByGUID(owner)) {
-		transferToDepot(player);
-	} else {
-		Player tmpPlayer(nullptr);
-		if (!IOLoginData::loadPlayerByGUID(&tmpPlayer, owner)) {
-			return false;
-		}
-
-		transferToDepot(&tmpPlayer);
-		IOLoginData::savePlayer(&tmpPlayer);
-	}
+	// the items of the owner before must not reach this one
+	finishDepotTransfer();
 
-	transferred = true;
-	return true;
-}
-
-bool House::transferToDepot(Player* player) const
-{
-	if (townId == 0 || owner == 0) {
+	if (!g_game.getPlayerByGUID(owner) && IOLoginData::getNameByGuid(owner).empty()) {
 		return false;
 	}
 
-	ItemList moveItemList;
+	auto transfer = std::make_unique<DepotTransfer>();
+	transfer->guid = owner;
+	transfer->townId = townId;
 	for (Tile* tile : houseTiles) {
 		if (const TileItemVector* items = tile->getItemList()) {
 			for (Item* item : *items) {
 				if (item->isPickupable()) {
-					moveItemList.push_back(item);
-				} else {
-					Container* container = item->getContainer();
-					if (container) {
-						for (Item* containerItem : container->getItemList()) {
-							moveItemList.push_back(containerItem);
-						}
+					transfer->items.push_back(item);
+				} else if (Container* container = item->getContainer()) {
+					for (Item* containerItem : container->getItemList()) {
+						transfer->items.push_back(containerItem);
 					}
 				}
 			}
 		}
 	}
 
-	DepotLocker* depotLocker = player->getDepotLocker(townId, true);
-	for (Item* item : moveItemList) {
-		g_game.internalMoveItem(item->getParent(), depotLocker, INDEX_WHEREEVER, item, item->getItemCount(), nullptr, FLAG_NOLIMIT);
+	// kept alive until their slice, whatever happens to them meanwhile
+	for (Item* item : transfer->items) {
+		item->incrementReferenceCounter();
 	}
 
+	transferred = true;
+	if (!transfer->items.empty()) {
+		depotTransfer = std::move(transfer);
+		g_dispatcher.addIdleJob([this]() {
+			return depotTransfer && transferDepotSlice(DEPOT_TRANSFER_SLICE_SIZE);
+		});
+	}
 	return true;
 }
 
+void House::finishDepotTransfer()
+{
+	if (depotTransfer) {
+		transferDepotSlice(std::numeric_limits<size_t>::max());
+	}
+}
+
+bool House::transferDepotSlice(size_t count)
+{
+	DepotTransfer& transfer = *depotTransfer;
+
+	Player* player = g_game.getPlayerByGUID(transfer.guid);
+	DepotLocker* depotLocker = player ? player->getDepotLocker(transfer.townId, true) : nullptr;
+	PropWriteStream inbox;
+
+	const size_t end = transfer.next + std::min(count, transfer.items.size() - transfer.next);
+	for (size_t i = transfer.next; i < end; ++i) {
+		Item* item = transfer.items[i];
+		const Tile* tile = item->getTile();
+		if (!tile || tile->getHouse() != this || item->getTopParent()->getCreature()) {
+			continue;
+		}
+
+		if (depotLocker) {
+			g_game.internalMoveItem(item->getParent(), depotLocker, INDEX_WHEREEVER, item, item->getItemCount(), nullptr, FLAG_NOLIMIT);
+		} else {
+			// removed right away, so an item moved into another queued container is written once
+			IOLoginData::serializePlayerInboxItem(inbox, transfer.townId, item);
+			g_game.internalRemoveItem(item);
+		}
+	}
+
+	size_t size;
+	inbox.getStream(size);
+	if (size != 0) {
+		IOLoginData::addPlayerInboxItems(transfer.guid, inbox);
+	}
+
+	for (size_t i = transfer.next; i < end; ++i) {
+		transfer.items[i]->decrementReferenceCounter();
+	}
+	transfer.next = end;
+
+	if (transfer.next != transfer.items.size()) {
+		return true;
+	}
+
+	depotTransfer.reset();
+	return false;
+}
+
 bool House::getAccessList(uint32_t listId, std::string& list) const
 {
 	if (listId == GUEST_LIST) {
@@ -313,6 +381,8 @@ void House::addDoor(Door* door)
 {
 	door->incrementReferenceCounter();
 	doorSet.insert(door);
+	doorsByNumber.emplace(door->getDoorId(), door);
+	doorsByPosition.emplace(packDoorPosition(door->getPosition()), door);
 	door->setHouse(this);
 	updateDoorDescription();
 }
@@ -323,6 +393,14 @@ void House::removeDoor(Door* door)
 	if (it != doorSet.end()) {
 		door->decrementReferenceCounter();
 		doorSet.erase(it);
+
+		// rebuilt from the remaining doors, the removed one may be off its tile already and another may share its number
+		doorsByNumber.clear();
+		doorsByPosition.clear();
+		for (Door* houseDoor : doorSet) {
+			doorsByNumber.emplace(houseDoor->getDoorId(), houseDoor);
+			doorsByPosition.emplace(packDoorPosition(houseDoor->getPosition()), houseDoor);
+		}
 	}
 }
 
@@ -348,22 +426,20 @@ void House::removeBed(BedItem* bed)
 
 Door* House::getDoorByNumber(uint32_t doorId) const
 {
-	for (Door* door : doorSet) {
-		if (door->getDoorId() == doorId) {
-			return door;
-		}
+	auto it = doorsByNumber.find(doorId);
+	if (it == doorsByNumber.end()) {
+		return nullptr;
 	}
-	return nullptr;
+	return it->second;
 }
 
 Door* House::getDoorByPosition(const Position& pos)
 {
-	for (Door* door : doorSet) {
-		if (door->getPosition() == pos) {
-			return door;
-		}
+	auto it = doorsByPosition.find(packDoorPosition(pos));
+	if (it == doorsByPosition.end()) {
+		return nullptr;
 	}
-	return nullptr;
+	return it->second;
 }
 
 bool House::canEditAccessList(uint32_t listId, const Player* player)
@@ -485,17 +561,22 @@ void AccessList::parseList(const std::string& value)
 			addPlayer(line);
 		}
 	}
+
+	std::sort(playerList.begin(), playerList.end());
+	playerList.erase(std::unique(playerList.begin(), playerList.end()), playerList.end());
+	std::sort(guildRankList.begin(), guildRankList.end());
+	guildRankList.erase(std::unique(guildRankList.begin(), guildRankList.end()), guildRankList.end());
 }
 
 void AccessList::addPlayer(const std::string& name)
 {
 	Player* player = g_game.getPlayerByName(name);
 	if (player) {
-		playerList.insert(player->getGUID());
+		playerList.push_back(player->getGUID());
 	} else {
 		uint32_t guid = IOLoginData::getGuidByName(name);
 		if (guid != 0) {
-			playerList.insert(guid);
+			playerList.push_back(guid);
 		}
 	}
 }
@@ -524,7 +605,7 @@ void AccessList::addGuild(const std::string& name)
 	const Guild* guild = getGuildByName(name);
 	if (guild) {
 		for (auto rank : guild->getRanks()) {
-			guildRankList.insert(rank->id);
+			guildRankList.push_back(rank->id);
 		}
 	}
 }
@@ -535,7 +616,7 @@ void AccessList::addGuildRank(const std::string& name, const std::string& rankNa
 	if (guild) {
 		GuildRank_ptr rank = guild->getRankByName(rankName);
 		if (rank) {
-			guildRankList.insert(rank->id);
+			guildRankList.push_back(rank->id);
 		}
 	}
 }
@@ -546,13 +627,12 @@ bool AccessList::isInList(const Player* player) const
 		return true;
 	}
 
-	auto playerIt = playerList.find(player->getGUID());
-	if (playerIt != playerList.end()) {
+	if (std::binary_search(playerList.begin(), playerList.end(), player->getGUID())) {
 		return true;
 	}
 
 	GuildRank_ptr rank = player->getGuildRank();
-	return rank && guildRankList.find(rank->id) != guildRankList.end();
+	return rank && std::binary_search(guildRankList.begin(), guildRankList.end(), rank->id);
 }
 
 void AccessList::getList(std::string& list) const
@@ -673,6 +753,149 @@ bool Houses::loadHousesXML(const std::string& filename)
 	return true;
 }
 
+namespace {
+
+uint32_t getHouseRent(const House* house)
+{
+	const int32_t housePrice = g_config.getNumber(ConfigManager::HOUSE_PRICE);
+	return (housePrice > -1) ? (housePrice * house->getTiles().size()) : house->getRent();
+}
+
+void extendPaidUntil(House* house, RentPeriod_t rentPeriod)
+{
+	time_t paidUntil = house->getPaidUntil();
+	switch (rentPeriod) {
+		case RENTPERIOD_DAILY:
+			paidUntil += 24 * 60 * 60;
+			break;
+		case RENTPERIOD_WEEKLY:
+			paidUntil += 24 * 60 * 60 * 7;
+			break;
+		case RENTPERIOD_MONTHLY:
+			paidUntil += 24 * 60 * 60 * 30;
+			break;
+		case RENTPERIOD_YEARLY:
+			paidUntil += 24 * 60 * 60 * 365;
+			break;
+		default:
+			break;
+	}
+
+	house->setPaidUntil(paidUntil);
+	house->setPayRentWarnings(0);
+}
+
+bool isEligibleToPayRent(const House* house, const PlayerLedger& ledger)
+{
+	if (g_config.getBoolean(ConfigManager::GUILHALLS_ONLYFOR_LEADERS) && house->isGuildHall() && ledger.guildRankLevel < 3) {
+		return false;
+	}
+
+	if (g_config.getBoolean(ConfigManager::HOUSES_ONLY_PREMIUM) && !g_config.getBoolean(ConfigManager::FREE_PREMIUM) && ledger.premiumEndsAt <= time(nullptr)) {
+		const Group* group = g_game.groups.getGroup(ledger.groupId);
+		if (!group || (group->flags & PlayerFlag_IsAlwaysPremium) == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// loads the whole owner, to pay from the depot or to send the warning letter and the house items to it
+void payHouseWithPlayer(House* house, RentPeriod_t rentPeriod)
+{
+	const uint32_t houseRent = getHouseRent(house);
+	const uint32_t ownerId = house->getOwner();
+	const uint32_t townId = house->getTownId();
+
+	Player player(nullptr);
+	if (!IOLoginData::loadPlayerByGUID(&player, ownerId)) {
+		// Player doesn't exist, reset house owner
+		house->setOwner(0);
+		return;
+	}
+
+	bool eligibleToPayRent = true;
+
+	if (g_config.getBoolean(ConfigManager::GUILHALLS_ONLYFOR_LEADERS) &&
+		(house->isGuildHall() && !player.getGuildRank() || 
+		house->isGuildHall() && player.getGuildRank()->level < 3)) {
+		eligibleToPayRent = false;
+	}
+
+	if (g_config.getBoolean(ConfigManager::HOUSES_ONLY_PREMIUM) && !player.isPremium()) {
+		eligibleToPayRent = false;
+	}
+
+	bool paidRent = false;
+
+	if (eligibleToPayRent) {
+		if (g_config.getBoolean(ConfigManager::HOUSES_BANKSYSTEM)) {
+			if (player.getBankBalance() >= houseRent) {
+				player.setBankBalance(player.getBankBalance() - houseRent);
+				paidRent = true;
+			}
+		}
+		else if (DepotLocker* const depotLocker = player.getDepotLocker(townId, true)) {
+			if (!depotLocker->getParent()) {
+				depotLocker->setParent(&player);
+			}
+
+			if (g_game.removeMoney(depotLocker, houseRent, FLAG_NOLIMIT)) {
+				paidRent = true;
+			}
+		}
+	}
+
+	if (paidRent) {
+		extendPaidUntil(house, rentPeriod);
+	} else {
+		if (house->getPayRentWarnings() < 7) {
+			int32_t daysLeft = 7 - house->getPayRentWarnings();
+
+			Item* letter = Item::CreateItem(ITEM_LETTER_STAMPED);
+			std::string period;
+
+			switch (rentPeriod) {
+			case RENTPERIOD_DAILY:
+				period = "daily";
+				break;
+
+			case RENTPERIOD_WEEKLY:
+				period = "weekly";
+				break;
+
+			case RENTPERIOD_MONTHLY:
+				period = "monthly";
+				break;
+
+			case RENTPERIOD_YEARLY:
+				period = "annual";
+				break;
+
+			default:
+				break;
+			}
+
+			letter->setText(fmt::format("Warning! \nThe {:s} rent of {:d} gold for your house \"{:s}\" is payable. Have it available within {:d} days, or you will lose this house.", period, houseRent, house->getName(), daysLeft));
+			player.getDepotLocker(townId, true)->addItem(letter);
+			house->setPayRentWarnings(house->getPayRentWarnings() + 1);
+		} else {
+			house->setOwner(0);
+		}
+	}
+
+	IOLoginData::savePlayer(&player);
+}
+
+}
+
+void Houses::finishDepotTransfers() const
+{
+	for (const auto& it : houseMap) {
+		it.second->finishDepotTransfer();
+	}
+}
+
 void Houses::payHouses(RentPeriod_t rentPeriod) const
 {
 	if (rentPeriod == RENTPERIOD_NEVER) {
@@ -680,121 +903,77 @@ void Houses::payHouses(RentPeriod_t rentPeriod) const
 	}
 
 	const time_t currentTime = time(nullptr);
+	std::vector<House*> dueHouses;
 	for (const auto& it : houseMap) {
 		House* house = it.second;
 		if (house->getOwner() == 0) {
 			continue;
 		}
 
-		const int32_t housePrice = g_config.getNumber(ConfigManager::HOUSE_PRICE);
-		const uint32_t houseRent = (housePrice > -1) ? (housePrice * house->getTiles().size()) : house->getRent();
+		const uint32_t houseRent = getHouseRent(house);
 		if (houseRent <= 0 || house->getPaidUntil() > currentTime) {
 			continue;
 		}
 
-		const uint32_t ownerId = house->getOwner();
-		const uint32_t townId = house->getTownId();
-		Town* town = g_game.map.towns.getTown(townId);
-		if (!town) {
-			continue;
-		}
-
-		Player player(nullptr);
-		if (!IOLoginData::loadPlayerByGUID(&player, ownerId)) {
-			// Player doesn't exist, reset house owner
-			house->setOwner(0);
+		if (!g_game.map.towns.getTown(house->getTownId())) {
 			continue;
 		}
 
-		bool eligibleToPayRent = true;
-
-		if (g_config.getBoolean(ConfigManager::GUILHALLS_ONLYFOR_LEADERS) &&
-			(house->isGuildHall() && !player.getGuildRank() || 
-			house->isGuildHall() && player.getGuildRank()->level < 3)) {
-			eligibleToPayRent = false;
-		}
+		dueHouses.push_back(house);
+	}
 
-		if (g_config.getBoolean(ConfigManager::HOUSES_ONLY_PREMIUM) && !player.isPremium()) {
-			eligibleToPayRent = false;
+	if (!g_config.getBoolean(ConfigManager::HOUSES_BANKSYSTEM)) {
+		for (House* house : dueHouses) {
+			payHouseWithPlayer(house, rentPeriod);
 		}
+		return;
+	}
 
-		bool paidRent = false;
+	// the rent comes out of the balance in the header of the owner's file, the owners of all due houses
+	// are read at once and only the ones that cannot pay are loaded whole
+	std::vector<uint32_t> ownerIds;
+	ownerIds.reserve(dueHouses.size());
+	for (House* house : dueHouses) {
+		ownerIds.push_back(house->getOwner());
+	}
+	std::sort(ownerIds.begin(), ownerIds.end());
+	ownerIds.erase(std::unique(ownerIds.begin(), ownerIds.end()), ownerIds.end());
 
-		if (eligibleToPayRent) {
-			if (g_config.getBoolean(ConfigManager::HOUSES_BANKSYSTEM)) {
-				if (player.getBankBalance() >= houseRent) {
-					player.setBankBalance(player.getBankBalance() - houseRent);
-					paidRent = true;
-				}
-			}
-			else if (DepotLocker* const depotLocker = player.getDepotLocker(townId, true)) {
-				if (!depotLocker->getParent()) {
-					depotLocker->setParent(&player);
-				}
+	std::vector<PlayerLedger> ledgers = IOLoginData::loadPlayerLedgers(ownerIds);
+	std::unordered_map<uint32_t, size_t> ledgerIndex;
+	for (size_t i = 0; i < ledgers.size(); ++i) {
+		ledgerIndex.emplace(ledgers[i].guid, i);
+	}
 
-				if (g_game.removeMoney(depotLocker, houseRent, FLAG_NOLIMIT)) {
-					paidRent = true;
-				}
-			}
+	std::vector<uint8_t> charged(ledgers.size());
+	std::vector<House*> unpaidHouses;
+	for (House* house : dueHouses) {
+		auto it = ledgerIndex.find(house->getOwner());
+		if (it == ledgerIndex.end()) {
+			unpaidHouses.push_back(house);
+			continue;
 		}
 
-		if (paidRent) {
-			time_t paidUntil = house->getPaidUntil();
-			switch (rentPeriod) {
-				case RENTPERIOD_DAILY:
-					paidUntil += 24 * 60 * 60;
-					break;
-				case RENTPERIOD_WEEKLY:
-					paidUntil += 24 * 60 * 60 * 7;
-					break;
-				case RENTPERIOD_MONTHLY:
-					paidUntil += 24 * 60 * 60 * 30;
-					break;
-				case RENTPERIOD_YEARLY:
-					paidUntil += 24 * 60 * 60 * 365;
-					break;
-				default:
-					break;
-			}
-
-			house->setPaidUntil(paidUntil);
-			house->setPayRentWarnings(0);
-		} else {
-			if (house->getPayRentWarnings() < 7) {
-				int32_t daysLeft = 7 - house->getPayRentWarnings();
-
-				Item* letter = Item::CreateItem(ITEM_LETTER_STAMPED);
-				std::string period;
-
-				switch (rentPeriod) {
-				case RENTPERIOD_DAILY:
-					period = "daily";
-					break;
-
-				case RENTPERIOD_WEEKLY:
-					period = "weekly";
-					break;
-
-				case RENTPERIOD_MONTHLY:
-					period = "monthly";
-					break;
-
-				case RENTPERIOD_YEARLY:
-					period = "annual";
-					break;
+		PlayerLedger& ledger = ledgers[it->second];
+		const uint32_t houseRent = getHouseRent(house);
+		if (!isEligibleToPayRent(house, ledger) || ledger.bankBalance < houseRent) {
+			unpaidHouses.push_back(house);
+			continue;
+		}
 
-				default:
-					break;
-				}
+		ledger.bankBalance -= houseRent;
+		charged[it->second] = true;
+		extendPaidUntil(house, rentPeriod);
+	}
 
-				letter->setText(fmt::format("Warning! \nThe {:s} rent of {:d} gold for your house \"{:s}\" is payable. Have it available within {:d} days, or you will lose this house.", period, houseRent, house->getName(), daysLeft));
-				player.getDepotLocker(townId, true)->addItem(letter);
-				house->setPayRentWarnings(house->getPayRentWarnings() + 1);
-			} else {
-				house->setOwner(0, true, &player);
-			}
+	for (size_t i = 0; i < ledgers.size(); ++i) {
+		if (charged[i]) {
+			IOLoginData::savePlayerLedger(ledgers[i]);
 		}
+	}
 
-		IOLoginData::savePlayer(&player);
+	// the full load waits for the ledger writes, so it sees the balance left after the paid houses
+	for (House* house : unpaidHouses) {
+		payHouseWithPlayer(house, rentPeriod);
 	}
 }
@@ -4,7 +4,6 @@
 #pragma once
 
 #include <set>
-#include <unordered_set>
 
 #include "container.h"
 #include "tile.h"
@@ -28,8 +27,9 @@ class AccessList
 
 	private:
 		std::string list;
-		std::unordered_set<uint32_t> playerList;
-		std::unordered_set<uint32_t> guildRankList;
+		// guids and guild rank ids, sorted once the list is parsed
+		std::vector<uint32_t> playerList;
+		std::vector<uint32_t> guildRankList;
 		bool allowEveryone = false;
 };
 
@@ -140,11 +140,15 @@ class House
 			return houseName;
 		}
 
-		void setOwner(uint32_t guid, bool updateDatabase = true, Player* player = nullptr);
+		void setOwner(uint32_t guid, bool updateDatabase = true);
 		uint32_t getOwner() const {
 			return owner;
 		}
 
+		const std::string& getOwnerName() const {
+			return ownerName;
+		}
+
 		uint32_t getOwnerAccountId() const {
 			return ownerAccountId;
 		}
@@ -213,6 +217,8 @@ class House
 
 		void clearDoors() {
 			doorSet.clear();
+			doorsByNumber.clear();
+			doorsByPosition.clear();
 		}
 		const std::set<Door*>& getDoors() const {
 			return doorSet;
@@ -227,9 +233,54 @@ class House
 			return static_cast<uint32_t>(std::ceil(bedsList.size() / 2.)); //each bed takes 2 sqms of space, ceil is just for bad maps
 		}
 
+		// set when an item on one of the house tiles is added, removed or changed
+		void setItemsChanged() {
+			itemsChanged = true;
+		}
+		// houses whose items are the ones written by the last save are skipped by IOMap::saveHouseItems
+		bool needsItemsSave() const {
+			return itemsChanged || volatileItems;
+		}
+		// returns false when the items are the same as the last time they were written
+		bool setItemsSaved(size_t hash, bool hasVolatileItems) {
+			itemsChanged = false;
+			volatileItems = hasVolatileItems;
+			if (hash == savedItemsHash) {
+				return false;
+			}
+
+			savedItemsHash = hash;
+			return true;
+		}
+
+		// queues the items of the house to go to the owner's depot, false if there is no owner to get them
 		bool transferToDepot();
+		// moves the items still queued at once, before a save
+		void finishDepotTransfer();
 	private:
-		bool transferToDepot(Player* player) const;
+		/*
+		 * The items a lost or sold house sends to the depot of its former owner in town townId. They
+		 * move a slice at a time while the dispatcher is idle: into the depot while the owner is
+		 * online, appended to the owner's inbox file otherwise, which the next login puts into the
+		 * depot. An item taken out of the house meanwhile stays where it was taken.
+		 */
+		struct DepotTransfer {
+			std::vector<Item*> items;
+			size_t next = 0;
+			uint32_t guid;
+			uint32_t townId;
+		};
+
+		static uint64_t packDoorPosition(const Position& pos) {
+			return (static_cast<uint64_t>(pos.x) << 24) | (static_cast<uint64_t>(pos.y) << 8) | pos.z;
+		}
+
+		// moves up to count items, false once every item is moved
+		bool transferDepotSlice(size_t count);
+
+		// which list the player is in, the cached answer of the player is good while it was given for
+		// the current accessVersion and the player has the same guild rank
+		AccessHouseLevel_t getListAccessLevel(const Player* player) const;
 
 		AccessList guestList;
 		AccessList subOwnerList;
@@ -238,16 +289,22 @@ class House
 
 		HouseTileList houseTiles;
 		std::set<Door*> doorSet;
+		// the doors of doorSet by number and by packed position, they do not move while in the house
+		std::unordered_map<uint32_t, Door*> doorsByNumber;
+		std::unordered_map<uint64_t, Door*> doorsByPosition;
 		HouseBedItemList bedsList;
 
 		std::string houseName;
 		std::string ownerName;
 
 		HouseTransferItem* transferItem = nullptr;
+		std::unique_ptr<DepotTransfer> depotTransfer;
 
 		time_t paidUntil = 0;
 
 		uint32_t id;
+		// unique over all houses, changes with the guest and subowner lists
+		uint32_t accessVersion;
 		uint32_t owner = 0;
 		uint32_t ownerAccountId = 0;
 		uint32_t rentWarnings = 0;
@@ -257,9 +314,14 @@ class House
 
 		Position posEntry = {};
 
+		size_t savedItemsHash = 0;
+
 		bool isLoaded = false;
 		bool guildHall = false;
 		bool transferred = false;
+		bool itemsChanged = true;
+		// containers and items with attributes can change without touching their tile
+		bool volatileItems = true;
 };
 
 using HouseMap = std::map<uint32_t, House*>;
@@ -310,6 +372,7 @@ class Houses
 		bool loadHousesXML(const std::string& filename);
 
 		void payHouses(RentPeriod_t rentPeriod) const;
+		void finishDepotTransfers() const;
 
 		const HouseMap& getHouses() const {
 			return houseMap;
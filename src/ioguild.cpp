@@ -16,8 +16,11 @@ Guild* IOGuild::loadGuild(uint32_t guildId)
 		Guild* guild = new Guild(guildId, result->getString("name"));
 
 		if ((result = db.storeQuery(fmt::format("SELECT `id`, `name`, `level` FROM `guild_ranks` WHERE `guild_id` = {:d}", guildId)))) {
+			const size_t idColumn = result->getColumnIndex("id");
+			const size_t nameColumn = result->getColumnIndex("name");
+			const size_t levelColumn = result->getColumnIndex("level");
 			do {
-				guild->addRank(result->getNumber<uint32_t>("id"), result->getString("name"), result->getNumber<uint16_t>("level"));
+				guild->addRank(result->getNumber<uint32_t>(idColumn), result->getString(nameColumn), result->getNumber<uint16_t>(levelColumn));
 			} while (result->next());
 		}
 		return guild;
@@ -25,6 +28,38 @@ Guild* IOGuild::loadGuild(uint32_t guildId)
 	return nullptr;
 }
 
+std::vector<Guild*> IOGuild::loadGuilds()
+{
+	std::vector<Guild*> guilds;
+	std::unordered_map<uint32_t, Guild*> guildsById;
+
+	Database& db = Database::getInstance();
+	DBResult_ptr result = db.storeQuery("SELECT `id`, `name` FROM `guilds`");
+	if (!result) {
+		return guilds;
+	}
+
+	do {
+		Guild* guild = new Guild(result->getNumber<uint32_t>("id"), result->getString("name"));
+		guilds.push_back(guild);
+		guildsById[guild->getId()] = guild;
+	} while (result->next());
+
+	if ((result = db.storeQuery("SELECT `id`, `guild_id`, `name`, `level` FROM `guild_ranks`"))) {
+		const size_t idColumn = result->getColumnIndex("id");
+		const size_t guildIdColumn = result->getColumnIndex("guild_id");
+		const size_t nameColumn = result->getColumnIndex("name");
+		const size_t levelColumn = result->getColumnIndex("level");
+		do {
+			auto it = guildsById.find(result->getNumber<uint32_t>(guildIdColumn));
+			if (it != guildsById.end()) {
+				it->second->addRank(result->getNumber<uint32_t>(idColumn), result->getString(nameColumn), result->getNumber<uint16_t>(levelColumn));
+			}
+		} while (result->next());
+	}
+	return guilds;
+}
+
 uint32_t IOGuild::getGuildIdByName(const std::string& name)
 {
 	Database& db = Database::getInstance();
@@ -10,6 +10,8 @@ class IOGuild
 {
 	public:
 		static Guild* loadGuild(uint32_t guildId);
+		// every guild with its ranks, in two queries
+		static std::vector<Guild*> loadGuilds();
 		static uint32_t getGuildIdByName(const std::string& name);
 		static void getWarList(uint32_t guildId, GuildWarVector& guildWarVector);
 };
@@ -8,11 +8,16 @@
 #include "game.h"
 #include "scriptwriter.h"
 
+#include <bit>
 #include <fmt/format.h>
 #include <fstream>
 #include <filesystem>
+#include <optional>
 
 #include "databasetasks.h"
+#include "filecompression.h"
+#include "filetasks.h"
+#include "jobpool.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
@@ -43,11 +48,297 @@ static std::map<slots_t, std::string> slotToString = {
 	{ CONST_SLOT_AMMO, "Ammo" },
 };
 
+namespace {
+
+// the logins and logouts not sent to players_online yet, the last one of each player wins; dispatcher thread
+std::map<uint32_t, bool> pendingOnlineStatus;
+
+// gamedata/players/<guid % 100>/<guid>.tvpb: magic, version and a list of sections (id, size, data)
+// unknown sections are skipped, so fields can be added without breaking older files
+constexpr uint32_t PLAYER_FILE_MAGIC = 0x42505654; // TVPB
+constexpr uint16_t PLAYER_FILE_VERSION = 1;
+
+enum PlayerFileSection_t : uint8_t {
+	PLAYERFILE_INFO = 1,
+	PLAYERFILE_SKILLS = 2,
+	PLAYERFILE_CONDITIONS = 3,
+	PLAYERFILE_SPELLS = 4,
+	PLAYERFILE_STORAGE = 5,
+	PLAYERFILE_STRING_STORAGE = 6,
+	PLAYERFILE_MURDERS = 7,
+	PLAYERFILE_VIP = 8,
+	PLAYERFILE_INVENTORY = 9,
+	PLAYERFILE_DEPOTS = 10,
+	// replaces PLAYERFILE_CONDITIONS, a type tag and the compact encoding of Condition::serialize
+	PLAYERFILE_COMPACT_CONDITIONS = 11,
+};
+
+void writePlayerFileSection(PropWriteStream& file, PlayerFileSection_t section, const PropWriteStream& data)
+{
+	size_t size;
+	const char* bytes = data.getStream(size);
+
+	file.write<uint8_t>(section);
+	file.write<uint32_t>(size);
+	file.writeBytes(bytes, size);
+}
+
+Item* readPlayerFileItem(PropStream& propStream)
+{
+	Item* item = Item::CreateItem(propStream);
+	if (!item) {
+		return nullptr;
+	}
+
+	if (!item->unserializeTVPFormat(propStream)) {
+		delete item;
+		return nullptr;
+	}
+	return item;
+}
+
+// the info section starts with the town, group, skull, sex, player killer end and bank balance
+constexpr size_t PLAYERFILE_INFO_GROUP_OFFSET = sizeof(uint32_t);
+constexpr size_t PLAYERFILE_INFO_BANK_BALANCE_OFFSET = sizeof(uint32_t) + sizeof(uint16_t) + 2 * sizeof(uint8_t) + sizeof(time_t);
+
+std::string getPlayerBinaryFilename(uint32_t guid)
+{
+	return fmt::format("gamedata/players/{:d}/{:d}.tvpb", guid % 100, guid);
+}
+
+// mail sent while the player was offline, town id and item per entry
+std::string getPlayerInboxFilename(uint32_t guid)
+{
+	return fmt::format("gamedata/players/{:d}/{:d}.inbox", guid % 100, guid);
+}
+
+/*
+ * The binary files of the players saved last, so a player who logs in again soon after does not read
+ * and copy the file again. An entry is used only while the file on disk has the time and size it got
+ * from that save, a file written or removed by anything else makes it stale. The oldest entries go
+ * once there are more than playerFileCacheSize. The file thread records the writes.
+ */
+class PlayerFileCache
+{
+	public:
+		// false when the cache is disabled
+		bool put(uint32_t guid, const std::shared_ptr<const std::string>& data) {
+			const size_t capacity = std::max<int32_t>(0, g_config.getNumber(ConfigManager::PLAYER_FILE_CACHE_SIZE));
+
+			std::lock_guard<std::mutex> lockClass(lock);
+			auto it = entries.find(guid);
+			if (it != entries.end()) {
+				lru.erase(it->second.lru);
+				entries.erase(it);
+			}
+
+			if (capacity == 0) {
+				return false;
+			}
+
+			while (entries.size() >= capacity) {
+				entries.erase(lru.back());
+				lru.pop_back();
+			}
+
+			lru.push_front(guid);
+			entries.emplace(guid, Entry{data, {}, 0, false, lru.begin()});
+			return true;
+		}
+
+		// data was written to filename, nothing happens when a newer save replaced it already
+		void written(uint32_t guid, const std::shared_ptr<const std::string>& data, const std::string& filename) {
+			std::error_code ec;
+			const auto writeTime = std::filesystem::last_write_time(filename, ec);
+			// compressed on the way, it differs from the size of data then
+			const uintmax_t fileSize = ec ? 0 : std::filesystem::file_size(filename, ec);
+
+			std::lock_guard<std::mutex> lockClass(lock);
+			auto it = entries.find(guid);
+			if (it == entries.end() || it->second.data != data) {
+				return;
+			}
+
+			if (ec) {
+				lru.erase(it->second.lru);
+				entries.erase(it);
+				return;
+			}
+
+			it->second.writeTime = writeTime;
+			it->second.fileSize = fileSize;
+			it->second.written = true;
+		}
+
+		// held while the server forks, so the copy never starts with the lock taken by another thread
+		std::unique_lock<std::mutex> hold() {
+			return std::unique_lock<std::mutex>(lock);
+		}
+
+		// the contents of filename if they are cached and the file did not change since
+		std::shared_ptr<const std::string> get(uint32_t guid, const std::string& filename) {
+			std::lock_guard<std::mutex> lockClass(lock);
+			auto it = entries.find(guid);
+			if (it == entries.end()) {
+				return nullptr;
+			}
+
+			Entry& entry = it->second;
+			std::error_code ec;
+			const auto writeTime = std::filesystem::last_write_time(filename, ec);
+			if (!entry.written || ec || writeTime != entry.writeTime || std::filesystem::file_size(filename, ec) != entry.fileSize || ec) {
+				lru.erase(entry.lru);
+				entries.erase(it);
+				return nullptr;
+			}
+
+			lru.splice(lru.begin(), lru, entry.lru);
+			return entry.data;
+		}
+
+	private:
+		struct Entry {
+			std::shared_ptr<const std::string> data;
+			std::filesystem::file_time_type writeTime;
+			uintmax_t fileSize;
+			bool written;
+			std::list<uint32_t>::iterator lru;
+		};
+
+		std::unordered_map<uint32_t, Entry> entries;
+		// most recently used first
+		std::list<uint32_t> lru;
+		std::mutex lock;
+};
+
+PlayerFileCache playerFileCache;
+
+// replaces the contents of a compressed file with what was compressed
+bool decompressPlayerFile(std::string& content)
+{
+	if (!filecompression::isCompressed(content.data(), content.size())) {
+		return true;
+	}
+
+	std::string decompressed;
+	if (!filecompression::decompress(content.data(), content.size(), decompressed)) {
+		return false;
+	}
+
+	content = std::move(decompressed);
+	return true;
+}
+
+// a forked save holds the file queue back until the dispatcher reaps it, so the dispatcher reaps it first
+void waitForPlayerFile(const std::string& filename)
+{
+	if (g_fileTasks.isFilePending(filename)) {
+		g_game.checkForkedSave(true);
+	}
+	g_fileTasks.waitForFile(filename);
+}
+
+bool readPlayerLedgerFile(PlayerLedger& ledger)
+{
+	const std::string filename = getPlayerBinaryFilename(ledger.guid);
+	g_fileTasks.waitForFile(filename);
+
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!decompressPlayerFile(content)) {
+		return false;
+	}
+
+	PropStream header;
+	header.init(content.data(), content.size());
+
+	uint32_t magic;
+	uint16_t version;
+	if (!header.read<uint32_t>(magic) || magic != PLAYER_FILE_MAGIC || !header.read<uint16_t>(version) || version > PLAYER_FILE_VERSION) {
+		return false;
+	}
+
+	// only the section headers are walked until the info section, items are not decoded
+	size_t offset = sizeof(magic) + sizeof(version);
+	while (offset < content.size()) {
+		uint8_t section;
+		uint32_t size;
+		header.init(content.data() + offset, content.size() - offset);
+		if (!header.read<uint8_t>(section) || !header.read<uint32_t>(size) || header.size() < size) {
+			return false;
+		}
+
+		offset += sizeof(section) + sizeof(size);
+		if (section == PLAYERFILE_INFO) {
+			if (size < PLAYERFILE_INFO_BANK_BALANCE_OFFSET + sizeof(ledger.bankBalance)) {
+				return false;
+			}
+
+			memcpy(&ledger.groupId, content.data() + offset + PLAYERFILE_INFO_GROUP_OFFSET, sizeof(ledger.groupId));
+			memcpy(&ledger.bankBalance, content.data() + offset + PLAYERFILE_INFO_BANK_BALANCE_OFFSET, sizeof(ledger.bankBalance));
+			ledger.bankBalanceOffset = offset + PLAYERFILE_INFO_BANK_BALANCE_OFFSET;
+			ledger.fileContent = std::move(content);
+			return true;
+		}
+		offset += size;
+	}
+	return false;
+}
+
+// accounts that logged in recently, so reconnecting clients do not query the database again
+struct CachedAccount {
+	Account account;
+	std::string passwordHash;
+	int64_t expiresAt = 0;
+};
+
+std::mutex accountCacheLock;
+std::unordered_map<uint32_t, CachedAccount> accountCache;
+size_t accountCachePruneSize = 1024;
+
+std::optional<CachedAccount> getCachedAccount(uint32_t accountId)
+{
+	std::lock_guard<std::mutex> lockClass(accountCacheLock);
+	auto it = accountCache.find(accountId);
+	if (it == accountCache.end()) {
+		return std::nullopt;
+	}
+
+	if (it->second.expiresAt <= OTSYS_TIME()) {
+		accountCache.erase(it);
+		return std::nullopt;
+	}
+	return it->second;
+}
+
+void cacheAccount(const Account& account, std::string passwordHash)
+{
+	const int64_t duration = g_config.getNumber(ConfigManager::ACCOUNT_CACHE_DURATION) * 1000;
+	if (duration <= 0) {
+		return;
+	}
+
+	const int64_t now = OTSYS_TIME();
+
+	std::lock_guard<std::mutex> lockClass(accountCacheLock);
+	if (accountCache.size() >= accountCachePruneSize) {
+		std::erase_if(accountCache, [now](const auto& it) { return it.second.expiresAt <= now; });
+		accountCachePruneSize = std::max<size_t>(1024, accountCache.size() * 2);
+	}
+	accountCache[account.id] = {account, std::move(passwordHash), now + duration};
+}
+
+}
+
 Account IOLoginData::loadAccount(uint32_t accno)
 {
 	Account account;
 
-	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `id`, `password`, `type`, `premium_ends_at` FROM `accounts` WHERE `id` = {:d}", accno));
+	DBResult_ptr result = Database::getInstance().storePreparedQuery("SELECT `id`, `password`, `type`, `premium_ends_at` FROM `accounts` WHERE `id` = ?", {accno});
 	if (!result) {
 		return account;
 	}
@@ -60,14 +351,23 @@ Account IOLoginData::loadAccount(uint32_t accno)
 
 bool IOLoginData::loginserverAuthentication(uint32_t accountNumber, const std::string& password, Account& account)
 {
+	std::string passwordHash = transformToSHA1(password);
+
+	// a wrong password goes to the database, it may have been changed since
+	auto cached = getCachedAccount(accountNumber);
+	if (cached && cached->passwordHash == passwordHash) {
+		account = std::move(cached->account);
+		return true;
+	}
+
 	Database& db = Database::getInstance();
 
-	DBResult_ptr result = db.storeQuery(fmt::format("SELECT `id`, `password`, `type`, `premium_ends_at` FROM `accounts` WHERE `id` = {:d}", accountNumber));
+	DBResult_ptr result = db.storePreparedQuery("SELECT `id`, `password`, `type`, `premium_ends_at` FROM `accounts` WHERE `id` = ?", {accountNumber});
 	if (!result) {
 		return false;
 	}
 
-	if (transformToSHA1(password) != result->getString("password")) {
+	if (passwordHash != result->getString("password")) {
 		return false;
 	}
 
@@ -75,20 +375,23 @@ bool IOLoginData::loginserverAuthentication(uint32_t accountNumber, const std::s
 	account.accountType = static_cast<AccountType_t>(result->getNumber<int32_t>("type"));
 	account.premiumEndsAt = result->getNumber<time_t>("premium_ends_at");
 
-	result = db.storeQuery(fmt::format("SELECT `name` FROM `players` WHERE `account_id` = {:d} AND `deletion` = 0 ORDER BY `name` ASC", account.id));
+	result = db.storePreparedQuery("SELECT `name` FROM `players` WHERE `account_id` = ? AND `deletion` = 0 ORDER BY `name` ASC", {account.id});
 	if (result) {
 		do {
 			account.characters.push_back(result->getString("name"));
 		} while (result->next());
 	}
+
+	cacheAccount(account, std::move(passwordHash));
 	return true;
 }
 
 uint32_t IOLoginData::gameworldAuthentication(uint32_t accountNumber, const std::string& password, std::string& characterName)
 {
-	Database& db = Database::getInstance();
-
-	DBResult_ptr result = db.storeQuery(fmt::format("SELECT `id`, `password` FROM `accounts` WHERE `id` = {:d}", accountNumber));
+	//any thread, the password and the owner of the character are always read from the database,
+	//the account cache of the login server may be up to accountCacheDuration old
+	DBResult_ptr result = Database::getInstance().storePreparedQuery("SELECT `a`.`id`, `a`.`password`, `p`.`name` FROM `accounts` AS `a` "
+		"INNER JOIN `players` AS `p` ON `p`.`account_id` = `a`.`id` AND `p`.`name` = ? AND `p`.`deletion` = 0 WHERE `a`.`id` = ?", {characterName, accountNumber});
 	if (!result) {
 		return 0;
 	}
@@ -97,15 +400,8 @@ uint32_t IOLoginData::gameworldAuthentication(uint32_t accountNumber, const std:
 		return 0;
 	}
 
-	uint32_t accountId = result->getNumber<uint32_t>("id");
-
-	result = db.storeQuery(fmt::format("SELECT `name` FROM `players` WHERE `name` = {:s} AND `account_id` = {:d} AND `deletion` = 0", db.escapeString(characterName), accountId));
-	if (!result) {
-		return 0;
-	}
-
 	characterName = result->getString("name");
-	return accountId;
+	return result->getNumber<uint32_t>("id");
 }
 
 uint32_t IOLoginData::getAccountIdByPlayerName(const std::string& playerName)
@@ -142,26 +438,66 @@ AccountType_t IOLoginData::getAccountType(uint32_t accountId)
 void IOLoginData::setAccountType(uint32_t accountId, AccountType_t accountType)
 {
 	Database::getInstance().executeQuery(fmt::format("UPDATE `accounts` SET `type` = {:d} WHERE `id` = {:d}", static_cast<uint16_t>(accountType), accountId));
+	invalidateAccountCache(accountId);
+}
+
+void IOLoginData::invalidateAccountCache(uint32_t accountId)
+{
+	std::lock_guard<std::mutex> lockClass(accountCacheLock);
+	accountCache.erase(accountId);
 }
 
+
 void IOLoginData::updateOnlineStatus(uint32_t guid, bool login)
 {
 	if (g_config.getBoolean(ConfigManager::ALLOW_CLONES)) {
 		return;
 	}
 
-	if (login) {
-		Database::getInstance().executeQuery(fmt::format("INSERT INTO `players_online` VALUES ({:d})", guid));
-	} else {
-		Database::getInstance().executeQuery(fmt::format("DELETE FROM `players_online` WHERE `player_id` = {:d}", guid));
+	pendingOnlineStatus[guid] = login;
+}
+
+void IOLoginData::flushOnlineStatus()
+{
+	if (pendingOnlineStatus.empty()) {
+		return;
+	}
+
+	const int64_t shardId = g_config.getNumber(ConfigManager::SHARD_ID);
+
+	std::string logins;
+	std::string logouts;
+	for (const auto& [guid, login] : pendingOnlineStatus) {
+		std::string& list = login ? logins : logouts;
+		if (!list.empty()) {
+			list += login ? "," : ", ";
+		}
+		list += login ? fmt::format("({:d}, {:d})", guid, shardId) : std::to_string(guid);
+	}
+	pendingOnlineStatus.clear();
+
+	// a player is in one list only, so the order of the two does not matter
+	if (!logouts.empty()) {
+		g_databaseTasks.addTask(fmt::format("DELETE FROM `players_online` WHERE `player_id` IN ({:s})", logouts));
+	}
+	if (!logins.empty()) {
+		g_databaseTasks.addTask(fmt::format("INSERT IGNORE INTO `players_online` (`player_id`, `shard_id`) VALUES {:s}", logins));
 	}
 }
 
+void IOLoginData::resetOnlineStatus()
+{
+	// the rows of a server that did not shut down cleanly, nobody is online at startup; the other
+	// shards sharing the database keep theirs
+	Database::getInstance().executeQuery(fmt::format("DELETE FROM `players_online` WHERE `shard_id` = {:d}", g_config.getNumber(ConfigManager::SHARD_ID)));
+	pendingOnlineStatus.clear();
+}
+
 bool IOLoginData::preloadPlayer(Player* player, const std::string& name)
 {
 	Database& db = Database::getInstance();
 
-	DBResult_ptr result = db.storeQuery(fmt::format("SELECT `p`.`id`, `p`.`sex`, `p`.`vocation`, `p`.`town_id`, `p`.`account_id`, `p`.`group_id`, `a`.`type`, `a`.`premium_ends_at` FROM `players` as `p` JOIN `accounts` as `a` ON `a`.`id` = `p`.`account_id` WHERE `p`.`name` = {:s} AND `p`.`deletion` = 0", db.escapeString(name)));
+	DBResult_ptr result = db.storePreparedQuery("SELECT `p`.`id`, `p`.`sex`, `p`.`vocation`, `p`.`town_id`, `p`.`account_id`, `p`.`group_id`, `a`.`type`, `a`.`premium_ends_at` FROM `players` as `p` JOIN `accounts` as `a` ON `a`.`id` = `p`.`account_id` WHERE `p`.`name` = ? AND `p`.`deletion` = 0", {name});
 	if (!result) {
 		return false;
 	}
@@ -205,39 +541,8 @@ bool IOLoginData::loadPlayerByName(Player* player, const std::string& name)
 	return loadPlayer(player, false);
 }
 
-bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
+bool IOLoginData::loadPlayerTextFile(Player* player, const std::string& filename)
 {
-	static const std::string basicMalePlayerFilename = "gamedata/players/male.dat";
-	static const std::string basicFemalePlayerFilename = "gamedata/players/female.dat";
-
-	// Find the players sub folder by modulus of player GUID and load
-	uint32_t modulus = player->getGUID() % 100;
-	const std::string foldername = fmt::format("gamedata/players/{:d}", modulus);
-	std::string filename = fmt::format("{}/{:d}.tvpp", foldername, player->getGUID());
-
-	std::ifstream fileTest(filename, std::ios::binary);
-	if (!fileTest.is_open()) {
-		if (!initializeScriptFile) {
-			return false;
-		}
-
-		if (player->getSex() == PLAYERSEX_FEMALE) {
-			filename = basicFemalePlayerFilename;
-			fileTest.open(basicFemalePlayerFilename, std::ios::binary);
-			if (!fileTest.is_open()) {
-				std::cout << "> ERROR: no female.dat file available." << std::endl;
-				return false;
-			}
-		} else {
-			filename = basicMalePlayerFilename;
-			fileTest.open(basicMalePlayerFilename, std::ios::binary);
-			if (!fileTest.is_open()) {
-				std::cout << "> ERROR: no male.dat file available." << std::endl;
-				return false;
-			}
-		}
-	}
-
 	ScriptReader script;
 	if (!script.loadScript(filename, false)) {
 		return false;
@@ -249,7 +554,7 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 			break;
 		}
 
-		std::string identifier = script.getIdentifier();
+		std::string identifier(script.getIdentifier());
 		script.readSymbol('=');
 
 		if (identifier == "id") {
@@ -375,7 +680,7 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 			while (script.canRead()) {
 				script.nextToken();
 				if (script.getToken() == TOKEN_STRING) {
-					player->learnedInstantSpellList.push_front(script.getString());
+					player->cold->learnedInstantSpellList.emplace_front(script.getString());
 				} else if (script.getSpecial() == ',') {
 					continue;
 				} else if (script.getSpecial() != '}') {
@@ -423,10 +728,10 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 				} else if (script.getSpecial() == ',') {
 					continue;
 				} else if (script.getSpecial() == '(') {
-					std::string storageValue = script.readString();
+					std::string storageValue(script.readString());
 					script.readSymbol(',');
-					std::string value = script.readString();
-					player->stringStorageMap[storageValue] = value;
+					std::string value(script.readString());
+					player->cold->stringStorageMap[storageValue] = value;
 					script.readSymbol(')');
 				} else {
 					script.error("quest-value expected");
@@ -439,7 +744,7 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 				script.nextToken();
 				if (script.getToken() == TOKEN_NUMBER) {
 					time_t timestamp = static_cast<time_t>(script.getNumber());
-					player->murderTimeStamps.push_back(timestamp);
+					player->cold->murderTimeStamps.push_back(timestamp);
 				} else if (script.getSpecial() == ',') {
 					continue;
 				} else if (script.getSpecial() == '}') {
@@ -455,7 +760,7 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 				script.nextToken();
 				if (script.getToken() == TOKEN_NUMBER) {
 					uint32_t vipID = script.getNumber();
-					player->VIPList.insert(vipID);
+					player->cold->VIPList.insert(vipID);
 				} else if (script.getSpecial() == ',') {
 					continue;
 				} else if (script.getSpecial() == ')') {
@@ -530,23 +835,481 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 		}
 	} // End script-data loading
 
-	std::vector<uint32_t> invalidVIPEntries;
-	for (const uint32_t& vip : player->VIPList) {
-		if (DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `name` FROM `players` WHERE `id` = {:d}", vip))) {
-			g_game.storePlayerName(vip, result->getString("name"));
-		} else {
-			// Player no longer exists
-			invalidVIPEntries.push_back(vip);
+	return true;
+}
+
+bool IOLoginData::loadPlayerBinaryFile(Player* player, const std::string& filename)
+{
+	const std::shared_ptr<const std::string> cached = playerFileCache.get(player->getGUID(), filename);
+	std::string fileContent;
+	if (!cached) {
+		std::ifstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			std::cout << "[Error - IOLoginData::loadPlayer] Cannot open " << filename << "." << std::endl;
+			return false;
+		}
+
+		fileContent.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		if (!decompressPlayerFile(fileContent)) {
+			std::cout << "[Error - IOLoginData::loadPlayer] Cannot decompress " << filename << "." << std::endl;
+			return false;
 		}
 	}
+	const std::string& content = cached ? *cached : fileContent;
+
+	PropStream header;
+	header.init(content.data(), content.size());
 
-	// Clean deleted players from the VIP list
-	for (const uint32_t& vip : invalidVIPEntries) {
-		player->VIPList.erase(vip);
+	uint32_t magic;
+	uint16_t version;
+	if (!header.read<uint32_t>(magic) || magic != PLAYER_FILE_MAGIC || !header.read<uint16_t>(version) || version > PLAYER_FILE_VERSION) {
+		std::cout << "[Error - IOLoginData::loadPlayer] " << filename << " is not a supported player file." << std::endl;
+		return false;
+	}
+
+	auto error = [&](const char* what) {
+		std::cout << "[Error - IOLoginData::loadPlayer] " << filename << ": " << what << "." << std::endl;
+		return false;
+	};
+
+	size_t offset = sizeof(magic) + sizeof(version);
+	while (offset < content.size()) {
+		uint8_t section;
+		uint32_t size;
+		header.init(content.data() + offset, content.size() - offset);
+		if (!header.read<uint8_t>(section) || !header.read<uint32_t>(size) || header.size() < size) {
+			return error("truncated section");
+		}
+
+		offset += sizeof(section) + sizeof(size);
+
+		PropStream propStream;
+		propStream.init(content.data() + offset, size);
+		offset += size;
+
+		switch (section) {
+			case PLAYERFILE_INFO: {
+				uint32_t townId, blessings, level, magLevel, capacity;
+				uint16_t groupId, vocationId;
+				uint8_t skull, sex;
+				Position position;
+				Outfit_t outfit;
+				if (!propStream.read<uint32_t>(townId) || !propStream.read<uint16_t>(groupId) || !propStream.read<uint8_t>(skull) ||
+					!propStream.read<uint8_t>(sex) || !propStream.read<time_t>(player->playerKillerEnd) || !propStream.read<uint64_t>(player->bankBalance) ||
+					!propStream.read<uint32_t>(blessings) || !propStream.read<time_t>(player->lastLoginSaved) || !propStream.read<time_t>(player->lastLogout) ||
+					!propStream.read<uint16_t>(position.x) || !propStream.read<uint16_t>(position.y) || !propStream.read<uint8_t>(position.z) ||
+					!propStream.read<uint16_t>(outfit.lookType) || !propStream.read<uint8_t>(outfit.lookHead) || !propStream.read<uint8_t>(outfit.lookBody) ||
+					!propStream.read<uint8_t>(outfit.lookLegs) || !propStream.read<uint8_t>(outfit.lookFeet) || !propStream.read<uint32_t>(level) ||
+					!propStream.read<uint64_t>(player->experience) || !propStream.read<int32_t>(player->health) || !propStream.read<int32_t>(player->healthMax) ||
+					!propStream.read<uint32_t>(player->mana) || !propStream.read<uint32_t>(player->manaMax) || !propStream.read<uint64_t>(player->manaSpent) ||
+					!propStream.read<uint32_t>(magLevel) || !propStream.read<uint8_t>(player->soul) || !propStream.read<uint32_t>(capacity) ||
+					!propStream.read<uint16_t>(vocationId) || !propStream.read<uint16_t>(player->staminaMinutes)) {
+					return error("truncated player info");
+				}
+
+				Town* town = g_game.map.towns.getTown(townId);
+				if (!town) {
+					return error("unknown town");
+				}
+
+				if (!player->town) {
+					// prioritize town obtained from the AAC/database
+					player->setTown(town);
+				}
+
+				Group* group = g_game.groups.getGroup(groupId);
+				if (!group) {
+					std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Group ID " << groupId << " which doesn't exist." << std::endl;
+					return false;
+				}
+
+				if (!player->group) {
+					// prioritize group obtained from the AAC/database
+					player->setGroup(group);
+				}
+
+				if (!player->setVocation(vocationId)) {
+					return error("invalid vocation ID");
+				}
+
+				player->setSkull(static_cast<Skulls_t>(skull));
+				player->setSex(static_cast<PlayerSex_t>(sex));
+				player->blessings = blessings;
+				player->position = position;
+				player->loginPosition = position;
+				player->defaultOutfit = outfit;
+				player->currentOutfit = outfit;
+				player->level = level;
+				player->magLevel = magLevel;
+				player->capacity = capacity;
+				player->updateBaseSpeed();
+
+				const auto expForLevel = Player::getExpForLevel(player->level);
+				if (player->experience < expForLevel || player->experience > Player::getExpForLevel(player->level + 1)) {
+					player->experience = expForLevel;
+				}
+				break;
+			}
+
+			case PLAYERFILE_SKILLS: {
+				uint8_t skills;
+				if (!propStream.read<uint8_t>(skills)) {
+					return error("truncated skills");
+				}
+
+				for (uint8_t i = 0; i < skills; i++) {
+					uint8_t skill;
+					uint16_t level;
+					uint64_t tries;
+					if (!propStream.read<uint8_t>(skill) || !propStream.read<uint16_t>(level) || !propStream.read<uint64_t>(tries)) {
+						return error("truncated skills");
+					}
+
+					if (skill > SKILL_LAST) {
+						continue;
+					}
+
+					player->skills[skill].level = level;
+					player->skills[skill].tries = tries;
+				}
+				break;
+			}
+
+			case PLAYERFILE_CONDITIONS:
+			case PLAYERFILE_COMPACT_CONDITIONS: {
+				const bool legacy = section == PLAYERFILE_CONDITIONS;
+
+				uint32_t conditions;
+				if (legacy) {
+					if (!propStream.read<uint32_t>(conditions)) {
+						return error("truncated conditions");
+					}
+				} else {
+					uint16_t compactConditions;
+					if (!propStream.read<uint16_t>(compactConditions)) {
+						return error("truncated conditions");
+					}
+					conditions = compactConditions;
+				}
+
+				for (uint32_t i = 0; i < conditions; i++) {
+					uint32_t type;
+					if (legacy) {
+						if (!propStream.read<uint32_t>(type)) {
+							return error("truncated conditions");
+						}
+					} else {
+						uint8_t tag;
+						if (!propStream.read<uint8_t>(tag)) {
+							return error("truncated conditions");
+						}
+						if (tag >= 32) {
+							return error("unknown condition");
+						}
+						type = static_cast<uint32_t>(1) << tag;
+					}
+
+					Condition* condition = Condition::createCondition(CONDITIONID_DEFAULT, static_cast<ConditionType_t>(type), 0);
+					if (!condition) {
+						return error("unknown condition");
+					}
+
+					if (!condition->unserialize(propStream, legacy)) {
+						delete condition;
+						return error("failed to load condition");
+					}
+
+					// never load in-fight condition
+					if (type == CONDITION_INFIGHT) {
+						delete condition;
+					} else {
+						player->storedConditionList.push_front(condition);
+					}
+				}
+				break;
+			}
+
+			case PLAYERFILE_SPELLS: {
+				uint32_t spells;
+				if (!propStream.read<uint32_t>(spells)) {
+					return error("truncated spells");
+				}
+
+				for (uint32_t i = 0; i < spells; i++) {
+					std::string spell;
+					if (!propStream.readString(spell)) {
+						return error("truncated spells");
+					}
+					player->cold->learnedInstantSpellList.push_back(std::move(spell));
+				}
+				break;
+			}
+
+			case PLAYERFILE_STORAGE: {
+				uint32_t values;
+				if (!propStream.read<uint32_t>(values)) {
+					return error("truncated quest values");
+				}
+
+				for (uint32_t i = 0; i < values; i++) {
+					uint32_t key;
+					int32_t value;
+					if (!propStream.read<uint32_t>(key) || !propStream.read<int32_t>(value)) {
+						return error("truncated quest values");
+					}
+					player->storageMap[key] = value;
+				}
+				break;
+			}
+
+			case PLAYERFILE_STRING_STORAGE: {
+				uint32_t values;
+				if (!propStream.read<uint32_t>(values)) {
+					return error("truncated string quest values");
+				}
+
+				for (uint32_t i = 0; i < values; i++) {
+					std::string key, value;
+					if (!propStream.readString(key) || !propStream.readString(value)) {
+						return error("truncated string quest values");
+					}
+					player->cold->stringStorageMap[key] = value;
+				}
+				break;
+			}
+
+			case PLAYERFILE_MURDERS: {
+				uint32_t murders;
+				if (!propStream.read<uint32_t>(murders)) {
+					return error("truncated murders");
+				}
+
+				for (uint32_t i = 0; i < murders; i++) {
+					time_t timestamp;
+					if (!propStream.read<time_t>(timestamp)) {
+						return error("truncated murders");
+					}
+					player->cold->murderTimeStamps.push_back(timestamp);
+				}
+				break;
+			}
+
+			case PLAYERFILE_VIP: {
+				uint32_t entries;
+				if (!propStream.read<uint32_t>(entries)) {
+					return error("truncated VIP list");
+				}
+
+				for (uint32_t i = 0; i < entries; i++) {
+					uint32_t vipID;
+					if (!propStream.read<uint32_t>(vipID)) {
+						return error("truncated VIP list");
+					}
+					player->cold->VIPList.insert(vipID);
+				}
+				break;
+			}
+
+			case PLAYERFILE_INVENTORY: {
+				uint8_t items;
+				if (!propStream.read<uint8_t>(items)) {
+					return error("truncated inventory");
+				}
+
+				for (uint8_t i = 0; i < items; i++) {
+					uint8_t slot;
+					if (!propStream.read<uint8_t>(slot) || slot < CONST_SLOT_FIRST || slot > CONST_SLOT_LAST) {
+						return error("invalid inventory slot");
+					}
+
+					Item* item = readPlayerFileItem(propStream);
+					if (!item) {
+						return error("could not create SLOT item");
+					}
+
+					player->internalAddThing(slot, item);
+					item->startDecaying();
+				}
+				break;
+			}
+
+			case PLAYERFILE_DEPOTS: {
+				// read the first time a depot is needed, see Player::loadDepots
+				player->cold->depotData.assign(content.data() + offset - size, size);
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+	return true;
+}
+
+bool IOLoginData::loadPlayerDepots(Player* player, const std::string& data)
+{
+	PropStream propStream;
+	propStream.init(data.data(), data.size());
+
+	auto error = [&](const char* what) {
+		std::cout << "[Error - IOLoginData::loadPlayerDepots] " << player->getName() << ": " << what << "." << std::endl;
+		return false;
+	};
+
+	uint32_t depots;
+	if (!propStream.read<uint32_t>(depots)) {
+		return error("truncated depots");
+	}
+
+	for (uint32_t i = 0; i < depots; i++) {
+		uint32_t depotId, items;
+		if (!propStream.read<uint32_t>(depotId) || !propStream.read<uint32_t>(items)) {
+			return error("truncated depots");
+		}
+
+		DepotLocker* depot = player->getDepotLocker(depotId, true);
+		for (uint32_t j = 0; j < items; j++) {
+			Item* item = readPlayerFileItem(propStream);
+			if (!item) {
+				return error("could not create depot item");
+			}
+			depot->internalAddThing(item);
+		}
+	}
+	return true;
+}
+
+void IOLoginData::loadPlayerInbox(Player* player)
+{
+	const std::string filename = getPlayerInboxFilename(player->getGUID());
+	waitForPlayerFile(filename);
+
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		return;
+	}
+
+	std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	PropStream propStream;
+	propStream.init(content.data(), content.size());
+
+	uint32_t townId;
+	while (propStream.read<uint32_t>(townId)) {
+		Item* item = readPlayerFileItem(propStream);
+		if (!item) {
+			std::cout << "[Error - IOLoginData::loadPlayerInbox] " << filename << ": could not create mail item." << std::endl;
+			break;
+		}
+		player->getDepotLocker(townId, true)->internalAddThing(item);
+	}
+
+	// removed once the depots holding the mail are saved
+	player->inboxLoaded = true;
+}
+
+void IOLoginData::addPlayerInboxItem(uint32_t guid, uint32_t townId, const Item* item)
+{
+	PropWriteStream propWriteStream;
+	serializePlayerInboxItem(propWriteStream, townId, item);
+	addPlayerInboxItems(guid, propWriteStream);
+}
+
+void IOLoginData::serializePlayerInboxItem(PropWriteStream& propWriteStream, uint32_t townId, const Item* item)
+{
+	propWriteStream.write<uint32_t>(townId);
+	item->serializeTVPFormat(propWriteStream);
+}
+
+void IOLoginData::addPlayerInboxItems(uint32_t guid, const PropWriteStream& propWriteStream)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(fmt::format("gamedata/players/{:d}", guid % 100), ec);
+
+	size_t size;
+	const char* data = propWriteStream.getStream(size);
+	g_fileTasks.writeFile(getPlayerInboxFilename(guid), std::string(data, size), true);
+}
+
+bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
+{
+	static const std::string basicMalePlayerFilename = "gamedata/players/male.dat";
+	static const std::string basicFemalePlayerFilename = "gamedata/players/female.dat";
+
+	// Find the players sub folder by modulus of player GUID and load
+	uint32_t modulus = player->getGUID() % 100;
+	const std::string foldername = fmt::format("gamedata/players/{:d}", modulus);
+	const std::string binaryFilename = fmt::format("{}/{:d}.tvpb", foldername, player->getGUID());
+	std::string filename = fmt::format("{}/{:d}.tvpp", foldername, player->getGUID());
+
+	//a save of this player may still be on its way to the disk
+	waitForPlayerFile(binaryFilename);
+	waitForPlayerFile(filename);
+
+	std::error_code ec;
+	if (std::filesystem::exists(binaryFilename, ec)) {
+		if (!loadPlayerBinaryFile(player, binaryFilename)) {
+			return false;
+		}
+	} else {
+		std::ifstream fileTest(filename, std::ios::binary);
+		if (!fileTest.is_open()) {
+			if (!initializeScriptFile) {
+				return false;
+			}
+
+			if (player->getSex() == PLAYERSEX_FEMALE) {
+				filename = basicFemalePlayerFilename;
+				fileTest.open(basicFemalePlayerFilename, std::ios::binary);
+				if (!fileTest.is_open()) {
+					std::cout << "> ERROR: no female.dat file available." << std::endl;
+					return false;
+				}
+			} else {
+				filename = basicMalePlayerFilename;
+				fileTest.open(basicMalePlayerFilename, std::ios::binary);
+				if (!fileTest.is_open()) {
+					std::cout << "> ERROR: no male.dat file available." << std::endl;
+					return false;
+				}
+			}
+		}
+
+		if (!loadPlayerTextFile(player, filename)) {
+			return false;
+		}
+	}
+
+	loadPlayerInbox(player);
+
+	if (!player->cold->VIPList.empty()) {
+		// the names of the whole list in one query
+		std::string vipIds;
+		for (uint32_t vip : player->cold->VIPList) {
+			if (!vipIds.empty()) {
+				vipIds.push_back(',');
+			}
+			vipIds += std::to_string(vip);
+		}
+
+		std::unordered_set<uint32_t> existingVIPEntries;
+		if (DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `id`, `name` FROM `players` WHERE `id` IN ({:s})", vipIds))) {
+			do {
+				const uint32_t vip = result->getNumber<uint32_t>("id");
+				g_game.storePlayerName(vip, result->getString("name"));
+				existingVIPEntries.insert(vip);
+			} while (result->next());
+		}
+
+		// Clean deleted players from the VIP list
+		std::erase_if(player->cold->VIPList, [&](uint32_t vip) { return existingVIPEntries.count(vip) == 0; });
 	}
 
 	Database& db = Database::getInstance();
-	if (DBResult_ptr result = db.storeQuery(fmt::format("SELECT `guild_id`, `rank_id`, `nick` FROM `guild_membership` WHERE `player_id` = {:d}", player->getGUID()))) {
+	// membership is edited outside of the server, so it is read on login, with the rank and member count in the same round trip
+	if (DBResult_ptr result = db.storeQuery(fmt::format("SELECT `gm`.`guild_id`, `gm`.`rank_id`, `gm`.`nick`, `gr`.`id` AS `rank_found`, `gr`.`name` AS `rank_name`, `gr`.`level` AS `rank_level`, "
+		"(SELECT COUNT(*) FROM `guild_membership` WHERE `guild_id` = `gm`.`guild_id`) AS `members` "
+		"FROM `guild_membership` AS `gm` LEFT JOIN `guild_ranks` AS `gr` ON `gr`.`id` = `gm`.`rank_id` WHERE `gm`.`player_id` = {:d}", player->getGUID()))) {
 		uint32_t guildId = result->getNumber<uint32_t>("guild_id");
 		uint32_t playerRankId = result->getNumber<uint32_t>("rank_id");
 		player->guildNick = result->getString("nick");
@@ -565,8 +1328,9 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 			player->guild = guild;
 			GuildRank_ptr rank = guild->getRankById(playerRankId);
 			if (!rank) {
-				if ((result = db.storeQuery(fmt::format("SELECT `id`, `name`, `level` FROM `guild_ranks` WHERE `id` = {:d}", playerRankId)))) {
-					guild->addRank(result->getNumber<uint32_t>("id"), result->getString("name"), result->getNumber<uint16_t>("level"));
+				// created after the guild was cached
+				if (result->getNumber<uint32_t>("rank_found") != 0) {
+					guild->addRank(playerRankId, result->getString("rank_name"), result->getNumber<uint16_t>("rank_level"));
 				}
 
 				rank = guild->getRankById(playerRankId);
@@ -577,11 +1341,9 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 
 			player->guildRank = rank;
 
-			IOGuild::getWarList(guildId, player->guildWarVector);
+			guild->setMemberCount(result->getNumber<uint32_t>("members"));
 
-			if ((result = db.storeQuery(fmt::format("SELECT COUNT(*) AS `members` FROM `guild_membership` WHERE `guild_id` = {:d}", guildId)))) {
-				guild->setMemberCount(result->getNumber<uint32_t>("members"));
-			}
+			IOGuild::getWarList(guildId, player->cold->guildWarVector);
 		}
 	}
 
@@ -623,59 +1385,57 @@ bool IOLoginData::loadPlayer(Player* player, bool initializeScriptFile)
 	return true;
 }
 
-bool IOLoginData::savePlayer(Player* player)
+bool IOLoginData::savePlayerTextFile(Player* player, const std::string& filename)
 {
-	uint32_t modulus = player->getGUID() % 100;
-	const std::string foldername = fmt::format("gamedata/players/{:d}", modulus);
-	const std::string filename = fmt::format("{}/{:d}.tvpp", foldername, player->getGUID());
-
-	//Create the required sub folder for us
-	if (!std::filesystem::exists(foldername) && !std::filesystem::create_directories(foldername)) {
-		std::cout << "> ERROR - [IOLoginData::savePlayer]: Cannot create " << foldername << "." << std::endl;
+	ScriptWriter script;
+	player->loadDepots();
+	if (player->cold->depotsUnsaveable) {
+		// the unread depots section can only go back into a binary file
+		std::cout << "[Error - IOLoginData::savePlayerTextFile] " << player->getName() << ": depots could not be loaded, not saving." << std::endl;
+		return false;
 	}
 
-	ScriptWriter script;
 	if (!script.open(filename)) {
 		return false;
 	}
 
 	script.writeLine("# The Violet Project");
-	script.writeLine(fmt::format("# {:s}: player data file", player->getName()));
+	script.writeLineFormatted("# {:s}: player data file", player->getName());
 	script.writeLine();
-	script.writeLine(fmt::format("ID = {:d}", player->getGUID()));
-	script.writeLine(fmt::format("Name = \"{:s}\"", player->getName()));
-	script.writeLine(fmt::format("Town = {:d}", player->getTown()->getID()));
-	script.writeLine(fmt::format("Group = {:d}", player->group->id));
-	script.writeLine(fmt::format("Skull = {:d}", static_cast<int32_t>(player->getSkull())));
-	script.writeLine(fmt::format("Sex = {:d}", static_cast<int32_t>(player->getSex())));
-	script.writeLine(fmt::format("PlayerKillerEnd = {:d}", player->playerKillerEnd));
-	script.writeLine(fmt::format("BankBalance = {:d}", player->bankBalance));
-	script.writeLine(fmt::format("Blessings = {:d}", player->blessings.to_ulong()));
-	script.writeLine(fmt::format("LastLoginSaved = {:d}", player->lastLoginSaved));
-	script.writeLine(fmt::format("LastLogout = {:d}", player->lastLogout));
-	script.writeLine(fmt::format("Position = [{:d},{:d},{:d}]", player->loginPosition.x, player->loginPosition.y, static_cast<int32_t>(player->loginPosition.z)));
-	script.writeLine(fmt::format("DefaultOutfit = ({:d}, {:d}-{:d}-{:d}-{:d})", player->getDefaultOutfit().lookType, player->getDefaultOutfit().lookHead, player->getDefaultOutfit().lookBody, player->getDefaultOutfit().lookLegs, player->getDefaultOutfit().lookFeet));
+	script.writeLineFormatted("ID = {:d}", player->getGUID());
+	script.writeLineFormatted("Name = \"{:s}\"", player->getName());
+	script.writeLineFormatted("Town = {:d}", player->getTown()->getID());
+	script.writeLineFormatted("Group = {:d}", player->group->id);
+	script.writeLineFormatted("Skull = {:d}", static_cast<int32_t>(player->getSkull()));
+	script.writeLineFormatted("Sex = {:d}", static_cast<int32_t>(player->getSex()));
+	script.writeLineFormatted("PlayerKillerEnd = {:d}", player->playerKillerEnd);
+	script.writeLineFormatted("BankBalance = {:d}", player->bankBalance);
+	script.writeLineFormatted("Blessings = {:d}", player->blessings.to_ulong());
+	script.writeLineFormatted("LastLoginSaved = {:d}", player->lastLoginSaved);
+	script.writeLineFormatted("LastLogout = {:d}", player->lastLogout);
+	script.writeLineFormatted("Position = [{:d},{:d},{:d}]", player->loginPosition.x, player->loginPosition.y, static_cast<int32_t>(player->loginPosition.z));
+	script.writeLineFormatted("DefaultOutfit = ({:d}, {:d}-{:d}-{:d}-{:d})", player->getDefaultOutfit().lookType, player->getDefaultOutfit().lookHead, player->getDefaultOutfit().lookBody, player->getDefaultOutfit().lookLegs, player->getDefaultOutfit().lookFeet);
 	script.writeLine();
-	script.writeLine(fmt::format("Level = {:d}", player->level));
-	script.writeLine(fmt::format("Experience = {:d}", player->experience));
-	script.writeLine(fmt::format("Health = {:d}", player->health));
-	script.writeLine(fmt::format("MaxHealth = {:d}", player->healthMax));
-	script.writeLine(fmt::format("Mana = {:d}", player->mana));
-	script.writeLine(fmt::format("MaxMana = {:d}", player->manaMax));
-	script.writeLine(fmt::format("ManaSpent = {:d}", player->manaSpent));
-	script.writeLine(fmt::format("MagicLevel = {:d}", player->magLevel));
-	script.writeLine(fmt::format("Soul = {:d}", player->soul));
-	script.writeLine(fmt::format("Capacity = {:d}", player->capacity));
-	script.writeLine(fmt::format("Vocation = {:d}", player->vocation->getId()));
-	script.writeLine(fmt::format("Stamina = {:d}", player->staminaMinutes));
+	script.writeLineFormatted("Level = {:d}", player->level);
+	script.writeLineFormatted("Experience = {:d}", player->experience);
+	script.writeLineFormatted("Health = {:d}", player->health);
+	script.writeLineFormatted("MaxHealth = {:d}", player->healthMax);
+	script.writeLineFormatted("Mana = {:d}", player->mana);
+	script.writeLineFormatted("MaxMana = {:d}", player->manaMax);
+	script.writeLineFormatted("ManaSpent = {:d}", player->manaSpent);
+	script.writeLineFormatted("MagicLevel = {:d}", player->magLevel);
+	script.writeLineFormatted("Soul = {:d}", player->soul);
+	script.writeLineFormatted("Capacity = {:d}", player->capacity);
+	script.writeLineFormatted("Vocation = {:d}", player->vocation->getId());
+	script.writeLineFormatted("Stamina = {:d}", player->staminaMinutes);
 	script.writeLine();
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_FIST), player->skills[SKILL_FIST].level, player->skills[SKILL_FIST].tries));
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_SWORD), player->skills[SKILL_SWORD].level, player->skills[SKILL_SWORD].tries));
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_CLUB), player->skills[SKILL_CLUB].level, player->skills[SKILL_CLUB].tries));
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_AXE), player->skills[SKILL_AXE].level, player->skills[SKILL_AXE].tries));
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_DISTANCE), player->skills[SKILL_DISTANCE].level, player->skills[SKILL_DISTANCE].tries));
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_SHIELD), player->skills[SKILL_SHIELD].level, player->skills[SKILL_SHIELD].tries));
-	script.writeLine(fmt::format("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_FISHING), player->skills[SKILL_FISHING].level, player->skills[SKILL_FISHING].tries));
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_FIST), player->skills[SKILL_FIST].level, player->skills[SKILL_FIST].tries);
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_SWORD), player->skills[SKILL_SWORD].level, player->skills[SKILL_SWORD].tries);
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_CLUB), player->skills[SKILL_CLUB].level, player->skills[SKILL_CLUB].tries);
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_AXE), player->skills[SKILL_AXE].level, player->skills[SKILL_AXE].tries);
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_DISTANCE), player->skills[SKILL_DISTANCE].level, player->skills[SKILL_DISTANCE].tries);
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_SHIELD), player->skills[SKILL_SHIELD].level, player->skills[SKILL_SHIELD].tries);
+	script.writeLineFormatted("Skill = ({:d}, {:d}, {:d})", static_cast<int32_t>(SKILL_FISHING), player->skills[SKILL_FISHING].level, player->skills[SKILL_FISHING].tries);
 	script.writeLine();
 	for (Condition* condition : player->conditions) {
 		condition->serializeTVPFormat(script);
@@ -692,9 +1452,9 @@ bool IOLoginData::savePlayer(Player* player)
 	}
 	script.writeText("Spells = {");
 	int32_t i = 0;
-	for (auto it = player->learnedInstantSpellList.begin(); it != player->learnedInstantSpellList.end(); ++it) {
+	for (auto it = player->cold->learnedInstantSpellList.begin(); it != player->cold->learnedInstantSpellList.end(); ++it) {
 		script.writeString(*it);
-		if (i < player->learnedInstantSpellList.size() - 1) {
+		if (i < player->cold->learnedInstantSpellList.size() - 1) {
 			script.writeText(",");
 		}
 		i++;
@@ -705,7 +1465,7 @@ bool IOLoginData::savePlayer(Player* player)
 	script.writeText("QuestValues = {");
 	i = 0;
 	for (auto it = player->storageMap.begin(); it != player->storageMap.end(); ++it) {
-		script.writeText(fmt::format("({:d},{:d})", it->first, it->second));
+		script.writeFormatted("({:d},{:d})", it->first, it->second);
 		if (i < player->storageMap.size() - 1) {
 			script.writeText(",");
 		}
@@ -716,8 +1476,8 @@ bool IOLoginData::savePlayer(Player* player)
 	script.writeLine();
 	script.writeText("StringQuestValues = {");
 	i = 0;
-	for (auto it = player->stringStorageMap.begin(); it != player->stringStorageMap.end(); ++it) {
-		script.writeText(fmt::format("(\"{:s}\",\"{:s}\")", it->first, it->second));
+	for (auto it = player->cold->stringStorageMap.begin(); it != player->cold->stringStorageMap.end(); ++it) {
+		script.writeFormatted("(\"{:s}\",\"{:s}\")", it->first, it->second);
 		if (i < player->storageMap.size() - 1) {
 			script.writeText(",");
 		}
@@ -728,9 +1488,9 @@ bool IOLoginData::savePlayer(Player* player)
 	script.writeLine();
 	script.writeText("Murders = {");
 	i = 0;
-	for (auto it = player->murderTimeStamps.begin(); it != player->murderTimeStamps.end(); ++it) {
-		script.writeText(fmt::format("{:d}", *it));
-		if (i < player->murderTimeStamps.size() - 1) {
+	for (auto it = player->cold->murderTimeStamps.begin(); it != player->cold->murderTimeStamps.end(); ++it) {
+		script.writeFormatted("{:d}", *it);
+		if (i < player->cold->murderTimeStamps.size() - 1) {
 			script.writeText(",");
 		}
 		i++;
@@ -740,9 +1500,9 @@ bool IOLoginData::savePlayer(Player* player)
 	script.writeLine();
 	script.writeText("VIP = (");
 	i = 0;
-	for (auto it = player->VIPList.begin(); it != player->VIPList.end(); ++it) {
-		script.writeText(fmt::format("{:d}", *it));
-		if (i < player->VIPList.size() - 1) {
+	for (auto it = player->cold->VIPList.begin(); it != player->cold->VIPList.end(); ++it) {
+		script.writeFormatted("{:d}", *it);
+		if (i < player->cold->VIPList.size() - 1) {
 			script.writeText(",");
 		}
 		i++;
@@ -758,14 +1518,14 @@ bool IOLoginData::savePlayer(Player* player)
 
 		const std::string_view& str = slotToString.find(static_cast<slots_t>(slot))->second;
 
-		script.writeText(fmt::format("{:s} = (", str));
+		script.writeFormatted("{:s} = (", str);
 		item->serializeTVPFormat(script);
 		script.writeText(")");
 		script.writeLine();
 	}
 	script.writeLine();
 	script.writeLine();
-	for (const auto& it : player->depotLockerMap) {
+	for (const auto& it : player->cold->depotLockerMap) {
 		script.writeText("Depot = (");
 		script.writeNumber(it.first);
 		script.writeText(", {");
@@ -783,9 +1543,228 @@ bool IOLoginData::savePlayer(Player* player)
 		script.writeLine();
 	}
 	script.close();
+	return true;
+}
+
+bool IOLoginData::savePlayerBinaryFile(Player* player, const std::string& filename)
+{
+	PropWriteStream file;
+	file.write<uint32_t>(PLAYER_FILE_MAGIC);
+	file.write<uint16_t>(PLAYER_FILE_VERSION);
+
+	PropWriteStream info;
+	info.write<uint32_t>(player->getTown()->getID());
+	info.write<uint16_t>(player->group->id);
+	info.write<uint8_t>(player->getSkull());
+	info.write<uint8_t>(player->getSex());
+	info.write<time_t>(player->playerKillerEnd);
+	info.write<uint64_t>(player->bankBalance);
+	info.write<uint32_t>(player->blessings.to_ulong());
+	info.write<time_t>(player->lastLoginSaved);
+	info.write<time_t>(player->lastLogout);
+	info.write<uint16_t>(player->loginPosition.x);
+	info.write<uint16_t>(player->loginPosition.y);
+	info.write<uint8_t>(player->loginPosition.z);
+	info.write<uint16_t>(player->getDefaultOutfit().lookType);
+	info.write<uint8_t>(player->getDefaultOutfit().lookHead);
+	info.write<uint8_t>(player->getDefaultOutfit().lookBody);
+	info.write<uint8_t>(player->getDefaultOutfit().lookLegs);
+	info.write<uint8_t>(player->getDefaultOutfit().lookFeet);
+	info.write<uint32_t>(player->level);
+	info.write<uint64_t>(player->experience);
+	info.write<int32_t>(player->health);
+	info.write<int32_t>(player->healthMax);
+	info.write<uint32_t>(player->mana);
+	info.write<uint32_t>(player->manaMax);
+	info.write<uint64_t>(player->manaSpent);
+	info.write<uint32_t>(player->magLevel);
+	info.write<uint8_t>(player->soul);
+	info.write<uint32_t>(player->capacity);
+	info.write<uint16_t>(player->vocation->getId());
+	info.write<uint16_t>(player->staminaMinutes);
+	writePlayerFileSection(file, PLAYERFILE_INFO, info);
+
+	PropWriteStream skills;
+	skills.write<uint8_t>(SKILL_LAST + 1);
+	for (uint8_t skill = SKILL_FIRST; skill <= SKILL_LAST; skill++) {
+		skills.write<uint8_t>(skill);
+		skills.write<uint16_t>(player->skills[skill].level);
+		skills.write<uint64_t>(player->skills[skill].tries);
+	}
+	writePlayerFileSection(file, PLAYERFILE_SKILLS, skills);
+
+	PropWriteStream conditions;
+	conditions.write<uint16_t>(player->conditions.size() + std::distance(player->storedConditionList.begin(), player->storedConditionList.end()));
+	for (Condition* condition : player->conditions) {
+		conditions.write<uint8_t>(std::countr_zero(static_cast<uint32_t>(condition->getType())));
+		condition->serialize(conditions);
+	}
+	for (Condition* condition : player->storedConditionList) {
+		conditions.write<uint8_t>(std::countr_zero(static_cast<uint32_t>(condition->getType())));
+		condition->serialize(conditions);
+	}
+	writePlayerFileSection(file, PLAYERFILE_COMPACT_CONDITIONS, conditions);
+
+	PropWriteStream spells;
+	spells.write<uint32_t>(player->cold->learnedInstantSpellList.size());
+	for (const std::string& spell : player->cold->learnedInstantSpellList) {
+		spells.writeString(spell);
+	}
+	writePlayerFileSection(file, PLAYERFILE_SPELLS, spells);
+
+	PropWriteStream storage;
+	storage.write<uint32_t>(player->storageMap.size());
+	for (const auto& it : player->storageMap) {
+		storage.write<uint32_t>(it.first);
+		storage.write<int32_t>(it.second);
+	}
+	writePlayerFileSection(file, PLAYERFILE_STORAGE, storage);
+
+	PropWriteStream stringStorage;
+	stringStorage.write<uint32_t>(player->cold->stringStorageMap.size());
+	for (const auto& it : player->cold->stringStorageMap) {
+		stringStorage.writeString(it.first);
+		stringStorage.writeString(it.second);
+	}
+	writePlayerFileSection(file, PLAYERFILE_STRING_STORAGE, stringStorage);
+
+	PropWriteStream murders;
+	murders.write<uint32_t>(player->cold->murderTimeStamps.size());
+	for (time_t timestamp : player->cold->murderTimeStamps) {
+		murders.write<time_t>(timestamp);
+	}
+	writePlayerFileSection(file, PLAYERFILE_MURDERS, murders);
+
+	PropWriteStream vip;
+	vip.write<uint32_t>(player->cold->VIPList.size());
+	for (uint32_t vipID : player->cold->VIPList) {
+		vip.write<uint32_t>(vipID);
+	}
+	writePlayerFileSection(file, PLAYERFILE_VIP, vip);
+
+	PropWriteStream inventory;
+	inventory.write<uint8_t>(std::count_if(std::begin(player->inventory), std::end(player->inventory), [](const Item* item) { return item != nullptr; }));
+	for (int32_t slot = CONST_SLOT_FIRST; slot <= CONST_SLOT_LAST; slot++) {
+		if (const Item* item = player->inventory[slot]) {
+			inventory.write<uint8_t>(slot);
+			item->serializeTVPFormat(inventory);
+		}
+	}
+	writePlayerFileSection(file, PLAYERFILE_INVENTORY, inventory);
+
+	PropWriteStream depots;
+	if (!player->cold->depotData.empty()) {
+		// no depot was needed this session or it could not be read, the section goes back as it was read
+		depots.writeBytes(player->cold->depotData.data(), player->cold->depotData.size());
+	} else {
+		depots.write<uint32_t>(player->cold->depotLockerMap.size());
+		for (const auto& it : player->cold->depotLockerMap) {
+			depots.write<uint32_t>(it.first);
+
+			const ItemDeque& items = it.second->getItemList();
+			depots.write<uint32_t>(items.size());
+			for (auto item = items.rbegin(); item != items.rend(); ++item) {
+				(*item)->serializeTVPFormat(depots);
+			}
+		}
+	}
+	writePlayerFileSection(file, PLAYERFILE_DEPOTS, depots);
+
+	size_t size;
+	const char* data = file.getStream(size);
+
+	const uint32_t guid = player->getGUID();
+	auto cached = std::make_shared<const std::string>(data, size);
+	if (playerFileCache.put(guid, cached)) {
+		g_fileTasks.writeFile(filename, std::string(data, size), false, [guid, cached, filename](bool success) {
+			if (success) {
+				playerFileCache.written(guid, cached, filename);
+			}
+		});
+	} else {
+		g_fileTasks.writeFile(filename, std::string(data, size));
+	}
+	return true;
+}
+
+bool IOLoginData::exportPlayerTextFile(Player* player)
+{
+	const std::string foldername = fmt::format("gamedata/players/{:d}", player->getGUID() % 100);
+
+	std::error_code ec;
+	std::filesystem::create_directories(foldername, ec);
+	return savePlayerTextFile(player, fmt::format("{}/{:d}.export.tvpp", foldername, player->getGUID()));
+}
+
+std::unique_lock<std::mutex> IOLoginData::lockPlayerFileCache()
+{
+	return playerFileCache.hold();
+}
+
+bool IOLoginData::savePlayer(Player* player)
+{
+	if (!savePlayerFile(player)) {
+		return false;
+	}
+
+	savePlayerDatabase(player);
+	return true;
+}
+
+void IOLoginData::savePlayers(const std::vector<Player*>& players)
+{
+	// the dispatcher waits for the workers, so the players stay as they are while their files are encoded
+	std::vector<uint8_t> saved(players.size());
+	g_jobPool.parallelFor(players.size(), [&](size_t i) {
+		saved[i] = savePlayerFile(players[i]);
+	}, g_config.getNumber(ConfigManager::SAVE_THREADS));
+
+	// queries stay on the dispatcher, in the same order as before
+	for (size_t i = 0; i < players.size(); ++i) {
+		if (saved[i]) {
+			savePlayerDatabase(players[i]);
+		}
+	}
+}
+
+bool IOLoginData::savePlayerFile(Player* player)
+{
+	uint32_t modulus = player->getGUID() % 100;
+	const std::string foldername = fmt::format("gamedata/players/{:d}", modulus);
+	const std::string filename = fmt::format("{}/{:d}.tvpp", foldername, player->getGUID());
+	const std::string binaryFilename = fmt::format("{}/{:d}.tvpb", foldername, player->getGUID());
+
+	//Create the required sub folder for us
+	std::error_code ec;
+	std::filesystem::create_directories(foldername, ec);
+	if (ec) {
+		std::cout << "> ERROR - [IOLoginData::savePlayer]: Cannot create " << foldername << "." << std::endl;
+	}
+
+	//only one format may stay on disk, the binary file is loaded first
+	if (g_config.getBoolean(ConfigManager::BINARY_PLAYER_FILES)) {
+		if (!savePlayerBinaryFile(player, binaryFilename)) {
+			return false;
+		}
+		g_fileTasks.removeFile(filename);
+	} else {
+		if (!savePlayerTextFile(player, filename)) {
+			return false;
+		}
+		g_fileTasks.removeFile(binaryFilename);
+	}
+
+	if (player->inboxLoaded && !player->cold->depotsUnsaveable) {
+		// queued after the player file, so the mail is never on disk twice or not at all
+		g_fileTasks.removeFile(getPlayerInboxFilename(player->getGUID()));
+		player->inboxLoaded = false;
+	}
+	return true;
+}
 
+void IOLoginData::savePlayerDatabase(Player* player)
+{
 	// Last step, update SQL specific data, this has to come last in case the SQL server is down
-	Database& db = Database::getInstance();
 	std::ostringstream query;
 	query << "UPDATE `players` SET ";
 	query << "`level` = " << player->level << ',';
@@ -854,19 +1833,43 @@ bool IOLoginData::savePlayer(Player* player)
 
 	query << " WHERE `id` = " << player->getGUID();
 
-	// We do not care about the result, async query it.
-	g_databaseTasks.addTask(query.str());
-	g_databaseTasks.addTask(fmt::format("DELETE FROM `player_items` WHERE `player_id` = {:d}", player->getGUID()));
-
+	std::vector<std::string> itemRows;
 	int32_t inventoryID = CONST_SLOT_HEAD;
 	for (auto& inventoryItem : player->inventory) {
 		if (!inventoryItem) {
 			continue;
 		}
-		g_databaseTasks.addTask(fmt::format("INSERT INTO `player_items` (`player_id`, `pid`, `sid`, `itemtype`, `count`) VALUES ({:d}, {:d}, {:d}, {:d}, {:d})", player->getGUID(), inventoryID++, 0, inventoryItem->getID(), inventoryItem->getItemCount()));
+		itemRows.push_back(fmt::format("{:d}, {:d}, {:d}, {:d}, {:d}", player->getGUID(), inventoryID++, 0, inventoryItem->getID(), inventoryItem->getItemCount()));
 	}
 
-	return true;
+	// We do not care about the result, async query it as a single transaction.
+	g_databaseTasks.addTask([guid = player->getGUID(), update = query.str(), itemRows = std::move(itemRows)](Database& db) {
+		DBTransaction transaction(db);
+		if (!transaction.begin()) {
+			return;
+		}
+
+		if (!db.executeQuery(update)) {
+			return;
+		}
+
+		if (!db.executeQuery(fmt::format("DELETE FROM `player_items` WHERE `player_id` = {:d}", guid))) {
+			return;
+		}
+
+		DBInsert itemsQuery("INSERT INTO `player_items` (`player_id`, `pid`, `sid`, `itemtype`, `count`) VALUES ", db);
+		for (const std::string& row : itemRows) {
+			if (!itemsQuery.addRow(row)) {
+				return;
+			}
+		}
+
+		if (!itemsQuery.execute()) {
+			return;
+		}
+
+		transaction.commit();
+	});
 }
 
 std::string IOLoginData::getNameByGuid(uint32_t guid)
@@ -940,4 +1943,66 @@ bool IOLoginData::hasBiddedOnHouse(uint32_t guid)
 void IOLoginData::updatePremiumTime(uint32_t accountId, time_t endTime)
 {
 	Database::getInstance().executeQuery(fmt::format("UPDATE `accounts` SET `premium_ends_at` = {:d} WHERE `id` = {:d}", endTime, accountId));
+	invalidateAccountCache(accountId);
+}
+
+std::vector<PlayerLedger> IOLoginData::loadPlayerLedgers(const std::vector<uint32_t>& guids)
+{
+	std::vector<PlayerLedger> ledgers;
+	if (guids.empty()) {
+		return ledgers;
+	}
+
+	std::string ids;
+	for (uint32_t guid : guids) {
+		if (!ids.empty()) {
+			ids.push_back(',');
+		}
+		ids += std::to_string(guid);
+	}
+
+	// premium and guild rank of every player in one round trip
+	DBResult_ptr result = Database::getInstance().storeQuery(fmt::format("SELECT `p`.`id`, `a`.`premium_ends_at`, `gr`.`level` AS `rank_level` FROM `players` AS `p` "
+		"INNER JOIN `accounts` AS `a` ON `a`.`id` = `p`.`account_id` LEFT JOIN `guild_membership` AS `gm` ON `gm`.`player_id` = `p`.`id` "
+		"LEFT JOIN `guild_ranks` AS `gr` ON `gr`.`id` = `gm`.`rank_id` WHERE `p`.`id` IN ({:s})", ids));
+	if (!result) {
+		return ledgers;
+	}
+
+	do {
+		PlayerLedger& ledger = ledgers.emplace_back();
+		ledger.guid = result->getNumber<uint32_t>("id");
+		ledger.premiumEndsAt = result->getNumber<time_t>("premium_ends_at");
+		ledger.guildRankLevel = result->getNumber<uint16_t>("rank_level");
+	} while (result->next());
+
+	// the workers wait for the files, the forked save that holds them back is reaped here
+	for (const PlayerLedger& ledger : ledgers) {
+		if (g_fileTasks.isFilePending(getPlayerBinaryFilename(ledger.guid))) {
+			g_game.checkForkedSave(true);
+			break;
+		}
+	}
+
+	// the files are read on saveThreads threads
+	std::vector<uint8_t> loaded(ledgers.size());
+	g_jobPool.parallelFor(ledgers.size(), [&](size_t i) {
+		loaded[i] = readPlayerLedgerFile(ledgers[i]);
+	}, g_config.getNumber(ConfigManager::SAVE_THREADS));
+
+	std::vector<PlayerLedger> readLedgers;
+	readLedgers.reserve(ledgers.size());
+	for (size_t i = 0; i < ledgers.size(); ++i) {
+		if (loaded[i]) {
+			readLedgers.push_back(std::move(ledgers[i]));
+		}
+	}
+	return readLedgers;
+}
+
+void IOLoginData::savePlayerLedger(PlayerLedger& ledger)
+{
+	memcpy(ledger.fileContent.data() + ledger.bankBalanceOffset, &ledger.bankBalance, sizeof(ledger.bankBalance));
+	g_fileTasks.writeFile(getPlayerBinaryFilename(ledger.guid), std::move(ledger.fileContent));
+	g_databaseTasks.addTask(fmt::format("UPDATE `players` SET `balance` = {:d} WHERE `id` = {:d}", ledger.bankBalance, ledger.guid));
 }
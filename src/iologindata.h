@@ -6,6 +6,20 @@
 #include "account.h"
 #include "player.h"
 
+// what the house rent needs of an offline player, read without loading the whole player
+struct PlayerLedger {
+	uint32_t guid = 0;
+	uint64_t bankBalance = 0;
+	time_t premiumEndsAt = 0;
+	uint16_t groupId = 0;
+	// 0 outside of a guild
+	uint16_t guildRankLevel = 0;
+
+	// the binary player file, written back with the new balance
+	std::string fileContent;
+	size_t bankBalanceOffset = 0;
+};
+
 class IOLoginData
 {
 	public:
@@ -19,13 +33,30 @@ class IOLoginData
 
 		static AccountType_t getAccountType(uint32_t accountId);
 		static void setAccountType(uint32_t accountId, AccountType_t accountType);
+		// accounts and character lists are cached for accountCacheDuration after a login,
+		// changes made by the server invalidate them, changes made outside show once they expire
+		static void invalidateAccountCache(uint32_t accountId);
+		// players_online is written in batches, see flushOnlineStatus
 		static void updateOnlineStatus(uint32_t guid, bool login);
+		// sends the logins and logouts since the last flush as one delete and one insert
+		static void flushOnlineStatus();
+		// removes the rows of this shard from players_online, at startup
+		static void resetOnlineStatus();
 		static bool preloadPlayer(Player* player, const std::string& name);
 
 		static bool loadPlayerByGUID(Player* player, uint32_t id);
 		static bool loadPlayerByName(Player* player, const std::string& name);
 		static bool loadPlayer(Player* player, bool initializeScriptFile);
 		static bool savePlayer(Player* player);
+		// encodes the files of the players on saveThreads threads, the queries are sent from the caller
+		static void savePlayers(const std::vector<Player*>& players);
+		// the two halves of savePlayer, a forked save writes the file and the server sends the queries
+		static bool savePlayerFile(Player* player);
+		static void savePlayerDatabase(Player* player);
+		// taken around a fork, see PlayerFileCache
+		static std::unique_lock<std::mutex> lockPlayerFileCache();
+		// writes the player in the text format next to its save file, for debugging
+		static bool exportPlayerTextFile(Player* player);
 
 		static uint32_t getGuidByName(const std::string& name);
 		static bool getGuidByNameEx(uint32_t& guid, bool& specialVip, std::string& name);
@@ -36,4 +67,24 @@ class IOLoginData
 		static bool hasBiddedOnHouse(uint32_t guid);
 
 		static void updatePremiumTime(uint32_t accountId, time_t endTime);
+
+		// reads the depots section of a binary player file into the depot lockers
+		static bool loadPlayerDepots(Player* player, const std::string& data);
+		// mail for an offline player, put into the depot of the town the next time the player is loaded
+		static void addPlayerInboxItem(uint32_t guid, uint32_t townId, const Item* item);
+		// inbox entries written one after another and added in one append, such as the items of a lost house
+		static void serializePlayerInboxItem(PropWriteStream& propWriteStream, uint32_t townId, const Item* item);
+		static void addPlayerInboxItems(uint32_t guid, const PropWriteStream& propWriteStream);
+
+		// players that do not exist or have no binary player file are left out
+		static std::vector<PlayerLedger> loadPlayerLedgers(const std::vector<uint32_t>& guids);
+		// the player must be offline, its file would be overwritten by the next save otherwise
+		static void savePlayerLedger(PlayerLedger& ledger);
+
+	private:
+		static bool loadPlayerTextFile(Player* player, const std::string& filename);
+		static bool loadPlayerBinaryFile(Player* player, const std::string& filename);
+		static void loadPlayerInbox(Player* player);
+		static bool savePlayerTextFile(Player* player, const std::string& filename);
+		static bool savePlayerBinaryFile(Player* player, const std::string& filename);
 };
@@ -6,13 +6,557 @@
 #include "iomap.h"
 
 #include "bed.h"
+#include "filecompression.h"
+#include "filetasks.h"
 #include "game.h"
+#include "iologindata.h"
+#include "jobpool.h"
 #include "scriptwriter.h"
+#include "profiler.h"
+#include "worldshards.h"
 
 #include <fmt/format.h>
 #include <filesystem>
+#include <fstream>
 #include <ranges>
 
+namespace {
+
+/*
+ * Live map data is a base snapshot (gamedata/map.tvpm) plus a delta journal (gamedata/map.tvpm.delta).
+ * The journal starts with the checksum of the base it belongs to, followed by segments of changed tiles
+ * (every tile holding a container or an item with attributes among them, those change unnoticed):
+ * magic, payload size, payload checksum and the payload (tile count + tile records in the snapshot format).
+ * Segments that fail to verify, like a save interrupted by a crash, are dropped at load.
+ *
+ * Every shard keeps a live map of its own (gamedata/map.shard<id>.tvpm), the shards would overwrite
+ * each other's tiles in a shared one. It replaces the OTBM at load, so it holds the whole map, the
+ * areas of the other shards as this one last had them.
+ */
+const std::string& getMapDataFile()
+{
+	static const std::string filename = g_config.getNumber(ConfigManager::SHARD_ID) == 0 ? "gamedata/map.tvpm" :
+		fmt::format("gamedata/map.shard{:d}.tvpm", g_config.getNumber(ConfigManager::SHARD_ID));
+	return filename;
+}
+
+const std::string& getMapDataDeltaFile()
+{
+	static const std::string filename = getMapDataFile() + ".delta";
+	return filename;
+}
+
+constexpr uint32_t MAP_DATA_DELTA_MAGIC = 0x4A505654; // TVPJ
+constexpr uint32_t MAP_DATA_SEGMENT_MAGIC = 0x53505654; // TVPS
+constexpr size_t MAP_DATA_DELTA_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr size_t MAP_DATA_SEGMENT_HEADER_SIZE = 3 * sizeof(uint32_t);
+
+// where each tile of the save list was written in the last snapshot
+struct SavedTileRecord {
+	uint32_t offset = 0;
+	uint32_t size = 0;
+	// items are fully described by id and count, nothing can change them without touching the tile
+	bool reusable = false;
+};
+
+// containers and items with attributes change without Tile::markChanged: the contents of a container
+// and the text, charges or other attributes of an item
+bool isVolatileMapDataItem(const Item* item)
+{
+	return item->hasAttributes() || item->getContainer();
+}
+
+bool isVolatileMapDataTile(const Tile* tile)
+{
+	if (const Item* ground = tile->getGround(); ground && isVolatileMapDataItem(ground)) {
+		return true;
+	}
+
+	const TileItemVector* items = tile->getItemList();
+	return items && std::any_of(items->begin(), items->end(), isVolatileMapDataItem);
+}
+
+std::shared_ptr<const std::vector<char>> lastSavedMapData;
+std::vector<SavedTileRecord> lastSavedTiles;
+
+// the delta journal matches the snapshot on disk and can be appended to
+bool deltaJournalReady = false;
+uint64_t snapshotSize = 0;
+uint64_t deltaJournalSize = 0;
+
+// set by the file thread, the next save rewrites the whole snapshot
+std::atomic<bool> mapDataWriteFailed{false};
+
+uint32_t mapDataChecksum(const char* data, size_t length)
+{
+	//adler-32, without the size limit of adlerChecksum
+	const uint32_t adler = 65521;
+
+	uint32_t a = 1, b = 0;
+	while (length > 0) {
+		size_t tmp = std::min<size_t>(length, 5552);
+		length -= tmp;
+
+		do {
+			a += static_cast<uint8_t>(*data++);
+			b += a;
+		} while (--tmp);
+
+		a %= adler;
+		b %= adler;
+	}
+	return (b << 16) | a;
+}
+
+// writes the tile in the snapshot format, returns whether its bytes can be reused while the tile is unchanged
+bool serializeMapDataTile(PropWriteStream& f, const Tile* tile)
+{
+	const Position& pos = tile->getPosition();
+
+	f.write<uint16_t>(pos.x);
+	f.write<uint16_t>(pos.y);
+	f.write<uint8_t>(pos.z);
+
+	if (const House* house = tile->getHouse()) {
+		f.write<uint32_t>(house->getId());
+	} else {
+		f.write<uint32_t>(0);
+	}
+
+	std::vector<const Item*> savingItems;
+
+	if (const Item* ground = tile->getGround()) {
+		savingItems.push_back(ground);
+	}
+
+	std::list<Item*> borderItems;
+	if (const auto& items = tile->getItemList()) {
+		for (auto it = items->rbegin(); it != items->rend(); it++) {
+			Item* item = (*it);
+			if (item->isAlwaysOnTop() && Item::items[item->getID()].alwaysOnTopOrder == 1) {
+				borderItems.push_front(item);
+			} else {
+				savingItems.push_back(item);
+			}
+		}
+	}
+
+	uint32_t realTileFlags = tile->getFlags();
+	realTileFlags &= ~TILESTATE_FLOORCHANGE;
+
+	f.write<uint32_t>(realTileFlags);
+
+	f.write<uint32_t>(savingItems.size() + borderItems.size());
+
+	for (const Item* item : borderItems) {
+		item->serializeTVPFormat(f);
+	}
+
+	for (const Item* item : savingItems) {
+		item->serializeTVPFormat(f);
+	}
+
+	return std::none_of(borderItems.begin(), borderItems.end(), isVolatileMapDataItem) && std::none_of(savingItems.begin(), savingItems.end(), isVolatileMapDataItem);
+}
+
+// reads a tile written by serializeMapDataTile, replacing the items of the tile already on the map
+bool unserializeMapDataTile(PropStream& propStream, const std::string& filename)
+{
+	uint32_t houseId;
+	uint16_t x, y;
+	uint8_t z;
+
+	propStream.read<uint16_t>(x);
+	propStream.read<uint16_t>(y);
+	propStream.read<uint8_t>(z);
+	propStream.read<uint32_t>(houseId);
+
+	Tile* tile = new Tile(x, y, z);
+	if (houseId != 0) {
+		House* house = g_game.map.houses.addHouse(houseId);
+		tile->setHouse(house);
+	}
+
+	uint32_t tileFlags = 0;
+	propStream.read<uint32_t>(tileFlags);
+	tile->setFlags(tileFlags);
+
+	uint32_t totalItems = 0;
+	propStream.read<uint32_t>(totalItems);
+
+	for (uint32_t i = 0; i < totalItems; i++) {
+		Item* item = Item::CreateItem(propStream);
+		if (!item) {
+			std::cout << fmt::format("ERROR - [IOMapSerialize::loadMapData]: Failed to create item - {:s}", filename) << std::endl;
+			delete tile;
+			return false;
+		}
+
+		if (!item->unserializeTVPFormat(propStream)) {
+			std::cout << "> ERROR - [IOMapSerialize::loadMapData]: Failed to unserialize item in file " << filename << std::endl;
+			delete item;
+			delete tile;
+			return false;
+		}
+
+		tile->internalAddThing(item);
+		item->startDecaying();
+	}
+
+	if (totalItems != 0) {
+		tile->makeRefreshItemList();
+	}
+
+	if (Tile* existingTile = g_game.map.getTile(x, y, z)) {
+		//a newer version of the tile from the delta journal, setTile moves the items over
+		g_game.map.setTile(x, y, z, tile);
+		existingTile->setFlags(existingTile->getFlags() | tileFlags);
+		existingTile->updateFloorMasks();
+		tile = existingTile;
+	} else {
+		g_game.map.setTile(x, y, z, tile);
+	}
+
+	if (isVolatileMapDataTile(tile)) {
+		tile->setTrackFlag(TILETRACK_VOLATILE);
+	}
+	return true;
+}
+
+// runs on the file thread
+void writeSnapshot(const std::vector<char>& data)
+{
+	bool written;
+	if (filecompression::isEnabled()) {
+		const std::string compressed = filecompression::compress(COMPRESSED_FILE_MAP, std::string(data.data(), data.size()));
+		written = FileTasks::writeFileContents(getMapDataFile(), compressed.data(), compressed.size());
+	} else {
+		written = FileTasks::writeFileContents(getMapDataFile(), data.data(), data.size());
+	}
+
+	if (!written) {
+		mapDataWriteFailed = true;
+		return;
+	}
+
+	PropWriteStream header;
+	header.write<uint32_t>(MAP_DATA_DELTA_MAGIC);
+	header.write<uint32_t>(mapDataChecksum(data.data(), data.size()));
+
+	size_t size;
+	const char* headerData = header.getStream(size);
+	if (!FileTasks::writeFileContents(getMapDataDeltaFile(), headerData, size)) {
+		mapDataWriteFailed = true;
+	}
+}
+
+// replays the verified segments of the delta journal, returns false when a tile could not be loaded
+bool loadDeltaJournal(uint32_t snapshotChecksum)
+{
+	std::error_code ec;
+	uint64_t fileSize = std::filesystem::file_size(getMapDataDeltaFile(), ec);
+	if (ec || fileSize < MAP_DATA_DELTA_HEADER_SIZE) {
+		return true;
+	}
+
+	uint64_t validSize = MAP_DATA_DELTA_HEADER_SIZE;
+	uint32_t segments = 0;
+	{
+		OTB::MappedFile file(getMapDataDeltaFile());
+
+		PropStream propStream;
+		propStream.init(file.data(), file.size());
+
+		uint32_t magic = 0, checksum = 0;
+		propStream.read<uint32_t>(magic);
+		propStream.read<uint32_t>(checksum);
+		if (magic != MAP_DATA_DELTA_MAGIC || checksum != snapshotChecksum) {
+			std::cout << "> INFO: Live map delta journal belongs to another snapshot, ignoring it." << std::endl;
+			return true;
+		}
+
+		while (file.size() - validSize >= MAP_DATA_SEGMENT_HEADER_SIZE) {
+			const char* segment = file.data() + validSize;
+
+			uint32_t payloadSize = 0, payloadChecksum = 0;
+			propStream.init(segment, MAP_DATA_SEGMENT_HEADER_SIZE);
+			propStream.read<uint32_t>(magic);
+			propStream.read<uint32_t>(payloadSize);
+			propStream.read<uint32_t>(payloadChecksum);
+
+			const char* payload = segment + MAP_DATA_SEGMENT_HEADER_SIZE;
+			if (magic != MAP_DATA_SEGMENT_MAGIC || payloadSize > file.size() - validSize - MAP_DATA_SEGMENT_HEADER_SIZE || mapDataChecksum(payload, payloadSize) != payloadChecksum) {
+				std::cout << "> WARNING: Live map delta journal has an incomplete segment, discarding " << (file.size() - validSize) << " bytes." << std::endl;
+				break;
+			}
+
+			propStream.init(payload, payloadSize);
+
+			uint64_t totalTiles = 0;
+			propStream.read<uint64_t>(totalTiles);
+			for (uint64_t i = 0; i < totalTiles; i++) {
+				if (!unserializeMapDataTile(propStream, getMapDataDeltaFile())) {
+					return false;
+				}
+			}
+
+			validSize += MAP_DATA_SEGMENT_HEADER_SIZE + payloadSize;
+			++segments;
+		}
+	}
+
+	if (validSize != fileSize) {
+		std::filesystem::resize_file(getMapDataDeltaFile(), validSize, ec);
+		if (ec) {
+			std::cout << "> ERROR: Cannot truncate " << getMapDataDeltaFile() << ": " << ec.message() << std::endl;
+			return true;
+		}
+	}
+
+	std::cout << "> Replayed " << segments << " live map delta segments." << std::endl;
+	deltaJournalReady = true;
+	deltaJournalSize = validSize;
+	return true;
+}
+
+void saveDeltaJournal()
+{
+	int64_t start = OTSYS_TIME();
+
+	//volatile tiles may have changed unnoticed, they are written while they are volatile and once more after
+	std::vector<Tile*> tiles = g_game.getTileSaveJournal();
+	for (Tile* tile : g_game.getTilesToSave()) {
+		if (!tile->hasTrackFlag(TILETRACK_SAVE_DIRTY) && (tile->hasTrackFlag(TILETRACK_VOLATILE) || isVolatileMapDataTile(tile))) {
+			tiles.push_back(tile);
+		}
+	}
+
+	if (tiles.empty()) {
+		return;
+	}
+
+	PropWriteStream payload;
+	payload.write<uint64_t>(tiles.size());
+	for (Tile* tile : tiles) {
+		if (serializeMapDataTile(payload, tile)) {
+			tile->resetTrackFlag(TILETRACK_VOLATILE);
+		} else {
+			tile->setTrackFlag(TILETRACK_VOLATILE);
+		}
+	}
+
+	size_t payloadSize;
+	const char* payloadData = payload.getStream(payloadSize);
+
+	PropWriteStream segment;
+	segment.write<uint32_t>(MAP_DATA_SEGMENT_MAGIC);
+	segment.write<uint32_t>(payloadSize);
+	segment.write<uint32_t>(mapDataChecksum(payloadData, payloadSize));
+	segment.writeBytes(payloadData, payloadSize);
+
+	size_t segmentSize;
+	const char* segmentData = segment.getStream(segmentSize);
+
+	g_fileTasks.addTask([data = std::string(segmentData, segmentSize)]() {
+		//whatever made it to the disk is dropped at load
+		if (!FileTasks::writeFileContents(getMapDataDeltaFile(), data.data(), data.size(), true)) {
+			mapDataWriteFailed = true;
+		}
+	});
+
+	deltaJournalSize += segmentSize;
+
+	std::cout << "> Saved " << tiles.size() << " changed tiles to the live map delta journal in: " <<
+		(OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
+	g_game.clearTileSaveJournal();
+}
+
+}
+
+struct DecodedTile
+{
+	uint16_t x;
+	uint16_t y;
+	uint32_t houseId = 0;
+	uint32_t flags = TILESTATE_NONE;
+	bool isHouseTile = false;
+	// in file order, IOMap::placeTileArea picks the ground out of them
+	std::vector<Item*> items;
+};
+
+// a tile area read on a worker thread, its items are unknown to the game until it is placed
+struct DecodedTileArea
+{
+	DecodedTileArea() = default;
+	~DecodedTileArea() {
+		for (DecodedTile& tile : tiles) {
+			for (Item* item : tile.items) {
+				delete item;
+			}
+		}
+	}
+
+	// non-copyable
+	DecodedTileArea(const DecodedTileArea&) = delete;
+	DecodedTileArea& operator=(const DecodedTileArea&) = delete;
+
+	uint16_t z = 0;
+	std::vector<DecodedTile> tiles;
+	std::string error;
+};
+
+namespace {
+
+Item* decodeItemNode(OTB::Loader& loader, const OTB::Node& itemNode, uint16_t x, uint16_t y, uint16_t z, std::string& error)
+{
+	PropStream stream;
+	if (!loader.getProps(itemNode, stream)) {
+		error = "Invalid item node.";
+		return nullptr;
+	}
+
+	Item* item = Item::CreateItem(stream);
+	if (!item) {
+		error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z);
+		return nullptr;
+	}
+
+	if (!item->unserializeItemNode(loader, itemNode, stream)) {
+		error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to load item {:d}.", x, y, z, item->getID());
+		delete item;
+		return nullptr;
+	}
+
+	if (item->getItemCount() == 0) {
+		item->setItemCount(1);
+	}
+	return item;
+}
+
+bool decodeTileArea(OTB::Loader& loader, const OTB::Node& tileAreaNode, DecodedTileArea& area)
+{
+	PropStream propStream;
+	if (!loader.getProps(tileAreaNode, propStream)) {
+		area.error = "Invalid map node.";
+		return false;
+	}
+
+	OTBM_Destination_coords area_coord;
+	if (!propStream.read(area_coord)) {
+		area.error = "Invalid map node.";
+		return false;
+	}
+
+	uint16_t base_x = area_coord.x;
+	uint16_t base_y = area_coord.y;
+	uint16_t z = area_coord.z;
+
+	area.z = z;
+	area.tiles.reserve(tileAreaNode.children.size());
+
+	for (auto& tileNode : tileAreaNode.children) {
+		if (tileNode.type != OTBM_TILE && tileNode.type != OTBM_HOUSETILE) {
+			area.error = "Unknown tile node.";
+			return false;
+		}
+
+		if (!loader.getProps(tileNode, propStream)) {
+			area.error = "Could not read node data.";
+			return false;
+		}
+
+		OTBM_Tile_coords tile_coord;
+		if (!propStream.read(tile_coord)) {
+			area.error = "Could not read tile position.";
+			return false;
+		}
+
+		DecodedTile& tile = area.tiles.emplace_back();
+		tile.x = base_x + tile_coord.x;
+		tile.y = base_y + tile_coord.y;
+
+		uint16_t x = tile.x;
+		uint16_t y = tile.y;
+
+		if (tileNode.type == OTBM_HOUSETILE) {
+			if (!propStream.read<uint32_t>(tile.houseId)) {
+				area.error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not read house id.", x, y, z);
+				return false;
+			}
+			tile.isHouseTile = true;
+		}
+
+		uint8_t attribute;
+		//read tile attributes
+		while (propStream.read<uint8_t>(attribute)) {
+			switch (attribute) {
+				case OTBM_ATTR_TILE_FLAGS: {
+					uint32_t flags;
+					if (!propStream.read<uint32_t>(flags)) {
+						area.error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to read tile flags.", x, y, z);
+						return false;
+					}
+
+					if ((flags & OTBM_TILEFLAG_PROTECTIONZONE) != 0) {
+						tile.flags |= TILESTATE_PROTECTIONZONE;
+					}
+
+					// cannot be both
+					if ((flags & OTBM_TILEFLAG_NOPVPZONE) != 0) {
+						tile.flags |= TILESTATE_NOPVPZONE;
+					} else if ((flags & OTBM_TILEFLAG_PVPZONE) != 0) {
+						tile.flags |= TILESTATE_PVPZONE;
+					}
+
+					if ((flags & OTBM_TILEFLAG_REFRESH) != 0) {
+						tile.flags |= TILESTATE_REFRESH;
+					}
+
+					if ((flags & OTBM_TILEFLAG_NOLOGOUT) != 0) {
+						tile.flags |= TILESTATE_NOLOGOUT;
+					}
+
+					break;
+				}
+
+				case OTBM_ATTR_ITEM: {
+					Item* item = Item::CreateItem(propStream);
+					if (!item) {
+						area.error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z);
+						return false;
+					}
+
+					if (item->getItemCount() == 0) {
+						item->setItemCount(1);
+					}
+					tile.items.push_back(item);
+					break;
+				}
+
+				default:
+					area.error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown tile attribute.", x, y, z);
+					return false;
+			}
+		}
+
+		for (auto& itemNode : tileNode.children) {
+			if (itemNode.type != OTBM_ITEM) {
+				area.error = fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown node type.", x, y, z);
+				return false;
+			}
+
+			Item* item = decodeItemNode(loader, itemNode, x, y, z, area.error);
+			if (!item) {
+				return false;
+			}
+			tile.items.push_back(item);
+		}
+	}
+	return true;
+}
+
+}
+
 Tile* IOMap::createTile(Item*& ground, uint16_t x, uint16_t y, uint8_t z)
 {
 	Tile* tile = new Tile(x, y, z);
@@ -74,9 +618,32 @@ bool IOMap::loadMap(Map* map, const std::string& fileName, bool replaceExistingT
 			return false;
 		}
 
+		// the tile areas are decoded in parallel, creating their items is most of the loading time
+		// placing them on the map, houses and the unique ids stay serial and in file order
+		std::vector<const OTB::Node*> tileAreaNodes;
 		for (auto& mapDataNode : mapNode.children) {
 			if (mapDataNode.type == OTBM_TILE_AREA) {
-				if (!parseTileArea(loader, mapDataNode, *map, replaceExistingTiles)) {
+				tileAreaNodes.push_back(&mapDataNode);
+			}
+		}
+
+		std::vector<DecodedTileArea> areas(tileAreaNodes.size());
+		g_jobPool.parallelFor(tileAreaNodes.size(), [&](size_t i) {
+			Item::deferGameRegistration = true;
+			decodeTileArea(loader, *tileAreaNodes[i], areas[i]);
+			Item::deferGameRegistration = false;
+		});
+
+		size_t areaIndex = 0;
+		for (auto& mapDataNode : mapNode.children) {
+			if (mapDataNode.type == OTBM_TILE_AREA) {
+				DecodedTileArea& area = areas[areaIndex++];
+				if (!area.error.empty()) {
+					setLastErrorString(std::move(area.error));
+					return false;
+				}
+
+				if (!placeTileArea(area, *map, replaceExistingTiles)) {
 					return false;
 				}
 			} else if (mapDataNode.type == OTBM_TOWNS) {
@@ -110,83 +677,56 @@ MapDataLoadResult_t IOMap::loadMapData()
 	// compare date times
 	auto otbmLastWriteTime = std::filesystem::last_write_time(fmt::format("data/world/{:s}.otbm", g_config.getString(ConfigManager::MAP_NAME)));
 
-	const std::string filename = "gamedata/map.tvpm";
-	std::ifstream fileTest(filename, std::ios::binary);
-	if (fileTest.is_open()) {
-		auto liveMapDataWriteTime = std::filesystem::last_write_time("gamedata/map.tvpm");
+	const std::string filename = getMapDataFile();
 
-		if (otbmLastWriteTime > liveMapDataWriteTime) {
-			std::cout << "> INFO: Original OTBM map is newer than live map data, proceeding to load original OTBM map." << std::endl;
-			g_game.toggleSendPlayersToTemple(true);
-			return MAP_DATA_LOAD_NONE;
-		} else {
-			std::cout << "> INFO: Live Map Data is being used." << std::endl;
-		}
+	std::error_code ec;
+	if (!std::filesystem::exists(filename, ec) || std::filesystem::file_size(filename, ec) == 0) {
+		return MAP_DATA_LOAD_NONE;
+	}
 
-		int64_t start = OTSYS_TIME();
+	auto liveMapDataWriteTime = std::filesystem::last_write_time(filename);
+	if (otbmLastWriteTime > liveMapDataWriteTime) {
+		std::cout << "> INFO: Original OTBM map is newer than live map data, proceeding to load original OTBM map." << std::endl;
+		g_game.toggleSendPlayersToTemple(true);
+		return MAP_DATA_LOAD_NONE;
+	} else {
+		std::cout << "> INFO: Live Map Data is being used." << std::endl;
+	}
+
+	int64_t start = OTSYS_TIME();
 
-		g_game.map.width = g_game.map.height = 65000; // default map size is max size
+	g_game.map.width = g_game.map.height = 65000; // default map size is max size
 
-		const auto& size = std::filesystem::file_size(std::filesystem::path(filename));
+	uint32_t snapshotChecksum;
+	{
+		OTB::MappedFile file(filename);
+
+		// the journal is bound to the checksum of the snapshot as it was before compression
+		std::string decompressed;
+		const char* data = file.data();
+		size_t size = file.size();
+		if (filecompression::isCompressed(data, size)) {
+			if (!filecompression::decompress(data, size, decompressed)) {
+				std::cout << "[Error - IOMap::loadMapData] Cannot decompress " << filename << '.' << std::endl;
+				return MAP_DATA_LOAD_ERROR;
+			}
+			data = decompressed.data();
+			size = decompressed.size();
+		}
 
-		std::string content(size, '\0');
-		fileTest.read(content.data(), size);
+		snapshotSize = size;
+		snapshotChecksum = mapDataChecksum(data, size);
 
 		PropStream propStream;
-		propStream.init(content.data(), size);
+		propStream.init(data, size);
 
 		uint64_t totalTiles = 0;
 		propStream.read<uint64_t>(totalTiles);
 
 		for (uint64_t i = 0; i < totalTiles; i++) {
-			uint32_t houseId;
-			uint16_t x, y;
-			uint8_t z;
-
-			propStream.read<uint16_t>(x);
-			propStream.read<uint16_t>(y);
-			propStream.read<uint8_t>(z);
-			propStream.read<uint32_t>(houseId);
-
-			Tile* tile = new Tile(x, y, z);
-			if (houseId != 0) {
-				House* house = g_game.map.houses.addHouse(houseId);
-				tile->setHouse(house);
-			}
-
-			uint32_t tileFlags = 0;
-			propStream.read<uint32_t>(tileFlags);
-			tile->setFlags(tileFlags);
-
-			uint32_t totalItems = 0;
-			propStream.read<uint32_t>(totalItems);
-
-			if (totalItems == 0) {
-				g_game.map.setTile(tile->getPosition(), tile);
-				continue;
-			}
-
-			for (uint32_t ii = 0; ii < totalItems; ii++) {
-				Item* item = Item::CreateItem(propStream);
-				if (!item) {
-					std::cout << fmt::format("ERROR - [IOMapSerialize::loadMapData]: Failed to create item - {:s}", filename) << std::endl;
-					delete tile;
-					return MAP_DATA_LOAD_ERROR;
-				}
-
-				if (!item->unserializeTVPFormat(propStream)) {
-					std::cout << "> ERROR - [IOMapSerialize::loadMapData]: Failed to unserialize item in file " << filename << std::endl;
-					delete item;
-					delete tile;
-					return MAP_DATA_LOAD_ERROR;
-				}
-
-				tile->internalAddThing(item);
-				item->startDecaying();
+			if (!unserializeMapDataTile(propStream, filename)) {
+				return MAP_DATA_LOAD_ERROR;
 			}
-
-			tile->makeRefreshItemList();
-			g_game.map.setTile(tile->getPosition(), tile);
 		}
 
 		uint8_t totalTowns = 0;
@@ -238,39 +778,53 @@ MapDataLoadResult_t IOMap::loadMapData()
 
 		propStream.readString(g_game.map.spawnfile);
 		propStream.readString(g_game.map.housefile);
+	}
 
-		std::cout << "> Live Map loading time: " << (OTSYS_TIME() - start) / (1000.) << " seconds." << std::endl;
-	} else {
-		return MAP_DATA_LOAD_NONE;
+	if (!loadDeltaJournal(snapshotChecksum)) {
+		return MAP_DATA_LOAD_ERROR;
 	}
 
+	//everything loaded so far is already on disk
+	g_game.clearTileSaveJournal();
+
+	std::cout << "> Live Map loading time: " << (OTSYS_TIME() - start) / (1000.) << " seconds." << std::endl;
+
 	g_game.cleanup();
 	return MAP_DATA_LOAD_FOUND;
 }
 
-bool IOMap::loadHouseItems(Map* map)
-{
-	const int64_t start = OTSYS_TIME();
+namespace {
 
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
+const std::string BED_SLEEPERS_FILENAME = "gamedata/beds.dat";
 
-		const std::string filename = fmt::format("gamedata/houses/{:d}.tvph", house->getId());
-		if (!std::filesystem::exists(filename)) {
-			continue;
-		}
+// the house items of one tile, read from a house data-file before they are placed
+struct HouseTileItems
+{
+	Tile* tile = nullptr;
+	std::vector<Item*> items;
+};
 
-		if (!loadHouseData(house, filename)) {
-			std::cout << "ERROR: Could not load house data-file: " << house->getId() << std::endl;
-			return false;
+struct HouseFileItems
+{
+	HouseFileItems() = default;
+	~HouseFileItems() {
+		for (HouseTileItems& tileItems : tiles) {
+			for (Item* item : tileItems.items) {
+				delete item;
+			}
 		}
 	}
 
-	std::cout << "Loaded house items in: " << (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
-	return true;
-}
+	// non-copyable
+	HouseFileItems(const HouseFileItems&) = delete;
+	HouseFileItems& operator=(const HouseFileItems&) = delete;
 
-bool IOMap::loadHouseData(House* house, const std::string_view& fileName)
+	std::vector<HouseTileItems> tiles;
+	bool exists = false;
+	bool loaded = false;
+};
+
+bool readHouseData(const std::string_view& fileName, std::vector<HouseTileItems>& tiles)
 {
 	ScriptReader script;
 	if (!script.loadScript(fileName)) {
@@ -305,7 +859,10 @@ bool IOMap::loadHouseData(House* house, const std::string_view& fileName)
 
 		bool loadedHouse = true;
 
-		std::vector<Item*> preloadedItems{};
+		// owned by tiles until placed, so they are deleted with the file items on errors
+		HouseTileItems& tileItems = tiles.emplace_back();
+		tileItems.tile = tile;
+		std::vector<Item*>& preloadedItems = tileItems.items;
 
 		script.nextToken();
 		while (script.canRead()) {
@@ -326,6 +883,7 @@ bool IOMap::loadHouseData(House* house, const std::string_view& fileName)
 
 				if (!item->isHouseItem()) {
 					script.error(fmt::format("item {:d} is not a house item", item->getID()));
+					delete item;
 					return false;
 				}
 
@@ -340,97 +898,183 @@ bool IOMap::loadHouseData(House* house, const std::string_view& fileName)
 			}
 		}
 
-		if (loadedHouse) {
-			// house tile is saved on disk, so clean it up no matter what
-			// also cleans up the stock furniture from CIP map that comes from original OTBM
-			tile->cleanHouseItems();
-
-			for (Item* houseItem : preloadedItems) {
-				tile->internalAddThing(houseItem);
-				houseItem->startDecaying();
-			}
-		} else {
+		if (!loadedHouse) {
 			for (const Item* houseItem : preloadedItems) {
 				delete houseItem;
 			}
+			tiles.pop_back();
+		}
+	}
+	return true;
+}
+
+void placeHouseItems(House* house, std::vector<HouseTileItems>& tiles)
+{
+	for (HouseTileItems& tileItems : tiles) {
+		// house tile is saved on disk, so clean it up no matter what
+		// also cleans up the stock furniture from CIP map that comes from original OTBM
+		tileItems.tile->cleanHouseItems();
+
+		for (Item* houseItem : tileItems.items) {
+			tileItems.tile->internalAddThing(houseItem);
+			houseItem->startDecaying();
 		}
+		tileItems.items.clear();
 	}
 
 	house->updateDoorDescription();
+}
+
+// writes the house data-file, returns whether some item can change without its tile being marked as changed
+bool writeHouseItems(const House* house, ScriptWriter& script)
+{
+	bool volatileItems = false;
+	script.writeLineFormatted("# House data-file: {:d}-{:s}", house->getId(), house->getName());
+	script.writeLine();
+
+	for (Tile* tile : house->getTiles()) {
+		script.writePosition(tile->getPosition());
+		script.writeText(": ");
+		script.writeText("{");
+
+		if (const auto& items = tile->getItemList()) {
+			std::vector<Item*> houseItems;
+			for (auto item : std::ranges::reverse_view(*items)) {
+				if (!item->isHouseItem()) {
+					continue;
+				}
+
+				houseItems.push_back(item);
+				volatileItems = volatileItems || item->hasAttributes() || item->getContainer();
+			}
+
+			for (auto it = houseItems.begin(); it != houseItems.end();) {
+				Item* item = *it;
+				item->serializeTVPFormat(script);
+				if (++it != houseItems.end()) {
+					script.writeText(", ");
+				}
+			}
+		}
+
+		// End of tile items
+		script.writeText("}");
+		script.writeLine();
+	}
+
+	return volatileItems;
+}
+
+}
+
+bool IOMap::loadHouseItems(Map* map)
+{
+	const int64_t start = OTSYS_TIME();
+
+	std::vector<House*> houses;
+	houses.reserve(g_game.map.houses.getHouses().size());
+	for (const auto& it : g_game.map.houses.getHouses()) {
+		houses.push_back(it.second);
+	}
+
+	// the files are parsed in parallel into items that belong to no tile yet, placing them stays serial
+	std::vector<HouseFileItems> houseItems(houses.size());
+	g_jobPool.parallelFor(houses.size(), [&](size_t i) {
+		const std::string filename = fmt::format("gamedata/houses/{:d}.tvph", houses[i]->getId());
+		if (std::filesystem::exists(filename)) {
+			houseItems[i].exists = true;
+			houseItems[i].loaded = readHouseData(filename, houseItems[i].tiles);
+		}
+	});
+
+	for (size_t i = 0; i < houses.size(); ++i) {
+		if (!houseItems[i].exists) {
+			continue;
+		}
+
+		if (!houseItems[i].loaded) {
+			std::cout << "ERROR: Could not load house data-file: " << houses[i]->getId() << std::endl;
+			return false;
+		}
+
+		placeHouseItems(houses[i], houseItems[i].tiles);
+	}
+
+	std::cout << "Loaded house items in: " << (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
+	return true;
+}
+
+bool IOMap::loadHouseData(House* house, const std::string_view& fileName)
+{
+	HouseFileItems houseItems;
+	if (!readHouseData(fileName, houseItems.tiles)) {
+		return false;
+	}
+
+	placeHouseItems(house, houseItems.tiles);
 	return true;
 }
 
 bool IOMap::saveMapData()
 {
+	PROFILE_FUNCTION();
 	if (!g_config.getBoolean(ConfigManager::ENABLE_MAP_DATA_FILES)) {
 		return true;
 	}
 
 	std::cout << "> Saving map data..." << std::endl;
 
-	int64_t start = OTSYS_TIME();
-
-	std::ostringstream ss;
-	ss << "gamedata/map.tvpm";
+	if (mapDataWriteFailed.exchange(false)) {
+		deltaJournalReady = false;
+		lastSavedTiles.clear();
+	}
 
-	std::ofstream file;
-	file.open(ss.str(), std::ios::out | std::ios::binary | std::ios::trunc);
-	if (!file.is_open()) {
-		std::cout << "> ERROR: Cannot open " << ss.str() << " for saving." << std::endl;
-		return false;
+	//changes go to the delta journal until it grows past half the snapshot, then the snapshot is rewritten
+	if (deltaJournalReady && deltaJournalSize < MAP_DATA_DELTA_HEADER_SIZE + snapshotSize / 2) {
+		saveDeltaJournal();
+		return true;
 	}
 
+	int64_t start = OTSYS_TIME();
+
 	PropWriteStream f;
 
 	const auto& tiles = g_game.getTilesToSave();
 
 	f.write<uint64_t>(tiles.size());
 
-	for (const Tile* tile : tiles) {
-		const Position& pos = tile->getPosition();
-
-		f.write<uint16_t>(pos.x);
-		f.write<uint16_t>(pos.y);
-		f.write<uint8_t>(pos.z);
-
-		if (const House* house = tile->getHouse()) {
-			f.write<uint32_t>(house->getId());
-		} else {
-			f.write<uint32_t>(0);
-		}
+	std::vector<SavedTileRecord> savedTiles;
+	savedTiles.reserve(tiles.size());
 
-		std::vector<const Item*> savingItems;
+	size_t serializedTiles = 0;
+	for (size_t i = 0, size = tiles.size(); i < size; ++i) {
+		Tile* tile = tiles[i];
 
-		if (const Item* ground = tile->getGround()) {
-			savingItems.push_back(ground);
-		}
+		size_t offset;
+		f.getStream(offset);
 
-		std::list<Item*> borderItems;
-		if (const auto& items = tile->getItemList()) {
-			for (auto it = items->rbegin(); it != items->rend(); it++) {
-				Item* item = (*it);
-				if (item->isAlwaysOnTop() && Item::items[item->getID()].alwaysOnTopOrder == 1) {
-					borderItems.push_front(item);
-				} else {
-					savingItems.push_back(item);
-				}
-			}
+		//tiles unchanged since the last snapshot are copied from it, unless an item got attributes meanwhile
+		if (i < lastSavedTiles.size() && lastSavedTiles[i].reusable && !tile->hasTrackFlag(TILETRACK_SNAPSHOT_DIRTY) && !isVolatileMapDataTile(tile)) {
+			const SavedTileRecord& record = lastSavedTiles[i];
+			f.writeBytes(lastSavedMapData->data() + record.offset, record.size);
+			savedTiles.push_back({static_cast<uint32_t>(offset), record.size, true});
+			tile->resetTrackFlag(TILETRACK_VOLATILE);
+			continue;
 		}
 
-		uint32_t realTileFlags = tile->getFlags();
-		realTileFlags &= ~TILESTATE_FLOORCHANGE;
-
-		f.write<uint32_t>(realTileFlags);
-
-		f.write<uint32_t>(savingItems.size() + borderItems.size());
+		++serializedTiles;
+		tile->resetTrackFlag(TILETRACK_SNAPSHOT_DIRTY);
 
-		for (const Item* item : borderItems) {
-			item->serializeTVPFormat(f);
+		bool reusable = serializeMapDataTile(f, tile);
+		if (reusable) {
+			tile->resetTrackFlag(TILETRACK_VOLATILE);
+		} else {
+			tile->setTrackFlag(TILETRACK_VOLATILE);
 		}
 
-		for (const Item* item : savingItems) {
-			item->serializeTVPFormat(f);
-		}
+		size_t end;
+		f.getStream(end);
+		savedTiles.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(end - offset), reusable});
 	}
 
 	f.write<uint8_t>(g_game.map.towns.getTowns().size());
@@ -458,30 +1102,59 @@ bool IOMap::saveMapData()
 	f.writeString(g_game.map.spawnfile);
 	f.writeString(g_game.map.housefile);
 
-	size_t size;
-	const char* data = f.getStream(size);
-	file.write(data, size);
-	file.close();
+	auto data = std::make_shared<const std::vector<char>>(f.release());
+	g_fileTasks.addTask([data]() { writeSnapshot(*data); });
+
+	snapshotSize = data->size();
+	deltaJournalSize = MAP_DATA_DELTA_HEADER_SIZE;
+	deltaJournalReady = true;
+
+	lastSavedMapData = std::move(data);
+	lastSavedTiles = std::move(savedTiles);
+	g_game.clearTileSaveJournal();
 
 	std::cout << "> Saved map data in: " <<
-		(OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
+		(OTSYS_TIME() - start) / (1000.) << " s (" << serializedTiles << " of " << tiles.size() << " tiles serialized)" << std::endl;
 	return true;
 }
 
+void IOMap::discardSavedMapData()
+{
+	mapDataWriteFailed = true;
+}
+
 bool IOMap::saveHouseItems()
 {
 	std::cout << "> Saving house items..." << std::endl;
 	int64_t start = OTSYS_TIME();
 
+	size_t writtenHouses = 0;
 	for (const auto& it : g_game.map.houses.getHouses()) {
-		const House* house = it.second;
-		if (!saveHouseTVPFormat(house)) {
+		House* house = it.second;
+		// the houses of the other shards are written by them
+		if (!house->needsItemsSave() || !g_worldShards.isOwned(house->getEntryPosition())) {
+			continue;
+		}
+
+		const std::string filename = fmt::format("gamedata/houses/{:d}.tvph", house->getId());
+		ScriptWriter script;
+		if (!script.open(filename)) {
 			std::cout << "> ERROR: Failed to save house " << house->getId() << ":" << house->getName() << std::endl;
 			return false;
 		}
+
+		// houses with containers or items with attributes are serialized on every save, but only written when they differ
+		const bool volatileItems = writeHouseItems(house, script);
+		if (!house->setItemsSaved(script.hash(), volatileItems)) {
+			script.discard();
+			continue;
+		}
+
+		script.close();
+		++writtenHouses;
 	}
 
-	std::cout << "> Saved house data files in: " << (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
+	std::cout << "> Saved house data files in: " << (OTSYS_TIME() - start) / (1000.) << " s (" << writtenHouses << " of " << g_game.map.houses.getHouses().size() << " houses written)" << std::endl;
 	return true;
 }
 
@@ -494,21 +1167,28 @@ bool IOMap::loadHouseDatabaseInformation()
 		return false;
 	}
 
+	const size_t idColumn = result->getColumnIndex("id");
+	const size_t ownerColumn = result->getColumnIndex("owner");
+	const size_t paidColumn = result->getColumnIndex("paid");
+	const size_t warningsColumn = result->getColumnIndex("warnings");
 	do {
-		House* house = g_game.map.houses.getHouse(result->getNumber<uint32_t>("id"));
+		House* house = g_game.map.houses.getHouse(result->getNumber<uint32_t>(idColumn));
 		if (house) {
-			house->setOwner(result->getNumber<uint32_t>("owner"), false);
-			house->setPaidUntil(result->getNumber<time_t>("paid"));
-			house->setPayRentWarnings(result->getNumber<uint32_t>("warnings"));
+			house->setOwner(result->getNumber<uint32_t>(ownerColumn), false);
+			house->setPaidUntil(result->getNumber<time_t>(paidColumn));
+			house->setPayRentWarnings(result->getNumber<uint32_t>(warningsColumn));
 		}
 	} while (result->next());
 
 	result = db.storeQuery("SELECT `house_id`, `listid`, `list` FROM `house_lists`");
 	if (result) {
+		const size_t houseIdColumn = result->getColumnIndex("house_id");
+		const size_t listIdColumn = result->getColumnIndex("listid");
+		const size_t listColumn = result->getColumnIndex("list");
 		do {
-			House* house = g_game.map.houses.getHouse(result->getNumber<uint32_t>("house_id"));
+			House* house = g_game.map.houses.getHouse(result->getNumber<uint32_t>(houseIdColumn));
 			if (house) {
-				house->setAccessList(result->getNumber<uint32_t>("listid"), result->getString("list"));
+				house->setAccessList(result->getNumber<uint32_t>(listIdColumn), result->getString(listColumn));
 			}
 		} while (result->next());
 	}
@@ -524,12 +1204,29 @@ bool IOMap::saveHouseDatabaseInformation()
 		return false;
 	}
 
-	if (!db.executeQuery("DELETE FROM `house_lists`")) {
+	// the houses of the other shards are saved by them
+	std::vector<House*> houses;
+	std::string houseIds;
+	for (const auto& it : g_game.map.houses.getHouses()) {
+		House* house = it.second;
+		if (g_worldShards.isOwned(house->getEntryPosition())) {
+			houses.push_back(house);
+			if (!houseIds.empty()) {
+				houseIds.push_back(',');
+			}
+			houseIds += std::to_string(house->getId());
+		}
+	}
+
+	if (houses.empty()) {
+		return transaction.commit();
+	}
+
+	if (!db.executeQuery(g_worldShards.isEnabled() ? fmt::format("DELETE FROM `house_lists` WHERE `house_id` IN ({:s})", houseIds) : "DELETE FROM `house_lists`")) {
 		return false;
 	}
 
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
+	for (House* house : houses) {
 		DBResult_ptr result = db.storeQuery(fmt::format("SELECT `id` FROM `houses` WHERE `id` = {:d}", house->getId()));
 		if (result) {
 			db.executeQuery(fmt::format(
@@ -548,9 +1245,7 @@ bool IOMap::saveHouseDatabaseInformation()
 
 	DBInsert stmt("INSERT INTO `house_lists` (`house_id` , `listid` , `list`) VALUES ");
 
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
-
+	for (House* house : houses) {
 		std::string listText;
 		if (house->getAccessList(GUEST_LIST, listText) && !listText.empty()) {
 			if (!stmt.addRow(fmt::format("{:d}, {}, {:s}", house->getId(), tvp::to_underlying(GUEST_LIST), db.escapeString(listText)))) {
@@ -588,49 +1283,68 @@ bool IOMap::saveHouseDatabaseInformation()
 
 bool IOMap::saveHouseTVPFormat(const House* house)
 {
-	std::ostringstream ss;
-	ss << "gamedata/houses/" << house->getId() << ".tvph";
+	const std::string filename = fmt::format("gamedata/houses/{:d}.tvph", house->getId());
 
 	ScriptWriter script;
-	if (!script.open(ss.str())) {
-		std::cout << "> ERROR: Cannot open " << ss.str() << " for saving." << std::endl;
+	if (!script.open(filename)) {
+		std::cout << "> ERROR: Cannot open " << filename << " for saving." << std::endl;
 		return false;
 	}
 
-	script.writeLine(fmt::format("# House data-file: {:d}-{:s}", house->getId(), house->getName()));
-	script.writeLine();
-
-	for (Tile* tile : house->getTiles()) {
-		script.writePosition(tile->getPosition());
-		script.writeText(": ");
-		script.writeText("{");
+	writeHouseItems(house, script);
+	script.close();
+	return true;
+}
 
-		if (const auto& items = tile->getItemList()) {
-			std::vector<Item*> houseItems;
-			for (auto item : std::ranges::reverse_view(*items)) {
-				if (!item->isHouseItem()) {
-					continue;
-				}
+void IOMap::loadBedSleepers()
+{
+	std::ifstream file(BED_SLEEPERS_FILENAME, std::ios::binary);
+	if (file.is_open()) {
+		std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
-				houseItems.push_back(item);
+		PropStream propStream;
+		propStream.init(content.data(), content.size());
+
+		uint32_t guid;
+		int64_t start;
+		uint8_t sex;
+		Position pos;
+		while (propStream.read<uint32_t>(guid) && propStream.read<int64_t>(start) && propStream.read<uint8_t>(sex) &&
+		       propStream.read<uint16_t>(pos.x) && propStream.read<uint16_t>(pos.y) && propStream.read<uint8_t>(pos.z)) {
+			Tile* tile = g_game.map.getTile(pos);
+			BedItem* bed = tile ? tile->getBedItem() : nullptr;
+			if (!bed || !bed->getHouse() || bed->getSleeper() != 0 || g_game.getBedBySleeper(guid) || sex > PLAYERSEX_LAST) {
+				continue;
 			}
 
-			for (auto it = houseItems.begin(); it != houseItems.end();) {
-				Item* item = *it;
-				item->serializeTVPFormat(script);
-				if (++it != houseItems.end()) {
-					script.writeText(", ");
-				}
+			const std::string name = IOLoginData::getNameByGuid(guid);
+			if (!name.empty()) {
+				bed->restoreSleeper(guid, name, static_cast<PlayerSex_t>(sex), static_cast<time_t>(start));
 			}
 		}
+	}
 
-		// End of tile items
-		script.writeText("}");
-		script.writeLine();
+	// sleepers read from older house files are kept in the beds file from now on
+	saveBedSleepers();
+}
+
+void IOMap::saveBedSleepers()
+{
+	PropWriteStream propWriteStream;
+	for (const auto& it : g_game.getBedSleepers()) {
+		const BedItem* bed = it.second;
+		const Position& pos = bed->getPosition();
+		propWriteStream.write<uint32_t>(it.first);
+		propWriteStream.write<int64_t>(bed->getSleepStart());
+		propWriteStream.write<uint8_t>(bed->getSleeperSex());
+		propWriteStream.write<uint16_t>(pos.x);
+		propWriteStream.write<uint16_t>(pos.y);
+		propWriteStream.write<uint8_t>(pos.z);
 	}
 
-	script.close();
-	return true;
+	size_t size;
+	const char* data = propWriteStream.getStream(size);
+	g_fileTasks.writeFile(BED_SLEEPERS_FILENAME, std::string(data, size));
 }
 
 bool IOMap::parseMapDataAttributes(OTB::Loader& loader, const OTB::Node& mapNode, Map& map, const std::string& fileName)
@@ -758,163 +1472,31 @@ bool IOMap::parseTowns(OTB::Loader& loader, const OTB::Node& townsNode, Map& map
 	return true;
 }
 
-bool IOMap::parseTileArea(OTB::Loader& loader, const OTB::Node& tileAreaNode, Map& map, bool replaceExistingTiles)
+bool IOMap::placeTileArea(DecodedTileArea& area, Map& map, bool replaceExistingTiles)
 {
-	PropStream propStream;
-	if (!loader.getProps(tileAreaNode, propStream)) {
-		setLastErrorString("Invalid map node.");
-		return false;
-	}
-
-	OTBM_Destination_coords area_coord;
-	if (!propStream.read(area_coord)) {
-		setLastErrorString("Invalid map node.");
-		return false;
-	}
-
-	uint16_t base_x = area_coord.x;
-	uint16_t base_y = area_coord.y;
-	uint16_t z = area_coord.z;
-
-	for (auto& tileNode : tileAreaNode.children) {
-		if (tileNode.type != OTBM_TILE && tileNode.type != OTBM_HOUSETILE) {
-			setLastErrorString("Unknown tile node.");
-			return false;
-		}
-
-		if (!loader.getProps(tileNode, propStream)) {
-			setLastErrorString("Could not read node data.");
-			return false;
-		}
-
-		OTBM_Tile_coords tile_coord;
-		if (!propStream.read(tile_coord)) {
-			setLastErrorString("Could not read tile position.");
-			return false;
-		}
-
-		uint16_t x = base_x + tile_coord.x;
-		uint16_t y = base_y + tile_coord.y;
+	for (DecodedTile& decodedTile : area.tiles) {
+		uint16_t x = decodedTile.x;
+		uint16_t y = decodedTile.y;
+		uint16_t z = area.z;
 
 		bool allowDecay = map.getTile(x, y, z) == nullptr || replaceExistingTiles;
-		bool isHouseTile = false;
-		House* house = nullptr;
 		Tile* tile = nullptr;
 		Item* ground_item = nullptr;
-		uint32_t tileflags = TILESTATE_NONE;
 
-		if (tileNode.type == OTBM_HOUSETILE) {
-			uint32_t houseId;
-			if (!propStream.read<uint32_t>(houseId)) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not read house id.", x, y, z));
-				return false;
-			}
-
-			house = map.houses.addHouse(houseId);
+		if (decodedTile.isHouseTile) {
+			House* house = map.houses.addHouse(decodedTile.houseId);
 			if (!house) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not create house id: {:d}", x, y, z, houseId));
+				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Could not create house id: {:d}", x, y, z, decodedTile.houseId));
 				return false;
 			}
 
 			tile = new Tile (x, y, z);
 			tile->setHouse(house);
 			house->addTile(tile);
-			isHouseTile = true;
-		}
-
-		uint8_t attribute;
-		//read tile attributes
-		while (propStream.read<uint8_t>(attribute)) {
-			switch (attribute) {
-				case OTBM_ATTR_TILE_FLAGS: {
-					uint32_t flags;
-					if (!propStream.read<uint32_t>(flags)) {
-						setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to read tile flags.", x, y, z));
-						return false;
-					}
-
-					if ((flags & OTBM_TILEFLAG_PROTECTIONZONE) != 0) {
-						tileflags |= TILESTATE_PROTECTIONZONE;
-					} 
-					
-					// cannot be both
-					if ((flags & OTBM_TILEFLAG_NOPVPZONE) != 0) {
-						tileflags |= TILESTATE_NOPVPZONE;
-					} else if ((flags & OTBM_TILEFLAG_PVPZONE) != 0) {
-						tileflags |= TILESTATE_PVPZONE;
-					} 
-					
-					if ((flags & OTBM_TILEFLAG_REFRESH) != 0) {
-						tileflags |= TILESTATE_REFRESH;
-					}
-
-					if ((flags & OTBM_TILEFLAG_NOLOGOUT) != 0) {
-						tileflags |= TILESTATE_NOLOGOUT;
-					}
-
-					break;
-				}
-
-				case OTBM_ATTR_ITEM: {
-					Item* item = Item::CreateItem(propStream);
-					if (!item) {
-						setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z));
-						return false;
-					}
-
-					if (item->getItemCount() == 0) {
-						item->setItemCount(1);
-					}
-
-					if (tile) {
-						tile->internalAddThing(item);
-						if (allowDecay) {
-							item->startDecaying();
-						}
-					} else if (item->isGroundTile()) {
-						delete ground_item;
-						ground_item = item;
-					} else {
-						tile = createTile(ground_item, x, y, z);
-						tile->internalAddThing(item);
-						item->startDecaying();
-					}
-					break;
-				}
-
-				default:
-					setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown tile attribute.", x, y, z));
-					return false;
-			}
 		}
 
-		for (auto& itemNode : tileNode.children) {
-			if (itemNode.type != OTBM_ITEM) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Unknown node type.", x, y, z));
-				return false;
-			}
-
-			PropStream stream;
-			if (!loader.getProps(itemNode, stream)) {
-				setLastErrorString("Invalid item node.");
-				return false;
-			}
-
-			Item* item = Item::CreateItem(stream);
-			if (!item) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to create item.", x, y, z));
-				return false;
-			}
-
-			if (!item->unserializeItemNode(loader, itemNode, stream)) {
-				setLastErrorString(fmt::format("[x:{:d}, y:{:d}, z:{:d}] Failed to load item {:d}.", x, y, z, item->getID()));
-				delete item;
-				return false;
-			}
-
-			if (item->getItemCount() == 0) {
-				item->setItemCount(1);
-			}
+		for (Item* item : decodedTile.items) {
+			Item::registerLoadedItem(item);
 
 			if (tile) {
 				tile->internalAddThing(item);
@@ -930,15 +1512,230 @@ bool IOMap::parseTileArea(OTB::Loader& loader, const OTB::Node& tileAreaNode, Ma
 				item->startDecaying();
 			}
 		}
+		decodedTile.items.clear();
 
 		if (!tile) {
 			tile = createTile(ground_item, x, y, z);
 		}
 
-		tile->setFlag(static_cast<tileflags_t>(tileflags));
+		tile->setFlag(static_cast<tileflags_t>(decodedTile.flags));
 		tile->makeRefreshItemList();
 
 		map.setTile(x, y, z, tile, replaceExistingTiles);
 	}
 	return true;
-}
\ No newline at end of file
+}
+
+namespace {
+
+constexpr uint32_t PATCH_TILE_FLAGS = TILESTATE_PROTECTIONZONE | TILESTATE_NOPVPZONE | TILESTATE_PVPZONE | TILESTATE_NOLOGOUT | TILESTATE_REFRESH;
+
+// the ground a decoded tile ends up with, the last one in file order
+Item* getDecodedGround(const DecodedTile& decodedTile)
+{
+	Item* ground = nullptr;
+	for (Item* item : decodedTile.items) {
+		if (item->isGroundTile()) {
+			ground = item;
+		}
+	}
+	return ground;
+}
+
+bool isSameItem(const Item* item, const Item* otherItem)
+{
+	return item->equals(otherItem) && item->getItemCount() == otherItem->getItemCount();
+}
+
+// whether the live tile already holds what the patch has for it, the order of the items aside
+bool isSameTile(const Tile* tile, const DecodedTile& decodedTile)
+{
+	if ((tile->getFlags() & PATCH_TILE_FLAGS) != decodedTile.flags) {
+		return false;
+	}
+
+	const Item* ground = getDecodedGround(decodedTile);
+	const Item* liveGround = tile->getGround();
+	if (!ground || !liveGround) {
+		if (ground != liveGround) {
+			return false;
+		}
+	} else if (!isSameItem(ground, liveGround)) {
+		return false;
+	}
+
+	std::vector<const Item*> liveItems;
+	if (const TileItemVector* items = tile->getItemList()) {
+		liveItems.assign(items->begin(), items->end());
+	}
+
+	for (const Item* item : decodedTile.items) {
+		if (item->isGroundTile()) {
+			continue;
+		}
+
+		auto it = std::find_if(liveItems.begin(), liveItems.end(), [item](const Item* liveItem) { return isSameItem(item, liveItem); });
+		if (it == liveItems.end()) {
+			return false;
+		}
+		liveItems.erase(it);
+	}
+	return liveItems.empty();
+}
+
+}
+
+MapPatch::MapPatch(std::string fileName) : fileName(std::move(fileName)) {}
+
+MapPatch::~MapPatch() = default;
+
+bool MapPatch::decode()
+{
+	try {
+		OTB::Loader loader{fileName, OTB::Identifier{{'O', 'T', 'B', 'M'}}};
+		auto& root = loader.parseTree();
+
+		PropStream propStream;
+		OTBM_root_header root_header;
+		if (!loader.getProps(root, propStream) || !propStream.read(root_header)) {
+			error = "Could not read header.";
+			return false;
+		}
+
+		if (root_header.version == 0 || root_header.version > 2) {
+			error = "Unsupported OTBM version.";
+			return false;
+		}
+
+		if (root.children.size() != 1 || root.children[0].type != OTBM_MAP_DATA) {
+			error = "Could not read data node.";
+			return false;
+		}
+
+		// towns, waypoints and the spawn and house files are left as they are
+		std::vector<const OTB::Node*> tileAreaNodes;
+		for (auto& mapDataNode : root.children[0].children) {
+			if (mapDataNode.type == OTBM_TILE_AREA) {
+				tileAreaNodes.push_back(&mapDataNode);
+			}
+		}
+
+		areas = std::vector<DecodedTileArea>(tileAreaNodes.size());
+
+		Item::deferGameRegistration = true;
+		for (size_t i = 0; i < tileAreaNodes.size(); ++i) {
+			if (!decodeTileArea(loader, *tileAreaNodes[i], areas[i])) {
+				error = std::move(areas[i].error);
+				break;
+			}
+		}
+	} catch (const OTB::InvalidOTBFormat& err) {
+		error = err.what();
+	} catch (const std::exception& err) {
+		// the file went away or cannot be mapped, this runs on the file thread where nothing else catches it
+		error = err.what();
+	}
+	Item::deferGameRegistration = false;
+
+	if (!error.empty()) {
+		areas.clear();
+		return false;
+	}
+	return true;
+}
+
+bool MapPatch::applyBatch(Map& map, size_t maxTiles)
+{
+	size_t batchTiles = 0;
+	while (areaIndex < areas.size()) {
+		DecodedTileArea& area = areas[areaIndex];
+		while (tileIndex < area.tiles.size()) {
+			if (batchTiles++ == maxTiles) {
+				return true;
+			}
+			applyTile(map, area.tiles[tileIndex++], area.z);
+		}
+
+		// what was not placed is deleted with the area
+		area.tiles.clear();
+		++areaIndex;
+		tileIndex = 0;
+	}
+	return false;
+}
+
+void MapPatch::applyTile(Map& map, DecodedTile& decodedTile, uint16_t z)
+{
+	const uint16_t x = decodedTile.x;
+	const uint16_t y = decodedTile.y;
+
+	Tile* tile = map.getTile(x, y, z);
+	if (decodedTile.isHouseTile || (tile && tile->getHouse())) {
+		++houseTiles;
+		return;
+	}
+
+	if (tile && isSameTile(tile, decodedTile)) {
+		++unchangedTiles;
+		return;
+	}
+
+	const bool newTile = !tile;
+	if (newTile) {
+		tile = new Tile(x, y, z);
+	} else {
+		tile->cleanItems();
+		tile->resetFlag(PATCH_TILE_FLAGS);
+	}
+
+	Item* ground = getDecodedGround(decodedTile);
+	for (Item* item : decodedTile.items) {
+		if (item->isGroundTile() && item != ground) {
+			delete item;
+			continue;
+		}
+
+		Item::registerLoadedItem(item);
+		tile->internalAddThing(item);
+		item->startDecaying();
+	}
+	decodedTile.items.clear();
+
+	tile->setFlag(decodedTile.flags);
+	tile->makeRefreshItemList();
+
+	if (newTile) {
+		map.setTile(x, y, z, tile, false);
+	} else {
+		if (tile->hasFlag(TILESTATE_REFRESH)) {
+			g_game.addTileToRefresh(tile);
+		}
+		g_game.addTileToSave(tile);
+		tile->updateFloorMasks();
+
+		// the creatures stay unless the tile cannot hold them anymore
+		if (!tile->getGround() || tile->hasFlag(TILESTATE_BLOCKSOLID)) {
+			if (const CreatureVector* creatures = tile->getCreatures()) {
+				for (int32_t i = creatures->size(); --i >= 0;) {
+					if (Player* player = (*creatures)[i]->getPlayer()) {
+						g_game.internalTeleport(player, player->getTown()->getTemplePosition(), false, FLAG_NOLIMIT);
+					} else {
+						g_game.removeCreature((*creatures)[i]);
+					}
+				}
+			}
+		}
+	}
+
+	// the items were added internally, the next map save would not know the tile changed
+	g_game.addTileToSaveJournal(tile);
+
+	const Position& pos = tile->getPosition();
+	SpectatorVec spectators;
+	map.getSpectators(spectators, pos, true, true);
+	for (Creature* spectator : spectators) {
+		spectator->getPlayer()->sendUpdateTile(tile, pos);
+	}
+
+	++changedTiles;
+}
@@ -100,6 +100,9 @@ enum MapDataLoadResult_t : uint8_t
 };
 
 
+struct DecodedTile;
+struct DecodedTileArea;
+
 class IOMap
 {
 	static Tile* createTile(Item*& ground, uint16_t x, uint16_t y, uint8_t z);
@@ -144,12 +147,18 @@ class IOMap
 
 		static bool saveMapData();
 		static bool saveHouseItems();
+		// the next saveMapData writes a full snapshot, the last one written may not be on disk
+		static void discardSavedMapData();
 
 		static bool loadHouseDatabaseInformation();
 		static bool saveHouseDatabaseInformation();
 
 		static bool saveHouseTVPFormat(const House* house);
 
+		// sleepers are kept apart from the house files: guid, sleep start, sex and bed position per record
+		static void loadBedSleepers();
+		static void saveBedSleepers();
+
 		const std::string& getLastErrorString() const {
 			return errorString;
 		}
@@ -162,7 +171,60 @@ class IOMap
 		bool parseMapDataAttributes(OTB::Loader& loader, const OTB::Node& mapNode, Map& map, const std::string& fileName);
 		bool parseWaypoints(OTB::Loader& loader, const OTB::Node& waypointsNode, Map& map);
 		bool parseTowns(OTB::Loader& loader, const OTB::Node& townsNode, Map& map);
-		bool parseTileArea(OTB::Loader& loader, const OTB::Node& tileAreaNode, Map& map, bool replaceExistingTiles = false);
+		bool placeTileArea(DecodedTileArea& area, Map& map, bool replaceExistingTiles);
 
 		std::string errorString;
 };
+
+/*
+ * A map part decoded away from the dispatcher and applied to the live map a batch of tiles at a
+ * time. Tiles equal to the live ones are left alone, house tiles are never touched. The creatures
+ * of a tile that cannot hold them anymore are moved away and the spectators get the new tiles.
+ */
+class MapPatch
+{
+	public:
+		static constexpr size_t BATCH_TILES = 256;
+
+		explicit MapPatch(std::string fileName);
+		~MapPatch();
+
+		// non-copyable
+		MapPatch(const MapPatch&) = delete;
+		MapPatch& operator=(const MapPatch&) = delete;
+
+		// reads the tile areas of the file, any thread
+		bool decode();
+		// applies the next tiles, returns whether some are left
+		bool applyBatch(Map& map, size_t maxTiles = BATCH_TILES);
+
+		const std::string& getFileName() const {
+			return fileName;
+		}
+		const std::string& getError() const {
+			return error;
+		}
+
+		size_t getChangedTiles() const {
+			return changedTiles;
+		}
+		size_t getUnchangedTiles() const {
+			return unchangedTiles;
+		}
+		size_t getHouseTiles() const {
+			return houseTiles;
+		}
+
+	private:
+		void applyTile(Map& map, DecodedTile& decodedTile, uint16_t z);
+
+		std::string fileName;
+		std::string error;
+		std::vector<DecodedTileArea> areas;
+		size_t areaIndex = 0;
+		size_t tileIndex = 0;
+
+		size_t changedTiles = 0;
+		size_t unchangedTiles = 0;
+		size_t houseTiles = 0;
+};
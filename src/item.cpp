@@ -16,6 +16,8 @@
 #include "scriptwriter.h"
 #include "iomap.h"
 
+#include "lockfree.h"
+
 #include <fmt/format.h>
 
 extern Game g_game;
@@ -24,6 +26,44 @@ extern Vocations g_vocations;
 
 Items Item::items;
 
+namespace {
+
+// plain items and everything up to the size of a container (corpses, fields, teleports, doors) get their own chunk sizes
+using ItemPool = LockfreeObjectPool<Item, sizeof(Item), 16384>;
+using ContainerPool = LockfreeObjectPool<Container, sizeof(Container), 4096>;
+using ItemAttributesPool = LockfreeObjectPool<ItemAttributes, sizeof(ItemAttributes), 16384>;
+
+}
+
+void* Item::operator new(size_t size)
+{
+	if (ItemPool::isPooled(size)) {
+		return ItemPool::allocate(size);
+	}
+	return ContainerPool::allocate(size);
+}
+
+void Item::operator delete(void* p, size_t size)
+{
+	if (ItemPool::isPooled(size)) {
+		ItemPool::deallocate(p, size);
+	} else {
+		ContainerPool::deallocate(p, size);
+	}
+}
+
+void* ItemAttributes::operator new(size_t size)
+{
+	return ItemAttributesPool::allocate(size);
+}
+
+void ItemAttributes::operator delete(void* p, size_t size)
+{
+	ItemAttributesPool::deallocate(p, size);
+}
+
+thread_local bool Item::deferGameRegistration = false;
+
 Item* Item::CreateItem(const uint16_t type, uint16_t count /*= 0*/)
 {
 	Item* newItem = nullptr;
@@ -95,6 +135,8 @@ Item* Item::CreateItem(ScriptReader& scriptReader)
 Item::Item(const uint16_t type, uint16_t count /*= 0*/) :
 	id(type)
 {
+	ItemTypeCounter::onCreate(id);
+
 	const ItemType& it = items[id];
 
 	if (it.isFluidContainer() || it.isSplash()) {
@@ -121,6 +163,8 @@ Item::Item(const uint16_t type, uint16_t count /*= 0*/) :
 Item::Item(const Item& i) :
 	Thing(), id(i.id), count(i.count)
 {
+	ItemTypeCounter::onCreate(id);
+
 	if (i.attributes) {
 		attributes.reset(new ItemAttributes(*i.attributes));
 	}
@@ -131,10 +175,9 @@ Item* Item::clone() const
 	Item* item = Item::CreateItem(id, count);
 	if (attributes) {
 		item->attributes.reset(new ItemAttributes(*attributes));
-		if (item->getDuration() > 0) {
-			item->incrementReferenceCounter();
-			item->setDecaying(DECAYING_TRUE);
-			g_game.toDecayItems.push_front(item);
+		if (uint32_t duration = getDuration(); duration > 0) {
+			item->setDuration(duration);
+			g_game.scheduleDecay(item);
 		}
 	}
 
@@ -202,9 +245,44 @@ void Item::onRemoved()
 	}
 }
 
+void Item::setDuration(int32_t time)
+{
+	uint32_t remaining;
+	if (getDecaying() == DECAYING_TRUE && g_game.getDecayRemaining(this, remaining)) {
+		// already decaying, it now expires once the new duration has passed
+		g_game.stopDecay(this);
+		setIntAttr(ITEM_ATTRIBUTE_DURATION, time);
+		g_game.scheduleDecay(this);
+		return;
+	}
+	setIntAttr(ITEM_ATTRIBUTE_DURATION, time);
+}
+
+uint32_t Item::getDuration() const
+{
+	if (!attributes) {
+		return 0;
+	}
+
+	uint32_t remaining;
+	if (getDecaying() == DECAYING_TRUE && g_game.getDecayRemaining(this, remaining)) {
+		return remaining;
+	}
+	return getIntAttr(ITEM_ATTRIBUTE_DURATION);
+}
+
+void Item::setDecaying(ItemDecayState_t decayState)
+{
+	if (decayState == DECAYING_FALSE) {
+		g_game.stopDecay(this);
+	}
+	setIntAttr(ITEM_ATTRIBUTE_DECAYSTATE, decayState);
+}
+
 void Item::setID(uint16_t newid)
 {
 	const ItemType& prevIt = Item::items[id];
+	ItemTypeCounter::onTransform(id, newid);
 	id = newid;
 
 	const ItemType& it = Item::items[newid];
@@ -411,7 +489,7 @@ bool Item::unserializeTVPFormat(ScriptReader& script)
 			break;
 		}
 
-		std::string identifier = script.getIdentifier();
+		std::string identifier(script.getIdentifier());
 		script.readSymbol('=');
 		if (identifier == "amount") {
 			setItemCount(script.readNumber());
@@ -507,13 +585,13 @@ bool Item::unserializeTVPFormat(ScriptReader& script)
 			boost::variant<std::string, int64_t, bool, double> value;
 			switch (script.getToken()) {
 				case TOKEN_IDENTIFIER:
-					value = script.getIdentifier();
+					value = std::string(script.getIdentifier());
 					break;
 				case TOKEN_NUMBER:
 					value = script.getNumber();
 					break;
 				case TOKEN_STRING:
-					value = script.getString();
+					value = std::string(script.getString());
 					break;
 				default:
 					script.error("expected identifier, boolean, number or string attribute value");
@@ -562,116 +640,122 @@ bool Item::unserializeTVPFormat(ScriptReader& script)
 
 void Item::serializeTVPFormat(ScriptWriter& script) const
 {
-	script.writeNumber(getID());
+	// beds are written free, their sleepers are kept in the beds file so sleeping leaves the house file untouched
+	const BedItem* bed = getBed();
+	if (bed && items[id].transformToFree != 0) {
+		script.writeNumber(items[id].transformToFree);
+	} else {
+		script.writeNumber(getID());
+	}
 
 	const ItemType& it = items[id];
 	if (it.stackable) {
-		script.writeText(fmt::format(" Amount={:d}", getItemCount()));
+		script.writeFormatted(" Amount={:d}", getItemCount());
 	}
 
 	if (it.isFluidContainer() || it.isSplash()) {
-		script.writeText(fmt::format(" FluidType={:d}", getSubType()));
+		script.writeFormatted(" FluidType={:d}", getSubType());
 	}
 
 	if (getCharges() != 0) {
-		script.writeText(fmt::format(" Charges={:d}", getCharges()));
+		script.writeFormatted(" Charges={:d}", getCharges());
 	}
 
 	if (getActionId() != 0) {
-		script.writeText(fmt::format(" ActionID={:d}", getActionId()));
+		script.writeFormatted(" ActionID={:d}", getActionId());
 	}
 
 	if (!getText().empty()) {
-		script.writeText(fmt::format(" Text=\"{:s}\"", ScriptWriter::prepString(getText())));
+		script.writeFormatted(" Text=\"{:s}\"", ScriptWriter::escape(getText()));
 	}
 
 	if (getDate() != 0) {
-		script.writeText(fmt::format(" WrittenDate={:d}", getDate()));
+		script.writeFormatted(" WrittenDate={:d}", getDate());
 	}
 
 	if (!getWriter().empty()) {
-		script.writeText(fmt::format(" WrittenBy=\"{:s}\"", ScriptWriter::prepString(getWriter())));
+		script.writeFormatted(" WrittenBy=\"{:s}\"", ScriptWriter::escape(getWriter()));
 	}
 
-	if (!getSpecialDescription().empty()) {
-		script.writeText(fmt::format(" Description=\"{:s}\"", ScriptWriter::prepString(getSpecialDescription())));
+	if (!getSpecialDescription().empty() && !(bed && bed->getSleeper() != 0)) {
+		script.writeFormatted(" Description=\"{:s}\"", ScriptWriter::escape(getSpecialDescription()));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DURATION)) {
-		script.writeText(fmt::format(" Duration={:d}", getIntAttr(ITEM_ATTRIBUTE_DURATION)));
+		script.writeFormatted(" Duration={:d}", getDuration());
 	}
 
 	ItemDecayState_t decayState = getDecaying();
 	if (decayState == DECAYING_TRUE || decayState == DECAYING_PENDING) {
-		script.writeText(fmt::format(" DecayState={:d}", tvp::to_underlying(decayState)));
+		script.writeFormatted(" DecayState={:d}", tvp::to_underlying(decayState));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_NAME)) {
-		script.writeText(fmt::format(" Name=\"{:s}\"", getStrAttr(ITEM_ATTRIBUTE_NAME)));
+		script.writeFormatted(" Name=\"{:s}\"", getStrAttr(ITEM_ATTRIBUTE_NAME));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_PLURALNAME)) {
-		script.writeText(fmt::format(" PluralName=\"{:s}\"", getStrAttr(ITEM_ATTRIBUTE_PLURALNAME)));
+		script.writeFormatted(" PluralName=\"{:s}\"", getStrAttr(ITEM_ATTRIBUTE_PLURALNAME));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_ARTICLE)) {
-		script.writeText(fmt::format(" Article=\"{:s}\"", getStrAttr(ITEM_ATTRIBUTE_ARTICLE)));
+		script.writeFormatted(" Article=\"{:s}\"", getStrAttr(ITEM_ATTRIBUTE_ARTICLE));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_WEIGHT)) {
-		script.writeText(fmt::format(" Weight={:d}", getIntAttr(ITEM_ATTRIBUTE_WEIGHT)));
+		script.writeFormatted(" Weight={:d}", getIntAttr(ITEM_ATTRIBUTE_WEIGHT));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_ATTACK)) {
-		script.writeText(fmt::format(" Attack={:d}", getIntAttr(ITEM_ATTRIBUTE_ATTACK)));
+		script.writeFormatted(" Attack={:d}", getIntAttr(ITEM_ATTRIBUTE_ATTACK));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_ATTACK_SPEED)) {
-		script.writeText(fmt::format(" AttackSpeed={:d}", getIntAttr(ITEM_ATTRIBUTE_ATTACK_SPEED)));
+		script.writeFormatted(" AttackSpeed={:d}", getIntAttr(ITEM_ATTRIBUTE_ATTACK_SPEED));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DEFENSE)) {
-		script.writeText(fmt::format(" Defense={:d}", getIntAttr(ITEM_ATTRIBUTE_DEFENSE)));
+		script.writeFormatted(" Defense={:d}", getIntAttr(ITEM_ATTRIBUTE_DEFENSE));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_EXTRADEFENSE)) {
-		script.writeText(fmt::format(" ExtraDefense={:d}", getIntAttr(ITEM_ATTRIBUTE_EXTRADEFENSE)));
+		script.writeFormatted(" ExtraDefense={:d}", getIntAttr(ITEM_ATTRIBUTE_EXTRADEFENSE));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_ARMOR)) {
-		script.writeText(fmt::format(" Armor={:d}", getIntAttr(ITEM_ATTRIBUTE_ARMOR)));
+		script.writeFormatted(" Armor={:d}", getIntAttr(ITEM_ATTRIBUTE_ARMOR));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_HITCHANCE)) {
-		script.writeText(fmt::format(" HitChance={:d}", getIntAttr(ITEM_ATTRIBUTE_HITCHANCE)));
+		script.writeFormatted(" HitChance={:d}", getIntAttr(ITEM_ATTRIBUTE_HITCHANCE));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_SHOOTRANGE)) {
-		script.writeText(fmt::format(" ShootRange={:d}", getIntAttr(ITEM_ATTRIBUTE_SHOOTRANGE)));
+		script.writeFormatted(" ShootRange={:d}", getIntAttr(ITEM_ATTRIBUTE_SHOOTRANGE));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DECAYTO)) {
-		script.writeText(fmt::format(" DecayTo={:d}", getIntAttr(ITEM_ATTRIBUTE_DECAYTO)));
+		script.writeFormatted(" DecayTo={:d}", getIntAttr(ITEM_ATTRIBUTE_DECAYTO));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_KEYNUMBER)) {
-		script.writeText(fmt::format(" KeyNumber={:d}", getIntAttr(ITEM_ATTRIBUTE_KEYNUMBER)));
+		script.writeFormatted(" KeyNumber={:d}", getIntAttr(ITEM_ATTRIBUTE_KEYNUMBER));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_KEYHOLENUMBER)) {
-		script.writeText(fmt::format(" KeyHoleNumber={:d}", getIntAttr(ITEM_ATTRIBUTE_KEYHOLENUMBER)));
+		script.writeFormatted(" KeyHoleNumber={:d}", getIntAttr(ITEM_ATTRIBUTE_KEYHOLENUMBER));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DOORLEVEL)) {
-		script.writeText(fmt::format(" DoorLevel={:d}", getIntAttr(ITEM_ATTRIBUTE_DOORLEVEL)));
+		script.writeFormatted(" DoorLevel={:d}", getIntAttr(ITEM_ATTRIBUTE_DOORLEVEL));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DOORQUESTNUMBER)) {
-		script.writeText(fmt::format(" DoorQuestNumber={:d}", getIntAttr(ITEM_ATTRIBUTE_DOORQUESTNUMBER)));
+		script.writeFormatted(" DoorQuestNumber={:d}", getIntAttr(ITEM_ATTRIBUTE_DOORQUESTNUMBER));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DOORQUESTVALUE)) {
-		script.writeText(fmt::format(" DoorQuestValue={:d}", getIntAttr(ITEM_ATTRIBUTE_DOORQUESTVALUE)));
+		script.writeFormatted(" DoorQuestValue={:d}", getIntAttr(ITEM_ATTRIBUTE_DOORQUESTVALUE));
 	}
 
 	if (hasAttribute(ITEM_ATTRIBUTE_CUSTOM)) {
@@ -679,29 +763,23 @@ void Item::serializeTVPFormat(ScriptWriter& script) const
 		for (const auto& entry : *customAttrMap) {
 			// Serializing key type and value
 			if (entry.second.value.type() == typeid(std::string)) {
-				script.writeText(fmt::format(" CustomAttr=({:s}, \"{:s}\")", entry.first, boost::get<std::string>(entry.second.value)));
+				script.writeFormatted(" CustomAttr=({:s}, \"{:s}\")", entry.first, boost::get<std::string>(entry.second.value));
 			} else if (entry.second.value.type() == typeid(int64_t)) {
-				script.writeText(fmt::format(" CustomAttr=({:s}, {:d})", entry.first, boost::get<int64_t>(entry.second.value)));
+				script.writeFormatted(" CustomAttr=({:s}, {:d})", entry.first, boost::get<int64_t>(entry.second.value));
 			} else if (entry.second.value.type() == typeid(bool)) {
-				script.writeText(fmt::format(" CustomAttr=({:s}, {:d})", entry.first, boost::get<bool>(entry.second.value)));
+				script.writeFormatted(" CustomAttr=({:s}, {:d})", entry.first, boost::get<bool>(entry.second.value));
 			}
 		}
 	}
 
 	if (const Teleport* teleport = getTeleport()) {
 		const auto& destination = teleport->getDestPos();
-		script.writeText(fmt::format(" Destination=[{:d},{:d},{:d}]", destination.x, destination.y, destination.z));
-	}
-
-	if (const BedItem* bed = getBed()) {
-		if (bed->getSleeper()) {
-			script.writeText(fmt::format(" Sleeper={:d}", bed->getSleeper()));
-		}
+		script.writeFormatted(" Destination=[{:d},{:d},{:d}]", destination.x, destination.y, destination.z);
 	}
 
 	if (const Container* container = getContainer()) {
 		if (const DepotLocker* depotLocker = container->getDepotLocker()) {
-			script.writeText(fmt::format(" DepotID={:d}", depotLocker->getDepotId()));
+			script.writeFormatted(" DepotID={:d}", depotLocker->getDepotId());
 		}
 
 		script.writeText(" Content={");
@@ -1185,7 +1263,7 @@ void Item::serializeAttr(PropWriteStream& propWriteStream) const
 
 	if (hasAttribute(ITEM_ATTRIBUTE_DURATION)) {
 		propWriteStream.write<uint8_t>(ATTR_DURATION);
-		propWriteStream.write<uint32_t>(getIntAttr(ITEM_ATTRIBUTE_DURATION));
+		propWriteStream.write<uint32_t>(getDuration());
 	}
 
 	ItemDecayState_t decayState = getDecaying();
@@ -1327,6 +1405,19 @@ uint32_t Item::getWeight() const
 std::string Item::getDescription(const ItemType& it, int32_t lookDistance,
                                  const Item* item /*= nullptr*/, int32_t subType /*= -1*/, bool addArticle /*= true*/)
 {
+	// an item without attributes reads like any other of its type unless its count, fluid or contents show,
+	// the text only differs within reading distance and the weight and description at one tile
+	uint32_t cacheKey = 0;
+	if (item && addArticle && (!item->attributes || item->attributes->getList().empty()) &&
+			!it.stackable && !it.isFluidContainer() && !it.isSplash() && !it.isContainer()) {
+		cacheKey = (static_cast<uint32_t>(it.id) << 2) | (lookDistance <= 1 ? 1 : (lookDistance <= 4 ? 2 : 3));
+
+		auto cached = items.descriptionCache.find(cacheKey);
+		if (cached != items.descriptionCache.end()) {
+			return cached->second;
+		}
+	}
+
 	std::ostringstream s;
 	s << getNameDescription(it, item, subType, addArticle);
 
@@ -1496,6 +1587,9 @@ std::string Item::getDescription(const ItemType& it, int32_t lookDistance,
 		s << std::endl << it.description;
 	}
 
+	if (cacheKey != 0) {
+		return items.descriptionCache.emplace(cacheKey, s.str()).first->second;
+	}
 	return s.str();
 }
 
@@ -1593,11 +1687,30 @@ void Item::setUniqueId(uint16_t n)
 		return;
 	}
 
-	if (g_game.addUniqueItem(n, this)) {
+	if (deferGameRegistration || g_game.addUniqueItem(n, this)) {
 		getAttributes()->setUniqueId(n);
 	}
 }
 
+void Item::registerLoadedItem(Item* item)
+{
+	if (item->hasAttribute(ITEM_ATTRIBUTE_UNIQUEID) && !g_game.addUniqueItem(item->getUniqueId(), item)) {
+		item->removeAttribute(ITEM_ATTRIBUTE_UNIQUEID);
+	}
+
+	if (BedItem* bed = item->getBed()) {
+		if (bed->getSleeper() != 0) {
+			g_game.setBedSleeper(bed, bed->getSleeper());
+		}
+	}
+
+	if (Container* container = item->getContainer()) {
+		for (Item* containerItem : container->getItemList()) {
+			registerLoadedItem(containerItem);
+		}
+	}
+}
+
 bool Item::canDecay() const
 {
 	if (isRemoved()) {
@@ -7,9 +7,11 @@
 #include "thing.h"
 #include "items.h"
 #include "luascript.h"
+#include "memorystats.h"
 #include "tools.h"
 #include "scriptreader.h"
 
+#include <boost/container/small_vector.hpp>
 #include <boost/variant.hpp>
 #include <deque>
 
@@ -111,6 +113,10 @@ class ItemAttributes
 	public:
 		ItemAttributes() = default;
 
+		// attribute blocks are recycled through a free list, see item.cpp
+		static void* operator new(size_t size);
+		static void operator delete(void* p, size_t size);
+
 		void setSpecialDescription(const std::string& desc) {
 			setStrAttr(ITEM_ATTRIBUTE_DESCRIPTION, desc);
 		}
@@ -406,7 +412,12 @@ class ItemAttributes
 			}
 		};
 
-		std::vector<Attribute> attributes;
+		// the usual handful of attributes (charges, duration, decay state, action/unique id) lives inside the block itself,
+		// only strings and custom attributes allocate
+		static constexpr size_t INLINE_ATTRIBUTES = 3;
+		using AttributeList = boost::container::small_vector<Attribute, INLINE_ATTRIBUTES>;
+
+		AttributeList attributes;
 		uint32_t attributeBits = 0;
 
 		const std::string& getStrAttr(itemAttrTypes type) const;
@@ -511,7 +522,7 @@ class ItemAttributes
 			return (type & ITEM_ATTRIBUTE_CUSTOM) == type;
 		}
 
-		const std::vector<Attribute>& getList() const {
+		const AttributeList& getList() const {
 			return attributes;
 		}
 
@@ -528,12 +539,23 @@ class Item : virtual public Thing
 		static Item* CreateItem(ScriptReader& scriptReader);
 		static Items items;
 
+		// set on the threads the map loader decodes tile areas with, unique ids and bed sleepers read
+		// there are only stored on the item until registerLoadedItem hands them to the game in map order
+		static thread_local bool deferGameRegistration;
+		static void registerLoadedItem(Item* item);
+
 		// Constructor for items
 		Item(const uint16_t type, uint16_t count = 0);
 		Item(const Item& i);
 		virtual Item* clone() const;
 
-		virtual ~Item() = default;
+		virtual ~Item() {
+			ItemTypeCounter::onDestroy(id);
+		}
+
+		// items and containers are recycled through free lists instead of going back to the heap
+		static void* operator new(size_t size);
+		static void operator delete(void* p, size_t size);
 
 		// non-assignable
 		Item& operator=(const Item&) = delete;
@@ -617,6 +639,9 @@ class Item : virtual public Thing
 			}
 			return attributes->hasAttribute(type);
 		}
+		bool hasAttributes() const {
+			return attributes != nullptr;
+		}
 
 		template<typename R>
 		void setCustomAttribute(std::string& key, R value) {
@@ -763,22 +788,11 @@ class Item : virtual public Thing
 			return getIntAttr(ITEM_ATTRIBUTE_CORPSEOWNER);
 		}
 
-		void setDuration(int32_t time) {
-			setIntAttr(ITEM_ATTRIBUTE_DURATION, time);
-		}
-		void decreaseDuration(int32_t time) {
-			increaseIntAttr(ITEM_ATTRIBUTE_DURATION, -time);
-		}
-		uint32_t getDuration() const {
-			if (!attributes) {
-				return 0;
-			}
-			return getIntAttr(ITEM_ATTRIBUTE_DURATION);
-		}
+		// the decay wheel keeps the remaining time of decaying items, the attribute is only updated when they leave it
+		void setDuration(int32_t time);
+		uint32_t getDuration() const;
 
-		void setDecaying(ItemDecayState_t decayState) {
-			setIntAttr(ITEM_ATTRIBUTE_DECAYSTATE, decayState);
-		}
+		void setDecaying(ItemDecayState_t decayState);
 		ItemDecayState_t getDecaying() const {
 			if (!attributes) {
 				return DECAYING_FALSE;
@@ -1052,6 +1066,11 @@ class Item : virtual public Thing
 
 		uint8_t count = 1; // number of stacked items
 
+		// script environment that holds this item as temporary, if any
+		ScriptEnvironment* tempScriptEnv = nullptr;
+
+		friend class ScriptEnvironment;
+
 		//Don't add variables here, use the ItemAttribute class.
 };
 
@@ -7,11 +7,14 @@
 #include "spells.h"
 #include "movement.h"
 #include "weapons.h"
+#include "configmanager.h"
+#include "filetasks.h"
 
 #include "pugicast.h"
 
 extern MoveEvents* g_moveEvents;
 extern Weapons* g_weapons;
+extern ConfigManager g_config;
 
 const std::unordered_map<std::string, ItemParseAttributes_t> ItemParseAttributesMap = {
 	{"type", ITEM_PARSE_TYPE},
@@ -187,29 +190,291 @@ const std::unordered_map<std::string, FluidTypes_t> FluidTypesMap = {
 Items::Items()
 {
 	items.reserve(30000);
-	nameToItems.reserve(30000);
+	nameIndex.reserve(30000);
 }
 
 void Items::clear()
 {
 	items.clear();
 	clientIdToServerIdMap.clear();
-	nameToItems.clear();
+	nameIndex.clear();
 	inventory.clear();
+	descriptionCache.clear();
 }
 
 bool Items::reload()
 {
 	clear();
+	if (loadFromCache()) {
+		return true;
+	}
+
 	loadFromOtb("data/items/items.otb");
 
 	if (!loadFromXml()) {
 		return false;
 	}
 
+	saveToCache();
+	return true;
+}
+
+namespace {
+
+// data/items/items.cache: magic, version, layout sizes and the hashes of items.otb and items.xml,
+// then the otb versions, the client id map, every item type and the sorted name index
+// ITEMS_CACHE_VERSION must be raised whenever a member is added to visitItemType or ConditionDamage::serializeState
+constexpr uint32_t ITEMS_CACHE_MAGIC = 0x43495654; // TVIC
+constexpr uint16_t ITEMS_CACHE_VERSION = 1;
+
+const std::string ITEMS_CACHE_FILE = "data/items/items.cache";
+
+// the cache is rebuilt as soon as either source file changes
+bool hashFile(const std::string& filename, uint64_t& hash)
+{
+	OTB::MappedFile file;
+	try {
+		file.open(filename);
+	} catch (const std::exception&) {
+		return false;
+	}
+
+	hash = hashBytes(file.data(), file.size());
+	return true;
+}
+
+struct CacheWriter
+{
+	PropWriteStream& stream;
+
+	template <typename T>
+	void operator()(const T& value) {
+		stream.write<T>(value);
+	}
+	void operator()(const std::string& value) {
+		stream.writeString(value);
+	}
+};
+
+struct CacheReader
+{
+	PropStream& stream;
+	bool valid = true;
+
+	template <typename T>
+	void operator()(T& value) {
+		valid = valid && stream.read<T>(value);
+	}
+	void operator()(std::string& value) {
+		valid = valid && stream.readString(value);
+	}
+};
+
+// the same member list writes and reads the cache, abilities and conditionDamage are handled by the caller
+template <typename Archive, typename Type>
+void visitItemType(Archive& ar, Type& it)
+{
+	ar(it.group); ar(it.type); ar(it.id); ar(it.clientId); ar(it.stackable); ar(it.isAnimation);
+
+	ar(it.name); ar(it.article); ar(it.pluralName); ar(it.description); ar(it.runeSpellName); ar(it.vocationString);
+
+	ar(it.attackSpeed); ar(it.weight); ar(it.levelDoor); ar(it.decayTime); ar(it.wieldInfo); ar(it.minReqLevel);
+	ar(it.minReqMagicLevel); ar(it.charges); ar(it.decayTo); ar(it.attack); ar(it.defense); ar(it.extraDefense);
+	ar(it.armor); ar(it.rotateTo); ar(it.runeMagLevel); ar(it.runeLevel); ar(it.combatType);
+
+	ar(it.transformToOnUse[0]); ar(it.transformToOnUse[1]); ar(it.transformToFree); ar(it.destroyTo);
+	ar(it.maxTextLen); ar(it.writeOnceItemId); ar(it.transformEquipTo); ar(it.transformDeEquipTo);
+	ar(it.maxItems); ar(it.slotPosition); ar(it.speed); ar(it.wareId);
+
+	ar(it.magicEffect); ar(it.bedPartnerDir); ar(it.weaponType); ar(it.ammoType); ar(it.shootType);
+	ar(it.corpseType); ar(it.fluidSource);
+
+	ar(it.floorChange); ar(it.alwaysOnTopOrder); ar(it.lightLevel); ar(it.lightColor); ar(it.shootRange); ar(it.hitChance);
+
+	ar(it.specialFieldBlockPath); ar(it.replaceMagicFields); ar(it.forceUse); ar(it.forceSerialize); ar(it.hasHeight);
+	ar(it.blockSolid); ar(it.blockPickupable); ar(it.blockProjectile); ar(it.blockPathFind); ar(it.allowPickupable);
+	ar(it.showDuration); ar(it.showCharges); ar(it.showAttributes); ar(it.replaceable); ar(it.pickupable);
+	ar(it.rotatable); ar(it.useable); ar(it.moveable); ar(it.alwaysOnTop); ar(it.canReadText); ar(it.canWriteText);
+	ar(it.isVertical); ar(it.isHorizontal); ar(it.isHangable); ar(it.allowDistRead); ar(it.lookThrough);
+	ar(it.stopTime); ar(it.showCount);
+}
+
+void writeCacheHeader(PropWriteStream& stream, uint64_t otbHash, uint64_t xmlHash)
+{
+	stream.write<uint32_t>(ITEMS_CACHE_MAGIC);
+	stream.write<uint16_t>(ITEMS_CACHE_VERSION);
+	stream.write<uint32_t>(sizeof(ItemType));
+	stream.write<uint32_t>(sizeof(Abilities));
+	stream.write<uint64_t>(otbHash);
+	stream.write<uint64_t>(xmlHash);
+}
+
+}
+
+bool Items::loadFromCache()
+{
+	if (!g_config.getBoolean(ConfigManager::ITEMS_CACHE)) {
+		return false;
+	}
+
+	uint64_t otbHash, xmlHash;
+	if (!hashFile("data/items/items.otb", otbHash) || !hashFile("data/items/items.xml", xmlHash)) {
+		return false;
+	}
+
+	OTB::MappedFile file;
+	try {
+		file.open(ITEMS_CACHE_FILE);
+	} catch (const std::exception&) {
+		return false;
+	}
+
+	// the header is compared byte for byte, any change means the cache is stale
+	PropWriteStream header;
+	writeCacheHeader(header, otbHash, xmlHash);
+
+	size_t headerSize;
+	const char* headerBytes = header.getStream(headerSize);
+	if (file.size() < headerSize || memcmp(file.data(), headerBytes, headerSize) != 0) {
+		return false;
+	}
+
+	PropStream propStream;
+	propStream.init(file.data() + headerSize, file.size() - headerSize);
+
+	auto readCache = [&]() {
+		std::vector<uint16_t> serverIds;
+		uint32_t clientIds, itemCount, nameCount;
+		if (!propStream.read<uint32_t>(majorVersion) || !propStream.read<uint32_t>(minorVersion) ||
+			!propStream.read<uint32_t>(buildNumber) || !propStream.read<uint32_t>(clientIds)) {
+			return false;
+		}
+
+		serverIds.resize(clientIds);
+		for (uint16_t& serverId : serverIds) {
+			if (!propStream.read<uint16_t>(serverId)) {
+				return false;
+			}
+		}
+		clientIdToServerIdMap.assign(std::move(serverIds));
+
+		if (!propStream.read<uint32_t>(itemCount)) {
+			return false;
+		}
+
+		CacheReader reader{propStream};
+		for (uint32_t i = 0; i < itemCount; ++i) {
+			ItemType& it = items.emplace_back();
+			visitItemType(reader, it);
+
+			uint8_t hasAbilities, hasCondition;
+			if (!reader.valid || !propStream.read<uint8_t>(hasAbilities)) {
+				return false;
+			}
+
+			if (hasAbilities != 0) {
+				it.abilities.reset(new Abilities());
+				if (!propStream.read<Abilities>(*it.abilities)) {
+					return false;
+				}
+			}
+
+			if (!propStream.read<uint8_t>(hasCondition)) {
+				return false;
+			}
+
+			if (hasCondition != 0) {
+				ConditionId_t conditionId;
+				ConditionType_t conditionType;
+				if (!propStream.read<ConditionId_t>(conditionId) || !propStream.read<ConditionType_t>(conditionType)) {
+					return false;
+				}
+
+				it.conditionDamage.reset(new ConditionDamage(conditionId, conditionType));
+				if (!it.conditionDamage->unserializeState(propStream)) {
+					return false;
+				}
+			}
+		}
+
+		if (!propStream.read<uint32_t>(nameCount)) {
+			return false;
+		}
+
+		nameIndex.resize(nameCount);
+		for (NameEntry& entry : nameIndex) {
+			if (!propStream.readString(entry.name) || !propStream.read<uint16_t>(entry.id)) {
+				return false;
+			}
+		}
+		return propStream.size() == 0;
+	};
+
+	if (!readCache()) {
+		std::cout << "[Warning - Items::loadFromCache] " << ITEMS_CACHE_FILE << " is corrupted, it will be rebuilt." << std::endl;
+		clear();
+		return false;
+	}
+
+	buildInventoryList();
 	return true;
 }
 
+void Items::saveToCache() const
+{
+	if (!g_config.getBoolean(ConfigManager::ITEMS_CACHE)) {
+		return;
+	}
+
+	uint64_t otbHash, xmlHash;
+	if (!hashFile("data/items/items.otb", otbHash) || !hashFile("data/items/items.xml", xmlHash)) {
+		return;
+	}
+
+	PropWriteStream propWriteStream;
+	writeCacheHeader(propWriteStream, otbHash, xmlHash);
+
+	propWriteStream.write<uint32_t>(majorVersion);
+	propWriteStream.write<uint32_t>(minorVersion);
+	propWriteStream.write<uint32_t>(buildNumber);
+
+	const std::vector<uint16_t>& serverIds = clientIdToServerIdMap.getServerIds();
+	propWriteStream.write<uint32_t>(serverIds.size());
+	for (uint16_t serverId : serverIds) {
+		propWriteStream.write<uint16_t>(serverId);
+	}
+
+	CacheWriter writer{propWriteStream};
+	propWriteStream.write<uint32_t>(items.size());
+	for (const ItemType& it : items) {
+		visitItemType(writer, it);
+
+		propWriteStream.write<uint8_t>(it.abilities ? 1 : 0);
+		if (it.abilities) {
+			propWriteStream.writeBytes(reinterpret_cast<const char*>(it.abilities.get()), sizeof(Abilities));
+		}
+
+		propWriteStream.write<uint8_t>(it.conditionDamage ? 1 : 0);
+		if (it.conditionDamage) {
+			propWriteStream.write<ConditionId_t>(it.conditionDamage->getId());
+			propWriteStream.write<ConditionType_t>(it.conditionDamage->getType());
+			it.conditionDamage->serializeState(propWriteStream);
+		}
+	}
+
+	propWriteStream.write<uint32_t>(nameIndex.size());
+	for (const NameEntry& entry : nameIndex) {
+		propWriteStream.writeString(entry.name);
+		propWriteStream.write<uint16_t>(entry.id);
+	}
+
+	size_t size;
+	const char* data = propWriteStream.getStream(size);
+	if (!FileTasks::writeFileContents(ITEMS_CACHE_FILE, data, size)) {
+		std::cout << "[Warning - Items::saveToCache] Unable to write " << ITEMS_CACHE_FILE << std::endl;
+	}
+}
+
 constexpr auto OTBI = OTB::Identifier{{'O','T', 'B', 'I'}};
 
 bool Items::loadFromOtb(const std::string& file)
@@ -476,10 +741,41 @@ bool Items::loadFromXml()
 		}
 	}
 
+	buildNameIndex();
 	buildInventoryList();
 	return true;
 }
 
+namespace {
+
+struct NameEntryLess
+{
+	static bool less(std::string_view lhs, std::string_view rhs) {
+		return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char a, char b) {
+			return tolower(static_cast<unsigned char>(a)) < tolower(static_cast<unsigned char>(b));
+		});
+	}
+
+	bool operator()(const Items::NameEntry& lhs, std::string_view rhs) const {
+		return less(lhs.name, rhs);
+	}
+	bool operator()(std::string_view lhs, const Items::NameEntry& rhs) const {
+		return less(lhs, rhs.name);
+	}
+	bool operator()(const Items::NameEntry& lhs, const Items::NameEntry& rhs) const {
+		return lhs.name < rhs.name;
+	}
+};
+
+}
+
+void Items::buildNameIndex()
+{
+	// stable, so items sharing a name stay in the order items.xml lists them
+	std::stable_sort(nameIndex.begin(), nameIndex.end(), NameEntryLess());
+	nameIndex.shrink_to_fit();
+}
+
 void Items::buildInventoryList()
 {
 	inventory.reserve(items.size());
@@ -521,8 +817,8 @@ void Items::parseItemNode(const pugi::xml_node& itemNode, uint16_t id)
 
 	it.name = itemNode.attribute("name").as_string();
 
-	if (nameToItems.find(asLowerCaseString(it.name)) == nameToItems.end()) {
-		nameToItems.insert({ asLowerCaseString(it.name), id });
+	if (!it.name.empty()) {
+		nameIndex.push_back({asLowerCaseString(it.name), id});
 	}
 
 	pugi::xml_attribute articleAttribute = itemNode.attribute("article");
@@ -1333,12 +1629,16 @@ const ItemType& Items::getItemIdByClientId(uint16_t spriteId) const
 	return items.front();
 }
 
-uint16_t Items::getItemIdByName(const std::string& name)
+uint16_t Items::getItemIdByName(std::string_view name) const
 {
-	auto result = nameToItems.find(asLowerCaseString(name));
-
-	if (result == nameToItems.end())
+	NameRange range = getItemIdsByName(name);
+	if (range.first == range.second) {
 		return 0;
+	}
+	return range.first->id;
+}
 
-	return result->second;
+Items::NameRange Items::getItemIdsByName(std::string_view name) const
+{
+	return std::equal_range(nameIndex.cbegin(), nameIndex.cend(), name, NameEntryLess());
 }
@@ -367,9 +367,14 @@ class ItemType
 class Items
 {
 	public:
-		using NameMap = std::unordered_multimap<std::string, uint16_t>;
 		using InventoryVector = std::vector<uint16_t>;
 
+		struct NameEntry {
+			std::string name; // lower case
+			uint16_t id;
+		};
+		using NameRange = std::pair<std::vector<NameEntry>::const_iterator, std::vector<NameEntry>::const_iterator>;
+
 		Items();
 
 		// non-copyable
@@ -381,6 +386,11 @@ class Items
 
 		bool loadFromOtb(const std::string& file);
 
+		// data/items/items.cache holds the items built from items.otb and items.xml,
+		// it is only used while both files hash to the values it was written with
+		bool loadFromCache();
+		void saveToCache() const;
+
 		const ItemType& operator[](size_t id) const {
 			return getItemType(id);
 		}
@@ -388,7 +398,9 @@ class Items
 		ItemType& getItemType(size_t id);
 		const ItemType& getItemIdByClientId(uint16_t spriteId) const;
 
-		uint16_t getItemIdByName(const std::string& name);
+		// names are matched case insensitively, the first id is the one items.xml defines first
+		uint16_t getItemIdByName(std::string_view name) const;
+		NameRange getItemIdsByName(std::string_view name) const;
 
 		uint32_t majorVersion = 0;
 		uint32_t minorVersion = 0;
@@ -406,9 +418,15 @@ class Items
 			return items.size();
 		}
 
-		NameMap nameToItems;
+		// descriptions of items that read like any other of their type, by id and look distance class, see Item::getDescription
+		std::unordered_map<uint32_t, std::string> descriptionCache;
 
 	private:
+		void buildNameIndex();
+
+		// sorted by name once items.xml is loaded, lookups are a binary search without allocating
+		std::vector<NameEntry> nameIndex;
+
 		std::vector<ItemType> items;
 		InventoryVector inventory;
 		class ClientIdToServerIdMap
@@ -438,6 +456,13 @@ class Items
 				void clear() {
 					vec.clear();
 				}
+
+				const std::vector<uint16_t>& getServerIds() const {
+					return vec;
+				}
+				void assign(std::vector<uint16_t>&& serverIds) {
+					vec = std::move(serverIds);
+				}
 			private:
 				std::vector<uint16_t> vec;
 		} clientIdToServerIdMap;
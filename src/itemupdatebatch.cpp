@@ -0,0 +1,106 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "itemupdatebatch.h"
+#include "game.h"
+
+extern Game g_game;
+
+ItemUpdateBatch::ItemUpdateBatch() : outermost(current == nullptr)
+{
+	if (outermost) {
+		current = this;
+	}
+}
+
+ItemUpdateBatch::~ItemUpdateBatch()
+{
+	if (outermost) {
+		// whatever the sending changes goes out right away
+		current = nullptr;
+		send();
+	}
+}
+
+void ItemUpdateBatch::addContainerItem(Container* container, const Item* item)
+{
+	containerChanges.push_back({container, item, nullptr, CONTAINER_CHANGE_ADD});
+}
+
+void ItemUpdateBatch::updateContainerItem(Container* container, const Item* oldItem, const Item* newItem)
+{
+	containerChanges.push_back({container, oldItem, newItem, CONTAINER_CHANGE_UPDATE});
+}
+
+void ItemUpdateBatch::removeContainerItem(Container* container, const Item* item)
+{
+	containerChanges.push_back({container, item, nullptr, CONTAINER_CHANGE_REMOVE});
+}
+
+void ItemUpdateBatch::updateTile(Tile* tile)
+{
+	if (std::find(tiles.begin(), tiles.end(), tile) == tiles.end()) {
+		tiles.push_back(tile);
+	}
+}
+
+void ItemUpdateBatch::updateStats(Player* player)
+{
+	if (std::find(players.begin(), players.end(), player) == players.end()) {
+		players.push_back(player);
+	}
+}
+
+void ItemUpdateBatch::send()
+{
+	// grouped by container, the changes of each in the order they were made
+	std::stable_sort(containerChanges.begin(), containerChanges.end(), [](const ContainerChange& lhs, const ContainerChange& rhs) {
+		return lhs.container < rhs.container;
+	});
+
+	for (auto it = containerChanges.begin(); it != containerChanges.end();) {
+		Container* container = it->container;
+		auto end = std::find_if(it, containerChanges.end(), [container](const ContainerChange& change) { return change.container != container; });
+
+		// a container taken out of the world meanwhile closed for the players that had it open
+		if (!container->isRemoved()) {
+			SpectatorVec spectators;
+			g_game.map.getSpectators(spectators, container->getPosition(), false, true, 2, 2, 2, 2);
+
+			for (Creature* spectator : spectators) {
+				Player* player = spectator->getPlayer();
+				for (auto change = it; change != end; ++change) {
+					switch (change->change) {
+						case CONTAINER_CHANGE_ADD:
+							player->onAddContainerItem(change->item);
+							break;
+						case CONTAINER_CHANGE_UPDATE:
+							player->onUpdateContainerItem(container, change->item, change->newItem);
+							break;
+						case CONTAINER_CHANGE_REMOVE:
+							player->onRemoveContainerItem(container, change->item);
+							break;
+					}
+				}
+				player->onSendContainer(container);
+			}
+		}
+		it = end;
+	}
+
+	for (Tile* tile : tiles) {
+		const Position& tilePos = tile->getPosition();
+
+		SpectatorVec spectators;
+		g_game.map.getSpectators(spectators, tilePos, true, true);
+		for (Creature* spectator : spectators) {
+			spectator->getPlayer()->sendUpdateTile(tile, tilePos);
+		}
+	}
+
+	for (Player* player : players) {
+		player->sendStats();
+	}
+}
@@ -0,0 +1,62 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+class Container;
+class Item;
+class Player;
+class Tile;
+
+/*
+ * Coalesces the updates players are sent about items while one is alive, Game::internalMoveItems
+ * holds one around its moves. The containers and tiles changed meanwhile are sent whole, once each,
+ * to the players that see them when it ends, instead of a packet per item, and so are the stats of
+ * the players whose inventory changed. The trade checks of the container changes run then too, with
+ * one spectator lookup per container. Batches nest, the outermost one sends. Dispatcher thread only.
+ */
+class ItemUpdateBatch
+{
+	public:
+		ItemUpdateBatch();
+		~ItemUpdateBatch();
+
+		// non-copyable
+		ItemUpdateBatch(const ItemUpdateBatch&) = delete;
+		ItemUpdateBatch& operator=(const ItemUpdateBatch&) = delete;
+
+		// the batch the updates go to, nullptr when they are sent right away
+		static ItemUpdateBatch* getCurrent() {
+			return current;
+		}
+
+		void addContainerItem(Container* container, const Item* item);
+		void updateContainerItem(Container* container, const Item* oldItem, const Item* newItem);
+		void removeContainerItem(Container* container, const Item* item);
+		void updateTile(Tile* tile);
+		void updateStats(Player* player);
+
+	private:
+		enum ContainerChange_t : uint8_t {
+			CONTAINER_CHANGE_ADD,
+			CONTAINER_CHANGE_UPDATE,
+			CONTAINER_CHANGE_REMOVE,
+		};
+
+		struct ContainerChange {
+			Container* container;
+			const Item* item;
+			const Item* newItem;
+			ContainerChange_t change;
+		};
+
+		void send();
+
+		static inline ItemUpdateBatch* current = nullptr;
+
+		std::vector<ContainerChange> containerChanges;
+		std::vector<Tile*> tiles;
+		std::vector<Player*> players;
+		// a nested batch leaves the sending to the outer one
+		bool outermost;
+};
@@ -0,0 +1,179 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "jobpool.h"
+
+namespace {
+
+constexpr size_t NO_WORKER = std::numeric_limits<size_t>::max();
+
+// the worker the thread is, jobs it adds go to its own queue
+thread_local size_t currentWorker = NO_WORKER;
+
+}
+
+void JobPool::setWorkers(size_t count)
+{
+	workers = count;
+	queues.clear();
+	for (size_t i = 0; i < count; ++i) {
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+}
+
+void JobPool::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lockClass(signalLock);
+		setState(THREAD_STATE_TERMINATED);
+	}
+	jobSignal.notify_all();
+}
+
+void JobPool::addJob(JobGroup& group, std::function<void()>&& job)
+{
+	if (!isRunning()) {
+		job();
+		return;
+	}
+
+	group.pending.fetch_add(1, std::memory_order_relaxed);
+
+	// counted before it is queued, so the count never drops below the jobs in the queues
+	{
+		std::lock_guard<std::mutex> lockClass(signalLock);
+		queuedJobs.fetch_add(1, std::memory_order_release);
+	}
+
+	const size_t index = currentWorker != NO_WORKER ? currentWorker : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+	{
+		WorkerQueue& queue = *queues[index];
+		std::lock_guard<std::mutex> lockClass(queue.lock);
+		queue.jobs.push_back({std::move(job), &group});
+	}
+	jobSignal.notify_one();
+}
+
+void JobPool::wait(JobGroup& group)
+{
+	const size_t index = currentWorker != NO_WORKER ? currentWorker : 0;
+
+	Job job;
+	while (!group.isDone()) {
+		if (!queues.empty() && takeJob(index, job)) {
+			runJob(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> signalLockUnique(signalLock);
+		jobSignal.wait(signalLockUnique, [this, &group]() {
+			return group.isDone() || queuedJobs.load(std::memory_order_acquire) != 0;
+		});
+	}
+}
+
+void JobPool::parallelFor(size_t count, const std::function<void(size_t)>& func, size_t maxJobs/* = std::numeric_limits<size_t>::max()*/)
+{
+	const size_t jobs = std::min({count, maxJobs, workers + 1});
+	if (jobs <= 1 || !isRunning()) {
+		for (size_t i = 0; i < count; ++i) {
+			func(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next{0};
+	auto work = [&]() {
+		for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+			func(i);
+		}
+	};
+
+	JobGroup group;
+	for (size_t i = 1; i < jobs; ++i) {
+		addJob(group, work);
+	}
+
+	work();
+	wait(group);
+}
+
+void JobPool::threadMain()
+{
+	for (size_t i = 1; i < workers; ++i) {
+		threads.emplace_back(&JobPool::workerMain, this, i);
+	}
+
+	if (workers != 0) {
+		workerMain(0);
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+void JobPool::workerMain(size_t index)
+{
+	currentWorker = index;
+	affinity::pinCurrentThread("jobs", index);
+
+	Job job;
+	while (true) {
+		if (takeJob(index, job)) {
+			runJob(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> signalLockUnique(signalLock);
+		jobSignal.wait(signalLockUnique, [this]() {
+			return queuedJobs.load(std::memory_order_acquire) != 0 || getState() != THREAD_STATE_RUNNING;
+		});
+
+		if (queuedJobs.load(std::memory_order_acquire) == 0 && getState() != THREAD_STATE_RUNNING) {
+			return;
+		}
+	}
+}
+
+bool JobPool::takeJob(size_t index, Job& job)
+{
+	if (queuedJobs.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+
+	for (size_t i = 0; i < queues.size(); ++i) {
+		WorkerQueue& queue = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> lockClass(queue.lock);
+		if (queue.jobs.empty()) {
+			continue;
+		}
+
+		if (i == 0) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		} else {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void JobPool::runJob(Job& job)
+{
+	job.function();
+	job.function = nullptr;
+
+	// the waiter may return and drop the group as soon as it is done, it is not touched after
+	if (job.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		std::lock_guard<std::mutex> lockClass(signalLock);
+		jobSignal.notify_all();
+	}
+}
@@ -0,0 +1,94 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include "thread_holder_base.h"
+
+/*
+ * Worker threads for work that splits into independent jobs, such as loading the map and the
+ * monsters or encoding the player files of a save. Every worker has a queue of its own, takes its
+ * newest job first and the oldest job of another worker once its queue runs dry. A caller waiting
+ * for its jobs runs queued ones meanwhile, so a job may wait for jobs it added and a pool without
+ * workers gets everything done on the caller. The thread of the holder is the first worker, it
+ * starts the others and joins them once the pool is shut down. Any thread.
+ */
+class JobPool : public ThreadHolder<JobPool>
+{
+	public:
+		// jobs that are waited for together
+		class JobGroup
+		{
+			public:
+				JobGroup() = default;
+
+				// non-copyable
+				JobGroup(const JobGroup&) = delete;
+				JobGroup& operator=(const JobGroup&) = delete;
+
+				bool isDone() const {
+					return pending.load(std::memory_order_acquire) == 0;
+				}
+
+			private:
+				std::atomic<size_t> pending{0};
+
+				friend class JobPool;
+		};
+
+		JobPool() = default;
+
+		// non-copyable
+		JobPool(const JobPool&) = delete;
+		JobPool& operator=(const JobPool&) = delete;
+
+		// before start, 0 runs every job on the thread adding it
+		void setWorkers(size_t count);
+		size_t getWorkers() const {
+			return workers;
+		}
+		// the queued jobs still run, jobs added from now on run on the thread adding them
+		void shutdown();
+
+		void addJob(JobGroup& group, std::function<void()>&& job);
+		// returns once every job of group ran
+		void wait(JobGroup& group);
+
+		// calls func(0) .. func(count - 1) spread over up to maxJobs jobs, the caller running one of them
+		void parallelFor(size_t count, const std::function<void(size_t)>& func, size_t maxJobs = std::numeric_limits<size_t>::max());
+
+		void threadMain();
+
+	private:
+		struct Job {
+			std::function<void()> function;
+			JobGroup* group = nullptr;
+		};
+
+		struct WorkerQueue {
+			std::mutex lock;
+			std::deque<Job> jobs;
+		};
+
+		bool isRunning() const {
+			return workers != 0 && getState() == THREAD_STATE_RUNNING;
+		}
+
+		void workerMain(size_t index);
+		// the newest job of the queue at index or the oldest of another queue, false if every queue is empty
+		bool takeJob(size_t index, Job& job);
+		void runJob(Job& job);
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues;
+		std::vector<std::thread> threads;
+		// guards the waits on jobSignal, which tells of new jobs, finished groups and the shutdown
+		std::mutex signalLock;
+		std::condition_variable jobSignal;
+		std::atomic<size_t> queuedJobs{0};
+		std::atomic<size_t> nextQueue{0};
+		size_t workers = 0;
+};
+
+extern JobPool g_jobPool;
@@ -0,0 +1,91 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "loadshedder.h"
+#include "configmanager.h"
+#include "creature.h"
+#include "tasks.h"
+
+extern ConfigManager g_config;
+
+LoadShedder g_loadShedder;
+
+namespace {
+
+// a window is one round over all the checkCreatures lists, a second
+constexpr uint32_t WINDOW_SLOTS = EVENT_CREATURECOUNT;
+// slots or batches over budget in a window that raise the level, a single late one is let go
+constexpr uint32_t OVERLOAD_SAMPLES = 2;
+// windows without anything over budget before the level goes down by one
+constexpr uint32_t RECOVERY_WINDOWS = 10;
+
+}
+
+void LoadShedder::loadConfig()
+{
+	tickBudget = std::chrono::milliseconds(g_config.getNumber(ConfigManager::TICK_BUDGET));
+	lastBatchesOverBudget = g_dispatcher.getBatchStats().batchesOverBudget;
+	slots = 0;
+	slotsOverBudget = 0;
+	calmWindows = 0;
+
+	if (tickBudget.count() == 0 && g_config.getNumber(ConfigManager::DISPATCHER_BATCH_BUDGET) == 0) {
+		setLevel(0);
+	}
+}
+
+void LoadShedder::addCheckCreaturesTime(std::chrono::nanoseconds time)
+{
+	if (tickBudget.count() > 0 && time > tickBudget) {
+		++slotsOverBudget;
+	}
+
+	if (++slots == WINDOW_SLOTS) {
+		evaluate();
+	}
+}
+
+void LoadShedder::evaluate()
+{
+	const uint64_t batchesOverBudget = g_dispatcher.getBatchStats().batchesOverBudget;
+	const uint64_t windowBatches = batchesOverBudget - lastBatchesOverBudget;
+	lastBatchesOverBudget = batchesOverBudget;
+
+	const uint32_t windowSlots = slotsOverBudget;
+	slots = 0;
+	slotsOverBudget = 0;
+
+	if (windowSlots >= OVERLOAD_SAMPLES || windowBatches >= OVERLOAD_SAMPLES) {
+		calmWindows = 0;
+		if (level < MAX_LEVEL) {
+			setLevel(level + 1);
+		}
+		return;
+	}
+
+	if (windowSlots != 0 || windowBatches != 0) {
+		calmWindows = 0;
+		return;
+	}
+
+	if (level != 0 && ++calmWindows == RECOVERY_WINDOWS) {
+		calmWindows = 0;
+		setLevel(level - 1);
+	}
+}
+
+void LoadShedder::setLevel(uint8_t newLevel)
+{
+	if (newLevel == level) {
+		return;
+	}
+
+	if (newLevel > level) {
+		std::cout << "> Warning: the game runs over its tick budget, load shedding level " << static_cast<int>(newLevel) << '.' << std::endl;
+	} else {
+		std::cout << ">> Load shedding back to level " << static_cast<int>(newLevel) << '.' << std::endl;
+	}
+	level = newLevel;
+}
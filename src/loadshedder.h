@@ -0,0 +1,58 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Holds the checkCreatures slots and the dispatcher batches against their budgets and defers low
+ * priority work while the game runs late. Every level adds to the one below:
+ *   1: the map refresh runs half as often
+ *   2: the map refresh runs a quarter as often, spawn checks are coalesced to one a second and
+ *      monsters without a target think every other round
+ *   3: the map refresh runs an eighth as often, spawn checks are coalesced to one every two seconds,
+ *      monsters without a target think every fourth round and the effects sent by scripts are dropped
+ * A level is entered after a second over budget and left after RECOVERY_WINDOWS seconds within it.
+ * Dispatcher thread only.
+ */
+class LoadShedder
+{
+	public:
+		static constexpr uint8_t MAX_LEVEL = 3;
+
+		void loadConfig();
+
+		// after every checkCreatures slot, the level is reconsidered once all the lists were checked
+		void addCheckCreaturesTime(std::chrono::nanoseconds time);
+
+		uint8_t getLevel() const {
+			return level;
+		}
+
+		uint32_t getRefreshIntervalFactor() const {
+			return 1 << level;
+		}
+		// the least time between two spawn checks, in milliseconds
+		int64_t getSpawnCheckDelay() const {
+			return level >= 2 ? (level - 1) * 1000 : 0;
+		}
+		// monsters without a target think once every this many rounds
+		uint32_t getIdleThinkDivisor() const {
+			return level >= 2 ? 1 << (level - 1) : 1;
+		}
+		bool dropScriptEffects() const {
+			return level >= 3;
+		}
+
+	private:
+		void evaluate();
+		void setLevel(uint8_t newLevel);
+
+		std::chrono::nanoseconds tickBudget{0};
+		uint64_t lastBatchesOverBudget = 0;
+		uint32_t slots = 0;
+		uint32_t slotsOverBudget = 0;
+		uint32_t calmWindows = 0;
+		uint8_t level = 0;
+};
+
+extern LoadShedder g_loadShedder;
@@ -0,0 +1,198 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <boost/lockfree/stack.hpp>
+
+#include "arena.h"
+
+struct LockfreePoolStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t inUse = 0;
+	uint64_t highWaterMark = 0;
+};
+
+// Counters shared by every free list created for the same pool tag
+template <typename Tag>
+struct LockfreePoolCounters
+{
+	static LockfreePoolCounters& get() {
+		static LockfreePoolCounters instance;
+		return instance;
+	}
+
+	void onAllocate(bool hit) {
+		(hit ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t current = inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+		uint64_t highest = highWaterMark.load(std::memory_order_relaxed);
+		while (current > highest && !highWaterMark.compare_exchange_weak(highest, current, std::memory_order_relaxed));
+	}
+
+	void onDeallocate() {
+		inUse.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	LockfreePoolStats getStats() const {
+		LockfreePoolStats stats;
+		stats.hits = hits.load(std::memory_order_relaxed);
+		stats.misses = misses.load(std::memory_order_relaxed);
+		stats.inUse = inUse.load(std::memory_order_relaxed);
+		stats.highWaterMark = highWaterMark.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	private:
+		std::atomic<uint64_t> hits{0};
+		std::atomic<uint64_t> misses{0};
+		std::atomic<uint64_t> inUse{0};
+		std::atomic<uint64_t> highWaterMark{0};
+};
+
+/*
+ * Global free list of fixed size chunks, shared by every thread. New chunks come from the arena
+ * while it is enabled, from the heap otherwise. Chunks that do not fit back into the free list
+ * (it is full) are released to the heap, or kept aside for later when they are of the arena.
+ */
+template <typename Tag, size_t TSize, size_t CAPACITY>
+struct LockfreeFreeList
+{
+	using FreeList = boost::lockfree::stack<void*, boost::lockfree::capacity<CAPACITY>>;
+
+	static LockfreeFreeList& get() {
+		static LockfreeFreeList instance;
+		return instance;
+	}
+
+	void* allocate() {
+		void* p;
+		bool hit = freeList.pop(p) || popOverflow(p);
+		if (!hit) {
+			p = arena::allocate(TSize);
+			if (!p) {
+				p = operator new(TSize);
+			}
+		}
+
+		LockfreePoolCounters<Tag>::get().onAllocate(hit);
+		return p;
+	}
+
+	void deallocate(void* p) {
+		LockfreePoolCounters<Tag>::get().onDeallocate();
+		if (freeList.bounded_push(p)) {
+			return;
+		}
+
+		if (arena::contains(p)) {
+			std::lock_guard<std::mutex> lockClass(overflowLock);
+			overflow.push_back(p);
+			overflowSize.store(overflow.size(), std::memory_order_relaxed);
+		} else {
+			//Release memory without calling the destructor
+			operator delete(p);
+		}
+	}
+
+	private:
+		bool popOverflow(void*& p) {
+			if (overflowSize.load(std::memory_order_relaxed) == 0) {
+				return false;
+			}
+
+			std::lock_guard<std::mutex> lockClass(overflowLock);
+			if (overflow.empty()) {
+				return false;
+			}
+
+			p = overflow.back();
+			overflow.pop_back();
+			overflowSize.store(overflow.size(), std::memory_order_relaxed);
+			return true;
+		}
+
+		FreeList freeList;
+
+		// arena chunks cannot go back to the heap
+		std::mutex overflowLock;
+		std::vector<void*> overflow;
+		std::atomic<size_t> overflowSize{0};
+};
+
+/*
+ * Allocator meant for std::allocate_shared. The shared_ptr control block and the
+ * object live in a single chunk, so recycling a chunk recycles the whole allocation.
+ * Only single element allocations are pooled, anything else goes to the heap.
+ */
+template <typename T, typename Tag, size_t CAPACITY>
+class LockfreePoolingAllocator
+{
+	public:
+		using value_type = T;
+
+		template <typename U>
+		struct rebind {
+			using other = LockfreePoolingAllocator<U, Tag, CAPACITY>;
+		};
+
+		LockfreePoolingAllocator() = default;
+
+		template <typename U>
+		explicit constexpr LockfreePoolingAllocator(const LockfreePoolingAllocator<U, Tag, CAPACITY>&) {}
+
+		T* allocate(size_t n) {
+			if (n != 1) {
+				return static_cast<T*>(operator new(n * sizeof(T)));
+			}
+			return static_cast<T*>(LockfreeFreeList<Tag, sizeof(T), CAPACITY>::get().allocate());
+		}
+
+		void deallocate(T* p, size_t n) const {
+			if (n != 1) {
+				operator delete(p);
+				return;
+			}
+			LockfreeFreeList<Tag, sizeof(T), CAPACITY>::get().deallocate(p);
+		}
+
+		template <typename U>
+		bool operator==(const LockfreePoolingAllocator<U, Tag, CAPACITY>&) const {
+			return true;
+		}
+
+		template <typename U>
+		bool operator!=(const LockfreePoolingAllocator<U, Tag, CAPACITY>&) const {
+			return false;
+		}
+};
+
+/*
+ * Backs class-specific operator new/delete of a polymorphic hierarchy. Every object
+ * that fits in TSize bytes takes a TSize chunk from the free list of its tag, bigger
+ * ones go to the heap. The size handed to deallocate must be the one given to allocate,
+ * which sized class deallocation guarantees through a virtual destructor.
+ */
+template <typename Tag, size_t TSize, size_t CAPACITY>
+struct LockfreeObjectPool
+{
+	static void* allocate(size_t size) {
+		if (size > TSize) {
+			return operator new(size);
+		}
+		return LockfreeFreeList<Tag, TSize, CAPACITY>::get().allocate();
+	}
+
+	static void deallocate(void* p, size_t size) {
+		if (size > TSize) {
+			operator delete(p);
+			return;
+		}
+		LockfreeFreeList<Tag, TSize, CAPACITY>::get().deallocate(p);
+	}
+
+	static bool isPooled(size_t size) {
+		return size <= TSize;
+	}
+};
@@ -0,0 +1,185 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "logger.h"
+#include "tools.h"
+
+#include <filesystem>
+
+Logger g_logger;
+
+namespace {
+
+const std::string LOG_DIRECTORY = "gamedata/logs";
+const std::string LOG_FILENAME = LOG_DIRECTORY + "/server.log";
+
+// how long the thread waits for messages before it writes what it has
+constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(100);
+
+const char* getLevelName(LogLevel_t level)
+{
+	switch (level) {
+		case LOGLEVEL_DEBUG: return "debug";
+		case LOGLEVEL_INFO: return "info";
+		case LOGLEVEL_WARNING: return "warning";
+		default: return "error";
+	}
+}
+
+}
+
+Logger::Logger() : ring(std::make_unique<Slot[]>(RING_SIZE))
+{
+	for (size_t i = 0; i < RING_SIZE; ++i) {
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+void Logger::threadMain()
+{
+	std::unique_lock<std::mutex> writeLockUnique(writeLock);
+	while (getState() != THREAD_STATE_TERMINATED) {
+		signal.wait_for(writeLockUnique, WRITE_INTERVAL);
+		drain();
+	}
+}
+
+void Logger::shutdown()
+{
+	writeLock.lock();
+	setState(THREAD_STATE_TERMINATED);
+	writeLock.unlock();
+	signal.notify_one();
+
+	join();
+
+	// pairs with the fence in log, a message pushed after this drain is written by the thread that pushed it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	std::lock_guard<std::mutex> lockClass(writeLock);
+	drain();
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+bool Logger::accept(LogSite& site)
+{
+	const int64_t now = OTSYS_TIME();
+	int64_t windowStart = site.windowStart.load(std::memory_order_relaxed);
+	if (now - windowStart >= 1000 && site.windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+		site.messages.store(0, std::memory_order_relaxed);
+	}
+
+	if (site.messages.fetch_add(1, std::memory_order_relaxed) < MESSAGES_PER_SECOND) {
+		return true;
+	}
+
+	site.suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void Logger::log(LogLevel_t level, LogSite& site, std::string&& text)
+{
+	if (uint32_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed); suppressed != 0) {
+		text += fmt::format(" ({:d} similar messages suppressed)", suppressed);
+	}
+
+	if (getState() == THREAD_STATE_RUNNING) {
+		if (!push(level, std::move(text))) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// shutdown may have run its last drain while the message was pushed
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (getState() != THREAD_STATE_RUNNING) {
+			std::lock_guard<std::mutex> lockClass(writeLock);
+			drain();
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> lockClass(writeLock);
+	write(level, text);
+	flush();
+}
+
+bool Logger::push(LogLevel_t level, std::string&& text)
+{
+	// a bounded multi-producer ring, a slot's sequence tells whose turn it is
+	uint64_t position = writePosition.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true) {
+		slot = &ring[position & (RING_SIZE - 1)];
+		const int64_t diff = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(position);
+		if (diff == 0) {
+			if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			position = writePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->level = level;
+	slot->text = std::move(text);
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+void Logger::drain()
+{
+	bool written = false;
+	while (true) {
+		Slot& slot = ring[readPosition & (RING_SIZE - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1) {
+			break;
+		}
+
+		const std::string text = std::move(slot.text);
+		write(slot.level, text);
+		slot.sequence.store(readPosition + RING_SIZE, std::memory_order_release);
+		++readPosition;
+		written = true;
+	}
+
+	if (uint64_t lost = dropped.exchange(0, std::memory_order_relaxed); lost != 0) {
+		write(LOGLEVEL_WARNING, fmt::format("> Warning: {:d} log messages were dropped, the log ring was full.", lost));
+		written = true;
+	}
+
+	if (written) {
+		flush();
+	}
+}
+
+void Logger::write(LogLevel_t level, const std::string& text)
+{
+	std::cout << text << '\n';
+	fileBuffer += fmt::format("[{:s}] {:s}: {:s}\n", formatDate(time(nullptr)), getLevelName(level), text);
+}
+
+void Logger::flush()
+{
+	std::cout.flush();
+
+	if (!file) {
+		std::error_code ec;
+		std::filesystem::create_directories(LOG_DIRECTORY, ec);
+		file = fopen(LOG_FILENAME.c_str(), "ab");
+		if (!file) {
+			std::cout << "[Error - Logger::flush] Cannot open " << LOG_FILENAME << " for writing." << std::endl;
+			fileBuffer.clear();
+			return;
+		}
+	}
+
+	fwrite(fileBuffer.data(), 1, fileBuffer.size(), file);
+	fflush(file);
+	fileBuffer.clear();
+}
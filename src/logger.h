@@ -0,0 +1,82 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <condition_variable>
+#include <fmt/format.h>
+#include "thread_holder_base.h"
+
+enum LogLevel_t : uint8_t {
+	LOGLEVEL_DEBUG,
+	LOGLEVEL_INFO,
+	LOGLEVEL_WARNING,
+	LOGLEVEL_ERROR,
+};
+
+// one per place that logs, holds how many messages it sent in the current second
+struct LogSite {
+	std::atomic<int64_t> windowStart{0};
+	std::atomic<uint32_t> messages{0};
+	std::atomic<uint32_t> suppressed{0};
+};
+
+/*
+ * Takes log messages from any thread into a fixed ring without locking and writes them to the
+ * console and gamedata/logs/server.log on its own thread, so a burst of errors never waits on
+ * terminal or disk I/O. Every site logs at most MESSAGES_PER_SECOND messages a second, the rest are
+ * counted and reported with the next one let through. A full ring drops messages and counts them.
+ * While the thread is not running messages are written right away, and a message pushed while it
+ * shuts down is written by the thread that logged it.
+ */
+class Logger : public ThreadHolder<Logger>
+{
+	public:
+		static constexpr uint32_t MESSAGES_PER_SECOND = 10;
+
+		Logger();
+		void shutdown();
+
+		// whether site may log now, counts the message as suppressed otherwise
+		bool accept(LogSite& site);
+		void log(LogLevel_t level, LogSite& site, std::string&& text);
+
+		void threadMain();
+
+	private:
+		static constexpr size_t RING_SIZE = 4096;
+
+		struct Slot {
+			std::atomic<uint64_t> sequence{0};
+			LogLevel_t level = LOGLEVEL_INFO;
+			std::string text;
+		};
+
+		bool push(LogLevel_t level, std::string&& text);
+		// writes the queued messages, writeLock held
+		void drain();
+		void write(LogLevel_t level, const std::string& text);
+		void flush();
+
+		std::unique_ptr<Slot[]> ring;
+		std::atomic<uint64_t> writePosition{0};
+		uint64_t readPosition = 0;
+		std::atomic<uint64_t> dropped{0};
+
+		// the file and its buffer, and the signal the thread waits on between writes
+		std::string fileBuffer;
+		FILE* file = nullptr;
+		std::mutex writeLock;
+		std::condition_variable signal;
+};
+
+extern Logger g_logger;
+
+// formats and logs the message unless its site is over its rate
+#define TVP_LOG(level, ...) \
+	do { \
+		static LogSite logSite; \
+		if (g_logger.accept(logSite)) { \
+			g_logger.log(level, logSite, fmt::format(__VA_ARGS__)); \
+		} \
+	} while (false)
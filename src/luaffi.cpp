@@ -0,0 +1,99 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "item.h"
+#include "player.h"
+
+/*
+ * Read-only getters for data/lib/core/ffi.lua, which calls them through the LuaJIT FFI in place of
+ * the Lua C API methods of the same name. A userdata passed to a void* parameter arrives as a
+ * pointer to its payload, which is the pointer to the object as pushUserdata wrote it. Positions
+ * are filled into a plain struct, the Lua side makes the position table of it. The executable
+ * exports them (ENABLE_EXPORTS), ffi.C finds nothing otherwise and the C API methods stay in use.
+ * Dispatcher thread only, as every script.
+ */
+
+#ifdef _WIN32
+#define TVP_FFI_EXPORT extern "C" __declspec(dllexport)
+#else
+#define TVP_FFI_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// TvpPosition in ffi.lua
+struct FfiPosition {
+	uint16_t x;
+	uint16_t y;
+	uint8_t z;
+};
+
+namespace {
+
+template<class T>
+const T* getObject(const void* userdata)
+{
+	return userdata ? *static_cast<const T* const*>(userdata) : nullptr;
+}
+
+void fillPosition(const Position& position, FfiPosition* out)
+{
+	out->x = position.x;
+	out->y = position.y;
+	out->z = position.z;
+}
+
+}
+
+TVP_FFI_EXPORT uint32_t tvp_creature_get_id(const void* userdata)
+{
+	const Creature* creature = getObject<Creature>(userdata);
+	return creature ? creature->getID() : 0;
+}
+
+TVP_FFI_EXPORT bool tvp_creature_get_position(const void* userdata, FfiPosition* position)
+{
+	const Creature* creature = getObject<Creature>(userdata);
+	if (!creature) {
+		return false;
+	}
+
+	fillPosition(creature->getPosition(), position);
+	return true;
+}
+
+// -1 for no creature
+TVP_FFI_EXPORT int32_t tvp_creature_get_health(const void* userdata)
+{
+	const Creature* creature = getObject<Creature>(userdata);
+	return creature ? creature->getHealth() : -1;
+}
+
+TVP_FFI_EXPORT int32_t tvp_creature_get_max_health(const void* userdata)
+{
+	const Creature* creature = getObject<Creature>(userdata);
+	return creature ? creature->getMaxHealth() : -1;
+}
+
+TVP_FFI_EXPORT uint32_t tvp_player_get_level(const void* userdata)
+{
+	const Player* player = getObject<Player>(userdata);
+	return player ? player->getLevel() : 0;
+}
+
+TVP_FFI_EXPORT uint16_t tvp_item_get_id(const void* userdata)
+{
+	const Item* item = getObject<Item>(userdata);
+	return item ? item->getID() : 0;
+}
+
+TVP_FFI_EXPORT bool tvp_item_get_position(const void* userdata, FfiPosition* position)
+{
+	const Item* item = getObject<Item>(userdata);
+	if (!item) {
+		return false;
+	}
+
+	fillPosition(item->getPosition(), position);
+	return true;
+}
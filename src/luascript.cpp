@@ -7,6 +7,7 @@
 #include <fmt/format.h>
 
 #include "luascript.h"
+#include "cast.h"
 #include "chat.h"
 #include "player.h"
 #include "game.h"
@@ -21,13 +22,24 @@
 #include "monster.h"
 #include "scheduler.h"
 #include "databasetasks.h"
+#include "ban.h"
+#include "filetasks.h"
 #include "events.h"
 #include "movement.h"
 #include "globalevent.h"
 #include "script.h"
 #include "weapons.h"
+#include "lockfree.h"
+#include "outputmessage.h"
+#include "purefunctions.h"
+#include "trafficstats.h"
+#include "memorystats.h"
+#include "loadshedder.h"
+#include "logger.h"
+#include "profiler.h"
 
 extern Chat* g_chat;
+extern Dispatcher g_dispatcher;
 extern Game g_game;
 extern Monsters g_monsters;
 extern ConfigManager g_config;
@@ -45,7 +57,6 @@ extern Weapons* g_weapons;
 ScriptEnvironment::DBResultMap ScriptEnvironment::tempResults;
 uint32_t ScriptEnvironment::lastResultId = 0;
 
-std::multimap<ScriptEnvironment*, Item*> ScriptEnvironment::tempItems;
 
 LuaEnvironment g_luaEnvironment;
 
@@ -68,15 +79,13 @@ void ScriptEnvironment::resetEnv()
 	localMap.clear();
 	tempResults.clear();
 
-	auto pair = tempItems.equal_range(this);
-	auto it = pair.first;
-	while (it != pair.second) {
-		Item* item = it->second;
-		if (item && item->getParent() == VirtualCylinder::virtualCylinder) {
+	for (Item* item : tempItems) {
+		item->tempScriptEnv = nullptr;
+		if (item->getParent() == VirtualCylinder::virtualCylinder) {
 			g_game.ReleaseItem(item);
 		}
-		it = tempItems.erase(it);
 	}
+	tempItems.clear();
 }
 
 bool ScriptEnvironment::setCallbackId(int32_t callbackId, LuaScriptInterface* scriptInterface)
@@ -193,16 +202,29 @@ void ScriptEnvironment::removeItemByUID(uint32_t uid)
 
 void ScriptEnvironment::addTempItem(Item* item)
 {
-	tempItems.emplace(this, item);
+	if (item->tempScriptEnv == this) {
+		return;
+	}
+
+	removeTempItem(item);
+	item->tempScriptEnv = this;
+	tempItems.push_back(item);
 }
 
 void ScriptEnvironment::removeTempItem(Item* item)
 {
-	for (auto it = tempItems.begin(), end = tempItems.end(); it != end; ++it) {
-		if (it->second == item) {
-			tempItems.erase(it);
-			break;
-		}
+	ScriptEnvironment* env = item->tempScriptEnv;
+	if (!env) {
+		return;
+	}
+
+	item->tempScriptEnv = nullptr;
+
+	auto& envTempItems = env->tempItems;
+	auto it = std::find(envTempItems.begin(), envTempItems.end(), item);
+	if (it != envTempItems.end()) {
+		*it = envTempItems.back();
+		envTempItems.pop_back();
 	}
 }
 
@@ -254,6 +276,9 @@ std::string LuaScriptInterface::getErrorDesc(ErrorCode_t code)
 
 ScriptEnvironment LuaScriptInterface::scriptEnv[16];
 int32_t LuaScriptInterface::scriptEnvIndex = -1;
+std::unordered_map<std::string, int32_t> LuaScriptInterface::metatableRefs;
+std::array<int32_t, LuaData_Last> LuaScriptInterface::typeMetatableRefs;
+int32_t LuaScriptInterface::internedUserdataRef = LUA_NOREF;
 
 LuaScriptInterface::LuaScriptInterface(std::string interfaceName) : interfaceName(std::move(interfaceName))
 {
@@ -423,6 +448,47 @@ const std::string& LuaScriptInterface::getFileById(int32_t scriptId)
 	return it->second;
 }
 
+const std::string* LuaScriptInterface::internScriptFile(const std::string& scriptFile)
+{
+	static std::unordered_set<std::string> scriptFiles;
+	return &*scriptFiles.insert(scriptFile).first;
+}
+
+const std::string* LuaScriptInterface::getLoadingScriptFile() const
+{
+	if (scriptEnvIndex < 0) {
+		return nullptr;
+	}
+
+	ScriptEnvironment* env = getScriptEnv();
+	if (env->getScriptId() != EVENT_ID_LOADING || env->getScriptInterface() != this) {
+		return nullptr;
+	}
+	return internScriptFile(loadingFile);
+}
+
+void LuaScriptInterface::forgetScriptFile(const std::string& scriptFile)
+{
+	lua_rawgeti(luaState, LUA_REGISTRYINDEX, eventTableRef);
+	if (!isTable(luaState, -1)) {
+		lua_pop(luaState, 1);
+		return;
+	}
+
+	// every function name is cached as "file:event"
+	for (auto it = cacheFiles.begin(); it != cacheFiles.end();) {
+		const std::string& name = it->second;
+		if (name.size() > scriptFile.size() && name[scriptFile.size()] == ':' && name.compare(0, scriptFile.size(), scriptFile) == 0) {
+			lua_pushnil(luaState);
+			lua_rawseti(luaState, -2, it->first);
+			it = cacheFiles.erase(it);
+		} else {
+			++it;
+		}
+	}
+	lua_pop(luaState, 1);
+}
+
 std::string LuaScriptInterface::getStackTrace(lua_State* L, const std::string& error_desc)
 {
 	lua_getglobal(L, "debug");
@@ -451,31 +517,38 @@ void LuaScriptInterface::reportError(const char* function, const std::string& er
 	LuaScriptInterface* scriptInterface;
 	getScriptEnv()->getEventInfo(scriptId, scriptInterface, callbackId, timerEvent);
 
-	std::cout << std::endl << "Lua Script Error: ";
+	// a script failing on every call is held to the rate of one log site, before its stack trace is built
+	static LogSite logSite;
+	if (!g_logger.accept(logSite)) {
+		return;
+	}
+
+	std::string text = "Lua Script Error: ";
 
 	if (scriptInterface) {
-		std::cout << '[' << scriptInterface->getInterfaceName() << "] " << std::endl;
+		text += fmt::format("[{:s}] \n", scriptInterface->getInterfaceName());
 
 		if (timerEvent) {
-			std::cout << "in a timer event called from: " << std::endl;
+			text += "in a timer event called from: \n";
 		}
 
 		if (callbackId) {
-			std::cout << "in callback: " << scriptInterface->getFileById(callbackId) << std::endl;
+			text += fmt::format("in callback: {:s}\n", scriptInterface->getFileById(callbackId));
 		}
 
-		std::cout << scriptInterface->getFileById(scriptId) << std::endl;
+		text += scriptInterface->getFileById(scriptId) + '\n';
 	}
 
 	if (function) {
-		std::cout << function << "(). ";
+		text += fmt::format("{:s}(). ", function);
 	}
 
 	if (L && stack_trace) {
-		std::cout << getStackTrace(L, error_desc) << std::endl;
+		text += getStackTrace(L, error_desc);
 	} else {
-		std::cout << error_desc << std::endl;
+		text += error_desc;
 	}
+	g_logger.log(LOGLEVEL_ERROR, logSite, std::move(text));
 }
 
 bool LuaScriptInterface::pushFunction(int32_t functionId)
@@ -490,6 +563,21 @@ bool LuaScriptInterface::pushFunction(int32_t functionId)
 	return isFunction(luaState, -1);
 }
 
+uint32_t LuaScriptInterface::getPureFunctionId(int32_t functionId)
+{
+	lua_getfield(luaState, LUA_REGISTRYINDEX, "pureFunctions");
+	if (!isTable(luaState, -1)) {
+		lua_pop(luaState, 1);
+		return 0;
+	}
+
+	pushFunction(functionId);
+	lua_rawget(luaState, -2);
+	uint32_t pureFunctionId = isNumber(luaState, -1) ? getNumber<uint32_t>(luaState, -1) : 0;
+	lua_pop(luaState, 2);
+	return pureFunctionId;
+}
+
 bool LuaScriptInterface::initState()
 {
 	luaState = g_luaEnvironment.getLuaState();
@@ -510,6 +598,7 @@ bool LuaScriptInterface::closeState()
 	}
 
 	cacheFiles.clear();
+	g_scriptProfiler.forgetInterface(this);
 	if (eventTableRef != -1) {
 		luaL_unref(luaState, LUA_REGISTRYINDEX, eventTableRef);
 		eventTableRef = -1;
@@ -526,16 +615,37 @@ int LuaScriptInterface::luaErrorHandler(lua_State* L)
 	return 1;
 }
 
+void LuaScriptInterface::profileCall(const ScriptProfiler::CallScope& scope) const
+{
+	int32_t scriptId;
+	int32_t callbackId;
+	bool timerEvent;
+	LuaScriptInterface* scriptInterface;
+	getScriptEnv()->getEventInfo(scriptId, scriptInterface, callbackId, timerEvent);
+	g_scriptProfiler.endCall(luaState, scope, scriptInterface, scriptId, callbackId);
+}
+
 bool LuaScriptInterface::callFunction(int params)
 {
+	PROFILE_FUNCTION();
 	bool result = false;
 	int size = lua_gettop(luaState);
+	const bool profile = g_scriptProfiler.isEnabled();
+	ScriptProfiler::CallScope scope;
+	if (profile) {
+		scope = g_scriptProfiler.beginCall(luaState);
+	}
+
 	if (protectedCall(luaState, params, 1) != 0) {
 		LuaScriptInterface::reportError(nullptr, LuaScriptInterface::getString(luaState, -1));
 	} else {
 		result = LuaScriptInterface::getBoolean(luaState, -1);
 	}
 
+	if (profile) {
+		profileCall(scope);
+	}
+
 	lua_pop(luaState, 1);
 	if ((lua_gettop(luaState) + params + 1) != size) {
 		LuaScriptInterface::reportError(nullptr, "Stack size changed!");
@@ -547,11 +657,22 @@ bool LuaScriptInterface::callFunction(int params)
 
 void LuaScriptInterface::callVoidFunction(int params)
 {
+	PROFILE_FUNCTION();
 	int size = lua_gettop(luaState);
+	const bool profile = g_scriptProfiler.isEnabled();
+	ScriptProfiler::CallScope scope;
+	if (profile) {
+		scope = g_scriptProfiler.beginCall(luaState);
+	}
+
 	if (protectedCall(luaState, params, 0) != 0) {
 		LuaScriptInterface::reportError(nullptr, LuaScriptInterface::popString(luaState));
 	}
 
+	if (profile) {
+		profileCall(scope);
+	}
+
 	if ((lua_gettop(luaState) + params + 1) != size) {
 		LuaScriptInterface::reportError(nullptr, "Stack size changed!");
 	}
@@ -651,10 +772,52 @@ int32_t LuaScriptInterface::popCallback(lua_State* L)
 // Metatables
 void LuaScriptInterface::setMetatable(lua_State* L, int32_t index, const std::string& name)
 {
-	luaL_getmetatable(L, name.c_str());
+	auto it = metatableRefs.find(name);
+	if (it != metatableRefs.end()) {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, it->second);
+	} else {
+		luaL_getmetatable(L, name.c_str());
+	}
 	lua_setmetatable(L, index - 1);
 }
 
+void LuaScriptInterface::setMetatable(lua_State* L, int32_t index, LuaDataType type)
+{
+	lua_rawgeti(L, LUA_REGISTRYINDEX, typeMetatableRefs[type]);
+	lua_setmetatable(L, index - 1);
+}
+
+bool LuaScriptInterface::pushInternedUserdata(lua_State* L, const void* value)
+{
+	if (internedUserdataRef == LUA_NOREF) {
+		return false;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, internedUserdataRef);
+	lua_pushlightuserdata(L, const_cast<void*>(value));
+	lua_rawget(L, -2);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 2);
+		return false;
+	}
+
+	lua_remove(L, -2);
+	return true;
+}
+
+void LuaScriptInterface::internUserdata(lua_State* L, const void* value)
+{
+	if (internedUserdataRef == LUA_NOREF) {
+		return;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, internedUserdataRef);
+	lua_pushlightuserdata(L, const_cast<void*>(value));
+	lua_pushvalue(L, -3);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+}
+
 void LuaScriptInterface::setWeakMetatable(lua_State* L, int32_t index, const std::string& name)
 {
 	static std::set<std::string> weakObjectTypes;
@@ -693,25 +856,23 @@ void LuaScriptInterface::setWeakMetatable(lua_State* L, int32_t index, const std
 void LuaScriptInterface::setItemMetatable(lua_State* L, int32_t index, const Item* item)
 {
 	if (item->getContainer()) {
-		luaL_getmetatable(L, "Container");
+		setMetatable(L, index, LuaData_Container);
 	} else if (item->getTeleport()) {
-		luaL_getmetatable(L, "Teleport");
+		setMetatable(L, index, LuaData_Teleport);
 	} else {
-		luaL_getmetatable(L, "Item");
+		setMetatable(L, index, LuaData_Item);
 	}
-	lua_setmetatable(L, index - 1);
 }
 
 void LuaScriptInterface::setCreatureMetatable(lua_State* L, int32_t index, const Creature* creature)
 {
 	if (creature->getPlayer()) {
-		luaL_getmetatable(L, "Player");
+		setMetatable(L, index, LuaData_Player);
 	} else if (creature->getMonster()) {
-		luaL_getmetatable(L, "Monster");
+		setMetatable(L, index, LuaData_Monster);
 	} else {
-		luaL_getmetatable(L, "Npc");
+		setMetatable(L, index, LuaData_Npc);
 	}
-	lua_setmetatable(L, index - 1);
 }
 
 // Get
@@ -977,6 +1138,17 @@ void LuaScriptInterface::pushLoot(lua_State* L, const std::vector<LootBlock>& lo
 
 void LuaScriptInterface::registerFunctions()
 {
+	// a new state, the references of the last one are gone with it
+	metatableRefs.clear();
+	typeMetatableRefs.fill(LUA_NOREF);
+
+	lua_newtable(luaState);
+	lua_createtable(luaState, 0, 1);
+	lua_pushstring(luaState, "v");
+	lua_setfield(luaState, -2, "__mode");
+	lua_setmetatable(luaState, -2);
+	internedUserdataRef = luaL_ref(luaState, LUA_REGISTRYINDEX);
+
 	//randomNumber(minNumber, maxNumber)
 	lua_register(luaState, "randomNumber", LuaScriptInterface::luaRandomNumber);
 
@@ -1066,6 +1238,12 @@ void LuaScriptInterface::registerFunctions()
 	//isScriptsInterface()
 	lua_register(luaState, "isScriptsInterface", LuaScriptInterface::luaIsScriptsInterface);
 
+	//appendFile(fileName, text[, callback(success)])
+	lua_register(luaState, "appendFile", LuaScriptInterface::luaAppendFile);
+
+	//markPure(function)
+	lua_register(luaState, "markPure", LuaScriptInterface::luaMarkPure);
+
 #ifndef LUAJIT_VERSION
 	//bit operations for Lua, based on bitlib project release 24
 	//bit.bnot, bit.band, bit.bor, bit.bxor, bit.lshift, bit.rshift
@@ -1122,6 +1300,8 @@ void LuaScriptInterface::registerFunctions()
 	registerEnum(COMBAT_FORMULA_LEVELMAGIC)
 	registerEnum(COMBAT_FORMULA_SKILL)
 	registerEnum(COMBAT_FORMULA_DAMAGE)
+	registerEnum(COMBAT_FORMULA_BASEDAMAGE)
+	registerEnum(COMBAT_FORMULA_BASESKILL)
 
 	registerEnum(DIRECTION_NORTH)
 	registerEnum(DIRECTION_EAST)
@@ -1721,6 +1901,8 @@ void LuaScriptInterface::registerFunctions()
 	registerEnum(RELOAD_TYPE_NPCS)
 	registerEnum(RELOAD_TYPE_RAIDS)
 	registerEnum(RELOAD_TYPE_SCRIPTS)
+	registerEnum(RELOAD_TYPE_CHANGED_SCRIPTS)
+	registerEnum(RELOAD_TYPE_GUILDS)
 
 	registerEnum(ZONE_PROTECTION)
 	registerEnum(ZONE_NOPVP)
@@ -1738,6 +1920,7 @@ void LuaScriptInterface::registerFunctions()
 	registerEnum(MONSTERS_EVENT_DISAPPEAR)
 	registerEnum(MONSTERS_EVENT_MOVE)
 	registerEnum(MONSTERS_EVENT_SAY)
+	registerEnum(MONSTERS_EVENT_THINK_BATCH)
 
 	// _G
 	registerGlobalVariable("INDEX_WHEREEVER", INDEX_WHEREEVER);
@@ -1773,6 +1956,7 @@ void LuaScriptInterface::registerFunctions()
 	registerEnumIn("configKeys", ConfigManager::GUILHALLS_ONLYFOR_LEADERS)
 	registerEnumIn("configKeys", ConfigManager::HOUSES_ONLY_PREMIUM)
 	registerEnumIn("configKeys", ConfigManager::HOUSE_TRANSFEROWNERSHIP_TRANSFERITEMS)
+	registerEnumIn("configKeys", ConfigManager::LUA_FFI_BINDINGS)
 	registerEnumIn("configKeys", ConfigManager::SERVER_SAVE_TIME)
 
 	registerEnumIn("configKeys", ConfigManager::HOUSE_RENT_PERIOD)
@@ -1837,6 +2021,13 @@ void LuaScriptInterface::registerFunctions()
 
 	registerMethod("Game", "getSpectators", LuaScriptInterface::luaGameGetSpectators);
 	registerMethod("Game", "getPlayers", LuaScriptInterface::luaGameGetPlayers);
+	registerMethod("Game", "broadcastMessage", LuaScriptInterface::luaGameBroadcastMessage);
+	registerMethod("Game", "reloadBans", LuaScriptInterface::luaGameReloadBans);
+	registerMethod("Game", "getSpectatorCacheStats", LuaScriptInterface::luaGameGetSpectatorCacheStats);
+	registerMethod("Game", "getDatabaseTasksStats", LuaScriptInterface::luaGameGetDatabaseTasksStats);
+	registerMethod("Game", "getObjectPoolStats", LuaScriptInterface::luaGameGetObjectPoolStats);
+	registerMethod("Game", "getLuaTimerStats", LuaScriptInterface::luaGameGetLuaTimerStats);
+	registerMethod("Game", "getSendQueueStats", LuaScriptInterface::luaGameGetSendQueueStats);
 
 	registerMethod("Game", "getExperienceStage", LuaScriptInterface::luaGameGetExperienceStage);
 	registerMethod("Game", "getExperienceForLevel", LuaScriptInterface::luaGameGetExperienceForLevel);
@@ -1865,6 +2056,7 @@ void LuaScriptInterface::registerFunctions()
 	registerMethod("Game", "createMonsterType", LuaScriptInterface::luaGameCreateMonsterType);
 
 	registerMethod("Game", "startRaid", LuaScriptInterface::luaGameStartRaid);
+	registerMethod("Game", "loadMap", LuaScriptInterface::luaGameLoadMap);
 
 	registerMethod("Game", "getClientVersion", LuaScriptInterface::luaGameGetClientVersion);
 
@@ -1877,6 +2069,14 @@ void LuaScriptInterface::registerFunctions()
 	registerMethod("Game", "unlockAccount", LuaScriptInterface::luaGameUnlockAccount);
 	registerMethod("Game", "unlockIp", LuaScriptInterface::luaGameUnlockIP);
 
+	registerMethod("Game", "dumpScriptProfile", LuaScriptInterface::luaGameDumpScriptProfile);
+	registerMethod("Game", "resetScriptProfile", LuaScriptInterface::luaGameResetScriptProfile);
+	registerMethod("Game", "getTrafficStats", LuaScriptInterface::luaGameGetTrafficStats);
+	registerMethod("Game", "dumpTrafficStats", LuaScriptInterface::luaGameDumpTrafficStats);
+	registerMethod("Game", "resetTrafficStats", LuaScriptInterface::luaGameResetTrafficStats);
+	registerMethod("Game", "getMemoryStats", LuaScriptInterface::luaGameGetMemoryStats);
+	registerMethod("Game", "dumpMemoryReport", LuaScriptInterface::luaGameDumpMemoryReport);
+
 	// Variant
 	registerClass("Variant", "", LuaScriptInterface::luaVariantCreate);
 
@@ -2071,6 +2271,7 @@ void LuaScriptInterface::registerFunctions()
 	registerMethod("Container", "hasItem", LuaScriptInterface::luaContainerHasItem);
 	registerMethod("Container", "addItem", LuaScriptInterface::luaContainerAddItem);
 	registerMethod("Container", "addItemEx", LuaScriptInterface::luaContainerAddItemEx);
+	registerMethod("Container", "moveItems", LuaScriptInterface::luaContainerMoveItems);
 	registerMethod("Container", "getCorpseOwner", LuaScriptInterface::luaContainerGetCorpseOwner);
 
 	// Teleport
@@ -2171,6 +2372,7 @@ void LuaScriptInterface::registerFunctions()
 
 	registerMethod("Player", "getGuid", LuaScriptInterface::luaPlayerGetGuid);
 	registerMethod("Player", "getIp", LuaScriptInterface::luaPlayerGetIp);
+	registerMethod("Player", "getTrafficStats", LuaScriptInterface::luaPlayerGetTrafficStats);
 	registerMethod("Player", "getAccountId", LuaScriptInterface::luaPlayerGetAccountId);
 	registerMethod("Player", "getLastLoginSaved", LuaScriptInterface::luaPlayerGetLastLoginSaved);
 	registerMethod("Player", "getLastLogout", LuaScriptInterface::luaPlayerGetLastLogout);
@@ -2297,6 +2499,7 @@ void LuaScriptInterface::registerFunctions()
 	registerMethod("Player", "hasLearnedSpell", LuaScriptInterface::luaPlayerHasLearnedSpell);
 
 	registerMethod("Player", "save", LuaScriptInterface::luaPlayerSave);
+	registerMethod("Player", "exportTextFile", LuaScriptInterface::luaPlayerExportTextFile);
 	registerMethod("Player", "popupFYI", LuaScriptInterface::luaPlayerPopupFYI);
 
 	registerMethod("Player", "isPzLocked", LuaScriptInterface::luaPlayerIsPzLocked);
@@ -2309,6 +2512,11 @@ void LuaScriptInterface::registerFunctions()
 
 	registerMethod("Player", "setGhostMode", LuaScriptInterface::luaPlayerSetGhostMode);
 
+	registerMethod("Player", "startCast", LuaScriptInterface::luaPlayerStartCast);
+	registerMethod("Player", "stopCast", LuaScriptInterface::luaPlayerStopCast);
+	registerMethod("Player", "isCasting", LuaScriptInterface::luaPlayerIsCasting);
+	registerMethod("Player", "getCastViewers", LuaScriptInterface::luaPlayerGetCastViewers);
+
 	registerMethod("Player", "getContainerId", LuaScriptInterface::luaPlayerGetContainerId);
 	registerMethod("Player", "getContainerById", LuaScriptInterface::luaPlayerGetContainerById);
 	registerMethod("Player", "getContainerIndex", LuaScriptInterface::luaPlayerGetContainerIndex);
@@ -2645,6 +2853,7 @@ void LuaScriptInterface::registerFunctions()
 	registerMethod("MonsterType", "onDisappear", LuaScriptInterface::luaMonsterTypeEventOnCallback);
 	registerMethod("MonsterType", "onMove", LuaScriptInterface::luaMonsterTypeEventOnCallback);
 	registerMethod("MonsterType", "onSay", LuaScriptInterface::luaMonsterTypeEventOnCallback);
+	registerMethod("MonsterType", "onThinkBatch", LuaScriptInterface::luaMonsterTypeEventOnCallback);
 
 	registerMethod("MonsterType", "getSummonList", LuaScriptInterface::luaMonsterTypeGetSummonList);
 	registerMethod("MonsterType", "addSummon", LuaScriptInterface::luaMonsterTypeAddSummon);
@@ -2940,25 +3149,35 @@ void LuaScriptInterface::registerClass(const std::string& className, const std::
 	lua_rawseti(luaState, metatable, 'p');
 
 	// className.metatable['t'] = type
+	LuaDataType type;
 	if (className == "Item") {
-		lua_pushnumber(luaState, LuaData_Item);
+		type = LuaData_Item;
 	} else if (className == "Container") {
-		lua_pushnumber(luaState, LuaData_Container);
+		type = LuaData_Container;
 	} else if (className == "Teleport") {
-		lua_pushnumber(luaState, LuaData_Teleport);
+		type = LuaData_Teleport;
 	} else if (className == "Player") {
-		lua_pushnumber(luaState, LuaData_Player);
+		type = LuaData_Player;
 	} else if (className == "Monster") {
-		lua_pushnumber(luaState, LuaData_Monster);
+		type = LuaData_Monster;
 	} else if (className == "Npc") {
-		lua_pushnumber(luaState, LuaData_Npc);
+		type = LuaData_Npc;
 	} else if (className == "Tile") {
-		lua_pushnumber(luaState, LuaData_Tile);
+		type = LuaData_Tile;
 	} else {
-		lua_pushnumber(luaState, LuaData_Unknown);
+		type = LuaData_Unknown;
 	}
+	lua_pushnumber(luaState, type);
 	lua_rawseti(luaState, metatable, 't');
 
+	// setMetatable takes it out of a registry slot instead of looking the name up
+	lua_pushvalue(luaState, metatable);
+	int32_t ref = luaL_ref(luaState, LUA_REGISTRYINDEX);
+	metatableRefs[className] = ref;
+	if (type != LuaData_Unknown) {
+		typeMetatableRefs[type] = ref;
+	}
+
 	// pop className, className.metatable
 	lua_pop(luaState, 2);
 }
@@ -3611,39 +3830,21 @@ int LuaScriptInterface::luaAddEvent(lua_State* L)
 	eventDesc.function = luaL_ref(L, LUA_REGISTRYINDEX);
 	eventDesc.scriptId = getScriptEnv()->getScriptId();
 
-	auto& lastTimerEventId = g_luaEnvironment.lastEventTimerId;
-	eventDesc.eventId = g_scheduler.addEvent(createSchedulerTask(
-		delay, std::bind(&LuaEnvironment::executeTimerEvent, &g_luaEnvironment, lastTimerEventId)
-	));
+	uint64_t eventId = g_luaEnvironment.addTimerEvent(std::move(eventDesc), delay);
+	if (eventId == 0) {
+		pushBoolean(L, false);
+		return 1;
+	}
 
-	g_luaEnvironment.timerEvents.emplace(lastTimerEventId, std::move(eventDesc));
-	lua_pushnumber(L, lastTimerEventId++);
+	lua_pushnumber(L, eventId);
 	return 1;
 }
 
 int LuaScriptInterface::luaStopEvent(lua_State* L)
 {
 	//stopEvent(eventid)
-	uint32_t eventId = getNumber<uint32_t>(L, 1);
-
-	auto& timerEvents = g_luaEnvironment.timerEvents;
-	auto it = timerEvents.find(eventId);
-	if (it == timerEvents.end()) {
-		pushBoolean(L, false);
-		return 1;
-	}
-
-	LuaTimerEventDesc timerEventDesc = std::move(it->second);
-	timerEvents.erase(it);
-
-	g_scheduler.stopEvent(timerEventDesc.eventId);
-	luaL_unref(L, LUA_REGISTRYINDEX, timerEventDesc.function);
-
-	for (auto parameter : timerEventDesc.parameters) {
-		luaL_unref(L, LUA_REGISTRYINDEX, parameter);
-	}
-
-	pushBoolean(L, true);
+	uint64_t eventId = getNumber<uint64_t>(L, 1);
+	pushBoolean(L, g_luaEnvironment.stopTimerEvent(eventId));
 	return 1;
 }
 
@@ -3741,6 +3942,107 @@ int LuaScriptInterface::luaIsScriptsInterface(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaAppendFile(lua_State* L)
+{
+	//appendFile(fileName, text[, callback(success)])
+	std::string fileName = getString(L, 1);
+	std::string text = getString(L, 2);
+
+	std::function<void(bool)> callback;
+	if (isFunction(L, 3)) {
+		lua_pushvalue(L, 3);
+		int32_t ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		auto scriptId = getScriptEnv()->getScriptId();
+		callback = [ref, scriptId](bool success) {
+			// file thread, the script runs back on the dispatcher
+			g_dispatcher.addTask(createTask([ref, scriptId, success]() {
+				lua_State* luaState = g_luaEnvironment.getLuaState();
+				if (!luaState) {
+					return;
+				}
+
+				if (!LuaScriptInterface::reserveScriptEnv()) {
+					luaL_unref(luaState, LUA_REGISTRYINDEX, ref);
+					return;
+				}
+
+				lua_rawgeti(luaState, LUA_REGISTRYINDEX, ref);
+				pushBoolean(luaState, success);
+				auto env = getScriptEnv();
+				env->setScriptId(scriptId, &g_luaEnvironment);
+				g_luaEnvironment.callFunction(1);
+
+				luaL_unref(luaState, LUA_REGISTRYINDEX, ref);
+			}));
+		};
+	}
+
+	g_fileTasks.writeFile(fileName, std::move(text), true, std::move(callback));
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaMarkPure(lua_State* L)
+{
+	//markPure(function)
+	if (!isFunction(L, 1) || lua_iscfunction(L, 1)) {
+		reportErrorFunc(L, "Only Lua functions can be marked pure.");
+		lua_pushnil(L);
+		return 1;
+	}
+
+	// the bytecode is loaded into other states, where upvalues would be nil
+	const char* upvalueName;
+	for (int i = 1; (upvalueName = lua_getupvalue(L, 1, i)); ++i) {
+		lua_pop(L, 1);
+		if (strcmp(upvalueName, "_ENV") != 0) {
+			reportErrorFunc(L, fmt::format("Pure functions cannot use upvalues ({:s}).", upvalueName));
+			lua_pushnil(L);
+			return 1;
+		}
+	}
+
+	lua_Debug ar;
+	lua_pushvalue(L, 1);
+	lua_getinfo(L, ">S", &ar);
+	std::string name = fmt::format("{:s}:{:d}", ar.short_src, ar.linedefined);
+
+	std::string bytecode;
+	lua_pushvalue(L, 1);
+	const auto writer = [](lua_State*, const void* data, size_t size, void* userdata) {
+		static_cast<std::string*>(userdata)->append(static_cast<const char*>(data), size);
+		return 0;
+	};
+#if LUA_VERSION_NUM >= 503
+	lua_dump(L, writer, &bytecode, 0);
+#else
+	lua_dump(L, writer, &bytecode);
+#endif
+	lua_pop(L, 1);
+
+	uint32_t pureFunctionId = g_pureFunctions.registerFunction(name, std::move(bytecode));
+
+	// by function, weak keys, for the callbacks loaded from it later
+	lua_getfield(L, LUA_REGISTRYINDEX, "pureFunctions");
+	if (!isTable(L, -1)) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_createtable(L, 0, 1);
+		setField(L, "__mode", "k");
+		lua_setmetatable(L, -2);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, "pureFunctions");
+	}
+
+	lua_pushvalue(L, 1);
+	lua_pushnumber(L, pureFunctionId);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+
+	lua_pushvalue(L, 1);
+	return 1;
+}
+
 std::string LuaScriptInterface::escapeString(const std::string& string)
 {
 	std::string s = string;
@@ -3960,8 +4262,12 @@ int LuaScriptInterface::luaResultGetNumber(lua_State* L)
 		return 1;
 	}
 
-	const std::string& s = getString(L, 2);
-	lua_pushnumber(L, res->getNumber<int64_t>(s));
+	if (isNumber(L, 2)) {
+		// column position, starting at 1
+		lua_pushnumber(L, res->getNumber<int64_t>(getNumber<size_t>(L, 2) - 1));
+	} else {
+		lua_pushnumber(L, res->getNumber<int64_t>(getString(L, 2)));
+	}
 	return 1;
 }
 
@@ -3973,8 +4279,11 @@ int LuaScriptInterface::luaResultGetString(lua_State* L)
 		return 1;
 	}
 
-	const std::string& s = getString(L, 2);
-	pushString(L, res->getString(s));
+	if (isNumber(L, 2)) {
+		pushString(L, res->getString(getNumber<size_t>(L, 2) - 1));
+	} else {
+		pushString(L, res->getString(getString(L, 2)));
+	}
 	return 1;
 }
 
@@ -3987,7 +4296,12 @@ int LuaScriptInterface::luaResultGetStream(lua_State* L)
 	}
 
 	unsigned long length;
-	const char* stream = res->getStream(getString(L, 2), length);
+	const char* stream;
+	if (isNumber(L, 2)) {
+		stream = res->getStream(getNumber<size_t>(L, 2) - 1, length);
+	} else {
+		stream = res->getStream(getString(L, 2), length);
+	}
 	lua_pushlstring(L, stream, length);
 	lua_pushnumber(L, length);
 	return 2;
@@ -4126,6 +4440,110 @@ int LuaScriptInterface::luaGameGetPlayers(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaGameBroadcastMessage(lua_State* L)
+{
+	// Game.broadcastMessage(message[, messageType = MESSAGE_STATUS_WARNING])
+	const MessageClasses type = isNumber(L, 2) ? getNumber<MessageClasses>(L, 2) : MESSAGE_STATUS_WARNING;
+	g_game.broadcastMessage(getString(L, 1), type);
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameReloadBans(lua_State* L)
+{
+	// Game.reloadBans()
+	IOBan::reloadBans();
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetSpectatorCacheStats(lua_State* L)
+{
+	// Game.getSpectatorCacheStats()
+	const SpectatorCacheStats stats = g_game.map.getSpectatorCacheStats();
+	lua_createtable(L, 0, 4);
+	setField(L, "hits", stats.hits);
+	setField(L, "misses", stats.misses);
+	setField(L, "invalidations", stats.invalidations);
+	setField(L, "entries", stats.entries);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetDatabaseTasksStats(lua_State* L)
+{
+	// Game.getDatabaseTasksStats()
+	const DatabaseTasksStats stats = g_databaseTasks.getStats();
+	lua_createtable(L, 0, 6);
+	setField(L, "queueDepth", stats.queueDepth);
+	setField(L, "maxQueueDepth", stats.maxQueueDepth);
+	setField(L, "tasks", stats.tasks);
+	setField(L, "batches", stats.batches);
+	setField(L, "maxBatchSize", stats.maxBatchSize);
+	setField(L, "coalesced", stats.coalesced);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetObjectPoolStats(lua_State* L)
+{
+	// Game.getObjectPoolStats()
+	const auto pushPoolStats = [L](const char* name, const LockfreePoolStats& stats) {
+		lua_createtable(L, 0, 4);
+		setField(L, "hits", stats.hits);
+		setField(L, "misses", stats.misses);
+		setField(L, "inUse", stats.inUse);
+		setField(L, "highWaterMark", stats.highWaterMark);
+		lua_setfield(L, -2, name);
+	};
+
+	lua_createtable(L, 0, 11);
+	pushPoolStats("tiles", LockfreePoolCounters<Tile>::get().getStats());
+	pushPoolStats("floors", LockfreePoolCounters<Floor>::get().getStats());
+	pushPoolStats("items", LockfreePoolCounters<Item>::get().getStats());
+	pushPoolStats("containers", LockfreePoolCounters<Container>::get().getStats());
+	pushPoolStats("itemAttributes", LockfreePoolCounters<ItemAttributes>::get().getStats());
+	pushPoolStats("monsters", LockfreePoolCounters<Monster>::get().getStats());
+	pushPoolStats("conditions", LockfreePoolCounters<Condition>::get().getStats());
+	pushPoolStats("outputMessages", OutputMessagePool::getPoolStats(OutputMessagePool::FULL_CAPACITY));
+	pushPoolStats("mediumOutputMessages", OutputMessagePool::getPoolStats(OutputMessagePool::MEDIUM_CAPACITY));
+	pushPoolStats("smallOutputMessages", OutputMessagePool::getPoolStats(OutputMessagePool::SMALL_CAPACITY));
+	pushPoolStats("inboundMessages", LockfreePoolCounters<InboundMessage>::get().getStats());
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetSendQueueStats(lua_State* L)
+{
+	// Game.getSendQueueStats()
+	const SendQueueStats stats = ConnectionManager::getInstance().getSendQueueStats();
+	lua_createtable(L, 0, 6);
+	setField(L, "droppedPackets", stats.droppedPackets);
+	setField(L, "closedConnections", stats.closedConnections);
+	setField(L, "writes", stats.writes);
+	setField(L, "writtenMessages", stats.writtenMessages);
+	setField(L, "writtenBytes", stats.writtenBytes);
+	setField(L, "messagesPerWrite", stats.writes != 0 ? static_cast<double>(stats.writtenMessages) / stats.writes : 0.);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetLuaTimerStats(lua_State* L)
+{
+	// Game.getLuaTimerStats()
+	const LuaTimerStats& stats = g_luaEnvironment.getTimerStats();
+	lua_createtable(L, 0, 5);
+	setField(L, "pending", stats.pending);
+	setField(L, "fired", stats.fired);
+	setField(L, "batches", stats.batches);
+	setField(L, "maxBatchSize", stats.maxBatchSize);
+
+	// pending timers per script file, to catch scripts that leak events
+	const auto& pendingTimersByScript = g_luaEnvironment.getPendingTimersByScript();
+	lua_createtable(L, 0, pendingTimersByScript.size());
+	for (const auto& it : pendingTimersByScript) {
+		setField(L, g_luaEnvironment.getFileById(it.first).c_str(), it.second);
+	}
+	lua_setfield(L, -2, "scripts");
+	return 1;
+}
+
 int LuaScriptInterface::luaGameGetExperienceStage(lua_State* L)
 {
 	// Game.getExperienceStage(level)
@@ -4449,10 +4867,12 @@ int LuaScriptInterface::luaGameCreateMonsterType(lua_State* L)
 		monsterType->nameDescription = "a " + name;
 	} else {
 		monsterType->info.lootItems.clear();
+		monsterType->info.compiledLoot.clear();
 		monsterType->info.attackSpells.clear();
 		monsterType->info.defenseSpells.clear();
 		monsterType->info.scripts.clear();
 		monsterType->info.thinkEvent = -1;
+		monsterType->info.thinkBatchEvent = -1;
 		monsterType->info.creatureAppearEvent = -1;
 		monsterType->info.creatureDisappearEvent = -1;
 		monsterType->info.creatureMoveEvent = -1;
@@ -4486,6 +4906,19 @@ int LuaScriptInterface::luaGameStartRaid(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaGameLoadMap(lua_State* L)
+{
+	// Game.loadMap(patchName)
+	const std::string& patchName = getString(L, 1);
+	if (patchName.empty() || patchName.find_first_of("/\\") != std::string::npos || patchName.find("..") != std::string::npos) {
+		pushBoolean(L, false);
+		return 1;
+	}
+
+	pushBoolean(L, g_game.loadMap(fmt::format("gamedata/map-patches/{:s}.otbm", patchName)));
+	return 1;
+}
+
 int LuaScriptInterface::luaGameGetClientVersion(lua_State* L)
 {
 	// Game.getClientVersion()
@@ -4510,6 +4943,113 @@ int LuaScriptInterface::luaGameReload(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaGameDumpScriptProfile(lua_State* L)
+{
+	// Game.dumpScriptProfile([fileName = "data/logs/script_profile.log"])
+	if (!g_scriptProfiler.isEnabled()) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	const std::string fileName = isString(L, 1) ? getString(L, 1) : "data/logs/script_profile.log";
+	lua_pushnumber(L, g_scriptProfiler.dump(fileName));
+	return 1;
+}
+
+int LuaScriptInterface::luaGameResetScriptProfile(lua_State* L)
+{
+	// Game.resetScriptProfile()
+	g_scriptProfiler.reset();
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetTrafficStats(lua_State* L)
+{
+	// Game.getTrafficStats()
+	if (!g_trafficStats.isEnabled()) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	// {sent = {[opcode] = {messages = n, bytes = n}}, received = {...}}, only the opcodes seen so far
+	const auto pushEntries = [L](const std::array<TrafficStats::Entry, 256>& entries) {
+		lua_newtable(L);
+		for (size_t opcode = 0; opcode < entries.size(); ++opcode) {
+			const TrafficStats::Entry& entry = entries[opcode];
+			if (entry.messages == 0) {
+				continue;
+			}
+
+			lua_createtable(L, 0, 2);
+			setField(L, "messages", entry.messages);
+			setField(L, "bytes", entry.bytes);
+			lua_rawseti(L, -2, opcode);
+		}
+	};
+
+	lua_createtable(L, 0, 2);
+	pushEntries(g_trafficStats.getSent());
+	lua_setfield(L, -2, "sent");
+	pushEntries(g_trafficStats.getReceived());
+	lua_setfield(L, -2, "received");
+	return 1;
+}
+
+int LuaScriptInterface::luaGameDumpTrafficStats(lua_State* L)
+{
+	// Game.dumpTrafficStats([fileName = "data/logs/traffic.log"])
+	if (!g_trafficStats.isEnabled()) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	const std::string fileName = isString(L, 1) ? getString(L, 1) : "data/logs/traffic.log";
+	g_trafficStats.dump(fileName);
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameResetTrafficStats(lua_State* L)
+{
+	// Game.resetTrafficStats()
+	g_trafficStats.reset();
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameGetMemoryStats(lua_State* L)
+{
+	// Game.getMemoryStats()
+	const MemoryStats stats = getMemoryStats();
+	lua_createtable(L, 0, 15);
+	setField(L, "items", stats.items);
+	setField(L, "itemAttributes", stats.itemAttributes);
+	setField(L, "itemAttributesBytes", stats.itemAttributesBytes);
+	setField(L, "players", stats.players);
+	setField(L, "monsters", stats.monsters);
+	setField(L, "npcs", stats.npcs);
+	setField(L, "tiles", stats.tiles);
+	setField(L, "floors", stats.floors);
+	setField(L, "refreshItems", stats.refreshItems);
+	setField(L, "refreshBytes", stats.refreshBytes);
+	setField(L, "outputMessages", stats.outputMessages);
+	setField(L, "statements", stats.statements);
+	setField(L, "listeners", stats.listeners);
+	setField(L, "luaMemory", stats.luaMemory);
+	setField(L, "depotItems", stats.depotItems);
+	return 1;
+}
+
+int LuaScriptInterface::luaGameDumpMemoryReport(lua_State* L)
+{
+	// Game.dumpMemoryReport([fileName = "data/logs/memory.log"])
+	const std::string fileName = isString(L, 1) ? getString(L, 1) : "data/logs/memory.log";
+	dumpMemoryReport(fileName);
+	pushBoolean(L, true);
+	return 1;
+}
+
 int LuaScriptInterface::luaGameGetAccountStorageValue(lua_State* L)
 {
 	// Game.getAccountStorageValue(accountId, key)
@@ -4732,6 +5272,11 @@ int LuaScriptInterface::luaPositionIsSightClear(lua_State* L)
 int LuaScriptInterface::luaPositionSendMagicEffect(lua_State* L)
 {
 	// position:sendMagicEffect(magicEffect[, player = nullptr])
+	if (g_loadShedder.dropScriptEffects()) {
+		pushBoolean(L, true);
+		return 1;
+	}
+
 	SpectatorVec spectators;
 	if (lua_gettop(L) >= 3) {
 		Player* player = getPlayer(L, 3);
@@ -4755,6 +5300,11 @@ int LuaScriptInterface::luaPositionSendMagicEffect(lua_State* L)
 int LuaScriptInterface::luaPositionSendDistanceEffect(lua_State* L)
 {
 	// position:sendDistanceEffect(positionEx, distanceEffect[, player = nullptr])
+	if (g_loadShedder.dropScriptEffects()) {
+		pushBoolean(L, true);
+		return 1;
+	}
+
 	SpectatorVec spectators;
 	if (lua_gettop(L) >= 4) {
 		Player* player = getPlayer(L, 4);
@@ -6417,7 +6967,10 @@ int LuaScriptInterface::luaItemGetAttribute(lua_State* L)
 		attribute = ITEM_ATTRIBUTE_NONE;
 	}
 
-	if (ItemAttributes::isIntAttrType(attribute)) {
+	if (attribute == ITEM_ATTRIBUTE_DURATION) {
+		// the attribute of a decaying item is only updated when it stops decaying
+		lua_pushnumber(L, item->getDuration());
+	} else if (ItemAttributes::isIntAttrType(attribute)) {
 		lua_pushnumber(L, item->getIntAttr(attribute));
 	} else if (ItemAttributes::isStrAttrType(attribute)) {
 		pushString(L, item->getStrAttr(attribute));
@@ -6452,7 +7005,13 @@ int LuaScriptInterface::luaItemSetAttribute(lua_State* L)
 			return 1;
 		}
 
-		item->setIntAttr(attribute, getNumber<int32_t>(L, 3));
+		if (attribute == ITEM_ATTRIBUTE_DURATION) {
+			item->setDuration(getNumber<int32_t>(L, 3));
+		} else if (attribute == ITEM_ATTRIBUTE_DECAYSTATE) {
+			item->setDecaying(getNumber<ItemDecayState_t>(L, 3));
+		} else {
+			item->setIntAttr(attribute, getNumber<int32_t>(L, 3));
+		}
 		pushBoolean(L, true);
 	} else if (ItemAttributes::isStrAttrType(attribute)) {
 		item->setStrAttr(attribute, getString(L, 3));
@@ -6929,6 +7488,40 @@ int LuaScriptInterface::luaContainerAddItemEx(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaContainerMoveItems(lua_State* L)
+{
+	// container:moveItems(items[, flags = 0])
+	Container* container = getUserdata<Container>(L, 1);
+	if (!container) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	if (!isTable(L, 2)) {
+		reportErrorFunc(L, "Items must be a table");
+		lua_pushnil(L);
+		return 1;
+	}
+
+	ItemVector items;
+	lua_pushnil(L);
+	while (lua_next(L, 2) != 0) {
+		Item* item = getUserdata<Item>(L, -1);
+		lua_pop(L, 1);
+		if (!item) {
+			lua_pop(L, 1);
+			reportErrorFunc(L, getErrorDesc(LUA_ERROR_ITEM_NOT_FOUND));
+			lua_pushnil(L);
+			return 1;
+		}
+		items.push_back(item);
+	}
+
+	uint32_t flags = getNumber<uint32_t>(L, 3, 0);
+	lua_pushnumber(L, g_game.internalMoveItems(items, container, flags));
+	return 1;
+}
+
 int LuaScriptInterface::luaContainerGetCorpseOwner(lua_State* L)
 {
 	// container:getCorpseOwner()
@@ -8099,6 +8692,33 @@ int LuaScriptInterface::luaPlayerGetIp(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaPlayerGetTrafficStats(lua_State* L)
+{
+	// player:getTrafficStats()
+	Player* player = getUserdata<Player>(L, 1);
+	if (!player || !g_trafficStats.isEnabled()) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	const TrafficCounter* counter = player->getTrafficCounter();
+	if (!counter) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	// totals since login, rates per second over the last complete window
+	const TrafficCounter::Rates rates = counter->getRates(OTSYS_TIME());
+	lua_createtable(L, 0, 6);
+	setField(L, "sentBytes", counter->getSentBytes());
+	setField(L, "receivedBytes", counter->getReceivedBytes());
+	setField(L, "sentBytesPerSecond", rates.sentBytes);
+	setField(L, "sentMessagesPerSecond", rates.sentMessages);
+	setField(L, "receivedBytesPerSecond", rates.receivedBytes);
+	setField(L, "receivedMessagesPerSecond", rates.receivedMessages);
+	return 1;
+}
+
 int LuaScriptInterface::luaPlayerGetAccountId(lua_State* L)
 {
 	// player:getAccountId()
@@ -8586,10 +9206,10 @@ int LuaScriptInterface::luaPlayerGetMurderTimestamps(lua_State* L)
 		return 1;
 	}
 
-	lua_createtable(L, player->murderTimeStamps.size(), 0);
+	lua_createtable(L, player->cold->murderTimeStamps.size(), 0);
 
 	uint32_t i = 1;
-	for (time_t currentMurderTimestamp : player->murderTimeStamps) {
+	for (time_t currentMurderTimestamp : player->cold->murderTimeStamps) {
 		lua_pushnumber(L, static_cast<int64_t>(currentMurderTimestamp));
 		lua_rawseti(L, -2, ++i);
 	}
@@ -9689,6 +10309,18 @@ int LuaScriptInterface::luaPlayerSave(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaPlayerExportTextFile(lua_State* L)
+{
+	// player:exportTextFile()
+	Player* player = getUserdata<Player>(L, 1);
+	if (player) {
+		pushBoolean(L, IOLoginData::exportPlayerTextFile(player));
+	} else {
+		lua_pushnil(L);
+	}
+	return 1;
+}
+
 int LuaScriptInterface::luaPlayerPopupFYI(lua_State* L)
 {
 	// player:popupFYI(message)
@@ -9815,6 +10447,7 @@ int LuaScriptInterface::luaPlayerSetGhostMode(lua_State* L)
 
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, position, true);
+	const TileStackpos stackpos(tile, player);
 	for (Creature* spectator : spectators) {
 		if (Monster* monster = spectator->getMonster()) {
 			if (!enabled) {
@@ -9824,9 +10457,9 @@ int LuaScriptInterface::luaPlayerSetGhostMode(lua_State* L)
 		} else if (Player* tmpPlayer = spectator->getPlayer()) {
 			if (tmpPlayer != player && !tmpPlayer->isAccessPlayer()) {
 				if (enabled) {
-					tmpPlayer->sendRemoveTileCreature(player, position, tile->getClientIndexOfCreature(tmpPlayer, player));
+					tmpPlayer->sendRemoveTileCreature(player, position, stackpos.get(tmpPlayer));
 				} else {
-					tmpPlayer->sendCreatureAppear(player, position);
+					tmpPlayer->sendCreatureAppear(player, position, stackpos);
 					if (showEffect) {
 						g_game.addMagicEffect(position, CONST_ME_TELEPORT);
 					}
@@ -9860,6 +10493,61 @@ int LuaScriptInterface::luaPlayerSetGhostMode(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaPlayerStartCast(lua_State* L)
+{
+	// player:startCast([password = ""])
+	Player* player = getUserdata<Player>(L, 1);
+	if (!player) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	player->startCast(getString(L, 2));
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaPlayerStopCast(lua_State* L)
+{
+	// player:stopCast()
+	Player* player = getUserdata<Player>(L, 1);
+	if (!player) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	player->stopCast();
+	pushBoolean(L, true);
+	return 1;
+}
+
+int LuaScriptInterface::luaPlayerIsCasting(lua_State* L)
+{
+	// player:isCasting()
+	Player* player = getUserdata<Player>(L, 1);
+	if (!player) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	pushBoolean(L, player->getCast() != nullptr);
+	return 1;
+}
+
+int LuaScriptInterface::luaPlayerGetCastViewers(lua_State* L)
+{
+	// player:getCastViewers()
+	Player* player = getUserdata<Player>(L, 1);
+	if (!player) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	const Cast* cast = player->getCast();
+	lua_pushnumber(L, cast ? cast->getViewers() : 0);
+	return 1;
+}
+
 int LuaScriptInterface::luaPlayerGetContainerId(lua_State* L)
 {
 	// player:getContainerId(container)
@@ -13397,6 +14085,7 @@ int LuaScriptInterface::luaMonsterTypeEventOnCallback(lua_State* L)
 	// monsterType:onDisappear(callback)
 	// monsterType:onMove(callback)
 	// monsterType:onSay(callback)
+	// monsterType:onThinkBatch(callback)
 	MonsterType* monsterType = getUserdata<MonsterType>(L, 1);
 	if (monsterType) {
 		if (monsterType->loadCallback(&g_scripts->getScriptInterface())) {
@@ -13751,21 +14440,15 @@ int LuaScriptInterface::luaLootSetId(lua_State* L)
 			loot->lootBlock.id = getNumber<uint16_t>(L, 2);
 		} else {
 			auto name = getString(L, 2);
-			auto ids = Item::items.nameToItems.equal_range(asLowerCaseString(name));
+			auto ids = Item::items.getItemIdsByName(name);
 
-			if (ids.first == Item::items.nameToItems.cend()) {
+			if (ids.first == ids.second) {
 				std::cout << "[Warning - Loot:setId] Unknown loot item \"" << name << "\". " << std::endl;
 				pushBoolean(L, false);
 				return 1;
 			}
 
-			if (std::next(ids.first) != ids.second) {
-				std::cout << "[Warning - Loot:setId] Non-unique loot item \"" << name << "\". " << std::endl;
-				pushBoolean(L, false);
-				return 1;
-			}
-
-			loot->lootBlock.id = ids.first->second;
+			loot->lootBlock.id = ids.first->id;
 		}
 		pushBoolean(L, true);
 	} else {
@@ -16600,13 +17283,74 @@ bool LuaEnvironment::initState()
 		return false;
 	}
 
+#ifndef LUAJIT_VERSION
+	// mallocs like the default one, counting the bytes for the script profiler
+	lua_setallocf(luaState, ScriptProfiler::luaAlloc, nullptr);
+#endif
+
 	luaL_openlibs(luaState);
 	registerFunctions();
 
+	applyGarbageCollectorMode();
+
 	runningEventId = EVENT_ID_USER;
 	return true;
 }
 
+void LuaEnvironment::loadGarbageCollectorConfig()
+{
+	gcIdleBudget = std::chrono::microseconds(g_config.getNumber(ConfigManager::LUA_GC_IDLE_BUDGET));
+	gcGenerational = g_config.getBoolean(ConfigManager::LUA_GC_GENERATIONAL);
+
+#if LUA_VERSION_NUM < 504
+	if (gcGenerational) {
+		std::cout << "> Warning: luaGcGenerational needs Lua 5.4, the garbage is collected incrementally." << std::endl;
+		gcGenerational = false;
+	}
+#endif
+	applyGarbageCollectorMode();
+}
+
+void LuaEnvironment::applyGarbageCollectorMode()
+{
+#if LUA_VERSION_NUM >= 504
+	if (!luaState) {
+		return;
+	}
+
+	// zero keeps a parameter as it is: minor and major multiplier, or pause, step multiplier and step size
+	if (gcGenerational) {
+		lua_gc(luaState, LUA_GCGEN, 0, 0);
+	} else {
+		lua_gc(luaState, LUA_GCINC, 0, 0, 0);
+	}
+#endif
+}
+
+bool LuaEnvironment::stepGarbageCollector()
+{
+	//dispatcher thread
+	if (!luaState || gcIdleBudget.count() == 0) {
+		return false;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	auto now = start;
+	bool cycleDone;
+	do {
+		// a basic step, a young collection in generational mode, which never reports the end of a cycle
+		cycleDone = lua_gc(luaState, LUA_GCSTEP, 0) != 0 || gcGenerational;
+		++gcStats.steps;
+		now = std::chrono::steady_clock::now();
+	} while (!cycleDone && now - start < gcIdleBudget);
+
+	gcStats.time += now - start;
+	if (cycleDone) {
+		++gcStats.cycles;
+	}
+	return !cycleDone;
+}
+
 bool LuaEnvironment::reInitState()
 {
 	// TODO: get children, reload children
@@ -16628,8 +17372,11 @@ bool LuaEnvironment::closeState()
 		clearAreaObjects(areaEntry.first);
 	}
 
-	for (auto& timerEntry : timerEvents) {
-		LuaTimerEventDesc timerEventDesc = std::move(timerEntry.second);
+	for (const LuaTimerEventDesc& timerEventDesc : timerEvents) {
+		if (timerEventDesc.function == -1) {
+			continue;
+		}
+
 		for (int32_t parameter : timerEventDesc.parameters) {
 			luaL_unref(luaState, LUA_REGISTRYINDEX, parameter);
 		}
@@ -16638,8 +17385,17 @@ bool LuaEnvironment::closeState()
 
 	combatIdMap.clear();
 	areaIdMap.clear();
+	// the wheel event keeps running until its next tick finds nothing pending
 	timerEvents.clear();
+	freeTimerEvents.clear();
+	for (auto& slot : timerWheel) {
+		slot.clear();
+	}
+	pendingTimersByScript.clear();
+	timerStats.pending = 0;
 	cacheFiles.clear();
+	g_scriptProfiler.forgetInterface(this);
+	internedUserdataRef = LUA_NOREF;
 
 	lua_close(luaState);
 	luaState = nullptr;
@@ -16721,37 +17477,182 @@ void LuaEnvironment::clearAreaObjects(LuaScriptInterface* interface)
 	it->second.clear();
 }
 
-void LuaEnvironment::executeTimerEvent(uint32_t eventIndex)
+uint64_t LuaEnvironment::getTimerTime()
 {
-	auto it = timerEvents.find(eventIndex);
-	if (it == timerEvents.end()) {
-		return;
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t LuaEnvironment::addTimerEvent(LuaTimerEventDesc&& eventDesc, uint32_t delay)
+{
+	uint32_t index;
+	if (!freeTimerEvents.empty()) {
+		index = freeTimerEvents.back();
+		freeTimerEvents.pop_back();
+	} else if (timerEvents.size() <= TIMER_INDEX_MASK) {
+		index = timerEvents.size();
+		timerEvents.emplace_back();
+	} else {
+		std::cout << "[Error - LuaEnvironment::addTimerEvent] Too many pending events." << std::endl;
+		luaL_unref(luaState, LUA_REGISTRYINDEX, eventDesc.function);
+		for (auto parameter : eventDesc.parameters) {
+			luaL_unref(luaState, LUA_REGISTRYINDEX, parameter);
+		}
+		return 0;
 	}
 
-	LuaTimerEventDesc timerEventDesc = std::move(it->second);
-	timerEvents.erase(it);
+	const uint64_t now = getTimerTime();
+	const uint64_t currentTick = now / LUA_TIMER_TICK;
+	if (timerWheelEventId == 0) {
+		// the wheel has been idle, whatever is left in its slots are stopped events
+		timerWheelTick = currentTick;
+		timerWheelEventId = g_scheduler.addEvent(createSchedulerTask(
+			LUA_TIMER_TICK, std::bind(&LuaEnvironment::executeTimerEvents, this), "LuaEnvironment::executeTimerEvents"
+		));
+	}
 
-	//push function
-	lua_rawgeti(luaState, LUA_REGISTRYINDEX, timerEventDesc.function);
+	LuaTimerEventDesc& timerEvent = timerEvents[index];
+	const uint32_t generation = timerEvent.generation;
+	timerEvent = std::move(eventDesc);
+	timerEvent.generation = generation;
+	// the first tick at or after the due time, counted from now and not from the start of the current tick,
+	// timers never run early
+	timerEvent.expireTick = std::max(currentTick + 1, (now + delay + LUA_TIMER_TICK - 1) / LUA_TIMER_TICK);
 
-	//push parameters
-	for (auto parameter : boost::adaptors::reverse(timerEventDesc.parameters)) {
-		lua_rawgeti(luaState, LUA_REGISTRYINDEX, parameter);
-	}
+	const uint64_t eventId = (static_cast<uint64_t>(generation) << TIMER_INDEX_BITS) | index;
+	timerWheel[timerEvent.expireTick & TIMER_WHEEL_MASK].push_back(eventId);
 
-	//call the function
-	if (reserveScriptEnv()) {
-		ScriptEnvironment* env = getScriptEnv();
-		env->setTimerEvent();
-		env->setScriptId(timerEventDesc.scriptId, this);
-		callFunction(timerEventDesc.parameters.size());
-	} else {
-		std::cout << "[Error - LuaScriptInterface::executeTimerEvent] Call stack overflow" << std::endl;
+	++pendingTimersByScript[timerEvent.scriptId];
+	++timerStats.pending;
+	return eventId;
+}
+
+bool LuaEnvironment::stopTimerEvent(uint64_t eventId)
+{
+	// the slot keeps the stale id until the wheel passes over it
+	if (!getTimerEvent(eventId)) {
+		return false;
 	}
 
-	//free resources
+	LuaTimerEventDesc timerEventDesc = releaseTimerEvent(eventId);
 	luaL_unref(luaState, LUA_REGISTRYINDEX, timerEventDesc.function);
 	for (auto parameter : timerEventDesc.parameters) {
 		luaL_unref(luaState, LUA_REGISTRYINDEX, parameter);
 	}
+	return true;
+}
+
+LuaTimerEventDesc* LuaEnvironment::getTimerEvent(uint64_t eventId)
+{
+	uint32_t index = eventId & TIMER_INDEX_MASK;
+	if (index >= timerEvents.size()) {
+		return nullptr;
+	}
+
+	LuaTimerEventDesc& timerEvent = timerEvents[index];
+	if (timerEvent.function == -1 || timerEvent.generation != (eventId >> TIMER_INDEX_BITS)) {
+		return nullptr;
+	}
+	return &timerEvent;
+}
+
+LuaTimerEventDesc LuaEnvironment::releaseTimerEvent(uint64_t eventId)
+{
+	uint32_t index = eventId & TIMER_INDEX_MASK;
+	LuaTimerEventDesc& timerEvent = timerEvents[index];
+
+	LuaTimerEventDesc timerEventDesc = std::move(timerEvent);
+	timerEvent.function = -1;
+	timerEvent.parameters.clear();
+	// generation 0 is skipped so that no event id is ever 0
+	timerEvent.generation = std::max<uint32_t>(1, timerEventDesc.generation + 1);
+	freeTimerEvents.push_back(index);
+
+	auto it = pendingTimersByScript.find(timerEventDesc.scriptId);
+	if (it != pendingTimersByScript.end() && --it->second == 0) {
+		pendingTimersByScript.erase(it);
+	}
+	--timerStats.pending;
+	return timerEventDesc;
+}
+
+void LuaEnvironment::executeTimerEvents()
+{
+	const uint64_t currentTick = getTimerTime() / LUA_TIMER_TICK;
+
+	// after a long stall a single pass over the wheel already covers every slot
+	uint64_t tick = timerWheelTick;
+	if (currentTick >= tick + TIMER_WHEEL_SIZE) {
+		tick = currentTick - TIMER_WHEEL_SIZE + 1;
+	}
+
+	dueTimerEvents.clear();
+	for (; tick <= currentTick; ++tick) {
+		auto& slot = timerWheel[tick & TIMER_WHEEL_MASK];
+		size_t kept = 0;
+		for (uint64_t eventId : slot) {
+			const LuaTimerEventDesc* timerEvent = getTimerEvent(eventId);
+			if (!timerEvent) {
+				continue;
+			}
+
+			if (timerEvent->expireTick <= currentTick) {
+				dueTimerEvents.push_back(eventId);
+			} else {
+				slot[kept++] = eventId;
+			}
+		}
+		slot.resize(kept);
+	}
+	timerWheelTick = std::max(timerWheelTick, currentTick + 1);
+
+	// a callback may stop a timer that is due on the same tick, so every id is checked again
+	uint32_t fired = 0;
+	for (uint64_t eventId : dueTimerEvents) {
+		if (!getTimerEvent(eventId)) {
+			continue;
+		}
+
+		LuaTimerEventDesc timerEventDesc = releaseTimerEvent(eventId);
+
+		//push function
+		lua_rawgeti(luaState, LUA_REGISTRYINDEX, timerEventDesc.function);
+
+		//push parameters
+		for (auto parameter : boost::adaptors::reverse(timerEventDesc.parameters)) {
+			lua_rawgeti(luaState, LUA_REGISTRYINDEX, parameter);
+		}
+
+		//call the function
+		if (reserveScriptEnv()) {
+			ScriptEnvironment* env = getScriptEnv();
+			env->setTimerEvent();
+			env->setScriptId(timerEventDesc.scriptId, this);
+			callFunction(timerEventDesc.parameters.size());
+		} else {
+			lua_pop(luaState, timerEventDesc.parameters.size() + 1);
+			std::cout << "[Error - LuaScriptInterface::executeTimerEvents] Call stack overflow" << std::endl;
+		}
+
+		//free resources
+		luaL_unref(luaState, LUA_REGISTRYINDEX, timerEventDesc.function);
+		for (auto parameter : timerEventDesc.parameters) {
+			luaL_unref(luaState, LUA_REGISTRYINDEX, parameter);
+		}
+		++fired;
+	}
+
+	if (fired != 0) {
+		timerStats.fired += fired;
+		++timerStats.batches;
+		timerStats.maxBatchSize = std::max(timerStats.maxBatchSize, fired);
+	}
+
+	if (timerStats.pending == 0) {
+		timerWheelEventId = 0;
+		return;
+	}
+
+	timerWheelEventId = g_scheduler.addEvent(createSchedulerTask(
+		LUA_TIMER_TICK, std::bind(&LuaEnvironment::executeTimerEvents, this), "LuaEnvironment::executeTimerEvents"
+	));
 }
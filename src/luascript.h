@@ -23,12 +23,17 @@
 #include "enums.h"
 #include "position.h"
 #include "outfit.h"
+#include "scriptprofiler.h"
+
+#include <boost/container/small_vector.hpp>
 
 class Thing;
 class Creature;
 class Player;
 class Item;
 class Container;
+class Teleport;
+class Tile;
 class AreaCombat;
 class Combat;
 using Combat_ptr = std::shared_ptr<Combat>;
@@ -61,8 +66,21 @@ enum LuaDataType {
 	LuaData_Monster,
 	LuaData_Npc,
 	LuaData_Tile,
+
+	LuaData_Last
 };
 
+// objects owned by the game, Lua never frees them so one userdata per object can be shared by every push
+template<class T> struct LuaInternedUserdata : std::false_type {};
+template<> struct LuaInternedUserdata<Creature> : std::true_type {};
+template<> struct LuaInternedUserdata<Player> : std::true_type {};
+template<> struct LuaInternedUserdata<Monster> : std::true_type {};
+template<> struct LuaInternedUserdata<Npc> : std::true_type {};
+template<> struct LuaInternedUserdata<Item> : std::true_type {};
+template<> struct LuaInternedUserdata<Container> : std::true_type {};
+template<> struct LuaInternedUserdata<Teleport> : std::true_type {};
+template<> struct LuaInternedUserdata<Tile> : std::true_type {};
+
 struct LuaVariant {
 	LuaVariantType_t type = VARIANT_NONE;
 	std::string text;
@@ -74,10 +92,26 @@ struct LuaTimerEventDesc {
 	int32_t scriptId = -1;
 	int32_t function = -1;
 	std::vector<int32_t> parameters;
-	uint32_t eventId = 0;
+	uint64_t expireTick = 0;
+	uint32_t generation = 1;
 
 	LuaTimerEventDesc() = default;
 	LuaTimerEventDesc(LuaTimerEventDesc&& other) = default;
+	LuaTimerEventDesc& operator=(LuaTimerEventDesc&& other) = default;
+};
+
+struct LuaTimerStats {
+	uint32_t pending = 0;
+	uint64_t fired = 0;
+	uint64_t batches = 0;
+	uint32_t maxBatchSize = 0;
+};
+
+// garbage collection run while the dispatcher was idle
+struct LuaGcStats {
+	uint64_t steps = 0;
+	uint64_t cycles = 0;
+	std::chrono::nanoseconds time{0};
 };
 
 class LuaScriptInterface;
@@ -148,8 +182,8 @@ class ScriptEnvironment
 		//for npc scripts
 		Npc* curNpc = nullptr;
 
-		//temporary item list
-		static std::multimap<ScriptEnvironment*, Item*> tempItems;
+		//temporary items owned by this environment, each one points back to it (Item::tempScriptEnv)
+		boost::container::small_vector<Item*, 4> tempItems;
 
 		//local item map
 		std::unordered_map<uint32_t, Item*> localMap;
@@ -199,6 +233,14 @@ class LuaScriptInterface
 		int32_t loadFile(const std::string& file, Npc* npc = nullptr);
 
 		const std::string& getFileById(int32_t scriptId);
+
+		// script file names are interned, events compare them by pointer
+		static const std::string* internScriptFile(const std::string& scriptFile);
+		// the file being run by loadFile on this interface, nullptr at any other time
+		const std::string* getLoadingScriptFile() const;
+		// drops the functions a file put in the event table, after its events are gone
+		void forgetScriptFile(const std::string& scriptFile);
+
 		int32_t getEvent(const std::string& eventName);
 		int32_t getEvent();
 		int32_t getMetaEvent(const std::string& globalName, const std::string& eventName);
@@ -231,6 +273,7 @@ class LuaScriptInterface
 		}
 
 		bool pushFunction(int32_t functionId);
+		uint32_t getPureFunctionId(int32_t functionId);
 
 		static int luaErrorHandler(lua_State* L);
 		bool callFunction(int params);
@@ -250,8 +293,18 @@ class LuaScriptInterface
 		template<class T>
 		static void pushUserdata(lua_State* L, T* value)
 		{
+			if constexpr (LuaInternedUserdata<T>::value) {
+				if (pushInternedUserdata(L, value)) {
+					return;
+				}
+			}
+
 			T** userdata = static_cast<T**>(lua_newuserdata(L, sizeof(T*)));
 			*userdata = value;
+
+			if constexpr (LuaInternedUserdata<T>::value) {
+				internUserdata(L, value);
+			}
 		}
 
 		// Shared Ptr
@@ -267,6 +320,7 @@ class LuaScriptInterface
 
 		static void setItemMetatable(lua_State* L, int32_t index, const Item* item);
 		static void setCreatureMetatable(lua_State* L, int32_t index, const Creature* creature);
+		static void setMetatable(lua_State* L, int32_t index, LuaDataType type);
 
 		// Get
 		template<typename T>
@@ -422,7 +476,20 @@ class LuaScriptInterface
 		//script file cache
 		std::map<int32_t, std::string> cacheFiles;
 
+		// registry references of the class metatables, by name and for the game objects by type
+		static std::unordered_map<std::string, int32_t> metatableRefs;
+		static std::array<int32_t, LuaData_Last> typeMetatableRefs;
+		// weak valued registry table from an object pointer to its userdata
+		static int32_t internedUserdataRef;
+
 	private:
+		void profileCall(const ScriptProfiler::CallScope& scope) const;
+
+		// the userdata pushed for a pointer while it is alive, false if there is none
+		static bool pushInternedUserdata(lua_State* L, const void* value);
+		// remembers the userdata on top of the stack as the one of value
+		static void internUserdata(lua_State* L, const void* value);
+
 		void registerClass(const std::string& className, const std::string& baseClass, lua_CFunction newFunction = nullptr);
 		void registerTable(const std::string& tableName);
 		void registerMetaMethod(const std::string& className, const std::string& methodName, lua_CFunction func);
@@ -485,6 +552,8 @@ class LuaScriptInterface
 		static int luaSendGuildChannelMessage(lua_State* L);
 
 		static int luaIsScriptsInterface(lua_State* L);
+		static int luaAppendFile(lua_State* L);
+		static int luaMarkPure(lua_State* L);
 
 #ifndef LUAJIT_VERSION
 		static int luaBitNot(lua_State* L);
@@ -531,6 +600,13 @@ class LuaScriptInterface
 		// Game
 		static int luaGameGetSpectators(lua_State* L);
 		static int luaGameGetPlayers(lua_State* L);
+		static int luaGameBroadcastMessage(lua_State* L);
+		static int luaGameReloadBans(lua_State* L);
+		static int luaGameGetSpectatorCacheStats(lua_State* L);
+		static int luaGameGetDatabaseTasksStats(lua_State* L);
+		static int luaGameGetObjectPoolStats(lua_State* L);
+		static int luaGameGetLuaTimerStats(lua_State* L);
+		static int luaGameGetSendQueueStats(lua_State* L);
 
 		static int luaGameGetExperienceStage(lua_State* L);
 		static int luaGameGetExperienceForLevel(lua_State* L);
@@ -559,6 +635,7 @@ class LuaScriptInterface
 		static int luaGameCreateMonsterType(lua_State* L);
 
 		static int luaGameStartRaid(lua_State* L);
+		static int luaGameLoadMap(lua_State* L);
 
 		static int luaGameGetClientVersion(lua_State* L);
 
@@ -571,6 +648,14 @@ class LuaScriptInterface
 		static int luaGameUnlockAccount(lua_State* L);
 		static int luaGameUnlockIP(lua_State* L);
 
+		static int luaGameDumpScriptProfile(lua_State* L);
+		static int luaGameResetScriptProfile(lua_State* L);
+		static int luaGameGetTrafficStats(lua_State* L);
+		static int luaGameDumpTrafficStats(lua_State* L);
+		static int luaGameResetTrafficStats(lua_State* L);
+		static int luaGameGetMemoryStats(lua_State* L);
+		static int luaGameDumpMemoryReport(lua_State* L);
+
 		// Variant
 		static int luaVariantCreate(lua_State* L);
 
@@ -758,6 +843,7 @@ class LuaScriptInterface
 		static int luaContainerHasItem(lua_State* L);
 		static int luaContainerAddItem(lua_State* L);
 		static int luaContainerAddItemEx(lua_State* L);
+		static int luaContainerMoveItems(lua_State* L);
 		static int luaContainerGetCorpseOwner(lua_State* L);
 
 		// Teleport
@@ -855,6 +941,7 @@ class LuaScriptInterface
 
 		static int luaPlayerGetGuid(lua_State* L);
 		static int luaPlayerGetIp(lua_State* L);
+		static int luaPlayerGetTrafficStats(lua_State* L);
 		static int luaPlayerGetAccountId(lua_State* L);
 		static int luaPlayerGetLastLoginSaved(lua_State* L);
 		static int luaPlayerGetLastLogout(lua_State* L);
@@ -982,6 +1069,7 @@ class LuaScriptInterface
 		static int luaPlayerHasLearnedSpell(lua_State* L);
 
 		static int luaPlayerSave(lua_State* L);
+		static int luaPlayerExportTextFile(lua_State* L);
 		static int luaPlayerPopupFYI(lua_State* L);
 
 		static int luaPlayerIsPzLocked(lua_State* L);
@@ -994,6 +1082,11 @@ class LuaScriptInterface
 
 		static int luaPlayerSetGhostMode(lua_State* L);
 
+		static int luaPlayerStartCast(lua_State* L);
+		static int luaPlayerStopCast(lua_State* L);
+		static int luaPlayerIsCasting(lua_State* L);
+		static int luaPlayerGetCastViewers(lua_State* L);
+
 		static int luaPlayerGetContainerId(lua_State* L);
 		static int luaPlayerGetContainerById(lua_State* L);
 		static int luaPlayerGetContainerIndex(lua_State* L);
@@ -1559,10 +1652,59 @@ class LuaEnvironment : public LuaScriptInterface
 		uint32_t createAreaObject(LuaScriptInterface* interface);
 		void clearAreaObjects(LuaScriptInterface* interface);
 
+		uint64_t addTimerEvent(LuaTimerEventDesc&& eventDesc, uint32_t delay);
+		bool stopTimerEvent(uint64_t eventId);
+
+		const LuaTimerStats& getTimerStats() const {
+			return timerStats;
+		}
+
+		// the collector mode and the idle budget, the mode is set on every new state
+		void loadGarbageCollectorConfig();
+		// collects garbage for up to the idle budget, false once a cycle is done or there is no budget
+		bool stepGarbageCollector();
+		const LuaGcStats& getGcStats() const {
+			return gcStats;
+		}
+		const std::unordered_map<int32_t, uint32_t>& getPendingTimersByScript() const {
+			return pendingTimersByScript;
+		}
+
 	private:
-		void executeTimerEvent(uint32_t eventIndex);
+		/*
+		 * Lua timers (addEvent) are kept in a timing wheel of TIMER_WHEEL_SIZE slots,
+		 * each LUA_TIMER_TICK ms wide. A single scheduler event drives the wheel while
+		 * there are pending timers and runs all the timers due on a tick in one dispatcher task.
+		 * Event ids are handles into the timer table (index + generation). The generation of a slot
+		 * goes up on every release, it takes 2^32 reuses of a slot before an old id could match again,
+		 * and the ids stay below 2^53, so a Lua number holds them exactly.
+		 */
+		static constexpr uint32_t LUA_TIMER_TICK = 50;
+		static constexpr uint32_t TIMER_WHEEL_SIZE = 256;
+		static constexpr uint32_t TIMER_WHEEL_MASK = TIMER_WHEEL_SIZE - 1;
+		static constexpr uint32_t TIMER_INDEX_BITS = 20;
+		static constexpr uint32_t TIMER_INDEX_MASK = (1 << TIMER_INDEX_BITS) - 1;
+
+		// milliseconds, the ticks of the wheel are LUA_TIMER_TICK of them
+		static uint64_t getTimerTime();
+		// switches the collector of the state to gcGenerational, keeping the parameters of the mode
+		void applyGarbageCollectorMode();
+		LuaTimerEventDesc* getTimerEvent(uint64_t eventId);
+		LuaTimerEventDesc releaseTimerEvent(uint64_t eventId);
+		void executeTimerEvents();
+
+		std::vector<LuaTimerEventDesc> timerEvents;
+		std::vector<uint32_t> freeTimerEvents;
+		std::array<std::vector<uint64_t>, TIMER_WHEEL_SIZE> timerWheel;
+		std::vector<uint64_t> dueTimerEvents;
+		std::unordered_map<int32_t, uint32_t> pendingTimersByScript;
+		LuaTimerStats timerStats;
+		LuaGcStats gcStats;
+		std::chrono::microseconds gcIdleBudget{0};
+		bool gcGenerational = false;
+		uint64_t timerWheelTick = 0;
+		uint64_t timerWheelEventId = 0;
 
-		std::unordered_map<uint32_t, LuaTimerEventDesc> timerEvents;
 		std::unordered_map<uint32_t, Combat_ptr> combatMap;
 		std::unordered_map<uint32_t, AreaCombat*> areaMap;
 
@@ -1571,7 +1713,6 @@ class LuaEnvironment : public LuaScriptInterface
 
 		LuaScriptInterface* testInterface = nullptr;
 
-		uint32_t lastEventTimerId = 1;
 		uint32_t lastCombatId = 0;
 		uint32_t lastAreaId = 0;
 
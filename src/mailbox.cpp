@@ -143,29 +143,20 @@ bool Mailbox::sendItem(Item* item) const
 			}
 		}
 	} else {
-		Player tmpPlayer(nullptr);
-		if (!IOLoginData::loadPlayerByName(&tmpPlayer, receiver)) {
+		const uint32_t guid = IOLoginData::getGuidByName(receiver);
+		if (guid == 0) {
 			return false;
 		}
 
-		DepotLocker* depotLocker = tmpPlayer.getDepotLocker(town->getID(), true);
-		if (depotLocker) {
-			int32_t count = 1;
-			if (Container* container = item->getParent()->getContainer()) {
-				count = container->getItemHoldingCount();
-			}
-
-			if (depotLocker->getItemHoldingCount() + count > depotLocker->getMaxDepotItems()) {
-				return false;
-			}
-
-			if (g_game.internalMoveItem(item->getParent(), depotLocker, INDEX_WHEREEVER,
-				item, item->getItemCount(), nullptr, FLAG_NOLIMIT) == RETURNVALUE_NOERROR) {
-				g_game.transformItem(item, item->getID() + 1);
-				IOLoginData::savePlayer(&tmpPlayer);
-				return true;
-			}
+		// appended to the player's inbox file instead of loading and rewriting the whole player
+		Item* sentItem = g_game.transformItem(item, item->getID() + 1);
+		if (!sentItem) {
+			return false;
 		}
+
+		IOLoginData::addPlayerInboxItem(guid, town->getID(), sentItem);
+		g_game.internalRemoveItem(sentItem);
+		return true;
 	}
 	return false;
 }
@@ -8,12 +8,30 @@
 #include "creature.h"
 #include "game.h"
 #include "monster.h"
+#include "profiler.h"
+#include "lockfree.h"
 
 #include <filesystem>
 
 extern Game g_game;
 
+namespace {
+
+using FloorPool = LockfreeObjectPool<Floor, sizeof(Floor), 1024>;
+
+}
+
 bool Map::loadMap(const std::string& identifier, bool loadHouses)
+{
+	if (!loadTilesAndHouses(identifier, loadHouses)) {
+		return false;
+	}
+
+	loadSpawns();
+	return true;
+}
+
+bool Map::loadTilesAndHouses(const std::string& identifier, bool loadHouses)
 {
 	IOMap loader;
 
@@ -28,10 +46,6 @@ bool Map::loadMap(const std::string& identifier, bool loadHouses)
 		return false;
 	}
 
-	if (!IOMap::loadSpawns(this)) {
-		std::cout << "[Warning - Map::loadMap] Failed to load spawn data." << std::endl;
-	}
-
 	if (loadHouses) {
 		std::cout << "> Loading house..." << std::endl;
 		if (!IOMap::loadHouses(this)) {
@@ -42,6 +56,7 @@ bool Map::loadMap(const std::string& identifier, bool loadHouses)
 		if (!IOMap::loadHouseItems(this)) {
 			return false;
 		}
+		IOMap::loadBedSleepers();
 
 		std::cout << "> Loading house owners..." << std::endl;
 		IOMap::loadHouseDatabaseInformation();
@@ -50,6 +65,13 @@ bool Map::loadMap(const std::string& identifier, bool loadHouses)
 	return true;
 }
 
+void Map::loadSpawns()
+{
+	if (!IOMap::loadSpawns(this)) {
+		std::cout << "[Warning - Map::loadMap] Failed to load spawn data." << std::endl;
+	}
+}
+
 bool Map::loadMapPart(const std::string& identifier, bool loadSpawns, bool replaceTiles)
 {
 	IOMap loader;
@@ -90,22 +112,68 @@ bool Map::save()
 }
 
 Tile* Map::getTile(uint16_t x, uint16_t y, uint8_t z) const
+{
+	const Floor* floor = getFloor(x, y, z);
+	if (!floor) {
+		return nullptr;
+	}
+	return floor->tiles[x & FLOOR_MASK][y & FLOOR_MASK];
+}
+
+Floor* Map::getFloor(uint16_t x, uint16_t y, uint8_t z) const
 {
 	if (z >= MAP_MAX_LAYERS) {
 		return nullptr;
 	}
 
+#ifdef TVP_FLAT_MAP_GRID
+	const QTreeLeafNode* leaf = getSectorLeaf(x, y);
+#else
 	const QTreeLeafNode* leaf = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, x, y);
+#endif
 	if (!leaf) {
 		return nullptr;
 	}
+	return leaf->getFloor(z);
+}
 
-	const Floor* floor = leaf->getFloor(z);
-	if (!floor) {
-		return nullptr;
+#ifdef TVP_FLAT_MAP_GRID
+void Map::indexSectorLeaf(uint16_t x, uint16_t y, QTreeLeafNode* leaf)
+{
+	const uint32_t sectorX = x >> FLOOR_BITS;
+	const uint32_t sectorY = y >> FLOOR_BITS;
+
+	if (sectorX < sectorGridX || sectorY < sectorGridY || sectorX >= sectorGridX + sectorGridWidth || sectorY >= sectorGridY + sectorGridHeight) {
+		// grow the box with some slack, sectors are not loaded in any particular order
+		static constexpr uint32_t SECTOR_GRID_SLACK = 64;
+		static constexpr uint32_t SECTOR_GRID_LIMIT = (std::numeric_limits<uint16_t>::max() >> FLOOR_BITS) + 1;
+
+		// the header size bounds the map, so the box never grows past it
+		const uint32_t limitX = width != 0 ? std::min<uint32_t>(SECTOR_GRID_LIMIT, ((width + FLOOR_MASK) >> FLOOR_BITS) + 1) : SECTOR_GRID_LIMIT;
+		const uint32_t limitY = height != 0 ? std::min<uint32_t>(SECTOR_GRID_LIMIT, ((height + FLOOR_MASK) >> FLOOR_BITS) + 1) : SECTOR_GRID_LIMIT;
+
+		const bool empty = sectorGrid.empty();
+		uint32_t newX = (empty || sectorX < sectorGridX) ? sectorX - std::min(sectorX, SECTOR_GRID_SLACK) : sectorGridX;
+		uint32_t newY = (empty || sectorY < sectorGridY) ? sectorY - std::min(sectorY, SECTOR_GRID_SLACK) : sectorGridY;
+		uint32_t newEndX = (empty || sectorX >= sectorGridX + sectorGridWidth) ? std::max(sectorX + 1, std::min(sectorX + SECTOR_GRID_SLACK, limitX)) : sectorGridX + sectorGridWidth;
+		uint32_t newEndY = (empty || sectorY >= sectorGridY + sectorGridHeight) ? std::max(sectorY + 1, std::min(sectorY + SECTOR_GRID_SLACK, limitY)) : sectorGridY + sectorGridHeight;
+
+		std::vector<QTreeLeafNode*> newGrid((newEndX - newX) * (newEndY - newY), nullptr);
+		for (uint32_t row = 0; row < sectorGridHeight; ++row) {
+			auto from = sectorGrid.begin() + row * sectorGridWidth;
+			std::copy(from, from + sectorGridWidth, newGrid.begin() + (sectorGridY + row - newY) * (newEndX - newX) + (sectorGridX - newX));
+		}
+
+		sectorGrid = std::move(newGrid);
+		sectorGridX = newX;
+		sectorGridY = newY;
+		sectorGridWidth = newEndX - newX;
+		sectorGridHeight = newEndY - newY;
 	}
-	return floor->tiles[x & FLOOR_MASK][y & FLOOR_MASK];
+
+	sectorGrid[(sectorY - sectorGridY) * sectorGridWidth + (sectorX - sectorGridX)] = leaf;
 }
+#endif
 
 void Map::setTile(uint16_t x, uint16_t y, uint8_t z, Tile* newTile, bool replaceExistingTiles)
 {
@@ -118,6 +186,10 @@ void Map::setTile(uint16_t x, uint16_t y, uint8_t z, Tile* newTile, bool replace
 	QTreeLeafNode* leaf = root.createLeaf(x, y, 15);
 
 	if (QTreeLeafNode::newLeaf) {
+#ifdef TVP_FLAT_MAP_GRID
+		indexSectorLeaf(x, y, leaf);
+#endif
+
 		//update north
 		QTreeLeafNode* northLeaf = root.getLeaf(x, y - FLOOR_SIZE);
 		if (northLeaf) {
@@ -172,6 +244,7 @@ void Map::setTile(uint16_t x, uint16_t y, uint8_t z, Tile* newTile, bool replace
 		delete newTile;
 	} else {
 		tile = newTile;
+		++tilesVersion;
 
 		if (tile->hasFlag(TILESTATE_REFRESH)) {
 			g_game.addTileToRefresh(tile);
@@ -179,20 +252,13 @@ void Map::setTile(uint16_t x, uint16_t y, uint8_t z, Tile* newTile, bool replace
 
 		g_game.addTileToSave(tile);
 	}
+
+	floor->updateTileMasks(x, y);
 }
 
 void Map::removeTile(uint16_t x, uint16_t y, uint8_t z)
 {
-	if (z >= MAP_MAX_LAYERS) {
-		return;
-	}
-
-	const QTreeLeafNode* leaf = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, x, y);
-	if (!leaf) {
-		return;
-	}
-
-	const Floor* floor = leaf->getFloor(z);
+	Floor* floor = getFloor(x, y, z);
 	if (!floor) {
 		return;
 	}
@@ -220,6 +286,8 @@ void Map::removeTile(uint16_t x, uint16_t y, uint8_t z)
 			g_game.internalRemoveItem(ground);
 			tile->setGround(nullptr);
 		}
+
+		floor->updateTileMasks(x, y);
 	}
 }
 
@@ -278,7 +346,8 @@ bool Map::placeCreature(const Position& centerPos, Creature* creature, bool forc
 	toCylinder->internalAddThing(creature);
 
 	const Position& dest = toCylinder->getPosition();
-	getQTNode(dest.x, dest.y)->addCreature(creature);
+	getQTNode(dest.x, dest.y)->addCreature(creature, dest);
+	invalidateSpectatorCache(dest, creature);
 	return true;
 }
 
@@ -297,10 +366,11 @@ void Map::moveCreature(Creature& creature, Tile& newTile, bool forceTeleport/* =
 	spectators.addSpectators(newPosSpectators);
 
 	std::vector<int32_t> oldStackPosVector;
+	const TileStackpos oldStackpos(&oldTile, &creature);
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
 			if (tmpPlayer->canSeeCreature(&creature)) {
-				oldStackPosVector.push_back(oldTile.getClientIndexOfCreature(tmpPlayer, &creature));
+				oldStackPosVector.push_back(oldStackpos.get(tmpPlayer));
 			} else {
 				oldStackPosVector.push_back(-1);
 			}
@@ -316,12 +386,17 @@ void Map::moveCreature(Creature& creature, Tile& newTile, bool forceTeleport/* =
 	// Switch the node ownership
 	if (leaf != new_leaf) {
 		leaf->removeCreature(&creature);
-		new_leaf->addCreature(&creature);
+		new_leaf->addCreature(&creature, newPos);
+	} else {
+		leaf->moveCreature(&creature, newPos);
 	}
 
 	//add the creature
 	newTile.addThing(&creature);
 
+	invalidateSpectatorCache(oldPos, &creature);
+	invalidateSpectatorCache(newPos, &creature);
+
 	if (!teleport) {
 		if (oldPos.y > newPos.y) {
 			creature.setDirection(DIRECTION_NORTH);
@@ -349,27 +424,30 @@ void Map::moveCreature(Creature& creature, Tile& newTile, bool forceTeleport/* =
 	}
 
 	//send to client
+	const TileStackpos newStackpos(&newTile, &creature);
 	size_t i = 0;
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
 			//Use the correct stackpos
 			int32_t stackpos = oldStackPosVector[i++];
 			if (stackpos != -1) {
-				tmpPlayer->sendMoveCreature(&creature, newPos, newTile.getClientIndexOfCreature(tmpPlayer, &creature), oldPos, stackpos, teleport);
+				tmpPlayer->sendMoveCreature(&creature, newPos, newStackpos.get(tmpPlayer), oldPos, stackpos, teleport);
 			}
 		}
 	}
 
 	//event method
 	for (Creature* spectator : spectators) {
-		spectator->onCreatureMove(&creature, &newTile, newPos, &oldTile, oldPos, teleport);
+		if (spectator->caresAboutMove(&creature)) {
+			spectator->onCreatureMove(&creature, &newTile, newPos, &oldTile, oldPos, teleport);
+		}
 	}
 
 	oldTile.postRemoveNotification(&creature, &newTile, 0);
 	newTile.postAddNotification(&creature, &oldTile, 0);
 }
 
-void Map::getSpectatorsInternal(SpectatorVec& spectators, const Position& centerPos, int32_t minRangeX, int32_t maxRangeX, int32_t minRangeY, int32_t maxRangeY, int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers) const
+void Map::getSpectatorsInternal(SpectatorVec& spectators, const Position& centerPos, int32_t minRangeX, int32_t maxRangeX, int32_t minRangeY, int32_t maxRangeY, int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers, bool onlyHearers/* = false*/) const
 {
 	int_fast16_t min_y = centerPos.y + minRangeY;
 	int_fast16_t min_x = centerPos.x + minRangeX;
@@ -389,6 +467,40 @@ void Map::getSpectatorsInternal(SpectatorVec& spectators, const Position& center
 	int32_t endx2 = x2 - (x2 % FLOOR_SIZE);
 	int32_t endy2 = y2 - (y2 % FLOOR_SIZE);
 
+	auto addList = [&](const LeafCreatureVector& node_list) {
+		for (const LeafCreature& entry : node_list) {
+			const Position& cpos = entry.pos;
+			if (minRangeZ > cpos.z || maxRangeZ < cpos.z) {
+				continue;
+			}
+
+			int_fast16_t offsetZ = Position::getOffsetZ(centerPos, cpos);
+			if ((min_y + offsetZ) > cpos.y || (max_y + offsetZ) < cpos.y || (min_x + offsetZ) > cpos.x || (max_x + offsetZ) < cpos.x) {
+				continue;
+			}
+
+			spectators.emplace_back(entry.creature);
+		}
+	};
+
+	auto addSpectators = [&](const QTreeLeafNode* leaf) {
+		if (onlyHearers) {
+			addList(leaf->player_list);
+			addList(leaf->hearer_list);
+		} else {
+			addList(onlyPlayers ? leaf->player_list : leaf->creature_list);
+		}
+	};
+
+#ifdef TVP_FLAT_MAP_GRID
+	for (int_fast32_t ny = starty1; ny <= endy2; ny += FLOOR_SIZE) {
+		for (int_fast32_t nx = startx1; nx <= endx2; nx += FLOOR_SIZE) {
+			if (const QTreeLeafNode* leaf = getSectorLeaf(nx, ny)) {
+				addSpectators(leaf);
+			}
+		}
+	}
+#else
 	const QTreeLeafNode* startLeaf = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, startx1, starty1);
 	const QTreeLeafNode* leafS = startLeaf;
 	const QTreeLeafNode* leafE;
@@ -397,20 +509,7 @@ void Map::getSpectatorsInternal(SpectatorVec& spectators, const Position& center
 		leafE = leafS;
 		for (int_fast32_t nx = startx1; nx <= endx2; nx += FLOOR_SIZE) {
 			if (leafE) {
-				const CreatureVector& node_list = (onlyPlayers ? leafE->player_list : leafE->creature_list);
-				for (Creature* creature : node_list) {
-					const Position& cpos = creature->getPosition();
-					if (minRangeZ > cpos.z || maxRangeZ < cpos.z) {
-						continue;
-					}
-
-					int_fast16_t offsetZ = Position::getOffsetZ(centerPos, cpos);
-					if ((min_y + offsetZ) > cpos.y || (max_y + offsetZ) < cpos.y || (min_x + offsetZ) > cpos.x || (max_x + offsetZ) < cpos.x) {
-						continue;
-					}
-
-					spectators.emplace_back(creature);
-				}
+				addSpectators(leafE);
 				leafE = leafE->leafE;
 			} else {
 				leafE = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, nx + FLOOR_SIZE, ny);
@@ -423,6 +522,7 @@ void Map::getSpectatorsInternal(SpectatorVec& spectators, const Position& center
 			leafS = QTreeNode::getLeafStatic<const QTreeLeafNode*, const QTreeNode*>(&root, startx1, ny + FLOOR_SIZE);
 		}
 	}
+#endif
 }
 
 void Map::getSpectators(SpectatorVec& spectators, const Position& centerPos, bool multifloor /*= false*/, bool onlyPlayers /*= false*/, int32_t minRangeX /*= 0*/, int32_t maxRangeX /*= 0*/, int32_t minRangeY /*= 0*/, int32_t maxRangeY /*= 0*/)
@@ -438,7 +538,55 @@ void Map::getSpectators(SpectatorVec& spectators, const Position& centerPos, boo
 
 	int32_t minRangeZ;
 	int32_t maxRangeZ;
+	getSpectatorFloors(centerPos, multifloor, minRangeZ, maxRangeZ);
+
+	const SpectatorCacheKey key{centerPos, minRangeX, maxRangeX, minRangeY, maxRangeY, minRangeZ, maxRangeZ, onlyPlayers};
+	auto it = spectatorCache.find(key);
+	if (it == spectatorCache.end()) {
+		++spectatorCacheStats.misses;
+		if (spectatorCache.size() >= SPECTATOR_CACHE_MAX_ENTRIES) {
+			spectatorCache.clear();
+		}
+
+		it = spectatorCache.emplace(key, SpectatorVec()).first;
+		getSpectatorsInternal(it->second, centerPos, minRangeX, maxRangeX, minRangeY, maxRangeY, minRangeZ, maxRangeZ, onlyPlayers);
+	} else {
+		++spectatorCacheStats.hits;
+	}
+
+	for (Creature* spectator : it->second) {
+		spectators.emplace_back(spectator);
+	}
+}
+
+void Map::getHearers(SpectatorVec& hearers, const Position& centerPos, bool multifloor, int32_t rangeX, int32_t rangeY) const
+{
+	if (centerPos.z >= MAP_MAX_LAYERS) {
+		return;
+	}
+
+	int32_t minRangeZ;
+	int32_t maxRangeZ;
+	getSpectatorFloors(centerPos, multifloor, minRangeZ, maxRangeZ);
+
+	// only a few creatures per sector hear, so this is cheap enough to skip the cache
+	getSpectatorsInternal(hearers, centerPos, -rangeX, rangeX, -rangeY, rangeY, minRangeZ, maxRangeZ, false, true);
+}
+
+void Map::updateHearers()
+{
+	for (Monster* monster : g_game.getMonsters()) {
+		if (!monster->getTile()) {
+			continue;
+		}
+
+		const Position& pos = monster->getPosition();
+		getQTNode(pos.x, pos.y)->updateHearer(monster, pos);
+	}
+}
 
+void Map::getSpectatorFloors(const Position& centerPos, bool multifloor, int32_t& minRangeZ, int32_t& maxRangeZ)
+{
 	if (multifloor) {
 		if (centerPos.z > 7) {
 			//underground (8->15)
@@ -458,8 +606,27 @@ void Map::getSpectators(SpectatorVec& spectators, const Position& centerPos, boo
 		minRangeZ = centerPos.z;
 		maxRangeZ = centerPos.z;
 	}
+}
+
+void Map::invalidateSpectatorCache(const Position& pos, const Creature* creature)
+{
+	const bool isPlayer = creature->getPlayer() != nullptr;
+	for (auto it = spectatorCache.begin(); it != spectatorCache.end();) {
+		const SpectatorCacheKey& key = it->first;
+		if ((isPlayer || !key.onlyPlayers) && key.covers(pos)) {
+			++spectatorCacheStats.invalidations;
+			it = spectatorCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
 
-	getSpectatorsInternal(spectators, centerPos, minRangeX, maxRangeX, minRangeY, maxRangeY, minRangeZ, maxRangeZ, onlyPlayers);
+SpectatorCacheStats Map::getSpectatorCacheStats() const
+{
+	SpectatorCacheStats stats = spectatorCacheStats;
+	stats.entries = spectatorCache.size();
+	return stats;
 }
 
 bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool multiFloor) const
@@ -468,6 +635,38 @@ bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool
 		return true;
 	}
 
+	// monsters and spells ask the same pairs over and over while nothing on the line changes
+	const uint64_t positions = (static_cast<uint64_t>(fromPos.x) << 48) | (static_cast<uint64_t>(fromPos.y) << 32) |
+		(static_cast<uint64_t>(toPos.x) << 16) | toPos.y;
+	const uint16_t floors = static_cast<uint16_t>(0x8000 | (multiFloor << 8) | ((fromPos.z & 0x0F) << 4) | (toPos.z & 0x0F));
+	const uint32_t version = Floor::sightVersion.load(std::memory_order_relaxed);
+
+	SightMemoEntry& entry = sightMemo[((positions ^ floors) * 0x9E3779B97F4A7C15ULL) >> (64 - SIGHT_MEMO_BITS)];
+	if (entry.positions == positions && entry.floors == floors && entry.version == version) {
+		return entry.result;
+	}
+
+	entry.positions = positions;
+	entry.floors = floors;
+	entry.version = version;
+	entry.result = computeCanThrowObjectTo(fromPos, toPos, multiFloor);
+	return entry.result;
+}
+
+bool Map::computeCanThrowObjectTo(const Position& fromPos, const Position& toPos, bool multiFloor) const
+{
+	// the line stays in one floor sector for most steps, it is only looked up again once it leaves it
+	const Floor* sightFloor = nullptr;
+	uint32_t sightSector = std::numeric_limits<uint32_t>::max();
+	const auto getSightFlags = [&](int32_t x, int32_t y, int32_t z) -> uint8_t {
+		const uint32_t sector = ((static_cast<uint32_t>(x) >> FLOOR_BITS) << 17) | ((static_cast<uint32_t>(y) >> FLOOR_BITS) << 4) | static_cast<uint32_t>(z);
+		if (sector != sightSector) {
+			sightSector = sector;
+			sightFloor = getFloor(x, y, z);
+		}
+		return sightFloor ? sightFloor->getHotFlags(x, y) & TILEHOT_SIGHT : 0;
+	};
+
 	int32_t deltaz = Position::getDistanceZ(fromPos, toPos);
 	if (deltaz > 2) {
 		return false;
@@ -488,8 +687,7 @@ bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool
 
 	if (sz_minus_one >= sz_minus_power) {
 		while (true) {
-			const Tile* tile = getTile(sx, sy, sz_minus_one);
-			if (tile && tile->getGround()) {
+			if (getSightFlags(sx, sy, sz_minus_one) & TILEHOT_GROUND) {
 				break;
 			}
 
@@ -551,10 +749,10 @@ bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool
 
 					do
 					{
-						const Tile* tile = getTile((x_check + (delta - i) * sx) / delta,
+						const uint8_t hotFlags = getSightFlags((x_check + (delta - i) * sx) / delta,
 							(y_check + (delta - i) * sy) / delta,
 							sz_minus_power_copy);
-						if (tile && tile->hasProperty(CONST_PROP_BLOCKPROJECTILE)) {
+						if (hotFlags & TILEHOT_BLOCKPROJECTILE) {
 							break;
 						}
 
@@ -579,8 +777,7 @@ bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool
 
 				if (sz_minus_power_copy < to_zz_copy) {
 					while (true) {
-						const Tile* tile = getTile(x_final_test, y_final_test, i);
-						if (tile && tile->getGround()) {
+						if (getSightFlags(x_final_test, y_final_test, i) & TILEHOT_GROUND) {
 							break;
 						}
 
@@ -610,10 +807,44 @@ bool Map::canThrowObjectTo(const Position& fromPos, const Position& toPos, bool
 	return false;
 }
 
+void Map::getPlaceableFields(std::vector<Position>& positions, const Position& fromPos, const Position& toPos) const
+{
+	for (int32_t z = fromPos.z; z <= toPos.z; ++z) {
+		for (int32_t sectorY = fromPos.y & ~FLOOR_MASK; sectorY <= toPos.y; sectorY += FLOOR_SIZE) {
+			for (int32_t sectorX = fromPos.x & ~FLOOR_MASK; sectorX <= toPos.x; sectorX += FLOOR_SIZE) {
+				const Floor* floor = getFloor(sectorX, sectorY, z);
+				if (!floor || floor->placeMask == 0) {
+					continue;
+				}
+
+				const int32_t endY = std::min<int32_t>(sectorY + FLOOR_MASK, toPos.y);
+				const int32_t endX = std::min<int32_t>(sectorX + FLOOR_MASK, toPos.x);
+				for (int32_t y = std::max<int32_t>(sectorY, fromPos.y); y <= endY; ++y) {
+					for (int32_t x = std::max<int32_t>(sectorX, fromPos.x); x <= endX; ++x) {
+						if ((floor->placeMask & Floor::getTileBit(x, y)) && !(floor->getHotFlags(x, y) & TILEHOT_CREATURES)) {
+							positions.emplace_back(x, y, z);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
 const Tile* Map::canWalkTo(const Creature& creature, const Position& pos) const
 {
-	Tile* tile = getTile(pos.x, pos.y, pos.z);
+	const Floor* floor = getFloor(pos.x, pos.y, pos.z);
+	if (!floor) {
+		return nullptr;
+	}
+
+	Tile* tile = floor->tiles[pos.x & FLOOR_MASK][pos.y & FLOOR_MASK];
 	if (creature.getTile() != tile) {
+		// no creature paths through it, no need to look at its items
+		if (!(floor->pathableMask & Floor::getTileBit(pos.x, pos.y))) {
+			return nullptr;
+		}
+
 		uint32_t flags = FLAG_PATHFINDING;
 		if (const Monster* monster = creature.getMonster()) {
 			if (monster->getState() == STATE::PANIC) {
@@ -632,6 +863,7 @@ const Tile* Map::canWalkTo(const Creature& creature, const Position& pos) const
 
 bool Map::getPathMatching(Creature& creature, std::vector<Direction>& dirList, const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const
 {
+	PROFILE_FUNCTION();
 	Position pos = creature.getPosition();
 	Position endPos;
 
@@ -813,18 +1045,23 @@ bool Map::getPathMatching(Creature& creature, std::vector<Direction>& dirList, c
 // AStarNodes
 
 AStarNodes::AStarNodes(uint32_t x, uint32_t y)
-	: nodes(), openNodes()
 {
 	curNode = 1;
 	closedNodes = 0;
-	openNodes[0] = true;
+	std::fill(std::begin(nodeTableValues), std::end(nodeTableValues), -1);
 
 	AStarNode& startNode = nodes[0];
 	startNode.parent = nullptr;
 	startNode.x = x;
 	startNode.y = y;
 	startNode.f = 0;
-	nodeTable[(x << 16) | y] = nodes;
+
+	const uint32_t key = (x << 16) | y;
+	const uint32_t slot = getNodeTableSlot(key);
+	nodeTableKeys[slot] = key;
+	nodeTableValues[slot] = 0;
+
+	heapPush(0);
 }
 
 AStarNode* AStarNodes::createOpenNode(AStarNode* parent, uint32_t x, uint32_t y, int_fast32_t f)
@@ -834,43 +1071,40 @@ AStarNode* AStarNodes::createOpenNode(AStarNode* parent, uint32_t x, uint32_t y,
 	}
 
 	size_t retNode = curNode++;
-	openNodes[retNode] = true;
 
 	AStarNode* node = nodes + retNode;
-	nodeTable[(x << 16) | y] = node;
 	node->parent = parent;
 	node->x = x;
 	node->y = y;
 	node->f = f;
+
+	const uint32_t key = (x << 16) | y;
+	uint32_t slot = getNodeTableSlot(key);
+	while (nodeTableValues[slot] != -1) {
+		slot = (slot + 1) & (NODE_TABLE_SIZE - 1);
+	}
+	nodeTableKeys[slot] = key;
+	nodeTableValues[slot] = retNode;
+
+	heapPush(retNode);
 	return node;
 }
 
 AStarNode* AStarNodes::getBestNode()
 {
-	if (curNode == 0) {
+	if (heapSize == 0) {
 		return nullptr;
 	}
-
-	int32_t best_node_f = std::numeric_limits<int32_t>::max();
-	int32_t best_node = -1;
-	for (size_t i = 0; i < curNode; i++) {
-		if (openNodes[i] && nodes[i].f < best_node_f) {
-			best_node_f = nodes[i].f;
-			best_node = i;
-		}
-	}
-
-	if (best_node >= 0) {
-		return nodes + best_node;
-	}
-	return nullptr;
+	return nodes + heap[0];
 }
 
 void AStarNodes::closeNode(AStarNode* node)
 {
 	size_t index = node - nodes;
 	assert(index < MAX_NODES);
-	openNodes[index] = false;
+	if (heapPos[index] != -1) {
+		heapRemove(index);
+	}
 	++closedNodes;
 }
 
@@ -878,9 +1112,12 @@ void AStarNodes::openNode(AStarNode* node)
 {
 	size_t index = node - nodes;
 	assert(index < MAX_NODES);
-	if (!openNodes[index]) {
-		openNodes[index] = true;
+	if (heapPos[index] == -1) {
+		heapPush(index);
 		--closedNodes;
+	} else {
+		// its cost went down
+		heapSiftUp(heapPos[index]);
 	}
 }
 
@@ -891,11 +1128,80 @@ int_fast32_t AStarNodes::getClosedNodes() const
 
 AStarNode* AStarNodes::getNodeByPosition(uint32_t x, uint32_t y)
 {
-	auto it = nodeTable.find((x << 16) | y);
-	if (it == nodeTable.end()) {
-		return nullptr;
+	const uint32_t key = (x << 16) | y;
+	for (uint32_t slot = getNodeTableSlot(key); nodeTableValues[slot] != -1; slot = (slot + 1) & (NODE_TABLE_SIZE - 1)) {
+		if (nodeTableKeys[slot] == key) {
+			return nodes + nodeTableValues[slot];
+		}
 	}
-	return it->second;
+	return nullptr;
+}
+
+void AStarNodes::heapPush(int16_t index)
+{
+	heap[heapSize] = index;
+	heapPos[index] = heapSize;
+	heapSiftUp(heapSize++);
+}
+
+void AStarNodes::heapRemove(int16_t index)
+{
+	int16_t heapIndex = heapPos[index];
+	heapPos[index] = -1;
+
+	int16_t last = heap[--heapSize];
+	if (heapIndex == heapSize) {
+		return;
+	}
+
+	heap[heapIndex] = last;
+	heapPos[last] = heapIndex;
+	heapSiftDown(heapIndex);
+	heapSiftUp(heapPos[last]);
+}
+
+void AStarNodes::heapSiftUp(int16_t heapIndex)
+{
+	int16_t index = heap[heapIndex];
+	while (heapIndex > 0) {
+		int16_t parent = (heapIndex - 1) / 2;
+		if (!isHeapBefore(index, heap[parent])) {
+			break;
+		}
+
+		heap[heapIndex] = heap[parent];
+		heapPos[heap[heapIndex]] = heapIndex;
+		heapIndex = parent;
+	}
+
+	heap[heapIndex] = index;
+	heapPos[index] = heapIndex;
+}
+
+void AStarNodes::heapSiftDown(int16_t heapIndex)
+{
+	int16_t index = heap[heapIndex];
+	while (true) {
+		int16_t child = heapIndex * 2 + 1;
+		if (child >= heapSize) {
+			break;
+		}
+
+		if (child + 1 < heapSize && isHeapBefore(heap[child + 1], heap[child])) {
+			++child;
+		}
+
+		if (!isHeapBefore(heap[child], index)) {
+			break;
+		}
+
+		heap[heapIndex] = heap[child];
+		heapPos[heap[heapIndex]] = heapIndex;
+		heapIndex = child;
+	}
+
+	heap[heapIndex] = index;
+	heapPos[index] = heapIndex;
 }
 
 int_fast32_t AStarNodes::getMapWalkCost(AStarNode* node, const Position& neighborPos)
@@ -936,8 +1242,92 @@ int_fast32_t AStarNodes::getTileWalkCost(Creature& creature, const Tile* tile)
 }
 
 // Floor
+void Floor::updateTileMasks(uint16_t x, uint16_t y)
+{
+	const uint8_t sight = getHotFlags(x, y) & TILEHOT_SIGHT;
+	computeTileMasks(x, y);
+	if ((getHotFlags(x, y) & TILEHOT_SIGHT) != sight) {
+		sightVersion.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void Floor::computeTileMasks(uint16_t x, uint16_t y)
+{
+	const uint64_t bit = getTileBit(x, y);
+	pathableMask &= ~bit;
+	freeMask &= ~bit;
+	placeMask &= ~bit;
+
+	uint8_t& hot = hotFlags[x & FLOOR_MASK][y & FLOOR_MASK];
+	hot = 0;
+
+	const Tile* tile = tiles[x & FLOOR_MASK][y & FLOOR_MASK];
+	if (!tile) {
+		return;
+	}
+
+	if (tile->hasFlag(TILESTATE_BLOCKSOLID)) {
+		hot |= TILEHOT_BLOCKSOLID;
+	}
+	if (tile->hasFlag(TILESTATE_BLOCKPATH)) {
+		hot |= TILEHOT_BLOCKPATH;
+	}
+	if (tile->hasFlag(TILESTATE_PROTECTIONZONE)) {
+		hot |= TILEHOT_PROTECTIONZONE;
+	}
+	if (tile->hasProperty(CONST_PROP_BLOCKPROJECTILE)) {
+		hot |= TILEHOT_BLOCKPROJECTILE;
+	}
+	if (tile->getHouse()) {
+		hot |= TILEHOT_HOUSE;
+	}
+	if (tile->getCreatureCount() != 0) {
+		hot |= TILEHOT_CREATURES;
+	}
+
+	if (!tile->getGround()) {
+		return;
+	}
+	hot |= TILEHOT_GROUND;
+
+	// Tile::queryAdd refuses these to every creature when pathfinding
+	if (!tile->hasFlag(TILESTATE_FLOORCHANGE | TILESTATE_TELEPORT | TILESTATE_SPECIALFIELDBLOCKPATH)) {
+		pathableMask |= bit;
+	}
+
+	if (!tile->hasFlag(TILESTATE_BLOCKSOLID | TILESTATE_BLOCKPATH)) {
+		freeMask |= bit;
+		if (!(hot & (TILEHOT_PROTECTIONZONE | TILEHOT_HOUSE))) {
+			placeMask |= bit;
+		}
+	}
+}
+
+void Floor::updateTileCreatures(uint16_t x, uint16_t y)
+{
+	uint8_t& hot = hotFlags[x & FLOOR_MASK][y & FLOOR_MASK];
+	const Tile* tile = tiles[x & FLOOR_MASK][y & FLOOR_MASK];
+	if (tile && tile->getCreatureCount() != 0) {
+		hot |= TILEHOT_CREATURES;
+	} else {
+		hot &= ~TILEHOT_CREATURES;
+	}
+}
+
+void* Floor::operator new(size_t size)
+{
+	return FloorPool::allocate(size);
+}
+
+void Floor::operator delete(void* p, size_t size)
+{
+	FloorPool::deallocate(p, size);
+}
+
 Floor::~Floor()
 {
+	InstanceCounter<Floor>::onDestroy();
+	sightVersion.fetch_add(1, std::memory_order_relaxed);
 	for (auto& row : tiles) {
 		for (auto tile : row) {
 			delete tile;
@@ -1001,27 +1391,72 @@ Floor* QTreeLeafNode::createFloor(uint32_t z)
 	return array[z];
 }
 
-void QTreeLeafNode::addCreature(Creature* c)
+static LeafCreatureVector::iterator findLeafCreature(LeafCreatureVector& list, const Creature* c)
+{
+	return std::find_if(list.begin(), list.end(), [c](const LeafCreature& entry) { return entry.creature == c; });
+}
+
+void QTreeLeafNode::addCreature(Creature* c, const Position& pos)
 {
-	creature_list.push_back(c);
+	creature_list.push_back({pos, c});
 
 	if (c->getPlayer()) {
-		player_list.push_back(c);
+		player_list.push_back({pos, c});
+	} else if (c->canHear()) {
+		hearer_list.push_back({pos, c});
 	}
 }
 
 void QTreeLeafNode::removeCreature(Creature* c)
 {
-	auto iter = std::find(creature_list.begin(), creature_list.end(), c);
+	auto iter = findLeafCreature(creature_list, c);
 	assert(iter != creature_list.end());
 	*iter = creature_list.back();
 	creature_list.pop_back();
 
 	if (c->getPlayer()) {
-		iter = std::find(player_list.begin(), player_list.end(), c);
+		iter = findLeafCreature(player_list, c);
 		assert(iter != player_list.end());
 		*iter = player_list.back();
 		player_list.pop_back();
+	} else {
+		// canHear of a monster follows its type, which may have been reloaded in the meantime
+		iter = findLeafCreature(hearer_list, c);
+		if (iter != hearer_list.end()) {
+			*iter = hearer_list.back();
+			hearer_list.pop_back();
+		}
+	}
+}
+
+void QTreeLeafNode::moveCreature(Creature* c, const Position& pos)
+{
+	auto iter = findLeafCreature(creature_list, c);
+	assert(iter != creature_list.end());
+	iter->pos = pos;
+
+	if (c->getPlayer()) {
+		iter = findLeafCreature(player_list, c);
+		assert(iter != player_list.end());
+		iter->pos = pos;
+	} else {
+		iter = findLeafCreature(hearer_list, c);
+		if (iter != hearer_list.end()) {
+			iter->pos = pos;
+		}
+	}
+}
+
+void QTreeLeafNode::updateHearer(Creature* c, const Position& pos)
+{
+	auto iter = findLeafCreature(hearer_list, c);
+	if (c->canHear()) {
+		if (iter == hearer_list.end()) {
+			hearer_list.push_back({pos, c});
+		}
+	} else if (iter != hearer_list.end()) {
+		*iter = hearer_list.back();
+		hearer_list.pop_back();
 	}
 }
 
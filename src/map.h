@@ -49,9 +49,33 @@ class AStarNodes
 		static int_fast32_t getTileWalkCost(Creature& creature, const Tile* tile);
 
 	private:
+		// open addressed position -> node table, kept at most half full
+		static constexpr uint32_t NODE_TABLE_BITS = 10;
+		static constexpr uint32_t NODE_TABLE_SIZE = 1 << NODE_TABLE_BITS;
+		static_assert(NODE_TABLE_SIZE >= 2 * MAX_NODES, "node table must stay sparse");
+
+		static uint32_t getNodeTableSlot(uint32_t key) {
+			return (key * 2654435761u) >> (32 - NODE_TABLE_BITS);
+		}
+
+		// binary min-heap of open node indexes ordered by (f, index),
+		// which picks the same node the former linear scan did
+		bool isHeapBefore(int16_t lhs, int16_t rhs) const {
+			return nodes[lhs].f < nodes[rhs].f || (nodes[lhs].f == nodes[rhs].f && lhs < rhs);
+		}
+		void heapPush(int16_t index);
+		void heapRemove(int16_t index);
+		void heapSiftUp(int16_t heapIndex);
+		void heapSiftDown(int16_t heapIndex);
+
 		AStarNode nodes[MAX_NODES];
-		bool openNodes[MAX_NODES];
-		std::unordered_map<uint32_t, AStarNode*> nodeTable;
+		int16_t heapPos[MAX_NODES];
+		int16_t heap[MAX_NODES];
+		int16_t heapSize = 0;
+
+		uint32_t nodeTableKeys[NODE_TABLE_SIZE];
+		int16_t nodeTableValues[NODE_TABLE_SIZE];
+
 		size_t curNode;
 		int_fast32_t closedNodes;
 };
@@ -60,15 +84,60 @@ static constexpr int32_t FLOOR_BITS = 3;
 static constexpr int32_t FLOOR_SIZE = (1 << FLOOR_BITS);
 static constexpr int32_t FLOOR_MASK = (FLOOR_SIZE - 1);
 
+// the tile properties walk and line of sight queries look at, one byte per tile in its Floor
+enum TileHotFlags_t : uint8_t {
+	TILEHOT_GROUND = 1 << 0,
+	TILEHOT_BLOCKSOLID = 1 << 1,
+	TILEHOT_BLOCKPATH = 1 << 2,
+	TILEHOT_BLOCKPROJECTILE = 1 << 3,
+	TILEHOT_PROTECTIONZONE = 1 << 4,
+	TILEHOT_HOUSE = 1 << 5,
+	TILEHOT_CREATURES = 1 << 6,
+
+	// the flags canThrowObjectTo looks at
+	TILEHOT_SIGHT = TILEHOT_GROUND | TILEHOT_BLOCKPROJECTILE,
+};
+
 struct Floor {
-	constexpr Floor() = default;
+	Floor() {
+		InstanceCounter<Floor>::onCreate();
+	}
 	~Floor();
 
 	// non-copyable
 	Floor(const Floor&) = delete;
 	Floor& operator=(const Floor&) = delete;
 
+	// floors are recycled through a free list, see map.cpp
+	static void* operator new(size_t size);
+	static void operator delete(void* p, size_t size);
+
+	static uint64_t getTileBit(uint16_t x, uint16_t y) {
+		return static_cast<uint64_t>(1) << (((x & FLOOR_MASK) << FLOOR_BITS) | (y & FLOOR_MASK));
+	}
+
+	// recomputes the bits of one tile from its current flags
+	void updateTileMasks(uint16_t x, uint16_t y);
+	// creatures move far more often than items change, only their bit is updated then
+	void updateTileCreatures(uint16_t x, uint16_t y);
+
+	uint8_t getHotFlags(uint16_t x, uint16_t y) const {
+		return hotFlags[x & FLOOR_MASK][y & FLOOR_MASK];
+	}
+
 	Tile* tiles[FLOOR_SIZE][FLOOR_SIZE] = {};
+	uint8_t hotFlags[FLOOR_SIZE][FLOOR_SIZE] = {};
+
+	// one bit per tile, kept up to date whenever the items of a tile change
+	uint64_t pathableMask = 0; // has ground and no static flag that keeps every creature's pathfinding out
+	uint64_t freeMask = 0; // has ground and nothing blocking
+	uint64_t placeMask = 0; // free and neither protection zone nor house, where summons may appear
+
+	// bumped whenever a tile of any floor changes its TILEHOT_SIGHT flags
+	static inline std::atomic<uint32_t> sightVersion{0};
+
+	private:
+		void computeTileMasks(uint16_t x, uint16_t y);
 };
 
 class FrozenPathingConditionCall;
@@ -116,6 +185,13 @@ class QTreeNode
 		friend class Map;
 };
 
+// a creature of a leaf with a copy of its position, so that range checks do not touch the creature
+struct LeafCreature {
+	Position pos;
+	Creature* creature;
+};
+using LeafCreatureVector = std::vector<LeafCreature>;
+
 class QTreeLeafNode final : public QTreeNode
 {
 	public:
@@ -131,16 +207,22 @@ class QTreeLeafNode final : public QTreeNode
 			return array[z];
 		}
 
-		void addCreature(Creature* c);
+		void addCreature(Creature* c, const Position& pos);
 		void removeCreature(Creature* c);
+		// updates the position of a creature that moved within the leaf
+		void moveCreature(Creature* c, const Position& pos);
+		// adds or removes a creature other than a player from hearer_list after canHear changed
+		void updateHearer(Creature* c, const Position& pos);
 
 	private:
 		static bool newLeaf;
 		QTreeLeafNode* leafS = nullptr;
 		QTreeLeafNode* leafE = nullptr;
 		Floor* array[MAP_MAX_LAYERS] = {};
-		CreatureVector creature_list;
-		CreatureVector player_list;
+		LeafCreatureVector creature_list;
+		LeafCreatureVector player_list;
+		// creatures other than players that react to what is said, see Creature::canHear
+		LeafCreatureVector hearer_list;
 
 		friend class Map;
 		friend class QTreeNode;
@@ -168,6 +250,13 @@ struct SpawnMatrix
 	int32_t* entry = nullptr;
 };
 
+struct SpectatorCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t invalidations = 0;
+	size_t entries = 0;
+};
+
 /**
   * Map class.
   * Holds all the actual map-data
@@ -186,6 +275,9 @@ class Map
 		  * \returns true if the map was loaded successfully
 		  */
 		bool loadMap(const std::string& identifier, bool loadHouses);
+		// the two halves of loadMap, the tiles and houses only need the item types, the spawns need the monsters and npcs
+		bool loadTilesAndHouses(const std::string& identifier, bool loadHouses);
+		void loadSpawns();
 		bool loadMapPart(const std::string& identifier, bool loadSpawns, bool replaceTiles);
 
 		uint32_t refreshMap();
@@ -201,6 +293,25 @@ class Map
 			return getTile(pos.x, pos.y, pos.z);
 		}
 
+		/**
+		  * Static walkability of a tile, read from the floor masks
+		  * without looking at the items of the tile.
+		  */
+		bool isTilePathable(uint16_t x, uint16_t y, uint8_t z) const {
+			const Floor* floor = getFloor(x, y, z);
+			return floor && (floor->pathableMask & Floor::getTileBit(x, y));
+		}
+		bool isTileFree(uint16_t x, uint16_t y, uint8_t z) const {
+			const Floor* floor = getFloor(x, y, z);
+			return floor && (floor->freeMask & Floor::getTileBit(x, y));
+		}
+
+		/**
+		  * Appends the positions of the box that are in the placeMask of their floor
+		  * and hold no creature, floors without any such tile are skipped whole.
+		  */
+		void getPlaceableFields(std::vector<Position>& positions, const Position& fromPos, const Position& toPos) const;
+
 		/**
 		  * Set a single tile.
 		  */
@@ -232,6 +343,11 @@ class Map
 		                   int32_t minRangeX = 0, int32_t maxRangeX = 0,
 		                   int32_t minRangeY = 0, int32_t maxRangeY = 0);
 
+		// players and the creatures that react to what is said around centerPos, not cached
+		void getHearers(SpectatorVec& hearers, const Position& centerPos, bool multifloor, int32_t rangeX, int32_t rangeY) const;
+		// the monster types may gain or lose onCreatureSay on a reload, called after one
+		void updateHearers();
+
 		/**
 		  * Checks if you can throw an object to that position
 		  *	\param fromPos from Source point
@@ -248,17 +364,91 @@ class Map
 		bool getPathMatching(Creature& creature, std::vector<Direction>& dirList,
 		                     const FrozenPathingConditionCall& pathCondition, const FindPathParams& fpp) const;
 
+		// bumped whenever a tile is added, a position that had no tile may have one now
+		uint32_t getTilesVersion() const {
+			return tilesVersion;
+		}
+
+		// drops every cached spectator query that could see a creature standing at pos
+		void invalidateSpectatorCache(const Position& pos, const Creature* creature);
+		SpectatorCacheStats getSpectatorCacheStats() const;
+
 		std::map<std::string, Position> waypoints;
 
 		QTreeLeafNode* getQTNode(uint16_t x, uint16_t y) {
+#ifdef TVP_FLAT_MAP_GRID
+			return getSectorLeaf(x, y);
+#else
 			return QTreeNode::getLeafStatic<QTreeLeafNode*, QTreeNode*>(&root, x, y);
+#endif
 		}
 
 		Spawns spawns;
 		Towns towns;
 		Houses houses;
+		RefreshSnapshots refreshSnapshots;
 
 	private:
+		// once the cache holds this many queries it is dropped as a whole, so invalidation stays cheap
+		static constexpr size_t SPECTATOR_CACHE_MAX_ENTRIES = 256;
+
+		struct SpectatorCacheKey {
+			Position centerPos;
+			int32_t minRangeX;
+			int32_t maxRangeX;
+			int32_t minRangeY;
+			int32_t maxRangeY;
+			int32_t minRangeZ;
+			int32_t maxRangeZ;
+			bool onlyPlayers;
+
+			bool operator==(const SpectatorCacheKey& other) const {
+				return centerPos == other.centerPos && minRangeX == other.minRangeX && maxRangeX == other.maxRangeX &&
+				       minRangeY == other.minRangeY && maxRangeY == other.maxRangeY &&
+				       minRangeZ == other.minRangeZ && maxRangeZ == other.maxRangeZ && onlyPlayers == other.onlyPlayers;
+			}
+
+			// same test getSpectatorsInternal applies to every creature it visits
+			bool covers(const Position& pos) const {
+				if (minRangeZ > pos.z || maxRangeZ < pos.z) {
+					return false;
+				}
+
+				int32_t offsetZ = Position::getOffsetZ(centerPos, pos);
+				return (centerPos.x + minRangeX + offsetZ) <= pos.x && (centerPos.x + maxRangeX + offsetZ) >= pos.x &&
+				       (centerPos.y + minRangeY + offsetZ) <= pos.y && (centerPos.y + maxRangeY + offsetZ) >= pos.y;
+			}
+		};
+
+		struct SpectatorCacheKeyHash {
+			size_t operator()(const SpectatorCacheKey& key) const {
+				size_t hash = (static_cast<size_t>(key.centerPos.x) << 24) ^ (static_cast<size_t>(key.centerPos.y) << 8) ^ key.centerPos.z;
+				hash = hash * 31 + static_cast<uint8_t>(key.minRangeX);
+				hash = hash * 31 + static_cast<uint8_t>(key.maxRangeX);
+				hash = hash * 31 + static_cast<uint8_t>(key.minRangeY);
+				hash = hash * 31 + static_cast<uint8_t>(key.maxRangeY);
+				hash = hash * 31 + static_cast<uint8_t>(key.minRangeZ);
+				hash = hash * 31 + static_cast<uint8_t>(key.maxRangeZ);
+				return hash * 2 + key.onlyPlayers;
+			}
+		};
+
+		std::unordered_map<SpectatorCacheKey, SpectatorVec, SpectatorCacheKeyHash> spectatorCache;
+		SpectatorCacheStats spectatorCacheStats;
+
+		// direct mapped memo of canThrowObjectTo, an entry holds until any tile changes its sight flags
+		struct SightMemoEntry {
+			uint64_t positions = 0;
+			uint32_t version = 0;
+			uint16_t floors = 0; // 0 while the entry is unused
+			bool result = false;
+		};
+		static constexpr int32_t SIGHT_MEMO_BITS = 12;
+		static constexpr size_t SIGHT_MEMO_SIZE = 1 << SIGHT_MEMO_BITS;
+		mutable std::array<SightMemoEntry, SIGHT_MEMO_SIZE> sightMemo{};
+
+		bool computeCanThrowObjectTo(const Position& fromPos, const Position& toPos, bool multiFloor) const;
+
 		QTreeNode root;
 
 		std::string spawnfile;
@@ -266,12 +456,35 @@ class Map
 
 		uint32_t width = 0;
 		uint32_t height = 0;
+		uint32_t tilesVersion = 0;
+
+		Floor* getFloor(uint16_t x, uint16_t y, uint8_t z) const;
+
+#ifdef TVP_FLAT_MAP_GRID
+		// the leaves of the tree indexed by sector, over the box of sectors the map uses
+		QTreeLeafNode* getSectorLeaf(uint16_t x, uint16_t y) const {
+			const uint32_t sectorX = (static_cast<uint32_t>(x) >> FLOOR_BITS) - sectorGridX;
+			const uint32_t sectorY = (static_cast<uint32_t>(y) >> FLOOR_BITS) - sectorGridY;
+			if (sectorX >= sectorGridWidth || sectorY >= sectorGridHeight) {
+				return nullptr;
+			}
+			return sectorGrid[sectorY * sectorGridWidth + sectorX];
+		}
+		void indexSectorLeaf(uint16_t x, uint16_t y, QTreeLeafNode* leaf);
+
+		std::vector<QTreeLeafNode*> sectorGrid;
+		uint32_t sectorGridX = 0;
+		uint32_t sectorGridY = 0;
+		uint32_t sectorGridWidth = 0;
+		uint32_t sectorGridHeight = 0;
+#endif
 
 		// Actually scans the map for spectators
 		void getSpectatorsInternal(SpectatorVec& spectators, const Position& centerPos,
 		                           int32_t minRangeX, int32_t maxRangeX,
 		                           int32_t minRangeY, int32_t maxRangeY,
-		                           int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers) const;
+		                           int32_t minRangeZ, int32_t maxRangeZ, bool onlyPlayers, bool onlyHearers = false) const;
+		static void getSpectatorFloors(const Position& centerPos, bool multifloor, int32_t& minRangeZ, int32_t& maxRangeZ);
 
 		friend class Game;
 		friend class IOMap;
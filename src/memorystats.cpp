@@ -0,0 +1,113 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "memorystats.h"
+#include "filetasks.h"
+#include "game.h"
+#include "lockfree.h"
+#include "luascript.h"
+#include "monster.h"
+#include "npc.h"
+#include "outputmessage.h"
+#include "tools.h"
+
+#include <fmt/format.h>
+
+extern Game g_game;
+extern LuaEnvironment g_luaEnvironment;
+
+namespace {
+
+// lines of the report
+constexpr size_t REPORT_ITEM_TYPES = 30;
+constexpr size_t REPORT_PLAYERS = 10;
+
+}
+
+MemoryStats getMemoryStats(bool countDepotItems/* = true*/)
+{
+	MemoryStats stats;
+	stats.items = ItemTypeCounter::getTotal();
+
+	stats.itemAttributes = LockfreePoolCounters<ItemAttributes>::get().getStats().inUse;
+	stats.itemAttributesBytes = stats.itemAttributes * sizeof(ItemAttributes);
+
+	stats.players = InstanceCounter<Player>::get();
+	stats.monsters = InstanceCounter<Monster>::get();
+	stats.npcs = InstanceCounter<Npc>::get();
+
+	stats.tiles = InstanceCounter<Tile>::get();
+	stats.floors = InstanceCounter<Floor>::get();
+	stats.refreshItems = g_game.map.refreshSnapshots.size();
+	stats.refreshBytes = g_game.map.refreshSnapshots.getMemoryUsage();
+
+	for (size_t capacity : {OutputMessagePool::SMALL_CAPACITY, OutputMessagePool::MEDIUM_CAPACITY, OutputMessagePool::FULL_CAPACITY}) {
+		stats.outputMessages += OutputMessagePool::getPoolStats(capacity).inUse;
+	}
+
+	const StatementLog& statementLog = g_game.getStatementLog();
+	stats.statements = statementLog.getStatementCount();
+	stats.listeners = statementLog.getListenerCount();
+
+	// every script interface shares the state of the environment
+	if (lua_State* L = g_luaEnvironment.getLuaState()) {
+		stats.luaMemory = (static_cast<uint64_t>(lua_gc(L, LUA_GCCOUNT, 0)) << 10) + lua_gc(L, LUA_GCCOUNTB, 0);
+	}
+
+	if (countDepotItems) {
+		for (const auto& it : g_game.getPlayers()) {
+			stats.depotItems += it.second->getDepotItemCount();
+		}
+	}
+	return stats;
+}
+
+void dumpMemoryReport(const std::string& fileName)
+{
+	const MemoryStats stats = getMemoryStats();
+
+	std::string report = fmt::format("[{:s}]\n", formatDate(time(nullptr)));
+	report += fmt::format("items {:d}, item attributes {:d} ({:d} bytes)\n", stats.items, stats.itemAttributes, stats.itemAttributesBytes);
+	report += fmt::format("players {:d} ({:d} in game), monsters {:d} ({:d} in game), npcs {:d} ({:d} in game)\n",
+		stats.players, g_game.getPlayersOnline(), stats.monsters, g_game.getMonstersOnline(), stats.npcs, g_game.getNpcsOnline());
+	report += fmt::format("tiles {:d}, floors {:d}, refresh items {:d} ({:d} bytes)\n", stats.tiles, stats.floors, stats.refreshItems, stats.refreshBytes);
+	report += fmt::format("output messages in flight {:d}, statements {:d}, listeners {:d}\n", stats.outputMessages, stats.statements, stats.listeners);
+	report += fmt::format("lua memory {:d} bytes, depot items of the players online {:d}\n", stats.luaMemory, stats.depotItems);
+
+	std::vector<std::pair<uint16_t, uint32_t>> itemTypes;
+	for (size_t id = 0; id <= std::numeric_limits<uint16_t>::max(); ++id) {
+		if (uint32_t count = ItemTypeCounter::get(static_cast<uint16_t>(id)); count != 0) {
+			itemTypes.emplace_back(static_cast<uint16_t>(id), count);
+		}
+	}
+
+	const size_t typeCount = std::min(itemTypes.size(), REPORT_ITEM_TYPES);
+	std::partial_sort(itemTypes.begin(), itemTypes.begin() + typeCount, itemTypes.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second > rhs.second;
+	});
+
+	report += fmt::format("item types, most instances first\n{:>10s} {:>6s}  name\n", "items", "id");
+	for (size_t i = 0; i < typeCount; ++i) {
+		report += fmt::format("{:>10d} {:>6d}  {:s}\n", itemTypes[i].second, itemTypes[i].first, Item::items[itemTypes[i].first].name);
+	}
+
+	std::vector<std::pair<const Player*, uint32_t>> players;
+	for (const auto& it : g_game.getPlayers()) {
+		players.emplace_back(it.second, it.second->getDepotItemCount());
+	}
+
+	const size_t playerCount = std::min(players.size(), REPORT_PLAYERS);
+	std::partial_sort(players.begin(), players.begin() + playerCount, players.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second > rhs.second;
+	});
+
+	report += fmt::format("players, most depot items first\n{:>10s}  player\n", "items");
+	for (size_t i = 0; i < playerCount; ++i) {
+		report += fmt::format("{:>10d}  {:s}\n", players[i].second, players[i].first->getName());
+	}
+	report += '\n';
+
+	g_fileTasks.writeFile(fileName, std::move(report), true);
+}
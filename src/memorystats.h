@@ -0,0 +1,84 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+// live instances of a class, kept by its constructors and destructor; the map loader creates them on its own threads too
+template <typename T>
+class InstanceCounter
+{
+	public:
+		static void onCreate() {
+			count.fetch_add(1, std::memory_order_relaxed);
+		}
+		static void onDestroy() {
+			count.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		static uint64_t get() {
+			return count.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static inline std::atomic<uint64_t> count{0};
+};
+
+// live items per item id, kept by the item constructors, destructor and Item::setID
+class ItemTypeCounter
+{
+	public:
+		static void onCreate(uint16_t id) {
+			counts[id].fetch_add(1, std::memory_order_relaxed);
+			total.fetch_add(1, std::memory_order_relaxed);
+		}
+		static void onDestroy(uint16_t id) {
+			counts[id].fetch_sub(1, std::memory_order_relaxed);
+			total.fetch_sub(1, std::memory_order_relaxed);
+		}
+		static void onTransform(uint16_t oldId, uint16_t newId) {
+			counts[oldId].fetch_sub(1, std::memory_order_relaxed);
+			counts[newId].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		static uint32_t get(uint16_t id) {
+			return counts[id].load(std::memory_order_relaxed);
+		}
+		// every id together, without going through them
+		static uint64_t getTotal() {
+			return total.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static inline std::array<std::atomic<uint32_t>, std::numeric_limits<uint16_t>::max() + 1> counts{};
+		static inline std::atomic<uint64_t> total{0};
+};
+
+// what the game holds on to, to tell which part of it grows
+struct MemoryStats {
+	uint64_t items = 0;
+	uint64_t itemAttributes = 0;
+	// the attribute blocks, strings and custom attributes they point to are not included
+	uint64_t itemAttributesBytes = 0;
+
+	// allocated, the ones in game are counted by the game
+	uint64_t players = 0;
+	uint64_t monsters = 0;
+	uint64_t npcs = 0;
+
+	uint64_t tiles = 0;
+	uint64_t floors = 0;
+	uint64_t refreshItems = 0;
+	uint64_t refreshBytes = 0;
+
+	uint64_t outputMessages = 0;
+	uint64_t statements = 0;
+	uint64_t listeners = 0;
+	uint64_t luaMemory = 0;
+	// in the loaded depots of the players online
+	uint64_t depotItems = 0;
+};
+
+// dispatcher thread, counting the depot items walks every loaded depot
+MemoryStats getMemoryStats(bool countDepotItems = true);
+// appends the stats, the item types with the most instances and the players with the most depot items
+void dumpMemoryReport(const std::string& fileName);
@@ -0,0 +1,262 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "metrics.h"
+#include "configmanager.h"
+#include "connection.h"
+#include "databasetasks.h"
+#include "game.h"
+#include "loadshedder.h"
+#include "lockfree.h"
+#include "luascript.h"
+#include "memorystats.h"
+#include "outputmessage.h"
+#include "scheduler.h"
+
+#include <fmt/format.h>
+
+extern ConfigManager g_config;
+extern Game g_game;
+extern LuaEnvironment g_luaEnvironment;
+
+Metrics g_metrics;
+
+namespace {
+
+constexpr uint32_t METRICS_REFRESH_INTERVAL = 1000;
+// counting them walks every depot of every player online
+constexpr auto DEPOT_ITEMS_REFRESH_INTERVAL = std::chrono::seconds(60);
+// a scraper that does not send its request in this time is dropped
+constexpr auto REQUEST_TIMEOUT = std::chrono::seconds(10);
+constexpr size_t MAX_REQUEST_SIZE = 4096;
+
+void addHeader(std::string& page, std::string_view name, std::string_view type, std::string_view help)
+{
+	page += fmt::format("# HELP {0:s} {1:s}\n# TYPE {0:s} {2:s}\n", name, help, type);
+}
+
+template <typename T>
+void addSample(std::string& page, std::string_view name, T value, std::string_view labels = {})
+{
+	if (labels.empty()) {
+		page += fmt::format("{:s} {}\n", name, value);
+	} else {
+		page += fmt::format("{:s}{{{:s}}} {}\n", name, labels, value);
+	}
+}
+
+template <typename T>
+void addMetric(std::string& page, std::string_view name, std::string_view type, std::string_view help, T value)
+{
+	addHeader(page, name, type, help);
+	addSample(page, name, value);
+}
+
+double toSeconds(std::chrono::nanoseconds duration)
+{
+	return std::chrono::duration<double>(duration).count();
+}
+
+}
+
+void Metrics::start()
+{
+	const int32_t port = g_config.getNumber(ConfigManager::METRICS_PORT);
+	if (port == 0) {
+		return;
+	}
+
+	try {
+		const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::make_address(g_config.getString(ConfigManager::METRICS_IP)), port);
+		acceptor.open(endpoint.protocol());
+		acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+		acceptor.bind(endpoint);
+		acceptor.listen();
+	} catch (const boost::system::system_error& e) {
+		std::cout << "[Error - Metrics::start] Unable to listen on port " << port << ": " << e.what() << std::endl;
+		return;
+	}
+
+	lastRefresh = std::chrono::steady_clock::now();
+	lastWrittenBytes = ConnectionManager::getInstance().getSendQueueStats().writtenBytes;
+	refresh();
+
+	accept();
+	ThreadHolder::start();
+	std::cout << ">> Metrics served on port " << port << std::endl;
+}
+
+void Metrics::shutdown()
+{
+	g_scheduler.stopEvent(refreshEvent);
+	refreshEvent = 0;
+
+	boost::asio::post(io_context, [this]() {
+		boost::system::error_code error;
+		acceptor.close(error);
+		io_context.stop();
+	});
+}
+
+void Metrics::refresh()
+{
+	//dispatcher thread
+	const auto now = std::chrono::steady_clock::now();
+	const double elapsed = std::chrono::duration<double>(now - lastRefresh).count();
+	lastRefresh = now;
+
+	std::string text;
+	text.reserve(page.capacity());
+
+	const DispatcherBatchStats& batchStats = g_dispatcher.getBatchStats();
+	addMetric(text, "tvp_dispatcher_tasks_total", "counter", "Tasks run by the dispatcher.", g_dispatcher.getDispatcherCycle());
+	addMetric(text, "tvp_dispatcher_batches_total", "counter", "Batches of tasks the dispatcher took from its queue.", batchStats.batches);
+	addMetric(text, "tvp_dispatcher_batch_seconds_total", "counter", "Time spent running the batches, sending the packets they wrote included.", toSeconds(batchStats.time));
+	addMetric(text, "tvp_dispatcher_queue_depth_max", "gauge", "Largest batch taken from the queue since the last refresh.", batchStats.peakSize);
+	addMetric(text, "tvp_dispatcher_batch_max_seconds", "gauge", "Longest batch since the last refresh.", toSeconds(batchStats.peakTime));
+	addMetric(text, "tvp_dispatcher_batches_over_budget_total", "counter", "Batches that ran longer than dispatcherBatchBudget.", batchStats.batchesOverBudget);
+	addMetric(text, "tvp_dispatcher_idle_slices_total", "counter", "Slices of low priority jobs run while the queue was empty.", batchStats.idleSlices);
+	addMetric(text, "tvp_load_shedding_level", "gauge", "Low priority work deferred because the game runs over its budget, 0 to 3.", static_cast<uint32_t>(g_loadShedder.getLevel()));
+	g_dispatcher.resetBatchPeaks();
+
+	addMetric(text, "tvp_scheduler_pending_events", "gauge", "Events waiting in the scheduler.", g_scheduler.getPendingEvents());
+
+	const DatabaseTasksStats databaseStats = g_databaseTasks.getStats();
+	addMetric(text, "tvp_database_queue_depth", "gauge", "Queries waiting for the database thread.", databaseStats.queueDepth);
+	addMetric(text, "tvp_database_tasks_total", "counter", "Queries run by the database thread.", databaseStats.tasks);
+
+	addMetric(text, "tvp_players_online", "gauge", "Players in the game.", g_game.getPlayersOnline());
+	addMetric(text, "tvp_monsters_online", "gauge", "Monsters in the game.", g_game.getMonstersOnline());
+	addMetric(text, "tvp_npcs_online", "gauge", "Npcs in the game.", g_game.getNpcsOnline());
+	addMetric(text, "tvp_decaying_items", "gauge", "Items waiting in the decay wheel.", g_game.getDecayingItems());
+
+	const SendQueueStats sendStats = ConnectionManager::getInstance().getSendQueueStats();
+	addMetric(text, "tvp_network_sent_bytes_total", "counter", "Bytes written to the client sockets.", sendStats.writtenBytes);
+	addMetric(text, "tvp_network_sent_bytes_per_second", "gauge", "Bytes written to the client sockets per second since the last refresh.",
+		elapsed > 0 ? (sendStats.writtenBytes - lastWrittenBytes) / elapsed : 0.);
+	addMetric(text, "tvp_network_sent_messages_total", "counter", "Messages written to the client sockets.", sendStats.writtenMessages);
+	addMetric(text, "tvp_network_dropped_packets_total", "counter", "Packets left out for congested clients.", sendStats.droppedPackets);
+	lastWrittenBytes = sendStats.writtenBytes;
+
+	const std::array<std::pair<const char*, LockfreePoolStats>, 3> pools = {{
+		{"size=\"small\"", OutputMessagePool::getPoolStats(OutputMessagePool::SMALL_CAPACITY)},
+		{"size=\"medium\"", OutputMessagePool::getPoolStats(OutputMessagePool::MEDIUM_CAPACITY)},
+		{"size=\"full\"", OutputMessagePool::getPoolStats(OutputMessagePool::FULL_CAPACITY)},
+	}};
+	addHeader(text, "tvp_output_messages_in_use", "gauge", "Output messages handed out by the pool.");
+	for (const auto& pool : pools) {
+		addSample(text, "tvp_output_messages_in_use", pool.second.inUse, pool.first);
+	}
+	addHeader(text, "tvp_output_messages_high_water_mark", "gauge", "Most output messages in use at once.");
+	for (const auto& pool : pools) {
+		addSample(text, "tvp_output_messages_high_water_mark", pool.second.highWaterMark, pool.first);
+	}
+	addHeader(text, "tvp_output_message_pool_hits_total", "counter", "Output messages taken from the pool.");
+	for (const auto& pool : pools) {
+		addSample(text, "tvp_output_message_pool_hits_total", pool.second.hits, pool.first);
+	}
+	addHeader(text, "tvp_output_message_pool_misses_total", "counter", "Output messages allocated because the pool was empty.");
+	for (const auto& pool : pools) {
+		addSample(text, "tvp_output_message_pool_misses_total", pool.second.misses, pool.first);
+	}
+
+	const bool countDepotItems = now - lastDepotItemsCount >= DEPOT_ITEMS_REFRESH_INTERVAL;
+	MemoryStats memoryStats = getMemoryStats(countDepotItems);
+	if (countDepotItems) {
+		lastDepotItemsCount = now;
+		depotItems = memoryStats.depotItems;
+	}
+	memoryStats.depotItems = depotItems;
+	addMetric(text, "tvp_lua_memory_bytes", "gauge", "Memory in use by the Lua state.", memoryStats.luaMemory);
+
+	const LuaGcStats& gcStats = g_luaEnvironment.getGcStats();
+	addMetric(text, "tvp_lua_gc_idle_steps_total", "counter", "Lua garbage collection steps run while the dispatcher was idle.", gcStats.steps);
+	addMetric(text, "tvp_lua_gc_idle_cycles_total", "counter", "Lua garbage collection cycles finished while the dispatcher was idle.", gcStats.cycles);
+	addMetric(text, "tvp_lua_gc_idle_seconds_total", "counter", "Time spent collecting Lua garbage while the dispatcher was idle.", toSeconds(gcStats.time));
+	addMetric(text, "tvp_items", "gauge", "Items alive, wherever they are.", memoryStats.items);
+	addMetric(text, "tvp_item_attributes", "gauge", "Attribute blocks of the items.", memoryStats.itemAttributes);
+	addMetric(text, "tvp_item_attributes_bytes", "gauge", "Memory of the attribute blocks, without the strings they point to.", memoryStats.itemAttributesBytes);
+	addHeader(text, "tvp_creatures", "gauge", "Creatures alive, in game or not.");
+	addSample(text, "tvp_creatures", memoryStats.players, "kind=\"player\"");
+	addSample(text, "tvp_creatures", memoryStats.monsters, "kind=\"monster\"");
+	addSample(text, "tvp_creatures", memoryStats.npcs, "kind=\"npc\"");
+	addMetric(text, "tvp_map_tiles", "gauge", "Tiles allocated.", memoryStats.tiles);
+	addMetric(text, "tvp_map_floors", "gauge", "Floors (8x8 tile blocks) allocated.", memoryStats.floors);
+	addMetric(text, "tvp_refresh_items", "gauge", "Items the refresh tiles are restored to.", memoryStats.refreshItems);
+	addMetric(text, "tvp_refresh_bytes", "gauge", "Memory of the items the refresh tiles are restored to.", memoryStats.refreshBytes);
+	addMetric(text, "tvp_statements", "gauge", "Statements kept for rule violation reports.", memoryStats.statements);
+	addMetric(text, "tvp_statement_listeners", "gauge", "Listeners kept for rule violation reports.", memoryStats.listeners);
+	addMetric(text, "tvp_depot_items", "gauge", "Items in the loaded depots of the players online, counted once a minute.", memoryStats.depotItems);
+
+	const GameSaveStats& saveStats = g_game.getSaveStats();
+	addHeader(text, "tvp_save_duration_seconds", "summary", "Time the dispatcher spent on global saves.");
+	addSample(text, "tvp_save_duration_seconds_sum", toSeconds(saveStats.totalTime));
+	addSample(text, "tvp_save_duration_seconds_count", saveStats.saves);
+	addMetric(text, "tvp_last_save_duration_seconds", "gauge", "Time the dispatcher spent on the last global save.", toSeconds(saveStats.lastTime));
+	addMetric(text, "tvp_player_autosaves_total", "counter", "Players saved by the rolling autosave.", saveStats.autosaves);
+
+	{
+		std::lock_guard<std::mutex> lockClass(pageLock);
+		page.swap(text);
+	}
+
+	refreshEvent = g_scheduler.addEvent(createSchedulerTask(METRICS_REFRESH_INTERVAL, [this]() { refresh(); }, "Metrics::refresh"));
+}
+
+void Metrics::accept()
+{
+	auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_context);
+	acceptor.async_accept(*socket, [this, socket](const boost::system::error_code& error) {
+		if (error == boost::asio::error::operation_aborted) {
+			return;
+		}
+
+		if (!error) {
+			serve(socket);
+		}
+		accept();
+	});
+}
+
+void Metrics::serve(Socket_ptr socket)
+{
+	auto timer = std::make_shared<boost::asio::steady_timer>(io_context, REQUEST_TIMEOUT);
+	timer->async_wait([socket](const boost::system::error_code& error) {
+		if (!error) {
+			boost::system::error_code closeError;
+			socket->close(closeError);
+		}
+	});
+
+	auto request = std::make_shared<boost::asio::streambuf>(MAX_REQUEST_SIZE);
+	boost::asio::async_read_until(*socket, *request, "\r\n\r\n", [this, socket, timer, request](const boost::system::error_code& error, size_t) {
+		if (error) {
+			timer->cancel();
+			return;
+		}
+
+		std::istream stream(request.get());
+		std::string method, target;
+		stream >> method >> target;
+
+		auto response = std::make_shared<std::string>();
+		if (method != "GET") {
+			*response = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		} else if (target != "/metrics" && !target.starts_with("/metrics?")) {
+			*response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		} else {
+			std::lock_guard<std::mutex> lockClass(pageLock);
+			*response = fmt::format("HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: {:d}\r\nConnection: close\r\n\r\n", page.size());
+			*response += page;
+		}
+
+		boost::asio::async_write(*socket, boost::asio::buffer(*response), [socket, timer, response](const boost::system::error_code&, size_t) {
+			timer->cancel();
+			boost::system::error_code shutdownError;
+			socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, shutdownError);
+			socket->close(shutdownError);
+		});
+	});
+}
@@ -0,0 +1,50 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include "thread_holder_base.h"
+
+/*
+ * Server internals in the Prometheus text format at http://metricsIP:metricsPort/metrics.
+ * The dispatcher renders the page once a second and the metrics thread only hands out the
+ * last one, so a scrape never waits for the game and a lagging game is still scraped.
+ */
+class Metrics : public ThreadHolder<Metrics>
+{
+	public:
+		// dispatcher thread, once the game runs; nothing happens while metricsPort is 0
+		void start();
+		// dispatcher thread, before the scheduler stops
+		void shutdown();
+
+		void threadMain() {
+			io_context.run();
+		}
+
+	private:
+		using Socket_ptr = std::shared_ptr<boost::asio::ip::tcp::socket>;
+
+		// dispatcher thread
+		void refresh();
+
+		// metrics thread
+		void accept();
+		void serve(Socket_ptr socket);
+
+		std::mutex pageLock;
+		std::string page;
+
+		// rates are taken between two refreshes
+		std::chrono::steady_clock::time_point lastRefresh;
+		uint64_t lastWrittenBytes = 0;
+		uint64_t refreshEvent = 0;
+
+		std::chrono::steady_clock::time_point lastDepotItemsCount;
+		uint64_t depotItems = 0;
+
+		boost::asio::io_context io_context;
+		boost::asio::ip::tcp::acceptor acceptor{io_context};
+};
+
+extern Metrics g_metrics;
@@ -9,13 +9,31 @@
 #include "events.h"
 #include "configmanager.h"
 #include "weapons.h"
+#include "lockfree.h"
+#include "logger.h"
+#include "profiler.h"
 
 extern Game g_game;
 extern Monsters g_monsters;
 extern Events* g_events;
 extern ConfigManager g_config;
 
-uint32_t Monster::monsterAutoID = 0x40000000;
+
+namespace {
+
+using MonsterPool = LockfreeObjectPool<Monster, sizeof(Monster), 2048>;
+
+}
+
+void* Monster::operator new(size_t size)
+{
+	return MonsterPool::allocate(size);
+}
+
+void Monster::operator delete(void* p, size_t size)
+{
+	MonsterPool::deallocate(p, size);
+}
 
 Monster* Monster::createMonster(const std::string& name, const std::vector<LootBlock>* extraLoot /* = nullptr*/)
 {
@@ -26,6 +44,55 @@ Monster* Monster::createMonster(const std::string& name, const std::vector<LootB
 	return new Monster(mType, extraLoot);
 }
 
+void SpellSchedule::schedule(const std::vector<spellBlock_t>& spells)
+{
+	heap.clear();
+	for (uint32_t index = 0; index < spells.size(); ++index) {
+		if (!spells[index].isMelee) {
+			heap.push_back({round + nextPass(spells[index].delay), index});
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), std::greater<>());
+
+	scheduledSpells = &spells;
+	spellCount = spells.size();
+}
+
+uint32_t SpellSchedule::nextPass(uint32_t delay)
+{
+	if (delay <= 1) {
+		return 1;
+	}
+
+	// geometric, from 53 random bits as a double in (0, 1]
+	const double u = static_cast<double>((getRandomGenerator()() >> 11) + 1) * 0x1.0p-53;
+	const double rounds = std::floor(std::log(u) / std::log1p(-1.0 / delay));
+	return rounds < std::numeric_limits<uint32_t>::max() / 2 ? static_cast<uint32_t>(rounds) + 1 : std::numeric_limits<uint32_t>::max() / 2;
+}
+
+namespace {
+
+Item* createLootItem(uint16_t id, uint32_t countmax)
+{
+	const uint16_t count = countmax > 1 ? static_cast<uint16_t>(random(1, static_cast<int32_t>(countmax))) : 1;
+	Item* item = Item::CreateItem(id, count);
+	if (!item) {
+		return nullptr;
+	}
+
+	const ItemType& itemType = Item::items.getItemType(id);
+	if (itemType.charges > 0) {
+		item->setCharges(static_cast<uint16_t>(itemType.charges));
+	}
+
+	if (itemType.isFluidContainer()) {
+		item->setSubType(FLUID_NONE);
+	}
+	return item;
+}
+
+}
+
 void Monster::addMonsterItemInventory(Container* bagItem, Item* item)
 {
 	const ItemType& itemType = Item::items.getItemType(item->getID());
@@ -78,6 +145,8 @@ Monster::Monster(MonsterType* mType, const std::vector<LootBlock>* extraLoot /*
 	nameDescription(mType->nameDescription),
 	mType(mType)
 {
+	InstanceCounter<Monster>::onCreate();
+
 	defaultOutfit = mType->info.outfit;
 	currentOutfit = mType->info.outfit;
 	skull = mType->info.skull;
@@ -109,48 +178,28 @@ Monster::Monster(MonsterType* mType, const std::vector<LootBlock>* extraLoot /*
 	}
 
 	const int32_t configRate = g_config.getNumber(ConfigManager::RATE_LOOT);
-	for (auto lootInfo = mType->info.lootItems.rbegin(); lootInfo != mType->info.lootItems.rend(); ++lootInfo) {
-		const int32_t lootrate = lootInfo->chance * (configRate > 0 ? configRate : 1);
-
-		if (uniform_random(0, MAX_LOOTCHANCE) <= lootrate) {
-			Item* item = Item::CreateItem(lootInfo->id, static_cast<uint16_t>(random(1, static_cast<int32_t>(lootInfo->countmax))));
-			if (!item) {
-				continue;
-			}
+	const int32_t lootRate = configRate > 0 ? configRate : 1;
 
-			const ItemType& itemType = Item::items.getItemType(lootInfo->id);
-			if (itemType.charges > 0) {
-				item->setCharges(static_cast<uint16_t>(itemType.charges));
-			}
-
-			if (itemType.isFluidContainer()) {
-				item->setSubType(FLUID_NONE);
-			}
+	// the rate may have been reloaded or the loot changed by a script since the last roll
+	CompiledLoot& compiledLoot = mType->info.compiledLoot;
+	if (compiledLoot.getRate() != lootRate) {
+		compiledLoot.compile(mType->info.lootItems, lootRate);
+	}
 
+	compiledLoot.roll([&](const CompiledLoot::Entry& entry) {
+		if (Item* item = createLootItem(entry.id, entry.countmax)) {
 			addMonsterItemInventory(bagItem, item);
 		}
-	}
+	});
 
 	if (extraLoot) {
 		for (auto& lootInfo : *extraLoot) {
-			const int32_t lootrate = lootInfo.chance * (configRate > 0 ? configRate : 1);
+			const int32_t lootrate = lootInfo.chance * lootRate;
 
 			if (uniform_random(0, MAX_LOOTCHANCE) <= lootrate) {
-				Item* item = Item::CreateItem(lootInfo.id, static_cast<uint16_t>(random(1, static_cast<int32_t>(lootInfo.countmax))));
-				if (!item) {
-					continue;
-				}
-
-				const ItemType& itemType = Item::items.getItemType(lootInfo.id);
-				if (itemType.charges > 0) {
-					item->setCharges(static_cast<uint16_t>(itemType.charges));
+				if (Item* item = createLootItem(lootInfo.id, lootInfo.countmax)) {
+					addMonsterItemInventory(bagItem, item);
 				}
-
-				if (itemType.isFluidContainer()) {
-					item->setSubType(FLUID_NONE);
-				}
-
-				addMonsterItemInventory(bagItem, item);
 			}
 		}
 	}
@@ -164,6 +213,8 @@ Monster::Monster(MonsterType* mType, const std::vector<LootBlock>* extraLoot /*
 
 Monster::~Monster()
 {
+	InstanceCounter<Monster>::onDestroy();
+
 	if (isSummon()) {
 		if (master) {
 			master->decrementReferenceCounter();
@@ -178,6 +229,12 @@ Monster::~Monster()
 	}
 }
 
+void Monster::setID()
+{
+	// a monster placed again after it was removed gets a new id
+	id = g_game.reserveMonsterId(id);
+}
+
 void Monster::addList()
 {
 	g_game.addMonster(this);
@@ -208,9 +265,10 @@ void Monster::setName(const std::string& newName)
 	// it is not feasible to send creature update to everyone that has ever met it
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, position, true, true);
+	const TileStackpos stackpos(getTile(), this);
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendUpdateTileCreature(this);
+			tmpPlayer->sendUpdateTileCreature(this, stackpos);
 		}
 	}
 }
@@ -262,7 +320,7 @@ void Monster::onCreatureAppear(Creature* creature, bool isLogin)
 		// onCreatureAppear(self, creature)
 		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
 		if (!scriptInterface->reserveScriptEnv()) {
-			std::cout << "[Error - Monster::onCreatureAppear] Call stack overflow" << std::endl;
+			TVP_LOG(LOGLEVEL_ERROR, "[Error - Monster::onCreatureAppear] Call stack overflow");
 			return;
 		}
 
@@ -299,7 +357,7 @@ void Monster::onRemoveCreature(Creature* creature, bool isLogout)
 		// onCreatureDisappear(self, creature)
 		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
 		if (!scriptInterface->reserveScriptEnv()) {
-			std::cout << "[Error - Monster::onCreatureDisappear] Call stack overflow" << std::endl;
+			TVP_LOG(LOGLEVEL_ERROR, "[Error - Monster::onCreatureDisappear] Call stack overflow");
 			return;
 		}
 
@@ -346,7 +404,7 @@ void Monster::onCreatureMove(Creature* creature, const Tile* newTile, const Posi
 		// onCreatureMove(self, creature, oldPosition, newPosition)
 		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
 		if (!scriptInterface->reserveScriptEnv()) {
-			std::cout << "[Error - Monster::onCreatureMove] Call stack overflow" << std::endl;
+			TVP_LOG(LOGLEVEL_ERROR, "[Error - Monster::onCreatureMove] Call stack overflow");
 			return;
 		}
 
@@ -431,6 +489,20 @@ void Monster::onCreatureMove(Creature* creature, const Tile* newTile, const Posi
 	}
 }
 
+bool Monster::caresAboutMove(const Creature* creature) const
+{
+	if (Creature::caresAboutMove(creature) || creature == Target || mType->info.creatureMoveEvent != -1) {
+		return true;
+	}
+
+	if (creature->getNpc()) {
+		return false;
+	}
+
+	// a wild monster has nothing to do when another wild monster walks by, it can never target it
+	return !creature->getMonster() || (isSummon() && master->getPlayer()) || (creature->isSummon() && creature->getMaster()->getPlayer());
+}
+
 void Monster::onCreatureSay(Creature* creature, SpeakClasses type, const std::string& text)
 {
 	Creature::onCreatureSay(creature, type, text);
@@ -439,7 +511,7 @@ void Monster::onCreatureSay(Creature* creature, SpeakClasses type, const std::st
 		// onCreatureSay(self, creature, type, message)
 		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
 		if (!scriptInterface->reserveScriptEnv()) {
-			std::cout << "[Error - Monster::onCreatureSay] Call stack overflow" << std::endl;
+			TVP_LOG(LOGLEVEL_ERROR, "[Error - Monster::onCreatureSay] Call stack overflow");
 			return;
 		}
 
@@ -606,6 +678,102 @@ bool Monster::isTarget(const Creature* creature) const
 	return true;
 }
 
+Creature* Monster::searchTarget(bool& opponentFound) const
+{
+	// only reads the world, the caller decides what to do with the result
+	Creature* target = nullptr;
+	int32_t Goodness = INT32_MIN;
+	int32_t TieBreaker = 0;
+	int32_t Strategy = 0;
+	int32_t r = random(0, 99);
+
+	if (r < mType->info.strategyNearestEnemy) {
+		Strategy = 0;
+	}
+	else {
+		r -= mType->info.strategyNearestEnemy;
+	}
+
+	if (r < mType->info.strategyWeakestEnemy) {
+		Strategy = 1;
+	}
+	else {
+		r -= mType->info.strategyWeakestEnemy;
+	}
+
+	if (r < mType->info.strategyMostDamageEnemy) {
+		Strategy = 2;
+	}
+
+	SpectatorVec spectators;
+	g_game.map.getSpectators(spectators, getPosition(), true, false, 12, 12, 12, 12);
+
+	for (Creature* cr : spectators) {
+		if (cr == this)
+			continue;
+
+		const Position& pos = cr->getPosition();
+		const Position& myPos = getPosition();
+
+		if (pos.z != myPos.z)
+			continue;
+
+		if (!isOpponent(cr))
+			continue;
+
+		opponentFound = true;
+
+		if (!isTarget(cr))
+			continue;
+
+		if (cr->getPlayer() && cr->getPlayer()->hasFlag(PlayerFlag_IgnoredByMonsters))
+			continue;
+
+		int32_t dx = Position::getDistanceX(myPos, pos);
+		int32_t dy = Position::getDistanceY(myPos, pos);
+
+		if (dx > 10 || dy > 10)
+			continue;
+
+		opponentFound = true;
+
+		if (!canSeeInvisibility() && cr->isInvisible())
+			continue;
+
+		if (cr->getTile()->hasFlag(TILESTATE_PROTECTIONZONE))
+			continue;
+
+		int32_t Priority = 0;
+
+		switch (Strategy) {
+		case 1:
+			Priority = -cr->getHealth();
+			break;
+		case 2:
+			Priority = getDamageDealtByAttacker(cr);
+			break;
+		case 3:
+			Priority = random(0, 99);
+			break;
+		case 0:
+			Priority = -(dy + dx);
+			break;
+		default:
+			std::cout << "[Error - Monster::searchTarget] Invalid strategy: " << Strategy << " for monster " << getName() << std::endl;
+			break;
+		}
+
+		int32_t r = random(0, 99);
+		if (Priority > Goodness || Priority == Goodness && r > TieBreaker) {
+			target = cr;
+			Goodness = Priority;
+			TieBreaker = r;
+		}
+	}
+
+	return target;
+}
+
 bool Monster::selectTarget(Creature* creature)
 {
 	if (!isTarget(creature) || creature->getZone() == ZONE_PROTECTION) {
@@ -625,6 +793,14 @@ void Monster::setIdle(bool idle)
 
 	if (!isIdle) {
 		g_game.addCreatureCheck(this);
+
+		for (Creature* summon : summons) {
+			Monster* monster = summon->getMonster();
+			if (monster && monster->State == STATE::SLEEPING) {
+				monster->State = STATE::IDLE;
+				monster->addYieldToDo();
+			}
+		}
 	} else {
 		onIdleStatus();
 		Game::removeCreatureCheck(this);
@@ -724,7 +900,7 @@ void Monster::onIdleStimulus()
 		// onIdleStimulus(self)
 		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
 		if (!scriptInterface->reserveScriptEnv()) {
-			std::cout << "[Error - Monster::onIdleStimulus] Call stack overflow" << std::endl;
+			TVP_LOG(LOGLEVEL_ERROR, "[Error - Monster::onIdleStimulus] Call stack overflow");
 			return;
 		}
 
@@ -792,6 +968,14 @@ void Monster::onIdleStimulus()
 			return;
 		}
 
+		// nothing is around while our master sleeps, we doze off with it and it wakes us again
+		const Monster* masterMonster = master->getMonster();
+		if (masterMonster && masterMonster->State == STATE::SLEEPING) {
+			State = STATE::SLEEPING;
+			setIdle(true);
+			return;
+		}
+
 		setAttackedCreature(master->attackedCreature);
 
 		if (master->attackedCreature == this || !master->attackedCreature) {
@@ -847,91 +1031,12 @@ void Monster::onIdleStimulus()
 		bool Sleep = true;
 
 		if (!isSummon()) {
-			int32_t Goodness = INT32_MIN;
-			int32_t TieBreaker = 0;
-			int32_t Strategy = 0;
-			int32_t r = random(0, 99);
-
-			if (r < mType->info.strategyNearestEnemy) {
-				Strategy = 0;
-			}
-			else {
-				r -= mType->info.strategyNearestEnemy;
-			}
-
-			if (r < mType->info.strategyWeakestEnemy) {
-				Strategy = 1;
-			}
-			else {
-				r -= mType->info.strategyWeakestEnemy;
-			}
-
-			if (r < mType->info.strategyMostDamageEnemy) {
-				Strategy = 2;
-			}
-
-			SpectatorVec spectators;
-			g_game.map.getSpectators(spectators, getPosition(), true, false, 12, 12, 12, 12);
-			spectators.erase(this); // Always delete self
+			bool opponentFound = false;
+			Creature* target = searchTarget(opponentFound);
+			Sleep = !opponentFound;
 
-			for (Creature* cr : spectators) {
-				const Position& pos = cr->getPosition();
-				const Position& myPos = getPosition();
-
-				if (pos.z != myPos.z)
-					continue;
-
-				if (!isOpponent(cr))
-					continue;
-
-				Sleep = false;
-
-				if (!isTarget(cr))
-					continue;
-
-				if (cr->getPlayer() && cr->getPlayer()->hasFlag(PlayerFlag_IgnoredByMonsters))
-					continue;
-
-				int32_t dx = Position::getDistanceX(myPos, pos);
-				int32_t dy = Position::getDistanceY(myPos, pos);
-
-				if (dx > 10 || dy > 10)
-					continue;
-
-				Sleep = false;
-
-				if (!canSeeInvisibility() && cr->isInvisible())
-					continue;
-
-				if (cr->getTile()->hasFlag(TILESTATE_PROTECTIONZONE))
-					continue;
-
-				int32_t Priority = 0;
-
-				switch (Strategy) {
-				case 1:
-					Priority = -cr->getHealth();
-					break;
-				case 2:
-					Priority = getDamageDealtByAttacker(cr);
-					break;
-				case 3:
-					Priority = random(0, 99);
-					break;
-				case 0:
-					Priority = -(dy + dx);
-					break;
-				default:
-					std::cout << "[Error - Monster::onIdleStimulus] Invalid strategy: " << Strategy << " for monster " << getName() << std::endl;
-					break;
-				}
-
-				int32_t r = random(0, 99);
-				if (Priority > Goodness || Priority == Goodness && r > TieBreaker) {
-					setAttackedCreature(cr);
-					Goodness = Priority;
-					TieBreaker = r;
-				}
+			if (target) {
+				setAttackedCreature(target);
 			}
 		}
 
@@ -1181,13 +1286,18 @@ void Monster::onIdleStimulus()
 
 void Monster::onThink(uint32_t interval)
 {
+	PROFILE_FUNCTION();
 	Creature::onThink(interval);
 
+	if (mType->info.thinkBatchEvent != -1) {
+		g_game.addBatchedMonsterThink(this);
+	}
+
 	if (mType->info.thinkEvent != -1) {
 		// onThink(self, interval)
 		LuaScriptInterface* scriptInterface = mType->info.scriptInterface;
 		if (!scriptInterface->reserveScriptEnv()) {
-			std::cout << "[Error - Monster::onThink] Call stack overflow" << std::endl;
+			TVP_LOG(LOGLEVEL_ERROR, "[Error - Monster::onThink] Call stack overflow");
 			return;
 		}
 
@@ -1208,6 +1318,15 @@ void Monster::onThink(uint32_t interval)
 	}
 }
 
+uint32_t Monster::getThinkInterval(uint32_t interval, uint32_t divisor)
+{
+	deferredThinkInterval += interval;
+	if (divisor > 1 && !Target && !attackedCreature && !followCreature && deferredThinkInterval < interval * divisor) {
+		return 0;
+	}
+	return std::exchange(deferredThinkInterval, 0);
+}
+
 void Monster::doAttacking()
 {
 	if (!attackedCreature || getHealth() <= 0 || isRemoved() || mType->info.baseSkill == 0 || !isSummon() && mType->info.runAwayHealth == mType->info.healthMax) {
@@ -1709,19 +1828,15 @@ void Monster::doAttackSpells()
 		return;
 	}
 
-	for (const spellBlock_t& spellBlock : mType->info.attackSpells) {
-		if (spellBlock.isMelee) {
-			continue;
-		}
-
-		if (!(rand() % spellBlock.delay) && (isSummon() || !isFleeing() || random(1, 3) == 1)) {
+	attackSchedule.roll(mType->info.attackSpells, [this](const spellBlock_t& spellBlock) {
+		if (isSummon() || !isFleeing() || random(1, 3) == 1) {
 			if (spellBlock.updateLook) {
 				updateLookDirection();
 			}
 
 			if (spellBlock.range != 0) {
 				if (!attackedCreature) {
-					continue;
+					return;
 				}
 
 				const Position& myPos = getPosition();
@@ -1729,7 +1844,7 @@ void Monster::doAttackSpells()
 				const int32_t targetDistance = std::max<int32_t>(Position::getDistanceX(myPos, targetPos), Position::getDistanceY(myPos, targetPos));
 				
 				if (!g_game.canThrowObjectTo(myPos, targetPos, false) || targetDistance > static_cast<int32_t>(spellBlock.range)) {
-					continue;
+					return;
 				}
 			}
 
@@ -1742,13 +1857,13 @@ void Monster::doAttackSpells()
 				spellBlock.spell->castSpell(this, this);
 			}
 		}
-	}
+	});
 }
 
 void Monster::doDefensiveSpells()
 {
-	for (const spellBlock_t& spellBlock : mType->info.defenseSpells) {
-		if (!(rand() % spellBlock.delay) && (isSummon() || !isFleeing() || random(1, 3) == 1)) {
+	defenseSchedule.roll(mType->info.defenseSpells, [this](const spellBlock_t& spellBlock) {
+		if (isSummon() || !isFleeing() || random(1, 3) == 1) {
 			if (spellBlock.updateLook) {
 				updateLookDirection();
 			}
@@ -1757,7 +1872,7 @@ void Monster::doDefensiveSpells()
 			maxCombatValue = spellBlock.maxCombatValue;
 			spellBlock.spell->castSpell(this, this);
 		}
-	}
+	});
 }
 
 void Monster::spawnSummons()
@@ -1767,6 +1882,10 @@ void Monster::spawnSummons()
 	}
 
 	if (!isSummon() && summons.size() < mType->info.maxSummons) {
+		// looked up on the first summon, every summon then takes a field of its own
+		std::vector<Position> fields;
+		bool searchedFields = false;
+
 		for (const summonBlock_t& summonBlock : mType->info.summons) {
 			if (summons.size() >= mType->info.maxSummons) {
 				continue;
@@ -1785,8 +1904,17 @@ void Monster::spawnSummons()
 
 			if (!uniform_random(0, summonBlock.delay) && (isSummon() || !isFleeing() || uniform_random(1, 3) == 1)) {
 				if (Monster* summon = Monster::createMonster(summonBlock.name)) {
+					if (!searchedFields) {
+						fields = g_game.searchSummonFields(getPosition(), 2, mType->info.maxSummons - summons.size());
+						searchedFields = true;
+					}
+
 					Position pos = getPosition();
-					g_game.searchSummonField(pos.x, pos.y, pos.z, 2);
+					if (!fields.empty()) {
+						pos = fields.back();
+						fields.pop_back();
+					}
+
 					if (g_game.placeCreature(summon, pos, summonBlock.force)) {
 						summon->setDropLoot(false);
 						summon->setSkillLoss(false);
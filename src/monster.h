@@ -33,6 +33,55 @@ enum STATE : int32_t
 	PANIC = 6,
 };
 
+/*
+ * A spell is cast on a round of its list with a chance of 1 in its delay. Rather than rolling every
+ * spell every round, the round each spell passes its roll next is drawn ahead and kept in a heap, so a
+ * round only looks at the spells due in it. The rounds between two passes of a roll are as long as
+ * the separate rolls would make them.
+ */
+class SpellSchedule
+{
+	public:
+		// calls onDue with every spell of spells whose roll passes this round, in list order
+		template<typename F>
+		void roll(const std::vector<spellBlock_t>& spells, F&& onDue) {
+			if (scheduledSpells != &spells || spellCount != spells.size()) {
+				schedule(spells);
+			}
+
+			++round;
+			while (!heap.empty() && heap.front().round <= round) {
+				std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+				Entry& entry = heap.back();
+				const uint32_t index = entry.index;
+				entry.round = round + nextPass(spells[index].delay);
+				std::push_heap(heap.begin(), heap.end(), std::greater<>());
+
+				onDue(spells[index]);
+			}
+		}
+
+	private:
+		struct Entry {
+			uint32_t round;
+			uint32_t index;
+
+			bool operator>(const Entry& other) const {
+				return round != other.round ? round > other.round : index > other.index;
+			}
+		};
+
+		// the melee blocks are not rolled here
+		void schedule(const std::vector<spellBlock_t>& spells);
+		// rounds until a roll of 1 in delay passes again
+		static uint32_t nextPass(uint32_t delay);
+
+		std::vector<Entry> heap;
+		const std::vector<spellBlock_t>* scheduledSpells = nullptr;
+		size_t spellCount = 0;
+		uint32_t round = 0;
+};
+
 class Monster final : public Creature
 {
 	public:
@@ -41,6 +90,10 @@ class Monster final : public Creature
 		explicit Monster(MonsterType* mType, const std::vector<LootBlock>* extraLoot = nullptr);
 		~Monster();
 
+		// respawned monsters reuse the memory of dead ones
+		static void* operator new(size_t size);
+		static void operator delete(void* p, size_t size);
+
 		// non-copyable
 		Monster(const Monster&) = delete;
 		Monster& operator=(const Monster&) = delete;
@@ -52,11 +105,7 @@ class Monster final : public Creature
 			return this;
 		}
 
-		void setID() override {
-			if (id == 0) {
-				id = monsterAutoID++;
-			}
-		}
+		void setID() override;
 
 		void addList() override;
 		void removeList() override;
@@ -122,6 +171,9 @@ class Monster final : public Creature
 		uint32_t getManaCost() const {
 			return mType->info.manaCost;
 		}
+		BaseSpawn* getSpawn() const {
+			return spawn;
+		}
 		void setSpawn(BaseSpawn* newSpawn) {
 			spawn = newSpawn;
 		}
@@ -132,7 +184,11 @@ class Monster final : public Creature
 		void onCreatureAppear(Creature* creature, bool isLogin) override;
 		void onRemoveCreature(Creature* creature, bool isLogout) override;
 		void onCreatureMove(Creature* creature, const Tile* newTile, const Position& newPos, const Tile* oldTile, const Position& oldPos, bool teleport) override;
+		bool caresAboutMove(const Creature* creature) const override;
 		void onCreatureSay(Creature* creature, SpeakClasses type, const std::string& text) override;
+		bool canHear() const override {
+			return mType->info.creatureSayEvent != -1;
+		}
 
 		void drainHealth(Creature* attacker, int32_t damage) override;
 		void changeHealth(int32_t healthChange, bool sendHealthChange = true) override;
@@ -141,6 +197,8 @@ class Monster final : public Creature
 
 		void onIdleStimulus() override;
 		void onThink(uint32_t interval) override;
+		// the interval to think with this round, 0 to skip it; without a target only every divisor rounds
+		uint32_t getThinkInterval(uint32_t interval, uint32_t divisor);
 
 		bool challengeCreature(Creature* creature, bool force = false) override;
 
@@ -153,6 +211,8 @@ class Monster final : public Creature
 
 		void doAttacking() override;
 
+		// picks the best target around without changing any state, opponentFound is set when something is worth staying awake for
+		Creature* searchTarget(bool& opponentFound) const;
 		bool selectTarget(Creature* creature);
 
 		bool isTarget(const Creature* creature) const;
@@ -180,7 +240,8 @@ class Monster final : public Creature
 		static bool pushCreature(const Position& fromPos, Creature* creature);
 		static bool pushCreatures(const Position& fromPos, Tile* fromTile, Creature* pushingCreature = nullptr);
 
-		static uint32_t monsterAutoID;
+		// monster ids are from here up to the npc ids
+		static constexpr uint32_t ID_BASE = 0x40000000;
 
 	private:
 		std::string name;
@@ -204,6 +265,7 @@ class Monster final : public Creature
 		uint32_t skillFactorPercent = 1000;
 		uint32_t skillNextLevel = 0;
 		uint32_t skillLearningPoints = 30;
+		uint32_t deferredThinkInterval = 0;
 
 		LightInfo internalLight{};
 
@@ -217,6 +279,9 @@ class Monster final : public Creature
 
 		std::array<Item*, CONST_SLOT_LAST + 1> inventory{};
 
+		SpellSchedule attackSchedule;
+		SpellSchedule defenseSchedule;
+
 		void addMonsterItemInventory(Container* bagItem, Item* item);
 
 		void onCreatureEnter(Creature* creature);
@@ -10,9 +10,13 @@
 #include "weapons.h"
 #include "configmanager.h"
 #include "game.h"
+#include "jobpool.h"
 
 #include "pugicast.h"
 
+#include <filesystem>
+#include <fstream>
+
 extern Game g_game;
 extern Spells* g_spells;
 extern Monsters g_monsters;
@@ -25,8 +29,46 @@ spellBlock_t::~spellBlock_t()
 	}
 }
 
+namespace {
+
+// spells by name belong to g_spells and scripted ones to its script interface, a reload of the spells rebuilds both
+bool usesReloadedSpells(const MonsterType& mType)
+{
+	auto reloaded = [](const spellBlock_t& sb) {
+		return !sb.combatSpell || static_cast<const CombatSpell*>(sb.spell)->isScripted();
+	};
+	return std::any_of(mType.info.attackSpells.begin(), mType.info.attackSpells.end(), reloaded) ||
+		std::any_of(mType.info.defenseSpells.begin(), mType.info.defenseSpells.end(), reloaded);
+}
+
+}
+
+void CompiledLoot::compile(const std::vector<LootBlock>& lootItems, int32_t rate)
+{
+	this->rate = rate;
+	entries.clear();
+	entries.reserve(lootItems.size());
+
+	// a roll of uniform_random(0, MAX_LOOTCHANCE) <= chance * rate
+	for (auto lootInfo = lootItems.rbegin(); lootInfo != lootItems.rend(); ++lootInfo) {
+		const int64_t lootrate = static_cast<int64_t>(lootInfo->chance) * rate;
+		const double chance = static_cast<double>(std::min<int64_t>(lootrate + 1, MAX_LOOTCHANCE + 1)) / (MAX_LOOTCHANCE + 1);
+		entries.push_back({lootInfo->id, lootInfo->countmax, chance, 1 - chance});
+	}
+
+	for (size_t i = entries.size(); i-- > 0; ) {
+		Entry& entry = entries[i];
+		const double chance = entry.drop;
+		if (i + 1 < entries.size()) {
+			entry.noDrop *= entries[i + 1].noDrop;
+		}
+		entry.drop = entry.noDrop < 1 ? std::min(1.0, chance / (1 - entry.noDrop)) : 1;
+	}
+}
+
 void MonsterType::loadLoot(MonsterType* monsterType, LootBlock lootBlock)
 {
+	monsterType->info.compiledLoot.clear();
 	if (lootBlock.childLoot.empty()) {
 		bool isContainer = Item::items[lootBlock.id].isContainer();
 		if (isContainer) {
@@ -60,12 +102,91 @@ bool Monsters::loadFromXml(bool reloading /*= false*/)
 
 	bool forceLoad = g_config.getBoolean(ConfigManager::FORCE_MONSTERTYPE_LOAD);
 
-	for (auto it : unloadedMonsters) {
+	std::vector<std::pair<std::string, std::string>> monsterFiles;
+	for (const auto& it : unloadedMonsters) {
 		if ((forceLoad || reloading) && monsters.find(it.first) != monsters.end()) {
-			loadMonster(it.second, it.first, reloading);
+			monsterFiles.emplace_back(it.first, it.second);
+		}
+	}
+
+	if (monsterFiles.empty()) {
+		return true;
+	}
+
+	const int64_t start = OTSYS_TIME();
+
+	// a reload keeps the monsters whose file is untouched, scripted ones are parsed again as reload recreates their script interface,
+	// and so are the ones holding spells that the reload of the spells frees
+	std::vector<const MonsterFileStamp*> previousStamps(monsterFiles.size(), nullptr);
+	if (reloading) {
+		for (size_t i = 0; i < monsterFiles.size(); ++i) {
+			auto stampIt = fileStamps.find(monsterFiles[i].first);
+			auto typeIt = monsters.find(monsterFiles[i].first);
+			if (stampIt != fileStamps.end() && typeIt != monsters.end() && !typeIt->second.info.scriptInterface && !usesReloadedSpells(typeIt->second)) {
+				previousStamps[i] = &stampIt->second;
+			}
 		}
 	}
 
+	// reading, hashing and parsing the documents is independent of everything else, building the types is not
+	std::vector<std::string> contents(monsterFiles.size());
+	std::vector<MonsterFileStamp> stamps(monsterFiles.size());
+	std::vector<uint8_t> unchanged(monsterFiles.size(), 0);
+	std::vector<pugi::xml_document> documents(monsterFiles.size());
+	std::vector<pugi::xml_parse_result> results(monsterFiles.size());
+	g_jobPool.parallelFor(monsterFiles.size(), [&](size_t i) {
+		const std::string& file = monsterFiles[i].second;
+		MonsterFileStamp& stamp = stamps[i];
+
+		std::error_code ec;
+		stamp.size = std::filesystem::file_size(file, ec);
+		if (!ec) {
+			stamp.writeTime = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+		}
+
+		const MonsterFileStamp* previous = previousStamps[i];
+		if (previous && !ec && previous->writeTime == stamp.writeTime && previous->size == stamp.size) {
+			stamp.hash = previous->hash;
+			unchanged[i] = 1;
+			return;
+		}
+
+		std::ifstream input(file, std::ios::binary);
+		if (!input) {
+			results[i] = documents[i].load_file(file.c_str());
+			return;
+		}
+
+		contents[i].assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+		stamp.hash = hashBytes(contents[i].data(), contents[i].size());
+		if (previous && previous->hash == stamp.hash) {
+			unchanged[i] = 1;
+			return;
+		}
+
+		results[i] = documents[i].load_buffer(contents[i].data(), contents[i].size());
+	});
+
+	size_t parsedFiles = 0;
+	for (size_t i = 0; i < monsterFiles.size(); ++i) {
+		if (unchanged[i]) {
+			fileStamps[monsterFiles[i].first] = stamps[i];
+			continue;
+		}
+
+		++parsedFiles;
+		if (!results[i]) {
+			printXMLError("Error - Monsters::loadMonster", monsterFiles[i].second, results[i]);
+			continue;
+		}
+
+		if (loadMonster(documents[i], monsterFiles[i].second, monsterFiles[i].first, reloading)) {
+			fileStamps[monsterFiles[i].first] = stamps[i];
+		}
+	}
+
+	std::cout << "> Monster loading time: " << (OTSYS_TIME() - start) / (1000.) << " seconds (" << parsedFiles << " files parsed, "
+	          << monsterFiles.size() - parsedFiles << " unchanged)." << std::endl;
 	return true;
 }
 
@@ -772,8 +893,6 @@ bool Monsters::deserializeSpell(MonsterSpell* spell, spellBlock_t& sb, const std
 
 MonsterType* Monsters::loadMonster(const std::string& file, const std::string& monsterName, bool reloading /*= false*/)
 {
-	MonsterType* mType = nullptr;
-
 	pugi::xml_document doc;
 	pugi::xml_parse_result result = doc.load_file(file.c_str());
 	if (!result) {
@@ -781,6 +900,13 @@ MonsterType* Monsters::loadMonster(const std::string& file, const std::string& m
 		return nullptr;
 	}
 
+	return loadMonster(doc, file, monsterName, reloading);
+}
+
+MonsterType* Monsters::loadMonster(const pugi::xml_document& doc, const std::string& file, const std::string& monsterName, bool reloading)
+{
+	MonsterType* mType = nullptr;
+
 	pugi::xml_node monsterNode = doc.child("monster");
 	if (!monsterNode) {
 		std::cout << "[Error - Monsters::loadMonster] Missing monster node in: " << file << std::endl;
@@ -861,6 +987,7 @@ MonsterType* Monsters::loadMonster(const std::string& file, const std::string& m
 			mType->info.creatureMoveEvent = scriptInterface->getEvent("onCreatureMove");
 			mType->info.creatureSayEvent = scriptInterface->getEvent("onCreatureSay");
 			mType->info.thinkEvent = scriptInterface->getEvent("onThink");
+			mType->info.thinkBatchEvent = scriptInterface->getEvent("onThinkBatch");
 		} else {
 			std::cout << "[Warning - Monsters::loadMonster] Can not load script: " << script << std::endl;
 			std::cout << scriptInterface->getLastLuaError() << std::endl;
@@ -1289,6 +1416,8 @@ MonsterType* Monsters::loadMonster(const std::string& file, const std::string& m
 
 	mType->info.summons.shrink_to_fit();
 	mType->info.lootItems.shrink_to_fit();
+	const int32_t lootRate = g_config.getNumber(ConfigManager::RATE_LOOT);
+	mType->info.compiledLoot.compile(mType->info.lootItems, lootRate > 0 ? lootRate : 1);
 	mType->info.attackSpells.shrink_to_fit();
 	mType->info.defenseSpells.shrink_to_fit();
 	mType->info.voiceVector.shrink_to_fit();
@@ -1315,6 +1444,8 @@ bool MonsterType::loadCallback(LuaScriptInterface* scriptInterface)
 		info.creatureMoveEvent = id;
 	} else if (info.eventType == MONSTERS_EVENT_SAY) {
 		info.creatureSayEvent = id;
+	} else if (info.eventType == MONSTERS_EVENT_THINK_BATCH) {
+		info.thinkBatchEvent = id;
 	}
 	return true;
 }
@@ -1335,19 +1466,14 @@ bool Monsters::loadLootItem(const pugi::xml_node& node, LootBlock& lootBlock)
 
 	} else if ((attr = node.attribute("name"))) {
 		auto name = attr.as_string();
-		auto ids = Item::items.nameToItems.equal_range(asLowerCaseString(name));
+		auto ids = Item::items.getItemIdsByName(name);
 
-		if (ids.first == Item::items.nameToItems.cend()) {
+		if (ids.first == ids.second) {
 			std::cout << "[Warning - Monsters::loadMonster] Unknown loot item \"" << name << "\". " << std::endl;
 			return false;
 		}
 
-		uint32_t id = ids.first->second;
-
-		if (std::next(ids.first) != ids.second) {
-			std::cout << "[Warning - Monsters::loadMonster] Non-unique loot item \"" << name << "\". " << std::endl;
-			return false;
-		}
+		uint32_t id = ids.first->id;
 
 		lootBlock.id = id;
 	}
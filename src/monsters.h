@@ -39,6 +39,62 @@ class Loot {
 		LootBlock lootBlock;
 };
 
+/*
+ * The loot of a monster type flattened for rolling at a loot rate. Every entry drops on its own, so
+ * along with its chance an entry keeps the chance that neither it nor any entry after it drops: one
+ * draw against that ends the roll, which is how most rolls go, and otherwise the next entry that drops
+ * is found with one draw per entry up to it. The same odds as a draw per entry, in fewer draws.
+ */
+class CompiledLoot
+{
+	public:
+		struct Entry {
+			uint16_t id;
+			uint32_t countmax;
+			// chance to drop given that this entry or one after it drops
+			double drop;
+			// chance that neither this entry nor any after it drops
+			double noDrop;
+		};
+
+		void compile(const std::vector<LootBlock>& lootItems, int32_t rate);
+		// forces the next roll to compile again, after the loot changed
+		void clear() {
+			entries.clear();
+			rate = 0;
+		}
+
+		int32_t getRate() const {
+			return rate;
+		}
+
+		// calls onDrop with every entry that drops, the last loot first
+		template<typename F>
+		void roll(F&& onDrop) const {
+			RandomGenerator& generator = getRandomGenerator();
+			bool dropsAhead = false;
+			for (const Entry& entry : entries) {
+				if (!dropsAhead && draw(generator) < entry.noDrop) {
+					return;
+				}
+
+				dropsAhead = draw(generator) >= entry.drop;
+				if (!dropsAhead) {
+					onDrop(entry);
+				}
+			}
+		}
+
+	private:
+		// 53 random bits as a double in [0, 1)
+		static double draw(RandomGenerator& generator) {
+			return static_cast<double>(generator() >> 11) * 0x1.0p-53;
+		}
+
+		std::vector<Entry> entries;
+		int32_t rate = 0;
+};
+
 struct summonBlock_t {
 	std::string name;
 	uint32_t chance;
@@ -94,13 +150,14 @@ struct voiceBlock_t {
 class MonsterType
 {
 	struct MonsterInfo {
-		LuaScriptInterface* scriptInterface;
+		LuaScriptInterface* scriptInterface = nullptr;
 
 		std::map<CombatType_t, int32_t> elementMap;
 
 		std::vector<voiceBlock_t> voiceVector;
 
 		std::vector<LootBlock> lootItems;
+		CompiledLoot compiledLoot;
 		std::vector<std::string> scripts;
 		std::vector<spellBlock_t> attackSpells;
 		std::vector<spellBlock_t> defenseSpells;
@@ -135,6 +192,8 @@ class MonsterType
 		int32_t creatureMoveEvent = -1;
 		int32_t creatureSayEvent = -1;
 		int32_t thinkEvent = -1;
+		// onThinkBatch(monsters, interval), called once per check with every monster of the type that thought
+		int32_t thinkBatchEvent = -1;
 		int32_t targetDistance = 1;
 		int32_t runAwayHealth = 0;
 		int32_t health = 100;
@@ -256,11 +315,20 @@ class Monsters
 		bool deserializeSpell(MonsterType* mType, const pugi::xml_node& node, spellBlock_t& sb, const std::string& description = "");
 
 		MonsterType* loadMonster(const std::string& file, const std::string& monsterName, bool reloading = false);
+		MonsterType* loadMonster(const pugi::xml_document& doc, const std::string& file, const std::string& monsterName, bool reloading);
 
 		void loadLootContainer(const pugi::xml_node& node, LootBlock&);
 		bool loadLootItem(const pugi::xml_node& node, LootBlock&);
 
 		std::map<std::string, std::string> unloadedMonsters;
 
+		// the file every monster was last parsed from, reloads skip the files that did not change
+		struct MonsterFileStamp {
+			int64_t writeTime = 0;
+			uintmax_t size = 0;
+			uint64_t hash = 0;
+		};
+		std::map<std::string, MonsterFileStamp> fileStamps;
+
 		bool loaded = false;
 };
@@ -20,26 +20,102 @@ MoveEvents::~MoveEvents()
 	clear();
 }
 
-void MoveEvents::clearMap(MoveListMap& map)
+MoveEventList* MovePositionIndex::find(const Position& pos) const
+{
+	if (count == 0) {
+		return nullptr;
+	}
+
+	const uint64_t key = getKey(pos);
+	for (size_t i = getSlot(key); slots[i].key != 0; i = (i + 1) & (slots.size() - 1)) {
+		if (slots[i].key == key) {
+			return slots[i].list;
+		}
+	}
+	return nullptr;
+}
+
+void MovePositionIndex::insert(const Position& pos, MoveEventList* list)
+{
+	// keep at most half of the slots used so probes stay short
+	if ((count + 1) * 2 > slots.size()) {
+		std::vector<Slot> oldSlots = std::move(slots);
+		slots.assign(std::max<size_t>(64, oldSlots.size() * 2), Slot());
+		for (const Slot& slot : oldSlots) {
+			if (slot.key != 0) {
+				size_t i = getSlot(slot.key);
+				while (slots[i].key != 0) {
+					i = (i + 1) & (slots.size() - 1);
+				}
+				slots[i] = slot;
+			}
+		}
+	}
+
+	const uint64_t key = getKey(pos);
+	size_t i = getSlot(key);
+	while (slots[i].key != 0 && slots[i].key != key) {
+		i = (i + 1) & (slots.size() - 1);
+	}
+
+	if (slots[i].key == 0) {
+		++count;
+	}
+	slots[i].key = key;
+	slots[i].list = list;
+}
+
+void MovePositionIndex::clear()
+{
+	slots.clear();
+	count = 0;
+}
+
+void MoveEvents::clearMap(MoveListMap& map, MoveListIndex& index)
 {
 	map.clear();
+	index.clear();
 }
 
 void MoveEvents::clearPosMap(MovePosListMap& map)
 {
 	map.clear();
+	positionIndex.clear();
 }
 
 void MoveEvents::clear()
 {
-	clearMap(itemIdMap);
-	clearMap(actionIdMap);
-	clearMap(uniqueIdMap);
+	clearMap(itemIdMap, itemIdIndex);
+	clearMap(actionIdMap, actionIdIndex);
+	clearMap(uniqueIdMap, uniqueIdIndex);
 	clearPosMap(positionMap);
 
 	getScriptInterface().reInitState();
 }
 
+void MoveEvents::removeScriptFile(const std::string* scriptFile)
+{
+	// the lists stay in the maps, the indexes keep pointing at them
+	for (MoveListMap* map : {&itemIdMap, &actionIdMap, &uniqueIdMap}) {
+		for (auto& it : *map) {
+			removeScriptFile(scriptFile, it.second);
+		}
+	}
+
+	for (auto& it : positionMap) {
+		removeScriptFile(scriptFile, it.second);
+	}
+}
+
+void MoveEvents::removeScriptFile(const std::string* scriptFile, MoveEventList& moveEventList)
+{
+	for (std::list<MoveEvent>& moveEvents : moveEventList.moveEvent) {
+		moveEvents.remove_if([scriptFile](const MoveEvent& moveEvent) {
+			return moveEvent.isFromScriptFile(scriptFile);
+		});
+	}
+}
+
 LuaScriptInterface& MoveEvents::getScriptInterface()
 {
 	return scriptInterface;
@@ -73,7 +149,7 @@ bool MoveEvents::registerLuaFunction(MoveEvent* event)
 	if (moveEvent->getItemIdRange().size() > 0) {
 		if (moveEvent->getItemIdRange().size() == 1) {
 			uint32_t id = moveEvent->getItemIdRange().at(0);
-			addEvent(*moveEvent, id, itemIdMap);
+			addEvent(*moveEvent, id, itemIdMap, itemIdIndex);
 			if (moveEvent->getEventType() == MOVE_EVENT_EQUIP) {
 				ItemType& it = Item::items.getItemType(id);
 				it.wieldInfo = moveEvent->getWieldInfo();
@@ -91,7 +167,7 @@ bool MoveEvents::registerLuaFunction(MoveEvent* event)
 					it.minReqMagicLevel = moveEvent->getReqMagLv();
 					it.vocationString = moveEvent->getVocationString();
 				}
-				addEvent(*moveEvent, moveEvent->getItemIdRange().at(iterId), itemIdMap);
+				addEvent(*moveEvent, moveEvent->getItemIdRange().at(iterId), itemIdMap, itemIdIndex);
 			}
 		}
 	} else {
@@ -123,7 +199,7 @@ bool MoveEvents::registerLuaEvent(MoveEvent* event)
 	if (moveEvent->getItemIdRange().size() > 0) {
 		if (moveEvent->getItemIdRange().size() == 1) {
 			uint32_t id = moveEvent->getItemIdRange().at(0);
-			addEvent(*moveEvent, id, itemIdMap);
+			addEvent(*moveEvent, id, itemIdMap, itemIdIndex);
 			if (moveEvent->getEventType() == MOVE_EVENT_EQUIP) {
 				ItemType& it = Item::items.getItemType(id);
 				it.wieldInfo = moveEvent->getWieldInfo();
@@ -141,27 +217,27 @@ bool MoveEvents::registerLuaEvent(MoveEvent* event)
 					it.minReqMagicLevel = moveEvent->getReqMagLv();
 					it.vocationString = moveEvent->getVocationString();
 				}
-				addEvent(*moveEvent, *i, itemIdMap);
+				addEvent(*moveEvent, *i, itemIdMap, itemIdIndex);
 			}
 		}
 	} else if (moveEvent->getActionIdRange().size() > 0) {
 		if (moveEvent->getActionIdRange().size() == 1) {
 			int32_t id = moveEvent->getActionIdRange().at(0);
-			addEvent(*moveEvent, id, actionIdMap);
+			addEvent(*moveEvent, id, actionIdMap, actionIdIndex);
 		} else {
 			auto v = moveEvent->getActionIdRange();
 			for (auto i = v.begin(); i != v.end(); i++) {
-				addEvent(*moveEvent, *i, actionIdMap);
+				addEvent(*moveEvent, *i, actionIdMap, actionIdIndex);
 			}
 		}
 	} else if (moveEvent->getUniqueIdRange().size() > 0) {
 		if (moveEvent->getUniqueIdRange().size() == 1) {
 			int32_t id = moveEvent->getUniqueIdRange().at(0);
-			addEvent(*moveEvent, id, uniqueIdMap);
+			addEvent(*moveEvent, id, uniqueIdMap, uniqueIdIndex);
 		} else {
 			auto v = moveEvent->getUniqueIdRange();
 			for (auto i = v.begin(); i != v.end(); i++) {
-				addEvent(*moveEvent, *i, uniqueIdMap);
+				addEvent(*moveEvent, *i, uniqueIdMap, uniqueIdIndex);
 			}
 		}
 	} else if (moveEvent->getPosList().size() > 0) {
@@ -181,13 +257,20 @@ bool MoveEvents::registerLuaEvent(MoveEvent* event)
 	return true;
 }
 
-void MoveEvents::addEvent(MoveEvent moveEvent, int32_t id, MoveListMap& map)
+void MoveEvents::addEvent(MoveEvent moveEvent, int32_t id, MoveListMap& map, MoveListIndex& index)
 {
 	auto it = map.find(id);
 	if (it == map.end()) {
-		MoveEventList moveEventList;
+		MoveEventList& moveEventList = map[id];
 		moveEventList.moveEvent[moveEvent.getEventType()].push_back(std::move(moveEvent));
-		map[id] = moveEventList;
+
+		// items only carry 16 bit ids, anything else can never be looked up
+		if (id >= 0 && id <= std::numeric_limits<uint16_t>::max()) {
+			if (static_cast<size_t>(id) >= index.size()) {
+				index.resize(id + 1);
+			}
+			index[id] = &moveEventList;
+		}
 	} else {
 		std::list<MoveEvent>& moveEventList = it->second.moveEvent[moveEvent.getEventType()];
 		for (MoveEvent& existingMoveEvent : moveEventList) {
@@ -216,9 +299,8 @@ MoveEvent* MoveEvents::getEvent(Item* item, MoveEvent_t eventType, slots_t slot)
 		default: slotp = 0; break;
 	}
 
-	auto it = itemIdMap.find(item->getID());
-	if (it != itemIdMap.end()) {
-		std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+	if (MoveEventList* list = findList(itemIdIndex, item->getID())) {
+		std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 		for (MoveEvent& moveEvent : moveEventList) {
 			if ((moveEvent.getSlot() & slotp) != 0) {
 				return &moveEvent;
@@ -230,12 +312,9 @@ MoveEvent* MoveEvents::getEvent(Item* item, MoveEvent_t eventType, slots_t slot)
 
 MoveEvent* MoveEvents::getEvent(Item* item, MoveEvent_t eventType)
 {
-	MoveListMap::iterator it;
-
 	if (item->hasAttribute(ITEM_ATTRIBUTE_UNIQUEID)) {
-		it = uniqueIdMap.find(item->getUniqueId());
-		if (it != uniqueIdMap.end()) {
-			std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+		if (MoveEventList* list = findList(uniqueIdIndex, item->getUniqueId())) {
+			std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 			if (!moveEventList.empty()) {
 				return &(*moveEventList.begin());
 			}
@@ -243,18 +322,16 @@ MoveEvent* MoveEvents::getEvent(Item* item, MoveEvent_t eventType)
 	}
 
 	if (item->hasAttribute(ITEM_ATTRIBUTE_ACTIONID)) {
-		it = actionIdMap.find(item->getActionId());
-		if (it != actionIdMap.end()) {
-			std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+		if (MoveEventList* list = findList(actionIdIndex, item->getActionId())) {
+			std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 			if (!moveEventList.empty()) {
 				return &(*moveEventList.begin());
 			}
 		}
 	}
 
-	it = itemIdMap.find(item->getID());
-	if (it != itemIdMap.end()) {
-		std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+	if (MoveEventList* list = findList(itemIdIndex, item->getID())) {
+		std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 		if (!moveEventList.empty()) {
 			return &(*moveEventList.begin());
 		}
@@ -264,12 +341,9 @@ MoveEvent* MoveEvents::getEvent(Item* item, MoveEvent_t eventType)
 
 MoveEvent* MoveEvents::getUniqueIdEvent(Item* item, MoveEvent_t eventType)
 {
-	MoveListMap::iterator it;
-
 	if (item->hasAttribute(ITEM_ATTRIBUTE_UNIQUEID)) {
-		it = uniqueIdMap.find(item->getUniqueId());
-		if (it != uniqueIdMap.end()) {
-			std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+		if (MoveEventList* list = findList(uniqueIdIndex, item->getUniqueId())) {
+			std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 			if (!moveEventList.empty()) {
 				return &(*moveEventList.begin());
 			}
@@ -281,12 +355,9 @@ MoveEvent* MoveEvents::getUniqueIdEvent(Item* item, MoveEvent_t eventType)
 
 MoveEvent* MoveEvents::getActionIdEvent(Item* item, MoveEvent_t eventType)
 {
-	MoveListMap::iterator it;
-
 	if (item->hasAttribute(ITEM_ATTRIBUTE_ACTIONID)) {
-		it = actionIdMap.find(item->getActionId());
-		if (it != actionIdMap.end()) {
-			std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+		if (MoveEventList* list = findList(actionIdIndex, item->getActionId())) {
+			std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 			if (!moveEventList.empty()) {
 				return &(*moveEventList.begin());
 			}
@@ -298,9 +369,8 @@ MoveEvent* MoveEvents::getActionIdEvent(Item* item, MoveEvent_t eventType)
 
 MoveEvent* MoveEvents::getItemIdEvent(Item* item, MoveEvent_t eventType)
 {
-	MoveListMap::iterator it = itemIdMap.find(item->getID());
-	if (it != itemIdMap.end()) {
-		std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+	if (MoveEventList* list = findList(itemIdIndex, item->getID())) {
+		std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 		if (!moveEventList.empty()) {
 			return &(*moveEventList.begin());
 		}
@@ -313,9 +383,9 @@ void MoveEvents::addEvent(MoveEvent moveEvent, const Position& pos, MovePosListM
 {
 	auto it = map.find(pos);
 	if (it == map.end()) {
-		MoveEventList moveEventList;
+		MoveEventList& moveEventList = map[pos];
 		moveEventList.moveEvent[moveEvent.getEventType()].push_back(std::move(moveEvent));
-		map[pos] = moveEventList;
+		positionIndex.insert(pos, &moveEventList);
 	} else {
 		std::list<MoveEvent>& moveEventList = it->second.moveEvent[moveEvent.getEventType()];
 		if (!moveEventList.empty()) {
@@ -328,9 +398,8 @@ void MoveEvents::addEvent(MoveEvent moveEvent, const Position& pos, MovePosListM
 
 MoveEvent* MoveEvents::getEvent(const Tile* tile, MoveEvent_t eventType)
 {
-	auto it = positionMap.find(tile->getPosition());
-	if (it != positionMap.end()) {
-		std::list<MoveEvent>& moveEventList = it->second.moveEvent[eventType];
+	if (MoveEventList* list = positionIndex.find(tile->getPosition())) {
+		std::list<MoveEvent>& moveEventList = list->moveEvent[eventType];
 		if (!moveEventList.empty()) {
 			return &(*moveEventList.begin());
 		}
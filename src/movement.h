@@ -32,6 +32,31 @@ struct MoveEventList {
 
 using VocEquipMap = std::map<uint16_t, bool>;
 
+// open addressing table from a position to its move events, probed on every step
+class MovePositionIndex
+{
+	public:
+		MoveEventList* find(const Position& pos) const;
+		void insert(const Position& pos, MoveEventList* list);
+		void clear();
+
+	private:
+		struct Slot {
+			uint64_t key = 0; // 0 marks an empty slot
+			MoveEventList* list = nullptr;
+		};
+
+		static uint64_t getKey(const Position& pos) {
+			return ((static_cast<uint64_t>(pos.x) << 24) | (static_cast<uint64_t>(pos.y) << 8) | pos.z) + 1;
+		}
+		size_t getSlot(uint64_t key) const {
+			return (key * 0x9E3779B97F4A7C15ULL) & (slots.size() - 1);
+		}
+
+		std::vector<Slot> slots;
+		size_t count = 0;
+};
+
 class MoveEvents final
 {
 	public:
@@ -55,17 +80,24 @@ class MoveEvents final
 		bool registerLuaEvent(MoveEvent* event);
 		bool registerLuaFunction(MoveEvent* event);
 		void clear();
+		void removeScriptFile(const std::string* scriptFile);
 
 	private:
 		using MoveListMap = std::map<int32_t, MoveEventList>;
 		using MovePosListMap = std::map<Position, MoveEventList>;
-		void clearMap(MoveListMap& map);
+		// the id maps indexed directly by id, probed on every step and every equip
+		using MoveListIndex = std::vector<MoveEventList*>;
+		void clearMap(MoveListMap& map, MoveListIndex& index);
 		void clearPosMap(MovePosListMap& map);
+		static void removeScriptFile(const std::string* scriptFile, MoveEventList& moveEventList);
 
 		LuaScriptInterface& getScriptInterface();
 		std::string getScriptBaseName() const;
 
-		void addEvent(MoveEvent moveEvent, int32_t id, MoveListMap& map);
+		void addEvent(MoveEvent moveEvent, int32_t id, MoveListMap& map, MoveListIndex& index);
+		static MoveEventList* findList(const MoveListIndex& index, uint16_t id) {
+			return id < index.size() ? index[id] : nullptr;
+		}
 
 		void addEvent(MoveEvent moveEvent, const Position& pos, MovePosListMap& map);
 		MoveEvent* getEvent(const Tile* tile, MoveEvent_t eventType);
@@ -77,6 +109,11 @@ class MoveEvents final
 		MoveListMap itemIdMap;
 		MovePosListMap positionMap;
 
+		MoveListIndex uniqueIdIndex;
+		MoveListIndex actionIdIndex;
+		MoveListIndex itemIdIndex;
+		MovePositionIndex positionIndex;
+
 		LuaScriptInterface scriptInterface;
 };
 
@@ -7,8 +7,17 @@
 
 #include "container.h"
 #include "creature.h"
+#include "lockfree.h"
 
-std::string NetworkMessage::getString(uint16_t stringLen/* = 0*/)
+namespace {
+
+const uint16_t INBOUNDMESSAGE_FREE_LIST_CAPACITY = 2048;
+
+using InboundMessageAllocator = LockfreePoolingAllocator<void, InboundMessage, INBOUNDMESSAGE_FREE_LIST_CAPACITY>;
+
+}
+
+std::string BasicNetworkMessage::getString(uint16_t stringLen/* = 0*/)
 {
 	if (stringLen == 0) {
 		stringLen = get<uint16_t>();
@@ -23,7 +32,7 @@ std::string NetworkMessage::getString(uint16_t stringLen/* = 0*/)
 	return std::string(v, stringLen);
 }
 
-Position NetworkMessage::getPosition()
+Position BasicNetworkMessage::getPosition()
 {
 	Position pos;
 	pos.x = get<uint16_t>();
@@ -32,7 +41,7 @@ Position NetworkMessage::getPosition()
 	return pos;
 }
 
-void NetworkMessage::addString(const std::string& value)
+void BasicNetworkMessage::addString(const std::string& value)
 {
 	size_t stringLen = value.length();
 	if (!canAdd(stringLen + 2) || stringLen > 8192) {
@@ -45,13 +54,13 @@ void NetworkMessage::addString(const std::string& value)
 	info.length += stringLen;
 }
 
-void NetworkMessage::addDouble(double value, uint8_t precision/* = 2*/)
+void BasicNetworkMessage::addDouble(double value, uint8_t precision/* = 2*/)
 {
 	addByte(precision);
 	add<uint32_t>(static_cast<uint32_t>((value * std::pow(static_cast<float>(10), precision)) + std::numeric_limits<int32_t>::max()));
 }
 
-void NetworkMessage::addBytes(const char* bytes, size_t size)
+void BasicNetworkMessage::addBytes(const char* bytes, size_t size)
 {
 	if (!canAdd(size) || size > 8192) {
 		return;
@@ -62,7 +71,7 @@ void NetworkMessage::addBytes(const char* bytes, size_t size)
 	info.length += size;
 }
 
-void NetworkMessage::addPaddingBytes(size_t n)
+void BasicNetworkMessage::addPaddingBytes(size_t n)
 {
 	if (!canAdd(n)) {
 		return;
@@ -72,14 +81,14 @@ void NetworkMessage::addPaddingBytes(size_t n)
 	info.length += n;
 }
 
-void NetworkMessage::addPosition(const Position& pos)
+void BasicNetworkMessage::addPosition(const Position& pos)
 {
 	add<uint16_t>(pos.x);
 	add<uint16_t>(pos.y);
 	addByte(pos.z);
 }
 
-void NetworkMessage::addItem(uint16_t id, uint8_t count)
+void BasicNetworkMessage::addItem(uint16_t id, uint8_t count)
 {
 	const ItemType& it = Item::items[id];
 
@@ -92,7 +101,7 @@ void NetworkMessage::addItem(uint16_t id, uint8_t count)
 	}
 }
 
-void NetworkMessage::addItem(const Item* item)
+void BasicNetworkMessage::addItem(const Item* item)
 {
 	const ItemType& it = Item::items[item->getID()];
 
@@ -105,7 +114,34 @@ void NetworkMessage::addItem(const Item* item)
 	}
 }
 
-void NetworkMessage::addItemId(uint16_t itemId)
+void BasicNetworkMessage::addItemId(uint16_t itemId)
 {
 	add<uint16_t>(Item::items[itemId].clientId);
 }
+
+InboundMessage::InboundMessage(const NetworkMessage& msg) : info(msg.info)
+{
+	// a message can be read up to 8 bytes past its length, the xtea padding
+	const size_t end = std::min<size_t>(info.length + 8, NETWORKMESSAGE_MAXSIZE);
+	if (info.position >= end) {
+		return;
+	}
+
+	size = end - info.position;
+	if (size <= INLINE_SIZE) {
+		std::copy_n(msg.buffer + info.position, size, inlineData.begin());
+	} else {
+		largeData.assign(msg.buffer + info.position, msg.buffer + end);
+	}
+}
+
+InboundMessage_ptr InboundMessage::make(const NetworkMessage& msg)
+{
+	return std::allocate_shared<InboundMessage>(InboundMessageAllocator(), msg);
+}
+
+void InboundMessage::restore(NetworkMessage& msg) const
+{
+	msg.info = info;
+	std::copy_n(size <= INLINE_SIZE ? inlineData.data() : largeData.data(), size, msg.buffer + info.position);
+}
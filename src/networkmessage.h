@@ -10,8 +10,12 @@ class Creature;
 class Player;
 struct Position;
 class RSA;
+class InboundMessage;
 
-class NetworkMessage
+using InboundMessage_ptr = std::shared_ptr<const InboundMessage>;
+
+// read and write functions over a buffer owned by the derived class
+class BasicNetworkMessage
 {
 	public:
 		using MsgSize_t = uint16_t;
@@ -24,7 +28,9 @@ class NetworkMessage
 		enum { MAX_BODY_LENGTH = NETWORKMESSAGE_MAXSIZE - HEADER_LENGTH - XTEA_MULTIPLE };
 		enum { MAX_PROTOCOL_BODY_LENGTH = MAX_BODY_LENGTH - 8 };
 
-		NetworkMessage() = default;
+		// non-copyable
+		BasicNetworkMessage(const BasicNetworkMessage&) = delete;
+		BasicNetworkMessage& operator=(const BasicNetworkMessage&) = delete;
 
 		void reset() {
 			info = {};
@@ -110,7 +116,7 @@ class NetworkMessage
 		}
 
 		bool setBufferPosition(MsgSize_t pos) {
-			if (pos < NETWORKMESSAGE_MAXSIZE - INITIAL_BUFFER_POSITION) {
+			if (pos < capacity - INITIAL_BUFFER_POSITION) {
 				info.position = pos + INITIAL_BUFFER_POSITION;
 				return true;
 			}
@@ -138,7 +144,18 @@ class NetworkMessage
 			return buffer + HEADER_LENGTH;
 		}
 
+		MsgSize_t getCapacity() const {
+			return capacity;
+		}
+
+		// longest body a protocol may write, leaving room for the headers and the xtea padding
+		MsgSize_t getMaxProtocolBodyLength() const {
+			return capacity - HEADER_LENGTH - XTEA_MULTIPLE - 8;
+		}
+
 	protected:
+		BasicNetworkMessage(uint8_t* buffer, MsgSize_t capacity) : buffer(buffer), capacity(capacity) {}
+
 		struct NetworkMessageInfo {
 			MsgSize_t length = 0;
 			MsgSize_t position = INITIAL_BUFFER_POSITION;
@@ -146,18 +163,65 @@ class NetworkMessage
 		};
 
 		NetworkMessageInfo info;
-		uint8_t buffer[NETWORKMESSAGE_MAXSIZE];
+		uint8_t* const buffer;
+		const MsgSize_t capacity;
+
+		friend class InboundMessage;
 
 	private:
 		bool canAdd(size_t size) const {
-			return (size + info.position) < MAX_BODY_LENGTH;
+			return (size + info.position) < static_cast<size_t>(capacity - HEADER_LENGTH - XTEA_MULTIPLE);
 		}
 
 		bool canRead(int32_t size) {
-			if ((info.position + size) > (info.length + 8) || size >= (NETWORKMESSAGE_MAXSIZE - info.position)) {
+			if ((info.position + size) > (info.length + 8) || size >= (capacity - info.position)) {
 				info.overrun = true;
 				return false;
 			}
 			return true;
 		}
 };
+
+// message with a buffer of the largest size, for reading packets and writing them before they are queued
+class NetworkMessage : public BasicNetworkMessage
+{
+	public:
+		NetworkMessage() : BasicNetworkMessage(storage, NETWORKMESSAGE_MAXSIZE) {}
+
+		NetworkMessage(const NetworkMessage& other) : NetworkMessage() {
+			*this = other;
+		}
+		NetworkMessage& operator=(const NetworkMessage& other) {
+			info = other.info;
+			std::copy_n(other.storage, NETWORKMESSAGE_MAXSIZE, storage);
+			return *this;
+		}
+
+	private:
+		uint8_t storage[NETWORKMESSAGE_MAXSIZE];
+};
+
+/*
+ * Received message handed over from a network thread to the dispatcher. Only the bytes that
+ * are left to read are kept, inline for the small packets and on the heap for the rest,
+ * instead of a whole NetworkMessage buffer. The objects are recycled through a free list.
+ */
+class InboundMessage
+{
+	public:
+		explicit InboundMessage(const NetworkMessage& msg);
+
+		// any thread
+		static InboundMessage_ptr make(const NetworkMessage& msg);
+
+		// msg continues reading from where the original message was
+		void restore(NetworkMessage& msg) const;
+
+	private:
+		static constexpr size_t INLINE_SIZE = 224;
+
+		NetworkMessage::NetworkMessageInfo info;
+		NetworkMessage::MsgSize_t size = 0;
+		std::array<uint8_t, INLINE_SIZE> inlineData;
+		std::vector<uint8_t> largeData;
+};
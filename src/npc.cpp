@@ -8,23 +8,26 @@
 #include "pugicast.h"
 #include "npcbehavior.h"
 #include "configmanager.h"
+#include "scheduler.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
 extern LuaEnvironment g_luaEnvironment;
 
-uint32_t Npc::npcAutoID = 0x80000000;
 NpcScriptInterface* Npc::scriptInterface = nullptr;
 
 void Npcs::reload()
 {
-	const std::map<uint32_t, Npc*>& npcs = g_game.getNpcs();
+	const CreatureTable<Npc>& npcs = g_game.getNpcs();
 
 	delete Npc::scriptInterface;
 	Npc::scriptInterface = nullptr;
 
-	for (const auto& it : npcs) {
-		it.second->reload();
+	// behaviour files are read again
+	NpcBehavior::clearPreloadedDatabases();
+
+	for (Npc* npc : npcs) {
+		npc->reload();
 	}
 }
 
@@ -44,17 +47,24 @@ Npc::Npc(const std::string& name) :
 	masterRadius(-1),
 	loaded(false)
 {
+	InstanceCounter<Npc>::onCreate();
 	reset();
 }
 
 Npc::~Npc()
 {
+	InstanceCounter<Npc>::onDestroy();
 	reset();
 	if (npcBehavior) {
 		delete npcBehavior;
 	}
 }
 
+void Npc::setID()
+{
+	id = g_game.reserveNpcId(id);
+}
+
 void Npc::addList()
 {
 	g_game.addNpc(this);
@@ -122,6 +132,9 @@ void Npc::reload()
 
 	const bool hasSpectators = !spectators.empty();
 	setIdle(!hasSpectators);
+	if (isIdle) {
+		Game::removeCreatureCheck(this);
+	}
 
 	// Simulate that the creature is placed on the map again.
 	if (npcEventHandler) {
@@ -412,17 +425,11 @@ void Npc::onThink(uint32_t interval)
 		npcEventHandler->onThink();
 	}
 
+	// the customer walking away is handled by onCreatureMove, the timeout by onConversationTimeout
 	if (npcBehavior && focusCreature) {
 		Player* player = g_game.getPlayerByID(focusCreature);
 		if (player) {
 			turnToCreature(player);
-
-			if (behaviorConversationTimeout != 0 && OTSYS_TIME() > behaviorConversationTimeout ||
-				!Position::areInRange<4, 3, 0>(player->getPosition(), getPosition())) {
-				if (player) {
-					npcBehavior->react(SITUATION_VANISH, player, "");
-				}
-			}
 		} else {
 			// In the rare circumstance that the focus creature was not found
 			npcBehavior->idle();
@@ -430,12 +437,61 @@ void Npc::onThink(uint32_t interval)
 	}
 }
 
+void Npc::onPlacedCreature()
+{
+	// dormant from the start while no player can see it
+	if (isIdle) {
+		Game::removeCreatureCheck(this);
+	}
+}
+
 void Npc::doSay(const std::string& text)
 {
-	behaviorConversationTimeout = OTSYS_TIME() + 60000;
+	extendConversation();
 	g_game.internalCreatureSay(this, TALKTYPE_SAY, text, false);
 }
 
+void Npc::extendConversation()
+{
+	behaviorConversationTimeout = OTSYS_TIME() + NPC_CONVERSATION_TIMEOUT;
+	if (conversationTimeoutEvent != 0) {
+		// the pending event moves itself to the new timeout
+		return;
+	}
+
+	scheduleConversationTimeout(NPC_CONVERSATION_TIMEOUT);
+}
+
+void Npc::scheduleConversationTimeout(uint32_t delay)
+{
+	conversationTimeoutEvent = g_scheduler.addEvent(createSchedulerTask(delay, [id = getID()]() {
+		if (Npc* npc = g_game.getNpcByID(id)) {
+			npc->onConversationTimeout();
+		}
+	}, "Npc::onConversationTimeout"));
+}
+
+void Npc::onConversationTimeout()
+{
+	conversationTimeoutEvent = 0;
+
+	const int64_t remaining = behaviorConversationTimeout - OTSYS_TIME();
+	if (remaining > 0) {
+		scheduleConversationTimeout(static_cast<uint32_t>(remaining));
+		return;
+	}
+
+	if (!npcBehavior || !focusCreature) {
+		return;
+	}
+
+	if (Player* player = g_game.getPlayerByID(focusCreature)) {
+		npcBehavior->react(SITUATION_VANISH, player, "");
+	} else {
+		npcBehavior->idle();
+	}
+}
+
 void Npc::setIdle(const bool idle)
 {
 	if (idle == isIdle) {
@@ -448,8 +504,12 @@ void Npc::setIdle(const bool idle)
 
 	isIdle = idle;
 
+	// dormant npcs neither think nor walk, the next player to see them wakes them up
 	if (isIdle) {
 		onIdleStatus();
+		Game::removeCreatureCheck(this);
+	} else {
+		g_game.addCreatureCheck(this);
 	}
 }
 
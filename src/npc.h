@@ -12,6 +12,9 @@ class Npc;
 class Player;
 class NpcBehavior;
 
+// a behavior conversation ends after this long without the npc saying anything
+static constexpr int32_t NPC_CONVERSATION_TIMEOUT = 60000;
+
 class Npcs
 {
 	public:
@@ -95,11 +98,7 @@ class Npc final : public Creature
 			return pushable && walkTicks != 0;
 		}
 
-		void setID() override {
-			if (id == 0) {
-				id = npcAutoID++;
-			}
-		}
+		void setID() override;
 
 		void removeList() override;
 		void addList() override;
@@ -143,9 +142,12 @@ class Npc final : public Creature
 		void turnToCreature(Creature* creature);
 		void setCreatureFocus(Creature* creature);
 
+		// pushes the end of the behavior conversation back to NPC_CONVERSATION_TIMEOUT from now
+		void extendConversation();
+
 		NpcScriptInterface* getScriptInterface();
 
-		static uint32_t npcAutoID;
+		static constexpr uint32_t ID_BASE = 0x80000000;
 	private:
 		explicit Npc(const std::string& name);
 
@@ -153,10 +155,19 @@ class Npc final : public Creature
 		void onRemoveCreature(Creature* creature, bool isLogout) override;
 		void onCreatureMove(Creature* creature, const Tile* newTile, const Position& newPos,
 		                            const Tile* oldTile, const Position& oldPos, bool teleport) override;
+		bool caresAboutMove(const Creature* creature) const override {
+			return Creature::caresAboutMove(creature) || creature->getPlayer();
+		}
 
 		void onCreatureSay(Creature* creature, SpeakClasses type, const std::string& text) override;
+		bool canHear() const override {
+			return true;
+		}
 		void onIdleStimulus() override;
 		void onThink(uint32_t interval) override;
+		void onPlacedCreature() override;
+		void scheduleConversationTimeout(uint32_t delay);
+		void onConversationTimeout();
 		std::string getDescription(int32_t lookDistance) const override;
 
 		bool isImmune(CombatType_t) const override {
@@ -193,6 +204,7 @@ class Npc final : public Creature
 		Position masterPos;
 
 		int64_t behaviorConversationTimeout = 0;
+		uint64_t conversationTimeoutEvent = 0;
 		uint32_t walkTicks;
 		int32_t focusCreature;
 		int32_t masterRadius;
@@ -7,12 +7,23 @@
 #include "npc.h"
 #include "player.h"
 #include "game.h"
+#include "jobpool.h"
 #include "spells.h"
 #include "monster.h"
+#include "configmanager.h"
+#include "fileloader.h"
+#include "filetasks.h"
+#include "tools.h"
+
+#include <boost/container_hash/hash.hpp>
+
+#include <filesystem>
+#include <queue>
 
 extern Game g_game;
 extern Monsters g_monsters;
 extern Spells* g_spells;
+extern ConfigManager g_config;
 
 NpcBehavior::NpcBehavior(Npc* _npc) : npc(_npc) 
 {
@@ -24,7 +35,595 @@ NpcBehavior::NpcBehavior(Npc* _npc) : npc(_npc)
 	talkDelay = 1000;
 }
 
+namespace {
+
+struct PreloadedDatabase
+{
+	std::list<NpcBehaviourPtr> behaviourEntries;
+	std::shared_ptr<const NpcKeywordMatcher> keywords;
+	bool loaded = false;
+};
+
+// the behaviours are never changed once parsed, so they can be shared by every NPC using the file
+std::mutex preloadedDatabasesLock;
+std::unordered_map<std::string, PreloadedDatabase> preloadedDatabases;
+
+size_t hashNode(const NpcBehaviourNodePtr& node)
+{
+	if (!node) {
+		return 0;
+	}
+
+	size_t seed = node->type;
+	boost::hash_combine(seed, node->number);
+	boost::hash_combine(seed, node->string);
+	boost::hash_combine(seed, hashNode(node->left));
+	boost::hash_combine(seed, hashNode(node->right));
+	return seed;
+}
+
+bool equalNodes(const NpcBehaviourNodePtr& left, const NpcBehaviourNodePtr& right)
+{
+	if (left == right) {
+		return true;
+	}
+
+	if (!left || !right) {
+		return false;
+	}
+
+	return left->type == right->type && left->number == right->number && left->string == right->string &&
+		equalNodes(left->left, right->left) && equalNodes(left->right, right->right);
+}
+
+struct ConditionHash
+{
+	size_t operator()(const NpcBehaviourConditionPtr& condition) const {
+		size_t seed = condition->type;
+		boost::hash_combine(seed, condition->situation);
+		boost::hash_combine(seed, condition->number);
+		boost::hash_combine(seed, condition->string);
+		boost::hash_combine(seed, hashNode(condition->expression));
+		return seed;
+	}
+};
+
+struct ConditionEqual
+{
+	bool operator()(const NpcBehaviourConditionPtr& left, const NpcBehaviourConditionPtr& right) const {
+		return left->type == right->type && left->situation == right->situation && left->number == right->number &&
+			left->string == right->string && equalNodes(left->expression, right->expression);
+	}
+};
+
+struct ActionHash
+{
+	size_t operator()(const NpcBehaviourActionPtr& action) const {
+		size_t seed = action->type;
+		boost::hash_combine(seed, action->number);
+		boost::hash_combine(seed, action->string);
+		boost::hash_combine(seed, hashNode(action->expression));
+		boost::hash_combine(seed, hashNode(action->expression2));
+		boost::hash_combine(seed, hashNode(action->expression3));
+		return seed;
+	}
+};
+
+struct ActionEqual
+{
+	bool operator()(const NpcBehaviourActionPtr& left, const NpcBehaviourActionPtr& right) const {
+		return left->type == right->type && left->number == right->number && left->string == right->string &&
+			equalNodes(left->expression, right->expression) && equalNodes(left->expression2, right->expression2) &&
+			equalNodes(left->expression3, right->expression3);
+	}
+};
+
+// conditions and actions are never changed once parsed, so equal ones are shared by every database,
+// most files include the same greeting, trade and travel blocks
+std::mutex sharedNodesLock;
+std::unordered_set<NpcBehaviourConditionPtr, ConditionHash, ConditionEqual> sharedConditions;
+std::unordered_set<NpcBehaviourActionPtr, ActionHash, ActionEqual> sharedActions;
+
+// <directory>/behaviours.cache: magic, version and the hash of the included files, then for every
+// behaviour file that loaded its name, the hash of its contents and its parsed behaviours
+// NPC_CACHE_VERSION must be raised whenever the members written below change
+constexpr uint32_t NPC_CACHE_MAGIC = 0x43425654; // TVBC
+constexpr uint16_t NPC_CACHE_VERSION = 1;
+
+const std::string NPC_CACHE_FILENAME = "behaviours.cache";
+
+// 0 for a file that cannot be read, no cached entry is ever written with it
+uint64_t hashFile(const std::string& filename)
+{
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(filename, ec);
+	if (ec) {
+		return 0;
+	}
+
+	// empty files cannot be mapped
+	if (size == 0) {
+		return hashBytes(nullptr, 0);
+	}
+
+	OTB::MappedFile file;
+	try {
+		file.open(filename);
+	} catch (const std::exception&) {
+		return 0;
+	}
+	return hashBytes(file.data(), file.size());
+}
+
+// the files pulled in with @"...", a change to any of them drops every cached behaviour
+uint64_t hashIncludes(const std::string& directory)
+{
+	std::vector<std::string> filenames;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+		const std::string filename = entry.path().filename().string();
+		if (entry.is_regular_file(ec) && entry.path().extension() != ".npc" && filename != NPC_CACHE_FILENAME) {
+			filenames.push_back(filename);
+		}
+	}
+	std::sort(filenames.begin(), filenames.end());
+
+	std::string index;
+	for (const std::string& filename : filenames) {
+		const uint64_t hash = hashFile(directory + filename);
+		index.append(filename);
+		index.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+	}
+	return hashBytes(index.data(), index.size());
+}
+
+void writeNode(PropWriteStream& stream, const NpcBehaviourNodePtr& node)
+{
+	stream.write<uint8_t>(node ? 1 : 0);
+	if (node) {
+		stream.write<NpcBehaviourType_t>(node->type);
+		stream.write<int32_t>(node->number);
+		stream.writeString(node->string);
+		writeNode(stream, node->left);
+		writeNode(stream, node->right);
+	}
+}
+
+bool readNode(PropStream& stream, NpcBehaviourNodePtr& node)
+{
+	uint8_t present;
+	if (!stream.read<uint8_t>(present)) {
+		return false;
+	}
+
+	if (present == 0) {
+		node = nullptr;
+		return true;
+	}
+
+	node = std::make_shared<NpcBehaviourNode>();
+	return stream.read<NpcBehaviourType_t>(node->type) && stream.read<int32_t>(node->number) && stream.readString(node->string) &&
+		readNode(stream, node->left) && readNode(stream, node->right);
+}
+
+void writeBehaviours(PropWriteStream& stream, const std::list<NpcBehaviourPtr>& behaviourEntries)
+{
+	stream.write<uint32_t>(behaviourEntries.size());
+	for (const NpcBehaviourPtr& behaviour : behaviourEntries) {
+		stream.write<NpcBehaviourSituation_t>(behaviour->situation);
+		stream.write<uint32_t>(behaviour->priority);
+
+		stream.write<uint32_t>(behaviour->conditions.size());
+		for (const NpcBehaviourConditionPtr& condition : behaviour->conditions) {
+			stream.write<NpcBehaviourType_t>(condition->type);
+			stream.write<NpcBehaviourSituation_t>(condition->situation);
+			stream.writeString(condition->string);
+			stream.write<int32_t>(condition->number);
+			writeNode(stream, condition->expression);
+		}
+
+		stream.write<uint32_t>(behaviour->actions.size());
+		for (const NpcBehaviourActionPtr& action : behaviour->actions) {
+			stream.write<NpcBehaviourType_t>(action->type);
+			stream.writeString(action->string);
+			stream.write<int32_t>(action->number);
+			writeNode(stream, action->expression);
+			writeNode(stream, action->expression2);
+			writeNode(stream, action->expression3);
+		}
+	}
+}
+
+bool readBehaviours(PropStream& stream, std::list<NpcBehaviourPtr>& behaviourEntries)
+{
+	uint32_t behaviourCount;
+	if (!stream.read<uint32_t>(behaviourCount)) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < behaviourCount; ++i) {
+		NpcBehaviourPtr behaviour = std::make_shared<NpcBehaviour>();
+		uint32_t conditionCount, actionCount;
+		if (!stream.read<NpcBehaviourSituation_t>(behaviour->situation) || !stream.read<uint32_t>(behaviour->priority) ||
+			!stream.read<uint32_t>(conditionCount)) {
+			return false;
+		}
+
+		for (uint32_t j = 0; j < conditionCount; ++j) {
+			NpcBehaviourConditionPtr condition = std::make_shared<NpcBehaviourCondition>();
+			if (!stream.read<NpcBehaviourType_t>(condition->type) || !stream.read<NpcBehaviourSituation_t>(condition->situation) ||
+				!stream.readString(condition->string) || !stream.read<int32_t>(condition->number) || !readNode(stream, condition->expression)) {
+				return false;
+			}
+			behaviour->conditions.push_back(std::move(condition));
+		}
+
+		if (!stream.read<uint32_t>(actionCount)) {
+			return false;
+		}
+
+		for (uint32_t j = 0; j < actionCount; ++j) {
+			NpcBehaviourActionPtr action = std::make_shared<NpcBehaviourAction>();
+			if (!stream.read<NpcBehaviourType_t>(action->type) || !stream.readString(action->string) || !stream.read<int32_t>(action->number) ||
+				!readNode(stream, action->expression) || !readNode(stream, action->expression2) || !readNode(stream, action->expression3)) {
+				return false;
+			}
+			behaviour->actions.push_back(std::move(action));
+		}
+
+		// written in their sorted order
+		behaviourEntries.push_back(std::move(behaviour));
+	}
+	return stream.size() == 0;
+}
+
+void writeCacheHeader(PropWriteStream& stream, uint64_t includesHash)
+{
+	stream.write<uint32_t>(NPC_CACHE_MAGIC);
+	stream.write<uint16_t>(NPC_CACHE_VERSION);
+	stream.write<uint64_t>(includesHash);
+}
+
+// the behaviour cache as mapped at startup, read from the loading threads
+class BehaviourCache
+{
+	public:
+		bool open(const std::string& filename, uint64_t includesHash) {
+			try {
+				file.open(filename);
+			} catch (const std::exception&) {
+				return false;
+			}
+
+			// the header is compared byte for byte, any change means the cache is stale
+			PropWriteStream header;
+			writeCacheHeader(header, includesHash);
+
+			size_t headerSize;
+			const char* headerBytes = header.getStream(headerSize);
+			if (file.size() < headerSize || memcmp(file.data(), headerBytes, headerSize) != 0) {
+				return false;
+			}
+
+			PropStream stream;
+			stream.init(file.data() + headerSize, file.size() - headerSize);
+
+			uint32_t entryCount;
+			if (!stream.read<uint32_t>(entryCount)) {
+				return false;
+			}
+
+			for (uint32_t i = 0; i < entryCount; ++i) {
+				std::string name;
+				Entry entry;
+				uint32_t size;
+				if (!stream.readString(name) || !stream.read<uint64_t>(entry.hash) || !stream.read<uint32_t>(size)) {
+					entries.clear();
+					return false;
+				}
+
+				entry.data = file.data() + (file.size() - stream.size());
+				entry.size = size;
+				if (!stream.skip(size)) {
+					entries.clear();
+					return false;
+				}
+				entries.emplace(std::move(name), entry);
+			}
+			return true;
+		}
+
+		// the behaviours of the file, while its contents still hash to the value they were written with
+		bool read(const std::string& filename, uint64_t hash, std::list<NpcBehaviourPtr>& behaviourEntries) const {
+			auto it = entries.find(filename);
+			if (it == entries.end() || it->second.hash != hash) {
+				return false;
+			}
+
+			PropStream stream;
+			stream.init(it->second.data, it->second.size);
+
+			std::list<NpcBehaviourPtr> cached;
+			if (!readBehaviours(stream, cached)) {
+				std::cout << "[Warning - NpcBehavior::preloadDatabases] The cached behaviours of " << filename << " are corrupted, the file is parsed." << std::endl;
+				return false;
+			}
+
+			behaviourEntries = std::move(cached);
+			return true;
+		}
+
+		size_t size() const {
+			return entries.size();
+		}
+
+		// the file is unmapped before it is written again
+		void close() {
+			entries.clear();
+			if (file.is_open()) {
+				file.close();
+			}
+		}
+
+	private:
+		struct Entry {
+			uint64_t hash;
+			const char* data;
+			size_t size;
+		};
+
+		OTB::MappedFile file;
+		std::unordered_map<std::string, Entry> entries;
+};
+
+}
+
+void NpcBehavior::preloadDatabases(const std::string& directory)
+{
+	const int64_t start = OTSYS_TIME();
+
+	std::vector<std::string> filenames;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+		if (entry.is_regular_file(ec) && entry.path().extension() == ".npc") {
+			filenames.push_back(directory + entry.path().filename().string());
+		}
+	}
+
+	// unchanged files skip the script reader, their behaviours are read back from the cache
+	const bool useCache = g_config.getBoolean(ConfigManager::NPC_BEHAVIOUR_CACHE);
+	const std::string cacheFilename = directory + NPC_CACHE_FILENAME;
+	const uint64_t includesHash = useCache ? hashIncludes(directory) : 0;
+
+	BehaviourCache cache;
+	if (useCache) {
+		cache.open(cacheFilename, includesHash);
+	}
+
+	std::vector<PreloadedDatabase> databases(filenames.size());
+	std::vector<uint64_t> hashes(filenames.size());
+	std::vector<uint8_t> parsed(filenames.size());
+	g_jobPool.parallelFor(filenames.size(), [&](size_t i) {
+		NpcBehavior behavior(nullptr);
+		if (useCache) {
+			hashes[i] = hashFile(filenames[i]);
+		}
+
+		if (hashes[i] != 0 && cache.read(filenames[i], hashes[i], behavior.behaviourEntries)) {
+			databases[i].loaded = true;
+		} else {
+			databases[i].loaded = behavior.parseDatabase(filenames[i]);
+			parsed[i] = 1;
+		}
+
+		behavior.shareNodes();
+		behavior.compileKeywords();
+		databases[i].behaviourEntries = std::move(behavior.behaviourEntries);
+		databases[i].keywords = std::move(behavior.keywords);
+	});
+
+	size_t cachedFiles = 0;
+	if (useCache) {
+		// rewritten once a file was parsed into it or one it holds is gone
+		bool changed = false;
+		uint32_t entryCount = 0;
+		PropWriteStream entries;
+		for (size_t i = 0; i < filenames.size(); ++i) {
+			if (!databases[i].loaded || hashes[i] == 0) {
+				continue;
+			}
+
+			PropWriteStream behaviours;
+			writeBehaviours(behaviours, databases[i].behaviourEntries);
+
+			size_t size;
+			const char* data = behaviours.getStream(size);
+			entries.writeString(filenames[i]);
+			entries.write<uint64_t>(hashes[i]);
+			entries.write<uint32_t>(size);
+			entries.writeBytes(data, size);
+
+			++entryCount;
+			changed = changed || parsed[i] != 0;
+			cachedFiles += parsed[i] == 0;
+		}
+
+		if (changed || entryCount != cache.size()) {
+			cache.close();
+
+			PropWriteStream propWriteStream;
+			writeCacheHeader(propWriteStream, includesHash);
+			propWriteStream.write<uint32_t>(entryCount);
+
+			size_t size;
+			const char* data = entries.getStream(size);
+			propWriteStream.writeBytes(data, size);
+
+			data = propWriteStream.getStream(size);
+			if (!FileTasks::writeFileContents(cacheFilename, data, size)) {
+				std::cout << "[Warning - NpcBehavior::preloadDatabases] Unable to write " << cacheFilename << std::endl;
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lockClass(preloadedDatabasesLock);
+	for (size_t i = 0; i < filenames.size(); ++i) {
+		preloadedDatabases[filenames[i]] = std::move(databases[i]);
+	}
+
+	std::cout << "> Npc behaviour loading time: " << (OTSYS_TIME() - start) / (1000.) << " seconds (" << filenames.size() << " files, " << cachedFiles << " cached)." << std::endl;
+}
+
+void NpcBehavior::clearPreloadedDatabases()
+{
+	{
+		std::lock_guard<std::mutex> lockClass(preloadedDatabasesLock);
+		preloadedDatabases.clear();
+	}
+
+	std::lock_guard<std::mutex> lockClass(sharedNodesLock);
+	sharedConditions.clear();
+	sharedActions.clear();
+}
+
 bool NpcBehavior::loadDatabase(const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lockClass(preloadedDatabasesLock);
+		auto it = preloadedDatabases.find(filename);
+		if (it != preloadedDatabases.end()) {
+			behaviourEntries = it->second.behaviourEntries;
+			keywords = it->second.keywords;
+			return it->second.loaded;
+		}
+	}
+
+	const bool loaded = parseDatabase(filename);
+	shareNodes();
+	compileKeywords();
+
+	// files read after a reload are shared with the next NPCs using them as well
+	std::lock_guard<std::mutex> lockClass(preloadedDatabasesLock);
+	preloadedDatabases.emplace(filename, PreloadedDatabase{behaviourEntries, keywords, loaded});
+	return loaded;
+}
+
+void NpcBehavior::shareNodes()
+{
+	std::lock_guard<std::mutex> lockClass(sharedNodesLock);
+	for (const NpcBehaviourPtr& behaviour : behaviourEntries) {
+		for (NpcBehaviourConditionPtr& condition : behaviour->conditions) {
+			condition = *sharedConditions.insert(condition).first;
+		}
+
+		for (NpcBehaviourActionPtr& action : behaviour->actions) {
+			action = *sharedActions.insert(action).first;
+		}
+	}
+}
+
+void NpcBehavior::compileKeywords()
+{
+	auto matcher = std::make_shared<NpcKeywordMatcher>();
+	for (const NpcBehaviourPtr& behaviour : behaviourEntries) {
+		behaviour->keywords.clear();
+		for (const NpcBehaviourConditionPtr& condition : behaviour->conditions) {
+			if (condition->type != BEHAVIOUR_TYPE_STRING) {
+				continue;
+			}
+
+			std::string_view keyword = condition->string;
+			if (!keyword.empty() && keyword.back() == '$') {
+				keyword.remove_suffix(1);
+			}
+
+			if (!keyword.empty()) {
+				behaviour->keywords.push_back(matcher->addKeyword(keyword));
+			}
+		}
+	}
+
+	matcher->build();
+	keywords = std::move(matcher);
+}
+
+uint32_t NpcKeywordMatcher::addKeyword(std::string_view keyword)
+{
+	uint32_t node = 0;
+	for (char c : keyword) {
+		uint32_t child = getChild(node, c);
+		if (child == 0) {
+			child = nodes.size();
+			auto& children = nodes[node].children;
+			children.insert(std::lower_bound(children.begin(), children.end(), std::make_pair(c, 0u)), {c, child});
+			nodes.emplace_back();
+		}
+		node = child;
+	}
+
+	if (nodes[node].keyword == -1) {
+		nodes[node].keyword = keywordCount++;
+		nodes[node].outputs.push_back(keywordCount - 1);
+	}
+	return static_cast<uint32_t>(nodes[node].keyword);
+}
+
+void NpcKeywordMatcher::build()
+{
+	// breadth first, so the failure node is always done before its dependants
+	std::queue<uint32_t> queue;
+	for (const auto& child : nodes[0].children) {
+		queue.push(child.second);
+	}
+
+	while (!queue.empty()) {
+		const uint32_t node = queue.front();
+		queue.pop();
+
+		for (const auto& [c, child] : nodes[node].children) {
+			uint32_t fail = nodes[node].fail;
+			while (fail != 0 && getChild(fail, c) == 0) {
+				fail = nodes[fail].fail;
+			}
+
+			nodes[child].fail = getChild(fail, c);
+
+			const auto& inherited = nodes[nodes[child].fail].outputs;
+			nodes[child].outputs.insert(nodes[child].outputs.end(), inherited.begin(), inherited.end());
+			queue.push(child);
+		}
+	}
+}
+
+void NpcKeywordMatcher::match(std::string_view message, std::vector<bool>& found) const
+{
+	found.assign(keywordCount, false);
+
+	uint32_t node = 0;
+	for (char c : message) {
+		while (node != 0 && getChild(node, c) == 0) {
+			node = nodes[node].fail;
+		}
+
+		node = getChild(node, c);
+		for (uint32_t keyword : nodes[node].outputs) {
+			found[keyword] = true;
+		}
+	}
+}
+
+uint32_t NpcKeywordMatcher::getChild(uint32_t node, char c) const
+{
+	// the root is never a child, so 0 means there is no transition
+	const auto& children = nodes[node].children;
+	auto it = std::lower_bound(children.begin(), children.end(), std::make_pair(c, 0u));
+	if (it == children.end() || it->first != c) {
+		return 0;
+	}
+	return it->second;
+}
+
+bool NpcBehavior::parseDatabase(const std::string& filename)
 {
 	ScriptReader script;
 	if (!script.loadScript(filename)) {
@@ -99,7 +698,7 @@ bool NpcBehavior::loadConditions(ScriptReader& script, const NpcBehaviourPtr& be
 
 		bool searchTerm = false;
 		if (script.getToken() == TOKEN_IDENTIFIER) {
-			std::string identifier = script.getIdentifier();
+			std::string identifier(script.getIdentifier());
 			if (identifier == "address") {
 				condition->situation = SITUATION_ADDRESS;
 				behaviour->situation = SITUATION_ADDRESS;
@@ -144,7 +743,7 @@ bool NpcBehavior::loadConditions(ScriptReader& script, const NpcBehaviourPtr& be
 				searchTerm = true;
 			}
 		} else if (script.getToken() == TOKEN_STRING) {
-			const std::string keyString = asLowerCaseString(script.getString());
+			const std::string keyString = asLowerCaseString(std::string(script.getString()));
 			condition->setCondition(BEHAVIOUR_TYPE_STRING, 0, keyString);
 
 			searchTerm = true;
@@ -237,7 +836,7 @@ bool NpcBehavior::loadActions(ScriptReader& script, const NpcBehaviourPtr& behav
 			action->type = BEHAVIOUR_TYPE_STRING;
 			action->string = script.getString();
 		} else if (script.getToken() == TOKEN_IDENTIFIER) {
-			std::string identifier = script.getIdentifier();
+			std::string identifier(script.getIdentifier());
 			if (identifier == "idle") {
 				action->type = BEHAVIOUR_TYPE_IDLE;
 			} else if (identifier == "nop") {
@@ -436,7 +1035,7 @@ NpcBehaviourNodePtr NpcBehavior::readValue(ScriptReader& script)
 	if (script.getToken() == TOKEN_STRING) {
 		NpcBehaviourNodePtr node = std::make_shared<NpcBehaviourNode>();
 		node->type = BEHAVIOUR_TYPE_STRING;
-		node->string = asLowerCaseString(script.getString());
+		node->string = asLowerCaseString(std::string(script.getString()));
 		script.nextToken();
 		return node;
 	}
@@ -457,7 +1056,7 @@ NpcBehaviourNodePtr NpcBehavior::readValue(ScriptReader& script)
 	NpcBehaviourNodePtr node = nullptr;
 	NpcBehaviourParameterSearch_t searchType = BEHAVIOUR_PARAMETER_NONE;
 
-	std::string identifier = script.getIdentifier();
+	std::string identifier(script.getIdentifier());
 	if (identifier == "topic") {
 		node = std::make_shared<NpcBehaviourNode>();
 		node->type = BEHAVIOUR_TYPE_TOPIC;
@@ -617,6 +1216,14 @@ void NpcBehavior::react(NpcBehaviourSituation_t situation, Player* player, const
 		return;
 	}
 
+	// conditions only look for keywords and numbers, so they all work on the lower case message
+	const std::string lowerMessage = asLowerCaseString(message);
+
+	std::vector<bool> foundKeywords;
+	if (keywords) {
+		keywords->match(lowerMessage, foundKeywords);
+	}
+
 	for (const NpcBehaviourPtr& behaviour : behaviourEntries) {
 		bool fulfilled = true;
 
@@ -636,7 +1243,12 @@ void NpcBehavior::react(NpcBehaviourSituation_t situation, Player* player, const
 			continue;
 		}
 
-		std::string messageCopy = message;
+		// every keyword has to appear somewhere in the message before searching them in order
+		if (!std::all_of(behaviour->keywords.begin(), behaviour->keywords.end(), [&](uint32_t keyword) { return foundKeywords[keyword]; })) {
+			continue;
+		}
+
+		std::string messageCopy = lowerMessage;
 		for (const NpcBehaviourConditionPtr& condition : behaviour->conditions) {
 			if (!checkCondition(condition, player, messageCopy)) {
 				fulfilled = false;
@@ -1222,36 +1834,36 @@ bool NpcBehavior::searchWord(const std::string& pattern, std::string& message)
 		wholeWord = true;
 	}
 
-	std::string newPattern = pattern.substr(0, len);
-	std::string actualMessage = asLowerCaseString(message);
+	// the message is already lower case, see react
+	const std::string_view newPattern(pattern.data(), len);
 
-	const size_t patternStart = actualMessage.find(newPattern);
+	const size_t patternStart = message.find(newPattern);
 	if (patternStart == std::string::npos) {
 		return false;
 	}
 
-	if (patternStart > 0 && !isspace(actualMessage[patternStart - 1])) {
+	if (patternStart > 0 && !isspace(message[patternStart - 1])) {
 		return false;
 	}
 
 	if (wholeWord) {
-		size_t wordPos = actualMessage.find(newPattern);
+		size_t wordPos = message.find(newPattern);
 		size_t wordEnd = wordPos + newPattern.length() - 1;
 
-		if (wordEnd + 1 > actualMessage.length()) {
+		if (wordEnd + 1 > message.length()) {
 			return false;
 		}
 
-		if (static_cast<int32_t>(wordPos - 1) >= 0 && !isspace(actualMessage[wordPos - 1])) {
+		if (static_cast<int32_t>(wordPos - 1) >= 0 && !isspace(message[wordPos - 1])) {
 			return false;
 		}
 
-		if (wordEnd + 1 == actualMessage.length()) {
+		if (wordEnd + 1 == message.length()) {
 			message = message.substr(wordEnd, message.length());
 			return true;
 		}
 
-		if (!isspace(actualMessage[wordEnd + 1])) {
+		if (!isspace(message[wordEnd + 1])) {
 			return false;
 		}
 	}
@@ -1289,7 +1901,7 @@ void NpcBehavior::attendCustomer(uint32_t playerId)
 	std::lock_guard<std::recursive_mutex> lock(mutex);
 
 	reset();
-	npc->behaviorConversationTimeout = OTSYS_TIME() + 60000;
+	npc->extendConversation();
 	npc->focusCreature = playerId;
 }
 
@@ -194,6 +194,9 @@ struct NpcBehaviour
 	std::vector<NpcBehaviourConditionPtr> conditions;
 	std::vector<NpcBehaviourActionPtr> actions;
 
+	// ids of the keywords of the string conditions in the keyword matcher of the database
+	std::vector<uint32_t> keywords;
+
 	NpcBehaviour() = default;
 	~NpcBehaviour() = default;
 
@@ -208,6 +211,32 @@ struct NpcQueueEntry
 	std::string text;
 };
 
+// Aho-Corasick automaton over every keyword of a behaviour database, one pass over
+// the lower case message tells which keywords appear anywhere in it
+class NpcKeywordMatcher
+{
+public:
+	// returns the id of the keyword, the same keyword always gets the same id
+	uint32_t addKeyword(std::string_view keyword);
+	// links the failure transitions, call it once every keyword has been added
+	void build();
+
+	void match(std::string_view message, std::vector<bool>& found) const;
+
+private:
+	struct Node {
+		std::vector<std::pair<char, uint32_t>> children; // sorted by character
+		std::vector<uint32_t> outputs;
+		uint32_t fail = 0;
+		int32_t keyword = -1;
+	};
+
+	uint32_t getChild(uint32_t node, char c) const;
+
+	std::vector<Node> nodes = std::vector<Node>(1);
+	uint32_t keywordCount = 0;
+};
+
 class NpcBehavior
 {
 public:
@@ -219,6 +248,10 @@ public:
 	NpcBehavior& operator=(const NpcBehavior&) = delete;
 
 	bool loadDatabase(const std::string& filename);
+
+	// parses every behaviour file of the folder on a few threads, NPCs created later share the results
+	static void preloadDatabases(const std::string& directory);
+	static void clearPreloadedDatabases();
 	bool loadBehaviour(ScriptReader& script);
 	bool loadConditions(ScriptReader& script, const NpcBehaviourPtr& behaviour);
 	bool loadActions(ScriptReader& script, const NpcBehaviourPtr& behaviour);
@@ -232,6 +265,9 @@ public:
 	}
 
 private:
+	bool parseDatabase(const std::string& filename);
+	void shareNodes();
+	void compileKeywords();
 
 	bool checkCondition(const NpcBehaviourConditionPtr& condition, Player* player, std::string& message);
 	void checkAction(const NpcBehaviourActionPtr& action, Player* player, std::string& message);
@@ -265,6 +301,7 @@ private:
 
 	std::list<NpcQueueEntry> queueList;
 	std::list<NpcBehaviourPtr> behaviourEntries;
+	std::shared_ptr<const NpcKeywordMatcher> keywords;
 	std::recursive_mutex mutex;
 
 	friend class Npc;
@@ -4,6 +4,8 @@
 #include "otpch.h"
 
 #include "server.h"
+#include "affinity.h"
+#include "arena.h"
 
 #include "game.h"
 
@@ -15,23 +17,34 @@
 #include "databasemanager.h"
 #include "scheduler.h"
 #include "databasetasks.h"
+#include "ban.h"
+#include "filecompression.h"
+#include "filetasks.h"
+#include "jobpool.h"
 #include "script.h"
+#include "scriptprofiler.h"
+#include "loadshedder.h"
+#include "logger.h"
+#include "trafficstats.h"
+#include "packetrecorder.h"
+#include "metrics.h"
+#include "worldsnapshot.h"
+#include "worldshards.h"
 #include "iomap.h"
+#include "npcbehavior.h"
 
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <fmt/format.h>
 #include <boost/algorithm/string.hpp>
 
-DatabaseTasks g_databaseTasks;
-Dispatcher g_dispatcher;
-Scheduler g_scheduler;
-
-Game g_game;
-ConfigManager g_config;
-Monsters g_monsters;
-Vocations g_vocations;
+extern Game g_game;
+extern ConfigManager g_config;
+extern Monsters g_monsters;
+extern Vocations g_vocations;
 extern Scripts* g_scripts;
+extern LuaEnvironment g_luaEnvironment;
 
 std::mutex g_loaderLock;
 std::condition_variable g_loaderSignal;
@@ -46,6 +59,55 @@ void startupErrorMessage(const std::string& errorStr)
 void mainLoader(int argc, char* argv[], ServiceManager* services);
 bool argumentsHandler(const StringVector& args);
 
+namespace {
+
+struct StartupPhaseTime {
+	std::string name;
+	int64_t start;
+	int64_t duration;
+};
+
+// phases run in parallel are recorded from their own threads
+std::mutex startupPhasesLock;
+std::vector<StartupPhaseTime> startupPhases;
+
+// times the scope it lives in, a phase that fails is recorded too
+class StartupPhase
+{
+	public:
+		StartupPhase(std::string name, int64_t bootStart) : name(std::move(name)), bootStart(bootStart), start(OTSYS_TIME()) {}
+		~StartupPhase() {
+			std::lock_guard<std::mutex> lockClass(startupPhasesLock);
+			startupPhases.push_back({std::move(name), start - bootStart, OTSYS_TIME() - start});
+		}
+
+		// non-copyable
+		StartupPhase(const StartupPhase&) = delete;
+		StartupPhase& operator=(const StartupPhase&) = delete;
+
+	private:
+		std::string name;
+		int64_t bootStart;
+		int64_t start;
+};
+
+void printStartupPhases(int64_t bootStart)
+{
+	std::lock_guard<std::mutex> lockClass(startupPhasesLock);
+	std::sort(startupPhases.begin(), startupPhases.end(), [](const StartupPhaseTime& lhs, const StartupPhaseTime& rhs) {
+		return lhs.start < rhs.start;
+	});
+
+	// overlapping phases ran in parallel, the total is the downtime of a restart
+	std::cout << fmt::format(">> Startup took {:.3f} seconds\n{:>9s} {:>9s}  phase", (OTSYS_TIME() - bootStart) / 1000., "start", "seconds") << std::endl;
+	for (const StartupPhaseTime& phase : startupPhases) {
+		std::cout << fmt::format("{:>9.3f} {:>9.3f}  {:s}", phase.start / 1000., phase.duration / 1000., phase.name) << std::endl;
+	}
+	startupPhases.clear();
+}
+
+}
+
 [[noreturn]] void badAllocationHandler()
 {
 	// Use functions that only use stack allocation
@@ -68,6 +130,8 @@ int main(int argc, char* argv[])
 
 	g_dispatcher.start();
 	g_scheduler.start();
+	g_fileTasks.start();
+	g_logger.start();
 
 	g_dispatcher.addTask(createTask(std::bind(mainLoader, argc, argv, &serviceManager)));
 
@@ -76,16 +140,34 @@ int main(int argc, char* argv[])
 	if (serviceManager.is_running()) {
 		std::cout << ">> " << g_config.getString(ConfigManager::SERVER_NAME) << " Server Online!" << std::endl << std::endl;
 		serviceManager.run();
+	} else if (g_packetRecorder.isReplayMode() && g_game.getGameState() == GAME_STATE_NORMAL) {
+		// the game shuts down once the record is replayed
+		g_packetRecorder.runReplay();
 	} else {
 		std::cout << ">> No services running. The server is NOT online." << std::endl;
 		g_scheduler.shutdown();
 		g_databaseTasks.shutdown();
+		g_fileTasks.shutdown();
+		g_jobPool.shutdown();
 		g_dispatcher.shutdown();
 	}
 
+	tfs::rsa::stopWorkers();
 	g_scheduler.join();
 	g_databaseTasks.join();
+	g_fileTasks.join();
+	g_jobPool.join();
 	g_dispatcher.join();
+	g_metrics.join();
+	g_logger.shutdown();
+
+	if (g_config.getBoolean(ConfigManager::FAST_SHUTDOWN)) {
+		// everything is saved and no thread is left, the system takes the world back faster than its destructors
+		Database::getInstance().disconnect();
+		std::cout << std::flush;
+		std::fflush(nullptr);
+		std::_Exit(EXIT_SUCCESS);
+	}
 	return 0;
 }
 
@@ -159,11 +241,41 @@ void mainLoader(int, char*[], ServiceManager* services)
 		c_test.close();
 	}
 
+	const int64_t bootStart = OTSYS_TIME();
+
 	// read global config
 	std::cout << ">> Loading config" << std::endl;
-	if (!g_config.load()) {
-		startupErrorMessage("Unable to load " + configFile + "!");
-		return;
+	{
+		StartupPhase phase("config", bootStart);
+		if (!g_config.load()) {
+			startupErrorMessage("Unable to load " + configFile + "!");
+			return;
+		}
+
+		g_dispatcher.loadConfig();
+		g_dispatcher.addIdleHandler([]() { return g_luaEnvironment.stepGarbageCollector(); });
+		g_luaEnvironment.loadGarbageCollectorConfig();
+		g_loadShedder.loadConfig();
+		g_scriptProfiler.loadConfig();
+		g_trafficStats.loadConfig();
+		filecompression::loadDictionaries();
+
+		// before the map and the items are allocated from the arena, on the dispatcher's node
+		if (!affinity::load()) {
+			startupErrorMessage("Invalid threadAffinity in " + configFile + "!");
+			return;
+		}
+		g_dispatcher.setAffinity("dispatcher");
+		g_scheduler.setAffinity("scheduler");
+		g_fileTasks.setAffinity("files");
+		g_logger.setAffinity("logger");
+		arena::load();
+
+		// before anything in the world draws a random number
+		if (!g_packetRecorder.start()) {
+			startupErrorMessage("Unable to start the packet recorder!");
+			return;
+		}
 	}
 
 #ifdef _WIN32
@@ -176,89 +288,145 @@ void mainLoader(int, char*[], ServiceManager* services)
 #endif
 
 	//set RSA key
-	try {
-		std::ifstream key{"key.pem"};
-		std::string pem{std::istreambuf_iterator<char>{key}, std::istreambuf_iterator<char>{}};
-		tfs::rsa::loadPEM(pem);
-	} catch(const std::exception& e) {
-		startupErrorMessage(e.what());
-		return;
+	{
+		StartupPhase phase("rsa key", bootStart);
+		try {
+			std::ifstream key{"key.pem"};
+			std::string pem{std::istreambuf_iterator<char>{key}, std::istreambuf_iterator<char>{}};
+			tfs::rsa::loadPEM(pem);
+		} catch(const std::exception& e) {
+			startupErrorMessage(e.what());
+			return;
+		}
+		tfs::rsa::startWorkers(g_config.getNumber(ConfigManager::RSA_THREADS));
 	}
 
-	std::cout << ">> Establishing database connection..." << std::flush;
-
-	if (!Database::getInstance().connect()) {
-		startupErrorMessage("Failed to connect to database.");
-		return;
-	}
+	// the caller of a parallel loop runs a share of it, so one core is left to it
+	const int32_t jobThreads = g_config.getNumber(ConfigManager::JOB_THREADS);
+	g_jobPool.setWorkers(jobThreads >= 0 ? jobThreads : std::max<int32_t>(1, std::thread::hardware_concurrency()) - 1);
+	g_jobPool.start();
+
+	// the database does not need anything of the world, it is connected and migrated while the vocations and items load
+	std::cout << ">> Establishing database connection" << std::endl;
+	auto databaseLoad = std::async(std::launch::async, [bootStart]() -> std::string {
+		StartupPhase phase("database", bootStart);
+		if (!Database::getInstance().connect(g_config.getNumber(ConfigManager::SQL_CONNECTIONS))) {
+			return "Failed to connect to database.";
+		}
 
-	std::cout << " MySQL " << Database::getClientVersion() << std::endl;
+		if (!DatabaseManager::isDatabaseSetup()) {
+			return "The database you have specified in config.lua is empty, please import the schema.sql to your database.";
+		}
 
-	// run database manager
-	std::cout << ">> Running database manager" << std::endl;
+		DatabaseManager::updateDatabase();
 
-	if (!DatabaseManager::isDatabaseSetup()) {
-		startupErrorMessage("The database you have specified in config.lua is empty, please import the schema.sql to your database.");
-		return;
-	}
-	g_databaseTasks.start();
-
-	DatabaseManager::updateDatabase();
+		if (g_config.getBoolean(ConfigManager::OPTIMIZE_DATABASE) && !DatabaseManager::optimizeTables()) {
+			std::cout << "> No tables were optimized." << std::endl;
+		}
 
-	if (g_config.getBoolean(ConfigManager::OPTIMIZE_DATABASE) && !DatabaseManager::optimizeTables()) {
-		std::cout << "> No tables were optimized." << std::endl;
-	}
+		if (!IOBan::loadBans()) {
+			return "Failed to load the bans.";
+		}
+		return {};
+	});
 
 	//load vocations
 	std::cout << ">> Loading vocations" << std::endl;
-	if (!g_vocations.loadFromXml()) {
-		startupErrorMessage("Unable to load vocations!");
-		return;
+	{
+		StartupPhase phase("vocations", bootStart);
+		if (!g_vocations.loadFromXml()) {
+			startupErrorMessage("Unable to load vocations!");
+			return;
+		}
 	}
 
 	// load item data
 	std::cout << ">> Loading items" << std::endl;
-	if (!Item::items.loadFromOtb("data/items/items.otb")) {
-		startupErrorMessage("Unable to load items (OTB)!");
-		return;
+	{
+		StartupPhase phase("items", bootStart);
+		if (!Item::items.loadFromCache()) {
+			if (!Item::items.loadFromOtb("data/items/items.otb")) {
+				startupErrorMessage("Unable to load items (OTB)!");
+				return;
+			}
+
+			if (!Item::items.loadFromXml()) {
+				startupErrorMessage("Unable to load items (XML)!");
+				return;
+			}
+
+			Item::items.saveToCache();
+		}
 	}
 
-	if (!Item::items.loadFromXml()) {
-		startupErrorMessage("Unable to load items (XML)!");
+	// scripts may query the database as they load
+	if (const std::string error = databaseLoad.get(); !error.empty()) {
+		startupErrorMessage(error);
 		return;
 	}
+	std::cout << ">> Connected to MySQL " << Database::getClientVersion() << std::endl;
+	g_databaseTasks.start();
+	g_databaseTasks.setAffinity("database");
+	IOBan::scheduleReload();
 
 	std::cout << ">> Loading script systems" << std::endl;
-	if (!ScriptingManager::getInstance().loadScriptSystems()) {
-		startupErrorMessage("Failed to load script systems");
-		return;
+	{
+		StartupPhase phase("script systems", bootStart);
+		if (!ScriptingManager::getInstance().loadScriptSystems()) {
+			startupErrorMessage("Failed to load script systems");
+			return;
+		}
 	}
 
 	std::cout << ">> Loading lua scripts" << std::endl;
-	if (!g_scripts->loadScripts("scripts", false, false)) {
-		startupErrorMessage("Failed to load lua scripts");
-		return;
+	{
+		StartupPhase phase("lua scripts", bootStart);
+		if (!g_scripts->loadScripts("scripts", false, false)) {
+			startupErrorMessage("Failed to load lua scripts");
+			return;
+		}
 	}
 
+	// the map creates its items from the item types the scripts adjusted (charges, durations, decay targets), the rest of
+	// the loading does not touch the map until the spawns, which need the monsters and npcs
+	std::cout << ">> Loading map" << std::endl;
+	auto mapLoad = std::async(std::launch::async, [bootStart]() {
+		StartupPhase phase("map", bootStart);
+		return g_game.loadMainMap(g_config.getString(ConfigManager::MAP_NAME));
+	});
+
 	std::cout << ">> Loading monsters" << std::endl;
-	if (!g_monsters.loadFromXml()) {
-		startupErrorMessage("Unable to load monsters!");
-		return;
+	{
+		StartupPhase phase("monsters", bootStart);
+		if (!g_monsters.loadFromXml()) {
+			startupErrorMessage("Unable to load monsters!");
+			return;
+		}
 	}
 
 	std::cout << ">> Loading lua monsters" << std::endl;
-	if (!g_scripts->loadScripts("monster", false, false)) {
-		startupErrorMessage("Failed to load lua monsters");
-		return;
+	{
+		StartupPhase phase("lua monsters", bootStart);
+		if (!g_scripts->loadScripts("monster", false, false)) {
+			startupErrorMessage("Failed to load lua monsters");
+			return;
+		}
 	}
 
 	std::cout << ">> Loading outfits" << std::endl;
-	if (!Outfits::getInstance().loadFromXml()) {
-		startupErrorMessage("Unable to load outfits!");
+	{
+		StartupPhase phase("outfits", bootStart);
+		if (!Outfits::getInstance().loadFromXml()) {
+			startupErrorMessage("Unable to load outfits!");
+			return;
+		}
+	}
+
+	if (!g_worldShards.load()) {
+		startupErrorMessage("Unable to load shards!");
 		return;
 	}
 
-	std::cout << ">> Checking world type... " << std::flush;
 	std::string worldType = boost::algorithm::to_lower_copy(g_config.getString(ConfigManager::WORLD_TYPE));
 	if (worldType == "pvp") {
 		g_game.setWorldType(WORLD_TYPE_PVP);
@@ -267,29 +435,42 @@ void mainLoader(int, char*[], ServiceManager* services)
 	} else if (worldType == "pvp-enforced") {
 		g_game.setWorldType(WORLD_TYPE_PVP_ENFORCED);
 	} else {
-		std::cout << std::endl;
 		startupErrorMessage(
 		    fmt::format("Unknown world type: {:s}, valid world types are: pvp, no-pvp and pvp-enforced.",
 		                g_config.getString(ConfigManager::WORLD_TYPE)));
 		return;
 	}
-	std::cout << boost::algorithm::to_upper_copy(worldType) << std::endl;
+	std::cout << ">> World type: " << boost::algorithm::to_upper_copy(worldType) << std::endl;
 
-	std::cout << ">> Loading map" << std::endl;
-	if (!g_game.loadMainMap(g_config.getString(ConfigManager::MAP_NAME))) {
+	std::cout << ">> Loading npc behaviours" << std::endl;
+	{
+		StartupPhase phase("npc behaviours", bootStart);
+		NpcBehavior::preloadDatabases("data/npc/behavior/");
+	}
+
+	if (!mapLoad.get()) {
 		startupErrorMessage("Failed to load map");
 		return;
 	}
 
+	std::cout << ">> Loading spawns" << std::endl;
+	{
+		StartupPhase phase("spawns", bootStart);
+		g_game.loadMainMapSpawns();
+	}
+
 	std::cout << ">> Initializing gamestate" << std::endl;
 	g_game.setGameState(GAME_STATE_INIT);
 
-	// Game client protocols
-	services->add<ProtocolGame>(static_cast<uint16_t>(g_config.getNumber(ConfigManager::GAME_PORT)));
-	services->add<ProtocolLogin>(static_cast<uint16_t>(g_config.getNumber(ConfigManager::LOGIN_PORT)));
+	// a replay runs offline, its players come from the record
+	if (!g_packetRecorder.isReplayMode()) {
+		// Game client protocols
+		services->add<ProtocolGame>(static_cast<uint16_t>(g_config.getNumber(ConfigManager::GAME_PORT)));
+		services->add<ProtocolLogin>(static_cast<uint16_t>(g_config.getNumber(ConfigManager::LOGIN_PORT)));
 
-	// OT protocols
-	services->add<ProtocolStatus>(static_cast<uint16_t>(g_config.getNumber(ConfigManager::STATUS_PORT)));
+		// OT protocols
+		services->add<ProtocolStatus>(static_cast<uint16_t>(g_config.getNumber(ConfigManager::STATUS_PORT)));
+	}
 
 	RentPeriod_t rentPeriod;
 	std::string strRentPeriod = boost::algorithm::to_lower_copy(g_config.getString(ConfigManager::HOUSE_RENT_PERIOD));
@@ -306,7 +487,10 @@ void mainLoader(int, char*[], ServiceManager* services)
 		rentPeriod = RENTPERIOD_NEVER;
 	}
 
-	g_game.map.houses.payHouses(rentPeriod);
+	{
+		StartupPhase phase("house rent", bootStart);
+		g_game.map.houses.payHouses(rentPeriod);
+	}
 
 	std::cout << ">> Loaded all modules, server starting up..." << std::endl;
 
@@ -317,7 +501,16 @@ void mainLoader(int, char*[], ServiceManager* services)
 	}
 #endif
 
-	g_game.start(services);
+	{
+		StartupPhase phase("game start", bootStart);
+		g_game.start(services);
+		g_metrics.start();
+		g_metrics.setAffinity("metrics");
+		g_worldSnapshot.start();
+		ProtocolStatus::updateCache();
+	}
+
+	printStartupPhases(bootStart);
 	g_game.setGameState(GAME_STATE_NORMAL);
 	g_loaderSignal.notify_all();
 }
@@ -332,7 +525,10 @@ bool argumentsHandler(const StringVector& args)
 			"\t--ip=$1\t\t\tIP address of the server.\n"
 			"\t\t\t\tShould be equal to the global IP.\n"
 			"\t--login-port=$1\tPort for login server to listen on.\n"
-			"\t--game-port=$1\tPort for game server to listen on.\n";
+			"\t--game-port=$1\tPort for game server to listen on.\n"
+			"\t--record=$1\t\tRecord the game packets to a file.\n"
+			"\t--replay=$1\t\tReplay a packet record offline, on a copy\n"
+			"\t\t\t\tof the data it was recorded with.\n";
 			return false;
 		} else if (arg == "--version") {
 			printServerVersion();
@@ -349,6 +545,10 @@ bool argumentsHandler(const StringVector& args)
 			g_config.setNumber(ConfigManager::LOGIN_PORT, std::stoi(tmp[1]));
 		else if (tmp[0] == "--game-port")
 			g_config.setNumber(ConfigManager::GAME_PORT, std::stoi(tmp[1]));
+		else if (tmp[0] == "--record")
+			g_packetRecorder.setRecordFile(tmp[1]);
+		else if (tmp[0] == "--replay")
+			g_packetRecorder.setReplayFile(tmp[1]);
 	}
 
 	return true;
@@ -47,26 +47,33 @@ bool Outfits::loadFromXml()
 			outfitNode.attribute("unlocked").as_bool(true)
 		);
 	}
+
+	for (uint8_t sex = PLAYERSEX_FEMALE; sex <= PLAYERSEX_LAST; ++sex) {
+		std::vector<const Outfit*>& index = outfitsByLookType[sex];
+		for (const Outfit& outfit : outfits[sex]) {
+			if (outfit.lookType >= index.size()) {
+				index.resize(outfit.lookType + 1);
+			}
+
+			if (!index[outfit.lookType]) {
+				index[outfit.lookType] = &outfit;
+			}
+		}
+	}
 	return true;
 }
 
 const Outfit* Outfits::getOutfitByLookType(PlayerSex_t sex, uint16_t lookType) const
 {
-	for (const Outfit& outfit : outfits[sex]) {
-		if (outfit.lookType == lookType) {
-			return &outfit;
-		}
-	}
-	return nullptr;
+	const std::vector<const Outfit*>& index = outfitsByLookType[sex];
+	return lookType < index.size() ? index[lookType] : nullptr;
 }
 
 const Outfit* Outfits::getOutfitByLookType(uint16_t lookType) const
 {
 	for (uint8_t sex = PLAYERSEX_FEMALE; sex <= PLAYERSEX_LAST; sex++) {
-		for (const Outfit& outfit : outfits[sex]) {
-			if (outfit.lookType == lookType) {
-				return &outfit;
-			}
+		if (const Outfit* outfit = getOutfitByLookType(static_cast<PlayerSex_t>(sex), lookType)) {
+			return outfit;
 		}
 	}
 	return nullptr;
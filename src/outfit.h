@@ -46,4 +46,6 @@ class Outfits
 
 	private:
 		std::vector<Outfit> outfits[PLAYERSEX_LAST + 1];
+		// by look type, built once the outfits are loaded
+		std::vector<const Outfit*> outfitsByLookType[PLAYERSEX_LAST + 1];
 };
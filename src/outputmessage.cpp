@@ -5,58 +5,66 @@
 
 #include "outputmessage.h"
 #include "protocol.h"
-#include "scheduler.h"
-
-extern Scheduler g_scheduler;
+#include "lockfree.h"
 
 namespace {
 
-const std::chrono::milliseconds OUTPUTMESSAGE_AUTOSEND_DELAY {10};
-
-void sendAll(const std::vector<Protocol_ptr>& bufferedProtocols);
+const uint16_t OUTPUTMESSAGE_FREE_LIST_CAPACITY = 2048;
 
-void scheduleSendAll(const std::vector<Protocol_ptr>& bufferedProtocols)
+template <NetworkMessage::MsgSize_t CAPACITY>
+class SizedOutputMessage final : public OutputMessage
 {
-	g_scheduler.addEvent(createSchedulerTask(OUTPUTMESSAGE_AUTOSEND_DELAY.count(), [&]() { sendAll(bufferedProtocols); }));
-}
+	public:
+		SizedOutputMessage() : OutputMessage(storage, CAPACITY) {}
 
-void sendAll(const std::vector<Protocol_ptr>& bufferedProtocols)
-{
-	//dispatcher thread
-	for (auto& protocol : bufferedProtocols) {
-		auto& msg = protocol->getCurrentBuffer();
-		if (msg) {
-			protocol->send(std::move(msg));
-		}
-	}
+	private:
+		uint8_t storage[CAPACITY];
+};
 
-	if (!bufferedProtocols.empty()) {
-		scheduleSendAll(bufferedProtocols);
-	}
+// each size class has a free list of its own
+template <NetworkMessage::MsgSize_t CAPACITY>
+OutputMessage_ptr allocateOutputMessage()
+{
+	using Allocator = LockfreePoolingAllocator<void, SizedOutputMessage<CAPACITY>, OUTPUTMESSAGE_FREE_LIST_CAPACITY>;
+	return std::allocate_shared<SizedOutputMessage<CAPACITY>>(Allocator());
 }
 
 }
 
-void OutputMessagePool::addProtocolToAutosend(Protocol_ptr protocol)
+void OutputMessagePool::addDirtyProtocol(Protocol_ptr protocol)
 {
 	//dispatcher thread
-	if (bufferedProtocols.empty()) {
-		scheduleSendAll(bufferedProtocols);
+	dirtyProtocols.emplace_back(std::move(protocol));
+}
+
+void OutputMessagePool::sendAll()
+{
+	//dispatcher thread, the protocols dirtied while flushing are sent by the next call
+	flushingProtocols.swap(dirtyProtocols);
+	for (auto& protocol : flushingProtocols) {
+		protocol->onFlush();
+		protocol->flushOutputBuffer();
 	}
-	bufferedProtocols.emplace_back(protocol);
+	flushingProtocols.clear();
 }
 
-void OutputMessagePool::removeProtocolFromAutosend(const Protocol_ptr& protocol)
+OutputMessage_ptr OutputMessagePool::getOutputMessage(size_t bodyLength/* = NetworkMessage::MAX_PROTOCOL_BODY_LENGTH*/)
 {
-	//dispatcher thread
-	auto it = std::find(bufferedProtocols.begin(), bufferedProtocols.end(), protocol);
-	if (it != bufferedProtocols.end()) {
-		std::swap(*it, bufferedProtocols.back());
-		bufferedProtocols.pop_back();
+	//any thread, buffers are returned to the free list by whichever thread drops the last reference
+	if (bodyLength <= getMaxBodyLength(SMALL_CAPACITY)) {
+		return allocateOutputMessage<SMALL_CAPACITY>();
+	} else if (bodyLength <= getMaxBodyLength(MEDIUM_CAPACITY)) {
+		return allocateOutputMessage<MEDIUM_CAPACITY>();
 	}
+	return allocateOutputMessage<FULL_CAPACITY>();
 }
 
-OutputMessage_ptr OutputMessagePool::getOutputMessage()
+LockfreePoolStats OutputMessagePool::getPoolStats(size_t capacity)
 {
-	return std::make_shared<OutputMessage>();
+	if (capacity <= SMALL_CAPACITY) {
+		return LockfreePoolCounters<SizedOutputMessage<SMALL_CAPACITY>>::get().getStats();
+	} else if (capacity <= MEDIUM_CAPACITY) {
+		return LockfreePoolCounters<SizedOutputMessage<MEDIUM_CAPACITY>>::get().getStats();
+	}
+	return LockfreePoolCounters<SizedOutputMessage<FULL_CAPACITY>>::get().getStats();
 }
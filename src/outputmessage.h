@@ -8,19 +8,18 @@
 #include "tools.h"
 
 class Protocol;
+struct LockfreePoolStats;
 
-class OutputMessage : public NetworkMessage
+// queued message, the pool hands out buffers of the size class that fits what the sender writes
+class OutputMessage : public BasicNetworkMessage
 {
 	public:
-		OutputMessage() = default;
-
-		// non-copyable
-		OutputMessage(const OutputMessage&) = delete;
-		OutputMessage& operator=(const OutputMessage&) = delete;
-
 		uint8_t* getOutputBuffer() {
 			return buffer + outputBufferStart;
 		}
+		const uint8_t* getOutputBuffer() const {
+			return buffer + outputBufferStart;
+		}
 
 		void writeMessageLength() {
 			add_header(info.length);
@@ -37,6 +36,12 @@ class OutputMessage : public NetworkMessage
 			info.position += msgLen;
 		}
 
+		void append(const uint8_t* bytes, MsgSize_t length) {
+			memcpy(buffer + info.position, bytes, length);
+			info.length += length;
+			info.position += length;
+		}
+
 		void append(const OutputMessage_ptr& msg) {
 			auto msgLen = msg->getLength();
 			memcpy(buffer + info.position, msg->getBuffer() + 4, msgLen);
@@ -44,6 +49,13 @@ class OutputMessage : public NetworkMessage
 			info.position += msgLen;
 		}
 
+		bool canAppend(size_t size) const {
+			return info.length + size <= getMaxProtocolBodyLength();
+		}
+
+	protected:
+		OutputMessage(uint8_t* buffer, MsgSize_t capacity) : BasicNetworkMessage(buffer, capacity) {}
+
 	private:
 		template <typename T>
 		void add_header(T add) {
@@ -69,13 +81,26 @@ class OutputMessagePool
 			return instance;
 		}
 
-		static OutputMessage_ptr getOutputMessage();
+		// the buffer fits at least bodyLength bytes, the largest one by default
+		static OutputMessage_ptr getOutputMessage(size_t bodyLength = NetworkMessage::MAX_PROTOCOL_BODY_LENGTH);
+		static LockfreePoolStats getPoolStats(size_t capacity);
+
+		// buffer sizes, output buffers that outgrow the medium one are chained instead of grown
+		static constexpr NetworkMessage::MsgSize_t SMALL_CAPACITY = 256;
+		static constexpr NetworkMessage::MsgSize_t MEDIUM_CAPACITY = 4096;
+		static constexpr NetworkMessage::MsgSize_t FULL_CAPACITY = NETWORKMESSAGE_MAXSIZE;
+
+		static constexpr size_t getMaxBodyLength(size_t capacity) {
+			return capacity - NetworkMessage::HEADER_LENGTH - NetworkMessage::XTEA_MULTIPLE - 8;
+		}
 
-		void addProtocolToAutosend(Protocol_ptr protocol);
-		void removeProtocolFromAutosend(const Protocol_ptr& protocol);
+		// registers a protocol whose autosend buffer has been written during the current dispatcher cycle
+		void addDirtyProtocol(Protocol_ptr protocol);
+		// sends the autosend buffer of every dirty protocol, called by the dispatcher after each batch of tasks
+		void sendAll();
 	private:
 		OutputMessagePool() = default;
-		//NOTE: A vector is used here because this container is mostly read
-		//and relatively rarely modified (only when a client connects/disconnects)
-		std::vector<Protocol_ptr> bufferedProtocols;
+		std::vector<Protocol_ptr> dirtyProtocols;
+		// the protocols sendAll is flushing, a flush may dirty a protocol again
+		std::vector<Protocol_ptr> flushingProtocols;
 };
@@ -0,0 +1,120 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "packetlimiter.h"
+
+namespace {
+
+struct PacketRule {
+	PacketLimiter::PacketKind kind = PacketLimiter::PACKET_KIND_OTHER;
+	// bytes after the opcode the parse method reads at least, a string counts its length only
+	uint8_t minLength = 0;
+};
+
+struct KindRate {
+	// packets a second
+	int64_t rate;
+	int64_t burst;
+};
+
+// by packet kind, a client walking with the arrow keys held sends about ten packets a second
+constexpr std::array<KindRate, PacketLimiter::PACKET_KIND_LAST + 1> kindRates = {{
+	{0, 0},
+	{25, 50},
+	{5, 15},
+	{10, 30},
+	{20, 40},
+	{30, 60},
+}};
+
+constexpr std::array<PacketRule, 256> makePacketRules()
+{
+	constexpr auto FREE = PacketLimiter::PACKET_KIND_FREE;
+	constexpr auto WALK = PacketLimiter::PACKET_KIND_WALK;
+	constexpr auto SAY = PacketLimiter::PACKET_KIND_SAY;
+	constexpr auto LOOK = PacketLimiter::PACKET_KIND_LOOK;
+	constexpr auto ITEM = PacketLimiter::PACKET_KIND_ITEM;
+	constexpr auto OTHER = PacketLimiter::PACKET_KIND_OTHER;
+
+	std::array<PacketRule, 256> rules{};
+
+	// leaving while dead, logout, ping and ping back
+	rules[0x0F] = {FREE, 0};
+	rules[0x14] = {FREE, 0};
+	rules[0x1D] = {FREE, 0};
+	rules[0x1E] = {FREE, 0};
+
+	rules[0x32] = {OTHER, 3};
+	rules[0x64] = {WALK, 2};
+	for (uint8_t opcode = 0x65; opcode <= 0x72; ++opcode) {
+		rules[opcode] = {WALK, 0};
+	}
+	rules[0x78] = {ITEM, 14};
+	rules[0x7D] = {ITEM, 12};
+	rules[0x7E] = {LOOK, 2};
+	rules[0x82] = {ITEM, 9};
+	rules[0x83] = {ITEM, 16};
+	rules[0x84] = {ITEM, 12};
+	rules[0x85] = {ITEM, 8};
+	rules[0x87] = {OTHER, 1};
+	rules[0x88] = {OTHER, 1};
+	rules[0x89] = {OTHER, 6};
+	rules[0x8A] = {OTHER, 7};
+	rules[0x8C] = {LOOK, 8};
+	rules[0x8D] = {LOOK, 4};
+	rules[0x96] = {SAY, 3};
+	rules[0x98] = {OTHER, 2};
+	rules[0x99] = {OTHER, 2};
+	rules[0x9A] = {OTHER, 2};
+	rules[0x9B] = {OTHER, 2};
+	rules[0x9C] = {OTHER, 2};
+	rules[0xA0] = {OTHER, 3};
+	for (uint8_t opcode = 0xA1; opcode <= 0xA6; ++opcode) {
+		rules[opcode] = {OTHER, 4};
+	}
+	rules[0xA8] = {OTHER, 1};
+	rules[0xAB] = {OTHER, 2};
+	rules[0xAC] = {OTHER, 2};
+	rules[0xCA] = {OTHER, 1};
+	rules[0xD3] = {OTHER, 6};
+	rules[0xDC] = {OTHER, 2};
+	rules[0xDD] = {OTHER, 4};
+	rules[0xE6] = {OTHER, 2};
+	rules[0xE8] = {OTHER, 8};
+	rules[0xF9] = {OTHER, 6};
+	return rules;
+}
+
+constexpr std::array<PacketRule, 256> packetRules = makePacketRules();
+
+}
+
+bool PacketLimiter::accept(uint8_t opcode, size_t length, int64_t now)
+{
+	const PacketRule& rule = packetRules[opcode];
+	if (length < rule.minLength) {
+		return false;
+	}
+
+	if (rule.kind == PACKET_KIND_FREE) {
+		return true;
+	}
+
+	const KindRate& kindRate = kindRates[rule.kind];
+	Bucket& bucket = buckets[rule.kind];
+	if (bucket.tokens < 0) {
+		bucket.tokens = kindRate.burst * 1000;
+	} else {
+		bucket.tokens = std::min(bucket.tokens + (now - bucket.lastRefill) * kindRate.rate, kindRate.burst * 1000);
+	}
+	bucket.lastRefill = now;
+
+	if (bucket.tokens < 1000) {
+		return false;
+	}
+
+	bucket.tokens -= 1000;
+	return true;
+}
@@ -0,0 +1,38 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Screens the packets of a game client on the network thread, before they are queued to the
+ * dispatcher. A packet shorter than its opcode needs is dropped, and so is one past the rate of its
+ * kind: walking and turning, speaking, looking, using and moving items, and everything else. Each
+ * kind is a token bucket refilled at its rate up to its burst, so a client that keeps within the
+ * rate never notices it. Logging out and the pings always pass. Network thread of its client only.
+ */
+class PacketLimiter
+{
+	public:
+		// whether a packet of opcode with length bytes after the opcode goes on to the dispatcher
+		bool accept(uint8_t opcode, size_t length, int64_t now);
+
+		enum PacketKind : uint8_t {
+			PACKET_KIND_FREE,
+			PACKET_KIND_WALK,
+			PACKET_KIND_SAY,
+			PACKET_KIND_LOOK,
+			PACKET_KIND_ITEM,
+			PACKET_KIND_OTHER,
+
+			PACKET_KIND_LAST = PACKET_KIND_OTHER
+		};
+
+	private:
+		struct Bucket {
+			// in thousandths of a packet
+			int64_t tokens = -1;
+			int64_t lastRefill = 0;
+		};
+
+		std::array<Bucket, PACKET_KIND_LAST + 1> buckets;
+};
@@ -0,0 +1,281 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "packetrecorder.h"
+#include "filetasks.h"
+#include "game.h"
+#include "protocolgame.h"
+#include "tools.h"
+
+extern Game g_game;
+
+PacketRecorder g_packetRecorder;
+
+namespace {
+
+// file: magic, version, random seed and recording date, then the records in dispatcher order
+// record: type, connection, dispatcher cycle and milliseconds since the recording started, then
+//   login: account id, operating system and character name
+//   packet: payload (length and bytes, the opcode first)
+//   release: nothing
+constexpr uint32_t RECORD_MAGIC = 0x52505654; // "TVPR"
+constexpr uint16_t RECORD_VERSION = 1;
+
+// the records are written out once this much was recorded or this long after the last write
+constexpr size_t FLUSH_SIZE = 64 * 1024;
+constexpr int64_t FLUSH_INTERVAL = 1000;
+
+}
+
+bool PacketRecorder::start()
+{
+	if (!recordFile.empty() && !replayFile.empty()) {
+		std::cout << "[Error - PacketRecorder::start] Packets cannot be recorded while they are replayed." << std::endl;
+		return false;
+	}
+
+	if (!replayFile.empty()) {
+		try {
+			replayData = std::make_unique<OTB::MappedFile>(replayFile);
+		} catch (const std::exception& e) {
+			std::cout << "[Error - PacketRecorder::start] Unable to open " << replayFile << ": " << e.what() << std::endl;
+			return false;
+		}
+
+		replayStream.init(replayData->data(), replayData->size());
+
+		uint32_t magic;
+		uint16_t version;
+		uint32_t seed;
+		int64_t recordedAt;
+		if (!replayStream.read<uint32_t>(magic) || !replayStream.read<uint16_t>(version) || !replayStream.read<uint32_t>(seed) ||
+		    !replayStream.read<int64_t>(recordedAt) || magic != RECORD_MAGIC || version != RECORD_VERSION) {
+			std::cout << "[Error - PacketRecorder::start] " << replayFile << " is not a packet record." << std::endl;
+			return false;
+		}
+
+		// the world takes the same random turns as when it was recorded, as long as the packets come in the same order
+		seedRandomGenerator(seed);
+		std::cout << ">> Replaying packets recorded on " << formatDate(static_cast<time_t>(recordedAt)) << std::endl;
+		return true;
+	}
+
+	if (!recordFile.empty()) {
+		const uint32_t seed = std::random_device{}();
+		seedRandomGenerator(seed);
+
+		stream.write<uint32_t>(RECORD_MAGIC);
+		stream.write<uint16_t>(RECORD_VERSION);
+		stream.write<uint32_t>(seed);
+		stream.write<int64_t>(time(nullptr));
+
+		recordStart = OTSYS_TIME();
+		lastFlush = recordStart;
+		recording = true;
+		std::cout << ">> Recording game packets to " << recordFile << std::endl;
+	}
+	return true;
+}
+
+void PacketRecorder::writeRecordHeader(RecordType type, uint32_t connection)
+{
+	const int64_t now = OTSYS_TIME();
+	stream.write<uint8_t>(type);
+	stream.write<uint32_t>(connection);
+	stream.write<uint64_t>(g_dispatcher.getDispatcherCycle());
+	stream.write<int64_t>(now - recordStart);
+
+	size_t size;
+	stream.getStream(size);
+	if (size >= FLUSH_SIZE || now - lastFlush >= FLUSH_INTERVAL) {
+		flush();
+	}
+}
+
+void PacketRecorder::recordLogin(ProtocolGame& protocol, const std::string& name, uint32_t accountId, uint8_t operatingSystem)
+{
+	protocol.recordId = ++lastConnectionId;
+	writeRecordHeader(RECORD_LOGIN, protocol.recordId);
+	stream.write<uint32_t>(accountId);
+	stream.write<uint8_t>(operatingSystem);
+	stream.writeString(name);
+}
+
+void PacketRecorder::recordPacket(const ProtocolGame& protocol, const NetworkMessage& msg)
+{
+	if (protocol.recordId == 0) {
+		return;
+	}
+
+	// the decoded payload starts at the initial position and is getLength() bytes long
+	writeRecordHeader(RECORD_PACKET, protocol.recordId);
+	stream.write<uint16_t>(msg.getLength());
+	stream.writeBytes(reinterpret_cast<const char*>(msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION), msg.getLength());
+}
+
+void PacketRecorder::recordRelease(const ProtocolGame& protocol)
+{
+	if (protocol.recordId != 0) {
+		writeRecordHeader(RECORD_RELEASE, protocol.recordId);
+	}
+}
+
+void PacketRecorder::flush()
+{
+	if (!recording) {
+		return;
+	}
+
+	size_t size;
+	const char* data = stream.getStream(size);
+	if (size != 0) {
+		g_fileTasks.writeFile(recordFile, std::string(data, size), fileCreated);
+		fileCreated = true;
+		stream.clear();
+	}
+	lastFlush = OTSYS_TIME();
+}
+
+bool PacketRecorder::readRecord(Record& record)
+{
+	uint8_t type;
+	if (!replayStream.read<uint8_t>(type) || !replayStream.read<uint32_t>(record.connection) ||
+	    !replayStream.read<uint64_t>(record.cycle) || !replayStream.read<int64_t>(record.elapsed)) {
+		return false;
+	}
+
+	record.type = static_cast<RecordType>(type);
+	switch (record.type) {
+		case RECORD_LOGIN:
+			return replayStream.read<uint32_t>(record.accountId) && replayStream.read<uint8_t>(record.operatingSystem) &&
+			       replayStream.readString(record.name);
+
+		case RECORD_PACKET:
+			return replayStream.readString(record.payload) && !record.payload.empty() &&
+			       record.payload.size() <= NETWORKMESSAGE_MAXSIZE - NetworkMessage::INITIAL_BUFFER_POSITION;
+
+		case RECORD_RELEASE:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+void PacketRecorder::runReplay()
+{
+	// the records of one recorded dispatcher cycle are handed over together, at the time they were handled
+	const auto postRecords = [](std::vector<Record>&& records) {
+		Task* task = createTask([records = std::move(records)]() {
+			for (const Record& record : records) {
+				g_packetRecorder.replayRecord(record);
+			}
+		});
+		task->setTag("PacketRecorder::replayRecord");
+		g_dispatcher.addTask(task);
+	};
+
+	g_dispatcher.addTask(createTask([this]() {
+		replayStartCycle = g_dispatcher.getDispatcherCycle();
+		replayStart = OTSYS_TIME();
+	}));
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<Record> records;
+	uint64_t readRecords = 0;
+	uint64_t firstCycle = 0;
+	uint64_t lastCycle = 0;
+	int64_t firstElapsed = 0;
+	int64_t lastElapsed = 0;
+	while (true) {
+		Record record;
+		if (!readRecord(record)) {
+			break;
+		}
+
+		if (!records.empty() && record.cycle != records.back().cycle) {
+			postRecords(std::move(records));
+			records.clear();
+		}
+
+		if (readRecords++ == 0) {
+			firstCycle = record.cycle;
+			firstElapsed = record.elapsed;
+		}
+
+		// the time before the first login is skipped
+		if (records.empty()) {
+			std::this_thread::sleep_until(start + std::chrono::milliseconds(record.elapsed - firstElapsed));
+		}
+
+		lastCycle = record.cycle;
+		lastElapsed = record.elapsed;
+		records.push_back(std::move(record));
+	}
+
+	if (replayStream.size() != 0) {
+		std::cout << "> Warning: " << replayFile << " is damaged, it was replayed up to there." << std::endl;
+	}
+
+	if (!records.empty()) {
+		postRecords(std::move(records));
+	}
+
+	g_dispatcher.addTask(createTask([this, recordedCycles = lastCycle - firstCycle, recordedDuration = lastElapsed - firstElapsed]() {
+		finishReplay(recordedCycles, recordedDuration);
+	}));
+}
+
+void PacketRecorder::replayRecord(const Record& record)
+{
+	++replayedRecords;
+
+	switch (record.type) {
+		case RECORD_LOGIN: {
+			// a protocol without connection, it builds the messages for the player and drops them
+			auto protocol = std::make_shared<ProtocolGame>(nullptr);
+			replayConnections[record.connection] = protocol;
+			protocol->login(record.name, record.accountId, static_cast<OperatingSystem_t>(record.operatingSystem));
+			break;
+		}
+
+		case RECORD_PACKET: {
+			auto it = replayConnections.find(record.connection);
+			if (it == replayConnections.end()) {
+				break;
+			}
+
+			// laid out like a decrypted packet of a connection
+			static NetworkMessage msg;
+			msg.reset();
+			std::copy(record.payload.begin(), record.payload.end(), msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION);
+			msg.setLength(static_cast<NetworkMessage::MsgSize_t>(record.payload.size()));
+			it->second->parsePacketOnDispatcher(InboundMessage::make(msg));
+			break;
+		}
+
+		case RECORD_RELEASE: {
+			auto it = replayConnections.find(record.connection);
+			if (it != replayConnections.end()) {
+				it->second->release();
+				replayConnections.erase(it);
+			}
+			break;
+		}
+	}
+}
+
+void PacketRecorder::finishReplay(uint64_t recordedCycles, int64_t recordedDuration)
+{
+	for (const auto& it : replayConnections) {
+		it.second->release();
+	}
+	replayConnections.clear();
+
+	std::cout << fmt::format(">> Replayed {:d} records in {:d} dispatcher cycles and {:d} ms, recorded in {:d} cycles and {:d} ms",
+		replayedRecords, g_dispatcher.getDispatcherCycle() - replayStartCycle, OTSYS_TIME() - replayStart, recordedCycles, recordedDuration) << std::endl;
+
+	g_game.setGameState(GAME_STATE_SHUTDOWN);
+}
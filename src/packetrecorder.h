@@ -0,0 +1,98 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include "fileloader.h"
+
+class NetworkMessage;
+class ProtocolGame;
+
+using ProtocolGame_ptr = std::shared_ptr<ProtocolGame>;
+
+/*
+ * Capture of the game packets the dispatcher handles, to run a production workload again offline.
+ * --record=<file> logs the seed of the random generators and then, in dispatcher order, every login,
+ * decoded packet and release of a game connection with its dispatcher cycle and time.
+ * --replay=<file> boots from the same gamedata/ and database without opening any port and feeds
+ * the packets to ProtocolGame at their recorded times, from the main thread like a network thread would.
+ * What the server sends to replayed players is built as usual and dropped.
+ */
+class PacketRecorder
+{
+	public:
+		void setRecordFile(const std::string& fileName) {
+			recordFile = fileName;
+		}
+		void setReplayFile(const std::string& fileName) {
+			replayFile = fileName;
+		}
+
+		// dispatcher thread, before the world loads: seeds the random generators and opens the record or the replay
+		bool start();
+
+		bool isRecording() const {
+			return recording;
+		}
+		bool isReplayMode() const {
+			return !replayFile.empty();
+		}
+
+		// dispatcher thread
+		void recordLogin(ProtocolGame& protocol, const std::string& name, uint32_t accountId, uint8_t operatingSystem);
+		void recordPacket(const ProtocolGame& protocol, const NetworkMessage& msg);
+		void recordRelease(const ProtocolGame& protocol);
+		// hands what was recorded so far to the file thread
+		void flush();
+
+		// main thread, once the game runs: blocks until every record was handed to the dispatcher, then shuts the game down
+		void runReplay();
+
+	private:
+		enum RecordType : uint8_t {
+			RECORD_LOGIN = 1,
+			RECORD_PACKET = 2,
+			RECORD_RELEASE = 3,
+		};
+
+		struct Record {
+			RecordType type;
+			uint32_t connection;
+			uint64_t cycle;
+			int64_t elapsed;
+
+			// login
+			std::string name;
+			uint32_t accountId = 0;
+			uint8_t operatingSystem = 0;
+
+			// packet
+			std::string payload;
+		};
+
+		void writeRecordHeader(RecordType type, uint32_t connection);
+		bool readRecord(Record& record);
+		void replayRecord(const Record& record);
+		void finishReplay(uint64_t recordedCycles, int64_t recordedDuration);
+
+		std::string recordFile;
+		std::string replayFile;
+
+		// recording, dispatcher thread only
+		PropWriteStream stream;
+		int64_t recordStart = 0;
+		int64_t lastFlush = 0;
+		uint32_t lastConnectionId = 0;
+		bool recording = false;
+		bool fileCreated = false;
+
+		// replaying, the file is read by the main thread, the connections live on the dispatcher thread
+		std::unique_ptr<OTB::MappedFile> replayData;
+		PropStream replayStream;
+		std::unordered_map<uint32_t, ProtocolGame_ptr> replayConnections;
+		uint64_t replayedRecords = 0;
+		uint64_t replayStartCycle = 0;
+		int64_t replayStart = 0;
+};
+
+extern PacketRecorder g_packetRecorder;
@@ -341,6 +341,11 @@ bool Party::canUseSharedExperience(const Player* player) const
 		return false;
 	}
 
+	return canUseSharedExperience(player, getMinSharedExperienceLevel());
+}
+
+uint32_t Party::getMinSharedExperienceLevel() const
+{
 	uint32_t highestLevel = leader->getLevel();
 	for (Player* member : memberList) {
 		if (member->getLevel() > highestLevel) {
@@ -348,7 +353,11 @@ bool Party::canUseSharedExperience(const Player* player) const
 		}
 	}
 
-	uint32_t minLevel = static_cast<uint32_t>(std::ceil((static_cast<float>(highestLevel) * 2) / 3));
+	return static_cast<uint32_t>(std::ceil((static_cast<float>(highestLevel) * 2) / 3));
+}
+
+bool Party::canUseSharedExperience(const Player* player, uint32_t minLevel) const
+{
 	if (player->getLevel() < minLevel) {
 		return false;
 	}
@@ -373,23 +382,49 @@ bool Party::canUseSharedExperience(const Player* player) const
 
 bool Party::canEnableSharedExperience()
 {
-	if (!canUseSharedExperience(leader)) {
+	if (memberList.empty()) {
+		return false;
+	}
+
+	const uint32_t minLevel = getMinSharedExperienceLevel();
+	if (!canUseSharedExperience(leader, minLevel)) {
 		return false;
 	}
 
 	for (Player* member : memberList) {
-		if (!canUseSharedExperience(member)) {
+		if (!canUseSharedExperience(member, minLevel)) {
 			return false;
 		}
 	}
+
+	// everyone is active, the first one to stop being so ends it
+	const int64_t inactiveTime = g_config.getNumber(ConfigManager::PZ_LOCKED);
+	sharedExpCheckTime = ticksMap.at(leader->getID()) + inactiveTime + 1;
+	for (Player* member : memberList) {
+		sharedExpCheckTime = std::min<int64_t>(sharedExpCheckTime, ticksMap.at(member->getID()) + inactiveTime + 1);
+	}
 	return true;
 }
 
+void Party::updateSharedExperience(const Player* player)
+{
+	if (player != leader && sharedExpEnabled && OTSYS_TIME() < sharedExpCheckTime &&
+		Position::areInRange<30, 30, 1>(leader->getPosition(), player->getPosition())) {
+		return;
+	}
+
+	updateSharedExperience();
+}
+
 void Party::updatePlayerTicks(Player* player, uint32_t points)
 {
 	if (points != 0) {
 		ticksMap[player->getID()] = OTSYS_TIME();
-		updateSharedExperience();
+
+		// fresher activity can only enable shared experience, not end it
+		if (!sharedExpEnabled || OTSYS_TIME() >= sharedExpCheckTime) {
+			updateSharedExperience();
+		}
 	}
 }
 
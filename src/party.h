@@ -59,14 +59,20 @@ class Party
 		}
 		bool canUseSharedExperience(const Player* player) const;
 		void updateSharedExperience();
+		// a member moved, only its own distance to the leader can have changed
+		void updateSharedExperience(const Player* player);
 
 		void updatePlayerTicks(Player* player, uint32_t points);
 		void clearPlayerPoints(Player* player);
 
 	private:
 		bool canEnableSharedExperience();
+		uint32_t getMinSharedExperienceLevel() const;
+		bool canUseSharedExperience(const Player* player, uint32_t minLevel) const;
 
 		std::map<uint32_t, int64_t> ticksMap;
+		// the cached sharedExpEnabled holds until someone's activity runs out at this time
+		int64_t sharedExpCheckTime = 0;
 
 		PlayerVector memberList;
 		std::vector<uint32_t> inviteList;
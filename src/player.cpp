@@ -3,7 +3,9 @@
 
 #include "otpch.h"
 
+#include "ban.h"
 #include "bed.h"
+#include "cast.h"
 #include "chat.h"
 #include "combat.h"
 #include "configmanager.h"
@@ -11,10 +13,12 @@
 #include "events.h"
 #include "game.h"
 #include "iologindata.h"
+#include "itemupdatebatch.h"
 #include "monster.h"
 #include "movement.h"
 #include "scheduler.h"
 #include "weapons.h"
+#include "worldshards.h"
 #include "database.h"
 #include "databasetasks.h"
 
@@ -36,11 +40,13 @@ uint32_t Player::playerAutoID = 0x10000000;
 Player::Player(ProtocolGame_ptr p) :
 	Creature(), lastPing(OTSYS_TIME()), lastPong(lastPing), client(std::move(p))
 {
-	//
+	InstanceCounter<Player>::onCreate();
 }
 
 Player::~Player()
 {
+	InstanceCounter<Player>::onDestroy();
+
 	for (Item* item : inventory) {
 		if (item) {
 			item->setParent(nullptr);
@@ -628,7 +634,7 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 {
 	if (IS_IN_KEYRANGE(key, RESERVED_RANGE)) {
 		if (IS_IN_KEYRANGE(key, OUTFITS_RANGE)) {
-			outfits.emplace_back(
+			cold->outfits.emplace_back(
 				value >> 16
 			);
 			return;
@@ -651,11 +657,11 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 void Player::addStringStorageValue(const std::string& key, const std::string& value)
 {
 	if (value.empty()) {
-		stringStorageMap.erase(key);
+		cold->stringStorageMap.erase(key);
 		return;
 	}
 
-	stringStorageMap.emplace(key, value);
+	cold->stringStorageMap.emplace(key, value);
 }
 
 bool Player::getStorageValue(const uint32_t key, int32_t& value) const
@@ -672,8 +678,8 @@ bool Player::getStorageValue(const uint32_t key, int32_t& value) const
 
 bool Player::getStringStorageValue(const std::string& key, std::string& value) const
 {
-	auto it = stringStorageMap.find(key);
-	if (it == stringStorageMap.end()) {
+	auto it = cold->stringStorageMap.find(key);
+	if (it == cold->stringStorageMap.end()) {
 		return false;
 	}
 
@@ -741,12 +747,40 @@ bool Player::isNearDepotBox(int32_t depotId/* = -1*/) const
 	return false;
 }
 
+void Player::loadDepots()
+{
+	if (cold->depotData.empty() || cold->depotsUnsaveable) {
+		return;
+	}
+
+	// cleared first, loading the lockers goes through getDepotLocker again
+	std::string data = std::move(cold->depotData);
+	cold->depotData.clear();
+	if (!IOLoginData::loadPlayerDepots(this, data)) {
+		// the lockers only hold part of the depots, saving them would overwrite the complete section
+		cold->depotData = std::move(data);
+		cold->depotsUnsaveable = true;
+	}
+}
+
+uint32_t Player::getDepotItemCount() const
+{
+	// depots that were not needed yet are still unread in depotData
+	uint32_t count = 0;
+	for (const auto& it : cold->depotLockerMap) {
+		count += it.second->getItemHoldingCount();
+	}
+	return count;
+}
+
 DepotLocker* Player::getDepotLocker(uint32_t depotId, bool force)
 {
-	auto it = depotLockerMap.find(depotId);
-	if (it != depotLockerMap.end()) {
+	loadDepots();
+
+	auto it = cold->depotLockerMap.find(depotId);
+	if (it != cold->depotLockerMap.end()) {
 		// Stop this depot container from being opened
-		if (!force && !it->second->hasLoadedContent()) {
+		if (!force && (!it->second->hasLoadedContent() || cold->depotsUnsaveable)) {
 			return nullptr;
 		}
 
@@ -754,7 +788,7 @@ DepotLocker* Player::getDepotLocker(uint32_t depotId, bool force)
 	}
 
 	// We always want to auto-create depots as we need them
-	it = depotLockerMap.emplace(depotId, new DepotLocker(ITEM_LOCKER1)).first;
+	it = cold->depotLockerMap.emplace(depotId, new DepotLocker(ITEM_LOCKER1)).first;
 	it->second->setDepotId(depotId);
 	it->second->setMaxDepotItems(getMaxDepotItems());
 	return it->second.get();
@@ -763,8 +797,8 @@ DepotLocker* Player::getDepotLocker(uint32_t depotId, bool force)
 void Player::loadDepotLocker(uint32_t depotId)
 {
 	DepotLocker* depotLocker = nullptr;
-	auto it = depotLockerMap.find(depotId);
-	if (it == depotLockerMap.end()) {
+	auto it = cold->depotLockerMap.find(depotId);
+	if (it == cold->depotLockerMap.end()) {
 		depotLocker = getDepotLocker(depotId, true);
 	} else {
 		depotLocker = it->second.get();
@@ -778,8 +812,8 @@ void Player::loadDepotLocker(uint32_t depotId)
 
 void Player::unloadDepotLocker(uint32_t depotId)
 {
-	auto it = depotLockerMap.find(depotId);
-	if (it == depotLockerMap.end()) {
+	auto it = cold->depotLockerMap.find(depotId);
+	if (it == cold->depotLockerMap.end()) {
 		return; // silently ignore
 	}
 
@@ -795,6 +829,11 @@ void Player::sendCancelMessage(ReturnValue message) const
 
 void Player::sendStats()
 {
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->updateStats(this);
+		return;
+	}
+
 	if (client) {
 		client->sendStats();
 	}
@@ -805,7 +844,7 @@ void Player::sendPing()
 	int64_t timeNow = OTSYS_TIME();
 
 	bool hasLostConnection = false;
-	if ((timeNow - lastPing) >= 5000) {
+	if ((timeNow - lastPing) >= PLAYER_PING_INTERVAL) {
 		lastPing = timeNow;
 		if (client) {
 			client->sendPing();
@@ -1076,6 +1115,20 @@ void Player::onChangeZone(ZoneType_t zone)
 	sendIcons();
 }
 
+void Player::startCast(const std::string& password)
+{
+	stopCast();
+	cast = std::make_shared<Cast>(password);
+}
+
+void Player::stopCast()
+{
+	if (cast) {
+		cast->close();
+		cast.reset();
+	}
+}
+
 void Player::onRemoveCreature(Creature* creature, bool isLogout)
 {
 	Creature::onRemoveCreature(creature, isLogout);
@@ -1109,6 +1162,8 @@ void Player::onRemoveCreature(Creature* creature, bool isLogout)
 			guild->removeMember(this);
 		}
 
+		stopCast();
+
 		IOLoginData::updateOnlineStatus(guid, false);
 
 		g_game.closeRuleViolationReport(this);
@@ -1151,6 +1206,11 @@ void Player::onCreatureMove(Creature* creature, const Tile* newTile, const Posit
 		return;
 	}
 
+	if (!g_worldShards.isOwned(newPos)) {
+		handOffToShard();
+		return;
+	}
+
 	if (tradeState != TRADE_TRANSFER) {
 		//check if we should close trade
 		if (tradeItem && !Position::areInRange<1, 1, 0>(tradeItem->getPosition(), getPosition())) {
@@ -1163,19 +1223,19 @@ void Player::onCreatureMove(Creature* creature, const Tile* newTile, const Posit
 	}
 	
 	// close modal windows
-	if (!modalWindows.empty()) {
+	if (!cold->modalWindows.empty()) {
 		// TODO: This shouldn't be hard-coded
-		for (uint32_t modalWindowId : modalWindows) {
+		for (uint32_t modalWindowId : cold->modalWindows) {
 			if (modalWindowId == std::numeric_limits<uint32_t>::max()) {
 				sendTextMessage(MESSAGE_EVENT_ADVANCE, "Offline training aborted.");
 				break;
 			}
 		}
-		modalWindows.clear();
+		cold->modalWindows.clear();
 	}
 
 	if (party) {
-		party->updateSharedExperience();
+		party->updateSharedExperience(this);
 	}
 
 	if (oldPos.z != newPos.z && attackedCreature) {
@@ -1349,23 +1409,36 @@ void Player::onIdleStimulus()
 
 void Player::onThink(uint32_t interval)
 {
+	// the pings, the idle kick and the skulls are timed by Game::checkPlayerTimers
 	Creature::onThink(interval);
+}
+
+int64_t Player::checkIdle(int64_t now)
+{
+	// idle time does not count where players cannot log out, nor for the staff
+	if (getTile()->hasFlag(TILESTATE_NOLOGOUT) || isAccessPlayer()) {
+		resetIdleTime();
+	}
 
-	sendPing();
+	const int32_t kickAfterMinutes = g_config.getNumber(ConfigManager::KICK_AFTER_MINUTES);
+	const int64_t warnTime = lastActivity + kickAfterMinutes * 60000;
+	if (now < warnTime) {
+		return warnTime;
+	}
 
-	if (!getTile()->hasFlag(TILESTATE_NOLOGOUT) && !isAccessPlayer()) {
-		idleTime += interval;
-		const int32_t kickAfterMinutes = g_config.getNumber(ConfigManager::KICK_AFTER_MINUTES);
-		if (idleTime > (kickAfterMinutes * 60000) + 60000) {
-			kickPlayer(true);
-		} else if (client && idleTime == 60000 * kickAfterMinutes) {
-			client->sendTextMessage(TextMessage(MESSAGE_STATUS_WARNING, fmt::format("You have been idle for {:d} minutes. You will be disconnected in one minute if you are still idle then.", kickAfterMinutes)));
-		}
+	const int64_t kickTime = warnTime + 60000;
+	if (now > kickTime) {
+		kickPlayer(true);
+		return 0;
 	}
 
-	if (g_game.getWorldType() != WORLD_TYPE_PVP_ENFORCED) {
-		checkSkullTicks();
+	if (!idleWarned) {
+		idleWarned = true;
+		if (client) {
+			client->sendTextMessage(TextMessage(MESSAGE_STATUS_WARNING, fmt::format("You have been idle for {:d} minutes. You will be disconnected in one minute if you are still idle then.", kickAfterMinutes)));
+		}
 	}
+	return kickTime + 1;
 }
 
 uint32_t Player::isMuted() const
@@ -1887,7 +1960,7 @@ void Player::death(Creature* lastHitCreature)
 				}
 
 				// unlearn all spells
-				learnedInstantSpellList.clear();
+				cold->learnedInstantSpellList.clear();
 
 				// reset inventory
 				for (int32_t slot = getFirstIndex(); slot < getLastIndex(); slot++) {
@@ -1909,10 +1982,9 @@ void Player::death(Creature* lastHitCreature)
 		health = healthMax;
 		mana = manaMax;
 
-		auto it = conditions.begin(), end = conditions.end();
-		while (it != end) {
-			Condition* condition = *it;
-			it = conditions.erase(it);
+		while (!conditions.empty()) {
+			Condition* condition = conditions.front();
+			conditions.erase(conditions.begin());
 
 			condition->endCondition(this);
 			onEndCondition(condition->getType());
@@ -1921,10 +1993,9 @@ void Player::death(Creature* lastHitCreature)
 	} else {
 		setSkillLoss(true);
 
-		auto it = conditions.begin(), end = conditions.end();
-		while (it != end) {
-			Condition* condition = *it;
-			it = conditions.erase(it);
+		while (!conditions.empty()) {
+			Condition* condition = conditions.front();
+			conditions.erase(conditions.begin());
 
 			condition->endCondition(this);
 			onEndCondition(condition->getType());
@@ -1988,20 +2059,44 @@ void Player::removeList()
 {
 	g_game.removePlayer(this);
 
-	for (const auto& it : g_game.getPlayers()) {
-		it.second->notifyStatusChange(this, VIPSTATUS_OFFLINE);
+	for (uint32_t vipGuid : cold->VIPList) {
+		g_game.removeVIPSubscriber(vipGuid, this);
+	}
+
+	if (const std::vector<Player*>* subscribers = g_game.getVIPSubscribers(guid)) {
+		for (Player* subscriber : *subscribers) {
+			subscriber->notifyStatusChange(this, VIPSTATUS_OFFLINE);
+		}
 	}
 }
 
 void Player::addList()
 {
-	for (const auto& it : g_game.getPlayers()) {
-		it.second->notifyStatusChange(this, VIPSTATUS_ONLINE);
+	if (const std::vector<Player*>* subscribers = g_game.getVIPSubscribers(guid)) {
+		for (Player* subscriber : *subscribers) {
+			subscriber->notifyStatusChange(this, VIPSTATUS_ONLINE);
+		}
+	}
+
+	for (uint32_t vipGuid : cold->VIPList) {
+		g_game.addVIPSubscriber(vipGuid, this);
 	}
 
 	g_game.addPlayer(this);
 }
 
+void Player::handOffToShard()
+{
+	// the file saved on logout holds the position on the other shard
+	const WorldShards::Shard* shard = g_worldShards.getShard(getPosition());
+	sendTextMessage(MESSAGE_STATUS_WARNING, fmt::format("You have entered {:s}. Please log in again.", shard ? shard->name : "another part of the world"));
+	g_dispatcher.addTask(createTask([id = getID()]() {
+		if (Player* player = g_game.getPlayerByID(id)) {
+			player->kickPlayer(false, true);
+		}
+	}));
+}
+
 void Player::kickPlayer(bool displayEffect, bool force)
 {
 	if (force || !isPzLocked()) {
@@ -2023,8 +2118,8 @@ void Player::notifyStatusChange(Player* loginPlayer, VipStatus_t status)
 		return;
 	}
 
-	auto it = VIPList.find(loginPlayer->guid);
-	if (it == VIPList.end()) {
+	auto it = cold->VIPList.find(loginPlayer->guid);
+	if (it == cold->VIPList.end()) {
 		return;
 	}
 
@@ -2033,26 +2128,33 @@ void Player::notifyStatusChange(Player* loginPlayer, VipStatus_t status)
 
 bool Player::removeVIP(uint32_t vipGuid)
 {
-	if (VIPList.erase(vipGuid) == 0) {
+	if (cold->VIPList.erase(vipGuid) == 0) {
 		return false;
 	}
 
+	if (isVIPSubscriber()) {
+		g_game.removeVIPSubscriber(vipGuid, this);
+	}
 	return true;
 }
 
 bool Player::addVIP(uint32_t vipGuid, const std::string& vipName, VipStatus_t status)
 {
-	if (VIPList.size() >= getMaxVIPEntries()) {
+	if (cold->VIPList.size() >= getMaxVIPEntries()) {
 		sendTextMessage(MESSAGE_STATUS_SMALL, "You cannot add more buddies.");
 		return false;
 	}
 
-	auto result = VIPList.insert(vipGuid);
+	auto result = cold->VIPList.insert(vipGuid);
 	if (!result.second) {
 		sendTextMessage(MESSAGE_STATUS_SMALL, "This player is already in your list.");
 		return false;
 	}
 
+	if (isVIPSubscriber()) {
+		g_game.addVIPSubscriber(vipGuid, this);
+	}
+
 	if (client) {
 		client->sendVIP(vipGuid, vipName, status);
 	}
@@ -2061,11 +2163,24 @@ bool Player::addVIP(uint32_t vipGuid, const std::string& vipName, VipStatus_t st
 
 bool Player::addVIPInternal(uint32_t vipGuid)
 {
-	if (VIPList.size() >= getMaxVIPEntries()) {
+	if (cold->VIPList.size() >= getMaxVIPEntries()) {
+		return false;
+	}
+
+	if (!cold->VIPList.insert(vipGuid).second) {
 		return false;
 	}
 
-	return VIPList.insert(vipGuid).second;
+	if (isVIPSubscriber()) {
+		g_game.addVIPSubscriber(vipGuid, this);
+	}
+	return true;
+}
+
+bool Player::isVIPSubscriber() const
+{
+	// between addList and removeList
+	return g_game.getPlayerByGUID(guid) == this;
 }
 
 //close container and its child containers
@@ -2874,7 +2989,7 @@ void Player::postRemoveNotification(Thing* thing, const Cylinder* newParent, int
 				if (const DepotLocker* depotLocker = dynamic_cast<const DepotLocker*>(topContainer)) {
 					bool isOwner = false;
 
-					for (const auto& it : depotLockerMap) {
+					for (const auto& it : cold->depotLockerMap) {
 						if (it.second.get() == depotLocker) {
 							isOwner = true;
 							onSendContainer(container);
@@ -3107,6 +3222,8 @@ void Player::onEndCondition(ConditionType_t type)
 
 		if (getSkull() != SKULL_RED) {
 			setSkull(SKULL_NONE);
+		} else {
+			g_game.schedulePlayerSkullCheck(this);
 		}
 
 		// player has lost aggressor status
@@ -3392,7 +3509,7 @@ bool Player::canWear(uint32_t lookType) const
 		return true;
 	}
 
-	for (const OutfitEntry& outfitEntry : outfits) {
+	for (const OutfitEntry& outfitEntry : cold->outfits) {
 		if (outfitEntry.lookType == lookType) {
 			return true;
 		}
@@ -3411,7 +3528,7 @@ bool Player::hasOutfit(uint32_t lookType)
 		return true;
 	}
 
-	for (const OutfitEntry& outfitEntry : outfits) {
+	for (const OutfitEntry& outfitEntry : cold->outfits) {
 		if (outfitEntry.lookType == lookType) {
 			return true;
 		}
@@ -3423,27 +3540,27 @@ void Player::genReservedStorageRange()
 {
 	//generate outfits range
 	uint32_t base_key = PSTRG_OUTFITS_RANGE_START;
-	for (const OutfitEntry& entry : outfits) {
+	for (const OutfitEntry& entry : cold->outfits) {
 		storageMap[++base_key] = (entry.lookType << 16);
 	}
 }
 
 void Player::addOutfit(uint16_t lookType)
 {
-	for (OutfitEntry& outfitEntry : outfits) {
+	for (OutfitEntry& outfitEntry : cold->outfits) {
 		if (outfitEntry.lookType == lookType) {
 			return;
 		}
 	}
-	outfits.emplace_back(lookType);
+	cold->outfits.emplace_back(lookType);
 }
 
 bool Player::removeOutfit(uint16_t lookType)
 {
-	for (auto it = outfits.begin(), end = outfits.end(); it != end; ++it) {
+	for (auto it = cold->outfits.begin(), end = cold->outfits.end(); it != end; ++it) {
 		OutfitEntry& entry = *it;
 		if (entry.lookType == lookType) {
-			outfits.erase(it);
+			cold->outfits.erase(it);
 			return true;
 		}
 	}
@@ -3529,7 +3646,7 @@ void Player::addUnjustifiedDead(const Player* attacked)
 
 	lastUnjustCreatureId = attacked->getID();
 
-	murderTimeStamps.push_back(std::time(nullptr));
+	cold->murderTimeStamps.push_back(std::time(nullptr));
 
 	sendTextMessage(MESSAGE_STATUS_WARNING, "Warning! The murder of " + attacked->getName() + " was not justified.");
 
@@ -3546,11 +3663,17 @@ void Player::addUnjustifiedDead(const Player* attacked)
 
 		if (murderResult == PLAYER_KILLING_BANISHMENT) {
 			g_game.addMagicEffect(getPosition(), CONST_ME_MAGIC_RED);
+			BanInfo banInfo;
+			banInfo.bannedBy = "Server";
+			banInfo.reason = "Too many unjustified kills";
+			banInfo.expiresAt = time(nullptr) + (g_config.getNumber(ConfigManager::BAN_DAYS_LENGTH) * 86400);
+			IOBan::addAccountBan(getAccount(), banInfo);
+
 			g_databaseTasks.addTask(fmt::format("INSERT INTO `account_bans` (`account_id`, `reason`, `banned_at`, `expires_at`, `banned_by`) VALUES ({:d}, {:s}, {:d}, {:d}, {:d})",
 				getAccount(),
-				Database::getInstance().escapeString("Too many unjustified kills"),
+				Database::getInstance().escapeString(banInfo.reason),
 				time(nullptr),
-				time(nullptr) + (g_config.getNumber(ConfigManager::BAN_DAYS_LENGTH) * 86400),
+				banInfo.expiresAt,
 				0));
 			g_scheduler.addEvent(createSchedulerTask(1000, std::bind(&Game::kickPlayer, &g_game, getID(), false)));
 		}
@@ -3569,7 +3692,7 @@ PlayerKillingResult_t Player::checkPlayerKilling()
 	time_t weekTimestamp = today - (7 * 24 * 60 * 60);
 	time_t monthTimestamp = today - (30 * 24 * 60 * 60);
 
-	for (time_t currentMurderTimestamp : murderTimeStamps) {
+	for (time_t currentMurderTimestamp : cold->murderTimeStamps) {
 		if (currentMurderTimestamp > dayTimestamp) {
 			lastDay++;
 		}
@@ -3658,13 +3781,13 @@ uint64_t Player::getLostExperience() const
 void Player::learnInstantSpell(const std::string& spellName)
 {
 	if (!hasLearnedInstantSpell(spellName)) {
-		learnedInstantSpellList.push_front(spellName);
+		cold->learnedInstantSpellList.push_front(spellName);
 	}
 }
 
 void Player::forgetInstantSpell(const std::string& spellName)
 {
-	learnedInstantSpellList.remove(spellName);
+	cold->learnedInstantSpellList.remove(spellName);
 }
 
 bool Player::hasLearnedInstantSpell(const std::string& spellName) const
@@ -3677,7 +3800,7 @@ bool Player::hasLearnedInstantSpell(const std::string& spellName) const
 		return true;
 	}
 
-	for (const auto& learnedSpellName : learnedInstantSpellList) {
+	for (const auto& learnedSpellName : cold->learnedInstantSpellList) {
 		if (strcasecmp(learnedSpellName.c_str(), spellName.c_str()) == 0) {
 			return true;
 		}
@@ -3701,7 +3824,7 @@ bool Player::isInWar(const Player* player) const
 
 bool Player::isInWarList(uint32_t guildId) const
 {
-	return std::find(guildWarVector.begin(), guildWarVector.end(), guildId) != guildWarVector.end();
+	return std::find(cold->guildWarVector.begin(), cold->guildWarVector.end(), guildId) != cold->guildWarVector.end();
 }
 
 bool Player::isPremium() const
@@ -3778,12 +3901,12 @@ void Player::sendPlayerPartyIcons(Player* player)
 
 bool Player::hasModalWindowOpen(uint32_t modalWindowId) const
 {
-	return find(modalWindows.begin(), modalWindows.end(), modalWindowId) != modalWindows.end();
+	return find(cold->modalWindows.begin(), cold->modalWindows.end(), modalWindowId) != cold->modalWindows.end();
 }
 
 void Player::onModalWindowHandled(uint32_t modalWindowId)
 {
-	modalWindows.remove(modalWindowId);
+	cold->modalWindows.remove(modalWindowId);
 }
 
 void Player::sendModalWindow(const ModalWindow& modalWindow)
@@ -3792,13 +3915,13 @@ void Player::sendModalWindow(const ModalWindow& modalWindow)
 		return;
 	}
 
-	modalWindows.push_front(modalWindow.id);
+	cold->modalWindows.push_front(modalWindow.id);
 	client->sendModalWindow(modalWindow);
 }
 
 void Player::clearModalWindows()
 {
-	modalWindows.clear();
+	cold->modalWindows.clear();
 }
 
 void Player::sendClosePrivate(uint16_t channelId)
@@ -3903,10 +4026,14 @@ void Player::setGuild(Guild* guild)
 		this->guild = guild;
 		this->guildRank = rank;
 		guild->addMember(this);
+		guild->setMemberCount(guild->getMemberCount() + 1);
 	}
 
 	if (oldGuild) {
 		oldGuild->removeMember(this);
+		if (oldGuild->getMemberCount() > 0) {
+			oldGuild->setMemberCount(oldGuild->getMemberCount() - 1);
+		}
 	}
 }
 
@@ -84,6 +84,24 @@ enum PlayerKillingResult_t {
 
 using MuteCountMap = std::map<uint32_t, uint32_t>;
 
+// the containers of a player only used by logins, saves and the player's own actions, kept out of
+// the player object so that walking the players does not pull them into the cache
+struct PlayerColdData {
+	std::unordered_set<uint32_t> VIPList;
+	std::map<uint32_t, DepotLocker_ptr> depotLockerMap;
+	// depots section of the player file, kept unread until a depot is needed
+	std::string depotData;
+	// the depots section could not be read, it is written back as it was instead of the lockers
+	bool depotsUnsaveable = false;
+	std::unordered_map<std::string, std::string> stringStorageMap;
+	std::vector<OutfitEntry> outfits;
+	GuildWarVector guildWarVector;
+	std::forward_list<Party*> invitePartyList;
+	std::forward_list<uint32_t> modalWindows;
+	std::list<std::string> learnedInstantSpellList;
+	std::list<time_t> murderTimeStamps;
+};
+
 static constexpr int32_t PLAYER_MAX_SPEED = 1500;
 static constexpr int32_t PLAYER_MIN_SPEED = 80;
 static constexpr int32_t PLAYER_FIGHT_DURATION = 60 * 1000;
@@ -147,6 +165,12 @@ class Player final : public Creature, public Cylinder
 		void removeList() override;
 		void addList() override;
 		void kickPlayer(bool displayEffect, bool force = false);
+		// the player moved out of the areas of this shard, see worldshards.h
+		void handOffToShard();
+		// the hand-off logs the player out, which a fight does not allow
+		bool canLeaveShard() const {
+			return isAccessPlayer() || (!isPzLocked() && !hasCondition(CONDITION_INFIGHT));
+		}
 
 		static uint64_t getExpForLevel(const uint64_t lv) {
 			return (((lv - 6ULL) * lv + 17ULL) * lv - 12ULL) / 6ULL * 100ULL;
@@ -190,7 +214,7 @@ class Player final : public Creature, public Cylinder
 		uint16_t getClientIcons() const;
 
 		const GuildWarVector& getGuildWarVector() const {
-			return guildWarVector;
+			return cold->guildWarVector;
 		}
 
 		Vocation* getVocation() const {
@@ -257,6 +281,10 @@ class Player final : public Creature, public Cylinder
 			}
 		}
 		uint32_t getIP() const;
+		// null while the player has no client
+		const TrafficCounter* getTrafficCounter() const {
+			return client ? &client->getTrafficCounter() : nullptr;
+		}
 
 		void addContainer(uint8_t cid, Container* container);
 		void closeContainer(uint8_t cid);
@@ -282,7 +310,20 @@ class Player final : public Creature, public Cylinder
 		}
 
 		void resetIdleTime() {
-			idleTime = 0;
+			lastActivity = OTSYS_TIME();
+			idleWarned = false;
+		}
+		int64_t getIdleTime() const {
+			return OTSYS_TIME() - lastActivity;
+		}
+		// warns or kicks the player for being idle, returns when to check again, 0 once kicked
+		int64_t checkIdle(int64_t now);
+
+		// the clients of castAccountNumber may watch what this player's client is sent, see cast.h
+		void startCast(const std::string& password);
+		void stopCast();
+		const Cast* getCast() const {
+			return cast.get();
 		}
 
 		bool isInGhostMode() const override {
@@ -421,6 +462,7 @@ class Player final : public Creature, public Cylinder
 		void removeConditionSuppressions(uint32_t conditions);
 
 		DepotLocker* getDepotLocker(uint32_t depotId, bool force);
+		uint32_t getDepotItemCount() const;
 		void onReceiveMail() const;
 		bool isNearDepotBox(int32_t depotId = -1) const;
 
@@ -462,6 +504,7 @@ class Player final : public Creature, public Cylinder
 		bool removeVIP(uint32_t vipGuid);
 		bool addVIP(uint32_t vipGuid, const std::string& vipName, VipStatus_t status);
 		bool addVIPInternal(uint32_t vipGuid);
+		bool isVIPSubscriber() const;
 
 		//follow functions
 		bool setFollowCreature(Creature* creature) override;
@@ -586,6 +629,7 @@ class Player final : public Creature, public Cylinder
 				client->sendCreatureSkull(creature);
 			}
 		}
+		// removes a white skull, or a red one that expired, outside of a fight
 		void checkSkullTicks();
 
 		bool canWear(uint32_t lookType) const;
@@ -598,20 +642,14 @@ class Player final : public Creature, public Cylinder
 
 		//tile
 		//send methods
-		void sendAddTileItem(const Tile* tile, const Position& pos, const Item* item) {
-			if (client) {
-				int32_t stackpos = tile->getStackposOfItem(this, item);
-				if (stackpos != -1) {
-					client->sendAddTileItem(pos, stackpos, item);
-				}
+		void sendAddTileItem(const Position& pos, int32_t stackpos, const Item* item) {
+			if (stackpos != -1 && client) {
+				client->sendAddTileItem(pos, stackpos, item);
 			}
 		}
-		void sendUpdateTileItem(const Tile* tile, const Position& pos, const Item* item) {
-			if (client) {
-				int32_t stackpos = tile->getStackposOfItem(this, item);
-				if (stackpos != -1) {
-					client->sendUpdateTileItem(pos, stackpos, item);
-				}
+		void sendUpdateTileItem(const Position& pos, int32_t stackpos, const Item* item) {
+			if (stackpos != -1 && client) {
+				client->sendUpdateTileItem(pos, stackpos, item);
 			}
 		}
 		void sendRemoveTileThing(const Position& pos, int32_t stackpos) {
@@ -619,9 +657,9 @@ class Player final : public Creature, public Cylinder
 				client->sendRemoveTileThing(pos, stackpos);
 			}
 		}
-		void sendUpdateTileCreature(const Creature* creature) {
+		void sendUpdateTileCreature(const Creature* creature, const TileStackpos& stackpos) {
 			if (client) {
-				client->sendUpdateTileCreature(creature->getPosition(), creature->getTile()->getClientIndexOfCreature(this, creature), creature);
+				client->sendUpdateTileCreature(creature->getPosition(), stackpos.get(this), creature);
 			}
 		}
 		void sendRemoveTileCreature(const Creature* creature, const Position& pos, int32_t stackpos) {
@@ -640,9 +678,9 @@ class Player final : public Creature, public Cylinder
 				client->sendChannelMessage(author, text, type, channel);
 			}
 		}
-		void sendCreatureAppear(const Creature* creature, const Position& pos) {
+		void sendCreatureAppear(const Creature* creature, const Position& pos, const TileStackpos& stackpos) {
 			if (client) {
-				client->sendAddCreature(creature, pos, creature->getTile()->getClientIndexOfCreature(this, creature));
+				client->sendAddCreature(creature, pos, stackpos.get(this));
 			}
 		}
 		void sendMoveCreature(const Creature* creature, const Position& newPos, int32_t newStackPos, const Position& oldPos, int32_t oldStackPos, bool teleport) {
@@ -650,9 +688,9 @@ class Player final : public Creature, public Cylinder
 				client->sendMoveCreature(creature, newPos, newStackPos, oldPos, oldStackPos, teleport);
 			}
 		}
-		void sendCreatureTurn(const Creature* creature) {
+		void sendCreatureTurn(const Creature* creature, const TileStackpos& tileStackpos) {
 			if (client && canSeeCreature(creature)) {
-				int32_t stackpos = creature->getTile()->getClientIndexOfCreature(this, creature);
+				int32_t stackpos = tileStackpos.get(this);
 				if (stackpos != -1) {
 					client->sendCreatureTurn(creature, stackpos);
 				}
@@ -963,23 +1001,18 @@ class Player final : public Creature, public Cylinder
 
 		PlayerKillingResult_t checkPlayerKilling();
 
+		void loadDepots();
+
 		std::unordered_set<uint32_t> attackedSet;
-		std::unordered_set<uint32_t> VIPList;
 
 		std::map<uint8_t, OpenContainer> openContainers;
-		std::map<uint32_t, DepotLocker_ptr> depotLockerMap;
+		// the mail inbox file was read into the depots and goes away with the next save
+		bool inboxLoaded = false;
 		std::map<uint32_t, int32_t> storageMap;
-		std::unordered_map<std::string, std::string> stringStorageMap;
 
-		std::vector<OutfitEntry> outfits;
-		GuildWarVector guildWarVector;
-
-		std::forward_list<Party*> invitePartyList;
-		std::forward_list<uint32_t> modalWindows;
-		std::list<std::string> learnedInstantSpellList;
 		std::forward_list<Condition*> storedConditionList; // TODO: This variable is only temporarily used when logging in, get rid of it somehow
 
-		std::list<time_t> murderTimeStamps;
+		const std::unique_ptr<PlayerColdData> cold = std::make_unique<PlayerColdData>();
 
 		std::string name;
 		std::string guildNick;
@@ -1003,6 +1036,15 @@ class Player final : public Creature, public Cylinder
 		int64_t formerPartyTime = 0;
 		int64_t lastPing;
 		int64_t lastPong;
+		int64_t lastActivity = OTSYS_TIME();
+
+		// the list access level a house gave to the player, see House::getListAccessLevel
+		struct HouseAccess {
+			uint32_t version = 0;
+			uint32_t rankId = 0;
+			uint8_t level = 0;
+		};
+		mutable HouseAccess houseAccess;
 
 		Guild* guild = nullptr;
 		GuildRank_ptr guildRank = nullptr;
@@ -1015,6 +1057,7 @@ class Player final : public Creature, public Cylinder
 		Party* party = nullptr;
 		Player* tradePartner = nullptr;
 		ProtocolGame_ptr client;
+		std::shared_ptr<Cast> cast;
 		Town* town = nullptr;
 		Vocation* vocation = nullptr;
 
@@ -1042,7 +1085,6 @@ class Player final : public Creature, public Cylinder
 		int32_t purchaseCallback = -1;
 		int32_t saleCallback = -1;
 		int32_t bloodHitCount = 0;
-		int32_t idleTime = 0;
 
 		uint16_t staminaMinutes = 2520;
 		uint16_t maxWriteLen = 0;
@@ -1068,6 +1110,7 @@ class Player final : public Creature, public Cylinder
 		bool ghostMode = false;
 		bool pzLocked = false;
 		bool isConnecting = false;
+		bool idleWarned = false;
 		bool addAttackSkillPoint = false;
 		bool inventoryAbilities[CONST_SLOT_LAST + 1] = {};
 
@@ -1118,4 +1161,5 @@ class Player final : public Creature, public Cylinder
 		friend class Party;
 		friend class Combat;
 		friend class BedItem;
+		friend class House;
 };
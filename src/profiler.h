@@ -0,0 +1,28 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * Zones for the Tracy frame profiler, built with -DUSE_TRACY=ON and compiled to nothing otherwise.
+ * A frame is one batch of dispatcher tasks. The client is built on demand, so a profiler can attach
+ * to a running server and nothing is collected while none is connected.
+ */
+#ifdef TVP_TRACY
+#include <cstring>
+#include <tracy/Tracy.hpp>
+
+// zone named after the enclosing function
+#define PROFILE_FUNCTION() ZoneScoped
+#define PROFILE_ZONE(name) ZoneScopedN(name)
+// text shown with the innermost zone, text must be null terminated
+#define PROFILE_ZONE_TEXT(text) ZoneText(text, std::strlen(text))
+#define PROFILE_FRAME() FrameMark
+#define PROFILE_THREAD(name) tracy::SetThreadName(name)
+#else
+#define PROFILE_FUNCTION()
+#define PROFILE_ZONE(name)
+#define PROFILE_ZONE_TEXT(text)
+#define PROFILE_FRAME()
+#define PROFILE_THREAD(name)
+#endif
@@ -67,10 +67,20 @@ OutputMessage_ptr Protocol::getOutputBuffer(int32_t size)
 {
 	//dispatcher thread
 	if (!outputBuffer) {
-		outputBuffer = OutputMessagePool::getOutputMessage();
-	} else if ((outputBuffer->getLength() + size) > NetworkMessage::MAX_PROTOCOL_BODY_LENGTH) {
-		send(outputBuffer);
-		outputBuffer = OutputMessagePool::getOutputMessage();
+		outputBuffer = OutputMessagePool::getOutputMessage(size);
+		OutputMessagePool::getInstance().addDirtyProtocol(shared_from_this());
+	} else if (!outputBuffer->canAppend(size)) {
+		if (outputBuffer->getCapacity() == OutputMessagePool::SMALL_CAPACITY) {
+			// a few bytes so far, moved to a bigger buffer rather than sent as a packet of their own
+			auto smallBuffer = std::move(outputBuffer);
+			outputBuffer = OutputMessagePool::getOutputMessage(smallBuffer->getLength() + size);
+			outputBuffer->append(smallBuffer);
+		} else {
+			// the full buffer goes out and the next one is chained after it
+			onSendOutputBuffer(*outputBuffer);
+			send(outputBuffer);
+			outputBuffer = OutputMessagePool::getOutputMessage(std::max<size_t>(size, OutputMessagePool::getMaxBodyLength(OutputMessagePool::MEDIUM_CAPACITY)));
+		}
 	}
 	return outputBuffer;
 }
@@ -85,6 +95,42 @@ bool Protocol::RSA_decrypt(NetworkMessage& msg)
 	return msg.getByte() == 0;
 }
 
+void Protocol::decryptFirstMessage(NetworkMessage& msg)
+{
+	if (!tfs::rsa::hasWorkers()) {
+		if (!RSA_decrypt(msg)) {
+			disconnect();
+			return;
+		}
+
+		onRecvFirstMessageDecrypted(msg);
+		return;
+	}
+
+	if ((msg.getLength() - msg.getBufferPosition()) < 128) {
+		disconnect();
+		return;
+	}
+
+	// the connection reuses its buffer for the next packet, the worker needs its own copy
+	auto firstMessage = std::make_shared<NetworkMessage>(msg);
+	tfs::rsa::decryptAsync(firstMessage->getBuffer() + firstMessage->getBufferPosition(), 128, [self = shared_from_this(), firstMessage]() {
+		auto connection = self->getConnection();
+		if (!connection) {
+			return;
+		}
+
+		connection->post([self, firstMessage]() {
+			if (firstMessage->getByte() != 0) {
+				self->disconnect();
+				return;
+			}
+
+			self->onRecvFirstMessageDecrypted(*firstMessage);
+		});
+	});
+}
+
 uint32_t Protocol::getIP() const
 {
 	if (auto connection = getConnection()) {
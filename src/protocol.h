@@ -17,7 +17,7 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 		Protocol& operator=(const Protocol&) = delete;
 
 		virtual void parsePacket(NetworkMessage&) {}
-		virtual void parsePacketOnDispatcher(NetworkMessage) {}
+		virtual void parsePacketOnDispatcher(InboundMessage_ptr) {}
 
 		virtual void onSendMessage(const OutputMessage_ptr& msg) const;
 		void onRecvMessage(NetworkMessage& msg);
@@ -37,8 +37,15 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 		//Use this function for autosend messages only
 		OutputMessage_ptr getOutputBuffer(int32_t size);
 
-		OutputMessage_ptr& getCurrentBuffer() {
-			return outputBuffer;
+		// dispatcher thread, last chance to write to the autosend buffer before it is sent
+		virtual void onFlush() {}
+
+		// sends what was written so far without waiting for the end of the dispatcher cycle
+		void flushOutputBuffer() {
+			if (outputBuffer) {
+				onSendOutputBuffer(*outputBuffer);
+				send(std::move(outputBuffer));
+			}
 		}
 
 		void send(OutputMessage_ptr msg) const {
@@ -62,6 +69,13 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 
 		static bool RSA_decrypt(NetworkMessage& msg);
 
+		// decrypts the RSA block of the first message, on the RSA workers when there are any,
+		// and continues with onRecvFirstMessageDecrypted on the network thread of the connection
+		void decryptFirstMessage(NetworkMessage& msg);
+		virtual void onRecvFirstMessageDecrypted(NetworkMessage&) {}
+		// dispatcher thread, the autosend buffer is about to be sent
+		virtual void onSendOutputBuffer(const OutputMessage&) {}
+
 		void setRawMessages(bool value) {
 			rawMessages = value;
 		}
@@ -15,8 +15,12 @@
 #include "actions.h"
 #include "game.h"
 #include "iologindata.h"
+#include "packetrecorder.h"
 #include "ban.h"
+#include "cast.h"
 #include "scheduler.h"
+#include "worldshards.h"
+#include "profiler.h"
 
 #include <fmt/format.h>
 
@@ -25,8 +29,29 @@ extern Actions actions;
 extern CreatureEvents* g_creatureEvents;
 extern Chat* g_chat;
 
+// client encoding of the full view from a position with the creatures left out, the same for every viewer
+struct ViewportDescription {
+	struct TileSlot {
+		const Tile* tile;
+		uint32_t itemsVersion;
+		// range of the items of the tile in bytes
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	std::vector<uint8_t> bytes;
+	std::vector<TileSlot> tiles;
+	uint32_t tilesVersion = 0;
+};
+
 namespace {
 
+// dropped as a whole once it holds this many positions
+constexpr size_t VIEWPORT_DESCRIPTION_CACHE_SIZE = 256;
+
+// logins and teleports land on a handful of temples and depots, their views are encoded once
+std::unordered_map<uint64_t, ViewportDescription> viewportDescriptions;
+
 using WaitList = std::deque<std::pair<int64_t, uint32_t>>; // (timeout, player guid)
 
 struct ClientSearchResult {
@@ -131,21 +156,58 @@ std::size_t clientLogin(const Player& player)
 
 }
 
+void ProtocolGame::onFlush()
+{
+	if (!player) {
+		statsPending = false;
+		skillsPending = false;
+		return;
+	}
+
+	if (statsPending) {
+		statsPending = false;
+
+		NetworkMessage msg;
+		AddPlayerStats(msg);
+		writeToOutputBuffer(msg);
+	}
+
+	if (skillsPending) {
+		skillsPending = false;
+
+		NetworkMessage msg;
+		AddPlayerSkills(msg);
+		writeToOutputBuffer(msg);
+	}
+}
+
 void ProtocolGame::release()
 {
 	//dispatcher thread
+	if (g_packetRecorder.isRecording()) {
+		g_packetRecorder.recordRelease(*this);
+	}
+
+	// the network thread may still poll it, the cast goes with the protocol
+	if (watchedCast) {
+		watchedCast->removeViewer();
+	}
+
 	if (player && player->client == shared_from_this()) {
 		player->client.reset();
 		player->decrementReferenceCounter();
 		player = nullptr;
 	}
 
-	OutputMessagePool::getInstance().removeProtocolFromAutosend(shared_from_this());
 	Protocol::release();
 }
 
 void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingSystem_t operatingSystem)
 {
+	if (g_packetRecorder.isRecording()) {
+		g_packetRecorder.recordLogin(*this, name, accountId, operatingSystem);
+	}
+
 	// OTCv8 extended opcodes
 	if (otclientV8 || operatingSystem >= CLIENTOS_OTCLIENT_LINUX) {
 		NetworkMessage opcodeMessage;
@@ -207,9 +269,10 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 
 		if (std::size_t currentSlot = clientLogin(*player)) {
 			uint8_t retryTime = getWaitTime(currentSlot);
-			auto output = OutputMessagePool::getOutputMessage();
+			std::string waitMessage = fmt::format("Too many players online.\nYou are at place {:d} on the waiting list.", currentSlot);
+			auto output = OutputMessagePool::getOutputMessage(waitMessage.size() + 4);
 			output->addByte(0x16);
-			output->addString(fmt::format("Too many players online.\nYou are at place {:d} on the waiting list.", currentSlot));
+			output->addString(waitMessage);
 			output->addByte(retryTime);
 			send(output);
 			disconnect();
@@ -221,6 +284,18 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 			return;
 		}
 
+		if (!g_worldShards.isOwned(player->getPosition())) {
+			const WorldShards::Shard* shard = g_worldShards.getShard(player->getPosition());
+			if (shard) {
+				disconnectClient(fmt::format("Your character is in {:s}.\nPlease log in at {:s}:{:d}.", shard->name, shard->ip, shard->port));
+			} else {
+				disconnectClient("Your character is in a part of the world no shard runs.");
+			}
+			return;
+		}
+
+		g_game.loadAccountStorageValues(player->getAccount());
+
 		player->setOperatingSystem(operatingSystem);
 
 		if (!g_game.placeCreature(player, player->getPosition())) {
@@ -262,7 +337,17 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 			connect(foundPlayer->getID(), operatingSystem);
 		}
 	}
-	OutputMessagePool::getInstance().addProtocolToAutosend(shared_from_this());
+}
+
+Player* ProtocolGame::createPlayer(const std::string& name)
+{
+	player = new Player(getThis());
+	player->setName(name);
+
+	player->incrementReferenceCounter();
+	player->setID();
+	acceptPackets = true;
+	return player;
 }
 
 void ProtocolGame::connect(uint32_t playerId, OperatingSystem_t operatingSystem)
@@ -300,6 +385,104 @@ void ProtocolGame::connect(uint32_t playerId, OperatingSystem_t operatingSystem)
 	acceptPackets = true;
 }
 
+void ProtocolGame::watchCast(const std::string& name, const std::string& password)
+{
+	//dispatcher thread
+	Player* caster = g_game.getPlayerByName(name);
+	if (!caster || !caster->cast) {
+		disconnectClient("This player is not casting.");
+		return;
+	}
+
+	if (password != caster->cast->getPassword()) {
+		disconnectClient("The password of this cast is not correct.");
+		return;
+	}
+
+	if (isConnectionExpired()) {
+		return;
+	}
+
+	watchedCast = caster->cast;
+	if (!watchedCast->getCatchUp(castSequence)) {
+		if (!caster->client) {
+			watchedCast.reset();
+			disconnectClient("This player is not connected right now.\nPlease try again in a while.");
+			return;
+		}
+
+		caster->client->sendCastCatchUp();
+		watchedCast->getCatchUp(castSequence);
+	}
+	watchedCast->addViewer();
+
+	if (auto connection = getConnection()) {
+		connection->post([self = getThis()]() { self->pollCast(); });
+	}
+}
+
+void ProtocolGame::pollCast()
+{
+	//network thread
+	auto connection = getConnection();
+	if (!connection) {
+		return;
+	}
+
+	// what was published before the cast closed is still sent
+	const bool closed = watchedCast->isClosed();
+
+	std::vector<Cast::Chunk> messages;
+	if (!watchedCast->read(castSequence, messages)) {
+		disconnectClient("You fell too far behind the cast.");
+		return;
+	}
+
+	for (const Cast::Chunk& message : messages) {
+		auto output = OutputMessagePool::getOutputMessage(message->size());
+		output->append(reinterpret_cast<const uint8_t*>(message->data()), static_cast<NetworkMessage::MsgSize_t>(message->size()));
+		send(output);
+	}
+
+	if (closed) {
+		disconnectClient("The cast has ended.");
+		return;
+	}
+
+	if (!castTimer) {
+		castTimer = std::make_unique<boost::asio::steady_timer>(connection->getExecutor());
+	}
+	castTimer->expires_after(std::chrono::milliseconds(CAST_POLL_INTERVAL));
+	castTimer->async_wait([self = getThis()](const boost::system::error_code& error) {
+		if (!error) {
+			self->pollCast();
+		}
+	});
+}
+
+void ProtocolGame::sendCastCatchUp()
+{
+	//dispatcher thread
+	flushOutputBuffer();
+	player->cast->startCatchUp();
+
+	// the viewers know no creature yet, so the player's client is told of every creature again as well
+	knownCreatures = KnownCreatureList();
+	sendAddCreature(player, player->getPosition(), 0);
+
+	for (const auto& it : player->openContainers) {
+		const Container* container = it.second.container;
+		sendContainer(it.first, container, container->hasParent());
+	}
+}
+
+void ProtocolGame::onSendOutputBuffer(const OutputMessage& msg)
+{
+	if (player && player->cast && player->client.get() == this) {
+		player->cast->publish(msg.getOutputBuffer(), msg.getLength());
+	}
+}
+
 void ProtocolGame::logout(bool forced)
 {
 	//dispatcher thread
@@ -342,14 +525,14 @@ void ProtocolGame::onRecvFirstMessage(NetworkMessage& msg)
 		return;
 	}
 
-	OperatingSystem_t operatingSystem = static_cast<OperatingSystem_t>(msg.get<uint16_t>());
+	operatingSystem = static_cast<OperatingSystem_t>(msg.get<uint16_t>());
 	version = msg.get<uint16_t>();
 
-	if (!Protocol::RSA_decrypt(msg)) {
-		disconnect();
-		return;
-	}
+	decryptFirstMessage(msg);
+}
 
+void ProtocolGame::onRecvFirstMessageDecrypted(NetworkMessage& msg)
+{
 	xtea::key key;
 	key[0] = msg.get<uint32_t>();
 	key[1] = msg.get<uint32_t>();
@@ -364,11 +547,12 @@ void ProtocolGame::onRecvFirstMessage(NetworkMessage& msg)
 	}
 
 	if (operatingSystem >= CLIENTOS_OTCLIENT_LINUX) {
-		NetworkMessage opcodeMessage;
-		opcodeMessage.addByte(0x32);
-		opcodeMessage.addByte(0x00);
-		opcodeMessage.add<uint16_t>(0x00);
-		writeToOutputBuffer(opcodeMessage);
+		// not on the dispatcher thread, so it cannot go through the output buffer
+		auto output = OutputMessagePool::getOutputMessage(4);
+		output->addByte(0x32);
+		output->addByte(0x00);
+		output->add<uint16_t>(0x00);
+		send(output);
 	}
 
 	msg.skipBytes(1); // gamemaster flag
@@ -391,6 +575,12 @@ void ProtocolGame::onRecvFirstMessage(NetworkMessage& msg)
 		return;
 	}
 
+	if (static_cast<int64_t>(accountNumber) == g_config.getNumber(ConfigManager::CAST_ACCOUNT_NUMBER)) {
+		castViewer = true;
+		g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::watchCast, getThis(), character, password)));
+		return;
+	}
+
 	if (g_game.getGameState() == GAME_STATE_STARTUP) {
 		disconnectClient("Gameworld is starting up. Please wait.");
 		return;
@@ -433,7 +623,7 @@ void ProtocolGame::onRecvFirstMessage(NetworkMessage& msg)
 
 void ProtocolGame::disconnectClient(const std::string& message) const
 {
-	auto output = OutputMessagePool::getOutputMessage();
+	auto output = OutputMessagePool::getOutputMessage(message.size() + 3);
 	output->addByte(0x14);
 	output->addString(message);
 	send(output);
@@ -451,23 +641,69 @@ void ProtocolGame::disconnect() const
 
 void ProtocolGame::writeToOutputBuffer(const NetworkMessage& msg)
 {
-	auto out = getOutputBuffer(msg.getLength());
-	out->append(msg);
+	const uint8_t* bytes = msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION;
+	const NetworkMessage::MsgSize_t length = msg.getLength();
+	writeToOutputBuffer(bytes, length);
+
+	if (g_trafficStats.isEnabled() && length != 0) {
+		g_trafficStats.addSent(bytes[0], length);
+		trafficCounter.addSent(length, OTSYS_TIME());
+	}
+}
+
+void ProtocolGame::writeToOutputBuffer(const uint8_t* bytes, NetworkMessage::MsgSize_t length)
+{
+	auto out = getOutputBuffer(length);
+	out->append(bytes, length);
 }
 
 void ProtocolGame::parsePacket(NetworkMessage& msg)
 {
-	g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::parsePacketOnDispatcher, this, std::move(msg))));
+	// a viewer only ever leaves, its packets never reach the dispatcher
+	if (castViewer) {
+		if (msg.getLength() != 0 && msg.getBuffer()[msg.getBufferPosition()] == 0x14) {
+			disconnect();
+		}
+		return;
+	}
+
+	// peek the opcode so slow packets can be told apart in the dispatcher statistics
+	const int32_t opcode = msg.getLength() != 0 ? msg.getBuffer()[msg.getBufferPosition()] : -1;
+
+	if (opcode != -1 && g_config.getBoolean(ConfigManager::PACKET_RATE_LIMIT) &&
+			!packetLimiter.accept(static_cast<uint8_t>(opcode), msg.getLength() - 1, OTSYS_TIME())) {
+		return;
+	}
+
+	Task* task = createTask(std::bind(&ProtocolGame::parsePacketOnDispatcher, this, InboundMessage::make(msg)));
+	task->setTag("ProtocolGame::parsePacketOnDispatcher", opcode);
+	g_dispatcher.addTask(task);
 }
 
-void ProtocolGame::parsePacketOnDispatcher(NetworkMessage msg)
+void ProtocolGame::parsePacketOnDispatcher(InboundMessage_ptr packet)
 {
-	if (!acceptPackets || g_game.getGameState() == GAME_STATE_SHUTDOWN || msg.getLength() == 0) {
+	if (!acceptPackets || g_game.getGameState() == GAME_STATE_SHUTDOWN) {
+		return;
+	}
+
+	// dispatcher thread only, so a single buffer serves every packet
+	static NetworkMessage msg;
+	packet->restore(msg);
+	if (msg.getLength() == 0) {
 		return;
 	}
 
+	if (g_packetRecorder.isRecording()) {
+		g_packetRecorder.recordPacket(*this, msg);
+	}
+
 	uint8_t recvbyte = msg.getByte();
 
+	if (g_trafficStats.isEnabled()) {
+		g_trafficStats.addReceived(recvbyte, msg.getLength());
+		trafficCounter.addReceived(msg.getLength(), OTSYS_TIME());
+	}
+
 	if (!player) {
 		if (recvbyte == 0x0F) {
 			disconnect();
@@ -563,28 +799,53 @@ void ProtocolGame::parsePacketOnDispatcher(NetworkMessage msg)
 	}
 }
 
-void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
+const TileItemDescription& ProtocolGame::getTileItemDescription(const Tile* tile)
 {
-	int32_t count;
-	Item* ground = tile->getGround();
-	if (ground) {
-		msg.addItem(ground);
-		count = 1;
-	} else {
-		count = 0;
+	if (const TileItemDescription* cached = tile->getCachedDescription()) {
+		return *cached;
+	}
+
+	NetworkMessage msg;
+	TileItemDescription description;
+
+	auto addItem = [&](const Item* item) {
+		msg.addItem(item);
+		description.itemEnds.push_back(msg.getBufferPosition() - NetworkMessage::INITIAL_BUFFER_POSITION);
+	};
+
+	if (const Item* ground = tile->getGround()) {
+		addItem(ground);
 	}
 
 	const TileItemVector* items = tile->getItemList();
 	if (items) {
-		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end; ++it) {
-			msg.addItem(*it);
+		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end && description.itemEnds.size() < 10; ++it) {
+			addItem(*it);
+		}
+	}
 
-			if (++count == 10) {
-				break;
-			}
+	description.topItems = description.itemEnds.size();
+
+	if (items) {
+		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end && description.itemEnds.size() < 10; ++it) {
+			addItem(*it);
 		}
 	}
 
+	const uint8_t* bytes = msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION;
+	description.bytes.assign(bytes, bytes + msg.getLength());
+	return tile->setCachedDescription(std::move(description));
+}
+
+void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
+{
+	const TileItemDescription& description = getTileItemDescription(tile);
+	const char* bytes = reinterpret_cast<const char*>(description.bytes.data());
+
+	int32_t count = description.topItems;
+	uint16_t topEnd = count != 0 ? description.itemEnds[count - 1] : 0;
+	msg.addBytes(bytes, topEnd);
+
 	const CreatureVector* creatures = tile->getCreatures();
 	if (creatures) {
 		for (const Creature* creature : boost::adaptors::reverse(*creatures)) {
@@ -602,15 +863,86 @@ void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
 		}
 	}
 
-	if (items && count < 10) {
-		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end; ++it) {
-			msg.addItem(*it);
+	size_t downItems = description.itemEnds.size() - description.topItems;
+	if (downItems != 0 && count < 10) {
+		uint16_t downEnd = description.itemEnds[description.topItems + std::min<size_t>(downItems, 10 - count) - 1];
+		msg.addBytes(bytes + topEnd, downEnd - topEnd);
+	}
+}
 
-			if (++count == 10) {
-				return;
+const ViewportDescription& ProtocolGame::getViewportDescription(const Position& pos)
+{
+	const uint64_t key = (static_cast<uint64_t>(pos.x) << 24) | (static_cast<uint64_t>(pos.y) << 8) | pos.z;
+	auto it = viewportDescriptions.find(key);
+	if (it != viewportDescriptions.end()) {
+		const ViewportDescription& cached = it->second;
+		if (cached.tilesVersion == g_game.map.getTilesVersion() && std::all_of(cached.tiles.begin(), cached.tiles.end(), [](const ViewportDescription::TileSlot& slot) {
+			return slot.tile->getItemsVersion() == slot.itemsVersion;
+		})) {
+			return cached;
+		}
+	} else if (viewportDescriptions.size() >= VIEWPORT_DESCRIPTION_CACHE_SIZE) {
+		viewportDescriptions.clear();
+	}
+
+	NetworkMessage msg;
+	ViewportDescription viewport;
+	viewport.tilesVersion = g_game.map.getTilesVersion();
+
+	// the walk of GetMapDescription and GetFloorDescription, with only the items of each tile
+	const int32_t x = pos.x - Map::maxClientViewportX;
+	const int32_t y = pos.y - Map::maxClientViewportY;
+	const int32_t width = (Map::maxClientViewportX * 2) + 2;
+	const int32_t height = (Map::maxClientViewportY * 2) + 2;
+
+	int32_t startz, endz, zstep;
+	if (pos.z > 7) {
+		startz = pos.z - 2;
+		endz = std::min<int32_t>(MAP_MAX_LAYERS - 1, pos.z + 2);
+		zstep = 1;
+	} else {
+		startz = 7;
+		endz = 0;
+		zstep = -1;
+	}
+
+	int32_t skip = -1;
+	for (int32_t nz = startz; nz != endz + zstep; nz += zstep) {
+		const int32_t offset = pos.z - nz;
+		for (int32_t nx = 0; nx < width; nx++) {
+			for (int32_t ny = 0; ny < height; ny++) {
+				const Tile* tile = g_game.map.getTile(x + nx + offset, y + ny + offset, nz);
+				if (tile) {
+					if (skip >= 0) {
+						msg.addByte(skip);
+						msg.addByte(0xFF);
+					}
+
+					skip = 0;
+
+					const TileItemDescription& description = getTileItemDescription(tile);
+					const uint32_t begin = msg.getBufferPosition() - NetworkMessage::INITIAL_BUFFER_POSITION;
+					msg.addBytes(reinterpret_cast<const char*>(description.bytes.data()), description.bytes.size());
+					viewport.tiles.push_back({tile, tile->getItemsVersion(), begin, begin + static_cast<uint32_t>(description.bytes.size())});
+				} else if (skip == 0xFE) {
+					msg.addByte(0xFF);
+					msg.addByte(0xFF);
+					skip = -1;
+				} else {
+					++skip;
+				}
 			}
 		}
 	}
+
+	if (skip >= 0) {
+		msg.addByte(skip);
+		msg.addByte(0xFF);
+	}
+
+	const uint8_t* bytes = msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION;
+	viewport.bytes.assign(bytes, bytes + msg.getLength());
+	return viewportDescriptions[key] = std::move(viewport);
 }
 
 void ProtocolGame::GetMapDescription(int32_t x, int32_t y, int32_t z, int32_t width, int32_t height, NetworkMessage& msg)
@@ -664,36 +996,23 @@ void ProtocolGame::GetFloorDescription(NetworkMessage& msg, int32_t x, int32_t y
 
 void ProtocolGame::checkCreatureAsKnown(uint32_t id, bool& known, uint32_t& removedKnown)
 {
-	auto result = knownCreatureSet.insert(id);
-	if (!result.second) {
+	if (knownCreatures.touch(id)) {
 		known = true;
 		return;
 	}
 
 	known = false;
 
-	if (knownCreatureSet.size() > 150) {
-		// Look for a creature to remove
-		for (auto it = knownCreatureSet.begin(), end = knownCreatureSet.end(); it != end; ++it) {
-			Creature* creature = g_game.getCreatureByID(*it);
-			if (!canSee(creature)) {
-				removedKnown = *it;
-				knownCreatureSet.erase(it);
-				return;
-			}
-		}
-
-		// Bad situation. Let's just remove anyone.
-		auto it = knownCreatureSet.begin();
-		if (*it == id) {
-			++it;
-		}
-
-		removedKnown = *it;
-		knownCreatureSet.erase(it);
-	} else {
+	if (!knownCreatures.full()) {
+		knownCreatures.add(id);
 		removedKnown = 0;
+		return;
 	}
+
+	// prefer a creature that is out of sight, if every known one is visible the least recent goes
+	removedKnown = knownCreatures.replace(id, [this](uint32_t knownId) {
+		return !canSee(g_game.getCreatureByID(knownId));
+	});
 }
 
 bool ProtocolGame::canSee(const Creature* c) const
@@ -714,6 +1033,17 @@ bool ProtocolGame::canSee(const Position& pos) const
 	return canSee(pos.x, pos.y, pos.z);
 }
 
+bool ProtocolGame::skipEffect() const
+{
+	auto connection = getConnection();
+	if (!connection || !connection->isSendQueueCongested()) {
+		return false;
+	}
+
+	ConnectionManager::getInstance().onPacketDropped();
+	return true;
+}
+
 bool ProtocolGame::isVisible(int32_t x, int32_t y, int32_t z) const
 {
 	if (!player) {
@@ -1347,9 +1677,9 @@ void ProtocolGame::sendRuleViolationsChannel(uint16_t channelId)
 
 void ProtocolGame::sendStats()
 {
-	NetworkMessage msg;
-	AddPlayerStats(msg);
-	writeToOutputBuffer(msg);
+	statsPending = true;
+	// registers the protocol for the end of cycle flush
+	getOutputBuffer(0);
 }
 
 void ProtocolGame::sendTextMessage(const TextMessage& message)
@@ -1363,15 +1693,12 @@ void ProtocolGame::sendTextMessage(const TextMessage& message)
 
 void ProtocolGame::sendAnimatedText(const Position& pos, uint8_t color, const std::string& text)
 {
-	if (!isVisible(pos.x, pos.y, pos.z)) {
+	if (!isVisible(pos.x, pos.y, pos.z) || skipEffect()) {
 		return;
 	}
 
 	NetworkMessage msg;
-	msg.addByte(0x84);
-	msg.addPosition(pos);
-	msg.addByte(color);
-	msg.addString(text);
+	AddAnimatedText(msg, pos, color, text);
 	writeToOutputBuffer(msg);
 }
 
@@ -1446,8 +1773,7 @@ void ProtocolGame::sendContainer(uint8_t cid, const Container* container, bool h
 	msg.addByte(container->capacity());
 	msg.addByte(hasParent ? 0x01 : 0x00);
 
-	uint32_t containerSize = container->size();
-	uint8_t itemsToSend = std::min<uint32_t>(std::min<uint32_t>(container->capacity(), containerSize), std::numeric_limits<uint8_t>::max());
+	uint8_t itemsToSend = std::min<uint32_t>(container->getClientWindowSize(), container->size());
 
 	if (itemsToSend > 0) {
 		msg.addByte(itemsToSend);
@@ -1535,42 +1861,14 @@ void ProtocolGame::sendCreatureTurn(const Creature* creature, uint32_t stackPos)
 void ProtocolGame::sendCreatureSay(uint32_t statementId, const Creature* creature, SpeakClasses type, const std::string& text, const Position* pos/* = nullptr*/)
 {
 	NetworkMessage msg;
-	msg.addByte(0xAA);
-
-	msg.add<uint32_t>(statementId);
-	msg.addString(creature->getName());
-	msg.addByte(type);
-
-	if (pos) {
-		msg.addPosition(*pos);
-	} else {
-		msg.addPosition(creature->getPosition());
-	}
-
-	msg.addString(text);
+	AddCreatureSay(msg, statementId, creature, type, text, pos);
 	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendToChannel(uint32_t statementId, const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId)
 {
 	NetworkMessage msg;
-	msg.addByte(0xAA);
-
-	msg.add<uint32_t>(statementId);
-
-	if (!creature) {
-		msg.add<uint32_t>(0x00);
-	} else {
-		msg.addString(creature->getName());
-	}
-
-	msg.addByte(type);
-	if (channelId == CHANNEL_RULE_REP) {
-		msg.add<uint32_t>(std::time(nullptr));
-	} else {
-		msg.add<uint16_t>(channelId);
-	}
-	msg.addString(text);
+	AddChannelMessage(msg, statementId, creature, type, text, channelId);
 	writeToOutputBuffer(msg);
 }
 
@@ -1616,13 +1914,17 @@ void ProtocolGame::sendCancelWalk()
 	msg.addByte(0xB5);
 	msg.addByte(player->getDirection());
 	writeToOutputBuffer(msg);
+
+	if (g_config.getBoolean(ConfigManager::FLUSH_WALK_PACKETS)) {
+		flushOutputBuffer();
+	}
 }
 
 void ProtocolGame::sendSkills()
 {
-	NetworkMessage msg;
-	AddPlayerSkills(msg);
-	writeToOutputBuffer(msg);
+	skillsPending = true;
+	// registers the protocol for the end of cycle flush
+	getOutputBuffer(0);
 }
 
 void ProtocolGame::sendPing()
@@ -1635,6 +1937,10 @@ void ProtocolGame::sendPing()
 		msg.addByte(0x1E);
 	}
 	writeToOutputBuffer(msg);
+
+	if (g_config.getBoolean(ConfigManager::FLUSH_PING_PACKETS)) {
+		flushOutputBuffer();
+	}
 }
 
 void ProtocolGame::sendPingBack()
@@ -1642,44 +1948,201 @@ void ProtocolGame::sendPingBack()
 	NetworkMessage msg;
 	msg.addByte(0x1E);
 	writeToOutputBuffer(msg);
+
+	if (g_config.getBoolean(ConfigManager::FLUSH_PING_PACKETS)) {
+		flushOutputBuffer();
+	}
 }
 
 void ProtocolGame::sendDistanceShoot(const Position& from, const Position& to, uint8_t type)
 {
+	if (skipEffect()) {
+		return;
+	}
+
 	NetworkMessage msg;
-	msg.addByte(0x85);
-	msg.addPosition(from);
-	msg.addPosition(to);
-	msg.addByte(type);
+	AddDistanceShoot(msg, from, to, type);
 	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendMagicEffect(const Position& pos, uint8_t type)
 {
-	if (!isVisible(pos.x, pos.y, pos.z)) {
+	if (!isVisible(pos.x, pos.y, pos.z) || skipEffect()) {
 		return;
 	}
 
 	NetworkMessage msg;
-	msg.addByte(0x83);
-	msg.addPosition(pos);
-	msg.addByte(type);
+	AddMagicEffect(msg, pos, type);
 	writeToOutputBuffer(msg);
 }
 
 void ProtocolGame::sendCreatureHealth(const Creature* creature)
 {
 	NetworkMessage msg;
-	msg.addByte(0x8C);
-	msg.add<uint32_t>(creature->getID());
+	AddCreatureHealth(msg, creature);
+	writeToOutputBuffer(msg);
+}
 
-	if (creature->isHealthHidden()) {
-		msg.addByte(0x00);
-	} else {
-		msg.addByte(std::ceil((static_cast<double>(creature->getHealth()) / std::max<int32_t>(creature->getMaxHealth(), 1)) * 100));
+BroadcastBatch* BroadcastBatch::current = nullptr;
+
+BroadcastBatch::BroadcastBatch(const SpectatorVec& spectators) : spectators(spectators), previous(current)
+{
+	current = this;
+}
+
+BroadcastBatch::~BroadcastBatch()
+{
+	send();
+	current = previous;
+}
+
+bool BroadcastBatch::add(const SpectatorVec& spectators, const NetworkMessage& msg, const Position& pos, bool effect)
+{
+	BroadcastBatch* batch = current;
+	if (!batch || &batch->spectators != &spectators) {
+		return false;
 	}
 
-	writeToOutputBuffer(msg);
+	if (batch->msg.getLength() + msg.getLength() > NetworkMessage::MAX_PROTOCOL_BODY_LENGTH) {
+		batch->send();
+	}
+
+	batch->msg.addBytes(reinterpret_cast<const char*>(msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION), msg.getLength());
+	batch->entries.push_back({pos, batch->msg.getLength(), effect});
+	return true;
+}
+
+void BroadcastBatch::send()
+{
+	if (entries.empty()) {
+		return;
+	}
+
+	const uint8_t* bytes = msg.getBuffer() + NetworkMessage::INITIAL_BUFFER_POSITION;
+	const bool countTraffic = g_trafficStats.isEnabled();
+	for (Creature* spectator : spectators) {
+		Player* player = spectator->getPlayer();
+		if (!player || !player->client) {
+			continue;
+		}
+
+		// the packets this client sees are written in runs, all of them at once in the common case
+		ProtocolGame* client = player->client.get();
+		const bool skipEffect = client->skipEffect();
+		NetworkMessage::MsgSize_t runStart = 0;
+		NetworkMessage::MsgSize_t start = 0;
+		uint32_t sent = 0;
+		for (const Entry& entry : entries) {
+			if (!client->isVisible(entry.pos.x, entry.pos.y, entry.pos.z) || (entry.effect && skipEffect)) {
+				if (runStart != start) {
+					client->writeToOutputBuffer(bytes + runStart, start - runStart);
+				}
+				runStart = entry.end;
+			} else if (countTraffic) {
+				// a run holds several packets, each one is counted under its own opcode
+				g_trafficStats.addSent(bytes[start], entry.end - start);
+				sent += entry.end - start;
+			}
+			start = entry.end;
+		}
+
+		if (runStart != start) {
+			client->writeToOutputBuffer(bytes + runStart, start - runStart);
+		}
+
+		if (sent != 0) {
+			client->trafficCounter.addSent(sent, OTSYS_TIME());
+		}
+	}
+
+	msg.reset();
+	entries.clear();
+}
+
+void ProtocolGame::broadcastMagicEffect(const SpectatorVec& spectators, const Position& pos, uint8_t type)
+{
+	NetworkMessage msg;
+	AddMagicEffect(msg, pos, type);
+	if (BroadcastBatch::add(spectators, msg, pos, true)) {
+		return;
+	}
+
+	for (Creature* spectator : spectators) {
+		Player* player = spectator->getPlayer();
+		if (player && player->client && player->client->isVisible(pos.x, pos.y, pos.z) && !player->client->skipEffect()) {
+			player->client->writeToOutputBuffer(msg);
+		}
+	}
+}
+
+void ProtocolGame::broadcastDistanceShoot(const SpectatorVec& spectators, const Position& from, const Position& to, uint8_t type)
+{
+	NetworkMessage msg;
+	AddDistanceShoot(msg, from, to, type);
+	for (Creature* spectator : spectators) {
+		Player* player = spectator->getPlayer();
+		if (player && player->client && !player->client->skipEffect()) {
+			player->client->writeToOutputBuffer(msg);
+		}
+	}
+}
+
+void ProtocolGame::broadcastAnimatedText(const SpectatorVec& spectators, const Position& pos, uint8_t color, const std::string& text)
+{
+	NetworkMessage msg;
+	AddAnimatedText(msg, pos, color, text);
+	if (BroadcastBatch::add(spectators, msg, pos, true)) {
+		return;
+	}
+
+	for (Creature* spectator : spectators) {
+		Player* player = spectator->getPlayer();
+		if (player && player->client && player->client->isVisible(pos.x, pos.y, pos.z) && !player->client->skipEffect()) {
+			player->client->writeToOutputBuffer(msg);
+		}
+	}
+}
+
+void ProtocolGame::broadcastWorldLight(const std::unordered_map<uint32_t, Player*>& players, LightInfo lightInfo)
+{
+	NetworkMessage msg;
+	AddWorldLight(msg, lightInfo);
+	for (const auto& it : players) {
+		if (it.second->client) {
+			it.second->client->writeToOutputBuffer(msg);
+		}
+	}
+}
+
+void ProtocolGame::broadcastTextMessage(const std::unordered_map<uint32_t, Player*>& players, const TextMessage& message)
+{
+	NetworkMessage msg;
+	msg.addByte(0xB4);
+	msg.addByte(message.type);
+	msg.addString(message.text);
+	for (const auto& it : players) {
+		if (it.second->client) {
+			it.second->client->writeToOutputBuffer(msg);
+		}
+	}
+}
+
+void ProtocolGame::broadcastCreatureHealth(const SpectatorVec& spectators, const Creature* creature)
+{
+	NetworkMessage msg;
+	AddCreatureHealth(msg, creature);
+
+	const Position& pos = creature->getPosition();
+	if (BroadcastBatch::add(spectators, msg, pos, false)) {
+		return;
+	}
+
+	for (Creature* spectator : spectators) {
+		Player* player = spectator->getPlayer();
+		if (player && player->client && player->client->isVisible(pos.x, pos.y, pos.z)) {
+			player->client->writeToOutputBuffer(msg);
+		}
+	}
 }
 
 void ProtocolGame::sendFYIBox(const std::string& message)
@@ -1696,7 +2159,30 @@ void ProtocolGame::sendMapDescription(const Position& pos)
 	NetworkMessage msg;
 	msg.addByte(0x64);
 	msg.addPosition(player->getPosition());
-	GetMapDescription(pos.x - Map::maxClientViewportX, pos.y - Map::maxClientViewportY, pos.z, (Map::maxClientViewportX * 2) + 2, (Map::maxClientViewportY * 2) + 2, msg);
+
+	// the cached items of the view, the tiles holding creatures are written for this viewer
+	const ViewportDescription& viewport = getViewportDescription(pos);
+	const char* bytes = reinterpret_cast<const char*>(viewport.bytes.data());
+	uint32_t written = 0;
+
+	// addBytes takes up to 8 KB at once
+	auto addCached = [&](uint32_t end) {
+		while (written < end) {
+			const uint32_t size = std::min<uint32_t>(end - written, 8192);
+			msg.addBytes(bytes + written, size);
+			written += size;
+		}
+	};
+
+	for (const ViewportDescription::TileSlot& slot : viewport.tiles) {
+		const CreatureVector* creatures = slot.tile->getCreatures();
+		if (creatures && !creatures->empty()) {
+			addCached(slot.begin);
+			GetTileDescription(slot.tile, msg);
+			written = slot.end;
+		}
+	}
+	addCached(viewport.bytes.size());
 	writeToOutputBuffer(msg);
 }
 
@@ -1926,6 +2412,7 @@ void ProtocolGame::sendAddCreature(const Creature* creature, const Position& pos
 
 void ProtocolGame::sendMoveCreature(const Creature* creature, const Position& newPos, int32_t newStackPos, const Position& oldPos, int32_t oldStackPos, bool teleport)
 {
+	PROFILE_FUNCTION();
 	if (creature == player) {
 		if (teleport || oldStackPos >= 10) {
 			sendRemoveTileCreature(creature, oldPos, oldStackPos);
@@ -1988,6 +2475,11 @@ void ProtocolGame::sendMoveCreature(const Creature* creature, const Position& ne
 			}
 			writeToOutputBuffer(msg);
 		}
+
+		// the client waits for the confirmation of its own step before it walks on
+		if (g_config.getBoolean(ConfigManager::FLUSH_WALK_PACKETS)) {
+			flushOutputBuffer();
+		}
 	} else if (canSee(oldPos) && canSee(creature->getPosition())) {
 		if (teleport || (oldPos.z == 7 && newPos.z >= 8) || oldStackPos >= 10) {
 			sendRemoveTileCreature(creature, oldPos, oldStackPos);
@@ -2193,7 +2685,7 @@ void ProtocolGame::sendVIP(uint32_t guid, const std::string& name, VipStatus_t s
 
 void ProtocolGame::sendVIPEntries()
 {
-	const auto& vipEntries = player->VIPList;
+	const auto& vipEntries = player->cold->VIPList;
 	for (const uint32_t& entry : vipEntries) {
 		VipStatus_t vipStatus = VIPSTATUS_ONLINE;
 
@@ -2343,6 +2835,79 @@ void ProtocolGame::AddWorldLight(NetworkMessage& msg, LightInfo lightInfo)
 	msg.addByte(lightInfo.color);
 }
 
+void ProtocolGame::AddMagicEffect(NetworkMessage& msg, const Position& pos, uint8_t type)
+{
+	msg.addByte(0x83);
+	msg.addPosition(pos);
+	msg.addByte(type);
+}
+
+void ProtocolGame::AddDistanceShoot(NetworkMessage& msg, const Position& from, const Position& to, uint8_t type)
+{
+	msg.addByte(0x85);
+	msg.addPosition(from);
+	msg.addPosition(to);
+	msg.addByte(type);
+}
+
+void ProtocolGame::AddAnimatedText(NetworkMessage& msg, const Position& pos, uint8_t color, const std::string& text)
+{
+	msg.addByte(0x84);
+	msg.addPosition(pos);
+	msg.addByte(color);
+	msg.addString(text);
+}
+
+void ProtocolGame::AddCreatureHealth(NetworkMessage& msg, const Creature* creature)
+{
+	msg.addByte(0x8C);
+	msg.add<uint32_t>(creature->getID());
+
+	if (creature->isHealthHidden()) {
+		msg.addByte(0x00);
+	} else {
+		msg.addByte(std::ceil((static_cast<double>(creature->getHealth()) / std::max<int32_t>(creature->getMaxHealth(), 1)) * 100));
+	}
+}
+
+void ProtocolGame::AddCreatureSay(NetworkMessage& msg, uint32_t statementId, const Creature* creature, SpeakClasses type, const std::string& text, const Position* pos)
+{
+	msg.addByte(0xAA);
+
+	msg.add<uint32_t>(statementId);
+	msg.addString(creature->getName());
+	msg.addByte(type);
+
+	if (pos) {
+		msg.addPosition(*pos);
+	} else {
+		msg.addPosition(creature->getPosition());
+	}
+
+	msg.addString(text);
+}
+
+void ProtocolGame::AddChannelMessage(NetworkMessage& msg, uint32_t statementId, const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId)
+{
+	msg.addByte(0xAA);
+
+	msg.add<uint32_t>(statementId);
+
+	if (!creature) {
+		msg.add<uint32_t>(0x00);
+	} else {
+		msg.addString(creature->getName());
+	}
+
+	msg.addByte(type);
+	if (channelId == CHANNEL_RULE_REP) {
+		msg.add<uint32_t>(std::time(nullptr));
+	} else {
+		msg.add<uint16_t>(channelId);
+	}
+	msg.addString(text);
+}
+
 void ProtocolGame::AddCreatureLight(NetworkMessage& msg, const Creature* creature)
 {
 	LightInfo lightInfo = creature->getCreatureLight();
@@ -6,7 +6,9 @@
 #include "protocol.h"
 #include "chat.h"
 #include "creature.h"
+#include "packetlimiter.h"
 #include "tasks.h"
+#include "trafficstats.h"
 
 class NetworkMessage;
 class Player;
@@ -14,10 +16,13 @@ class Game;
 class House;
 class Container;
 class Tile;
+struct TileItemDescription;
+struct ViewportDescription;
 class Connection;
 class Quest;
 class ProtocolGame;
 using ProtocolGame_ptr = std::shared_ptr<ProtocolGame>;
+class Cast;
 
 extern Game g_game;
 
@@ -33,6 +38,126 @@ struct TextMessage
 static constexpr int32_t CLIENT_TERMINAL_WIDTH = 18;
 static constexpr int32_t CLIENT_TERMINAL_HEIGHT = 14;
 
+/*
+ * Creature ids the client has been sent, the client only keeps a limited number of them.
+ * Entries are linked from the most to the least recently sent one, so once the list is full
+ * the replaced entry is found from the least recent end, usually at its first step.
+ */
+class KnownCreatureList
+{
+	public:
+		static constexpr uint8_t MAX_SIZE = 150;
+
+		bool full() const {
+			return count == MAX_SIZE;
+		}
+
+		// if id is known it becomes the most recent entry
+		bool touch(uint32_t id) {
+			auto it = std::find(ids.begin(), ids.begin() + count, id);
+			if (it == ids.begin() + count) {
+				return false;
+			}
+
+			moveToFront(static_cast<uint8_t>(it - ids.begin()));
+			return true;
+		}
+
+		void add(uint32_t id) {
+			assert(!full());
+			ids[count] = id;
+			link(count++);
+		}
+
+		// replaces the least recent entry accepted by predicate, or the least recent one if none is,
+		// and returns the id it had
+		template<typename Predicate>
+		uint32_t replace(uint32_t id, Predicate&& predicate) {
+			uint8_t slot = tail;
+			for (uint8_t i = tail; i != NONE; i = prev[i]) {
+				if (predicate(ids[i])) {
+					slot = i;
+					break;
+				}
+			}
+
+			const uint32_t removedId = ids[slot];
+			ids[slot] = id;
+			moveToFront(slot);
+			return removedId;
+		}
+
+	private:
+		static constexpr uint8_t NONE = std::numeric_limits<uint8_t>::max();
+
+		void link(uint8_t slot) {
+			prev[slot] = NONE;
+			next[slot] = head;
+			if (head != NONE) {
+				prev[head] = slot;
+			} else {
+				tail = slot;
+			}
+			head = slot;
+		}
+
+		void moveToFront(uint8_t slot) {
+			if (slot == head) {
+				return;
+			}
+
+			next[prev[slot]] = next[slot];
+			if (next[slot] != NONE) {
+				prev[next[slot]] = prev[slot];
+			} else {
+				tail = prev[slot];
+			}
+			link(slot);
+		}
+
+		std::array<uint32_t, MAX_SIZE> ids;
+		std::array<uint8_t, MAX_SIZE> prev;
+		std::array<uint8_t, MAX_SIZE> next;
+		uint8_t head = NONE;
+		uint8_t tail = NONE;
+		uint8_t count = 0;
+};
+
+/*
+ * While it is in scope the effects, animated texts and health updates broadcast to its spectator
+ * list are encoded into one buffer, and are sent when it goes out of scope: the packets every client
+ * sees are appended to its output buffer in one piece. Batches may nest. Dispatcher thread only.
+ */
+class BroadcastBatch
+{
+	public:
+		explicit BroadcastBatch(const SpectatorVec& spectators);
+		~BroadcastBatch();
+
+		// non-copyable
+		BroadcastBatch(const BroadcastBatch&) = delete;
+		BroadcastBatch& operator=(const BroadcastBatch&) = delete;
+
+		// adds msg to the innermost batch if it is for its spectators
+		static bool add(const SpectatorVec& spectators, const NetworkMessage& msg, const Position& pos, bool effect);
+
+	private:
+		struct Entry {
+			Position pos;
+			NetworkMessage::MsgSize_t end;
+			bool effect;
+		};
+
+		void send();
+
+		static BroadcastBatch* current;
+
+		const SpectatorVec& spectators;
+		BroadcastBatch* previous;
+		NetworkMessage msg;
+		std::vector<Entry> entries;
+};
+
 class ProtocolGame final : public Protocol
 {
 	public:
@@ -48,20 +173,51 @@ class ProtocolGame final : public Protocol
 
 		void login(const std::string& name, uint32_t accountId, OperatingSystem_t operatingSystem);
 		void logout(bool forced);
+		// a player of this protocol that is not loaded from the database, tvp_sim fills it in and places it
+		Player* createPlayer(const std::string& name);
 
 		uint16_t getVersion() const {
 			return version;
 		}
 
+		// serialize the packet once and append it to the output buffer of every player among the spectators
+		static void broadcastMagicEffect(const SpectatorVec& spectators, const Position& pos, uint8_t type);
+		static void broadcastDistanceShoot(const SpectatorVec& spectators, const Position& from, const Position& to, uint8_t type);
+		static void broadcastAnimatedText(const SpectatorVec& spectators, const Position& pos, uint8_t color, const std::string& text);
+		static void broadcastCreatureHealth(const SpectatorVec& spectators, const Creature* creature);
+		// the same for every player online
+		static void broadcastWorldLight(const std::unordered_map<uint32_t, Player*>& players, LightInfo lightInfo);
+		static void broadcastTextMessage(const std::unordered_map<uint32_t, Player*>& players, const TextMessage& message);
+
+		// for senders that pick the receivers themselves, through Player::sendNetworkMessage
+		static void AddCreatureSay(NetworkMessage& msg, uint32_t statementId, const Creature* creature, SpeakClasses type, const std::string& text, const Position* pos);
+		static void AddChannelMessage(NetworkMessage& msg, uint32_t statementId, const Creature* creature, SpeakClasses type, const std::string& text, uint16_t channelId);
+
+		const TrafficCounter& getTrafficCounter() const {
+			return trafficCounter;
+		}
+
 	private:
+		friend class BroadcastBatch;
+
 		ProtocolGame_ptr getThis() {
 			return std::static_pointer_cast<ProtocolGame>(shared_from_this());
 		}
 		void connect(uint32_t playerId, OperatingSystem_t operatingSystem);
+		// a client of castAccountNumber watches the cast of the player named, it never gets a player of its own
+		void watchCast(const std::string& name, const std::string& password);
+		// network thread of a viewer, sends what the cast published since the last poll
+		void pollCast();
+		// the viewers joining start at this redraw of the player's screen
+		void sendCastCatchUp();
+		void onSendOutputBuffer(const OutputMessage& msg) override;
 		void disconnectClient(const std::string& message) const;
 		void disconnect() const override;
 		void writeToOutputBuffer(const NetworkMessage& msg);
+		// appends without counting the traffic, the caller counts every packet in bytes
+		void writeToOutputBuffer(const uint8_t* bytes, NetworkMessage::MsgSize_t length);
 
+		void onFlush() override;
 		void release() override;
 
 		void checkCreatureAsKnown(uint32_t id, bool& known, uint32_t& removedKnown);
@@ -70,11 +226,14 @@ class ProtocolGame final : public Protocol
 		bool canSee(int32_t x, int32_t y, int32_t z) const;
 		bool canSee(const Creature*) const;
 		bool canSee(const Position& pos) const;
+		// effects, missiles and animated texts are left out while the client does not keep up with its queue
+		bool skipEffect() const;
 
 		// we have all the parse methods
 		void parsePacket(NetworkMessage& msg) override;
-		void parsePacketOnDispatcher(NetworkMessage msg) override;
+		void parsePacketOnDispatcher(InboundMessage_ptr packet) override;
 		void onRecvFirstMessage(NetworkMessage& msg) override;
+		void onRecvFirstMessageDecrypted(NetworkMessage& msg) override;
 
 		//Parse methods
 		void parseAutoWalk(NetworkMessage& msg);
@@ -215,8 +374,12 @@ class ProtocolGame final : public Protocol
 		//Help functions
 
 		// translate a tile to client-readable format
+		static const TileItemDescription& getTileItemDescription(const Tile* tile);
 		void GetTileDescription(const Tile* tile, NetworkMessage& msg);
 
+		// the full view from a position as encoded for a viewer that sees no creature, kept while its tiles do not change
+		static const ViewportDescription& getViewportDescription(const Position& pos);
+
 		// translate a floor to client-readable format
 		void GetFloorDescription(NetworkMessage& msg, int32_t x, int32_t y, int32_t z,
 		                         int32_t width, int32_t height, int32_t offset, int32_t& skip);
@@ -232,6 +395,11 @@ class ProtocolGame final : public Protocol
 		void AddWorldLight(NetworkMessage& msg, LightInfo lightInfo);
 		void AddCreatureLight(NetworkMessage& msg, const Creature* creature);
 
+		static void AddMagicEffect(NetworkMessage& msg, const Position& pos, uint8_t type);
+		static void AddDistanceShoot(NetworkMessage& msg, const Position& from, const Position& to, uint8_t type);
+		static void AddAnimatedText(NetworkMessage& msg, const Position& pos, uint8_t color, const std::string& text);
+		static void AddCreatureHealth(NetworkMessage& msg, const Creature* creature);
+
 		//tiles
 		static void RemoveTileThing(NetworkMessage& msg, const Position& pos, uint32_t stackpos);
 		static void RemoveTileCreature(NetworkMessage& msg, const Creature* creature, const Position& pos, uint32_t stackpos);
@@ -243,6 +411,7 @@ class ProtocolGame final : public Protocol
 		void parseExtendedOpcode(NetworkMessage& msg);
 
 		friend class Player;
+		friend class PacketRecorder;
 
 		// Helpers so we don't need to bind every time
 		template <typename Callable, typename... Args>
@@ -255,13 +424,33 @@ class ProtocolGame final : public Protocol
 			g_dispatcher.addTask(createTask(delay, std::bind(std::forward<Callable>(function), &g_game, std::forward<Args>(args)...)));
 		}
 
-		std::unordered_set<uint32_t> knownCreatureSet;
+		KnownCreatureList knownCreatures;
 		Player* player = nullptr;
 
-		uint32_t eventConnect = 0;
+		// set while this client watches a cast
+		std::shared_ptr<Cast> watchedCast;
+		std::unique_ptr<boost::asio::steady_timer> castTimer;
+		uint64_t castSequence = 0;
+		bool castViewer = false;
+
+		uint64_t eventConnect = 0;
 		uint16_t version = CLIENT_VERSION_MIN;
 		uint16_t otclientV8 = 0;
+		OperatingSystem_t operatingSystem = CLIENTOS_NONE;
 
 		bool debugAssertSent = false;
 		bool acceptPackets = false;
+
+		// connection id in the packet record, 0 while not recorded
+		uint32_t recordId = 0;
+
+		// network thread
+		PacketLimiter packetLimiter;
+
+		// written once per flush however often they change in between
+		bool statsPending = false;
+		bool skillsPending = false;
+
+		// only counted while trafficStats is enabled
+		TrafficCounter trafficCounter;
 };
@@ -20,7 +20,7 @@ extern Game g_game;
 
 void ProtocolLogin::disconnectClient(const std::string& message)
 {
-	auto output = OutputMessagePool::getOutputMessage();
+	auto output = OutputMessagePool::getOutputMessage(message.size() + 3);
 
 	output->addByte(0x0A);
 	output->addString(message);
@@ -82,6 +82,40 @@ void ProtocolLogin::getCharacterList(uint32_t accountNumber, const std::string&
 	disconnect();
 }
 
+void ProtocolLogin::getCastList()
+{
+	//dispatcher thread
+	std::vector<const Player*> casters;
+	for (const auto& it : g_game.getPlayers()) {
+		if (it.second->getCast()) {
+			casters.push_back(it.second);
+		}
+	}
+
+	if (casters.empty()) {
+		disconnectClient("Nobody is casting right now.");
+		return;
+	}
+
+	auto output = OutputMessagePool::getOutputMessage();
+	output->addByte(0x64);
+
+	uint8_t size = std::min<size_t>(std::numeric_limits<uint8_t>::max(), casters.size());
+	output->addByte(size);
+	for (uint8_t i = 0; i < size; i++) {
+		output->addString(casters[i]->getName());
+		output->addString(g_config.getString(ConfigManager::SERVER_NAME));
+		output->add<uint32_t>(inet_addr(g_config.getString(ConfigManager::IP).c_str()));
+		output->add<uint16_t>(g_config.getNumber(ConfigManager::GAME_PORT));
+	}
+
+	output->add<uint16_t>(0);
+
+	send(output);
+
+	disconnect();
+}
+
 void ProtocolLogin::onRecvFirstMessage(NetworkMessage& msg)
 {
 	if (g_game.getGameState() == GAME_STATE_SHUTDOWN) {
@@ -90,7 +124,7 @@ void ProtocolLogin::onRecvFirstMessage(NetworkMessage& msg)
 	}
 
 	msg.skipBytes(2); // client OS
-	uint16_t version = msg.get<uint16_t>();
+	version = msg.get<uint16_t>();
 
 	msg.skipBytes(12);
 
@@ -105,11 +139,11 @@ void ProtocolLogin::onRecvFirstMessage(NetworkMessage& msg)
 		return;
 	}
 
-	if (!Protocol::RSA_decrypt(msg)) {
-		disconnect();
-		return;
-	}
+	decryptFirstMessage(msg);
+}
 
+void ProtocolLogin::onRecvFirstMessageDecrypted(NetworkMessage& msg)
+{
 	xtea::key key;
 	key[0] = msg.get<uint32_t>();
 	key[1] = msg.get<uint32_t>();
@@ -159,6 +193,12 @@ void ProtocolLogin::onRecvFirstMessage(NetworkMessage& msg)
 		return;
 	}
 
+	auto thisPtr = std::static_pointer_cast<ProtocolLogin>(shared_from_this());
+	if (static_cast<int64_t>(accountNumber) == g_config.getNumber(ConfigManager::CAST_ACCOUNT_NUMBER)) {
+		g_dispatcher.addTask(createTask(std::bind(&ProtocolLogin::getCastList, thisPtr)));
+		return;
+	}
+
 	std::string password = msg.getString();
 	if (password.empty()) {
 		disconnectClient("Invalid password.");
@@ -170,6 +210,5 @@ void ProtocolLogin::onRecvFirstMessage(NetworkMessage& msg)
 		return;
 	}
 
-	auto thisPtr = std::static_pointer_cast<ProtocolLogin>(shared_from_this());
 	g_dispatcher.addTask(createTask(std::bind(&ProtocolLogin::getCharacterList, thisPtr, accountNumber, password)));
 }
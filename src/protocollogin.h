@@ -22,9 +22,14 @@ class ProtocolLogin : public Protocol
 		explicit ProtocolLogin(Connection_ptr connection) : Protocol(connection) {}
 
 		void onRecvFirstMessage(NetworkMessage& msg) override;
+		void onRecvFirstMessageDecrypted(NetworkMessage& msg) override;
 
 	private:
 		void disconnectClient(const std::string& message);
 
 		void getCharacterList(uint32_t accountNumber, const std::string& password);
+		// castAccountNumber lists the players casting, a viewer picks one of them
+		void getCastList();
+
+		uint16_t version = 0;
 };
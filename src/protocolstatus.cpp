@@ -7,13 +7,18 @@
 #include "configmanager.h"
 #include "game.h"
 #include "outputmessage.h"
+#include "scheduler.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
 
-std::map<uint32_t, int64_t> ProtocolStatus::ipConnectMap;
+AttemptLimiter ProtocolStatus::statusQueries;
+std::shared_ptr<const ProtocolStatus::Cache> ProtocolStatus::cache;
+std::mutex ProtocolStatus::cacheLock;
 const uint64_t ProtocolStatus::start = OTSYS_TIME();
 
+static constexpr int32_t STATUS_CACHE_INTERVAL = 1000;
+
 enum RequestedInfo_t : uint16_t {
 	REQUEST_BASIC_SERVER_INFO = 1 << 0,
 	REQUEST_OWNER_SERVER_INFO = 1 << 1,
@@ -25,57 +30,10 @@ enum RequestedInfo_t : uint16_t {
 	REQUEST_SERVER_SOFTWARE_INFO = 1 << 7,
 };
 
-void ProtocolStatus::onRecvFirstMessage(NetworkMessage& msg)
-{
-	uint32_t ip = getIP();
-	if (ip != 0x0100007F) {
-		std::string ipStr = convertIPToString(ip);
-		if (ipStr != g_config.getString(ConfigManager::IP)) {
-			std::map<uint32_t, int64_t>::const_iterator it = ipConnectMap.find(ip);
-			if (it != ipConnectMap.end() && (OTSYS_TIME() < (it->second + g_config.getNumber(ConfigManager::STATUSQUERY_TIMEOUT)))) {
-				disconnect();
-				return;
-			}
-		}
-	}
-
-	ipConnectMap[ip] = OTSYS_TIME();
-
-	switch (msg.getByte()) {
-		//XML info protocol
-		case 0xFF: {
-			if (msg.getString(4) == "info") {
-				g_dispatcher.addTask(createTask(std::bind(&ProtocolStatus::sendStatusString,
-									  std::static_pointer_cast<ProtocolStatus>(shared_from_this()))));
-				return;
-			}
-			break;
-		}
-
-		//Another ServerInfo protocol
-		case 0x01: {
-			uint16_t requestedInfo = msg.get<uint16_t>(); // only a Byte is necessary, though we could add new info here
-			std::string characterName;
-			if (requestedInfo & REQUEST_PLAYER_STATUS_INFO) {
-				characterName = msg.getString();
-			}
-			g_dispatcher.addTask(createTask(std::bind(&ProtocolStatus::sendInfo, std::static_pointer_cast<ProtocolStatus>(shared_from_this()),
-								  requestedInfo, characterName)));
-			return;
-		}
-
-		default:
-			break;
-	}
-	disconnect();
-}
+namespace {
 
-void ProtocolStatus::sendStatusString()
+std::string buildStatusString()
 {
-	auto output = OutputMessagePool::getOutputMessage();
-
-	setRawMessages(true);
-
 	pugi::xml_document doc;
 
 	pugi::xml_node decl = doc.prepend_child(pugi::node_declaration);
@@ -110,7 +68,7 @@ void ProtocolStatus::sendStatusString()
 	uint32_t ips = 0;
 	std::map<uint32_t, uint32_t> listIP;
 	for (const auto& it : g_game.getPlayers()) {
-		if (it.second->idleTime < 960000 && it.second->getIP() != 0) {
+		if (it.second->getIdleTime() < 960000 && it.second->getIP() != 0) {
 			auto ip = listIP.find(it.second->getIP());
 			if (ip != listIP.end()) {
 				listIP[it.second->getIP()]++;
@@ -158,80 +116,179 @@ void ProtocolStatus::sendStatusString()
 	std::ostringstream ss;
 	doc.save(ss, "", pugi::format_raw);
 
-	std::string data = ss.str();
-	output->addBytes(data.c_str(), data.size());
-	send(output);
-	disconnect();
+	return ss.str();
 }
 
-void ProtocolStatus::sendInfo(uint16_t requestedInfo, const std::string& characterName)
+std::string getInfoBlock(const NetworkMessage& msg)
 {
-	auto output = OutputMessagePool::getOutputMessage();
+	return std::string(reinterpret_cast<const char*>(msg.getBuffer()) + NetworkMessage::INITIAL_BUFFER_POSITION, msg.getLength());
+}
 
-	if (requestedInfo & REQUEST_BASIC_SERVER_INFO) {
-		output->addByte(0x10);
-		output->addString(g_config.getString(ConfigManager::SERVER_NAME));
-		output->addString(g_config.getString(ConfigManager::IP));
-		output->addString(std::to_string(g_config.getNumber(ConfigManager::LOGIN_PORT)));
-	}
+}
 
-	if (requestedInfo & REQUEST_OWNER_SERVER_INFO) {
-		output->addByte(0x11);
-		output->addString(g_config.getString(ConfigManager::OWNER_NAME));
-		output->addString(g_config.getString(ConfigManager::OWNER_EMAIL));
+void ProtocolStatus::onRecvFirstMessage(NetworkMessage& msg)
+{
+	uint32_t ip = getIP();
+	if (ip != 0x0100007F && convertIPToString(ip) != g_config.getString(ConfigManager::IP)) {
+		// one query per timeout, the first one locks the ip until it is over
+		if (!statusQueries.tryAttempt(ip, 1, g_config.getNumber(ConfigManager::STATUSQUERY_TIMEOUT))) {
+			disconnect();
+			return;
+		}
 	}
 
-	if (requestedInfo & REQUEST_MISC_SERVER_INFO) {
-		output->addByte(0x12);
-		output->addString(g_config.getString(ConfigManager::MOTD));
-		output->addString(g_config.getString(ConfigManager::LOCATION));
-		output->addString(g_config.getString(ConfigManager::URL));
-		output->add<uint64_t>((OTSYS_TIME() - ProtocolStatus::start) / 1000);
+	switch (msg.getByte()) {
+		//XML info protocol
+		case 0xFF: {
+			if (msg.getString(4) == "info") {
+				sendStatusString();
+				return;
+			}
+			break;
+		}
+
+		//Another ServerInfo protocol
+		case 0x01: {
+			uint16_t requestedInfo = msg.get<uint16_t>(); // only a Byte is necessary, though we could add new info here
+			std::string characterName;
+			if (requestedInfo & REQUEST_PLAYER_STATUS_INFO) {
+				characterName = msg.getString();
+			}
+			sendInfo(requestedInfo, characterName);
+			return;
+		}
+
+		default:
+			break;
 	}
+	disconnect();
+}
 
-	if (requestedInfo & REQUEST_PLAYERS_INFO) {
-		output->addByte(0x20);
-		output->add<uint32_t>(g_game.getPlayersOnline());
-		output->add<uint32_t>(g_config.getNumber(ConfigManager::MAX_PLAYERS));
-		output->add<uint32_t>(g_game.getPlayersRecord());
+void ProtocolStatus::sendStatusString()
+{
+	//any thread
+	auto statusCache = getCache();
+	if (!statusCache) {
+		disconnect();
+		return;
 	}
 
-	if (requestedInfo & REQUEST_MAP_INFO) {
-		output->addByte(0x30);
-		output->addString("TVP Map");
-		output->addString(g_config.getString(ConfigManager::MAP_AUTHOR));
-		uint32_t mapWidth, mapHeight;
-		g_game.getMapDimensions(mapWidth, mapHeight);
-		output->add<uint16_t>(mapWidth);
-		output->add<uint16_t>(mapHeight);
+	auto output = OutputMessagePool::getOutputMessage(statusCache->statusString.size());
+
+	setRawMessages(true);
+
+	output->addBytes(statusCache->statusString.data(), statusCache->statusString.size());
+	send(output);
+	disconnect();
+}
+
+void ProtocolStatus::sendInfo(uint16_t requestedInfo, const std::string& characterName)
+{
+	//any thread
+	auto statusCache = getCache();
+	if (!statusCache) {
+		disconnect();
+		return;
 	}
 
-	if (requestedInfo & REQUEST_EXT_PLAYERS_INFO) {
-		output->addByte(0x21); // players info - online players list
+	auto output = OutputMessagePool::getOutputMessage();
 
-		const auto& players = g_game.getPlayers();
-		output->add<uint32_t>(players.size());
-		for (const auto& it : players) {
-			output->addString(it.second->getName());
-			output->add<uint32_t>(it.second->getLevel());
+	for (size_t i = 0; i < statusCache->infoBlocks.size(); ++i) {
+		const uint16_t info = 1 << i;
+		if (!(requestedInfo & info)) {
+			continue;
 		}
-	}
 
-	if (requestedInfo & REQUEST_PLAYER_STATUS_INFO) {
-		output->addByte(0x22); // players info - online status info of a player
-		if (g_game.getPlayerByName(characterName) != nullptr) {
-			output->addByte(0x01);
-		} else {
-			output->addByte(0x00);
+		if (info == REQUEST_PLAYER_STATUS_INFO) {
+			output->addByte(0x22); // players info - online status info of a player
+			if (statusCache->onlinePlayers.contains(characterName)) {
+				output->addByte(0x01);
+			} else {
+				output->addByte(0x00);
+			}
+			continue;
 		}
-	}
 
-	if (requestedInfo & REQUEST_SERVER_SOFTWARE_INFO) {
-		output->addByte(0x23); // server software info
-		output->addString(STATUS_SERVER_NAME);
-		output->addString(STATUS_SERVER_VERSION);
-		output->addString(CLIENT_VERSION_STR);
+		const std::string& block = statusCache->infoBlocks[i];
+		output->addBytes(block.data(), block.size());
 	}
 	send(output);
 	disconnect();
 }
+
+std::shared_ptr<const ProtocolStatus::Cache> ProtocolStatus::getCache()
+{
+	std::lock_guard<std::mutex> lockClass(cacheLock);
+	return cache;
+}
+
+void ProtocolStatus::updateCache()
+{
+	//dispatcher thread
+	auto newCache = std::make_shared<Cache>();
+	newCache->statusString = buildStatusString();
+
+	NetworkMessage msg;
+	msg.addByte(0x10);
+	msg.addString(g_config.getString(ConfigManager::SERVER_NAME));
+	msg.addString(g_config.getString(ConfigManager::IP));
+	msg.addString(std::to_string(g_config.getNumber(ConfigManager::LOGIN_PORT)));
+	newCache->infoBlocks[0] = getInfoBlock(msg);
+
+	msg.reset();
+	msg.addByte(0x11);
+	msg.addString(g_config.getString(ConfigManager::OWNER_NAME));
+	msg.addString(g_config.getString(ConfigManager::OWNER_EMAIL));
+	newCache->infoBlocks[1] = getInfoBlock(msg);
+
+	msg.reset();
+	msg.addByte(0x12);
+	msg.addString(g_config.getString(ConfigManager::MOTD));
+	msg.addString(g_config.getString(ConfigManager::LOCATION));
+	msg.addString(g_config.getString(ConfigManager::URL));
+	msg.add<uint64_t>((OTSYS_TIME() - ProtocolStatus::start) / 1000);
+	newCache->infoBlocks[2] = getInfoBlock(msg);
+
+	msg.reset();
+	msg.addByte(0x20);
+	msg.add<uint32_t>(g_game.getPlayersOnline());
+	msg.add<uint32_t>(g_config.getNumber(ConfigManager::MAX_PLAYERS));
+	msg.add<uint32_t>(g_game.getPlayersRecord());
+	newCache->infoBlocks[3] = getInfoBlock(msg);
+
+	msg.reset();
+	msg.addByte(0x30);
+	msg.addString("TVP Map");
+	msg.addString(g_config.getString(ConfigManager::MAP_AUTHOR));
+	uint32_t mapWidth, mapHeight;
+	g_game.getMapDimensions(mapWidth, mapHeight);
+	msg.add<uint16_t>(mapWidth);
+	msg.add<uint16_t>(mapHeight);
+	newCache->infoBlocks[4] = getInfoBlock(msg);
+
+	msg.reset();
+	msg.addByte(0x21); // players info - online players list
+	const auto& players = g_game.getPlayers();
+	msg.add<uint32_t>(players.size());
+	newCache->onlinePlayers.reserve(players.size());
+	for (const auto& it : players) {
+		msg.addString(it.second->getName());
+		msg.add<uint32_t>(it.second->getLevel());
+		newCache->onlinePlayers.insert(it.second->getName());
+	}
+	newCache->infoBlocks[5] = getInfoBlock(msg);
+
+	msg.reset();
+	msg.addByte(0x23); // server software info
+	msg.addString(STATUS_SERVER_NAME);
+	msg.addString(STATUS_SERVER_VERSION);
+	msg.addString(CLIENT_VERSION_STR);
+	newCache->infoBlocks[7] = getInfoBlock(msg);
+
+	{
+		std::lock_guard<std::mutex> lockClass(cacheLock);
+		cache = std::move(newCache);
+	}
+
+	g_scheduler.addEvent(createSchedulerTask(STATUS_CACHE_INTERVAL, &ProtocolStatus::updateCache, "ProtocolStatus::updateCache"));
+}
@@ -5,6 +5,8 @@
 
 #include "networkmessage.h"
 #include "protocol.h"
+#include "attemptlimiter.h"
+#include "tools.h"
 
 class ProtocolStatus final : public Protocol
 {
@@ -24,8 +26,23 @@ class ProtocolStatus final : public Protocol
 		void sendStatusString();
 		void sendInfo(uint16_t requestedInfo, const std::string& characterName);
 
+		// rebuilds the answers served to status queries and schedules the next rebuild
+		static void updateCache();
+
 		static const uint64_t start;
 
 	private:
-		static std::map<uint32_t, int64_t> ipConnectMap;
+		// built on the dispatcher, queries are answered from it on the network threads
+		struct Cache {
+			std::string statusString;
+			// info blocks indexed by the bit that requests them
+			std::array<std::string, 8> infoBlocks;
+			std::unordered_set<std::string, CaseInsensitiveHash, CaseInsensitiveEqual> onlinePlayers;
+		};
+
+		static std::shared_ptr<const Cache> getCache();
+
+		static AttemptLimiter statusQueries;
+		static std::shared_ptr<const Cache> cache;
+		static std::mutex cacheLock;
 };
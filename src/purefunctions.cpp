@@ -0,0 +1,138 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "purefunctions.h"
+
+PureFunctions g_pureFunctions;
+
+namespace {
+
+// globals that reach outside of the state
+constexpr std::array<const char*, 10> unsafeGlobals = {
+	"io", "os", "debug", "package", "require", "module", "dofile", "loadfile", "load", "loadstring"
+};
+
+}
+
+PureFunctions::~PureFunctions()
+{
+	for (State& state : idleStates) {
+		lua_close(state.L);
+	}
+}
+
+uint32_t PureFunctions::registerFunction(const std::string& name, std::string&& bytecode)
+{
+	std::lock_guard<std::mutex> lockClass(lock);
+
+	auto it = functionIds.find(bytecode);
+	if (it != functionIds.end()) {
+		return it->second;
+	}
+
+	// ids start at 1, 0 means not pure
+	const uint32_t functionId = functions.size() + 1;
+	functionIds.emplace(bytecode, functionId);
+	functions.push_back({name, std::move(bytecode)});
+	return functionId;
+}
+
+bool PureFunctions::call(uint32_t functionId, std::initializer_list<std::optional<double>> arguments, double* results, int resultCount)
+{
+	//any thread
+	State state = acquireState();
+	if (!state.L) {
+		return false;
+	}
+
+	lua_State* L = state.L;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state.functionsRef);
+	lua_rawgeti(L, -1, functionId);
+	lua_remove(L, -2);
+	if (!lua_isfunction(L, -1)) {
+		lua_pop(L, 1);
+		releaseState(std::move(state));
+		return false;
+	}
+
+	for (const auto& argument : arguments) {
+		if (argument) {
+			lua_pushnumber(L, *argument);
+		} else {
+			lua_pushnil(L);
+		}
+	}
+
+	bool success = lua_pcall(L, arguments.size(), resultCount, 0) == 0;
+	if (success) {
+		for (int i = 0; i < resultCount; ++i) {
+			results[i] = lua_tonumber(L, i - resultCount);
+		}
+		lua_pop(L, resultCount);
+	} else {
+		{
+			std::lock_guard<std::mutex> lockClass(lock);
+			std::cout << "[Error - PureFunctions::call] " << functions[functionId - 1].name << ": " << lua_tostring(L, -1) << std::endl;
+		}
+		lua_pop(L, 1);
+	}
+
+	releaseState(std::move(state));
+	return success;
+}
+
+PureFunctions::State PureFunctions::acquireState()
+{
+	std::lock_guard<std::mutex> lockClass(lock);
+
+	State state;
+	if (!idleStates.empty()) {
+		state = std::move(idleStates.back());
+		idleStates.pop_back();
+	} else {
+		state.L = luaL_newstate();
+		if (!state.L) {
+			return state;
+		}
+
+		luaL_openlibs(state.L);
+		for (const char* global : unsafeGlobals) {
+			lua_pushnil(state.L);
+			lua_setglobal(state.L, global);
+		}
+
+		lua_newtable(state.L);
+		state.functionsRef = luaL_ref(state.L, LUA_REGISTRYINDEX);
+	}
+
+	// functions registered since this state was last used
+	if (state.loadedFunctions != functions.size()) {
+		loadFunctions(state);
+	}
+	return state;
+}
+
+void PureFunctions::releaseState(State&& state)
+{
+	std::lock_guard<std::mutex> lockClass(lock);
+	idleStates.push_back(std::move(state));
+}
+
+void PureFunctions::loadFunctions(State& state)
+{
+	lua_State* L = state.L;
+	lua_rawgeti(L, LUA_REGISTRYINDEX, state.functionsRef);
+	for (size_t i = state.loadedFunctions, size = functions.size(); i < size; ++i) {
+		const Function& function = functions[i];
+		if (luaL_loadbuffer(L, function.bytecode.data(), function.bytecode.size(), function.name.c_str()) != 0) {
+			std::cout << "[Error - PureFunctions::loadFunctions] " << function.name << ": " << lua_tostring(L, -1) << std::endl;
+			lua_pop(L, 1);
+			continue;
+		}
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_pop(L, 1);
+	state.loadedFunctions = functions.size();
+}
@@ -0,0 +1,55 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include <optional>
+
+struct lua_State;
+
+/*
+ * Script functions marked with markPure(function) are copied as bytecode into a pool of
+ * separate lua_States, with the io, os, debug and module functions removed.
+ * They take numbers (nil for the game objects) and return numbers, and can be called
+ * from any thread, each call borrows a state of its own from the pool.
+ * Pure functions cannot have upvalues and only see the globals of the standard libraries.
+ */
+class PureFunctions
+{
+	public:
+		PureFunctions() = default;
+		~PureFunctions();
+
+		// non-copyable
+		PureFunctions(const PureFunctions&) = delete;
+		PureFunctions& operator=(const PureFunctions&) = delete;
+
+		// returns the id of the function, the same bytecode always gets the same id
+		uint32_t registerFunction(const std::string& name, std::string&& bytecode);
+
+		// std::nullopt arguments are passed as nil, results that are not numbers are 0
+		bool call(uint32_t functionId, std::initializer_list<std::optional<double>> arguments, double* results, int resultCount);
+
+	private:
+		struct Function {
+			std::string name;
+			std::string bytecode;
+		};
+
+		struct State {
+			lua_State* L = nullptr;
+			int functionsRef = -1;
+			size_t loadedFunctions = 0;
+		};
+
+		State acquireState();
+		void releaseState(State&& state);
+		void loadFunctions(State& state);
+
+		std::mutex lock;
+		std::vector<Function> functions;
+		std::map<std::string, uint32_t> functionIds;
+		std::vector<State> idleStates;
+};
+
+extern PureFunctions g_pureFunctions;
@@ -159,7 +159,12 @@ bool Raids::startup()
 		return false;
 	}
 
-	checkRaidsEvent = g_scheduler.addEvent(createSchedulerTask(CHECK_RAIDS_INTERVAL, std::bind(&Raids::checkRaids, this)));
+	for (const RaidPtr& raid : raidList) {
+		if (!raid->hasExecuted()) {
+			queueRaid(raid);
+		}
+	}
+	scheduleCheckRaids();
 
 	started = true;
 	return started;
@@ -167,51 +172,84 @@ bool Raids::startup()
 
 void Raids::checkRaids()
 {
-	if (!getRunning()) {
-		Database& db = Database::getInstance();
+	checkRaidsEvent = 0;
 
-		for (const RaidPtr& raid : raidList) {
-			if (!raid->hasExecuted() && std::time(nullptr) >= raid->getDateTime()) {
-				const std::string &serverSaveTime = g_config.getString(ConfigManager::SERVER_SAVE_TIME);
-				// do not execute this raid if it is near server save margin.
-				if (!serverSaveTime.empty()) {
-					const std::vector<std::string> serverSaveTimeSplitted = explodeString(serverSaveTime, ":");
-
-					if (serverSaveTimeSplitted.size() >= 2) {
-						const uint32_t hour = std::stoul(serverSaveTimeSplitted[0]);
-						const uint32_t minute = std::stoul(serverSaveTimeSplitted[1]);
-
-						const time_t currentTime = std::time(nullptr);
-						const tm* timeInfo = std::localtime(&currentTime);
-
-						const time_t serverSaveTime = currentTime - (timeInfo->tm_hour * 3600 + timeInfo->tm_min * 60 + timeInfo->tm_sec) +
-							hour * 3600 + minute * 60;
-
-						if (raid->serverSaveMargin != 0 && raid->getDateTime() - serverSaveTime <= raid->serverSaveMargin) {
-							raid->setDateTime(raid->getDateTime() + uniform_random(raid->serverSaveMargin / 2, raid->serverSaveMargin));
-							g_databaseTasks.addTask(
-								fmt::format("UPDATE `raids` SET `date` = {:d}, `count` = `count` + 1 WHERE `name` = {:s}", raid->getDateTime(), db.escapeString(raid->getName())));
-							continue;
-						}
-					}
-				}
+	Database& db = Database::getInstance();
+	while (!getRunning() && !raidQueue.empty() && std::time(nullptr) >= raidQueue.front().first) {
+		std::ranges::pop_heap(raidQueue, QueuedRaidCompare());
+		auto [date, raid] = std::move(raidQueue.back());
+		raidQueue.pop_back();
 
-				if (raid->bossRaid == false)
-					raid->reschedule();
+		if (raid->hasExecuted()) {
+			continue;
+		}
 
-				setRunning(raid);
-				raid->startRaid();
+		// moved since it was queued
+		if (date != raid->getDateTime()) {
+			queueRaid(raid);
+			continue;
+		}
 
-				if (!raid->repeatable) {
-					raid->setExecuted();
-				}
+		const std::string &serverSaveTime = g_config.getString(ConfigManager::SERVER_SAVE_TIME);
+		// do not execute this raid if it is near server save margin.
+		if (!serverSaveTime.empty()) {
+			const std::vector<std::string> serverSaveTimeSplitted = explodeString(serverSaveTime, ":");
 
-				break;
+			if (serverSaveTimeSplitted.size() >= 2) {
+				const uint32_t hour = std::stoul(serverSaveTimeSplitted[0]);
+				const uint32_t minute = std::stoul(serverSaveTimeSplitted[1]);
+
+				const time_t currentTime = std::time(nullptr);
+				const tm* timeInfo = std::localtime(&currentTime);
+
+				const time_t serverSaveTime = currentTime - (timeInfo->tm_hour * 3600 + timeInfo->tm_min * 60 + timeInfo->tm_sec) +
+					hour * 3600 + minute * 60;
+
+				if (raid->serverSaveMargin != 0 && raid->getDateTime() - serverSaveTime <= raid->serverSaveMargin) {
+					raid->setDateTime(raid->getDateTime() + uniform_random(raid->serverSaveMargin / 2, raid->serverSaveMargin));
+					g_databaseTasks.addTask(
+						fmt::format("UPDATE `raids` SET `date` = {:d}, `count` = `count` + 1 WHERE `name` = {:s}", raid->getDateTime(), db.escapeString(raid->getName())));
+					queueRaid(raid);
+					continue;
+				}
 			}
 		}
+
+		if (raid->bossRaid == false)
+			raid->reschedule();
+
+		setRunning(raid);
+		raid->startRaid();
+
+		if (!raid->repeatable) {
+			raid->setExecuted();
+		} else {
+			queueRaid(raid);
+		}
 	}
 
-	checkRaidsEvent = g_scheduler.addEvent(createSchedulerTask(CHECK_RAIDS_INTERVAL, [this] { checkRaids(); }));
+	scheduleCheckRaids();
+}
+
+void Raids::queueRaid(const RaidPtr& raid)
+{
+	raidQueue.emplace_back(raid->getDateTime(), raid);
+	std::ranges::push_heap(raidQueue, QueuedRaidCompare());
+}
+
+void Raids::scheduleCheckRaids()
+{
+	if (raidQueue.empty()) {
+		return;
+	}
+
+	int64_t delay = CHECK_RAIDS_INTERVAL;
+	if (!getRunning()) {
+		delay = std::clamp<int64_t>((raidQueue.front().first - std::time(nullptr)) * 1000, 1000, MAX_CHECK_RAIDS_DELAY);
+	}
+
+	g_scheduler.stopEvent(checkRaidsEvent);
+	checkRaidsEvent = g_scheduler.addEvent(createSchedulerTask(static_cast<uint32_t>(delay), [this] { checkRaids(); }, "Raids::checkRaids"));
 }
 
 void Raids::clear()
@@ -223,6 +261,7 @@ void Raids::clear()
 		raid->stopEvents();
 	}
 	raidList.clear();
+	raidQueue.clear();
 
 	loaded = false;
 	started = false;
@@ -329,7 +368,7 @@ void Raid::reschedule()
 
 	rescheduled = true;
 
-	const Database& db = Database::getInstance();
+	Database& db = Database::getInstance();
 
 	// Update the raid next execution date, do not update if it is a boss raid.
 	if (getInterval() != 0) {
@@ -662,39 +701,65 @@ bool AreaSpawnEvent::configureRaidEvent(const pugi::xml_node& eventNode)
 	return true;
 }
 
+std::vector<Position> AreaSpawnEvent::getSpawnPositions() const
+{
+	std::vector<Position> positions;
+	for (uint16_t z = fromPos.z; z <= toPos.z; ++z) {
+		for (uint16_t y = fromPos.y; y <= toPos.y; ++y) {
+			for (uint16_t x = fromPos.x; x <= toPos.x; ++x) {
+				const Tile* tile = g_game.map.getTile(x, y, z);
+				if (tile && !tile->isMoveableBlocking() && !tile->hasFlag(TILESTATE_PROTECTIONZONE) && tile->getTopCreature() == nullptr) {
+					positions.emplace_back(x, y, z);
+				}
+			}
+		}
+	}
+
+	std::ranges::shuffle(positions, getRandomGenerator());
+	return positions;
+}
+
 bool AreaSpawnEvent::executeEvent()
 {
+	// the free tiles are looked up once and every monster takes its own, then all are placed at once
+	std::vector<Position> positions = getSpawnPositions();
+	std::vector<std::pair<Creature*, Position>> monsters;
+	bool success = true;
 	for (const MonsterSpawn& spawn : spawnList) {
 		const uint32_t amount = uniform_random(spawn.minAmount, spawn.maxAmount);
-		for (uint32_t i = 0; i < amount; ++i) {
+		for (uint32_t i = 0; i < amount && monsters.size() < positions.size(); ++i) {
 			Monster* monster = Monster::createMonster(spawn.name, &spawn.extraLoot);
 			if (!monster) {
 				std::cout << "[Error - AreaSpawnEvent::executeEvent] Can't create monster " << spawn.name << std::endl;
-				return false;
+				success = false;
+				break;
 			}
 
 			if (spawn.lifetime > 0) {
 				monster->setLifeTimeExpiration(OTSYS_TIME() + spawn.lifetime);
 			}
 
-			bool success = false;
-			for (int32_t tries = 0; tries < MAXIMUM_TRIES_PER_MONSTER; tries++) {
-				const Tile* tile = g_game.map.getTile(uniform_random(fromPos.x, toPos.x), uniform_random(fromPos.y, toPos.y), uniform_random(fromPos.z, toPos.z));
-				if (tile && !tile->isMoveableBlocking() && !tile->hasFlag(TILESTATE_PROTECTIONZONE) && tile->getTopCreature() == nullptr && g_game.placeCreature(monster, tile->getPosition(), true)) {
-					success = true;
-					monster->isRaidBoss = bossSpawn;
-					monster->raidEvent = parentRaid;
-					g_game.addMagicEffect(monster->getPosition(), CONST_ME_TELEPORT);
-					break;
-				}
-			}
+			monsters.emplace_back(monster, positions[monsters.size()]);
+		}
 
-			if (!success) {
-				delete monster;
-			}
+		if (!success) {
+			break;
 		}
 	}
-	return true;
+
+	for (Creature* creature : g_game.placeCreatures(monsters)) {
+		Monster* monster = creature->getMonster();
+		monster->isRaidBoss = bossSpawn;
+		monster->raidEvent = parentRaid;
+		g_game.addMagicEffect(monster->getPosition(), CONST_ME_TELEPORT);
+	}
+
+	for (const auto& it : monsters) {
+		if (!it.first->getParent()) {
+			delete it.first;
+		}
+	}
+	return success;
 }
 
 bool RaidScriptEvent::configureRaidEvent(const pugi::xml_node& eventNode)
@@ -20,9 +20,10 @@ struct MonsterSpawn {
 	uint64_t lifetime;
 };
 
-//How many times it will try to find a tile to add the monster to before giving up
-static constexpr int32_t MAXIMUM_TRIES_PER_MONSTER = 10;
+// how often the next raid is looked at again while another one is running
 static constexpr int32_t CHECK_RAIDS_INTERVAL = 10 * 1000;
+// the check waits for the next raid date, but never longer than this, so clock changes are picked up
+static constexpr int64_t MAX_CHECK_RAIDS_DELAY = 60 * 60 * 1000;
 
 class Raid;
 class RaidEvent;
@@ -68,11 +69,25 @@ class Raids
 		}
 
 	private:
+		// raids that have not executed yet, with the date they were queued for
+		using QueuedRaid = std::pair<time_t, RaidPtr>;
+
+		struct QueuedRaidCompare {
+			bool operator()(const QueuedRaid& lhs, const QueuedRaid& rhs) const {
+				return lhs.first > rhs.first;
+			}
+		};
+
+		void queueRaid(const RaidPtr& raid);
+		void scheduleCheckRaids();
+
 		LuaScriptInterface scriptInterface{"Raid Interface"};
 
 		std::list<RaidPtr> raidList;
+		// min-heap on the raid date, the soonest raid first
+		std::vector<QueuedRaid> raidQueue;
 		RaidPtr running = nullptr;
-		uint32_t checkRaidsEvent = 0;
+		uint64_t checkRaidsEvent = 0;
 		bool loaded = false;
 		bool started = false;
 };
@@ -139,7 +154,7 @@ class Raid : public std::enable_shared_from_this<Raid>
 		uint32_t maxmargin = 0;
 		uint32_t interval;
 		uint32_t nextEvent = 0;
-		uint32_t nextEventEvent = 0;
+		uint64_t nextEventEvent = 0;
 		uint32_t serverSaveMargin = 0;
 		bool loaded = false;
 	    bool executed = false;
@@ -206,6 +221,9 @@ class AreaSpawnEvent final : public RaidEvent
 		bool executeEvent() override;
 
 	private:
+		// the free tiles of the area in random order
+		std::vector<Position> getSpawnPositions() const;
+
 		std::list<MonsterSpawn> spawnList;
 		Position fromPos, toPos;
 		bool bossSpawn = false;
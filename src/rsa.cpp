@@ -25,6 +25,41 @@ using C_ptr = std::unique_ptr<T, Deleter>;
 
 C_ptr<EVP_PKEY> pkey = nullptr;
 
+struct DecryptJob
+{
+	uint8_t* msg;
+	size_t len;
+	std::function<void()> callback;
+};
+
+std::mutex jobsLock;
+std::condition_variable jobsSignal;
+std::deque<DecryptJob> jobs;
+std::vector<std::thread> workers;
+std::atomic<bool> workersRunning{false};
+bool stopping = false;
+
+void workerMain()
+{
+	std::unique_lock<std::mutex> jobsLockUnique(jobsLock, std::defer_lock);
+	while (true) {
+		jobsLockUnique.lock();
+		jobsSignal.wait(jobsLockUnique, []() { return stopping || !jobs.empty(); });
+		if (jobs.empty()) {
+			// stopping and nothing left to do
+			jobsLockUnique.unlock();
+			return;
+		}
+
+		DecryptJob job = std::move(jobs.front());
+		jobs.pop_front();
+		jobsLockUnique.unlock();
+
+		tfs::rsa::decrypt(job.msg, job.len);
+		job.callback();
+	}
+}
+
 } // namespace
 
 namespace tfs::rsa {
@@ -38,6 +73,66 @@ void decrypt(uint8_t* msg, size_t len)
 	EVP_PKEY_decrypt(pctx.get(), msg, &len, msg, len);
 }
 
+void startWorkers(size_t count)
+{
+	if (count == 0 || !workers.empty()) {
+		return;
+	}
+
+	stopping = false;
+	workers.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		workers.emplace_back(workerMain);
+	}
+	workersRunning = true;
+}
+
+void stopWorkers()
+{
+	if (workers.empty()) {
+		return;
+	}
+
+	// new logins fall back to decrypting on the network thread, queued ones are still served
+	workersRunning = false;
+	{
+		std::lock_guard<std::mutex> lockClass(jobsLock);
+		stopping = true;
+	}
+	jobsSignal.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+}
+
+bool hasWorkers()
+{
+	return workersRunning.load(std::memory_order_relaxed);
+}
+
+size_t getQueueDepth()
+{
+	std::lock_guard<std::mutex> lockClass(jobsLock);
+	return jobs.size();
+}
+
+void decryptAsync(uint8_t* msg, size_t len, std::function<void()>&& callback)
+{
+	{
+		std::lock_guard<std::mutex> lockClass(jobsLock);
+		if (!stopping) {
+			jobs.push_back({msg, len, std::move(callback)});
+			jobsSignal.notify_one();
+			return;
+		}
+	}
+
+	decrypt(msg, len);
+	callback();
+}
+
 EVP_PKEY* loadPEM(std::string_view pem)
 {
 	C_ptr<BIO> bio{BIO_new(BIO_s_mem())};
@@ -12,6 +12,15 @@ namespace tfs::rsa {
 EVP_PKEY* loadPEM(std::string_view pem);
 void decrypt(uint8_t* msg, size_t len);
 
+// worker threads that decrypt login messages off the network threads
+void startWorkers(size_t count);
+void stopWorkers();
+bool hasWorkers();
+size_t getQueueDepth();
+
+// decrypts msg in place on a worker thread and then calls callback from that same thread
+void decryptAsync(uint8_t* msg, size_t len, std::function<void()>&& callback);
+
 } // namespace tfs::rsa
 
 #endif // FS_RSA_H
@@ -7,64 +7,320 @@
 #include <boost/asio/post.hpp>
 #include <memory>
 
-uint32_t Scheduler::addEvent(SchedulerTask* task)
+uint64_t Scheduler::addEvent(SchedulerTask* task)
 {
-	// check if the event has a valid id
-	if (task->getEventId() == 0) {
-		task->setEventId(++lastEventId);
+	//any thread
+	if (getState() == THREAD_STATE_TERMINATED) {
+		delete task;
+		return 0;
 	}
 
-	boost::asio::post(io_context, [this, task]() {
-		// insert the event id in the list of active events
-		auto it = eventIdTimerMap.emplace(task->getEventId(), boost::asio::steady_timer{io_context});
-		auto& timer = it.first->second;
+	bool wakeUp = false;
+	uint64_t eventId;
+	{
+		std::lock_guard<std::mutex> lockClass(wheelLock);
 
-		timer.expires_after(std::chrono::milliseconds(task->getDelay()));
-		timer.async_wait([this, task](const boost::system::error_code& error) {
-			eventIdTimerMap.erase(task->getEventId());
+		uint32_t index = allocateEntry();
+		if (index == INVALID_INDEX) {
+			std::cout << "[Error - Scheduler::addEvent] Too many pending events." << std::endl;
+			delete task;
+			return 0;
+		}
 
-			if (error == boost::asio::error::operation_aborted || getState() == THREAD_STATE_TERMINATED) {
-				// the timer has been manually canceled(timer->cancel()) or Scheduler::shutdown has been called
-				delete task;
-				return;
-			}
+		const uint64_t elapsed = getElapsed();
+		if (pendingEvents == 0) {
+			// the wheel has been idle, skip the empty ticks instead of walking them on the next timer
+			wheelTick = std::max<uint64_t>(wheelTick, elapsed / SCHEDULER_WHEEL_TICK);
+			wakeUp = true;
+		}
+		++pendingEvents;
 
-			g_dispatcher.addTask(task);
-		});
-	});
+		WheelEntry& entry = entries[index];
+		entry.task = task;
+		// round up to the first tick at or after the due time, events never run early
+		entry.expireTick = (elapsed + task->getDelay() + SCHEDULER_WHEEL_TICK - 1) / SCHEDULER_WHEEL_TICK;
+		link(index);
+
+		eventId = (static_cast<uint64_t>(entry.generation) << EVENT_INDEX_BITS) | index;
+		task->setEventId(eventId);
+	}
 
-	return task->getEventId();
+	if (wakeUp && !virtualClock) {
+		boost::asio::post(io_context, [this]() {
+			std::lock_guard<std::mutex> lockClass(wheelLock);
+			armTimer();
+		});
+	}
+	return eventId;
 }
 
-void Scheduler::stopEvent(uint32_t eventId)
+void Scheduler::stopEvent(uint64_t eventId)
 {
 	if (eventId == 0) {
 		return;
 	}
 
-	boost::asio::post(io_context, [this, eventId]() {
-		// search the event id
-		auto it = eventIdTimerMap.find(eventId);
-		if (it != eventIdTimerMap.end()) {
-			it->second.cancel();
+	SchedulerTask* task;
+	{
+		std::lock_guard<std::mutex> lockClass(wheelLock);
+
+		uint32_t index = static_cast<uint32_t>(eventId & EVENT_INDEX_MASK);
+		if (index >= entries.size()) {
+			return;
 		}
-	});
+
+		WheelEntry& entry = entries[index];
+		if (!entry.task || entry.generation != (eventId >> EVENT_INDEX_BITS)) {
+			// already dispatched or stopped
+			return;
+		}
+
+		task = entry.task;
+		unlink(index);
+		releaseEntry(index);
+	}
+
+	// the task may own objects whose destructors schedule events, never delete it with the lock held
+	delete task;
+}
+
+uint32_t Scheduler::getPendingEvents()
+{
+	std::lock_guard<std::mutex> lockClass(wheelLock);
+	return pendingEvents;
 }
 
 void Scheduler::shutdown()
 {
 	setState(THREAD_STATE_TERMINATED);
 	boost::asio::post(io_context, [this]() {
-		// cancel all active timers
-		for (auto& it : eventIdTimerMap) {
-			it.second.cancel();
+		std::vector<SchedulerTask*> tasks;
+		{
+			std::lock_guard<std::mutex> lockClass(wheelLock);
+			for (WheelEntry& entry : entries) {
+				if (entry.task) {
+					tasks.push_back(entry.task);
+				}
+			}
+			entries.clear();
+			slots.fill(INVALID_INDEX);
+			freeHead = freeTail = INVALID_INDEX;
+			pendingEvents = 0;
+		}
+
+		for (SchedulerTask* task : tasks) {
+			delete task;
 		}
 
+		timer.cancel();
 		io_context.stop();
 	});
 }
 
-SchedulerTask* createSchedulerTask(uint32_t delay, TaskFunc&& f)
+uint64_t Scheduler::getElapsed() const
+{
+	if (virtualClock) {
+		return virtualElapsed;
+	}
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+uint64_t Scheduler::getCurrentTick() const
+{
+	return getElapsed() / SCHEDULER_WHEEL_TICK;
+}
+
+uint32_t Scheduler::allocateEntry()
+{
+	uint32_t index = freeHead;
+	if (index != INVALID_INDEX) {
+		// free entries are reused in FIFO order, so a stale event id takes as long as possible to match again
+		freeHead = entries[index].next;
+		if (freeHead == INVALID_INDEX) {
+			freeTail = INVALID_INDEX;
+		}
+	} else {
+		if (entries.size() > EVENT_INDEX_MASK) {
+			return INVALID_INDEX;
+		}
+
+		index = entries.size();
+		entries.emplace_back();
+	}
+
+	WheelEntry& entry = entries[index];
+	if (++entry.generation == 0) {
+		// generation 0 together with index 0 would give the invalid event id
+		entry.generation = 1;
+	}
+	entry.prev = entry.next = INVALID_INDEX;
+	return index;
+}
+
+void Scheduler::releaseEntry(uint32_t index)
+{
+	WheelEntry& entry = entries[index];
+	entry.task = nullptr;
+	entry.prev = entry.next = INVALID_INDEX;
+
+	if (freeTail != INVALID_INDEX) {
+		entries[freeTail].next = index;
+	} else {
+		freeHead = index;
+	}
+	freeTail = index;
+
+	--pendingEvents;
+}
+
+void Scheduler::link(uint32_t index)
+{
+	WheelEntry& entry = entries[index];
+
+	uint64_t expireTick = std::max(entry.expireTick, wheelTick);
+	uint64_t ticks = expireTick - wheelTick;
+	if (ticks > WHEEL_MAX_TICKS) {
+		// park it in the farthest slot, it is placed again every time its slot cascades
+		ticks = WHEEL_MAX_TICKS;
+		expireTick = wheelTick + ticks;
+	}
+
+	uint32_t level = 0;
+	while (level + 1 < WHEEL_LEVELS && ticks >= (1ULL << (WHEEL_BITS * (level + 1)))) {
+		++level;
+	}
+
+	entry.slot = static_cast<uint16_t>(level * WHEEL_SIZE + ((expireTick >> (WHEEL_BITS * level)) & WHEEL_MASK));
+	entry.prev = INVALID_INDEX;
+	entry.next = slots[entry.slot];
+	if (entry.next != INVALID_INDEX) {
+		entries[entry.next].prev = index;
+	}
+	slots[entry.slot] = index;
+}
+
+void Scheduler::unlink(uint32_t index)
+{
+	WheelEntry& entry = entries[index];
+	if (entry.prev != INVALID_INDEX) {
+		entries[entry.prev].next = entry.next;
+	} else {
+		slots[entry.slot] = entry.next;
+	}
+
+	if (entry.next != INVALID_INDEX) {
+		entries[entry.next].prev = entry.prev;
+	}
+	entry.prev = entry.next = INVALID_INDEX;
+}
+
+void Scheduler::cascade(uint32_t level, uint32_t slot)
+{
+	uint32_t index = slots[level * WHEEL_SIZE + slot];
+	slots[level * WHEEL_SIZE + slot] = INVALID_INDEX;
+
+	while (index != INVALID_INDEX) {
+		uint32_t next = entries[index].next;
+		link(index);
+		index = next;
+	}
+}
+
+void Scheduler::armTimer()
+{
+	//scheduler thread, wheelLock held
+	if (timerArmed || getState() == THREAD_STATE_TERMINATED) {
+		return;
+	}
+
+	timerArmed = true;
+	timer.expires_at(startTime + std::chrono::milliseconds(wheelTick * SCHEDULER_WHEEL_TICK));
+	timer.async_wait([this](const boost::system::error_code& error) { onTimer(error); });
+}
+
+void Scheduler::onTimer(const boost::system::error_code& error)
+{
+	//scheduler thread
+	if (error == boost::asio::error::operation_aborted || getState() == THREAD_STATE_TERMINATED) {
+		return;
+	}
+
+	std::vector<SchedulerTask*> expired;
+	{
+		std::lock_guard<std::mutex> lockClass(wheelLock);
+		timerArmed = false;
+		expired = takeExpired();
+	}
+	dispatchExpired(std::move(expired));
+
+	std::lock_guard<std::mutex> lockClass(wheelLock);
+	if (pendingEvents != 0) {
+		armTimer();
+	}
+}
+
+void Scheduler::advanceTo(uint64_t elapsed)
+{
+	std::vector<SchedulerTask*> expired;
+	{
+		std::lock_guard<std::mutex> lockClass(wheelLock);
+		virtualElapsed = std::max(virtualElapsed, elapsed);
+		expired = takeExpired();
+	}
+	dispatchExpired(std::move(expired));
+}
+
+std::vector<SchedulerTask*> Scheduler::takeExpired()
+{
+	std::vector<SchedulerTask*> expired;
+	const uint64_t currentTick = getCurrentTick();
+	while (wheelTick <= currentTick && pendingEvents != 0) {
+		const uint32_t slot = wheelTick & WHEEL_MASK;
+		if (slot == 0) {
+			// the lower wheel wrapped around, bring the next slot of every upper level down
+			for (uint32_t level = 1; level < WHEEL_LEVELS; ++level) {
+				const uint32_t upperSlot = (wheelTick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+				cascade(level, upperSlot);
+				if (upperSlot != 0) {
+					break;
+				}
+			}
+		}
+
+		uint32_t index = slots[slot];
+		while (index != INVALID_INDEX) {
+			uint32_t next = entries[index].next;
+			expired.push_back(entries[index].task);
+			releaseEntry(index);
+			index = next;
+		}
+		slots[slot] = INVALID_INDEX;
+
+		++wheelTick;
+	}
+	return expired;
+}
+
+void Scheduler::dispatchExpired(std::vector<SchedulerTask*>&& expired)
+{
+	if (expired.empty()) {
+		return;
+	}
+
+	// one dispatcher task per timer expiration, the events run in the order they expired
+	g_dispatcher.addTask(createTask([tasks = std::move(expired)]() {
+		for (SchedulerTask* task : tasks) {
+			if (!task->hasExpired()) {
+				g_dispatcher.runTask(task);
+			}
+			delete task;
+		}
+	}));
+}
+
+SchedulerTask* createSchedulerTask(uint32_t delay, TaskFunc&& f, const char* tag /*= nullptr*/)
 {
-	return new SchedulerTask(delay, std::move(f));
+	SchedulerTask* task = new SchedulerTask(delay, std::move(f));
+	task->setTag(tag);
+	return task;
 }
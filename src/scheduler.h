@@ -4,19 +4,21 @@
 #pragma once
 
 #include "tasks.h"
-#include <unordered_map>
 
 #include "thread_holder_base.h"
 
 static constexpr int32_t SCHEDULER_MINTICKS = 50;
 
+// resolution of the timing wheel, event delays are rounded up to it
+static constexpr int32_t SCHEDULER_WHEEL_TICK = 5;
+
 class SchedulerTask : public Task
 {
 	public:
-		void setEventId(uint32_t id) {
+		void setEventId(uint64_t id) {
 			eventId = id;
 		}
-		uint32_t getEventId() const {
+		uint64_t getEventId() const {
 			return eventId;
 		}
 
@@ -26,27 +28,97 @@ class SchedulerTask : public Task
 	private:
 		SchedulerTask(uint32_t delay, TaskFunc&& f) : Task(std::move(f)), delay(delay) {}
 
-		uint32_t eventId = 0;
+		uint64_t eventId = 0;
 		uint32_t delay = 0;
 
-		friend SchedulerTask* createSchedulerTask(uint32_t, TaskFunc&&);
+		friend SchedulerTask* createSchedulerTask(uint32_t, TaskFunc&&, const char*);
 };
 
-SchedulerTask* createSchedulerTask(uint32_t delay, TaskFunc&& f);
+SchedulerTask* createSchedulerTask(uint32_t delay, TaskFunc&& f, const char* tag = nullptr);
 
+/*
+ * Hierarchical timing wheel (4 levels of 64 slots) driven by a single timer.
+ * Event ids are handles into a slot table (index + generation), so adding and
+ * stopping an event are O(1) and do not touch any hash map. The generation is
+ * 32 bits wide, a stale id cannot match a reused entry in practice.
+ * All the events that expire on the same tick are handed to the dispatcher as one task.
+ */
 class Scheduler : public ThreadHolder<Scheduler>
 {
 	public:
-		uint32_t addEvent(SchedulerTask* task);
-		void stopEvent(uint32_t eventId);
+		Scheduler() {
+			slots.fill(INVALID_INDEX);
+		}
+
+		uint64_t addEvent(SchedulerTask* task);
+		void stopEvent(uint64_t eventId);
+
+		// any thread
+		uint32_t getPendingEvents();
 
 		void shutdown();
 
+		// virtual time for tvp_sim: the wheel follows advanceTo instead of the clock, the expired events
+		// are handed to the dispatcher as usual and the scheduler thread is never started
+		void useVirtualClock() {
+			virtualClock = true;
+			startWithoutThread();
+		}
+		// milliseconds since the scheduler was created
+		void advanceTo(uint64_t elapsed);
+
 		void threadMain() { io_context.run(); }
 	private:
-		std::atomic<uint32_t> lastEventId{1};
-		std::unordered_map<uint32_t, boost::asio::steady_timer> eventIdTimerMap;
+		static constexpr uint32_t WHEEL_BITS = 6;
+		static constexpr uint32_t WHEEL_SIZE = 1 << WHEEL_BITS;
+		static constexpr uint32_t WHEEL_MASK = WHEEL_SIZE - 1;
+		static constexpr uint32_t WHEEL_LEVELS = 4;
+		static constexpr uint64_t WHEEL_MAX_TICKS = (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+		static constexpr uint32_t EVENT_INDEX_BITS = 20;
+		static constexpr uint32_t EVENT_INDEX_MASK = (1 << EVENT_INDEX_BITS) - 1;
+		static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+		struct WheelEntry {
+			SchedulerTask* task = nullptr;
+			uint64_t expireTick = 0;
+			uint32_t prev = INVALID_INDEX;
+			uint32_t next = INVALID_INDEX;
+			uint32_t generation = 0;
+			uint16_t slot = 0;
+		};
+
+		uint64_t getElapsed() const;
+		uint64_t getCurrentTick() const;
+		uint32_t allocateEntry();
+		void releaseEntry(uint32_t index);
+		void link(uint32_t index);
+		void unlink(uint32_t index);
+		void cascade(uint32_t level, uint32_t slot);
+		void armTimer();
+		void onTimer(const boost::system::error_code& error);
+		// wheelLock held
+		std::vector<SchedulerTask*> takeExpired();
+		static void dispatchExpired(std::vector<SchedulerTask*>&& expired);
+
+		std::mutex wheelLock;
+		std::vector<WheelEntry> entries;
+		std::array<uint32_t, WHEEL_LEVELS * WHEEL_SIZE> slots;
+		uint32_t freeHead = INVALID_INDEX;
+		uint32_t freeTail = INVALID_INDEX;
+		uint32_t pendingEvents = 0;
+
+		// next tick to be processed, only moves forward
+		uint64_t wheelTick = 0;
+		bool timerArmed = false;
+
+		bool virtualClock = false;
+		uint64_t virtualElapsed = 0;
+
+		const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
 		boost::asio::io_context io_context;
+		boost::asio::steady_timer timer{io_context};
 		boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{io_context.get_executor()};
 };
 
@@ -4,11 +4,24 @@
 #include "otpch.h"
 
 #include "script.h"
-#include <filesystem>
+#include "actions.h"
 #include "configmanager.h"
+#include "creatureevent.h"
+#include "globalevent.h"
+#include "movement.h"
+#include "spells.h"
+#include "talkaction.h"
+#include "weapons.h"
 
 extern LuaEnvironment g_luaEnvironment;
 extern ConfigManager g_config;
+extern Actions* g_actions;
+extern CreatureEvents* g_creatureEvents;
+extern GlobalEvents* g_globalEvents;
+extern MoveEvents* g_moveEvents;
+extern Spells* g_spells;
+extern TalkActions* g_talkActions;
+extern Weapons* g_weapons;
 
 bool ScriptEvent::loadScript(const std::string& scriptFile)
 {
@@ -67,6 +80,7 @@ bool CallBack::loadCallBack(LuaScriptInterface* interface, const std::string& na
 	}
 
 	scriptId = id;
+	pureFunctionId = scriptInterface->getPureFunctionId(id);
 	loaded = true;
 	return true;
 }
@@ -82,16 +96,10 @@ Scripts::~Scripts()
 	scriptInterface.reInitState();
 }
 
-bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
+std::vector<std::filesystem::path> Scripts::getScriptFiles(const std::filesystem::path& dir, bool isLib)
 {
 	namespace fs = std::filesystem;
 
-	const auto dir = fs::current_path() / "data" / folderName;
-	if(!fs::exists(dir) || !fs::is_directory(dir)) {
-		std::cout << "[Warning - Scripts::loadScripts] Can not load folder '" << folderName << "'." << std::endl;
-		return false;
-	}
-
 	fs::recursive_directory_iterator endit;
 	std::vector<fs::path> v;
 	std::string disable = ("#");
@@ -112,9 +120,37 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 		}
 	}
 	sort(v.begin(), v.end());
+	return v;
+}
+
+bool Scripts::loadScriptFile(const std::filesystem::path& scriptFile, bool track)
+{
+	if (track) {
+		std::error_code ec;
+		scriptFiles[scriptFile.string()] = std::filesystem::last_write_time(scriptFile, ec);
+	}
+
+	if(scriptInterface.loadFile(scriptFile.string()) == -1) {
+		std::cout << "> " << scriptFile.filename().string() << " [error]" << std::endl;
+		std::cout << "^ " << scriptInterface.getLastLuaError() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
+{
+	namespace fs = std::filesystem;
+
+	const auto dir = fs::current_path() / "data" / folderName;
+	if(!fs::exists(dir) || !fs::is_directory(dir)) {
+		std::cout << "[Warning - Scripts::loadScripts] Can not load folder '" << folderName << "'." << std::endl;
+		return false;
+	}
+
+	std::vector<fs::path> v = getScriptFiles(dir, isLib);
 	std::string redir;
 	for (auto it = v.begin(); it != v.end(); ++it) {
-		const std::string scriptFile = it->string();
 		if (!isLib) {
 			if (redir.empty() || redir != it->parent_path().string()) {
 				auto p = fs::path(it->relative_path());
@@ -125,9 +161,8 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 			}
 		}
 
-		if(scriptInterface.loadFile(scriptFile) == -1) {
-			std::cout << "> " << it->filename().string() << " [error]" << std::endl;
-			std::cout << "^ " << scriptInterface.getLastLuaError() << std::endl;
+		// libraries are not reloaded on their own, every file depends on them
+		if (!loadScriptFile(*it, !isLib)) {
 			continue;
 		}
 
@@ -142,3 +177,93 @@ bool Scripts::loadScripts(std::string folderName, bool isLib, bool reload)
 
 	return true;
 }
+
+size_t Scripts::reloadChangedScripts(const std::string& folderName)
+{
+	namespace fs = std::filesystem;
+
+	const auto dir = fs::current_path() / "data" / folderName;
+	if(!fs::exists(dir) || !fs::is_directory(dir)) {
+		std::cout << "[Warning - Scripts::reloadChangedScripts] Can not load folder '" << folderName << "'." << std::endl;
+		return 0;
+	}
+
+	const std::string folderPrefix = (dir / "").string();
+	std::vector<fs::path> v = getScriptFiles(dir, false);
+
+	// files of the folder that are gone or were disabled
+	std::set<std::string> currentFiles;
+	for (const fs::path& scriptFile : v) {
+		currentFiles.insert(scriptFile.string());
+	}
+
+	std::vector<std::string> removedFiles;
+	for (const auto& it : scriptFiles) {
+		if (it.first.compare(0, folderPrefix.size(), folderPrefix) == 0 && currentFiles.find(it.first) == currentFiles.end()) {
+			removedFiles.push_back(it.first);
+		}
+	}
+
+	size_t count = 0;
+	for (const std::string& scriptFile : removedFiles) {
+		unloadScriptFile(scriptFile);
+		scriptFiles.erase(scriptFile);
+		std::cout << "> " << fs::path(scriptFile).filename().string() << " [unloaded]" << std::endl;
+		++count;
+	}
+
+	for (const fs::path& scriptFile : v) {
+		std::error_code ec;
+		auto it = scriptFiles.find(scriptFile.string());
+		if (it != scriptFiles.end() && it->second == fs::last_write_time(scriptFile, ec)) {
+			continue;
+		}
+
+		if (it != scriptFiles.end()) {
+			unloadScriptFile(it->first);
+		}
+
+		if (loadScriptFile(scriptFile, true)) {
+			std::cout << "> " << scriptFile.filename().string() << " [reloaded]" << std::endl;
+		}
+		++count;
+	}
+
+	if (count != 0) {
+		// ids a reloaded weapon file no longer registers fall back to the defaults
+		g_weapons->loadDefaults();
+		g_creatureEvents->removeInvalidEvents();
+	}
+	return count;
+}
+
+void Scripts::unloadScriptFile(const std::string& scriptFile)
+{
+	const std::string* file = LuaScriptInterface::internScriptFile(scriptFile);
+	g_actions->removeScriptFile(file);
+	g_creatureEvents->removeScriptFile(file);
+	g_globalEvents->removeScriptFile(file);
+	g_moveEvents->removeScriptFile(file);
+	g_spells->removeScriptFile(file);
+	g_talkActions->removeScriptFile(file);
+	g_weapons->removeScriptFile(file);
+
+	// EventCallback keeps its callbacks in Lua, by the file that registered them
+	lua_State* L = scriptInterface.getLuaState();
+	lua_getglobal(L, "EventCallback");
+	if (LuaScriptInterface::isTable(L, -1)) {
+		lua_getfield(L, -1, "clearFile");
+		if (LuaScriptInterface::isFunction(L, -1)) {
+			lua_pushvalue(L, -2);
+			LuaScriptInterface::pushString(L, scriptFile);
+			if (LuaScriptInterface::protectedCall(L, 2, 0) != 0) {
+				LuaScriptInterface::reportError(nullptr, LuaScriptInterface::popString(L));
+			}
+		} else {
+			lua_pop(L, 1);
+		}
+	}
+	lua_pop(L, 1);
+
+	scriptInterface.forgetScriptFile(scriptFile);
+}
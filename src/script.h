@@ -5,13 +5,16 @@
 
 #include "luascript.h"
 
+#include <filesystem>
+
 class ScriptEvent;
 using ScriptEvent_ptr = std::unique_ptr<ScriptEvent>;
 
 class ScriptEvent
 {
 public:
-	explicit ScriptEvent(LuaScriptInterface* interface) : scriptInterface(interface) {}
+	explicit ScriptEvent(LuaScriptInterface* interface) :
+		scriptInterface(interface), scriptFile(interface ? interface->getLoadingScriptFile() : nullptr) {}
 	virtual ~ScriptEvent() = default;
 
 	bool loadScript(const std::string& scriptFile);
@@ -20,6 +23,14 @@ public:
 	int32_t getScriptId() const {
 		return scriptId;
 	}
+	bool isScripted() const {
+		return scripted;
+	}
+
+	// scriptFile is an interned name, see LuaScriptInterface::internScriptFile
+	bool isFromScriptFile(const std::string* scriptFile) const {
+		return this->scriptFile == scriptFile;
+	}
 
 protected:
 	virtual std::string getScriptEventName() const = 0;
@@ -27,6 +38,8 @@ protected:
 	bool scripted = false;
 	int32_t scriptId = 0;
 	LuaScriptInterface* scriptInterface = nullptr;
+	// the file that registered the event, for the per-file reload
+	const std::string* scriptFile = nullptr;
 };
 
 class CallBack
@@ -39,6 +52,8 @@ public:
 protected:
 	int32_t scriptId = 0;
 	LuaScriptInterface* scriptInterface = nullptr;
+	// set when the function was marked with markPure
+	uint32_t pureFunctionId = 0;
 
 private:
 	bool loaded = false;
@@ -51,9 +66,18 @@ class Scripts
 		~Scripts();
 
 		bool loadScripts(std::string folderName, bool isLib, bool reload);
+		// reloads only the files of the folder that changed since they were loaded, returns how many
+		size_t reloadChangedScripts(const std::string& folderName);
 		LuaScriptInterface& getScriptInterface() {
 			return scriptInterface;
 		}
 	private:
+		static std::vector<std::filesystem::path> getScriptFiles(const std::filesystem::path& dir, bool isLib);
+		bool loadScriptFile(const std::filesystem::path& scriptFile, bool track);
+		void unloadScriptFile(const std::string& scriptFile);
+
 		LuaScriptInterface scriptInterface;
+
+		// last write time of every file loaded, by path
+		std::map<std::string, std::filesystem::file_time_type> scriptFiles;
 };
@@ -0,0 +1,140 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "scriptprofiler.h"
+#include "configmanager.h"
+#include "filetasks.h"
+#include "luascript.h"
+#include "tools.h"
+
+extern ConfigManager g_config;
+
+ScriptProfiler g_scriptProfiler;
+
+namespace {
+
+thread_local uint64_t allocatedBytes = 0;
+
+int64_t getMicroseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+void* ScriptProfiler::luaAlloc(void*, void* ptr, size_t osize, size_t nsize)
+{
+	if (nsize == 0) {
+		free(ptr);
+		return nullptr;
+	}
+
+	// osize is the type of a new object when ptr is null
+	if (!ptr) {
+		allocatedBytes += nsize;
+	} else if (nsize > osize) {
+		allocatedBytes += nsize - osize;
+	}
+	return realloc(ptr, nsize);
+}
+
+uint64_t ScriptProfiler::getAllocatedBytes(lua_State* L)
+{
+#ifndef LUAJIT_VERSION
+	(void)L;
+	return allocatedBytes;
+#else
+	return (static_cast<uint64_t>(lua_gc(L, LUA_GCCOUNT, 0)) << 10) + lua_gc(L, LUA_GCCOUNTB, 0);
+#endif
+}
+
+void ScriptProfiler::loadConfig()
+{
+	enabled = g_config.getBoolean(ConfigManager::LUA_PROFILER);
+	logInterval = std::chrono::seconds(g_config.getNumber(ConfigManager::LUA_PROFILER_LOG_INTERVAL));
+	nextLog = std::chrono::steady_clock::now() + logInterval;
+}
+
+ScriptProfiler::CallScope ScriptProfiler::beginCall(lua_State* L) const
+{
+	return {getMicroseconds(), getAllocatedBytes(L)};
+}
+
+void ScriptProfiler::endCall(lua_State* L, const CallScope& scope, LuaScriptInterface* scriptInterface, int32_t scriptId, int32_t callbackId)
+{
+	const int64_t elapsed = getMicroseconds() - scope.startTime;
+	const uint64_t bytes = getAllocatedBytes(L);
+
+	Entry*& entry = entryCache[std::make_tuple(scriptInterface, scriptId, callbackId)];
+	if (!entry) {
+		std::string name;
+		if (scriptInterface) {
+			name = '[' + scriptInterface->getInterfaceName() + "] " + scriptInterface->getFileById(scriptId);
+			if (callbackId) {
+				name += " callback " + scriptInterface->getFileById(callbackId);
+			}
+		} else {
+			name = "(Unknown script)";
+		}
+		entry = &entries[name];
+	}
+
+	++entry->calls;
+	entry->totalTime += elapsed;
+	entry->maxTime = std::max(entry->maxTime, elapsed);
+	if (bytes > scope.startBytes) {
+		entry->allocatedBytes += bytes - scope.startBytes;
+	}
+
+	if (logInterval.count() != 0) {
+		auto now = std::chrono::steady_clock::now();
+		if (now >= nextLog) {
+			dump("data/logs/script_profile.log");
+			nextLog = now + logInterval;
+		}
+	}
+}
+
+void ScriptProfiler::forgetInterface(const LuaScriptInterface* scriptInterface)
+{
+	for (auto it = entryCache.begin(); it != entryCache.end(); ) {
+		if (std::get<0>(it->first) == scriptInterface) {
+			it = entryCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+size_t ScriptProfiler::dump(const std::string& fileName) const
+{
+	std::vector<std::pair<const std::string*, const Entry*>> sorted;
+	sorted.reserve(entries.size());
+	for (const auto& it : entries) {
+		sorted.emplace_back(&it.first, &it.second);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second->totalTime > rhs.second->totalTime;
+	});
+
+	std::string report = fmt::format("[{:s}] {:d} scripts\n{:>10s} {:>12s} {:>10s} {:>10s} {:>14s}  script\n",
+		formatDate(time(nullptr)), sorted.size(), "calls", "total ms", "avg us", "max us", "alloc bytes");
+	for (const auto& it : sorted) {
+		const Entry& entry = *it.second;
+		report += fmt::format("{:>10d} {:>12.2f} {:>10d} {:>10d} {:>14d}  {:s}\n",
+			entry.calls, entry.totalTime / 1000., entry.totalTime / static_cast<int64_t>(entry.calls), entry.maxTime, entry.allocatedBytes, *it.first);
+	}
+	report += '\n';
+
+	g_fileTasks.writeFile(fileName, std::move(report), true);
+	return sorted.size();
+}
+
+void ScriptProfiler::reset()
+{
+	entries.clear();
+	entryCache.clear();
+}
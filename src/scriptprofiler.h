@@ -0,0 +1,60 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+class LuaScriptInterface;
+struct lua_State;
+
+/*
+ * Accounts the Lua events run through LuaScriptInterface::callFunction per script.
+ * Times are wall clock and include the events a script triggers itself, allocated bytes
+ * are counted by the Lua allocator (the heap growth under LuaJIT, which keeps its own).
+ * Dispatcher thread only.
+ */
+class ScriptProfiler
+{
+	public:
+		struct CallScope {
+			int64_t startTime;
+			uint64_t startBytes;
+		};
+
+		bool isEnabled() const {
+			return enabled;
+		}
+
+		void loadConfig();
+
+		CallScope beginCall(lua_State* L) const;
+		void endCall(lua_State* L, const CallScope& scope, LuaScriptInterface* scriptInterface, int32_t scriptId, int32_t callbackId);
+
+		// the ids of an interface die with its state, later calls are accounted under fresh entries
+		void forgetInterface(const LuaScriptInterface* scriptInterface);
+
+		// appends the report to fileName on the file thread, returns the number of scripts in it
+		size_t dump(const std::string& fileName) const;
+		void reset();
+
+		static void* luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+	private:
+		struct Entry {
+			uint64_t calls = 0;
+			uint64_t allocatedBytes = 0;
+			int64_t totalTime = 0; // microseconds
+			int64_t maxTime = 0;
+		};
+
+		static uint64_t getAllocatedBytes(lua_State* L);
+
+		// by the script file and event name the interface reports
+		std::map<std::string, Entry> entries;
+		std::map<std::tuple<const LuaScriptInterface*, int32_t, int32_t>, Entry*> entryCache;
+
+		std::chrono::steady_clock::time_point nextLog;
+		std::chrono::seconds logInterval{0};
+		bool enabled = false;
+};
+
+extern ScriptProfiler g_scriptProfiler;
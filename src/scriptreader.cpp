@@ -1,55 +1,93 @@
 #include "otpch.h"
 
 #include "scriptreader.h"
+#include "filecompression.h"
 #include "tools.h"
 
-#include <boost/lexical_cast.hpp>
-
-ScriptReader::~ScriptReader()
-{
-	if (recursionDepth == -1) {
-		return;
-	}
-
-	for (FILE* file : files) {
-		if (file) {
-			fclose(file);
-		}
-	}
-}
+#include <charconv>
+#include <filesystem>
 
 bool ScriptReader::loadScript(const std::string_view& filename, bool important)
 {
-	if (recursionDepth++ >= 3) {
+	if (recursionDepth + 1 >= static_cast<int32_t>(files.size())) {
 		std::cout << "[Warning - ScriptReader:loadScript] Recursion depth too high " << filename << std::endl;
 		return false;
 	}
 
-	files[recursionDepth] = fopen(filename.data(), "rb");
-	lines[recursionDepth] = 1;
-	filenames[recursionDepth] = filename;
+	ScriptFile& file = files[++recursionDepth];
+	file.filename = filename;
+	file.line = 1;
+	file.open = false;
 
-	if (!files[recursionDepth]) {
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(file.filename, ec);
+	if (ec) {
 		if (important) {
 			std::cout << "[Error - ScriptReader::loadScript] Script file does not exist: " << filename << std::endl;
 		}
 		return false;
 	}
 
+	// empty files cannot be mapped
+	if (size == 0) {
+		file.pos = nullptr;
+		file.end = nullptr;
+	} else {
+		try {
+			file.mapping.open(file.filename);
+		} catch (const std::exception& e) {
+			std::cout << "[Error - ScriptReader::loadScript] Cannot map " << filename << ": " << e.what() << std::endl;
+			return false;
+		}
+
+		file.pos = file.mapping.data();
+		file.end = file.pos + file.mapping.size();
+
+		if (filecompression::isCompressed(file.pos, file.mapping.size())) {
+			if (!filecompression::decompress(file.pos, file.mapping.size(), file.decompressed)) {
+				std::cout << "[Error - ScriptReader::loadScript] Cannot decompress " << filename << std::endl;
+				file.mapping.close();
+				return false;
+			}
+
+			file.mapping.close();
+			file.pos = file.decompressed.data();
+			file.end = file.pos + file.decompressed.size();
+		}
+	}
+
+	file.open = true;
 	isGood = true;
 	return true;
 }
 
 bool ScriptReader::canRead() const
 {
-	if (files[recursionDepth] == nullptr) return false;
+	if (recursionDepth < 0 || !files[recursionDepth].open) return false;
 	return isGood;
 }
 
+bool ScriptReader::readNumberToken(const char* begin)
+{
+	ScriptFile& file = files[recursionDepth];
+	while (file.pos != file.end && isdigit(static_cast<uint8_t>(*file.pos))) {
+		++file.pos;
+	}
+
+	token = TOKEN_NUMBER;
+	auto result = std::from_chars(begin, file.pos, number);
+	if (result.ec != std::errc() || result.ptr != file.pos) {
+		number = -1;
+		error("bad number structure");
+		return false;
+	}
+	return true;
+}
+
 TokenType_t ScriptReader::nextToken(bool allowNegativeDigits)
 {
 	while (canRead()) {
-		int8_t next = getc(files[recursionDepth]);
+		int32_t next = getChar();
 		if (next == -1) {
 			token = TOKEN_ENDOFFILE;
 			closeCurrentFile();
@@ -60,100 +98,108 @@ TokenType_t ScriptReader::nextToken(bool allowNegativeDigits)
 			continue;
 		}
 
+		ScriptFile& file = files[recursionDepth];
 		if (next == ' ' || next == '\t') {
 			continue;
 		} else if (next == '#') {
 			while (canRead()) {
-				next = getc(files[recursionDepth]);
+				next = getChar();
+				if (next == -1) {
+					break;
+				}
+
 				if (next == '\n' || next == '\r') {
 					if (next == '\n') {
-						lines[recursionDepth]++;
+						file.line++;
 					}
 					break;
 				}
 			}
 		} else if (next == '\n' || next == '\r') {
 			if (next == '\n') {
-				lines[recursionDepth]++;
+				file.line++;
 			}
 		} else if (isalpha(next)) {
-			std::ostringstream ss;
-			ss << static_cast<char>(next);
-
-			while (canRead()) {
-				next = getc(files[recursionDepth]);
-				if (!isalpha(next) && !isdigit(next) && next != '_') {
-					ungetc(next, files[recursionDepth]);
+			const char* begin = file.pos - 1;
+			bool lowerCase = !isupper(next);
+			while (file.pos != file.end) {
+				const uint8_t c = *file.pos;
+				if (!isalpha(c) && !isdigit(c) && c != '_') {
 					break;
 				}
 
-				ss << static_cast<char>(next);
+				lowerCase = lowerCase && !isupper(c);
+				++file.pos;
 			}
 
 			token = TOKEN_IDENTIFIER;
-			identifier = ss.str();
-			identifier = asLowerCaseString(identifier);
+			identifier = std::string_view(begin, file.pos - begin);
+			if (!lowerCase) {
+				scratch.assign(identifier);
+				toLowerCaseString(scratch);
+				identifier = scratch;
+			}
 			return token;
 		} else if (isdigit(next)) {
-			std::ostringstream ss;
-			ss << static_cast<char>(next);
-
-			while (canRead()) {
-				next = getc(files[recursionDepth]);
-				if (!isdigit(next)) {
-					ungetc(next, files[recursionDepth]);
+			if (!readNumberToken(file.pos - 1)) {
+				return TOKEN_ENDOFFILE;
+			}
+			return token;
+		} else if (next == '"') {
+			const char* begin = file.pos;
+			bool escaped = false;
+			while (file.pos != file.end && *file.pos != '"') {
+				if (*file.pos == '\\') {
+					escaped = true;
 					break;
 				}
-
-				ss << static_cast<char>(next);
+				++file.pos;
 			}
 
-			token = TOKEN_NUMBER;
-			try {
-				number = boost::lexical_cast<int64_t>(ss.str());
-			} catch (const boost::bad_lexical_cast& e) {
-				number = -1;
-				error("bad number structure");
-				return TOKEN_ENDOFFILE;
-			}
+			if (!escaped) {
+				string = std::string_view(begin, file.pos - begin);
+				if (file.pos != file.end) {
+					++file.pos; // closing quote
+				}
+			} else {
+				scratch.assign(begin, file.pos);
+				while (canRead()) {
+					next = getChar();
+					if (next == -1) {
+						break;
+					}
 
-			return token;
-		} else if (next == '"') {
-			std::ostringstream ss;
+					if (next == '\\') {
+						next = getChar();
+						if (next == 'n') {
+							scratch.push_back('\n');
+						} else if (next == '"') {
+							scratch.push_back('"');
+						} else {
+							scratch.push_back('\\');
+						}
+						continue;
+					}
 
-			while (canRead()) {
-				next = getc(files[recursionDepth]);
-
-				if (next == '\\') {
-					next = getc(files[recursionDepth]);
-					if (next == 'n') {
-						ss << '\n';
-					} else if (next == '"') {
-						ss << '"';
-					} else {
-						ss << '\\';
+					if (next == '"') {
+						break;
 					}
-					continue;
-				}
 
-				if (next == '"') {
-					break;
+					scratch.push_back(static_cast<char>(next));
 				}
-
-				ss << next;
+				string = scratch;
 			}
 
 			token = TOKEN_STRING;
-			string = ss.str();
 			return token;
 		} else { // special-characters
 			token = TOKEN_SPECIAL;
 			special = next;
 			if (special == '@') {
 				// recursive file load
-				std::ostringstream ss;
-				ss << "data/npc/behavior/" << readString();
-				if (!loadScript(ss.str())) {
+				std::string filename = "data/npc/behavior/";
+				filename.append(readString());
+				if (!loadScript(filename)) {
 					return token;
 				}
 
@@ -161,59 +207,40 @@ TokenType_t ScriptReader::nextToken(bool allowNegativeDigits)
 			}
 
 			if (next == '>') { // greater or equals
-				next = getc(files[recursionDepth]);
-				if (next == '=') {
+				if (peekChar() == '=') {
+					++file.pos;
 					special = 'G';
 					return token;
 				}
 
 				special = '>';
-				ungetc(next, files[recursionDepth]);
 			} else if (next == '<') { // not equals
-				next = getc(files[recursionDepth]);
+				next = peekChar();
 				if (next == '>') {
+					++file.pos;
 					special = 'N';
 					return token;
 				} else if (next == '=') {
+					++file.pos;
 					special = 'L';
 					return token;
 				}
 
 				special = '<';
-				ungetc(next, files[recursionDepth]);
 			} else if (next == '-') {
-				next = getc(files[recursionDepth]);
+				next = peekChar();
 				if (next == '>') {
+					++file.pos;
 					special = 'I';
 					return token;
-				} else if (allowNegativeDigits && isdigit(next)) {
-					std::ostringstream ss;
-					ss << '-' << static_cast<char>(next);
-
-					while (canRead()) {
-						next = getc(files[recursionDepth]);
-						if (!isdigit(next)) {
-							ungetc(next, files[recursionDepth]);
-							break;
-						}
-
-						ss << static_cast<char>(next);
-					}
-
-					token = TOKEN_NUMBER;
-					try {
-						number = boost::lexical_cast<int64_t>(ss.str());
-					} catch (const boost::bad_lexical_cast& e) {
-						number = -1;
-						error("bad number structure");
+				} else if (allowNegativeDigits && next != -1 && isdigit(next)) {
+					if (!readNumberToken(file.pos - 1)) {
 						return TOKEN_ENDOFFILE;
 					}
-
 					return token;
 				}
 
 				special = '-';
-				ungetc(next, files[recursionDepth]);
 			}
 
 			return token;
@@ -230,13 +257,17 @@ void ScriptReader::error(const std::string& errMessage)
 	}
 
 	std::ostringstream ss;
-	ss << "[Error - ScriptReader::error]: In script file '" << filenames[recursionDepth] << "':" << lines[recursionDepth] << ": " << errMessage << std::endl;
+	if (recursionDepth >= 0) {
+		ss << "[Error - ScriptReader::error]: In script file '" << files[recursionDepth].filename << "':" << files[recursionDepth].line << ": " << errMessage << std::endl;
+	} else {
+		ss << "[Error - ScriptReader::error]: " << errMessage << std::endl;
+	}
 	ss << "[Error - ScriptReader::error] Token: " << static_cast<int32_t>(token) << " Special: " << static_cast<int32_t>(special) << std::endl;
 	std::cout << ss.str() << std::endl;
 	isGood = false;
 }
 
-const std::string& ScriptReader::getIdentifier()
+std::string_view ScriptReader::getIdentifier()
 {
 	if (token != TOKEN_IDENTIFIER) {
 		error("identifier expected");
@@ -246,7 +277,7 @@ const std::string& ScriptReader::getIdentifier()
 	return identifier;
 }
 
-const std::string& ScriptReader::getString()
+std::string_view ScriptReader::getString()
 {
 	if (token != TOKEN_STRING) {
 		error("string expected");
@@ -288,13 +319,13 @@ Position ScriptReader::getPosition()
 	return pos;
 }
 
-const std::string& ScriptReader::readIdentifier()
+std::string_view ScriptReader::readIdentifier()
 {
 	nextToken();
 	return getIdentifier();
 }
 
-const std::string& ScriptReader::readString()
+std::string_view ScriptReader::readString()
 {
 	nextToken();
 	return getString();
@@ -338,9 +369,9 @@ Position ScriptReader::readPosition()
 	return pos;
 }
 
-std::string ScriptReader::prepString(const std::string& str)
+std::string ScriptReader::prepString(std::string_view str)
 {
-	std::string copy = str;
+	std::string copy(str);
 	replaceString(copy, "\\n", "\n");
 	replaceString(copy, "\\\"", "\"");
 	return copy;
@@ -350,12 +381,16 @@ void ScriptReader::closeCurrentFile()
 {
 	if (recursionDepth == -1) {
 		return;
-	} else {
-		if (fclose(files[recursionDepth])) {
-			std::cout << "[Error - ScriptReader::closeCurrentFile] Failed to close current script file." << std::endl;
-		}
+	}
 
-		files[recursionDepth] = nullptr;
-		recursionDepth--;
+	ScriptFile& file = files[recursionDepth];
+	if (file.mapping.is_open()) {
+		file.mapping.close();
 	}
+	std::string().swap(file.decompressed);
+
+	file.pos = nullptr;
+	file.end = nullptr;
+	file.open = false;
+	recursionDepth--;
 }
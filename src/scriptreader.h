@@ -14,11 +14,16 @@ enum TokenType_t : uint8_t
 
 struct Position;
 
+/*
+ * Tokenizer for the script files (NPC behaviours, players, houses).
+ * Files are memory mapped and tokenized in place: identifiers and strings are views
+ * into the mapping (or into a scratch buffer when they had to be lowered or unescaped),
+ * valid until the next token is read.
+ */
 class ScriptReader
 {
 public:
 	ScriptReader() = default;
-	~ScriptReader();
 
 	bool loadScript(const std::string_view& filename, bool important = true);
 	bool canRead() const;
@@ -30,8 +35,8 @@ public:
 
 	void error(const std::string& errMessage);
 
-	const std::string& getIdentifier();
-	const std::string& getString();
+	std::string_view getIdentifier();
+	std::string_view getString();
 
 	template <typename T>
 	T getNumber()
@@ -48,8 +53,8 @@ public:
 	int8_t getSpecial();
 	Position getPosition();
 
-	const std::string& readIdentifier();
-	const std::string& readString();
+	std::string_view readIdentifier();
+	std::string_view readString();
 
 	template <typename T>
 	T readNumber()
@@ -63,15 +68,41 @@ public:
 	int8_t readSymbol(int8_t symbol);
 	Position readPosition();
 
-	static std::string prepString(const std::string& str);
+	static std::string prepString(std::string_view str);
 private:
+	struct ScriptFile {
+		boost::iostreams::mapped_file_source mapping;
+		// the contents of a compressed file, read from here instead of the mapping
+		std::string decompressed;
+		const char* pos = nullptr;
+		const char* end = nullptr;
+		std::string filename;
+		int32_t line = 1;
+		bool open = false;
+	};
+
+	int32_t getChar() {
+		ScriptFile& file = files[recursionDepth];
+		if (file.pos == file.end) {
+			return -1;
+		}
+		return static_cast<uint8_t>(*file.pos++);
+	}
+
+	int32_t peekChar() const {
+		const ScriptFile& file = files[recursionDepth];
+		if (file.pos == file.end) {
+			return -1;
+		}
+		return static_cast<uint8_t>(*file.pos);
+	}
+
+	bool readNumberToken(const char* begin);
 	void closeCurrentFile();
 
 	TokenType_t token = TOKEN_ENDOFFILE;
 
-	std::array<FILE*, 3> files{ nullptr, nullptr, nullptr };
-	std::array<std::string, 3> filenames{};
-	std::array<int32_t, 3> lines{ 1, 1, 1 };
+	std::array<ScriptFile, 3> files;
 
 	bool isGood = true;
 
@@ -79,7 +110,9 @@ private:
 	int32_t recursionDepth = -1;
 	int64_t number = -1;
 
-	std::string identifier;
-	std::string string;
-};
+	std::string_view identifier;
+	std::string_view string;
 
+	// holds the token when it could not be a view into the file
+	std::string scratch;
+};
@@ -4,8 +4,10 @@
 #include "otpch.h"
 
 #include "scriptwriter.h"
+#include "filetasks.h"
 #include "position.h"
-#include "tools.h"
+
+#include <filesystem>
 
 ScriptWriter::~ScriptWriter()
 {
@@ -14,64 +16,69 @@ ScriptWriter::~ScriptWriter()
 
 bool ScriptWriter::open(const std::string& filename, bool append)
 {
-	if (append) {
-		file.open(filename, std::ostream::out | std::ostream::binary | std::ostream::app);
-	} else {
-		file.open(filename, std::ostream::out | std::ostream::binary);
-	}
-
-	if (!file.is_open()) {
+	std::error_code ec;
+	const std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+	if (!directory.empty() && !std::filesystem::is_directory(directory, ec)) {
 		std::cout << "[ERROR - ScriptWriter::open] Could not open file for writing '" << filename << '\'' << std::endl;
 		return false;
 	}
 
+	this->filename = filename;
+	this->append = append;
 	return true;
 }
 
 void ScriptWriter::close()
 {
-	if (!file.is_open()) {
+	if (filename.empty()) {
 		return;
 	}
 
-	file.write(buffer.str().c_str(), buffer.str().size());
-	file.close();
+	g_fileTasks.writeFile(filename, fmt::to_string(buffer), append);
+	buffer.clear();
+	filename.clear();
 }
 
-void ScriptWriter::writePosition(const Position& pos)
+void ScriptWriter::discard()
 {
-	buffer << '[' << pos.x << ',' << pos.y << ',' << static_cast<int32_t>(pos.z) << ']';
+	buffer.clear();
+	filename.clear();
 }
 
-void ScriptWriter::writeNumber(int64_t number)
+size_t ScriptWriter::hash() const
+{
+	return std::hash<std::string_view>{}(std::string_view(buffer.data(), buffer.size()));
+}
+
+void ScriptWriter::writePosition(const Position& pos)
 {
-	buffer << number;
+	writeFormatted("[{:d},{:d},{:d}]", pos.x, pos.y, pos.z);
 }
 
-void ScriptWriter::writeText(const std::string& str)
+void ScriptWriter::writeNumber(int64_t number)
 {
-	buffer << str;
+	writeFormatted("{:d}", number);
 }
 
-void ScriptWriter::writeString(const std::string& str)
+void ScriptWriter::writeText(std::string_view str)
 {
-	buffer << "\"" << str << "\"";
+	buffer.append(str.data(), str.data() + str.size());
 }
 
-void ScriptWriter::writeLine(const std::string& str)
+void ScriptWriter::writeString(std::string_view str)
 {
-	buffer << str << std::endl;
+	buffer.push_back('"');
+	writeText(str);
+	buffer.push_back('"');
 }
 
-void ScriptWriter::writeLine()
+void ScriptWriter::writeLine(std::string_view str)
 {
-	buffer << std::endl;
+	writeText(str);
+	buffer.push_back('\n');
 }
 
-std::string ScriptWriter::prepString(const std::string& str)
+void ScriptWriter::writeLine()
 {
-	std::string copy = str;
-	replaceString(copy, "\n", "\\n");
-	replaceString(copy, "\"", "\\\"");
-	return copy;
+	buffer.push_back('\n');
 }
@@ -3,16 +3,24 @@
 
 #pragma once
 
-#include <fstream>
+#include <fmt/format.h>
 
 struct Position;
 
 /// <summary>
 /// Class used to write binary & text script files to be used by the game server.
+/// Everything is formatted into one growable buffer, handed to the file thread on close.
 /// </summary>
 class ScriptWriter
 {
 	public:
+		/// <summary>
+		/// Wraps a string so it is written with its quotes and line breaks escaped.
+		/// </summary>
+		struct Escaped {
+			std::string_view str;
+		};
+
 		explicit ScriptWriter() = default;
 		~ScriptWriter();
 
@@ -21,24 +29,77 @@ class ScriptWriter
 		/// </summary>
 		/// <param name="filename"></param>
 		/// <param name="append"></param>
-		/// <returns>True if the file was created successfully.</returns>
+		/// <returns>True if the file can be created.</returns>
 		bool open(const std::string& filename, bool append = false);
 
 		/// <summary>
-		/// Closes the file stream.
+		/// Hands the written contents to the file thread.
 		/// </summary>
 		void close();
 
+		/// <summary>
+		/// Drops the written contents, the file is left as it is.
+		/// </summary>
+		void discard();
+
+		/// <summary>
+		/// Hash of the contents written since the file was opened.
+		/// </summary>
+		size_t hash() const;
+
 		void writePosition(const Position& pos);
 		void writeNumber(int64_t number);
-		void writeText(const std::string& str);
-		void writeString(const std::string& str);
-		void writeLine(const std::string& str);
+		void writeText(std::string_view str);
+		void writeString(std::string_view str);
+		void writeLine(std::string_view str);
 		void writeLine();
 
-		static std::string prepString(const std::string& str);
+		template <typename... Args>
+		void writeFormatted(fmt::format_string<Args...> format, Args&&... args) {
+			fmt::format_to(std::back_inserter(buffer), format, std::forward<Args>(args)...);
+		}
+
+		template <typename... Args>
+		void writeLineFormatted(fmt::format_string<Args...> format, Args&&... args) {
+			fmt::format_to(std::back_inserter(buffer), format, std::forward<Args>(args)...);
+			buffer.push_back('\n');
+		}
+
+		static Escaped escape(std::string_view str) {
+			return Escaped{str};
+		}
 	private:
-		std::ofstream file;
+		std::string filename;
+		bool append = false;
+
+		fmt::memory_buffer buffer;
+};
+
+template <>
+struct fmt::formatter<ScriptWriter::Escaped>
+{
+	constexpr auto parse(format_parse_context& ctx) {
+		auto it = ctx.begin();
+		if (it != ctx.end() && *it == 's') {
+			++it;
+		}
+		return it;
+	}
 
-		std::ostringstream buffer;
-};
\ No newline at end of file
+	template <typename FormatContext>
+	auto format(const ScriptWriter::Escaped& escaped, FormatContext& ctx) const {
+		auto out = ctx.out();
+		for (char c : escaped.str) {
+			if (c == '\n') {
+				*out++ = '\\';
+				*out++ = 'n';
+			} else {
+				if (c == '"') {
+					*out++ = '\\';
+				}
+				*out++ = c;
+			}
+		}
+		return out;
+	}
+};
@@ -7,6 +7,7 @@
 #include "server.h"
 #include "scheduler.h"
 #include "configmanager.h"
+#include "affinity.h"
 #include "ban.h"
 
 extern ConfigManager g_config;
@@ -26,7 +27,67 @@ void ServiceManager::run()
 {
 	assert(!running);
 	running = true;
+	startNetworkThreads();
+	affinity::pinCurrentThread("network", 0);
+	checkTimeouts();
 	io_context.run();
+	stopNetworkThreads();
+}
+
+void ServiceManager::checkTimeouts()
+{
+	ConnectionManager::getInstance().closeTimedOut();
+
+	timeout_timer.expires_after(std::chrono::milliseconds(CONNECTION_TIMEOUT_CHECK_INTERVAL));
+	timeout_timer.async_wait([this](const boost::system::error_code& error) {
+		if (!error && running) {
+			checkTimeouts();
+		}
+	});
+}
+
+void ServiceManager::startNetworkThreads()
+{
+	const int32_t networkThreads = g_config.getNumber(ConfigManager::NETWORK_THREADS);
+	for (int32_t i = 1; i < networkThreads; ++i) {
+		auto& context = ioContexts.emplace_back(std::make_unique<boost::asio::io_context>(1));
+		ioWork.emplace_back(context->get_executor());
+		// the vector may grow while this thread starts, only the context itself stays where it is
+		ioThreads.emplace_back([ctx = context.get(), i]() {
+			affinity::pinCurrentThread("network", i);
+			ctx->run();
+		});
+	}
+}
+
+void ServiceManager::stopNetworkThreads()
+{
+	// the connections still pending are closed by the socket shutdown, let every thread finish its handlers
+	ioWork.clear();
+	for (auto& context : ioContexts) {
+		context->stop();
+	}
+
+	for (auto& thread : ioThreads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+	ioThreads.clear();
+}
+
+boost::asio::io_context& ServiceManager::getConnectionContext()
+{
+	//main network thread (acceptors)
+	if (ioContexts.empty()) {
+		return io_context;
+	}
+
+	size_t index = nextIoContext++ % (ioContexts.size() + 1);
+	if (index == 0) {
+		return io_context;
+	}
+	return *ioContexts[index - 1];
 }
 
 void ServiceManager::stop()
@@ -46,6 +107,7 @@ void ServiceManager::stop()
 	}
 
 	acceptors.clear();
+	timeout_timer.cancel();
 
 	death_timer.expires_after(std::chrono::seconds(3));
 	death_timer.async_wait(std::bind(&ServiceManager::die, this));
@@ -82,7 +144,7 @@ void ServicePort::accept()
 		return;
 	}
 
-	auto connection = ConnectionManager::getInstance().createConnection(io_context, shared_from_this());
+	auto connection = ConnectionManager::getInstance().createConnection(manager.getConnectionContext(), shared_from_this());
 	acceptor->async_accept(connection->getSocket(), std::bind(&ServicePort::onAccept, shared_from_this(), connection, std::placeholders::_1));
 }
 
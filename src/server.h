@@ -8,6 +8,7 @@
 #include <memory>
 
 class Protocol;
+class ServiceManager;
 
 class ServiceBase
 {
@@ -41,7 +42,7 @@ class Service final : public ServiceBase
 class ServicePort : public std::enable_shared_from_this<ServicePort>
 {
 	public:
-		explicit ServicePort(boost::asio::io_context& io_context) : io_context(io_context) {}
+		ServicePort(boost::asio::io_context& io_context, ServiceManager& manager) : io_context(io_context), manager(manager) {}
 		~ServicePort();
 
 		// non-copyable
@@ -64,6 +65,7 @@ class ServicePort : public std::enable_shared_from_this<ServicePort>
 		void accept();
 
 		boost::asio::io_context& io_context;
+		ServiceManager& manager;
 		std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor;
 		std::vector<Service_ptr> services;
 
@@ -91,14 +93,29 @@ class ServiceManager
 			return acceptors.empty() == false;
 		}
 
+		// io_context that runs the next accepted connection, connections are spread round-robin
+		boost::asio::io_context& getConnectionContext();
+
 	private:
 		void die();
+		void checkTimeouts();
+		void startNetworkThreads();
+		void stopNetworkThreads();
+
+		using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
 
 		std::unordered_map<uint16_t, ServicePort_ptr> acceptors;
 
+		// additional network threads, the main io_context below is always part of the pool
+		std::vector<std::unique_ptr<boost::asio::io_context>> ioContexts;
+		std::vector<WorkGuard> ioWork;
+		std::vector<std::thread> ioThreads;
+		size_t nextIoContext = 0;
+
 		boost::asio::io_context io_context;
 		Signals signals{io_context};
 		boost::asio::steady_timer death_timer { io_context };
+		boost::asio::steady_timer timeout_timer { io_context };
 		bool running = false;
 };
 
@@ -115,7 +132,7 @@ bool ServiceManager::add(uint16_t port)
 	auto foundServicePort = acceptors.find(port);
 
 	if (foundServicePort == acceptors.end()) {
-		service_port = std::make_shared<ServicePort>(io_context);
+		service_port = std::make_shared<ServicePort>(io_context, *this);
 		service_port->open(port);
 		acceptors[port] = service_port;
 	} else {
@@ -7,7 +7,9 @@
 #include "game.h"
 #include "monster.h"
 #include "configmanager.h"
+#include "loadshedder.h"
 #include "scheduler.h"
+#include "worldshards.h"
 
 #include "pugicast.h"
 #include "events.h"
@@ -20,6 +22,14 @@ extern Events* g_events;
 static constexpr int32_t MINSPAWN_INTERVAL = 10 * 1000; // 10 seconds to match RME
 static constexpr int32_t MAXSPAWN_INTERVAL = 24 * 60 * 60 * 1000; // 1 day
 
+// set while a lazy spawn is filled, its monsters are announced like the ones placed at startup
+static bool materializing = false;
+
+static uint32_t getSpawnSector(int32_t sectorX, int32_t sectorY)
+{
+	return (static_cast<uint32_t>(sectorX) << 16) | static_cast<uint32_t>(sectorY);
+}
+
 int32_t Spawns::calculateSpawnDelay(int32_t delay)
 {
 	int32_t newDelay = delay;
@@ -181,7 +191,14 @@ void Spawns::startup()
 		return;
 	}
 
+	// the spectators of everything spawned here are looked up per map region at the end
+	g_game.beginPlaceCreatures();
 	for (Npc* npc : npcList) {
+		if (!g_worldShards.isOwned(npc->getMasterPos())) {
+			delete npc;
+			continue;
+		}
+
 		if (!g_game.placeCreature(npc, npc->getMasterPos(), true)) {
 			std::cout << "[Warning - Spawns::startup] Couldn't spawn npc \"" << npc->getName() << "\" on position: " << npc->getMasterPos() << '.' << std::endl;
 			delete npc;
@@ -190,15 +207,37 @@ void Spawns::startup()
 	npcList.clear();
 
 	if (g_config.getBoolean(ConfigManager::DISABLE_MONSTER_SPAWNS)) {
+		g_game.endPlaceCreatures();
 		return;
 	}
 
+	// the spawns of other shards stay idle, lazy spawns wait for a player to come near
+	const bool lazy = g_config.getNumber(ConfigManager::LAZY_SPAWN_RADIUS) > 0;
+	auto startSpawn = [this, lazy](BaseSpawn* spawn) {
+		const Position& centerPos = spawn->getCenterPos();
+		if (!g_worldShards.isOwned(centerPos)) {
+			return;
+		}
+
+		if (lazy) {
+			spawn->materialized = false;
+			spawnSectors[getSpawnSector(centerPos.x / SPAWN_SECTOR_SIZE, centerPos.y / SPAWN_SECTOR_SIZE)].push_back(spawn);
+		} else {
+			spawn->startup();
+		}
+	};
+
 	for (BaseSpawn* spawn : spawnList) {
-		spawn->startup();
+		startSpawn(spawn);
 	}
 
 	for (BaseSpawn* spawn : tvpSpawnList) {
-		spawn->startup();
+		startSpawn(spawn);
+	}
+	g_game.endPlaceCreatures();
+
+	if (lazy) {
+		materializeEvent = g_scheduler.addEvent(createSchedulerTask(SPAWN_MATERIALIZE_INTERVAL, std::bind(&Spawns::checkMaterialization, this), "Spawns::checkMaterialization"));
 	}
 
 	started = true;
@@ -216,9 +255,161 @@ void Spawns::clear()
 	}
 	tvpSpawnList.clear();
 
+	spawnChecks = {};
+	if (checkSpawnsEvent != 0) {
+		g_scheduler.stopEvent(checkSpawnsEvent);
+		checkSpawnsEvent = 0;
+	}
+
+	spawnSectors.clear();
+	materializedSpawns.clear();
+	if (materializeEvent != 0) {
+		g_scheduler.stopEvent(materializeEvent);
+		materializeEvent = 0;
+	}
+
 	started = false;
 }
 
+void Spawns::scheduleSpawnCheck(BaseSpawn* spawn, int64_t dueTime)
+{
+	spawn->nextCheckTime = dueTime;
+	spawnChecks.push({dueTime, spawn});
+
+	if (checkSpawnsEvent == 0 || dueTime < checkSpawnsTime) {
+		armSpawnCheck();
+	}
+}
+
+void Spawns::armSpawnCheck()
+{
+	if (checkSpawnsEvent != 0) {
+		g_scheduler.stopEvent(checkSpawnsEvent);
+		checkSpawnsEvent = 0;
+	}
+
+	if (spawnChecks.empty()) {
+		return;
+	}
+
+	// while the game runs late the checks are coalesced, counted from the last one so re-arming does not push them back
+	checkSpawnsTime = std::max(spawnChecks.top().dueTime, lastCheckSpawns + g_loadShedder.getSpawnCheckDelay());
+	int64_t delay = std::max<int64_t>(SCHEDULER_MINTICKS, checkSpawnsTime - OTSYS_TIME());
+	checkSpawnsEvent = g_scheduler.addEvent(createSchedulerTask(static_cast<uint32_t>(delay), std::bind(&Spawns::checkSpawns, this), "Spawns::checkSpawns"));
+}
+
+void Spawns::checkSpawns()
+{
+	checkSpawnsEvent = 0;
+
+	const int64_t now = OTSYS_TIME();
+	lastCheckSpawns = now;
+	while (!spawnChecks.empty() && spawnChecks.top().dueTime <= now) {
+		SpawnCheck check = spawnChecks.top();
+		spawnChecks.pop();
+
+		// stopped or rescheduled since this entry was queued
+		BaseSpawn* spawn = check.spawn;
+		if (spawn->nextCheckTime != check.dueTime) {
+			continue;
+		}
+
+		spawn->nextCheckTime = 0;
+
+		int64_t nextCheckTime = spawn->checkSpawn();
+		if (nextCheckTime != 0) {
+			spawn->nextCheckTime = nextCheckTime;
+			spawnChecks.push({nextCheckTime, spawn});
+		}
+	}
+
+	armSpawnCheck();
+}
+
+void Spawns::checkMaterialization()
+{
+	materializeEvent = g_scheduler.addEvent(createSchedulerTask(SPAWN_MATERIALIZE_INTERVAL, std::bind(&Spawns::checkMaterialization, this), "Spawns::checkMaterialization"));
+
+	const int64_t now = OTSYS_TIME();
+	const int32_t radius = g_config.getNumber(ConfigManager::LAZY_SPAWN_RADIUS);
+
+	g_game.beginPlaceCreatures();
+	for (const auto& it : g_game.getPlayers()) {
+		const Position& pos = it.second->getPosition();
+		const int32_t endX = (pos.x + radius) / SPAWN_SECTOR_SIZE;
+		const int32_t endY = (pos.y + radius) / SPAWN_SECTOR_SIZE;
+		for (int32_t sectorX = std::max<int32_t>(0, pos.x - radius) / SPAWN_SECTOR_SIZE; sectorX <= endX; ++sectorX) {
+			for (int32_t sectorY = std::max<int32_t>(0, pos.y - radius) / SPAWN_SECTOR_SIZE; sectorY <= endY; ++sectorY) {
+				auto sector = spawnSectors.find(getSpawnSector(sectorX, sectorY));
+				if (sector == spawnSectors.end()) {
+					continue;
+				}
+
+				for (BaseSpawn* spawn : sector->second) {
+					const Position& centerPos = spawn->getCenterPos();
+					if (Position::getDistanceX(centerPos, pos) > radius || Position::getDistanceY(centerPos, pos) > radius ||
+							Position::getDistanceZ(centerPos, pos) > SPAWN_MATERIALIZE_FLOORS) {
+						continue;
+					}
+
+					spawn->lastPlayerNearby = now;
+					if (!spawn->materialized) {
+						materialize(spawn);
+					}
+				}
+			}
+		}
+	}
+	g_game.endPlaceCreatures();
+
+	const int64_t idleTime = static_cast<int64_t>(g_config.getNumber(ConfigManager::LAZY_SPAWN_IDLE_TIME)) * 1000;
+	std::unordered_set<BaseSpawn*> idleSpawns;
+	for (BaseSpawn* spawn : materializedSpawns) {
+		if (now - spawn->lastPlayerNearby >= idleTime) {
+			idleSpawns.insert(spawn);
+		}
+	}
+
+	if (idleSpawns.empty()) {
+		return;
+	}
+
+	// a spawn with a monster still fighting is emptied at a later check
+	for (Monster* monster : g_game.getMonsters()) {
+		if (monster->getAttackedCreature()) {
+			idleSpawns.erase(monster->getSpawn());
+		}
+	}
+
+	std::vector<Monster*> removedMonsters;
+	for (Monster* monster : g_game.getMonsters()) {
+		if (idleSpawns.contains(monster->getSpawn())) {
+			removedMonsters.push_back(monster);
+		}
+	}
+
+	for (Monster* monster : removedMonsters) {
+		g_game.removeCreature(monster);
+	}
+
+	for (BaseSpawn* spawn : idleSpawns) {
+		spawn->stopSpawnCheck();
+		spawn->activeMonsters = 0;
+		spawn->materialized = false;
+	}
+	std::erase_if(materializedSpawns, [](const BaseSpawn* spawn) { return !spawn->materialized; });
+}
+
+void Spawns::materialize(BaseSpawn* spawn)
+{
+	spawn->materialized = true;
+	materializedSpawns.push_back(spawn);
+
+	materializing = true;
+	spawn->startup();
+	materializing = false;
+}
+
 bool Spawns::isInZone(const Position& centerPos, int32_t radius, const Position& pos)
 {
 	if (radius == -1) {
@@ -253,15 +444,14 @@ void Spawn::addMonster(const std::string& name, const Position& pos, Direction&
 	spawnMap.push_back(sb);
 }
 
-void Spawn::checkSpawn()
+int64_t Spawn::checkSpawn()
 {
-	checkSpawnEvent = 0;
-
 	if (activeMonsters >= spawnMap.size()) {
 		// no need to respawn anymore monsters
-		return;
+		return 0;
 	}
 
+	int64_t nextSpawnTime = std::numeric_limits<int64_t>::max();
 	for (auto& it : spawnMap) {
 		spawnBlock_t& sb = it;
 		if (OTSYS_TIME() >= sb.nextSpawnTime) {
@@ -269,9 +459,10 @@ void Spawn::checkSpawn()
 				sb.nextSpawnTime = OTSYS_TIME() + Spawns::calculateSpawnDelay(sb.interval);
 			}
 
+			// only blocks that are due look for players around
 			if (!isPlayerAround(sb.pos)) {
 				// we do not care if we successfully spawned the monster or not
-				spawnMonster(sb);
+				spawnMonster(sb.mType, sb.pos, sb.direction, sb.interval);
 
 				sb.nextSpawnTime = OTSYS_TIME() + Spawns::calculateSpawnDelay(sb.interval);
 
@@ -281,9 +472,16 @@ void Spawn::checkSpawn()
 				}
 			}
 		}
+
+		nextSpawnTime = std::min(nextSpawnTime, sb.nextSpawnTime);
 	}
 
-	checkSpawnEvent = g_scheduler.addEvent(createSchedulerTask(SPAWN_CHECK_INTERVAL, std::bind(&Spawn::checkSpawn, this)));
+	if (activeMonsters >= spawnMap.size()) {
+		return 0;
+	}
+
+	// blocks that are due but blocked by players are retried after the usual interval
+	return std::max<int64_t>(OTSYS_TIME() + SPAWN_CHECK_INTERVAL, nextSpawnTime);
 }
 
 bool searchSpawnPosition(const Position& pos, Position& spawnPos)
@@ -378,13 +576,11 @@ void TvpSpawn::addMonster(const std::string& name, const Position& pos, Directio
 	monsterSpawn = sb;
 }
 
-void TvpSpawn::checkSpawn()
+int64_t TvpSpawn::checkSpawn()
 {
-	checkSpawnEvent = 0;
-
 	if (activeMonsters >= monsterSpawn.amount) {
 		// no need to respawn anymore monsters
-		return;
+		return 0;
 	}
 
 	if (monsterSpawn.nextSpawnTime <= OTSYS_TIME()) {
@@ -433,22 +629,24 @@ void TvpSpawn::checkSpawn()
 		}
 	}
 
-	checkSpawnEvent = g_scheduler.addEvent(createSchedulerTask(SPAWN_CHECK_INTERVAL, std::bind(&TvpSpawn::checkSpawn, this)));
+	if (activeMonsters >= monsterSpawn.amount) {
+		return 0;
+	}
+
+	return std::max<int64_t>(OTSYS_TIME() + SPAWN_CHECK_INTERVAL, monsterSpawn.nextSpawnTime);
 }
 
 void BaseSpawn::startSpawnCheck(uint32_t interval)
 {
-	if (checkSpawnEvent == 0) {
-		checkSpawnEvent = g_scheduler.addEvent(createSchedulerTask(Spawns::calculateSpawnDelay(interval), std::bind(&BaseSpawn::checkSpawn, this)));
+	if (nextCheckTime == 0 && materialized) {
+		g_game.map.spawns.scheduleSpawnCheck(this, OTSYS_TIME() + Spawns::calculateSpawnDelay(interval));
 	}
 }
 
 void BaseSpawn::stopSpawnCheck()
 {
-	if (checkSpawnEvent != 0) {
-		g_scheduler.stopEvent(checkSpawnEvent);
-		checkSpawnEvent = 0;
-	}
+	// the queued entry no longer matches and is dropped when it comes up
+	nextCheckTime = 0;
 }
 
 bool BaseSpawn::isPlayerAround(const Position& pos)
@@ -488,7 +686,7 @@ bool BaseSpawn::spawnMonster(MonsterType* mType, const Position& pos, Direction
 	}
 
 	if (forceSpawn) {
-		if (g_game.getGameState() <= GAME_STATE_CLOSED) {
+		if (g_game.getGameState() <= GAME_STATE_CLOSED || materializing) {
 			if (!g_game.placeCreature(monster_ptr.get(), pos, true)) {
 				std::cout << "[Warning - BaseSpawn::spawnMonster] Couldn't spawn monster \"" << monster_ptr->getName() << "\" on position: " << pos << '.' << std::endl;
 				return false;
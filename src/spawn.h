@@ -6,6 +6,7 @@
 #include "tile.h"
 #include "position.h"
 
+#include <queue>
 #include <utility>
 #include <vector>
 
@@ -14,6 +15,11 @@ class MonsterType;
 class Npc;
 
 static constexpr uint32_t SPAWN_CHECK_INTERVAL = 5000;
+static constexpr uint32_t SPAWN_MATERIALIZE_INTERVAL = 1000;
+// side of the map sectors the lazy spawns are looked up by
+static constexpr int32_t SPAWN_SECTOR_SIZE = 32;
+// floors above or below a lazy spawn a player fills it from
+static constexpr int32_t SPAWN_MATERIALIZE_FLOORS = 2;
 
 struct spawnBlock_t {
 	Position pos;
@@ -60,7 +66,8 @@ class BaseSpawn
 	protected:
 		static bool isPlayerAround(const Position& pos);
 
-		virtual void checkSpawn() = 0;
+		// returns when the spawn wants to be checked again, 0 once it is full
+		virtual int64_t checkSpawn() = 0;
 
 		bool spawnMonster(spawnBlock_t& sb, bool startup = false);
 		bool spawnMonster(MonsterType* mType, const Position& pos, Direction dir, uint32_t interval, bool forceSpawn = false);
@@ -69,7 +76,15 @@ class BaseSpawn
 
 		uint8_t radius = 0;
 		uint32_t activeMonsters = 0;
-		uint32_t checkSpawnEvent = 0;
+
+		// due time of the pending check in the spawn queue, 0 when none is pending
+		int64_t nextCheckTime = 0;
+
+		// false while a lazy spawn is only its blocks, without monsters or checks
+		bool materialized = true;
+		int64_t lastPlayerNearby = 0;
+
+		friend class Spawns;
 };
 
 class Spawn : public BaseSpawn
@@ -88,7 +103,7 @@ class Spawn : public BaseSpawn
 		void startup() final;
 		void addMonster(const std::string& name, const Position& pos, Direction& dir, uint32_t interval, uint32_t amount) final;
 	private:
-		void checkSpawn() final;
+		int64_t checkSpawn() final;
 
 		std::vector<spawnBlock_t> spawnMap;
 };
@@ -109,7 +124,7 @@ public:
 	void startup() final;
 	void addMonster(const std::string& name, const Position& pos, Direction& dir, uint32_t interval, uint32_t amount) final;
 private:
-	void checkSpawn() final;
+	int64_t checkSpawn() final;
 
 	spawnBlock_t monsterSpawn;
 };
@@ -137,7 +152,36 @@ class Spawns
 		}
 
 		static int32_t calculateSpawnDelay(int32_t delay);
+
+		void scheduleSpawnCheck(BaseSpawn* spawn, int64_t dueTime);
 	private:
+		struct SpawnCheck {
+			int64_t dueTime;
+			BaseSpawn* spawn;
+
+			bool operator>(const SpawnCheck& other) const {
+				return dueTime > other.dueTime;
+			}
+		};
+
+		void armSpawnCheck();
+		void checkSpawns();
+
+		// fills the lazy spawns players came near and empties the ones they left long enough ago
+		void checkMaterialization();
+		void materialize(BaseSpawn* spawn);
+
+		// every spawn missing monsters has one entry here, checked by a single scheduler event
+		std::priority_queue<SpawnCheck, std::vector<SpawnCheck>, std::greater<SpawnCheck>> spawnChecks;
+		uint64_t checkSpawnsEvent = 0;
+		int64_t checkSpawnsTime = 0;
+		int64_t lastCheckSpawns = 0;
+
+		// the lazy spawns by the sector of their center, and the ones filled right now
+		std::unordered_map<uint32_t, std::vector<BaseSpawn*>> spawnSectors;
+		std::vector<BaseSpawn*> materializedSpawns;
+		uint64_t materializeEvent = 0;
+
 		std::forward_list<Npc*> npcList;
 		std::forward_list<Spawn*> spawnList;
 		std::forward_list<TvpSpawn*> tvpSpawnList;
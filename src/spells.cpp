@@ -92,6 +92,7 @@ void Spells::clearMaps()
 {
 	instants.clear();
 	runes.clear();
+	wordTrieDirty = true;
 }
 
 void Spells::clear()
@@ -101,6 +102,26 @@ void Spells::clear()
 	getScriptInterface().reInitState();
 }
 
+void Spells::removeScriptFile(const std::string* scriptFile)
+{
+	for (auto it = instants.begin(); it != instants.end();) {
+		if (it->second.isFromScriptFile(scriptFile)) {
+			it = instants.erase(it);
+			wordTrieDirty = true;
+		} else {
+			++it;
+		}
+	}
+
+	for (auto it = runes.begin(); it != runes.end();) {
+		if (it->second.isFromScriptFile(scriptFile)) {
+			it = runes.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 LuaScriptInterface& Spells::getScriptInterface()
 {
 	return scriptInterface;
@@ -120,6 +141,7 @@ bool Spells::registerInstantLuaEvent(InstantSpell* event)
 		if (!result.second) {
 			std::cout << "[Warning - Spells::registerInstantLuaEvent] Duplicate registered instant spell with words: " << words << std::endl;
 		}
+		wordTrieDirty = true;
 		return result.second;
 	}
 
@@ -174,11 +196,70 @@ RuneSpell* Spells::getRuneSpellByName(const std::string& name)
 	return nullptr;
 }
 
-InstantSpell* Spells::getInstantSpell(const std::string& words)
+void Spells::buildWordTrie()
 {
-	InstantSpell* result = nullptr;
+	wordTrie.assign(1, SpellWordNode());
+	rankedInstants.clear();
+
+	for (auto& it : instants) {
+		InstantSpell* spell = &it.second;
+		rankedInstants.push_back(spell);
+		const uint32_t rank = rankedInstants.size();
+		const bool hasParam = spell->getHasParam() || spell->getHasPlayerNameParam();
+
+		// compareSpellWords skips one typed space before every part that does not begin with one
+		StringVector parts = explodeString(spell->getWords(), ",");
+		std::vector<size_t> optionalSpaces;
+		for (size_t i = 0; i < parts.size(); ++i) {
+			if (parts[i].empty() || parts[i][0] != ' ') {
+				optionalSpaces.push_back(i);
+			}
+		}
+
+		for (uint32_t variant = 0; variant < (1u << optionalSpaces.size()); ++variant) {
+			uint32_t nodeIndex = 0;
+			auto addChar = [&](char c) {
+				c = tolower(static_cast<unsigned char>(c));
+				auto& children = wordTrie[nodeIndex].children;
+				auto child = std::find_if(children.begin(), children.end(), [c](const auto& entry) { return entry.first == c; });
+				if (child != children.end()) {
+					nodeIndex = child->second;
+					return;
+				}
+
+				const uint32_t newIndex = wordTrie.size();
+				children.emplace_back(c, newIndex);
+				wordTrie.emplace_back();
+				nodeIndex = newIndex;
+			};
+
+			for (size_t i = 0, optional = 0; i < parts.size(); ++i) {
+				if (optional < optionalSpaces.size() && optionalSpaces[optional] == i) {
+					if (variant & (1u << optional)) {
+						addChar(' ');
+					}
+					++optional;
+				}
+
+				for (char c : parts[i]) {
+					addChar(c);
+				}
+			}
+
+			// ranks only grow, the spell checked last used to win
+			SpellWordNode& node = wordTrie[nodeIndex];
+			node.wordsRank = rank;
+			if (hasParam) {
+				node.paramRank = rank;
+			}
+		}
+	}
+	wordTrieDirty = false;
+}
 
-	std::string constructedWords = words;
+InstantSpell* Spells::getInstantSpell(const std::string& words)
+{
+	std::string_view constructedWords = words;
 
 	size_t paramStart = words.find_first_of('"');
 	if (paramStart != std::string::npos) { // String has a "
@@ -187,21 +268,36 @@ InstantSpell* Spells::getInstantSpell(const std::string& words)
 			return nullptr;
 		}
 
-		constructedWords = words.substr(0, paramStart - 1);
+		constructedWords = constructedWords.substr(0, paramStart - 1);
 	}
 
-	for (auto& it : instants) {
-		const std::string& instantSpellWords = it.second.getWords();
-		
-		// match the current spell words with the given words
-		if (compareSpellWords(instantSpellWords, constructedWords, (it.second.getHasParam() || it.second.getHasPlayerNameParam()))) {
-			result = &it.second;
+	if (wordTrieDirty) {
+		buildWordTrie();
+	}
+
+	// spells with a parameter match on any node along the way, the others only where the words end
+	uint32_t best = 0;
+	uint32_t nodeIndex = 0;
+	for (size_t i = 0; ; ++i) {
+		const SpellWordNode& node = wordTrie[nodeIndex];
+		if (i == constructedWords.size()) {
+			best = std::max(best, node.wordsRank);
+			break;
 		}
+		best = std::max(best, node.paramRank);
 
-		// continue checking on spells
+		const char c = tolower(static_cast<unsigned char>(constructedWords[i]));
+		auto child = std::find_if(node.children.begin(), node.children.end(), [c](const auto& entry) { return entry.first == c; });
+		if (child == node.children.end()) {
+			break;
+		}
+		nodeIndex = child->second;
 	}
 
-	return result;
+	if (best == 0) {
+		return nullptr;
+	}
+	return rankedInstants[best - 1];
 }
 
 InstantSpell* Spells::getInstantSpellByName(const std::string& name)
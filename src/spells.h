@@ -46,13 +46,27 @@ class Spells final
 		void clear();
 		bool registerInstantLuaEvent(InstantSpell* event);
 		bool registerRuneLuaEvent(RuneSpell* event);
+		void removeScriptFile(const std::string* scriptFile);
 
 	private:
 		LuaScriptInterface& getScriptInterface();
 
+		// the words of every instant spell, lower case, one path for each way the spaces between
+		// their comma separated parts may be typed; a rank is the spell's position in instants plus one
+		struct SpellWordNode {
+			std::vector<std::pair<char, uint32_t>> children;
+			uint32_t wordsRank = 0; // the highest ranked spell whose words end here
+			uint32_t paramRank = 0; // the same, among spells that take a parameter after their words
+		};
+		void buildWordTrie();
+
 		std::map<uint16_t, RuneSpell> runes;
 		std::map<std::string, InstantSpell> instants;
 
+		std::vector<SpellWordNode> wordTrie;
+		std::vector<InstantSpell*> rankedInstants;
+		bool wordTrieDirty = true;
+
 		friend class CombatSpell;
 		LuaScriptInterface scriptInterface { "Spell Interface" };
 };
@@ -0,0 +1,50 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "statementlog.h"
+
+void StatementLog::setLimits(size_t maxStatements, size_t maxListeners)
+{
+	statements.reset(maxStatements);
+	listeners.reset(maxListeners);
+}
+
+uint32_t StatementLog::addStatement(uint32_t guid, uint8_t mode, uint16_t channel, const std::string& text)
+{
+	// 0 is sent for the statements that are not recorded
+	if (nextStatementId == 0) {
+		nextStatementId = 1;
+	}
+
+	Statement& statement = statements.push();
+	statement.statementID = nextStatementId++;
+	statement.timeStamp = std::time(nullptr);
+	statement.characterID = guid;
+	statement.channel = channel;
+	statement.mode = mode;
+	statement.reported = false;
+	statement.text.assign(text);
+	return statement.statementID;
+}
+
+void StatementLog::addListener(uint32_t statementId, uint32_t guid)
+{
+	Listener& listener = listeners.push();
+	listener.StatementID = statementId;
+	listener.CharacterID = guid;
+}
+
+void StatementLog::removeExpired(uint32_t timeLimit)
+{
+	while (!statements.empty() && statements[0].timeStamp < timeLimit) {
+		statements.pop();
+	}
+
+	// listeners of statements dropped because the ring was full go as well
+	const uint32_t firstStatementId = statements.empty() ? nextStatementId : statements[0].statementID;
+	while (!listeners.empty() && listeners[0].StatementID < firstStatementId) {
+		listeners.pop();
+	}
+}
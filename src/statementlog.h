@@ -0,0 +1,100 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+struct Statement
+{
+	uint32_t statementID = 0;
+	uint32_t timeStamp = 0;
+	uint32_t characterID = 0;
+	uint16_t channel = 0;
+	uint8_t mode = 0;
+	bool reported = false;
+	std::string text;
+};
+
+struct Listener
+{
+	uint32_t StatementID = 0;
+	uint32_t CharacterID = 0;
+};
+
+// fixed capacity queue, once full every push drops the oldest entry
+template<typename T>
+class RingBuffer
+{
+	public:
+		void reset(size_t capacity) {
+			entries.clear();
+			entries.resize(std::max<size_t>(1, capacity));
+			head = 0;
+			count = 0;
+		}
+
+		// the returned slot still holds the values of the entry it replaced
+		T& push() {
+			if (count == entries.size()) {
+				pop();
+			}
+
+			T& entry = entries[(head + count) % entries.size()];
+			++count;
+			return entry;
+		}
+
+		void pop() {
+			head = (head + 1) % entries.size();
+			--count;
+		}
+
+		// 0 is the oldest entry
+		T& operator[](size_t index) {
+			return entries[(head + index) % entries.size()];
+		}
+		const T& operator[](size_t index) const {
+			return entries[(head + index) % entries.size()];
+		}
+
+		size_t size() const {
+			return count;
+		}
+		bool empty() const {
+			return count == 0;
+		}
+
+	private:
+		std::vector<T> entries = std::vector<T>(1);
+		size_t head = 0;
+		size_t count = 0;
+};
+
+/*
+ * Statements said in game and the players that received them, for the rule violation reports.
+ * Both are kept in preallocated rings in id order, so expired entries are dropped from the front,
+ * and text buffers are reused as entries are overwritten.
+ */
+class StatementLog
+{
+	public:
+		void setLimits(size_t maxStatements, size_t maxListeners);
+
+		// returns the id sent to the clients with the statement
+		uint32_t addStatement(uint32_t guid, uint8_t mode, uint16_t channel, const std::string& text);
+		// listeners have to be added in statement id order
+		void addListener(uint32_t statementId, uint32_t guid);
+
+		void removeExpired(uint32_t timeLimit);
+
+		size_t getStatementCount() const {
+			return statements.size();
+		}
+		size_t getListenerCount() const {
+			return listeners.size();
+		}
+
+	private:
+		RingBuffer<Statement> statements;
+		RingBuffer<Listener> listeners;
+		uint32_t nextStatementId = 1;
+};
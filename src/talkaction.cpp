@@ -21,10 +21,37 @@ TalkActions::~TalkActions()
 void TalkActions::clear()
 {
 	talkActions.clear();
+	for (auto& bucket : talkActionsByFirstChar) {
+		bucket.clear();
+	}
 
 	getScriptInterface().reInitState();
 }
 
+void TalkActions::removeScriptFile(const std::string* scriptFile)
+{
+	bool removed = false;
+	for (auto it = talkActions.begin(); it != talkActions.end();) {
+		if (it->second.isFromScriptFile(scriptFile)) {
+			it = talkActions.erase(it);
+			removed = true;
+		} else {
+			++it;
+		}
+	}
+
+	if (!removed) {
+		return;
+	}
+
+	for (auto& bucket : talkActionsByFirstChar) {
+		bucket.clear();
+	}
+	for (const auto& entry : talkActions) {
+		indexTalkAction(entry);
+	}
+}
+
 LuaScriptInterface& TalkActions::getScriptInterface()
 {
 	return scriptInterface;
@@ -41,21 +68,55 @@ bool TalkActions::registerLuaEvent(TalkAction* event)
 	std::vector<std::string> words = talkAction->getWordsMap();
 
 	for (size_t i = 0; i < words.size(); i++) {
+		std::pair<std::map<std::string, TalkAction>::iterator, bool> result;
 		if (i == words.size() - 1) {
-			talkActions.emplace(words[i], std::move(*talkAction));
+			result = talkActions.emplace(words[i], std::move(*talkAction));
 		} else {
-			talkActions.emplace(words[i], *talkAction);
+			result = talkActions.emplace(words[i], *talkAction);
+		}
+
+		if (result.second) {
+			indexTalkAction(*result.first);
 		}
 	}
 
 	return true;
 }
 
+void TalkActions::indexTalkAction(const TalkActionEntry& entry)
+{
+	auto insert = [&entry](std::vector<const TalkActionEntry*>& bucket) {
+		auto it = std::lower_bound(bucket.begin(), bucket.end(), &entry, [](const TalkActionEntry* lhs, const TalkActionEntry* rhs) {
+			return lhs->first < rhs->first;
+		});
+		bucket.insert(it, &entry);
+	};
+
+	const std::string& talkactionWords = entry.first;
+	if (talkactionWords.empty()) {
+		// matches every line
+		for (auto& bucket : talkActionsByFirstChar) {
+			insert(bucket);
+		}
+		return;
+	}
+
+	uint8_t c = tolower(static_cast<uint8_t>(talkactionWords.front()));
+	insert(talkActionsByFirstChar[c]);
+	if (toupper(c) != c) {
+		// strncasecmp lets either case through
+		insert(talkActionsByFirstChar[toupper(c)]);
+	}
+}
+
 TalkActionResult_t TalkActions::playerSaySpell(Player* player, SpeakClasses type, const std::string& words) const
 {
 	size_t wordsLength = words.length();
-	for (auto it = talkActions.begin(); it != talkActions.end(); ) {
-		const std::string& talkactionWords = it->first;
+	// only talkactions sharing the first character can prefix the line, ordinary chat usually hits an empty list
+	const auto& candidates = talkActionsByFirstChar[wordsLength != 0 ? static_cast<uint8_t>(words.front()) : 0];
+	for (auto it = candidates.begin(); it != candidates.end(); ) {
+		const std::string& talkactionWords = (*it)->first;
+		const TalkAction& talkAction = (*it)->second;
 		size_t talkactionLength = talkactionWords.length();
 		if (wordsLength < talkactionLength || strncasecmp(words.c_str(), talkactionWords.c_str(), talkactionLength) != 0) {
 			++it;
@@ -64,14 +125,14 @@ TalkActionResult_t TalkActions::playerSaySpell(Player* player, SpeakClasses type
 
 		std::string param;
 		if (wordsLength != talkactionLength) {
-			param = words.substr(talkactionLength);
-			if (param.front() != ' ') {
+			if (words[talkactionLength] != ' ') {
 				++it;
 				continue;
 			}
+			param = words.substr(talkactionLength);
 			trim_left(param, ' ');
 
-			std::string separator = it->second.getSeparator();
+			const std::string& separator = talkAction.getSeparator();
 			if (separator != " ") {
 				if (!param.empty()) {
 					if (param != separator) {
@@ -84,15 +145,15 @@ TalkActionResult_t TalkActions::playerSaySpell(Player* player, SpeakClasses type
 			}
 		}
 
-		if (it->second.getNeedAccess() && !player->getGroup()->access) {
+		if (talkAction.getNeedAccess() && !player->getGroup()->access) {
 			return TALKACTION_CONTINUE;
 		}
 
-		if (player->getAccountType() < it->second.getRequiredAccountType()) {
+		if (player->getAccountType() < talkAction.getRequiredAccountType()) {
 			return TALKACTION_CONTINUE;
 		}
 
-		if (it->second.executeSay(player, talkactionWords, param, type)) {
+		if (talkAction.executeSay(player, talkactionWords, param, type)) {
 			return TALKACTION_CONTINUE;
 		}
 
@@ -30,7 +30,7 @@ class TalkAction : public ScriptEvent
 			words = word;
 			wordsMap.push_back(word);
 		}
-		std::string getSeparator() const {
+		const std::string& getSeparator() const {
 			return separator;
 		}
 		void setSeparator(std::string sep) {
@@ -80,12 +80,19 @@ class TalkActions final
 
 		bool registerLuaEvent(TalkAction* event);
 		void clear();
+		void removeScriptFile(const std::string* scriptFile);
 
 	private:
+		using TalkActionEntry = std::pair<const std::string, TalkAction>;
+
 		LuaScriptInterface& getScriptInterface();
 		std::string getScriptBaseName() const;
+		void indexTalkAction(const TalkActionEntry& entry);
 
 		std::map<std::string, TalkAction> talkActions;
 
+		// talkActions by the lower case first character of their words, each list in map order
+		std::array<std::vector<const TalkActionEntry*>, 256> talkActionsByFirstChar;
+
 		LuaScriptInterface scriptInterface;
 };
@@ -3,9 +3,13 @@
 
 #include "otpch.h"
 
+#include <bit>
+
 #include "tasks.h"
 #include "game.h"
 #include "configmanager.h"
+#include "outputmessage.h"
+#include "profiler.h"
 
 extern Game g_game;
 extern ConfigManager g_config;
@@ -20,8 +24,61 @@ Task* createTask(uint32_t expiration, TaskFunc&& f)
 	return new Task(expiration, std::move(f));
 }
 
+void LatencyHistogram::add(uint64_t value)
+{
+	uint32_t bucket;
+	if (value < (1 << SUB_BUCKET_BITS)) {
+		bucket = static_cast<uint32_t>(value);
+	} else {
+		// the highest bit selects the power of two, the next bits the sub-bucket inside it
+		const uint32_t msb = std::bit_width(value) - 1;
+		const uint32_t sub = static_cast<uint32_t>(value >> (msb - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+		bucket = std::min<uint32_t>(((msb - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub, BUCKETS - 1);
+	}
+
+	++buckets[bucket];
+	++count;
+	max = std::max(max, value);
+}
+
+void LatencyHistogram::reset()
+{
+	buckets.fill(0);
+	count = 0;
+	max = 0;
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile * count + 0.5));
+	uint64_t seen = 0;
+	for (uint32_t bucket = 0; bucket < BUCKETS; ++bucket) {
+		seen += buckets[bucket];
+		if (seen < rank) {
+			continue;
+		}
+
+		if (bucket < (1 << SUB_BUCKET_BITS)) {
+			return bucket;
+		}
+
+		// upper bound of the bucket, never above the highest sample
+		const uint32_t msb = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+		const uint64_t sub = bucket & ((1 << SUB_BUCKET_BITS) - 1);
+		const uint64_t upper = ((1ULL << SUB_BUCKET_BITS) + sub + 1) << (msb - SUB_BUCKET_BITS);
+		return std::min(upper - 1, max);
+	}
+	return max;
+}
+
 void Dispatcher::threadMain()
 {
+	PROFILE_THREAD("Dispatcher");
+
 	std::vector<Task*> tmpTaskList;
 	// NOTE: second argument defer_lock is to prevent from immediate locking
 	std::unique_lock<std::mutex> taskLockUnique(taskLock, std::defer_lock);
@@ -31,13 +88,21 @@ void Dispatcher::threadMain()
 	while (getState() != THREAD_STATE_TERMINATED) {
 		// check if there are tasks waiting
 		taskLockUnique.lock();
-		if (taskList.empty()) {
+		if (taskList.empty() && !lockfreeTaskHead.load(std::memory_order_acquire)) {
+			if (!idleJobs.empty()) {
+				taskLockUnique.unlock();
+				runIdleSlice();
+				continue;
+			}
+
 			//if the list is empty wait for signal
 			taskSignal.wait(taskLockUnique);
 		}
 		tmpTaskList.swap(taskList);
 		taskLockUnique.unlock();
 
+		popLockfreeTasks(tmpTaskList);
+
 		if (std::time(nullptr) - timing >= 50) {
 			timing = std::time(nullptr);
 			beatIOSync = true;
@@ -45,20 +110,97 @@ void Dispatcher::threadMain()
 			beatIOSync = false;
 		}
 
-		for (Task* task : tmpTaskList) {
-			if (!task->hasExpired()) {
-				++dispatcherCycle;
-				// execute it
-				(*task)();
-			}
-			delete task;
+		runBatch(tmpTaskList);
+		queueIdleHandlers();
+		PROFILE_FRAME();
+	}
+}
+
+bool Dispatcher::runQueuedTasks()
+{
+	std::vector<Task*> tasks;
+	{
+		std::lock_guard<std::mutex> lockClass(taskLock);
+		tasks.swap(taskList);
+	}
+	popLockfreeTasks(tasks);
+
+	if (tasks.empty()) {
+		return false;
+	}
+
+	runBatch(tasks);
+	return true;
+}
+
+void Dispatcher::runBatch(std::vector<Task*>& tasks)
+{
+	const size_t batchSize = tasks.size();
+	const auto batchStart = std::chrono::steady_clock::now();
+	for (Task* task : tasks) {
+		if (!task->hasExpired()) {
+			++dispatcherCycle;
+			// execute it
+			runTask(task);
+		}
+		delete task;
+	}
+	tasks.clear();
+
+	// everything written by this batch leaves now instead of waiting for a timer
+	OutputMessagePool::getInstance().sendAll();
+
+	const auto batchTime = std::chrono::steady_clock::now() - batchStart;
+	++batchStats.batches;
+	batchStats.time += batchTime;
+	batchStats.peakSize = std::max(batchStats.peakSize, batchSize);
+	batchStats.peakTime = std::max<std::chrono::nanoseconds>(batchStats.peakTime, batchTime);
+	if (batchBudget.count() > 0 && batchTime > batchBudget) {
+		++batchStats.batchesOverBudget;
+	}
+}
+
+void Dispatcher::addIdleHandler(std::function<bool()> handler)
+{
+	idleHandlers.push_back({std::move(handler), false});
+}
+
+void Dispatcher::queueIdleHandlers()
+{
+	for (size_t i = 0; i < idleHandlers.size(); ++i) {
+		if (idleHandlers[i].queued) {
+			continue;
 		}
-		tmpTaskList.clear();
+
+		idleHandlers[i].queued = true;
+		idleJobs.push_back([this, i]() {
+			return idleHandlers[i].queued = idleHandlers[i].run();
+		});
+	}
+}
+
+void Dispatcher::runIdleSlice()
+{
+	std::function<bool()> job = std::move(idleJobs.front());
+	idleJobs.pop_front();
+	++batchStats.idleSlices;
+
+	if (job()) {
+		idleJobs.push_back(std::move(job));
 	}
 }
 
 void Dispatcher::addTask(Task* task)
 {
+	if (taskStats.load(std::memory_order_relaxed)) {
+		task->queuedAt = std::chrono::steady_clock::now();
+	}
+
+	if (lockfreeQueue.load(std::memory_order_relaxed)) {
+		pushLockfreeTask(task);
+		return;
+	}
+
 	bool do_signal = false;
 
 	taskLock.lock();
@@ -78,6 +220,133 @@ void Dispatcher::addTask(Task* task)
 	}
 }
 
+void Dispatcher::runTask(Task* task)
+{
+	//dispatcher thread
+	PROFILE_ZONE("Dispatcher::runTask");
+	PROFILE_ZONE_TEXT(task->getTag());
+
+	if (!taskStats.load(std::memory_order_relaxed)) {
+		(*task)();
+		return;
+	}
+
+	// tasks run from inside another task (the scheduler batches) inherit its queue time,
+	// the outer task is then not accounted so the time is not counted twice
+	if (runDepth == 0) {
+		currentQueuedAt = task->queuedAt;
+		nestedRun = false;
+	} else {
+		nestedRun = true;
+	}
+
+	const auto queuedAt = task->queuedAt != std::chrono::steady_clock::time_point{} ? task->queuedAt : currentQueuedAt;
+	const auto start = std::chrono::steady_clock::now();
+
+	++runDepth;
+	(*task)();
+	--runDepth;
+
+	if (runDepth == 0 && nestedRun) {
+		return;
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	const auto wait = queuedAt != std::chrono::steady_clock::time_point{} ? std::chrono::duration_cast<std::chrono::microseconds>(start - queuedAt) : std::chrono::microseconds(0);
+	const auto exec = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+
+	waitHistogram.add(wait.count());
+	execHistogram.add(exec.count());
+
+	if (slowTaskThreshold.count() > 0 && exec >= slowTaskThreshold) {
+		std::cout << "[Warning - Dispatcher::runTask] Slow task " << task->getTag();
+		if (task->getTagValue() >= 0) {
+			std::cout << " (0x" << std::hex << task->getTagValue() << std::dec << ')';
+		}
+		std::cout << " took " << exec.count() / 1000. << " ms, waited " << wait.count() / 1000. << " ms in queue." << std::endl;
+	}
+
+	if (runDepth == 0) {
+		reportTaskStats(end);
+	}
+}
+
+void Dispatcher::reportTaskStats(std::chrono::steady_clock::time_point now)
+{
+	if (statsInterval.count() == 0) {
+		return;
+	}
+
+	if (statsWindowStart == std::chrono::steady_clock::time_point{}) {
+		statsWindowStart = now;
+		return;
+	}
+
+	if (now - statsWindowStart < statsInterval) {
+		return;
+	}
+
+	std::cout << fmt::format(">> Dispatcher: {:d} tasks in {:d}s, wait p50/p99/max {:.2f}/{:.2f}/{:.2f} ms, run p50/p99/max {:.2f}/{:.2f}/{:.2f} ms",
+		execHistogram.getCount(), std::chrono::duration_cast<std::chrono::seconds>(now - statsWindowStart).count(),
+		waitHistogram.getPercentile(0.5) / 1000., waitHistogram.getPercentile(0.99) / 1000., waitHistogram.getMax() / 1000.,
+		execHistogram.getPercentile(0.5) / 1000., execHistogram.getPercentile(0.99) / 1000., execHistogram.getMax() / 1000.) << std::endl;
+
+	waitHistogram.reset();
+	execHistogram.reset();
+	statsWindowStart = now;
+}
+
+void Dispatcher::loadConfig()
+{
+	//dispatcher thread
+	lockfreeQueue.store(g_config.getBoolean(ConfigManager::DISPATCHER_LOCKFREE_QUEUE), std::memory_order_relaxed);
+
+	slowTaskThreshold = std::chrono::milliseconds(g_config.getNumber(ConfigManager::DISPATCHER_SLOW_TASK_THRESHOLD));
+	statsInterval = std::chrono::seconds(g_config.getNumber(ConfigManager::DISPATCHER_STATS_INTERVAL));
+	batchBudget = std::chrono::milliseconds(g_config.getNumber(ConfigManager::DISPATCHER_BATCH_BUDGET));
+	statsWindowStart = {};
+	waitHistogram.reset();
+	execHistogram.reset();
+	taskStats.store(g_config.getBoolean(ConfigManager::DISPATCHER_TASK_STATS), std::memory_order_relaxed);
+}
+
+void Dispatcher::pushLockfreeTask(Task* task)
+{
+	//any thread
+	if (getState() != THREAD_STATE_RUNNING) {
+		delete task;
+		return;
+	}
+
+	Task* head = lockfreeTaskHead.load(std::memory_order_relaxed);
+	do {
+		task->next = head;
+	} while (!lockfreeTaskHead.compare_exchange_weak(head, task, std::memory_order_release, std::memory_order_relaxed));
+
+	// only the push that makes the stack non-empty can find the dispatcher sleeping,
+	// taking the lock here guarantees it is either already waiting or has not checked the stack yet
+	if (!head) {
+		std::lock_guard<std::mutex> lockClass(taskLock);
+		taskSignal.notify_one();
+	}
+}
+
+void Dispatcher::popLockfreeTasks(std::vector<Task*>& tasks)
+{
+	//dispatcher thread
+	Task* task = lockfreeTaskHead.exchange(nullptr, std::memory_order_acquire);
+	if (!task) {
+		return;
+	}
+
+	// the stack holds the newest task first, append it reversed to keep the FIFO order
+	size_t first = tasks.size();
+	for (; task; task = task->next) {
+		tasks.push_back(task);
+	}
+	std::reverse(tasks.begin() + first, tasks.end());
+}
+
 void Dispatcher::shutdown()
 {
 	Task* task = createTask([this]() {
@@ -35,6 +35,18 @@ class Task
 			return expiration < std::chrono::system_clock::now();
 		}
 
+		// origin of the task for the dispatcher statistics, tag must be a string literal
+		void setTag(const char* tag, int32_t tagValue = -1) {
+			this->tag = tag;
+			this->tagValue = tagValue;
+		}
+		const char* getTag() const {
+			return tag ? tag : func.target_type().name();
+		}
+		int32_t getTagValue() const {
+			return tagValue;
+		}
+
 	protected:
 		std::chrono::system_clock::time_point expiration = SYSTEM_TIME_ZERO;
 
@@ -43,31 +55,140 @@ class Task
 		// then it is the time the task should be added to the
 		// dispatcher
 		TaskFunc func;
+
+		// intrusive link used by the lock-free dispatcher queue
+		Task* next = nullptr;
+
+		const char* tag = nullptr;
+		int32_t tagValue = -1;
+		std::chrono::steady_clock::time_point queuedAt;
+
+		friend class Dispatcher;
 };
 
 Task* createTask(TaskFunc&& f);
 Task* createTask(uint32_t expiration, TaskFunc&& f);
 
+// Log-linear histogram of microsecond samples, 8 sub-buckets per power of two
+class LatencyHistogram
+{
+	public:
+		void add(uint64_t value);
+		void reset();
+
+		uint64_t getPercentile(double percentile) const;
+		uint64_t getMax() const {
+			return max;
+		}
+		uint64_t getCount() const {
+			return count;
+		}
+
+	private:
+		static constexpr uint32_t SUB_BUCKET_BITS = 3;
+		static constexpr uint32_t BUCKETS = (40 << SUB_BUCKET_BITS);
+
+		std::array<uint32_t, BUCKETS> buckets = {};
+		uint64_t count = 0;
+		uint64_t max = 0;
+};
+
+// batches of tasks the dispatcher took from its queue at once, dispatcher thread only
+struct DispatcherBatchStats {
+	uint64_t batches = 0;
+	std::chrono::nanoseconds time{0};
+	// the largest and the longest batch since the peaks were last reset
+	size_t peakSize = 0;
+	std::chrono::nanoseconds peakTime{0};
+	// batches that ran longer than dispatcherBatchBudget
+	uint64_t batchesOverBudget = 0;
+	// slices of idle jobs run
+	uint64_t idleSlices = 0;
+};
+
 class Dispatcher : public ThreadHolder<Dispatcher> {
 	public:
 		void addTask(Task* task);
 
+		// executes the task and accounts it in the task statistics, dispatcher thread only
+		void runTask(Task* task);
+
+		// reads the queue backend and task statistics settings, dispatcher thread only
+		void loadConfig();
+
 		void shutdown();
 
 		uint64_t getDispatcherCycle() const {
 			return dispatcherCycle;
 		}
 
+		const DispatcherBatchStats& getBatchStats() const {
+			return batchStats;
+		}
+		void resetBatchPeaks() {
+			batchStats.peakSize = 0;
+			batchStats.peakTime = {};
+		}
+
+		/*
+		 * Low priority work for the time the queue is empty. A job does a small slice of its work per
+		 * call and returns whether it has more, the jobs take turns and a task that arrives waits for
+		 * the slice running at most. Dispatcher thread only.
+		 */
+		void addIdleJob(std::function<bool()> job) {
+			idleJobs.push_back(std::move(job));
+		}
+		// a job queued again after every batch, for work the tasks keep making
+		void addIdleHandler(std::function<bool()> handler);
+
 		void threadMain();
+		// runs what is queued as one batch on the calling thread, for tvp_sim whose dispatcher has no
+		// thread of its own; false when the queue was empty
+		bool runQueuedTasks();
 
 		bool beatIOSync = false;
 
 	private:
+		void runBatch(std::vector<Task*>& tasks);
+		void pushLockfreeTask(Task* task);
+		void popLockfreeTasks(std::vector<Task*>& tasks);
+		void reportTaskStats(std::chrono::steady_clock::time_point now);
+
 		std::mutex taskLock;
 		std::condition_variable taskSignal;
 
 		std::vector<Task*> taskList;
 		uint64_t dispatcherCycle = 0;
+		DispatcherBatchStats batchStats;
+
+		struct IdleHandler {
+			std::function<bool()> run;
+			bool queued = false;
+		};
+
+		// queues the idle handlers that are not queued already
+		void queueIdleHandlers();
+		void runIdleSlice();
+
+		std::deque<std::function<bool()>> idleJobs;
+		std::vector<IdleHandler> idleHandlers;
+
+		std::atomic<Task*> lockfreeTaskHead{nullptr};
+		// switches producers between the mutex protected task list and the lock-free stack,
+		// the dispatcher thread always drains both
+		std::atomic<bool> lockfreeQueue{false};
+
+		// task statistics, everything but the switch is only touched by the dispatcher thread
+		std::atomic<bool> taskStats{false};
+		LatencyHistogram waitHistogram;
+		LatencyHistogram execHistogram;
+		std::chrono::steady_clock::time_point statsWindowStart;
+		std::chrono::microseconds slowTaskThreshold{0};
+		std::chrono::seconds statsInterval{0};
+		std::chrono::nanoseconds batchBudget{0};
+		std::chrono::steady_clock::time_point currentQueuedAt;
+		uint32_t runDepth = 0;
+		bool nestedRun = false;
 };
 
 extern Dispatcher g_dispatcher;
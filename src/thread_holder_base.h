@@ -5,6 +5,7 @@
 
 #include <thread>
 #include <atomic>
+#include "affinity.h"
 #include "enums.h"
 
 template <typename Derived>
@@ -17,6 +18,11 @@ class ThreadHolder
 			thread = std::thread(&Derived::threadMain, static_cast<Derived*>(this));
 		}
 
+		// accepts work without a thread of its own, the owner runs it (tvp_sim)
+		void startWithoutThread() {
+			setState(THREAD_STATE_RUNNING);
+		}
+
 		void stop() {
 			setState(THREAD_STATE_CLOSING);
 		}
@@ -26,6 +32,11 @@ class ThreadHolder
 				thread.join();
 			}
 		}
+
+		// pins the running thread to the cores threadAffinity gives role
+		void setAffinity(std::string_view role) {
+			affinity::pinThread(thread, role);
+		}
 	protected:
 		void setState(ThreadState newState) {
 			threadState.store(newState, std::memory_order_relaxed);
@@ -10,20 +10,43 @@
 #include "creature.h"
 #include "combat.h"
 #include "game.h"
+#include "itemupdatebatch.h"
 #include "mailbox.h"
 #include "monster.h"
 #include "movement.h"
 #include "teleport.h"
 #include "trashholder.h"
 #include "configmanager.h"
+#include "lockfree.h"
 
 extern Game g_game;
+
+namespace {
+
+// dropped as a whole once it grows this big
+constexpr size_t TILE_DESCRIPTION_CACHE_SIZE = 1 << 16;
+
+std::unordered_map<const Tile*, TileItemDescription> tileDescriptions;
+
+using TilePool = LockfreeObjectPool<Tile, sizeof(Tile), 16384>;
+
+}
 extern MoveEvents* g_moveEvents;
 extern ConfigManager g_config;
 
 Tile real_nullptr_tile(0xFFFF, 0xFFFF, 0xFF);
 Tile& Tile::nullptr_tile = real_nullptr_tile;
 
+void* Tile::operator new(size_t size)
+{
+	return TilePool::allocate(size);
+}
+
+void Tile::operator delete(void* p, size_t size)
+{
+	TilePool::deallocate(p, size);
+}
+
 bool Tile::hasProperty(ITEMPROPERTY prop) const
 {
 	if (ground && ground->hasProperty(prop)) {
@@ -395,30 +418,43 @@ void Tile::onAddTileItem(Item* item)
 	setTileFlags(item);
 	updateHouse(item);
 
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->updateTile(this);
+		return;
+	}
+
 	const Position& cylinderMapPos = getPosition();
 
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, cylinderMapPos, true);
 
 	//send to client
+	const TileStackpos stackpos(this, item);
 	for (Creature* spectator : spectators) {
 		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendAddTileItem(this, cylinderMapPos, item);
+			tmpPlayer->sendAddTileItem(cylinderMapPos, stackpos.get(tmpPlayer), item);
 		}
 	}
 }
 
 void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newItem, const ItemType& newType)
 {
+	markChanged();
+
 	const Position& cylinderMapPos = getPosition();
 
 	SpectatorVec spectators;
 	g_game.map.getSpectators(spectators, cylinderMapPos, true);
 
 	//send to client
-	for (Creature* spectator : spectators) {
-		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendUpdateTileItem(this, cylinderMapPos, newItem);
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->updateTile(this);
+	} else {
+		const TileStackpos stackpos(this, newItem);
+		for (Creature* spectator : spectators) {
+			if (Player* tmpPlayer = spectator->getPlayer()) {
+				tmpPlayer->sendUpdateTileItem(cylinderMapPos, stackpos.get(tmpPlayer), newItem);
+			}
 		}
 	}
 
@@ -436,10 +472,14 @@ void Tile::onRemoveTileItem(const SpectatorVec& spectators, const std::vector<in
 	const ItemType& iType = Item::items[item->getID()];
 
 	//send to client
-	size_t i = 0;
-	for (Creature* spectator : spectators) {
-		if (Player* tmpPlayer = spectator->getPlayer()) {
-			tmpPlayer->sendRemoveTileThing(cylinderMapPos, oldStackPosVector[i++]);
+	if (ItemUpdateBatch* batch = ItemUpdateBatch::getCurrent()) {
+		batch->updateTile(this);
+	} else {
+		size_t i = 0;
+		for (Creature* spectator : spectators) {
+			if (Player* tmpPlayer = spectator->getPlayer()) {
+				tmpPlayer->sendRemoveTileThing(cylinderMapPos, oldStackPosVector[i++]);
+			}
 		}
 	}
 
@@ -451,6 +491,8 @@ void Tile::onRemoveTileItem(const SpectatorVec& spectators, const std::vector<in
 
 void Tile::onUpdateTile(const SpectatorVec& spectators)
 {
+	markChanged();
+
 	const Position& cylinderMapPos = getPosition();
 
 	//send to clients
@@ -923,6 +965,7 @@ void Tile::addThing(int32_t, Thing* thing)
 		creature->setParent(this);
 		CreatureVector* creatures = makeCreatures();
 		creatures->insert(creatures->end(), creature);
+		updateFloorCreatures();
 	} else {
 		Item* item = thing->getItem();
 		if (item == nullptr) {
@@ -1139,6 +1182,7 @@ void Tile::removeThing(Thing* thing, uint32_t count)
 			auto it = std::find(creatures->begin(), creatures->end(), thing);
 			if (it != creatures->end()) {
 				creatures->erase(it);
+				updateFloorCreatures();
 			}
 		}
 		return;
@@ -1180,9 +1224,10 @@ void Tile::removeThing(Thing* thing, uint32_t count)
 
 		SpectatorVec spectators;
 		g_game.map.getSpectators(spectators, getPosition(), true);
+		const TileStackpos stackpos(this, item);
 		for (Creature* spectator : spectators) {
 			if (Player* tmpPlayer = spectator->getPlayer()) {
-				oldStackPosVector.push_back(getStackposOfItem(tmpPlayer, item));
+				oldStackPosVector.push_back(stackpos.get(tmpPlayer));
 			}
 		}
 
@@ -1204,9 +1249,10 @@ void Tile::removeThing(Thing* thing, uint32_t count)
 
 			SpectatorVec spectators;
 			g_game.map.getSpectators(spectators, getPosition(), true);
+			const TileStackpos stackpos(this, item);
 			for (Creature* spectator : spectators) {
 				if (Player* tmpPlayer = spectator->getPlayer()) {
-					oldStackPosVector.push_back(getStackposOfItem(tmpPlayer, item));
+					oldStackPosVector.push_back(stackpos.get(tmpPlayer));
 				}
 			}
 
@@ -1222,6 +1268,7 @@ void Tile::removeCreature(Creature* creature)
 {
 	g_game.map.getQTNode(tilePos.x, tilePos.y)->removeCreature(creature);
 	removeThing(creature, 0);
+	g_game.map.invalidateSpectatorCache(tilePos, creature);
 }
 
 int32_t Tile::getThingIndex(const Thing* thing) const
@@ -1294,7 +1341,7 @@ int32_t Tile::getClientIndexOfCreature(const Player* player, const Creature* cre
 		for (const Creature* c : boost::adaptors::reverse(*creatures)) {
 			if (c == creature) {
 				return n;
-			} else if (player->canSeeCreature(c)) {
+			} else if (!player || player->canSeeCreature(c)) {
 				n++;
 			}
 		}
@@ -1302,6 +1349,46 @@ int32_t Tile::getClientIndexOfCreature(const Player* player, const Creature* cre
 	return -1;
 }
 
+bool Tile::hasUniformVisibility() const
+{
+	const bool classicInvisibility = g_config.getBoolean(ConfigManager::CLASSIC_MONSTER_INVISIBILITY);
+	for (const Creature* creature : creatures) {
+		// see Player::canSeeCreature
+		if (creature->isInGhostMode() || (!classicInvisibility && !creature->getPlayer() && creature->isInvisible())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TileStackpos::TileStackpos(const Tile* tile, const Creature* creature) :
+	tile(tile), creature(creature), uniform(tile->hasUniformVisibility())
+{
+	if (uniform) {
+		stackpos = tile->getClientIndexOfCreature(nullptr, creature);
+	}
+}
+
+TileStackpos::TileStackpos(const Tile* tile, const Item* item) :
+	tile(tile), item(item), uniform(tile->hasUniformVisibility())
+{
+	if (uniform) {
+		stackpos = tile->getStackposOfItem(nullptr, item);
+	}
+}
+
+int32_t TileStackpos::get(const Player* player) const
+{
+	if (uniform) {
+		return stackpos;
+	}
+
+	if (creature) {
+		return tile->getClientIndexOfCreature(player, creature);
+	}
+	return tile->getStackposOfItem(player, item);
+}
+
 int32_t Tile::getStackposOfItem(const Player* player, const Item* item) const
 {
 	int32_t n = 0;
@@ -1332,7 +1419,7 @@ int32_t Tile::getStackposOfItem(const Player* player, const Item* item) const
 
 	if (const CreatureVector* creatures = getCreatures()) {
 		for (const Creature* creature : *creatures) {
-			if (player->canSeeCreature(creature)) {
+			if (!player || player->canSeeCreature(creature)) {
 				if (++n >= 10) {
 					return -1;
 				}
@@ -1510,6 +1597,7 @@ void Tile::internalAddThing(uint32_t, Thing* thing)
 	if (creature) {
 		CreatureVector* creatures = makeCreatures();
 		creatures->insert(creatures->end(), creature);
+		updateFloorCreatures();
 	} else {
 		Item* item = thing->getItem();
 		if (item == nullptr) {
@@ -1615,6 +1703,9 @@ void Tile::setTileFlags(const Item* item)
 	if (item->hasProperty(CONST_PROP_SUPPORTHANGABLE)) {
 		setFlag(TILESTATE_SUPPORTS_HANGABLE);
 	}
+
+	updateFloorMasks();
+	markChanged();
 }
 
 void Tile::resetTileFlags(const Item* item)
@@ -1681,6 +1772,75 @@ void Tile::resetTileFlags(const Item* item)
 	if (item->hasProperty(CONST_PROP_SUPPORTHANGABLE)) {
 		resetFlag(TILESTATE_SUPPORTS_HANGABLE);
 	}
+
+	updateFloorMasks();
+	markChanged();
+}
+
+Floor* Tile::getMapFloor() const
+{
+	// tiles still being loaded are not part of the map yet, Map::setTile picks them up
+	QTreeLeafNode* leaf = g_game.map.getQTNode(tilePos.x, tilePos.y);
+	if (!leaf) {
+		return nullptr;
+	}
+
+	Floor* floor = leaf->getFloor(tilePos.z);
+	if (floor && floor->tiles[tilePos.x & FLOOR_MASK][tilePos.y & FLOOR_MASK] == this) {
+		return floor;
+	}
+	return nullptr;
+}
+
+void Tile::updateFloorMasks() const
+{
+	if (Floor* floor = getMapFloor()) {
+		floor->updateTileMasks(tilePos.x, tilePos.y);
+	}
+}
+
+void Tile::updateFloorCreatures() const
+{
+	if (Floor* floor = getMapFloor()) {
+		floor->updateTileCreatures(tilePos.x, tilePos.y);
+	}
+}
+
+const TileItemDescription* Tile::getCachedDescription() const
+{
+	auto it = tileDescriptions.find(this);
+	if (it == tileDescriptions.end()) {
+		return nullptr;
+	}
+	return &it->second;
+}
+
+const TileItemDescription& Tile::setCachedDescription(TileItemDescription&& description) const
+{
+	if (tileDescriptions.size() >= TILE_DESCRIPTION_CACHE_SIZE) {
+		tileDescriptions.clear();
+	}
+	return tileDescriptions[this] = std::move(description);
+}
+
+void Tile::dropCachedDescription() const
+{
+	if (!tileDescriptions.empty()) {
+		tileDescriptions.erase(this);
+	}
+}
+
+void Tile::markChanged()
+{
+	dropCachedDescription();
+	++itemsVersion;
+	if (hasTrackFlag(TILETRACK_SAVE)) {
+		g_game.addTileToSaveJournal(this);
+	}
+
+	if (house) {
+		house->setItemsChanged();
+	}
 }
 
 void Tile::updateHouse(Item* item)
@@ -1735,6 +1895,57 @@ Item* Tile::getUseItem() const
 	return item;
 }
 
+uint32_t RefreshSnapshots::add(const std::vector<const Item*>& items)
+{
+	uint32_t first = descriptors.size();
+	for (const Item* item : items) {
+		Descriptor descriptor{item->getID(), item->getItemCount(), 0, 0};
+
+		// plain items come back from their id and count, the others need their attributes and contents
+		const ItemType& it = Item::items[item->getID()];
+		if (item->hasAttributes() || it.type != ITEM_TYPE_NONE || it.isContainer()) {
+			PropWriteStream propWriteStream;
+			item->serializeTVPFormat(propWriteStream);
+
+			size_t size;
+			const char* bytes = propWriteStream.getStream(size);
+			descriptor.dataOffset = data.size();
+			descriptor.dataSize = size;
+			data.insert(data.end(), bytes, bytes + size);
+		}
+		descriptors.push_back(descriptor);
+	}
+	return first;
+}
+
+Item* RefreshSnapshots::createItem(uint32_t index) const
+{
+	const Descriptor& descriptor = descriptors[index];
+	if (descriptor.dataSize == 0) {
+		return Item::CreateItem(descriptor.id, descriptor.count);
+	}
+
+	PropStream propStream;
+	propStream.init(data.data() + descriptor.dataOffset, descriptor.dataSize);
+
+	Item* item = Item::CreateItem(propStream);
+	if (!item) {
+		return nullptr;
+	}
+
+	if (!item->unserializeTVPFormat(propStream)) {
+		std::cout << "[Error - RefreshSnapshots::createItem] Failed to restore item " << descriptor.id << std::endl;
+		delete item;
+		return nullptr;
+	}
+
+	// as a clone would, the restored duration keeps running
+	if (item->getDuration() > 0) {
+		g_game.scheduleDecay(item);
+	}
+	return item;
+}
+
 void Tile::makeRefreshItemList()
 {
 	if (!g_config.getBoolean(ConfigManager::ENABLE_MAP_REFRESH)) {
@@ -1742,27 +1953,27 @@ void Tile::makeRefreshItemList()
 	}
 
 	if (hasFlag(TILESTATE_REFRESH)) {
-		TileItemVector* refreshableItems = getRefreshableItemList();
-		if (refreshableItems) {
-			// clear in case of map patch occuring
-			refreshableItems->clear();
-
-			if (Item* ground = getGround()) {
-				refreshableItems->push_back(ground->clone());
+		// down items first, reversed, then the ground and the top items, the order refresh adds them in
+		std::vector<const Item*> refreshItems;
+		if (TileItemVector* items = getItemList()) {
+			for (auto it = items->getEndDownItem(); it != items->getBeginDownItem(); ) {
+				refreshItems.push_back(*--it);
 			}
+		}
 
-			if (TileItemVector* items = getItemList()) {
-				// top items later
-				for (auto it = items->getBeginTopItem(); it != items->getEndTopItem(); it++) {
-					refreshableItems->push_back((*it)->clone());
-				}
+		if (Item* ground = getGround()) {
+			refreshItems.push_back(ground);
+		}
 
-				// down items first
-				for (auto it = items->getBeginDownItem(); it != items->getEndDownItem(); it++) {
-					refreshableItems->insert(refreshableItems->begin(), (*it)->clone());
-				}
+		if (TileItemVector* items = getItemList()) {
+			for (auto it = items->getBeginTopItem(); it != items->getEndTopItem(); it++) {
+				refreshItems.push_back(*it);
 			}
 		}
+
+		// a map patch takes a new range, the previous one stays unused in the table
+		refreshItemsBegin = g_game.map.refreshSnapshots.add(refreshItems);
+		refreshItemsCount = refreshItems.size();
 	}
 }
 
@@ -1792,10 +2003,10 @@ void Tile::refresh()
 		g_game.internalRemoveItem(item);
 	}
 
-	if (const TileItemVector* refreshableItems = getRefreshableItemList()) {
-		for (Item* item : *refreshableItems) {
-			// it is guarantee that there are no players around to see
-			internalAddThing(item->clone());
+	for (uint32_t i = 0; i < refreshItemsCount; ++i) {
+		// it is guarantee that there are no players around to see
+		if (Item* item = g_game.map.refreshSnapshots.createItem(refreshItemsBegin + i)) {
+			internalAddThing(item);
 		}
 	}
 
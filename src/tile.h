@@ -14,6 +14,7 @@ class TrashHolder;
 class Mailbox;
 class MagicField;
 class QTreeLeafNode;
+struct Floor;
 class BedItem;
 class House;
 
@@ -53,6 +54,15 @@ enum tileflags_t : uint32_t {
 	TILESTATE_FLOORCHANGE = TILESTATE_FLOORCHANGE_DOWN | TILESTATE_FLOORCHANGE_NORTH | TILESTATE_FLOORCHANGE_SOUTH | TILESTATE_FLOORCHANGE_EAST | TILESTATE_FLOORCHANGE_WEST | TILESTATE_FLOORCHANGE_SOUTH_ALT | TILESTATE_FLOORCHANGE_EAST_ALT,
 };
 
+// bookkeeping the game keeps per tile, never saved with the tile flags
+enum TileTrackFlags_t : uint8_t {
+	TILETRACK_REFRESH = 1 << 0,
+	TILETRACK_SAVE = 1 << 1,
+	TILETRACK_SAVE_DIRTY = 1 << 2, // changed since the last map data save
+	TILETRACK_SNAPSHOT_DIRTY = 1 << 3, // changed since the last full map data snapshot
+	TILETRACK_VOLATILE = 1 << 4, // written to the map data with items that change without Tile::markChanged
+};
+
 enum ZoneType_t {
 	ZONE_PROTECTION,
 	ZONE_NOPVP,
@@ -62,6 +72,14 @@ enum ZoneType_t {
 	ZONE_REFRESH,
 };
 
+// client encoding of the items of a tile, the same for every viewer
+struct TileItemDescription {
+	std::vector<uint8_t> bytes;
+	// end offset of each encoded item, ground and top items come first
+	std::vector<uint16_t> itemEnds;
+	uint8_t topItems = 0;
+};
+
 class TileItemVector : private ItemVector
 {
 	public:
@@ -133,34 +151,67 @@ class TileItemVector : private ItemVector
 		uint16_t downItemCount = 0;
 };
 
+/*
+ * The items refresh tiles are restored to, one table for the whole map. Items are kept as descriptors,
+ * id and count for plain items and their serialized form for the others, and only created on a refresh.
+ */
+class RefreshSnapshots
+{
+	public:
+		// appends the items, returns the index of the first one
+		uint32_t add(const std::vector<const Item*>& items);
+		Item* createItem(uint32_t index) const;
+
+		size_t size() const {
+			return descriptors.size();
+		}
+		size_t getMemoryUsage() const {
+			return descriptors.capacity() * sizeof(Descriptor) + data.capacity();
+		}
+
+	private:
+		struct Descriptor {
+			uint16_t id;
+			uint16_t count;
+			// into data, dataSize is 0 for plain items
+			uint32_t dataOffset;
+			uint32_t dataSize;
+		};
+
+		std::vector<Descriptor> descriptors;
+		std::vector<char> data;
+};
+
 class Tile : public Cylinder
 {
 	// By allocating the vectors in-house, we avoid some memory fragmentation
-	TileItemVector refreshableItems;
 	TileItemVector items;
 	CreatureVector creatures;
 
 	public:
 		static Tile& nullptr_tile;
-		Tile(uint16_t x, uint16_t y, uint8_t z) : tilePos(x, y, z) {}
+		Tile(uint16_t x, uint16_t y, uint8_t z) : tilePos(x, y, z) {
+			InstanceCounter<Tile>::onCreate();
+		}
 		virtual ~Tile() {
+			InstanceCounter<Tile>::onDestroy();
+			dropCachedDescription();
 			delete ground;
 
 			for (Item* item : items) {
 				item->setParent(nullptr);
 				item->decrementReferenceCounter();
 			}
-
-			for (Item* item : refreshableItems) {
-				item->setParent(nullptr);
-				item->decrementReferenceCounter();
-			}
 		};
 
 		// non-copyable
 		Tile(const Tile&) = delete;
 		Tile& operator=(const Tile&) = delete;
 
+		// tiles are recycled through a free list, see tile.cpp
+		static void* operator new(size_t size);
+		static void operator delete(void* p, size_t size);
+
 		TileItemVector* getItemList() {
 			return &items;
 		}
@@ -171,10 +222,6 @@ class Tile : public Cylinder
 			return &items;
 		}
 
-		TileItemVector* getRefreshableItemList() {
-			return &refreshableItems;
-		}
-
 		CreatureVector* getCreatures() {
 			return &creatures;
 		}
@@ -248,6 +295,16 @@ class Tile : public Cylinder
 			this->flags &= ~flag;
 		}
 
+		bool hasTrackFlag(uint8_t flag) const {
+			return (trackFlags & flag) != 0;
+		}
+		void setTrackFlag(uint8_t flag) {
+			trackFlags |= flag;
+		}
+		void resetTrackFlag(uint8_t flag) {
+			trackFlags &= ~flag;
+		}
+
 		ZoneType_t getZone() const {
 			if (hasFlag(TILESTATE_PROTECTIONZONE)) {
 				return ZONE_PROTECTION;
@@ -266,8 +323,11 @@ class Tile : public Cylinder
 
 		std::string getDescription(int32_t lookDistance) const override final;
 
+		// a nullptr player sees every creature
 		int32_t getClientIndexOfCreature(const Player* player, const Creature* creature) const;
 		int32_t getStackposOfItem(const Player* player, const Item* item) const;
+		// whether every player sees all the creatures here, so that stack positions are the same for everyone
+		bool hasUniformVisibility() const;
 
 		void updateRefreshTime();
 		int64_t getNextRefreshTime() const {
@@ -318,6 +378,7 @@ class Tile : public Cylinder
 			return ground;
 		}
 		void setGround(Item* item) {
+			markChanged();
 			ground = item;
 		}
 
@@ -333,6 +394,20 @@ class Tile : public Cylinder
 
 		void updateHouse(Item* item);
 
+		// refreshes the walkability bits and hot flags the map keeps for this tile
+		void updateFloorMasks() const;
+		void updateFloorCreatures() const;
+
+		// the items of the tile as encoded for clients, kept until the items change
+		const TileItemDescription* getCachedDescription() const;
+		const TileItemDescription& setCachedDescription(TileItemDescription&& description) const;
+		void dropCachedDescription() const;
+
+		// bumped each time the items change, a copy of the encoded items is current while it matches
+		uint32_t getItemsVersion() const {
+			return itemsVersion;
+		}
+
 	private:
 		void onAddTileItem(Item* item);
 		void onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newItem, const ItemType& newType);
@@ -342,10 +417,40 @@ class Tile : public Cylinder
 		void setTileFlags(const Item* item);
 		void resetTileFlags(const Item* item);
 
+		// the floor holding this tile, nullptr while it is not on the map
+		Floor* getMapFloor() const;
+
+		// the items changed: drops the cached description, bumps the items version and journals the tile for the next map save
+		void markChanged();
+
 		House* house = nullptr;
 
 		Item* ground = nullptr;
 		Position tilePos;
+		uint8_t trackFlags = 0;
 		uint32_t flags = 0;
+		uint32_t itemsVersion = 0;
 		int64_t nextRefreshTime = 0;
+
+		// range of Map::refreshSnapshots
+		uint32_t refreshItemsBegin = 0;
+		uint16_t refreshItemsCount = 0;
+};
+
+// The stack position of a thing on a tile for all the spectators of one change. It is worked out once,
+// and again for each player only while a creature on the tile is hidden from some of them.
+class TileStackpos
+{
+	public:
+		TileStackpos(const Tile* tile, const Creature* creature);
+		TileStackpos(const Tile* tile, const Item* item);
+
+		int32_t get(const Player* player) const;
+
+	private:
+		const Tile* tile;
+		const Creature* creature = nullptr;
+		const Item* item = nullptr;
+		int32_t stackpos = -1;
+		bool uniform = false;
 };
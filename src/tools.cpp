@@ -254,6 +254,16 @@ std::string transformToSHA1(const std::string& input)
 	return std::string(hexstring, 40);
 }
 
+uint64_t hashBytes(const char* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
 void replaceString(std::string& str, const std::string& sought, const std::string& replacement)
 {
 	size_t pos = 0;
@@ -288,6 +298,24 @@ std::string asLowerCaseString(std::string source)
 	return source;
 }
 
+size_t CaseInsensitiveHash::operator()(std::string_view str) const
+{
+	// FNV-1a over the lower case characters
+	uint64_t hash = 14695981039346656037ULL;
+	for (char c : str) {
+		hash ^= static_cast<uint8_t>(std::tolower(static_cast<uint8_t>(c)));
+		hash *= 1099511628211ULL;
+	}
+	return static_cast<size_t>(hash);
+}
+
+bool CaseInsensitiveEqual::operator()(std::string_view left, std::string_view right) const
+{
+	return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(), [](char a, char b) {
+		return std::tolower(static_cast<uint8_t>(a)) == std::tolower(static_cast<uint8_t>(b));
+	});
+}
+
 std::string asUpperCaseString(std::string source)
 {
 	std::transform(source.begin(), source.end(), source.begin(), toupper);
@@ -317,13 +345,62 @@ IntegerVector vectorAtoi(const StringVector& stringVector)
 	return returnVector;
 }
 
-std::mt19937& getRandomGenerator()
+void RandomGenerator::seed(uint64_t seed, uint64_t stream)
+{
+	// splitmix64 spreads the seed over the state, which must not be all zeros
+	uint64_t x = seed ^ (stream * 0x9E3779B97F4A7C15ULL);
+	for (uint64_t& word : state) {
+		x += 0x9E3779B97F4A7C15ULL;
+		uint64_t z = x;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		word = z ^ (z >> 31);
+	}
+}
+
+uint32_t RandomGenerator::bounded(uint32_t range)
 {
-	static std::random_device rd;
-	static std::mt19937 generator(rd());
+	const uint32_t bits = static_cast<uint32_t>((*this)() >> 32);
+	if (range == 0) {
+		return bits;
+	}
+
+	// Lemire's multiply and shift, the few values that would bias the result are drawn again
+	uint64_t product = static_cast<uint64_t>(bits) * range;
+	uint32_t low = static_cast<uint32_t>(product);
+	if (low < range) {
+		const uint32_t threshold = -range % range;
+		while (low < threshold) {
+			product = static_cast<uint64_t>(static_cast<uint32_t>((*this)() >> 32)) * range;
+			low = static_cast<uint32_t>(product);
+		}
+	}
+	return static_cast<uint32_t>(product >> 32);
+}
+
+namespace {
+
+std::atomic<uint64_t> nextRandomStream{0};
+
+}
+
+RandomGenerator& getRandomGenerator()
+{
+	thread_local RandomGenerator generator = []() {
+		RandomGenerator generator;
+		std::random_device rd;
+		generator.seed((static_cast<uint64_t>(rd()) << 32) | rd(), nextRandomStream++);
+		return generator;
+	}();
 	return generator;
 }
 
+void seedRandomGenerator(uint32_t seed)
+{
+	getRandomGenerator().seed(seed, 0);
+	srand(seed);
+}
+
 int32_t random(int32_t minNumber, int32_t maxNumber)
 {
 	bool negate = minNumber < 0 || maxNumber < 0;
@@ -334,7 +411,7 @@ int32_t random(int32_t minNumber, int32_t maxNumber)
 
 	int32_t result = maxNumber - minNumber + 1;
 	if (result > 0) {
-		result = rand() % result + minNumber;
+		result = getRandomGenerator().bounded(result) + minNumber;
 		if (negate) {
 			return -result;
 		}
@@ -351,18 +428,19 @@ int32_t random(int32_t minNumber, int32_t maxNumber)
 
 int32_t uniform_random(int32_t minNumber, int32_t maxNumber)
 {
-	static std::uniform_int_distribution<int32_t> uniformRand;
 	if (minNumber == maxNumber) {
 		return minNumber;
 	} else if (minNumber > maxNumber) {
 		std::swap(minNumber, maxNumber);
 	}
-	return uniformRand(getRandomGenerator(), std::uniform_int_distribution<int32_t>::param_type(minNumber, maxNumber));
+
+	const uint32_t range = static_cast<uint32_t>(static_cast<int64_t>(maxNumber) - minNumber + 1);
+	return static_cast<int32_t>(static_cast<int64_t>(minNumber) + getRandomGenerator().bounded(range));
 }
 
 int32_t normal_random(int32_t minNumber, int32_t maxNumber)
 {
-	static std::normal_distribution<float> normalRand(0.5f, 0.25f);
+	thread_local std::normal_distribution<float> normalRand(0.5f, 0.25f);
 	if (minNumber == maxNumber) {
 		return minNumber;
 	} else if (minNumber > maxNumber) {
@@ -384,8 +462,8 @@ int32_t normal_random(int32_t minNumber, int32_t maxNumber)
 
 bool boolean_random(double probability/* = 0.5*/)
 {
-	static std::bernoulli_distribution booleanRand;
-	return booleanRand(getRandomGenerator(), std::bernoulli_distribution::param_type(probability));
+	// 53 random bits as a double in [0, 1)
+	return static_cast<double>(getRandomGenerator()() >> 11) * 0x1.0p-53 < probability;
 }
 
 void trimString(std::string& str)
@@ -1223,7 +1301,21 @@ const char* getReturnMessage(ReturnValue value)
 	}
 }
 
+namespace {
+
+std::atomic<int64_t> virtualTime{0};
+
+}
+
+void setVirtualTime(int64_t time)
+{
+	virtualTime.store(time, std::memory_order_relaxed);
+}
+
 int64_t OTSYS_TIME()
 {
+	if (const int64_t time = virtualTime.load(std::memory_order_relaxed); time != 0) {
+		return time;
+	}
 	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
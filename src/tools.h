@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <bit>
 #include <random>
 
 #include "position.h"
@@ -18,6 +19,8 @@ uint8_t getLiquidColor(uint8_t type);
 void printXMLError(const std::string& where, const std::string& fileName, const pugi::xml_parse_result& result);
 
 std::string transformToSHA1(const std::string& input);
+// FNV-1a, cheap enough to tell whether a data file changed
+uint64_t hashBytes(const char* data, size_t size);
 
 void replaceString(std::string& str, const std::string& sought, const std::string& replacement);
 void trim_right(std::string& source, char t);
@@ -26,6 +29,19 @@ void toLowerCaseString(std::string& source);
 std::string asLowerCaseString(std::string source);
 std::string asUpperCaseString(std::string source);
 
+// for containers keyed by names, looked up with any string type without lower casing a copy first
+struct CaseInsensitiveHash
+{
+	using is_transparent = void;
+	size_t operator()(std::string_view str) const;
+};
+
+struct CaseInsensitiveEqual
+{
+	using is_transparent = void;
+	bool operator()(std::string_view left, std::string_view right) const;
+};
+
 using StringVector = std::vector<std::string>;
 using IntegerVector = std::vector<int32_t>;
 
@@ -35,7 +51,44 @@ constexpr bool hasBitSet(uint32_t flag, uint32_t flags) {
 	return (flags & flag) != 0;
 }
 
-std::mt19937& getRandomGenerator();
+// xoshiro256**, every thread draws from a generator and a stream of its own
+class RandomGenerator
+{
+	public:
+		using result_type = uint64_t;
+
+		static constexpr result_type min() {
+			return 0;
+		}
+		static constexpr result_type max() {
+			return std::numeric_limits<result_type>::max();
+		}
+
+		// generators of the same seed and different streams do not overlap in practice
+		void seed(uint64_t seed, uint64_t stream);
+
+		result_type operator()() {
+			const uint64_t result = std::rotl(state[1] * 5, 7) * 9;
+			const uint64_t t = state[1] << 17;
+			state[2] ^= state[0];
+			state[3] ^= state[1];
+			state[1] ^= state[2];
+			state[0] ^= state[3];
+			state[2] ^= t;
+			state[3] = std::rotl(state[3], 45);
+			return result;
+		}
+
+		// uniform in [0, range), 0 for the whole 32 bit range, without a division in the common case
+		uint32_t bounded(uint32_t range);
+
+	private:
+		std::array<uint64_t, 4> state;
+};
+
+RandomGenerator& getRandomGenerator();
+// seeds the generator of the calling thread and rand(), so a run can take the same random turns again
+void seedRandomGenerator(uint32_t seed);
 int32_t random(int32_t minNumber, int32_t maxNumber);
 int32_t uniform_random(int32_t minNumber, int32_t maxNumber);
 int32_t normal_random(int32_t minNumber, int32_t maxNumber);
@@ -82,6 +135,8 @@ itemAttrTypes stringToItemAttribute(const std::string& str);
 const char* getReturnMessage(ReturnValue value);
 
 int64_t OTSYS_TIME();
+// OTSYS_TIME returns this instead of the system clock, 0 goes back to the clock; for tvp_sim
+void setVirtualTime(int64_t time);
 
 namespace tvp {
 
@@ -0,0 +1,126 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "trafficstats.h"
+#include "configmanager.h"
+#include "filetasks.h"
+#include "game.h"
+#include "tools.h"
+
+extern ConfigManager g_config;
+extern Game g_game;
+
+TrafficStats g_trafficStats;
+
+namespace {
+
+// players listed in the report, the ones sending the most messages first
+constexpr size_t REPORT_PLAYERS = 10;
+
+void formatEntries(std::string& report, const char* title, const std::array<TrafficStats::Entry, 256>& entries)
+{
+	std::vector<uint8_t> opcodes;
+	uint64_t totalBytes = 0;
+	for (size_t opcode = 0; opcode < entries.size(); ++opcode) {
+		if (entries[opcode].messages != 0) {
+			opcodes.push_back(static_cast<uint8_t>(opcode));
+			totalBytes += entries[opcode].bytes;
+		}
+	}
+
+	std::sort(opcodes.begin(), opcodes.end(), [&entries](uint8_t lhs, uint8_t rhs) {
+		return entries[lhs].bytes > entries[rhs].bytes;
+	});
+
+	report += fmt::format("{:s}\n{:>6s} {:>12s} {:>14s} {:>8s} {:>8s}\n", title, "opcode", "messages", "bytes", "avg", "share");
+	for (uint8_t opcode : opcodes) {
+		const TrafficStats::Entry& entry = entries[opcode];
+		report += fmt::format("  0x{:02X} {:>12d} {:>14d} {:>8d} {:>7.2f}%\n",
+			opcode, entry.messages, entry.bytes, entry.bytes / entry.messages, entry.bytes * 100. / totalBytes);
+	}
+}
+
+}
+
+TrafficCounter::Rates TrafficCounter::getRates(int64_t now) const
+{
+	// the last window is stale once a whole window went by without traffic
+	if (now - windowStart >= 2 * WINDOW) {
+		return {};
+	}
+
+	const Window& window = now - windowStart >= WINDOW ? current : last;
+	const double seconds = WINDOW / 1000.;
+	return {window.sentBytes / seconds, window.sentMessages / seconds, window.receivedBytes / seconds, window.receivedMessages / seconds};
+}
+
+void TrafficCounter::roll(int64_t now)
+{
+	if (now - windowStart < WINDOW) {
+		return;
+	}
+
+	sentBytes += current.sentBytes;
+	receivedBytes += current.receivedBytes;
+	last = now - windowStart < 2 * WINDOW ? current : Window();
+	current = {};
+	windowStart = now - (now - windowStart) % WINDOW;
+}
+
+void TrafficStats::loadConfig()
+{
+	enabled = g_config.getBoolean(ConfigManager::TRAFFIC_STATS);
+	logInterval = std::chrono::seconds(g_config.getNumber(ConfigManager::TRAFFIC_STATS_LOG_INTERVAL));
+	nextLog = std::chrono::steady_clock::now() + logInterval;
+}
+
+void TrafficStats::checkLog()
+{
+	if (logInterval.count() == 0) {
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (now >= nextLog) {
+		dump("data/logs/traffic.log");
+		nextLog = now + logInterval;
+	}
+}
+
+void TrafficStats::dump(const std::string& fileName) const
+{
+	std::string report = fmt::format("[{:s}]\n", formatDate(time(nullptr)));
+	formatEntries(report, "sent", sent);
+	formatEntries(report, "received", received);
+
+	const int64_t now = OTSYS_TIME();
+	std::vector<std::pair<const Player*, TrafficCounter::Rates>> players;
+	for (const auto& it : g_game.getPlayers()) {
+		if (const TrafficCounter* counter = it.second->getTrafficCounter()) {
+			players.emplace_back(it.second, counter->getRates(now));
+		}
+	}
+
+	const size_t count = std::min(players.size(), REPORT_PLAYERS);
+	std::partial_sort(players.begin(), players.begin() + count, players.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.second.receivedMessages > rhs.second.receivedMessages;
+	});
+
+	report += fmt::format("players, per second\n{:>10s} {:>10s} {:>10s} {:>10s}  player\n", "recv msgs", "recv bytes", "sent msgs", "sent bytes");
+	for (size_t i = 0; i < count; ++i) {
+		const TrafficCounter::Rates& rates = players[i].second;
+		report += fmt::format("{:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}  {:s}\n",
+			rates.receivedMessages, rates.receivedBytes, rates.sentMessages, rates.sentBytes, players[i].first->getName());
+	}
+	report += '\n';
+
+	g_fileTasks.writeFile(fileName, std::move(report), true);
+}
+
+void TrafficStats::reset()
+{
+	sent = {};
+	received = {};
+}
@@ -0,0 +1,112 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+// bytes and messages of a single client, with the rates of the last complete window
+class TrafficCounter
+{
+	public:
+		struct Rates {
+			double sentBytes = 0;
+			double sentMessages = 0;
+			double receivedBytes = 0;
+			double receivedMessages = 0;
+		};
+
+		void addSent(size_t bytes, int64_t now) {
+			roll(now);
+			++current.sentMessages;
+			current.sentBytes += bytes;
+		}
+		void addReceived(size_t bytes, int64_t now) {
+			roll(now);
+			++current.receivedMessages;
+			current.receivedBytes += bytes;
+		}
+
+		// per second
+		Rates getRates(int64_t now) const;
+
+		uint64_t getSentBytes() const {
+			return sentBytes + current.sentBytes;
+		}
+		uint64_t getReceivedBytes() const {
+			return receivedBytes + current.receivedBytes;
+		}
+
+	private:
+		static constexpr int64_t WINDOW = 10000;
+
+		struct Window {
+			uint64_t sentBytes = 0;
+			uint64_t sentMessages = 0;
+			uint64_t receivedBytes = 0;
+			uint64_t receivedMessages = 0;
+		};
+
+		void roll(int64_t now);
+
+		Window current;
+		Window last;
+		int64_t windowStart = 0;
+		// totals of the windows before the current one
+		uint64_t sentBytes = 0;
+		uint64_t receivedBytes = 0;
+};
+
+/*
+ * Counts the game protocol messages and bytes per opcode in both directions, the opcode of a
+ * server message is the first one written to it. Sizes are the ones of the plain payload,
+ * without the length header, checksum and encryption padding.
+ * Dispatcher thread only.
+ */
+class TrafficStats
+{
+	public:
+		struct Entry {
+			uint64_t messages = 0;
+			uint64_t bytes = 0;
+		};
+
+		bool isEnabled() const {
+			return enabled;
+		}
+
+		void loadConfig();
+
+		void addSent(uint8_t opcode, size_t bytes) {
+			Entry& entry = sent[opcode];
+			++entry.messages;
+			entry.bytes += bytes;
+			checkLog();
+		}
+		void addReceived(uint8_t opcode, size_t bytes) {
+			Entry& entry = received[opcode];
+			++entry.messages;
+			entry.bytes += bytes;
+		}
+
+		const std::array<Entry, 256>& getSent() const {
+			return sent;
+		}
+		const std::array<Entry, 256>& getReceived() const {
+			return received;
+		}
+
+		// appends the report to fileName on the file thread
+		void dump(const std::string& fileName) const;
+		void reset();
+
+	private:
+		void checkLog();
+
+		std::array<Entry, 256> sent;
+		std::array<Entry, 256> received;
+
+		std::chrono::steady_clock::time_point nextLog;
+		std::chrono::seconds logInterval{0};
+		bool enabled = false;
+};
+
+extern TrafficStats g_trafficStats;
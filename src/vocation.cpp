@@ -25,9 +25,14 @@ bool Vocations::loadFromXml()
 		}
 
 		uint16_t id = pugi::cast<uint16_t>(attr.value());
-		auto res = vocationsMap.emplace(std::piecewise_construct,
-				std::forward_as_tuple(id), std::forward_as_tuple(id));
-		Vocation& voc = res.first->second;
+		if (id >= vocations.size()) {
+			vocations.resize(id + 1);
+		}
+
+		if (!vocations[id]) {
+			vocations[id] = std::make_unique<Vocation>(id);
+		}
+		Vocation& voc = *vocations[id];
 
 		vocationNode.remove_attribute("id");
 		for (auto attrNode : vocationNode.attributes()) {
@@ -107,30 +112,29 @@ bool Vocations::loadFromXml()
 
 Vocation* Vocations::getVocation(uint16_t id)
 {
-	auto it = vocationsMap.find(id);
-	if (it == vocationsMap.end()) {
+	if (id >= vocations.size() || !vocations[id]) {
 		std::cout << "[Warning - Vocations::getVocation] Vocation " << id << " not found." << std::endl;
 		return nullptr;
 	}
-	return &it->second;
+	return vocations[id].get();
 }
 
 int32_t Vocations::getVocationId(const std::string& name) const
 {
-	auto it = std::find_if(vocationsMap.begin(), vocationsMap.end(), [&name](auto it) {
-		return name.size() == it.second.name.size() && std::equal(name.begin(), name.end(), it.second.name.begin(), [](char a, char b) {
+	auto it = std::find_if(vocations.begin(), vocations.end(), [&name](const auto& vocation) {
+		return vocation && name.size() == vocation->name.size() && std::equal(name.begin(), name.end(), vocation->name.begin(), [](char a, char b) {
 			return std::tolower(a) == std::tolower(b);
 		});
 	});
-	return it != vocationsMap.end() ? it->first : -1;
+	return it != vocations.end() ? (*it)->getId() : -1;
 }
 
 uint16_t Vocations::getPromotedVocation(uint16_t id) const
 {
-	auto it = std::find_if(vocationsMap.begin(), vocationsMap.end(), [id](auto it) {
-		return it.second.fromVocation == id && it.first != id;
+	auto it = std::find_if(vocations.begin(), vocations.end(), [id](const auto& vocation) {
+		return vocation && vocation->fromVocation == id && vocation->getId() != id;
 	});
-	return it != vocationsMap.end() ? it->first : VOCATION_NONE;
+	return it != vocations.end() ? (*it)->getId() : VOCATION_NONE;
 }
 
 static const uint32_t skillBase[SKILL_LAST + 1] = {50, 50, 50, 50, 30, 100, 20};
@@ -117,5 +117,6 @@ class Vocations
 		uint16_t getPromotedVocation(uint16_t vocationId) const;
 
 	private:
-		std::map<uint16_t, Vocation> vocationsMap;
+		// by id, nullptr for the ids no vocation has
+		std::vector<std::unique_ptr<Vocation>> vocations;
 };
@@ -29,11 +29,8 @@ const Weapon* Weapons::getWeapon(const Item* item) const
 		return nullptr;
 	}
 
-	auto it = weapons.find(item->getID());
-	if (it == weapons.end()) {
-		return nullptr;
-	}
-	return it->second;
+	const uint16_t id = item->getID();
+	return id < weapons.size() ? weapons[id] : nullptr;
 }
 
 void Weapons::clear()
@@ -43,6 +40,16 @@ void Weapons::clear()
 	getScriptInterface().reInitState();
 }
 
+void Weapons::removeScriptFile(const std::string* scriptFile)
+{
+	for (Weapon*& weapon : weapons) {
+		if (weapon && weapon->isFromScriptFile(scriptFile)) {
+			delete weapon;
+			weapon = nullptr;
+		}
+	}
+}
+
 LuaScriptInterface& Weapons::getScriptInterface()
 {
 	return scriptInterface;
@@ -55,9 +62,13 @@ std::string Weapons::getScriptBaseName() const
 
 void Weapons::loadDefaults()
 {
+	if (weapons.size() < Item::items.size()) {
+		weapons.resize(Item::items.size());
+	}
+
 	for (size_t i = 100, size = Item::items.size(); i < size; ++i) {
 		const ItemType& it = Item::items.getItemType(i);
-		if (it.id == 0 || weapons.find(i) != weapons.end()) {
+		if (it.id == 0 || weapons[i]) {
 			continue;
 		}
 
@@ -91,7 +102,12 @@ void Weapons::loadDefaults()
 
 bool Weapons::registerLuaEvent(Weapon* weapon)
 {
-	weapons[weapon->getID()] = weapon;
+	const uint16_t id = weapon->getID();
+	if (id >= weapons.size()) {
+		weapons.resize(std::max<size_t>(id + 1, Item::items.size()));
+	}
+
+	weapons[id] = weapon;
 	return true;
 }
 
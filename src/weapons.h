@@ -36,12 +36,14 @@ class Weapons final
 
 		bool registerLuaEvent(Weapon* event);
 		void clear();
+		void removeScriptFile(const std::string* scriptFile);
 
 	private:
 		LuaScriptInterface& getScriptInterface();
 		std::string getScriptBaseName() const;
 
-		std::map<uint32_t, Weapon*> weapons;
+		// by item id, nullptr for items that are no weapon
+		std::vector<Weapon*> weapons;
 
 		LuaScriptInterface scriptInterface { "Weapon Interface" };
 };
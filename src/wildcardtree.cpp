@@ -3,111 +3,40 @@
 
 #include "otpch.h"
 
-#include <stack>
-
 #include "wildcardtree.h"
 
-WildcardTreeNode* WildcardTreeNode::getChild(char ch)
-{
-	auto it = children.find(ch);
-	if (it == children.end()) {
-		return nullptr;
-	}
-	return &it->second;
-}
-
-const WildcardTreeNode* WildcardTreeNode::getChild(char ch) const
+void WildcardTree::insert(const std::string& str)
 {
-	auto it = children.find(ch);
-	if (it == children.end()) {
-		return nullptr;
+	auto it = std::lower_bound(names.begin(), names.end(), str);
+	if (it == names.end() || *it != str) {
+		names.insert(it, str);
 	}
-	return &it->second;
 }
 
-WildcardTreeNode* WildcardTreeNode::addChild(char ch, bool breakpoint)
+void WildcardTree::remove(const std::string& str)
 {
-	WildcardTreeNode* child = getChild(ch);
-	if (child) {
-		if (breakpoint && !child->breakpoint) {
-			child->breakpoint = true;
-		}
-	} else {
-		auto pair = children.emplace(std::piecewise_construct,
-				std::forward_as_tuple(ch), std::forward_as_tuple(breakpoint));
-		child = &pair.first->second;
-	}
-	return child;
-}
-
-void WildcardTreeNode::insert(const std::string& str)
-{
-	WildcardTreeNode* cur = this;
-
-	size_t length = str.length() - 1;
-	for (size_t pos = 0; pos < length; ++pos) {
-		cur = cur->addChild(str[pos], false);
+	auto it = std::lower_bound(names.begin(), names.end(), str);
+	if (it != names.end() && *it == str) {
+		names.erase(it);
 	}
-
-	cur->addChild(str[length], true);
 }
 
-void WildcardTreeNode::remove(const std::string& str)
+ReturnValue WildcardTree::findOne(const std::string& query, std::string& result) const
 {
-	WildcardTreeNode* cur = this;
+	auto hasPrefix = [&query](const std::string& name) {
+		return name.compare(0, query.size(), query) == 0;
+	};
 
-	std::stack<WildcardTreeNode*> path;
-	path.push(cur);
-	size_t len = str.length();
-	for (size_t pos = 0; pos < len; ++pos) {
-		cur = cur->getChild(str[pos]);
-		if (!cur) {
-			return;
-		}
-		path.push(cur);
+	auto it = std::lower_bound(names.begin(), names.end(), query);
+	if (it == names.end() || !hasPrefix(*it)) {
+		return RETURNVALUE_PLAYERWITHTHISNAMEISNOTONLINE;
 	}
 
-	cur->breakpoint = false;
-
-	do {
-		cur = path.top();
-		path.pop();
-
-		if (!cur->children.empty() || cur->breakpoint || path.empty()) {
-			break;
-		}
-
-		cur = path.top();
-
-		auto it = cur->children.find(str[--len]);
-		if (it != cur->children.end()) {
-			cur->children.erase(it);
-		}
-	} while (true);
-}
-
-ReturnValue WildcardTreeNode::findOne(const std::string& query, std::string& result) const
-{
-	const WildcardTreeNode* cur = this;
-	for (char pos : query) {
-		cur = cur->getChild(pos);
-		if (!cur) {
-			return RETURNVALUE_PLAYERWITHTHISNAMEISNOTONLINE;
-		}
+	auto next = std::next(it);
+	if (next != names.end() && hasPrefix(*next)) {
+		return RETURNVALUE_NAMEISTOOAMBIGUOUS;
 	}
 
-	result = query;
-
-	do {
-		size_t size = cur->children.size();
-		if (size == 0) {
-			return RETURNVALUE_NOERROR;
-		} else if (size > 1 || cur->breakpoint) {
-			return RETURNVALUE_NAMEISTOOAMBIGUOUS;
-		}
-
-		auto it = cur->children.begin();
-		result += it->first;
-		cur = &it->second;
-	} while (true);
+	result = *it;
+	return RETURNVALUE_NOERROR;
 }
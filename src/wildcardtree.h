@@ -5,26 +5,15 @@
 
 #include "enums.h"
 
-class WildcardTreeNode
+// names kept sorted in a flat array, the names a query is a prefix of are next to each other
+class WildcardTree
 {
 	public:
-		explicit WildcardTreeNode(bool breakpoint) : breakpoint(breakpoint) {}
-		WildcardTreeNode(WildcardTreeNode&& other) = default;
-
-		// non-copyable
-		WildcardTreeNode(const WildcardTreeNode&) = delete;
-		WildcardTreeNode& operator=(const WildcardTreeNode&) = delete;
-
-		WildcardTreeNode* getChild(char ch);
-		const WildcardTreeNode* getChild(char ch) const;
-		WildcardTreeNode* addChild(char ch, bool breakpoint);
-
 		void insert(const std::string& str);
 		void remove(const std::string& str);
 
 		ReturnValue findOne(const std::string& query, std::string& result) const;
 
 	private:
-		std::map<char, WildcardTreeNode> children;
-		bool breakpoint;
+		std::vector<std::string> names;
 };
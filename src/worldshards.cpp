@@ -0,0 +1,84 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "worldshards.h"
+#include "configmanager.h"
+#include "pugicast.h"
+#include "tools.h"
+
+extern ConfigManager g_config;
+
+WorldShards g_worldShards;
+
+namespace {
+
+bool isInArea(const WorldShards::Area& area, const Position& pos)
+{
+	return pos.x >= area.fromX && pos.x <= area.toX && pos.y >= area.fromY && pos.y <= area.toY;
+}
+
+}
+
+bool WorldShards::load()
+{
+	const uint32_t shardId = g_config.getNumber(ConfigManager::SHARD_ID);
+	if (shardId == 0) {
+		return true;
+	}
+
+	pugi::xml_document doc;
+	pugi::xml_parse_result result = doc.load_file("data/XML/shards.xml");
+	if (!result) {
+		printXMLError("Error - WorldShards::load", "data/XML/shards.xml", result);
+		return false;
+	}
+
+	for (auto shardNode : doc.child("shards").children("shard")) {
+		Shard shard;
+		shard.id = pugi::cast<uint32_t>(shardNode.attribute("id").value());
+		shard.name = shardNode.attribute("name").as_string();
+		shard.ip = shardNode.attribute("ip").as_string();
+		shard.port = pugi::cast<uint16_t>(shardNode.attribute("port").value());
+
+		for (auto areaNode : shardNode.children("area")) {
+			Area area;
+			area.fromX = pugi::cast<uint16_t>(areaNode.attribute("fromx").value());
+			area.fromY = pugi::cast<uint16_t>(areaNode.attribute("fromy").value());
+			area.toX = pugi::cast<uint16_t>(areaNode.attribute("tox").value());
+			area.toY = pugi::cast<uint16_t>(areaNode.attribute("toy").value());
+			shard.areas.push_back(area);
+		}
+		shards.push_back(std::move(shard));
+	}
+
+	auto it = std::find_if(shards.begin(), shards.end(), [shardId](const Shard& shard) { return shard.id == shardId; });
+	if (it == shards.end() || it->areas.empty()) {
+		std::cout << "[Error - WorldShards::load] Shard " << shardId << " has no area in data/XML/shards.xml." << std::endl;
+		return false;
+	}
+
+	ownShard = &*it;
+	std::cout << ">> Running shard " << ownShard->name << " (" << ownShard->areas.size() << " areas of " << shards.size() << " shards)." << std::endl;
+	return true;
+}
+
+bool WorldShards::isOwned(const Position& pos) const
+{
+	if (!ownShard) {
+		return true;
+	}
+
+	return std::any_of(ownShard->areas.begin(), ownShard->areas.end(), [&pos](const Area& area) { return isInArea(area, pos); });
+}
+
+const WorldShards::Shard* WorldShards::getShard(const Position& pos) const
+{
+	for (const Shard& shard : shards) {
+		if (std::any_of(shard.areas.begin(), shard.areas.end(), [&pos](const Area& area) { return isInArea(area, pos); })) {
+			return &shard;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,50 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+#include "position.h"
+
+/*
+ * Experimental: the map split by region between several processes, each one running the areas given to
+ * its shardId in data/XML/shards.xml. Every process loads the whole map and the same gamedata/, but only
+ * spawns and moves creatures within its own areas. A player stepping or teleported out of them is logged
+ * out where it stands, so its file holds the new position, and it logs in again on the shard that owns it;
+ * routing the client there is up to a proxy in front of the shards. A player who may not log out, being in
+ * a fight, cannot leave. Nothing is shared along the borders: the players on either side do not see each
+ * other. Each shard saves only the houses within its areas and keeps a live map file of its own.
+ */
+class WorldShards
+{
+	public:
+		struct Area {
+			uint16_t fromX, fromY;
+			uint16_t toX, toY;
+		};
+
+		struct Shard {
+			uint32_t id = 0;
+			std::string name;
+			std::string ip;
+			uint16_t port = 0;
+			std::vector<Area> areas;
+		};
+
+		// data/XML/shards.xml, only while shardId is set
+		bool load();
+
+		bool isEnabled() const {
+			return ownShard != nullptr;
+		}
+
+		// true for every position while sharding is off
+		bool isOwned(const Position& pos) const;
+		// the shard owning pos, nullptr if none does
+		const Shard* getShard(const Position& pos) const;
+
+	private:
+		std::vector<Shard> shards;
+		const Shard* ownShard = nullptr;
+};
+
+extern WorldShards g_worldShards;
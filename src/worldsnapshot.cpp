@@ -0,0 +1,118 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "otpch.h"
+
+#include "worldsnapshot.h"
+#include "configmanager.h"
+#include "filetasks.h"
+#include "game.h"
+#include "scheduler.h"
+
+#include <fmt/format.h>
+
+extern ConfigManager g_config;
+extern Game g_game;
+
+WorldSnapshot g_worldSnapshot;
+
+namespace {
+
+void addString(std::string& text, std::string_view value)
+{
+	text += '"';
+	for (char c : value) {
+		switch (c) {
+			case '"': text += "\\\""; break;
+			case '\\': text += "\\\\"; break;
+			case '\n': text += "\\n"; break;
+			case '\r': text += "\\r"; break;
+			case '\t': text += "\\t"; break;
+			default:
+				if (static_cast<uint8_t>(c) < 0x20) {
+					text += fmt::format("\\u{:04x}", static_cast<uint8_t>(c));
+				} else {
+					text += c;
+				}
+				break;
+		}
+	}
+	text += '"';
+}
+
+}
+
+void WorldSnapshot::start()
+{
+	if (g_config.getNumber(ConfigManager::WORLD_SNAPSHOT_INTERVAL) <= 0) {
+		return;
+	}
+
+	refresh();
+	std::cout << ">> World snapshot written to " << g_config.getString(ConfigManager::WORLD_SNAPSHOT_FILE) << std::endl;
+}
+
+void WorldSnapshot::shutdown()
+{
+	g_scheduler.stopEvent(refreshEvent);
+	refreshEvent = 0;
+}
+
+void WorldSnapshot::refresh()
+{
+	std::string text;
+	text += fmt::format("{{\"time\":{:d},\"playersRecord\":{:d},\"players\":[", time(nullptr), g_game.getPlayersRecord());
+
+	bool first = true;
+	for (const auto& it : g_game.getPlayers()) {
+		const Player* player = it.second;
+		if (!first) {
+			text += ',';
+		}
+		first = false;
+
+		text += "{\"name\":";
+		addString(text, player->getName());
+		text += fmt::format(",\"level\":{:d},\"vocation\":", player->getLevel());
+		addString(text, player->getVocation()->getVocName());
+		if (const Guild* guild = player->getGuild()) {
+			text += ",\"guild\":";
+			addString(text, guild->getName());
+			if (GuildRank_ptr rank = player->getGuildRank()) {
+				text += ",\"rank\":";
+				addString(text, rank->name);
+			}
+		}
+		text += '}';
+	}
+
+	text += "],\"houses\":[";
+	first = true;
+	for (const auto& it : g_game.map.houses.getHouses()) {
+		const House* house = it.second;
+		if (!first) {
+			text += ',';
+		}
+		first = false;
+
+		text += fmt::format("{{\"id\":{:d},\"name\":", house->getId());
+		addString(text, house->getName());
+		text += fmt::format(",\"town\":{:d},\"owner\":", house->getTownId());
+		if (house->getOwner() != 0) {
+			addString(text, house->getOwnerName());
+		} else {
+			text += "null";
+		}
+		text += '}';
+	}
+	text += "]}\n";
+
+	g_fileTasks.writeFile(g_config.getString(ConfigManager::WORLD_SNAPSHOT_FILE), std::move(text));
+
+	const int32_t interval = g_config.getNumber(ConfigManager::WORLD_SNAPSHOT_INTERVAL);
+	if (interval > 0) {
+		refreshEvent = g_scheduler.addEvent(createSchedulerTask(interval * 1000, [this]() { refresh(); }, "WorldSnapshot::refresh"));
+	} else {
+		refreshEvent = 0;
+	}
+}
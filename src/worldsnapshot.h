@@ -0,0 +1,25 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+/*
+ * The online players, the house owners and the players record as JSON in worldSnapshotFile, written
+ * every worldSnapshotInterval seconds. The file is replaced in one rename, so the website and other
+ * tools can read it at any time without asking the database or the game. Dispatcher thread.
+ */
+class WorldSnapshot
+{
+	public:
+		// once the game runs; nothing happens while worldSnapshotInterval is 0
+		void start();
+		// before the scheduler stops
+		void shutdown();
+
+	private:
+		void refresh();
+
+		uint64_t refreshEvent = 0;
+};
+
+extern WorldSnapshot g_worldSnapshot;
@@ -8,22 +8,30 @@
 #include <array>
 #include <assert.h>
 
-namespace xtea {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define XTEA_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define XTEA_NEON 1
+#include <arm_neon.h>
+#endif
 
-round_keys expand_key(const key& k)
-{
-	constexpr uint32_t delta = 0x9E3779B9;
-	round_keys expanded;
+#if defined(XTEA_X86) && !defined(_MSC_VER)
+#define XTEA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define XTEA_TARGET_AVX2
+#endif
 
-	for (uint32_t i = 0, sum = 0, next_sum = sum + delta; i < expanded.size(); i += 2, sum = next_sum, next_sum += delta) {
-		expanded[i] = sum + k[sum & 3];
-		expanded[i + 1] = next_sum + k[(next_sum >> 11) & 3];
-	}
+namespace xtea {
 
-	return expanded;
-}
+namespace {
 
-void encrypt(uint8_t* data, size_t length, const round_keys& k)
+// Scalar kernels, they also take care of the blocks left over by the vector kernels
+
+void encrypt_scalar(uint8_t* data, size_t length, const round_keys& k)
 {
 	for (int32_t i = 0; i < k.size(); i += 2) {
 		for (auto it = data, last = data + length; it < last; it += 8) {
@@ -40,7 +48,7 @@ void encrypt(uint8_t* data, size_t length, const round_keys& k)
 	}
 }
 
-void decrypt(uint8_t* data, size_t length, const round_keys& k)
+void decrypt_scalar(uint8_t* data, size_t length, const round_keys& k)
 {
 	for (int32_t i = k.size() - 1; i > 0; i -= 2) {
 		for (auto it = data, last = data + length; it < last; it += 8) {
@@ -57,4 +65,234 @@ void decrypt(uint8_t* data, size_t length, const round_keys& k)
 	}
 }
 
+#ifdef XTEA_X86
+
+// SSE2: 4 blocks per iteration, the halves of the blocks are split into one vector of lefts and one of rights
+// and every round of the group is run while it stays in registers
+
+inline __m128i round_sse2(__m128i v, __m128i key)
+{
+	return _mm_xor_si128(_mm_add_epi32(_mm_xor_si128(_mm_slli_epi32(v, 4), _mm_srli_epi32(v, 5)), v), key);
+}
+
+size_t encrypt_sse2(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = 0;
+	for (; done + 32 <= length; done += 32) {
+		__m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + done)));
+		__m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + done + 16)));
+		__m128i left = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i right = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (size_t i = 0; i < k.size(); i += 2) {
+			left = _mm_add_epi32(left, round_sse2(right, _mm_set1_epi32(k[i])));
+			right = _mm_add_epi32(right, round_sse2(left, _mm_set1_epi32(k[i + 1])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + done), _mm_unpacklo_epi32(left, right));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + done + 16), _mm_unpackhi_epi32(left, right));
+	}
+	return done;
+}
+
+size_t decrypt_sse2(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = 0;
+	for (; done + 32 <= length; done += 32) {
+		__m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + done)));
+		__m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + done + 16)));
+		__m128i left = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i right = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (int32_t i = k.size() - 1; i > 0; i -= 2) {
+			right = _mm_sub_epi32(right, round_sse2(left, _mm_set1_epi32(k[i])));
+			left = _mm_sub_epi32(left, round_sse2(right, _mm_set1_epi32(k[i - 1])));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + done), _mm_unpacklo_epi32(left, right));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + done + 16), _mm_unpackhi_epi32(left, right));
+	}
+	return done;
+}
+
+// AVX2: 8 blocks per iteration, the shuffles work inside each 128 bit lane and the unpacks undo exactly that
+
+XTEA_TARGET_AVX2 inline __m256i round_avx2(__m256i v, __m256i key)
+{
+	return _mm256_xor_si256(_mm256_add_epi32(_mm256_xor_si256(_mm256_slli_epi32(v, 4), _mm256_srli_epi32(v, 5)), v), key);
+}
+
+XTEA_TARGET_AVX2 size_t encrypt_avx2(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = 0;
+	for (; done + 64 <= length; done += 64) {
+		__m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + done)));
+		__m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + done + 32)));
+		__m256i left = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m256i right = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (size_t i = 0; i < k.size(); i += 2) {
+			left = _mm256_add_epi32(left, round_avx2(right, _mm256_set1_epi32(k[i])));
+			right = _mm256_add_epi32(right, round_avx2(left, _mm256_set1_epi32(k[i + 1])));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + done), _mm256_unpacklo_epi32(left, right));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + done + 32), _mm256_unpackhi_epi32(left, right));
+	}
+	return done + encrypt_sse2(data + done, length - done, k);
+}
+
+XTEA_TARGET_AVX2 size_t decrypt_avx2(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = 0;
+	for (; done + 64 <= length; done += 64) {
+		__m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + done)));
+		__m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + done + 32)));
+		__m256i left = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		__m256i right = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		for (int32_t i = k.size() - 1; i > 0; i -= 2) {
+			right = _mm256_sub_epi32(right, round_avx2(left, _mm256_set1_epi32(k[i])));
+			left = _mm256_sub_epi32(left, round_avx2(right, _mm256_set1_epi32(k[i - 1])));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + done), _mm256_unpacklo_epi32(left, right));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + done + 32), _mm256_unpackhi_epi32(left, right));
+	}
+	return done + decrypt_sse2(data + done, length - done, k);
+}
+
+bool cpuSupportsAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+
+	// the OS must save the ymm registers (OSXSAVE + XCR0) besides the CPU having AVX2
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+#ifdef XTEA_NEON
+
+// NEON: vld2 splits 4 blocks into lefts and rights on load and vst2 interleaves them back
+
+inline uint32x4_t round_neon(uint32x4_t v, uint32_t key)
+{
+	return veorq_u32(vaddq_u32(veorq_u32(vshlq_n_u32(v, 4), vshrq_n_u32(v, 5)), v), vdupq_n_u32(key));
+}
+
+size_t encrypt_neon(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = 0;
+	for (; done + 32 <= length; done += 32) {
+		uint32x4x2_t v = vld2q_u32(reinterpret_cast<const uint32_t*>(data + done));
+		for (size_t i = 0; i < k.size(); i += 2) {
+			v.val[0] = vaddq_u32(v.val[0], round_neon(v.val[1], k[i]));
+			v.val[1] = vaddq_u32(v.val[1], round_neon(v.val[0], k[i + 1]));
+		}
+		vst2q_u32(reinterpret_cast<uint32_t*>(data + done), v);
+	}
+	return done;
+}
+
+size_t decrypt_neon(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = 0;
+	for (; done + 32 <= length; done += 32) {
+		uint32x4x2_t v = vld2q_u32(reinterpret_cast<const uint32_t*>(data + done));
+		for (int32_t i = k.size() - 1; i > 0; i -= 2) {
+			v.val[1] = vsubq_u32(v.val[1], round_neon(v.val[0], k[i]));
+			v.val[0] = vsubq_u32(v.val[0], round_neon(v.val[1], k[i - 1]));
+		}
+		vst2q_u32(reinterpret_cast<uint32_t*>(data + done), v);
+	}
+	return done;
+}
+
+#endif
+
+using kernel = size_t (*)(uint8_t*, size_t, const round_keys&);
+
+struct Kernels {
+	kernel encrypt;
+	kernel decrypt;
+	const char* name;
+};
+
+Kernels selectKernels()
+{
+#if defined(XTEA_X86)
+	if (cpuSupportsAVX2()) {
+		return {encrypt_avx2, decrypt_avx2, "AVX2"};
+	}
+	return {encrypt_sse2, decrypt_sse2, "SSE2"};
+#elif defined(XTEA_NEON)
+	return {encrypt_neon, decrypt_neon, "NEON"};
+#else
+	return {[](uint8_t*, size_t, const round_keys&) -> size_t { return 0; }, [](uint8_t*, size_t, const round_keys&) -> size_t { return 0; }, "scalar"};
+#endif
+}
+
+const Kernels kernels = selectKernels();
+
+} // namespace
+
+round_keys expand_key(const key& k)
+{
+	constexpr uint32_t delta = 0x9E3779B9;
+	round_keys expanded;
+
+	for (uint32_t i = 0, sum = 0, next_sum = sum + delta; i < expanded.size(); i += 2, sum = next_sum, next_sum += delta) {
+		expanded[i] = sum + k[sum & 3];
+		expanded[i + 1] = next_sum + k[(next_sum >> 11) & 3];
+	}
+
+	return expanded;
+}
+
+void encrypt(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = kernels.encrypt(data, length, k);
+	if (done < length) {
+		encrypt_scalar(data + done, length - done, k);
+	}
+}
+
+void decrypt(uint8_t* data, size_t length, const round_keys& k)
+{
+	size_t done = kernels.decrypt(data, length, k);
+	if (done < length) {
+		decrypt_scalar(data + done, length - done, k);
+	}
+}
+
+void encrypt_reference(uint8_t* data, size_t length, const round_keys& k)
+{
+	encrypt_scalar(data, length, k);
+}
+
+void decrypt_reference(uint8_t* data, size_t length, const round_keys& k)
+{
+	decrypt_scalar(data, length, k);
+}
+
+const char* kernel_name()
+{
+	return kernels.name;
+}
+
 } // namespace xtea
@@ -12,4 +12,9 @@ round_keys expand_key(const key& k);
 void encrypt(uint8_t* data, size_t length, const round_keys& k);
 void decrypt(uint8_t* data, size_t length, const round_keys& k);
 
+// plain scalar implementation and the name of the vector kernel picked for this CPU, meant for benchmarks
+void encrypt_reference(uint8_t* data, size_t length, const round_keys& k);
+void decrypt_reference(uint8_t* data, size_t length, const round_keys& k);
+const char* kernel_name();
+
 } // namespace xtea
@@ -0,0 +1,192 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#include "client.h"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace loadgen {
+
+namespace {
+
+constexpr size_t RSA_BLOCK_SIZE = 128;
+
+void writeU16(std::vector<uint8_t>& out, uint16_t value)
+{
+	out.push_back(static_cast<uint8_t>(value));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+}
+
+RsaPublicKey::~RsaPublicKey()
+{
+	EVP_PKEY_free(pkey);
+}
+
+bool RsaPublicKey::load(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	const std::string pem{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+	BIO* bio = BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size()));
+	if (!bio) {
+		return false;
+	}
+
+	pkey = PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr);
+	BIO_free(bio);
+	return pkey != nullptr;
+}
+
+bool RsaPublicKey::encrypt(uint8_t* block) const
+{
+	EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_pkey(nullptr, pkey, nullptr);
+	if (!ctx) {
+		return false;
+	}
+
+	uint8_t encrypted[RSA_BLOCK_SIZE];
+	size_t length = sizeof(encrypted);
+	const bool encryptedBlock = EVP_PKEY_encrypt_init(ctx) > 0 && EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_NO_PADDING) > 0 &&
+	                            EVP_PKEY_encrypt(ctx, encrypted, &length, block, RSA_BLOCK_SIZE) > 0 && length == RSA_BLOCK_SIZE;
+	EVP_PKEY_CTX_free(ctx);
+
+	if (encryptedBlock) {
+		std::memcpy(block, encrypted, RSA_BLOCK_SIZE);
+	}
+	return encryptedBlock;
+}
+
+void OutPacket::addU16(uint16_t value)
+{
+	writeU16(body, value);
+}
+
+void OutPacket::addU32(uint32_t value)
+{
+	addU16(static_cast<uint16_t>(value));
+	addU16(static_cast<uint16_t>(value >> 16));
+}
+
+void OutPacket::addString(std::string_view value)
+{
+	addU16(static_cast<uint16_t>(value.size()));
+	body.insert(body.end(), value.begin(), value.end());
+}
+
+void OutPacket::addBytes(const uint8_t* bytes, size_t size)
+{
+	body.insert(body.end(), bytes, bytes + size);
+}
+
+void OutPacket::addPosition(uint16_t x, uint16_t y, uint8_t z)
+{
+	addU16(x);
+	addU16(y);
+	addByte(z);
+}
+
+std::vector<uint8_t> OutPacket::finishPlain() const
+{
+	std::vector<uint8_t> out;
+	out.reserve(body.size() + 2);
+	writeU16(out, static_cast<uint16_t>(body.size()));
+	out.insert(out.end(), body.begin(), body.end());
+	return out;
+}
+
+std::vector<uint8_t> OutPacket::finishEncrypted(const xtea::round_keys& keys) const
+{
+	std::vector<uint8_t> out;
+	out.reserve(body.size() + 12);
+	writeU16(out, 0);
+	writeU16(out, static_cast<uint16_t>(body.size()));
+	out.insert(out.end(), body.begin(), body.end());
+
+	// the encrypted part (inner length and body) is a multiple of the xtea block
+	out.resize(2 + (out.size() - 2 + 7) / 8 * 8, 0);
+	xtea::encrypt(out.data() + 2, out.size() - 2, keys);
+
+	const uint16_t length = static_cast<uint16_t>(out.size() - 2);
+	out[0] = static_cast<uint8_t>(length);
+	out[1] = static_cast<uint8_t>(length >> 8);
+	return out;
+}
+
+bool InPacket::decrypt(std::vector<uint8_t>& body, const xtea::round_keys& keys)
+{
+	if (body.size() < 8 || body.size() % 8 != 0) {
+		return false;
+	}
+
+	xtea::decrypt(body.data(), body.size(), keys);
+
+	const size_t innerLength = body[0] | body[1] << 8;
+	if (innerLength + 2 > body.size()) {
+		return false;
+	}
+
+	data = body.data() + 2;
+	size = innerLength;
+	position = 0;
+	overrun = false;
+	return true;
+}
+
+bool InPacket::canRead(size_t count)
+{
+	if (position + count > size) {
+		overrun = true;
+		return false;
+	}
+	return true;
+}
+
+uint8_t InPacket::getByte()
+{
+	if (!canRead(1)) {
+		return 0;
+	}
+	return data[position++];
+}
+
+uint16_t InPacket::getU16()
+{
+	if (!canRead(2)) {
+		return 0;
+	}
+
+	const uint16_t value = data[position] | data[position + 1] << 8;
+	position += 2;
+	return value;
+}
+
+uint32_t InPacket::getU32()
+{
+	const uint32_t low = getU16();
+	return low | static_cast<uint32_t>(getU16()) << 16;
+}
+
+std::string InPacket::getString()
+{
+	const uint16_t length = getU16();
+	if (!canRead(length)) {
+		return {};
+	}
+
+	std::string value(reinterpret_cast<const char*>(data + position), length);
+	position += length;
+	return value;
+}
+
+}
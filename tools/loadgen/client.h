@@ -0,0 +1,100 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+#pragma once
+
+// xtea.h relies on the server's precompiled header for these
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "xtea.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct evp_pkey_st;
+typedef evp_pkey_st EVP_PKEY;
+
+namespace loadgen {
+
+// public half of the server key (key.pem), the first message of each protocol is encrypted with it
+class RsaPublicKey
+{
+	public:
+		RsaPublicKey() = default;
+		~RsaPublicKey();
+
+		// non-copyable
+		RsaPublicKey(const RsaPublicKey&) = delete;
+		RsaPublicKey& operator=(const RsaPublicKey&) = delete;
+
+		bool load(const std::string& filename);
+
+		// encrypts a 128 byte block in place without padding, the server decrypts it the same way
+		bool encrypt(uint8_t* block) const;
+
+	private:
+		EVP_PKEY* pkey = nullptr;
+};
+
+// client to server packet, the body is written first and framed when it is sent
+class OutPacket
+{
+	public:
+		void addByte(uint8_t value) {
+			body.push_back(value);
+		}
+		void addU16(uint16_t value);
+		void addU32(uint32_t value);
+		void addString(std::string_view value);
+		void addBytes(const uint8_t* bytes, size_t size);
+		void addPosition(uint16_t x, uint16_t y, uint8_t z);
+
+		size_t size() const {
+			return body.size();
+		}
+
+		// length header and body, only the first message of a connection goes out like this
+		std::vector<uint8_t> finishPlain() const;
+		// inner length, body and padding encrypted with xtea, behind the length header
+		std::vector<uint8_t> finishEncrypted(const xtea::round_keys& keys) const;
+
+	private:
+		std::vector<uint8_t> body;
+};
+
+// server to client packet, read in place over the decrypted body
+class InPacket
+{
+	public:
+		// decrypts the body (the bytes after the length header) and checks its inner length
+		bool decrypt(std::vector<uint8_t>& data, const xtea::round_keys& keys);
+
+		uint8_t getByte();
+		uint16_t getU16();
+		uint32_t getU32();
+		std::string getString();
+
+		bool isEmpty() const {
+			return size == 0;
+		}
+		// the inner length, the payload of all the messages in the packet
+		size_t getSize() const {
+			return size;
+		}
+		bool isOverrun() const {
+			return overrun;
+		}
+
+	private:
+		bool canRead(size_t count);
+
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		size_t position = 0;
+		bool overrun = false;
+};
+
+}
@@ -0,0 +1,734 @@
+// Copyright 2023 The Forgotten Server Authors and Alejandro Mujica for many specific source code changes, All rights reserved.
+// Use of this source code is governed by the GPL-2.0 License that can be found in the LICENSE file.
+
+/*
+ * Headless load generator: logs in scripted bots through the same protocol as the 7.72 client
+ * (RSA first message, then XTEA) and drives them at a fixed rate with a weighted mix of actions:
+ * walking, turning, talking, attacking other bots and opening their backpack. The server response
+ * latency is measured with pings sent between the actions, along with login times and traffic.
+ * Each bot draws its actions from its own generator seeded from --seed, so runs can be repeated.
+ */
+
+#include "client.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <fmt/format.h>
+
+namespace loadgen {
+
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::tcp;
+
+// protocol constants of the 7.72 client, see ProtocolLogin and ProtocolGame
+constexpr uint16_t CLIENT_VERSION = 772;
+constexpr uint16_t CLIENT_OS = 2; // CLIENTOS_WINDOWS
+constexpr uint8_t LOGIN_PROTOCOL_ID = 0x01;
+constexpr uint8_t GAME_PROTOCOL_ID = 0x0A;
+constexpr uint8_t TALKTYPE_SAY = 1;
+constexpr uint8_t SLOT_BACKPACK = 3;
+
+enum Action_t : uint8_t {
+	ACTION_WALK,
+	ACTION_TURN,
+	ACTION_SAY,
+	ACTION_ATTACK,
+	ACTION_USE,
+
+	ACTION_LAST = ACTION_USE
+};
+
+constexpr std::array<const char*, ACTION_LAST + 1> actionNames = {"walk", "turn", "say", "attack", "use"};
+
+const std::array<std::string, 4> chatter = {
+	"hi", "anyone selling a backpack of manas?", "where is the depot", "bye",
+};
+
+struct Account {
+	uint32_t number = 0;
+	std::string password;
+	std::string character;
+};
+
+struct Scenario {
+	std::string host = "127.0.0.1";
+	uint16_t loginPort = 7171;
+	uint16_t gamePort = 7172;
+	std::string keyFile = "key.pem";
+	std::string accountsFile = "accounts.txt";
+	size_t bots = 0;
+	size_t threads = 2;
+	uint32_t seed = 1;
+	double actionsPerSecond = 1.;
+	std::chrono::milliseconds pingInterval{1000};
+	std::chrono::milliseconds rampInterval{50};
+	std::chrono::seconds duration{60};
+	std::chrono::seconds reportInterval{5};
+	uint16_t backpackSpriteId = 1988;
+	bool useLoginServer = false;
+	std::array<double, ACTION_LAST + 1> mix = {50, 10, 10, 10, 20};
+};
+
+// latency samples in milliseconds, kept whole for the summary and per interval for the reports
+class LatencyRecorder
+{
+	public:
+		void add(double milliseconds) {
+			std::lock_guard<std::mutex> lockClass(lock);
+			interval.push_back(milliseconds);
+			total.push_back(milliseconds);
+		}
+
+		std::string takeInterval() {
+			std::vector<double> samples;
+			{
+				std::lock_guard<std::mutex> lockClass(lock);
+				samples.swap(interval);
+			}
+			return format(samples);
+		}
+
+		std::string summary() {
+			std::lock_guard<std::mutex> lockClass(lock);
+			return format(total);
+		}
+
+	private:
+		static std::string format(std::vector<double>& samples) {
+			if (samples.empty()) {
+				return "n=0";
+			}
+
+			std::sort(samples.begin(), samples.end());
+			auto percentile = [&samples](double p) { return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))]; };
+			return fmt::format("n={:d} p50={:.2f} p90={:.2f} p99={:.2f} max={:.2f} ms", samples.size(), percentile(0.5), percentile(0.9), percentile(0.99), samples.back());
+		}
+
+		std::mutex lock;
+		std::vector<double> interval;
+		std::vector<double> total;
+};
+
+struct Stats {
+	explicit Stats(size_t bots) : creatureIds(bots) {}
+
+	std::atomic<uint64_t> actions{0};
+	std::atomic<uint64_t> packetsSent{0};
+	std::atomic<uint64_t> packetsReceived{0};
+	std::atomic<uint64_t> bytesSent{0};
+	std::atomic<uint64_t> bytesReceived{0};
+	std::atomic<uint32_t> online{0};
+	std::atomic<uint32_t> loginFailures{0};
+	std::atomic<uint32_t> disconnects{0};
+
+	LatencyRecorder ping;
+	LatencyRecorder login;
+
+	// the player id of every bot in game, 0 while it is not, bots attack each other
+	std::vector<std::atomic<uint32_t>> creatureIds;
+};
+
+class Bot : public std::enable_shared_from_this<Bot>
+{
+	public:
+		Bot(boost::asio::io_context& io_context, const Scenario& scenario, const RsaPublicKey& rsa, const tcp::endpoint& endpoint,
+		    Account account, size_t index, Stats& stats) :
+			strand(boost::asio::make_strand(io_context)), socket(strand), actionTimer(strand), pingTimer(strand),
+			scenario(scenario), rsa(rsa), endpoint(endpoint), account(std::move(account)), index(index), stats(stats),
+			rng(scenario.seed + static_cast<uint32_t>(index)), actionDistribution(scenario.mix.begin(), scenario.mix.end()) {}
+
+		void start() {
+			boost::asio::post(strand, [self = shared_from_this()]() {
+				self->loginStart = Clock::now();
+				self->connect(self->scenario.useLoginServer ? self->scenario.loginPort : self->scenario.gamePort);
+			});
+		}
+
+		void stop() {
+			boost::asio::post(strand, [self = shared_from_this()]() {
+				if (self->state == State::PLAYING) {
+					OutPacket packet;
+					packet.addByte(0x14); // logout
+					self->sendPacket(packet);
+				}
+				self->close(false);
+			});
+		}
+
+	private:
+		enum class State : uint8_t {
+			LOGIN_SERVER,
+			GAME_LOGIN,
+			PLAYING,
+			CLOSED,
+		};
+
+		void connect(uint16_t port) {
+			state = port == scenario.gamePort ? State::GAME_LOGIN : State::LOGIN_SERVER;
+
+			for (uint32_t& part : key) {
+				part = rng();
+			}
+			roundKeys = xtea::expand_key(key);
+
+			tcp::endpoint target(endpoint.address(), port);
+			socket.async_connect(target, [self = shared_from_this()](const boost::system::error_code& error) {
+				if (error) {
+					self->fail(fmt::format("could not connect: {:s}", error.message()));
+					return;
+				}
+
+				self->sendFirstMessage();
+				self->readHeader();
+			});
+		}
+
+		void sendFirstMessage() {
+			OutPacket packet;
+			packet.addByte(state == State::GAME_LOGIN ? GAME_PROTOCOL_ID : LOGIN_PROTOCOL_ID);
+			packet.addU16(CLIENT_OS);
+			packet.addU16(CLIENT_VERSION);
+			if (state == State::LOGIN_SERVER) {
+				// dat, spr and pic signatures, not checked
+				const uint8_t signatures[12] = {};
+				packet.addBytes(signatures, sizeof(signatures));
+			}
+
+			OutPacket block;
+			block.addByte(0); // the server checks the first decrypted byte
+			for (uint32_t part : key) {
+				block.addU32(part);
+			}
+			if (state == State::GAME_LOGIN) {
+				block.addByte(0); // gamemaster flag
+				block.addU32(account.number);
+				block.addString(account.character);
+				block.addString(account.password);
+				block.addU16(0); // no OTCv8 identification
+			} else {
+				block.addU32(account.number);
+				block.addString(account.password);
+			}
+
+			std::vector<uint8_t> rsaBlock = block.finishPlain();
+			rsaBlock.erase(rsaBlock.begin(), rsaBlock.begin() + 2);
+			rsaBlock.resize(128, 0);
+			if (!rsa.encrypt(rsaBlock.data())) {
+				fail("could not encrypt the first message");
+				return;
+			}
+
+			packet.addBytes(rsaBlock.data(), rsaBlock.size());
+			queueSend(packet.finishPlain());
+		}
+
+		void sendPacket(const OutPacket& packet) {
+			queueSend(packet.finishEncrypted(roundKeys));
+		}
+
+		void queueSend(std::vector<uint8_t>&& data) {
+			if (state == State::CLOSED) {
+				return;
+			}
+
+			stats.packetsSent.fetch_add(1, std::memory_order_relaxed);
+			stats.bytesSent.fetch_add(data.size(), std::memory_order_relaxed);
+
+			sendQueue.push_back(std::make_shared<const std::vector<uint8_t>>(std::move(data)));
+			if (sendQueue.size() == 1) {
+				writeNext();
+			}
+		}
+
+		void writeNext() {
+			// the handler keeps the buffer alive, close drops the queue while a write may still be on its way
+			auto data = sendQueue.front();
+			boost::asio::async_write(socket, boost::asio::buffer(*data), [self = shared_from_this(), data, connection = connection](const boost::system::error_code& error, size_t) {
+				if (connection != self->connection) {
+					return;
+				}
+
+				if (error) {
+					self->fail(fmt::format("could not send: {:s}", error.message()));
+					return;
+				}
+
+				self->sendQueue.pop_front();
+				if (!self->sendQueue.empty()) {
+					self->writeNext();
+				}
+			});
+		}
+
+		void readHeader() {
+			boost::asio::async_read(socket, boost::asio::buffer(header), [self = shared_from_this()](const boost::system::error_code& error, size_t) {
+				if (error) {
+					self->fail(fmt::format("connection lost: {:s}", error.message()));
+					return;
+				}
+
+				const uint16_t size = self->header[0] | self->header[1] << 8;
+				self->body.resize(size);
+				self->readBody();
+			});
+		}
+
+		void readBody() {
+			boost::asio::async_read(socket, boost::asio::buffer(body), [self = shared_from_this()](const boost::system::error_code& error, size_t) {
+				if (error) {
+					self->fail(fmt::format("connection lost: {:s}", error.message()));
+					return;
+				}
+
+				self->stats.packetsReceived.fetch_add(1, std::memory_order_relaxed);
+				self->stats.bytesReceived.fetch_add(self->body.size() + self->header.size(), std::memory_order_relaxed);
+
+				InPacket packet;
+				if (!packet.decrypt(self->body, self->roundKeys)) {
+					self->fail("could not decrypt a packet");
+					return;
+				}
+
+				if (self->onPacket(packet)) {
+					self->readHeader();
+				}
+			});
+		}
+
+		// returns whether the connection reads on
+		bool onPacket(InPacket& packet) {
+			switch (state) {
+				case State::LOGIN_SERVER: {
+					// motd (0x14) and character list (0x64), or an error (0x0A)
+					if (packet.getByte() == 0x0A) {
+						fail(fmt::format("login server: {:s}", packet.getString()));
+						return false;
+					}
+
+					// the game connection starts its own reads
+					close(false);
+					connect(scenario.gamePort);
+					return false;
+				}
+
+				case State::GAME_LOGIN: {
+					const uint8_t opcode = packet.getByte();
+					if (opcode != 0x0A) {
+						// 0x14 is a disconnect message, 0x16 the waiting list
+						fail(fmt::format("game server: {:s}", opcode == 0x14 || opcode == 0x16 ? packet.getString() : fmt::format("unexpected opcode 0x{:02X}", opcode)));
+						return false;
+					}
+
+					creatureId = packet.getU32();
+					stats.creatureIds[index].store(creatureId, std::memory_order_relaxed);
+					stats.online.fetch_add(1, std::memory_order_relaxed);
+					stats.login.add(std::chrono::duration<double, std::milli>(Clock::now() - loginStart).count());
+
+					state = State::PLAYING;
+					scheduleAction();
+					schedulePing();
+					return true;
+				}
+
+				case State::PLAYING: {
+					// the messages carry no length of their own, only a packet holding nothing but the answer is
+					// known to be one, an answer sent along with other messages leaves the ping unanswered
+					if (pingPending && packet.getSize() == 1 && packet.getByte() == 0x1E) {
+						pingPending = false;
+						stats.ping.add(std::chrono::duration<double, std::milli>(Clock::now() - pingSent).count());
+					}
+					return true;
+				}
+
+				default:
+					return false;
+			}
+		}
+
+		void scheduleAction() {
+			// exponential gaps give the bots a steady average rate without moving in lockstep
+			std::exponential_distribution<double> gap(scenario.actionsPerSecond);
+			actionTimer.expires_after(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap(rng))));
+			actionTimer.async_wait([self = shared_from_this()](const boost::system::error_code& error) {
+				if (error || self->state != State::PLAYING) {
+					return;
+				}
+
+				self->doAction(static_cast<Action_t>(self->actionDistribution(self->rng)));
+				self->scheduleAction();
+			});
+		}
+
+		void doAction(Action_t action) {
+			OutPacket packet;
+			switch (action) {
+				case ACTION_WALK:
+					packet.addByte(0x65 + rng() % 4); // north, east, south or west
+					break;
+
+				case ACTION_TURN:
+					packet.addByte(0x6F + rng() % 4);
+					break;
+
+				case ACTION_SAY:
+					packet.addByte(0x96);
+					packet.addByte(TALKTYPE_SAY);
+					packet.addString(chatter[rng() % chatter.size()]);
+					break;
+
+				case ACTION_ATTACK: {
+					if (attacking) {
+						packet.addByte(0xBE); // cancel attack and follow
+						attacking = false;
+						break;
+					}
+
+					const uint32_t target = stats.creatureIds[rng() % stats.creatureIds.size()].load(std::memory_order_relaxed);
+					if (target == 0 || target == creatureId) {
+						return;
+					}
+
+					packet.addByte(0xA1);
+					packet.addU32(target);
+					attacking = true;
+					break;
+				}
+
+				case ACTION_USE:
+					if (containerOpen) {
+						packet.addByte(0x87); // close container
+						packet.addByte(0);
+					} else {
+						packet.addByte(0x82); // use the backpack in its slot, it opens as container 0
+						packet.addPosition(0xFFFF, SLOT_BACKPACK, 0);
+						packet.addU16(scenario.backpackSpriteId);
+						packet.addByte(0);
+						packet.addByte(0);
+					}
+					containerOpen = !containerOpen;
+					break;
+			}
+
+			stats.actions.fetch_add(1, std::memory_order_relaxed);
+			sendPacket(packet);
+		}
+
+		void schedulePing() {
+			pingTimer.expires_after(scenario.pingInterval);
+			pingTimer.async_wait([self = shared_from_this()](const boost::system::error_code& error) {
+				if (error || self->state != State::PLAYING) {
+					return;
+				}
+
+				// 0x1E answers the pings of the server, which would kick the bot otherwise, and is never answered itself
+				OutPacket pong;
+				pong.addByte(0x1E);
+				self->sendPacket(pong);
+
+				// 0x1D asks for a ping back, an unanswered one is dropped and the next one measures again
+				OutPacket packet;
+				packet.addByte(0x1D);
+				self->pingPending = true;
+				self->pingSent = Clock::now();
+				self->sendPacket(packet);
+				self->schedulePing();
+			});
+		}
+
+		void fail(const std::string& reason) {
+			if (state == State::CLOSED) {
+				return;
+			}
+
+			std::cout << "[bot " << index << ' ' << account.character << "] " << reason << std::endl;
+			close(true);
+		}
+
+		void close(bool failed) {
+			if (state == State::PLAYING) {
+				stats.online.fetch_sub(1, std::memory_order_relaxed);
+				stats.creatureIds[index].store(0, std::memory_order_relaxed);
+				if (failed) {
+					stats.disconnects.fetch_add(1, std::memory_order_relaxed);
+				}
+			} else if (failed) {
+				stats.loginFailures.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			boost::system::error_code error;
+			actionTimer.cancel();
+			pingTimer.cancel();
+			socket.shutdown(tcp::socket::shutdown_both, error);
+			socket.close(error);
+			sendQueue.clear();
+			++connection;
+			state = State::CLOSED;
+		}
+
+		boost::asio::strand<boost::asio::io_context::executor_type> strand;
+		tcp::socket socket;
+		boost::asio::steady_timer actionTimer;
+		boost::asio::steady_timer pingTimer;
+
+		const Scenario& scenario;
+		const RsaPublicKey& rsa;
+		const tcp::endpoint endpoint;
+		const Account account;
+		const size_t index;
+		Stats& stats;
+
+		std::mt19937 rng;
+		std::discrete_distribution<int> actionDistribution;
+
+		xtea::key key;
+		xtea::round_keys roundKeys;
+
+		std::array<uint8_t, 2> header;
+		std::vector<uint8_t> body;
+		std::deque<std::shared_ptr<const std::vector<uint8_t>>> sendQueue;
+		// counts the closed connections, the socket is reused for the game connection after the login server
+		uint32_t connection = 0;
+
+		Clock::time_point loginStart;
+		Clock::time_point pingSent;
+		uint32_t creatureId = 0;
+		State state = State::CLOSED;
+		bool pingPending = false;
+		bool attacking = false;
+		bool containerOpen = false;
+};
+
+// one account per line: number, password and character name (the rest of the line)
+std::vector<Account> loadAccounts(const std::string& filename)
+{
+	std::vector<Account> accounts;
+	std::ifstream file(filename);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line.front() == '#') {
+			continue;
+		}
+
+		std::istringstream stream(line);
+		Account account;
+		if (stream >> account.number >> account.password >> std::ws && std::getline(stream, account.character)) {
+			accounts.push_back(std::move(account));
+		}
+	}
+	return accounts;
+}
+
+bool parseMix(const std::string& value, std::array<double, ACTION_LAST + 1>& mix)
+{
+	mix.fill(0);
+
+	std::istringstream stream(value);
+	std::string entry;
+	while (std::getline(stream, entry, ',')) {
+		const size_t separator = entry.find('=');
+		if (separator == std::string::npos) {
+			return false;
+		}
+
+		auto it = std::find(actionNames.begin(), actionNames.end(), entry.substr(0, separator));
+		if (it == actionNames.end()) {
+			return false;
+		}
+		mix[it - actionNames.begin()] = std::stod(entry.substr(separator + 1));
+	}
+	return std::any_of(mix.begin(), mix.end(), [](double weight) { return weight > 0; });
+}
+
+void printUsage()
+{
+	std::cout << "Usage: tvp_loadgen [options]\n"
+	             "  --host <address>          server address (127.0.0.1)\n"
+	             "  --login-port <port>       login server port (7171)\n"
+	             "  --game-port <port>        game server port (7172)\n"
+	             "  --login-server            go through the login server before entering the game\n"
+	             "  --key <file>              server key, its public half encrypts the first messages (key.pem)\n"
+	             "  --accounts <file>         one \"number password character\" per line (accounts.txt)\n"
+	             "  --bots <count>            bots to log in, all accounts by default\n"
+	             "  --threads <count>         network threads (2)\n"
+	             "  --rate <actions>          actions per second of each bot (1)\n"
+	             "  --mix <weights>           action weights (walk=50,turn=10,say=10,attack=10,use=20)\n"
+	             "  --ping-interval <ms>      time between the pings measuring latency (1000)\n"
+	             "  --ramp <ms>               time between two bots logging in (50)\n"
+	             "  --duration <seconds>      length of the run once every bot was started (60)\n"
+	             "  --report <seconds>        time between two reports (5)\n"
+	             "  --backpack-sprite <id>    client id of the backpack the bots open (1988)\n"
+	             "  --seed <number>           seed of the bot actions (1)\n";
+}
+
+bool parseArguments(int argc, char* argv[], Scenario& scenario)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		if (arg == "--login-server") {
+			scenario.useLoginServer = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			return false;
+		}
+
+		const std::string value = argv[++i];
+		if (arg == "--host") {
+			scenario.host = value;
+		} else if (arg == "--login-port") {
+			scenario.loginPort = static_cast<uint16_t>(std::stoul(value));
+		} else if (arg == "--game-port") {
+			scenario.gamePort = static_cast<uint16_t>(std::stoul(value));
+		} else if (arg == "--key") {
+			scenario.keyFile = value;
+		} else if (arg == "--accounts") {
+			scenario.accountsFile = value;
+		} else if (arg == "--bots") {
+			scenario.bots = std::stoul(value);
+		} else if (arg == "--threads") {
+			scenario.threads = std::max<size_t>(1, std::stoul(value));
+		} else if (arg == "--rate") {
+			scenario.actionsPerSecond = std::stod(value);
+		} else if (arg == "--mix") {
+			if (!parseMix(value, scenario.mix)) {
+				return false;
+			}
+		} else if (arg == "--ping-interval") {
+			scenario.pingInterval = std::chrono::milliseconds(std::stoul(value));
+		} else if (arg == "--ramp") {
+			scenario.rampInterval = std::chrono::milliseconds(std::stoul(value));
+		} else if (arg == "--duration") {
+			scenario.duration = std::chrono::seconds(std::stoul(value));
+		} else if (arg == "--report") {
+			scenario.reportInterval = std::chrono::seconds(std::max<unsigned long>(1, std::stoul(value)));
+		} else if (arg == "--backpack-sprite") {
+			scenario.backpackSpriteId = static_cast<uint16_t>(std::stoul(value));
+		} else if (arg == "--seed") {
+			scenario.seed = static_cast<uint32_t>(std::stoul(value));
+		} else {
+			return false;
+		}
+	}
+	return scenario.actionsPerSecond > 0;
+}
+
+void report(Stats& stats, double seconds, uint64_t& lastActions, uint64_t& lastPackets, uint64_t& lastBytes)
+{
+	const uint64_t actions = stats.actions.load();
+	const uint64_t packets = stats.packetsReceived.load();
+	const uint64_t bytes = stats.bytesReceived.load();
+	std::cout << fmt::format("online {:d} | actions/s {:.1f} | recv packets/s {:.1f} KB/s {:.1f} | ping {:s} | login {:s}",
+	                         stats.online.load(), (actions - lastActions) / seconds, (packets - lastPackets) / seconds,
+	                         (bytes - lastBytes) / seconds / 1024, stats.ping.takeInterval(), stats.login.takeInterval())
+	          << std::endl;
+
+	lastActions = actions;
+	lastPackets = packets;
+	lastBytes = bytes;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace loadgen;
+
+	Scenario scenario;
+	try {
+		if (!parseArguments(argc, argv, scenario)) {
+			printUsage();
+			return 1;
+		}
+	} catch (const std::exception&) {
+		printUsage();
+		return 1;
+	}
+
+	RsaPublicKey rsa;
+	if (!rsa.load(scenario.keyFile)) {
+		std::cout << "> ERROR: Unable to load the key from " << scenario.keyFile << std::endl;
+		return 1;
+	}
+
+	std::vector<Account> accounts = loadAccounts(scenario.accountsFile);
+	if (scenario.bots != 0 && scenario.bots < accounts.size()) {
+		accounts.resize(scenario.bots);
+	}
+	if (accounts.empty()) {
+		std::cout << "> ERROR: No accounts in " << scenario.accountsFile << std::endl;
+		return 1;
+	}
+
+	boost::asio::io_context io_context;
+	tcp::endpoint endpoint;
+	try {
+		tcp::resolver resolver(io_context);
+		endpoint = *resolver.resolve(scenario.host, std::to_string(scenario.gamePort)).begin();
+	} catch (const boost::system::system_error& e) {
+		std::cout << "> ERROR: Unable to resolve " << scenario.host << ": " << e.what() << std::endl;
+		return 1;
+	}
+
+	auto work = boost::asio::make_work_guard(io_context);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < scenario.threads; ++i) {
+		threads.emplace_back([&io_context]() { io_context.run(); });
+	}
+
+	Stats stats(accounts.size());
+	std::vector<std::shared_ptr<Bot>> bots;
+	bots.reserve(accounts.size());
+
+	std::cout << ">> Starting " << accounts.size() << " bots against " << endpoint.address().to_string() << std::endl;
+
+	uint64_t lastActions = 0, lastPackets = 0, lastBytes = 0;
+	auto lastReport = Clock::now();
+	for (size_t i = 0; i < accounts.size(); ++i) {
+		auto bot = std::make_shared<Bot>(io_context, scenario, rsa, endpoint, std::move(accounts[i]), i, stats);
+		bot->start();
+		bots.push_back(std::move(bot));
+		std::this_thread::sleep_for(scenario.rampInterval);
+
+		if (Clock::now() - lastReport >= scenario.reportInterval) {
+			report(stats, std::chrono::duration<double>(Clock::now() - lastReport).count(), lastActions, lastPackets, lastBytes);
+			lastReport = Clock::now();
+		}
+	}
+
+	const auto end = Clock::now() + scenario.duration;
+	while (Clock::now() < end) {
+		std::this_thread::sleep_until(std::min(end, lastReport + scenario.reportInterval));
+		report(stats, std::chrono::duration<double>(Clock::now() - lastReport).count(), lastActions, lastPackets, lastBytes);
+		lastReport = Clock::now();
+	}
+
+	for (const auto& bot : bots) {
+		bot->stop();
+	}
+	work.reset();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	std::cout << fmt::format(">> Summary: {:d} bots, {:d} login failures, {:d} disconnects, {:d} actions, {:d} packets sent, "
+	                         "{:d} packets received ({:.1f} KB)",
+	                         bots.size(), stats.loginFailures.load(), stats.disconnects.load(), stats.actions.load(),
+	                         stats.packetsSent.load(), stats.packetsReceived.load(), stats.bytesReceived.load() / 1024.)
+	          << std::endl;
+	std::cout << ">> Ping: " << stats.ping.summary() << std::endl;
+	std::cout << ">> Login: " << stats.login.summary() << std::endl;
+	return 0;
+}
@@ -0,0 +1,92 @@
+#!/bin/sh
+# Training run of the profile-guided optimization build, from the source folder like the server:
+#
+#   cmake --preset pgo-generate && cmake --build --preset pgo-generate
+#   tools/pgo/train.sh [--replay <record>] [--bolt]
+#   cmake --preset pgo-use && cmake --build --preset pgo-use
+#
+# The instrumented server writes its profile to build/pgo-profile when it shuts down. The workload is either
+# a packet record replayed offline (--replay, recorded with --record on a production server and replayed on a
+# copy of its data), or by default tvp_loadgen driving bots against the server; the bots log in with the
+# accounts of accounts.txt. The profile is only valid for the sources it was trained on, train again after
+# changing them.
+#
+# --bolt runs the server of the pgo-use build (USE_BOLT) under perf instead and rewrites it with llvm-bolt,
+# the result is left next to it as tvp.bolt.
+
+set -e
+
+PROFILE_DIR=${PROFILE_DIR:-build/pgo-profile}
+LOADGEN=${LOADGEN:-build/pgo-generate/Release/tvp_loadgen}
+BOTS=${BOTS:-100}
+DURATION=${DURATION:-300}
+STARTUP_TIMEOUT=${STARTUP_TIMEOUT:-600}
+
+replay=
+bolt=
+while [ $# -gt 0 ]; do
+	case "$1" in
+		--replay) replay=$2; shift 2 ;;
+		--bolt) bolt=1; shift ;;
+		*) echo "usage: $0 [--replay <record>] [--bolt]" >&2; exit 1 ;;
+	esac
+done
+
+# multi-config generators put the server in a folder named after the configuration
+if [ -z "$TVP" ]; then
+	TVP=./tvp
+	[ -x Release/tvp ] && TVP=Release/tvp
+fi
+
+run_server() {
+	if [ -n "$bolt" ]; then
+		perf record -e cycles:u -j any,u -o build/perf.data -- "$TVP" "$@"
+	else
+		"$TVP" "$@"
+	fi
+}
+
+if [ -z "$bolt" ]; then
+	# counters of an older training would be added to this one
+	rm -rf "$PROFILE_DIR"
+	mkdir -p "$PROFILE_DIR"
+fi
+
+if [ -n "$replay" ]; then
+	# the replay shuts the server down once the record was played
+	run_server --replay="$replay"
+else
+	log=build/pgo-train.log
+	run_server > "$log" 2>&1 &
+	server=$!
+
+	waited=0
+	until grep -q "Server Online" "$log"; do
+		if ! kill -0 "$server" 2>/dev/null || [ "$waited" -ge "$STARTUP_TIMEOUT" ]; then
+			echo "The server did not start, see $log" >&2
+			kill "$server" 2>/dev/null || true
+			exit 1
+		fi
+		sleep 1
+		waited=$((waited + 1))
+	done
+
+	"$LOADGEN" --bots "$BOTS" --duration "$DURATION" || true
+
+	# the profile is written as the server exits, SIGTERM shuts it down cleanly
+	kill -TERM "$server"
+	wait "$server" || true
+fi
+
+if [ -n "$bolt" ]; then
+	perf2bolt -p build/perf.data -o build/perf.fdata "$TVP"
+	llvm-bolt "$TVP" -o "$TVP.bolt" -data=build/perf.fdata -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -dyno-stats
+	echo "Optimized server written to $TVP.bolt"
+	exit 0
+fi
+
+if ls "$PROFILE_DIR"/*.profraw > /dev/null 2>&1; then
+	# clang leaves raw profiles, the pgo-use build reads them merged
+	llvm-profdata merge -output="$PROFILE_DIR/tvp.profdata" "$PROFILE_DIR"/*.profraw
+fi
+echo "Training done, profile in $PROFILE_DIR"